@@ -0,0 +1,208 @@
+#include "DxvaDeviceBroker.h"
+
+
+HRESULT CDxvaDeviceBroker::AcquireDevice(UINT &nAdapter, IDirect3D9Ex **ppD3D, IDirect3DDevice9Ex **ppD3DDev, IDirect3DDeviceManager9 **ppD3DDevMngr)
+{
+	CAutoLock lock(&m_csBroker);
+	auto itFind = m_mapDevice.find(nAdapter);
+	if (itFind == m_mapDevice.end())
+	{
+		DxvaSharedDevice Device;
+		ZeroMemory(&Device, sizeof(DxvaSharedDevice));
+		UINT nRequestAdapter = nAdapter;
+		HRESULT hr = m_pBackend->CreateDevice(nAdapter, Device);
+		if (FAILED(hr))
+			return hr;
+		if (nAdapter != nRequestAdapter)
+		{// Ч,ѸĬ,Ĭ豸Ѿ
+			itFind = m_mapDevice.find(nAdapter);
+			if (itFind != m_mapDevice.end())
+				m_pBackend->DestroyDevice(Device);
+		}
+		if (itFind == m_mapDevice.end())
+			itFind = m_mapDevice.insert(pair<UINT, DxvaSharedDevice>(nAdapter, Device)).first;
+	}
+	DxvaSharedDevice &Device = itFind->second;
+	Device.nChannels++;
+	m_pBackend->ShareDevice(Device, ppD3D, ppD3DDev, ppD3DDevMngr);
+	return S_OK;
+}
+
+void CDxvaDeviceBroker::ReleaseDevice(UINT nAdapter)
+{
+	CAutoLock lock(&m_csBroker);
+	auto itFind = m_mapDevice.find(nAdapter);
+	if (itFind == m_mapDevice.end())
+		return;
+	if (--itFind->second.nChannels > 0)
+		return;
+	DxTraceMsg("%s Destroy the shared device on adapter %d.\n", __FUNCTION__, nAdapter);
+	m_pBackend->DestroyDevice(itFind->second);
+	m_mapDevice.erase(itFind);
+}
+
+bool CDxvaDeviceBroker::ReserveSurfaces(UINT nAdapter, int nSurfaces, LONGLONG nBytes)
+{
+	CAutoLock lock(&m_csBroker);
+	auto itFind = m_mapDevice.find(nAdapter);
+	if (itFind == m_mapDevice.end())
+		return false;
+	DxvaSharedDevice &Device = itFind->second;
+	if (m_nSurfaceBudget > 0 && Device.nSurfaceBytes + nBytes > m_nSurfaceBudget)
+	{
+		DxTraceMsg("%s Surface budget exceeded on adapter %d:%I64d + %I64d > %I64d bytes.\n", __FUNCTION__, nAdapter, Device.nSurfaceBytes, nBytes, m_nSurfaceBudget);
+		return false;
+	}
+	Device.nSurfaces += nSurfaces;
+	Device.nSurfaceBytes += nBytes;
+	return true;
+}
+
+void CDxvaDeviceBroker::UnreserveSurfaces(UINT nAdapter, int nSurfaces, LONGLONG nBytes)
+{
+	CAutoLock lock(&m_csBroker);
+	auto itFind = m_mapDevice.find(nAdapter);
+	if (itFind == m_mapDevice.end())
+		return;
+	itFind->second.nSurfaces -= nSurfaces;
+	itFind->second.nSurfaceBytes -= nBytes;
+}
+
+bool CDxvaDeviceBroker::GetDeviceStat(UINT nAdapter, LONG &nChannels, LONG &nSurfaces, LONGLONG &nSurfaceBytes)
+{
+	CAutoLock lock(&m_csBroker);
+	auto itFind = m_mapDevice.find(nAdapter);
+	if (itFind == m_mapDevice.end())
+		return false;
+	nChannels = itFind->second.nChannels;
+	nSurfaces = itFind->second.nSurfaces;
+	nSurfaceBytes = itFind->second.nSurfaceBytes;
+	return true;
+}
+
+void CDxvaDeviceBroker::TraceStat()
+{
+	CAutoLock lock(&m_csBroker);
+	for (auto it = m_mapDevice.begin(); it != m_mapDevice.end(); it++)
+	{
+		DxTraceMsg("%s Adapter %d:Channels = %d\tSurfaces = %d(%I64d KB).\n", __FUNCTION__,
+					it->first, it->second.nChannels, it->second.nSurfaces, it->second.nSurfaceBytes / 1024);
+	}
+}
+
+#ifdef _WIN32
+typedef HRESULT (WINAPI *DXVA2CreateDeviceManagerProc)(UINT *pResetToken, IDirect3DDeviceManager9 **ppManager);
+
+static CD3D9DeviceBackend s_D3D9DeviceBackend;
+CDxvaDeviceBroker g_DxvaDeviceBroker(&s_D3D9DeviceBackend);
+
+HRESULT CD3D9DeviceBackend::CreateDevice(UINT &nAdapter, DxvaSharedDevice &Device)
+{
+	HRESULT hr = S_OK;
+	Device.hDxva2Lib = ::LoadLibraryA("dxva2.dll");
+	if (!Device.hDxva2Lib)
+	{
+		DxTraceMsg("%s Loading dxva2.dll failed.\n", __FUNCTION__);
+		return E_FAIL;
+	}
+	DXVA2CreateDeviceManagerProc pCreateDeviceManager = (DXVA2CreateDeviceManagerProc)GetProcAddress(Device.hDxva2Lib, "DXVA2CreateDirect3DDeviceManager9");
+	if (!pCreateDeviceManager)
+	{
+		DxTraceMsg("%s DXVA2CreateDirect3DDeviceManager9 not available.\n", __FUNCTION__);
+		DestroyDevice(Device);
+		return E_FAIL;
+	}
+
+	hr = Direct3DCreate9Ex(D3D_SDK_VERSION, &Device.pD3D);
+	if (FAILED(hr))
+	{
+		DxTraceMsg("%s Failed to acquire IDirect3D9Ex.\n", __FUNCTION__);
+		DestroyDevice(Device);
+		return E_FAIL;
+	}
+
+	D3DADAPTER_IDENTIFIER9 d3dai = { 0 };
+	hr = Device.pD3D->GetAdapterIdentifier(nAdapter, 0, &d3dai);
+	if (FAILED(hr) && nAdapter != D3DADAPTER_DEFAULT)
+	{// retry if the adapter is invalid
+		nAdapter = D3DADAPTER_DEFAULT;
+		hr = Device.pD3D->GetAdapterIdentifier(nAdapter, 0, &d3dai);
+	}
+	if (FAILED(hr))
+	{
+		DxTraceMsg("%s Querying of adapter identifier failed with hr: %X.\n", __FUNCTION__, hr);
+		DestroyDevice(Device);
+		return E_FAIL;
+	}
+	DxTraceMsg("%s Create the shared device on adapter %d, %s, vendor 0x%04X, device 0x%04X.\n", __FUNCTION__, nAdapter, d3dai.Description, d3dai.VendorId, d3dai.DeviceId);
+
+	D3DPRESENT_PARAMETERS d3dpp;
+	ZeroMemory(&d3dpp, sizeof(d3dpp));
+	d3dpp.Windowed			= TRUE;
+	d3dpp.BackBufferWidth	= 640;
+	d3dpp.BackBufferHeight	= 480;
+	d3dpp.BackBufferCount	= 0;
+	d3dpp.BackBufferFormat	= D3DFMT_UNKNOWN;
+	d3dpp.SwapEffect		= D3DSWAPEFFECT_DISCARD;
+	d3dpp.Flags				= D3DPRESENTFLAG_VIDEO | D3DPRESENTFLAG_LOCKABLE_BACKBUFFER;
+	// 豸߳ͬʱʹ,ָD3DCREATE_MULTITHREADED
+	hr = Device.pD3D->CreateDeviceEx(nAdapter,
+									D3DDEVTYPE_HAL,
+									GetShellWindow(),
+									D3DCREATE_SOFTWARE_VERTEXPROCESSING | D3DCREATE_MULTITHREADED | D3DCREATE_FPU_PRESERVE,
+									&d3dpp,
+									NULL,
+									&Device.pD3DDev);
+	if (FAILED(hr))
+	{
+		DxTraceMsg("%s Creation of device failed with hr: %X.\n", __FUNCTION__, hr);
+		DestroyDevice(Device);
+		return E_FAIL;
+	}
+
+	hr = pCreateDeviceManager(&Device.nResetToken, &Device.pD3DDevMngr);
+	if (SUCCEEDED(hr))
+		hr = Device.pD3DDevMngr->ResetDevice(Device.pD3DDev, Device.nResetToken);
+	if (FAILED(hr))
+	{
+		DxTraceMsg("%s Creation of Device manager failed with hr: %X.\n", __FUNCTION__, hr);
+		DestroyDevice(Device);
+		return E_FAIL;
+	}
+	return S_OK;
+}
+
+void CD3D9DeviceBackend::DestroyDevice(DxvaSharedDevice &Device)
+{
+	if (Device.pD3DDevMngr)
+	{
+		Device.pD3DDevMngr->Release();
+		Device.pD3DDevMngr = NULL;
+	}
+	if (Device.pD3DDev)
+	{
+		Device.pD3DDev->Release();
+		Device.pD3DDev = NULL;
+	}
+	if (Device.pD3D)
+	{
+		Device.pD3D->Release();
+		Device.pD3D = NULL;
+	}
+	if (Device.hDxva2Lib)
+	{
+		FreeLibrary(Device.hDxva2Lib);
+		Device.hDxva2Lib = NULL;
+	}
+}
+
+void CD3D9DeviceBackend::ShareDevice(DxvaSharedDevice &Device, IDirect3D9Ex **ppD3D, IDirect3DDevice9Ex **ppD3DDev, IDirect3DDeviceManager9 **ppD3DDevMngr)
+{
+	*ppD3D = Device.pD3D;
+	(*ppD3D)->AddRef();
+	*ppD3DDev = Device.pD3DDev;
+	(*ppD3DDev)->AddRef();
+	*ppD3DDevMngr = Device.pD3DDevMngr;
+	(*ppD3DDevMngr)->AddRef();
+}
+#endif
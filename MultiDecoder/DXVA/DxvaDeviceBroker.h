@@ -0,0 +1,119 @@
+#pragma once
+#include "../DxSurface/Win32Port.h"
+#ifdef _WIN32
+#include <d3d9.h>
+#include <dxva2api.h>
+#else
+// Windowsʱ豸ӿֻΪ͸ָڴͺ֮䴫
+struct IDirect3D9Ex;
+struct IDirect3DDevice9Ex;
+struct IDirect3DDeviceManager9;
+#endif
+#include <map>
+#include "../DxSurface/AutoLock.h"
+#include "../DxSurface/DxTrace.h"
+
+using namespace std;
+
+// һнͨõD3D豸
+struct DxvaSharedDevice
+{
+	HMODULE					hDxva2Lib;
+	IDirect3D9Ex			*pD3D;
+	IDirect3DDevice9Ex		*pD3DDev;
+	IDirect3DDeviceManager9	*pD3DDevMngr;
+	UINT					nResetToken;
+	LONG					nChannels;		// ʹø豸ͨ
+	LONG					nSurfaces;		// ͨѷĽ
+	LONGLONG				nSurfaceBytes;	// ͨѷĽԴֵ
+};
+
+/// @brief ٹ豸ĺ
+/// @remark ֻ豸ͳͨͱ,豸Ĵüɺ
+/// ʵʱʹD3D9,ʱԻɲԿĺ
+class IDxvaDeviceBackend
+{
+public:
+	virtual ~IDxvaDeviceBackend() {}
+	/// @brief ϴ豸
+	/// @param nAdapter	,ЧʱΪʵʹõ
+	/// @remark ʧʱͷѴĲ,Deviceȫ
+	virtual HRESULT CreateDevice(UINT &nAdapter, DxvaSharedDevice &Device) = 0;
+	virtual void DestroyDevice(DxvaSharedDevice &Device) = 0;
+	// 豸ӿڵü,ͨʹ
+	virtual void ShareDevice(DxvaSharedDevice &Device, IDirect3D9Ex **ppD3D, IDirect3DDevice9Ex **ppD3DDev, IDirect3DDeviceManager9 **ppD3DDevMngr) = 0;
+};
+
+#ifdef _WIN32
+// ͨdxva2.dllDirect3D9Ex豸豸
+class CD3D9DeviceBackend : public IDxvaDeviceBackend
+{
+public:
+	virtual HRESULT CreateDevice(UINT &nAdapter, DxvaSharedDevice &Device);
+	virtual void DestroyDevice(DxvaSharedDevice &Device);
+	virtual void ShareDevice(DxvaSharedDevice &Device, IDirect3D9Ex **ppD3D, IDirect3DDevice9Ex **ppD3DDev, IDirect3DDeviceManager9 **ppD3DDevMngr);
+};
+#endif
+
+/// @brief 豸
+/// @remark ÿCDXVA2DecodeԭȸԴIDirect3D9Ex豸豸,ͨ϶ʱڽþ֮ǰԴѺľ
+/// 豸Ϊÿֻһ豸豸,ϵͨ,ֻͨԼ豸ͽ
+/// ͬʱͳƸͨĽ,SetSurfaceBudgetÿϽռõԴ
+class CDxvaDeviceBroker
+{
+public:
+	/// @param pBackend	豸ĺ,ȴڸ
+	explicit CDxvaDeviceBroker(IDxvaDeviceBackend *pBackend)
+	{
+		InitializeCriticalSection(&m_csBroker);
+		m_pBackend = pBackend;
+		m_nSurfaceBudget = 0;
+	}
+	~CDxvaDeviceBroker()
+	{
+		for (auto it = m_mapDevice.begin(); it != m_mapDevice.end(); it++)
+			m_pBackend->DestroyDevice(it->second);
+		m_mapDevice.clear();
+		DeleteCriticalSection(&m_csBroker);
+	}
+
+	/// @brief ȡϵĹ豸,豸ʱ,صĽӿھü
+	/// @param nAdapter	,ЧʱΪD3DADAPTER_DEFAULT
+	/// @remark ÿγɹöͬһnAdapterһReleaseDevice
+	HRESULT AcquireDevice(UINT &nAdapter, IDirect3D9Ex **ppD3D, IDirect3DDevice9Ex **ppD3DDev, IDirect3DDeviceManager9 **ppD3DDevMngr);
+
+	// ͨʹ豸,豸ûͨʹʱ
+	void ReleaseDevice(UINT nAdapter);
+
+	/// @brief ǼͨĽ
+	/// @return SetSurfaceBudgetõԴԤʱfalse,Ǽ
+	bool ReserveSurfaces(UINT nAdapter, int nSurfaces, LONGLONG nBytes);
+	void UnreserveSurfaces(UINT nAdapter, int nSurfaces, LONGLONG nBytes);
+
+	// ÿϽռõԴ,Ϊ0ʱ
+	void SetSurfaceBudget(LONGLONG nBytes)
+	{
+		m_nSurfaceBudget = nBytes;
+	}
+
+	/// @brief ȡϹ豸ͳ
+	/// @return û豸ʱfalse
+	bool GetDeviceStat(UINT nAdapter, LONG &nChannels, LONG &nSurfaces, LONGLONG &nSurfaceBytes);
+	int GetDeviceCount()
+	{
+		CAutoLock lock(&m_csBroker);
+		return (int)m_mapDevice.size();
+	}
+
+	void TraceStat();
+private:
+	CDxvaDeviceBroker(const CDxvaDeviceBroker &);
+	CDxvaDeviceBroker &operator=(const CDxvaDeviceBroker &);
+
+	IDxvaDeviceBackend		*m_pBackend;
+	CRITICAL_SECTION		m_csBroker;
+	map<UINT, DxvaSharedDevice> m_mapDevice;
+	LONGLONG				m_nSurfaceBudget;
+};
+
+extern CDxvaDeviceBroker g_DxvaDeviceBroker;
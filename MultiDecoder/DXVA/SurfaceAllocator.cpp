@@ -0,0 +1,216 @@
+#include "SurfaceAllocator.h"
+#include <algorithm>
+
+using namespace std;
+
+CSurfaceAllocator::CSurfaceAllocator()
+{
+	ZeroMemory(m_Slot, sizeof(m_Slot));
+	ZeroMemory(&m_Stat, sizeof(DXVA2SurfaceStat));
+	m_nSurfaces = 0;
+	m_nFreeHead = -1;
+	m_nFreeTail = -1;
+	m_nFreeSurfaces = 0;
+	m_nGeneration = 0;
+	m_nCurrentAge = 1;
+	m_bGrowPending = FALSE;
+	m_nGrowSurfaces = 0;
+	m_hFreeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	InitializeCriticalSection(&m_csSurface);
+}
+
+CSurfaceAllocator::~CSurfaceAllocator()
+{
+	CloseHandle(m_hFreeEvent);
+	DeleteCriticalSection(&m_csSurface);
+}
+
+void CSurfaceAllocator::Reset(int nSurfaces)
+{
+	if (nSurfaces > SURFACE_ALLOCATOR_MAX)
+		nSurfaces = SURFACE_ALLOCATOR_MAX;
+	if (nSurfaces < 0)
+		nSurfaces = 0;
+	CAutoLock lock(&m_csSurface);
+	// б水η
+	for (int i = 0; i < nSurfaces; i++)
+	{
+		m_Slot[i].nRefs = 0;
+		m_Slot[i].nNext = (i + 1 < nSurfaces) ? (i + 1) : -1;
+		m_Slot[i].nAge = 0;
+	}
+	m_nSurfaces = nSurfaces;
+	m_nFreeHead = nSurfaces ? 0 : -1;
+	m_nFreeTail = nSurfaces - 1;
+	m_nFreeSurfaces = nSurfaces;
+	m_nGeneration++;
+	m_Stat.nMinFreeSurfaces = nSurfaces;
+}
+
+// ڳm_csSurfaceʱ
+int CSurfaceAllocator::AllocFree()
+{
+	int nIndex = m_nFreeHead;
+	if (nIndex == -1)
+		return -1;
+	SurfaceSlot &Slot = m_Slot[nIndex];
+	m_nFreeHead = Slot.nNext;
+	if (m_nFreeHead == -1)
+		m_nFreeTail = -1;
+	Slot.nNext = -1;
+	Slot.nRefs++;
+	Slot.nAge = m_nCurrentAge++;
+	m_nFreeSurfaces--;
+	if (m_nFreeSurfaces < m_Stat.nMinFreeSurfaces)
+		m_Stat.nMinFreeSurfaces = m_nFreeSurfaces;
+	m_Stat.nAllocs++;
+	return nIndex;
+}
+
+int CSurfaceAllocator::Alloc(DWORD dwTimeout)
+{
+	{
+		CAutoLock lock(&m_csSurface);
+		int nIndex = AllocFree();
+		if (nIndex != -1 || !dwTimeout)
+			return nIndex;
+		m_Stat.nWaits++;
+	}
+	DWORD dwStart = GetTickCount();
+	DWORD dwElapsed = 0;
+	while (dwElapsed < dwTimeout)
+	{
+		WaitForSingleObject(m_hFreeEvent, dwTimeout - dwElapsed);
+		{
+			CAutoLock lock(&m_csSurface);
+			int nIndex = AllocFree();
+			if (nIndex != -1)
+				return nIndex;
+		}
+		dwElapsed = GetTickCount() - dwStart;
+	}
+	CAutoLock lock(&m_csSurface);
+	m_Stat.nWaitTimeouts++;
+	return -1;
+}
+
+void CSurfaceAllocator::Free(int nIndex, UINT nGeneration)
+{
+	{
+		CAutoLock lock(&m_csSurface);
+		// ؽ֮ͷŵľɱ治ٹ黹
+		if (nGeneration != m_nGeneration || nIndex < 0 || nIndex >= m_nSurfaces)
+			return;
+		SurfaceSlot &Slot = m_Slot[nIndex];
+		assert(Slot.nRefs > 0);
+		if (--Slot.nRefs > 0)
+			return;
+		Slot.nNext = -1;
+		if (m_nFreeTail == -1)
+			m_nFreeHead = nIndex;
+		else
+			m_Slot[m_nFreeTail].nNext = nIndex;
+		m_nFreeTail = nIndex;
+		m_nFreeSurfaces++;
+	}
+	SetEvent(m_hFreeEvent);
+}
+
+void CSurfaceAllocator::RequestGrow(int nExtraSurfaces)
+{
+	CAutoLock lock(&m_csSurface);
+	// ͬһؼ֮֡ǰĶֻһ
+	if (nExtraSurfaces > m_nGrowSurfaces)
+		m_nGrowSurfaces = nExtraSurfaces;
+	m_bGrowPending = TRUE;
+}
+
+bool CSurfaceAllocator::TakeGrow(int &nExtraSurfaces)
+{
+	CAutoLock lock(&m_csSurface);
+	nExtraSurfaces = 0;
+	if (!m_bGrowPending)
+		return false;
+	nExtraSurfaces = m_nGrowSurfaces;
+	m_nGrowSurfaces = 0;
+	m_bGrowPending = FALSE;
+	m_Stat.nGrows++;
+	return true;
+}
+
+void CSurfaceAllocator::GetStat(DXVA2SurfaceStat &Stat)
+{
+	CAutoLock lock(&m_csSurface);
+	Stat = m_Stat;
+	Stat.nSurfaces = m_nSurfaces;
+	Stat.nFreeSurfaces = m_nFreeSurfaces;
+}
+
+int CalcDpbFrames(DpbCodec nCodec, int nLevel, int nWidth, int nHeight, int nRefs, int nReorder)
+{
+	switch (nCodec)
+	{
+	case DpbCodec_MPEG2:
+	case DpbCodec_VC1:
+		return 2;
+	case DpbCodec_H264:
+	case DpbCodec_HEVC:
+		break;
+	default:
+		return 0;
+	}
+	if (nRefs > 0)
+		return min<int>(nRefs + max<int>(nReorder, 0), 16);
+	if (nWidth <= 0 || nHeight <= 0)
+		return 0;
+
+	struct LevelLimit
+	{
+		int nLevel;
+		int nLimit;
+	};
+	if (nCodec == DpbCodec_H264)
+	{
+		// H.264׼A-1иMaxDpbMbs
+		static const LevelLimit LevelDpb[] =
+		{
+			{ 9, 396 }, { 10, 396 }, { 11, 900 }, { 12, 2376 }, { 13, 2376 },
+			{ 20, 2376 }, { 21, 4752 }, { 22, 8100 }, { 30, 8100 }, { 31, 18000 },
+			{ 32, 20480 }, { 40, 32768 }, { 41, 32768 }, { 42, 34816 }, { 50, 110400 },
+			{ 51, 184320 }, { 52, 184320 }
+		};
+		int nMbs = ((nWidth + 15) / 16) * ((nHeight + 15) / 16);
+		for (int i = 0; i < (int)(sizeof(LevelDpb) / sizeof(LevelDpb[0])); i++)
+		{
+			if (LevelDpb[i].nLevel == nLevel)
+				return max<int>(1, min<int>(LevelDpb[i].nLimit / nMbs, 16));
+		}
+		return 0;
+	}
+
+	// HEVC׼A.8иMaxLumaPs
+	static const LevelLimit LevelLumaPs[] =
+	{
+		{ 30, 36864 }, { 60, 122880 }, { 63, 245760 }, { 90, 552960 }, { 93, 983040 },
+		{ 120, 2228224 }, { 123, 2228224 }, { 150, 8912896 }, { 153, 8912896 }, { 156, 8912896 },
+		{ 180, 35651584 }, { 183, 35651584 }, { 186, 35651584 }
+	};
+	const int nMaxDpbPicBuf = 6;
+	LONGLONG nPicSize = (LONGLONG)nWidth * nHeight;
+	for (int i = 0; i < (int)(sizeof(LevelLumaPs) / sizeof(LevelLumaPs[0])); i++)
+	{
+		if (LevelLumaPs[i].nLevel != nLevel)
+			continue;
+		// ͼԽС,ͬDPBԽͼ,A.4.2maxDpbSizeļ
+		LONGLONG nMaxLumaPs = LevelLumaPs[i].nLimit;
+		if (nPicSize <= (nMaxLumaPs >> 2))
+			return min<int>(4 * nMaxDpbPicBuf, 16);
+		else if (nPicSize <= (nMaxLumaPs >> 1))
+			return min<int>(2 * nMaxDpbPicBuf, 16);
+		else if (nPicSize <= ((3 * nMaxLumaPs) >> 2))
+			return min<int>((4 * nMaxDpbPicBuf) / 3, 16);
+		else
+			return nMaxDpbPicBuf;
+	}
+	return 0;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "../DxSurface/Win32Port.h"
+#include "../DxSurface/AutoLock.h"
+#include <stdint.h>
+
+#define SURFACE_ALLOCATOR_MAX	64
+
+struct DXVA2SurfaceStat
+{
+	LONG	nSurfaces;		// ǰı
+	LONG	nFreeSurfaces;	// ǰеı
+	LONG	nMinFreeSurfaces;// бֵ
+	LONG	nAllocs;		// Ĵ
+	LONG	nWaits;			// ûпбȴĴ
+	LONG	nWaitTimeouts;	// ȴʱ½ʧܵĴ
+	LONG	nGrows;			// ӱĴ
+};
+
+// DPBСʱֵı׼
+enum DpbCodec
+{
+	DpbCodec_Unknown = 0,
+	DpbCodec_H264,
+	DpbCodec_HEVC,
+	DpbCodec_MPEG2,			// MPEG-1
+	DpbCodec_VC1,			// WMV3
+};
+
+/// @brief DPBС,ͬʱеĲο֡ʹͼ
+/// @param nLevel	ļ,H.264Ϊlevel_idc,HEVCΪgeneral_level_idc,30
+/// @param nWidth	ͼ,nHeightһڼȷDPBС
+/// @param nRefs	ͷеĲο֡,0ʱٲ,H.264HEVCЧ
+/// @param nReorder	ӳ֡,nRefsһʹ
+/// @return ޷ȷʱ0,ɵ߰׼ֵ
+/// @remark MPEG-2VC-1ֻǰο֡;H.264׼A-1MaxDpbMbsHEVCA.8MaxLumaPsA.4.2ڵĹ,16֡
+int CalcDpbFrames(DpbCodec nCodec, int nLevel, int nWidth, int nHeight, int nRefs, int nReorder);
+
+/// @brief ķ,ֻ,漰D3D
+/// @remark б水ͷŵȺ˳ų,ʱӱͷȡδʹõı,ͷʱ׷ӵβ,ΪO(1);
+/// ÿReset֮1,ͷʱϷʱ,ؽ֮ǰľɱ治ٹ黹
+/// 治ʱֻǼӵ,ɽ߳һؼ֡ȡؽ,;ؽᶪʧο֡
+class CSurfaceAllocator
+{
+public:
+	CSurfaceAllocator();
+	~CSurfaceAllocator();
+
+	/// @brief ؽ,nSurfacesȫ,1
+	/// @remark nSurfacesΪ0б,˺ͷŵıȫ
+	void Reset(int nSurfaces);
+
+	/// @brief һ
+	/// @param dwTimeout	ûпбʱȴ߳ͷŵʱ,λ,Ϊ0ʱ
+	/// @return ,ûпбʱ-1
+	int Alloc(DWORD dwTimeout = 0);
+
+	/// @brief ٱü,ûʱ׷ӵβ
+	/// @param nGeneration	ʱGetGenerationķֵ,뵱ǰͬʱ
+	void Free(int nIndex, UINT nGeneration);
+
+	/// @brief Ǽӱ,һؼ֡TakeGrowȡ
+	/// @param nExtraSurfaces	Ҫӵı,Ϊ0ʾֻ谴µҪؽ
+	void RequestGrow(int nExtraSurfaces);
+	bool IsGrowPending()
+	{
+		return m_bGrowPending != 0;
+	}
+	/// @brief ȡӱ
+	/// @param nExtraSurfaces	Ҫӵı
+	/// @return ûʱfalse
+	bool TakeGrow(int &nExtraSurfaces);
+	/// @brief ÿݰ֮ǰ,ֻڹؼ֡ȡӱ
+	/// @param bKeyFrame	ݰǷΪؼ֡,ǹؼ֡ʱһؼ֡
+	/// @return ڸݰ֮ǰսؽʱtrue
+	bool TakeGrowAtKeyFrame(bool bKeyFrame, int &nExtraSurfaces)
+	{
+		nExtraSurfaces = 0;
+		if (!bKeyFrame || !m_bGrowPending)
+			return false;
+		return TakeGrow(nExtraSurfaces);
+	}
+
+	UINT GetGeneration()
+	{
+		return m_nGeneration;
+	}
+	int GetCount()
+	{
+		return m_nSurfaces;
+	}
+	int GetFreeCount()
+	{
+		return m_nFreeSurfaces;
+	}
+	void GetStat(DXVA2SurfaceStat &Stat);
+private:
+	CSurfaceAllocator(const CSurfaceAllocator &);
+	CSurfaceAllocator &operator=(const CSurfaceAllocator &);
+	int AllocFree();
+
+	struct SurfaceSlot
+	{
+		int			nRefs;		// иñ֡,Ϊ0ʱλڿ
+		int			nNext;		// һ,-1ʾβ
+		uint64_t	nAge;		// һη
+	};
+	SurfaceSlot			m_Slot[SURFACE_ALLOCATOR_MAX];
+	int					m_nSurfaces;
+	int					m_nFreeHead;
+	int					m_nFreeTail;
+	volatile LONG		m_nFreeSurfaces;
+	volatile UINT		m_nGeneration;
+	uint64_t			m_nCurrentAge;
+	volatile LONG		m_bGrowPending;
+	int					m_nGrowSurfaces;
+	HANDLE				m_hFreeEvent;		// б汻ͷʱλ
+	CRITICAL_SECTION	m_csSurface;		// ʾ߳ͷ
+	DXVA2SurfaceStat	m_Stat;
+};
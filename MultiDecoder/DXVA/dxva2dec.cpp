@@ -3,6 +3,7 @@
 
 #include "libavcodec/dxva2.h"
 #include "gpu_memcpy_sse4.h"
+#include "../DxSurface/PixelCopy.h"
 #include <ppl.h>
 #include <assert.h>
 
@@ -185,18 +186,6 @@ static void CopyFrameNV12_SSE4_MT(const BYTE *pSourceData, BYTE *pY, BYTE *pUV,
 			gpu_memcpy(pUV, pSourceData + (surfaceHeight * pitch), halfSize);
 	});
 }
-void CopyPlane(uint8_t *dst, size_t dst_pitch,
-					const uint8_t *src, size_t src_pitch,
-					unsigned width, unsigned height)
-{
-	unsigned int y;
-	for (y = 0; y < height; y++) 
-	{
-		memcpy(dst, src, width);
-		src += src_pitch;
-		dst += dst_pitch;
-	}
-}
 
 CDXVA2Decode::CDXVA2Decode(void)
 {
@@ -204,6 +193,9 @@ CDXVA2Decode::CDXVA2Decode(void)
 	m_DecoderPixelFormat = AV_PIX_FMT_NONE;
 	m_guidDecoderDevice = GUID_NULL;
 	m_DisplayDelay = DXVA2_QUEUE_SURFACES;
+	m_pSurfaceAlloc = new CSurfaceAllocator;
+	m_nSurfacePolicy = SurfacePolicy_Wait;
+	m_dwSurfaceWaitTimeout = 40;
 }
 
 // NV12ʽͼƵdstFrame
@@ -240,18 +232,30 @@ CDXVA2Decode::CDXVA2Decode(void)
 CDXVA2Decode::~CDXVA2Decode(void)
 {
 	DestroyDXVADecoder(true);
-
+	delete m_pSurfaceAlloc;
 }
 
 STDMETHODIMP CDXVA2Decode::DestroyDXVADecoder(bool bFull, bool bNoAVCodec)
 {
 	//m_pCallback->ReleaseAllDXVAResources();	// ͷһ֡
+	// Ա֡еıSurfaceWrapperеñЧ,ͷʱʶΪɱ
+	m_pSurfaceAlloc->Reset(0);
 	for (int i = 0; i < m_NumSurfaces; i++) 
 	{
-		SafeRelease(m_pSurfaces[i].d3d);
+		SafeRelease(m_pRawSurface[i]);
 	}
 	m_NumSurfaces = 0;
-
+	if (m_nReservedSurfaces)
+	{
+		g_DxvaDeviceBroker.UnreserveSurfaces(m_nAdapter, m_nReservedSurfaces, m_nReservedBytes);
+		m_nReservedSurfaces = 0;
+		m_nReservedBytes = 0;
+	}
+	if (m_nAccountedBytes)
+	{
+		g_MemoryAccount.Free(MemTag_Surface, m_nMemoryChannel, m_nAccountedBytes);
+		m_nAccountedBytes = 0;
+	}
 	SafeRelease(m_pDecoder);
 
 	if (!bNoAVCodec) 
@@ -277,6 +281,11 @@ STDMETHODIMP CDXVA2Decode::FreeD3DResources()
 	SafeRelease(m_pD3DDevMngr);
 	SafeRelease(m_pD3DDev);
 	SafeRelease(m_pD3D);
+	if (m_bBrokerDevice)
+	{
+		g_DxvaDeviceBroker.ReleaseDevice(m_nAdapter);
+		m_bBrokerDevice = false;
+	}
 
 	if (m_dxva.dxva2lib) {
 		FreeLibrary(m_dxva.dxva2lib);
@@ -471,71 +480,15 @@ HRESULT CDXVA2Decode::InitD3D(UINT &nAdapter)
 		return E_FAIL;
 	}
 	
-	hr = Direct3DCreate9Ex(D3D_SDK_VERSION, &m_pD3D);
+	// ͬһϵͨһ豸豸,ÿֻͨԼ豸
+	hr = g_DxvaDeviceBroker.AcquireDevice(nAdapter, &m_pD3D, &m_pD3DDev, &m_pD3DDevMngr);
 	if (FAILED(hr))
 	{
-		DxTraceMsg("%s Failed to acquire IDirect3D9Ex.\n",__FUNCTION__);
-		return E_FAIL;
-	}
-
-retry_default:
-	D3DADAPTER_IDENTIFIER9 d3dai = { 0 };
-	hr = m_pD3D->GetAdapterIdentifier(nAdapter, 0, &d3dai);
-	if (FAILED(hr)) 
-	{
-		// retry if the adapter is invalid
-		if (nAdapter != D3DADAPTER_DEFAULT) 
-		{
-			nAdapter = D3DADAPTER_DEFAULT;
-			goto retry_default;
-		}
-		DxTraceMsg( "%s Querying of adapter identifier failed with hr: %X.\n",__FUNCTION__, hr);
-		return E_FAIL;
-	}
-
-	const char *vendor = "Unknown";
-	for (int i = 0; vendors[i].id != 0; i++) 
-	{
-		if (vendors[i].id == d3dai.VendorId) 
-		{
-			vendor = vendors[i].name;
-			break;
-		}
-	}
-
-	DxTraceMsg("%s Running on adapter %d, %S, vendor 0x%04X(%S), device 0x%04X.\n",__FUNCTION__, nAdapter, d3dai.Description, d3dai.VendorId, vendor, d3dai.DeviceId);
-	m_dwVendorId = d3dai.VendorId;
-	m_dwDeviceId = d3dai.DeviceId;
-
-	ZeroMemory(&m_d3dpp, sizeof(m_d3dpp));
-
-	m_d3dpp.Windowed		 = TRUE;
-	m_d3dpp.BackBufferWidth	 = 640/*GetSystemMetrics(SM_CXSCREEN)*/;
-	m_d3dpp.BackBufferHeight = 480/* GetSystemMetrics(SM_CYSCREEN)*/;
-	m_d3dpp.BackBufferCount	 = 0;
-	m_d3dpp.BackBufferFormat = D3DFMT_UNKNOWN/*d3ddm.Format*/;
-	m_d3dpp.SwapEffect		 = D3DSWAPEFFECT_DISCARD;
-	m_d3dpp.Flags			 = D3DPRESENTFLAG_VIDEO | D3DPRESENTFLAG_LOCKABLE_BACKBUFFER;
-	
-	hr = m_pD3D->CreateDeviceEx(nAdapter, 
-								D3DDEVTYPE_HAL, 
-								GetShellWindow(), 
-								D3DCREATE_SOFTWARE_VERTEXPROCESSING | D3DCREATE_MULTITHREADED | D3DCREATE_FPU_PRESERVE,
-								&m_d3dpp, 
-								NULL,
-								&m_pD3DDev);
-	if (FAILED(hr)) 
-	{
-		DxTraceMsg("%s Creation of device failed with hr: %X.\n",__FUNCTION__, hr);
-		return E_FAIL;
-	}
-	
-	hr = CreateD3DDeviceManager(m_pD3DDev, &m_pD3DResetToken, &m_pD3DDevMngr);
-	if (FAILED(hr)) 
-	{
-		DxTraceMsg("%s Creation of Device manager failed with hr: %X.\n", __FUNCTION__,hr);
+		DxTraceMsg("%s Failed to acquire the shared device with hr: %X.\n", __FUNCTION__, hr);
 		return E_FAIL;
 	}
+	m_nAdapter = nAdapter;
+	m_bBrokerDevice = true;
 
 	hr = SetD3DDeviceManager(m_pD3DDevMngr);
 	if (FAILED(hr)) 
@@ -771,6 +724,37 @@ DWORD CDXVA2Decode::GetAlignedDimension(DWORD dim)
 	return dim;
 }
 
+// DPBС,ͬʱеͼ,޷ȷʱ0
+// H.264HEVCĲο֡ӳڽͷAVCodecContext,δʱͷֱʲ
+int CDXVA2Decode::GetDpbFrames()
+{
+	if (!m_pAVCtx)
+		return 0;
+	DpbCodec nCodec = DpbCodec_Unknown;
+	switch (m_nCodecId)
+	{
+	case AV_CODEC_ID_H264:
+		nCodec = DpbCodec_H264;
+		break;
+	case AV_CODEC_ID_HEVC:
+		nCodec = DpbCodec_HEVC;
+		break;
+	case AV_CODEC_ID_MPEG1VIDEO:
+	case AV_CODEC_ID_MPEG2VIDEO:
+		nCodec = DpbCodec_MPEG2;
+		break;
+	case AV_CODEC_ID_VC1:
+	case AV_CODEC_ID_WMV3:
+		nCodec = DpbCodec_VC1;
+		break;
+	default:
+		return 0;
+	}
+	return CalcDpbFrames(nCodec, m_pAVCtx->level,
+						GetAlignedDimension(m_pAVCtx->coded_width), GetAlignedDimension(m_pAVCtx->coded_height),
+						m_pAVCtx->refs, m_pAVCtx->has_b_frames);
+}
+
 #define H264_CHECK_PROFILE(profile) \
   (((profile) & ~FF_PROFILE_H264_CONSTRAINED) <= FF_PROFILE_H264_HIGH)
 
@@ -895,13 +879,31 @@ HRESULT CDXVA2Decode::CreateDXVA2Decoder(int nSurfaces, IDirect3DSurface9 **ppSu
 		m_DecoderPixelFormat = m_pAVCtx->sw_pix_fmt;
 
 		m_NumSurfaces = GetBufferCount();
+		// NV12ÿ1.5ֽ,P010Ϊ3ֽ
+		LONGLONG nSurfaceBytes = (LONGLONG)m_dwSurfaceWidth * m_dwSurfaceHeight * 3 / 2;
+		if (output == (D3DFORMAT)FOURCC_P010)
+			nSurfaceBytes *= 2;
+		if (m_bBrokerDevice)
+		{
+			if (!g_DxvaDeviceBroker.ReserveSurfaces(m_nAdapter, m_NumSurfaces, nSurfaceBytes * m_NumSurfaces))
+			{
+				m_NumSurfaces = 0;
+				return E_OUTOFMEMORY;
+			}
+			m_nReservedSurfaces = m_NumSurfaces;
+			m_nReservedBytes = nSurfaceBytes * m_NumSurfaces;
+		}
 		hr = m_pDXVADecoderService->CreateSurface(m_dwSurfaceWidth, m_dwSurfaceHeight, m_NumSurfaces - 1, output, D3DPOOL_DEFAULT, 0, DXVA2_VideoDecoderRenderTarget, pSurfaces, nullptr);
 		if (FAILED(hr)) 
 		{
 			DxTraceMsg( "%s Creation of surfaces failed with hr: %X.\n",__FUNCTION__, hr);
 			m_NumSurfaces = 0;
+			DestroyDXVADecoder(false, true);		// Ǽ
 			return E_FAIL;
 		}
+		// ɽ̴߳,߳ͨ
+		m_nAccountedBytes = nSurfaceBytes * m_NumSurfaces;
+		m_nMemoryChannel = g_MemoryAccount.Alloc(MemTag_Surface, MEMORY_CURRENT_CHANNEL, m_nAccountedBytes);
 		ppSurfaces = pSurfaces;
 	}
 	else 
@@ -922,16 +924,15 @@ HRESULT CDXVA2Decode::CreateDXVA2Decoder(int nSurfaces, IDirect3DSurface9 **ppSu
 	IDirect3DDevice9 *pDev = nullptr;
 	ppSurfaces[0]->GetDevice(&pDev);
 
+	memset(m_pRawSurface, 0, sizeof(m_pRawSurface));
 	for (int i = 0; i < m_NumSurfaces; i++) 
 	{
-		m_pSurfaces[i].index = i;
-		m_pSurfaces[i].d3d = ppSurfaces[i];
-		m_pSurfaces[i].age = UINT64_MAX;
-		m_pSurfaces[i].used = false;
+		m_pRawSurface[i] = ppSurfaces[i];
 
 		// fill the surface in black, to avoid the "green screen" in case the first frame fails to decode.
 		if (pDev) pDev->ColorFill(ppSurfaces[i], NULL, D3DCOLOR_XYUV(0, 128, 128));
 	}
+	m_pSurfaceAlloc->Reset(m_NumSurfaces);
 
 	// and done with the device
 	SafeRelease(pDev);
@@ -962,11 +963,6 @@ HRESULT CDXVA2Decode::CreateDXVA2Decoder(int nSurfaces, IDirect3DSurface9 **ppSu
 	/* fill hwaccel_context */
 	FillHWContext((dxva_context *)m_pAVCtx->hwaccel_context);
 
-	memset(m_pRawSurface, 0, sizeof(m_pRawSurface));
-	for (int i = 0; i < m_NumSurfaces; i++) {
-		m_pRawSurface[i] = m_pSurfaces[i].d3d;
-	}
-
 	return S_OK;
 }
 
@@ -1015,6 +1011,8 @@ typedef struct SurfaceWrapper {
 	IMediaSample *sample;
 	CDXVA2Decode *pDec;
 	IDirectXVideoDecoder *pDXDecoder;
+	int nIndex;				// m_pRawSurfaceе
+	UINT nGeneration;		// ʱ
 } SurfaceWrapper;
 
 void CDXVA2Decode::free_dxva2_buffer(void *opaque, uint8_t *data)
@@ -1023,14 +1021,7 @@ void CDXVA2Decode::free_dxva2_buffer(void *opaque, uint8_t *data)
 	CDXVA2Decode *pDec = sw->pDec;
 	
 	LPDIRECT3DSURFACE9 pSurface = sw->surface;
-	for (int i = 0; i < pDec->m_NumSurfaces; i++) 
-	{
-		if (pDec->m_pSurfaces[i].d3d == pSurface) 
-		{
-			pDec->m_pSurfaces[i].used = false;
-			break;
-		}
-	}
+	pDec->m_pSurfaceAlloc->Free(sw->nIndex, sw->nGeneration);
 	SafeRelease(pSurface);
 	SafeRelease(sw->pDXDecoder);
 	SafeRelease(sw->sample);
@@ -1050,7 +1041,26 @@ HRESULT CDXVA2Decode::ReInitDXVA2Decoder(AVCodecContext *c)
 		DxTraceMsg(("No DXVA2 Decoder or image dimensions changed -> Re-Allocating resources.\n"));				
 		hr = CreateDXVA2Decoder();		
 	}
+	else if (GetBufferCount() > m_NumSurfaces && !m_pSurfaceAlloc->IsGrowPending())
+	{// DPBʱеı,һؼ֡ؽ,ʱؽᶪʧDPBеĲο֡
+		DxTraceMsg("%s DPB grows to %d surfaces,rebuild at the next key frame.\n", __FUNCTION__, GetBufferCount());
+		m_pSurfaceAlloc->RequestGrow(0);
+	}
+
+	return hr;
+}
 
+// ڹؼ֮֡ǰ:սеĲο֡µıؽ,Աʾһеľɱͷʱ
+HRESULT CDXVA2Decode::GrowSurfaces(int nExtraSurfaces)
+{
+	if (!m_pDecoder)
+		return S_FALSE;
+	avcodec_flush_buffers(m_pAVCtx);
+	m_nExtraSurfaces += nExtraSurfaces;
+	DxTraceMsg("%s Rebuild the decoder with %d surfaces at a key frame.\n", __FUNCTION__, GetBufferCount());
+	HRESULT hr = CreateDXVA2Decoder();
+	if (FAILED(hr))
+		DxTraceMsg("%s CreateDXVA2Decoder failed,hr = %08X.\n", __FUNCTION__, hr);
 	return hr;
 }
 
@@ -1079,36 +1089,32 @@ int CDXVA2Decode::get_dxva2_buffer(struct AVCodecContext *c, AVFrame *pic, int f
 		DxTraceMsg(("Device Lost.\n.\n"));
 	}
 
-	int i;
+	// ûпбʱٸԱеı,ǵȴ߳ͷű;
+	// SurfacePolicy_GrowͬʱǼӱ,һؼ֡ؽ,ڽ;ؽʧο֡
+	int i = pDec->m_pSurfaceAlloc->Alloc();
+	if (i == -1)
 	{
-		int old, old_unused;
-		for (i = 0, old = 0, old_unused = -1; i < pDec->m_NumSurfaces; i++) 
+		if (pDec->m_nSurfacePolicy == SurfacePolicy_Grow && pDec->m_NumSurfaces < DXVA2_MAX_SURFACES && !pDec->m_pSurfaceAlloc->IsGrowPending())
 		{
-			d3d_surface_t *surface = &pDec->m_pSurfaces[i];
-			if (!surface->used && (old_unused == -1 || surface->age < pDec->m_pSurfaces[old_unused].age))
-				old_unused = i;
-			if (surface->age < pDec->m_pSurfaces[old].age)
-				old = i;
+			DxTraceMsg("%s No free surface,grow to %d surfaces at the next key frame.\n", __FUNCTION__, min(pDec->GetBufferCount() + DXVA2_QUEUE_SURFACES, (long)DXVA2_MAX_SURFACES));
+			pDec->m_pSurfaceAlloc->RequestGrow(DXVA2_QUEUE_SURFACES);
 		}
-		if (old_unused == -1) {
-			DxTraceMsg(("No free surface, using oldest.\n"));
-			i = old;
-		}
-		else {
-			i = old_unused;
+		i = pDec->m_pSurfaceAlloc->Alloc(pDec->m_dwSurfaceWaitTimeout);
+		if (i == -1)
+		{
+			DxTraceMsg("%s No free surface in %d surfaces.\n", __FUNCTION__, pDec->m_NumSurfaces);
+			return -1;
 		}
 	}
 
-	LPDIRECT3DSURFACE9 pSurface = pDec->m_pSurfaces[i].d3d;
+	LPDIRECT3DSURFACE9 pSurface = pDec->m_pRawSurface[i];
 	if (!pSurface) 
 	{
 		DxTraceMsg(("There is a sample, but no D3D Surace? WTF?.\n"));
+		pDec->m_pSurfaceAlloc->Free(i, pDec->m_pSurfaceAlloc->GetGeneration());
 		return -1;
 	}
 
-	pDec->m_pSurfaces[i].age = pDec->m_CurrentSurfaceAge++;
-	pDec->m_pSurfaces[i].used = true;
-
 	memset(pic->data, 0, sizeof(pic->data));
 	memset(pic->linesize, 0, sizeof(pic->linesize));
 	memset(pic->buf, 0, sizeof(pic->buf));
@@ -1117,6 +1123,8 @@ int CDXVA2Decode::get_dxva2_buffer(struct AVCodecContext *c, AVFrame *pic, int f
 	SurfaceWrapper *surfaceWrapper = new SurfaceWrapper();
 	surfaceWrapper->pDec			 = pDec;
 	surfaceWrapper->surface		 = pSurface;
+	surfaceWrapper->nIndex		 = i;
+	surfaceWrapper->nGeneration	 = pDec->m_pSurfaceAlloc->GetGeneration();
 	surfaceWrapper->surface->AddRef();
 	surfaceWrapper->pDXDecoder	 = pDec->m_pDecoder;
 	surfaceWrapper->pDXDecoder->AddRef();
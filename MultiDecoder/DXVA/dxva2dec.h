@@ -47,11 +47,16 @@ extern "C" {
 #pragma warning(pop)
 
 #include "../DxSurface/DxTrace.h"
+#include "../DxSurface/AutoLock.h"
+#include "DxvaDeviceBroker.h"
+#include "SurfaceAllocator.h"
+#include "../DxSurface/MemoryAccount.h"
 #include <string>
 using namespace std;
 
-#define DXVA2_MAX_SURFACES 64
+#define DXVA2_MAX_SURFACES SURFACE_ALLOCATOR_MAX
 #define DXVA2_QUEUE_SURFACES 4
+#define DXVA2_RENDER_SURFACES 3		// Ⱦһͬʱеı:еȴʾ֡ʾ֡Ⱦһ֡
 #define DXVA2_SURFACE_BASE_ALIGN 16
 
 #ifndef SAFE_ARRAY_DELETE
@@ -82,13 +87,13 @@ std::wstring WStringFromGUID(const GUID& guid);
 
 typedef HRESULT WINAPI pCreateDeviceManager9(UINT *pResetToken, IDirect3DDeviceManager9 **);
 
-typedef struct 
+// ȫռʱĴ
+// ɵֱӸı,ñԱΪο֡ʾ̳߳,ᵼͼ
+enum DXVA2SurfacePolicy
 {
-	int index;
-	bool used;
-	LPDIRECT3DSURFACE9 d3d;
-	uint64_t age;
-} d3d_surface_t;
+	SurfacePolicy_Wait = 0,		// ȴ߳ͷű,ʱ֡ʧ
+	SurfacePolicy_Grow,			// SurfacePolicy_Waitһȴ,ͬʱһؼ֡սӱؽ,ӵDXVA2_MAX_SURFACES
+};
 
 
 #define AVCODEC_MAX_THREADS 16
@@ -190,9 +195,14 @@ public:
 	{
 		long buffers = 0;
 
+		// ֪DPBСʱʵҪ,һɰֵ,ԱԴɸͨ
+		// DPB,ӵǰı桢رһ֡,ԼȾһͬʱеı,ʼʱ˷,;
+		int nDpbFrames = GetDpbFrames();
+		if (nDpbFrames > 0)
+			buffers = nDpbFrames + 2 + DXVA2_RENDER_SURFACES;
 		// Native decoding should use 16 buffers to enable seamless codec changes
 		// Buffers based on max ref frames
-		if (m_nCodecId == AV_CODEC_ID_H264)
+		else if (m_nCodecId == AV_CODEC_ID_H264)
 			buffers = 8;
 		else if (m_nCodecId == AV_CODEC_ID_HEVC)
 			buffers = 16;
@@ -203,7 +213,9 @@ public:
 		// buffers += 4;
 		// buffers += m_DisplayDelay;
 
-		return buffers;
+		// SurfacePolicy_Grow治ڹؼ֡׷ӵı
+		buffers += m_nExtraSurfaces;
+		return min(buffers, (long)DXVA2_MAX_SURFACES);
 	}
 
 	// Ҫļͬʱʼ
@@ -303,6 +315,7 @@ public:
 		return S_OK;
 	}
 	DWORD GetAlignedDimension(DWORD dim);
+	int GetDpbFrames();
 
 public:
 	HRESULT InitD3D(UINT &nAdapter /*= D3DADAPTER_DEFAULT*/);
@@ -321,9 +334,26 @@ public:
 	HRESULT CheckHWCompatConditions(GUID decoderGuid);
 	HRESULT FillHWContext(dxva_context *ctx);
 	HRESULT ReInitDXVA2Decoder(AVCodecContext *c);
+	HRESULT GrowSurfaces(int nExtraSurfaces);
 	static enum AVPixelFormat get_dxva2_format(struct AVCodecContext *s, const enum AVPixelFormat * pix_fmts);
 	static int get_dxva2_buffer(struct AVCodecContext *c, AVFrame *pic, int flags);
 	static void free_dxva2_buffer(void *opaque, uint8_t *data);	
+
+	/// @brief ýȫռʱĴ
+	/// @param nPolicy		
+	/// @param dwWaitTimeout	SurfacePolicy_Waitµĵȴʱ,λ
+	/// @remark ĬΪSurfacePolicy_Wait,ڳʼʱѰDPBСȾһеıȷ,һ㲻þ
+	/// ԴȾһܳʱбʱɸSurfacePolicy_Grow,һؼ֡ӱ
+	void SetSurfacePolicy(DXVA2SurfacePolicy nPolicy, DWORD dwWaitTimeout = 40)
+	{
+		m_nSurfacePolicy = nPolicy;
+		m_dwSurfaceWaitTimeout = dwWaitTimeout;
+	}
+
+	void GetSurfaceStat(DXVA2SurfaceStat &Stat)
+	{
+		m_pSurfaceAlloc->GetStat(Stat);
+	}
 	inline IDirect3DDevice9 *GetD3DDevice()
 	{
 		return m_pD3DDev;
@@ -336,9 +366,20 @@ public:
 
 	inline int Decode(AVFrame *pFrame, int &got_picture,AVPacket *pPacket)
 	{
+		// 治ʱƳٵؼ֡ؽ,˺ͼ֮ǰĲο֡
+		int nExtraSurfaces = 0;
+		if (pPacket && m_pSurfaceAlloc->TakeGrowAtKeyFrame((pPacket->flags & AV_PKT_FLAG_KEY) != 0, nExtraSurfaces))
+			GrowSurfaces(nExtraSurfaces);
 		return avcodec_decode_video2(m_pAVCtx, pFrame, &got_picture, pPacket);
 	}
 
+	// ýʱ֡,ͼҪʾʱֻο֡
+	inline void SetSkipFrame(AVDiscard nDiscard)
+	{
+		if (m_pAVCtx)
+			m_pAVCtx->skip_frame = nDiscard;
+	}
+
 	inline int SeekFrame(int64_t timestamp, int flags)
 	{
 		if (!m_pFormatCtx)
@@ -361,6 +402,12 @@ public:
 		pCreateDeviceManager9 *createDeviceManager;
 	} m_dxva;
 
+	UINT					m_nAdapter;			// 豸ڵ
+	bool					m_bBrokerDevice;	// 豸ȡg_DxvaDeviceBroker
+	int						m_nReservedSurfaces;// g_DxvaDeviceBrokerǼǵıԴ
+	LONGLONG				m_nReservedBytes;
+	LONGLONG				m_nAccountedBytes;	// g_MemoryAccountֽ
+	int						m_nMemoryChannel;
 	IDirect3D9Ex            *m_pD3D /*= nullptr*/;
 	IDirect3DDevice9Ex      *m_pD3DDev/* = nullptr*/;
 	IDirect3DDeviceManager9 *m_pD3DDevMngr/* = nullptr*/;
@@ -370,8 +417,10 @@ public:
 	IDirectXVideoDecoder        *m_pDecoder/* = nullptr*/;
 	DXVA2_ConfigPictureDecode   m_DXVAVideoDecoderConfig;
 	int					m_NumSurfaces/* = 0*/;
-	d3d_surface_t		m_pSurfaces[DXVA2_MAX_SURFACES];
-	uint64_t			m_CurrentSurfaceAge/* = 1*/;
+	CSurfaceAllocator	*m_pSurfaceAlloc;		// m_pRawSurfaceеı;ڹʱ,ֱΪԱ
+	int					m_nExtraSurfaces;
+	DXVA2SurfacePolicy	m_nSurfacePolicy;
+	DWORD				m_dwSurfaceWaitTimeout;
 	LPDIRECT3DSURFACE9	m_pRawSurface[DXVA2_MAX_SURFACES];
 
 	AVPixelFormat		m_DecoderPixelFormat/* = AV_PIX_FMT_NONE*/;
@@ -40,7 +40,7 @@ inline void* gpu_memcpy(void* d, const void* s, size_t size)
     }
 
     __m128i xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7;
-#ifdef _M_X64
+#if defined(_M_X64) || defined(__x86_64__)
     __m128i xmm8, xmm9, xmm10, xmm11, xmm12, xmm13, xmm14, xmm15;
 #endif
 
@@ -66,7 +66,7 @@ inline void* gpu_memcpy(void* d, const void* s, size_t size)
         xmm5  = _mm_stream_load_si128(pSrc + 5);
         xmm6  = _mm_stream_load_si128(pSrc + 6);
         xmm7  = _mm_stream_load_si128(pSrc + 7);
-#ifdef _M_X64 // Use all 16 xmm registers
+#if defined(_M_X64) || defined(__x86_64__) // Use all 16 xmm registers
         xmm8  = _mm_stream_load_si128(pSrc + 8);
         xmm9  = _mm_stream_load_si128(pSrc + 9);
         xmm10 = _mm_stream_load_si128(pSrc + 10);
@@ -86,7 +86,7 @@ inline void* gpu_memcpy(void* d, const void* s, size_t size)
         _mm_store_si128(pTrg +  5, xmm5);
         _mm_store_si128(pTrg +  6, xmm6);
         _mm_store_si128(pTrg +  7, xmm7);
-#ifdef _M_X64 // Use all 16 xmm registers
+#if defined(_M_X64) || defined(__x86_64__) // Use all 16 xmm registers
         _mm_store_si128(pTrg +  8, xmm8);
         _mm_store_si128(pTrg +  9, xmm9);
         _mm_store_si128(pTrg + 10, xmm10);
@@ -0,0 +1,176 @@
+#include "AdaptiveLock.h"
+#include <vector>
+#include <algorithm>
+#include "DxTrace.h"
+
+using namespace std;
+
+volatile LONG g_bLockProfile = FALSE;
+static LockSiteStat * volatile s_pLockSites = NULL;	// ѵǼǵļλ,ֻӲɾ
+static volatile LONG s_nProcessors = 0;
+
+static int GetProcessorCount()
+{
+	if (!s_nProcessors)
+	{
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		InterlockedExchange(&s_nProcessors, si.dwNumberOfProcessors);
+	}
+	return s_nProcessors;
+}
+
+void LockProfileEnable(bool bEnable)
+{
+	InterlockedExchange(&g_bLockProfile, bEnable ? TRUE : FALSE);
+}
+
+void LockProfileReset()
+{
+	for (LockSiteStat *pSite = s_pLockSites; pSite; pSite = pSite->pNext)
+	{
+		InterlockedExchange(&pSite->nAcquires, 0);
+		InterlockedExchange(&pSite->nContended, 0);
+		InterlockedExchange64(&pSite->nWaitNs, 0);
+		InterlockedExchange64(&pSite->nHoldNs, 0);
+		InterlockedExchange64(&pSite->nMaxWaitNs, 0);
+	}
+}
+
+void LockProfileRecord(LockSiteStat *pSite, int64_t nWaitNs, int64_t nHoldNs, bool bContended)
+{
+	if (!pSite->bRegistered && InterlockedCompareExchange(&pSite->bRegistered, TRUE, FALSE) == FALSE)
+	{
+		LockSiteStat *pHead = NULL;
+		do
+		{
+			pHead = s_pLockSites;
+			pSite->pNext = pHead;
+		} while (InterlockedCompareExchangePointer((PVOID volatile *)&s_pLockSites, pSite, pHead) != pHead);
+	}
+	InterlockedIncrement(&pSite->nAcquires);
+	InterlockedExchangeAdd64(&pSite->nHoldNs, nHoldNs);
+	if (!bContended)
+		return;
+	InterlockedIncrement(&pSite->nContended);
+	InterlockedExchangeAdd64(&pSite->nWaitNs, nWaitNs);
+	LONGLONG nMax = pSite->nMaxWaitNs;
+	while (nWaitNs > nMax)
+	{
+		LONGLONG nOld = InterlockedCompareExchange64(&pSite->nMaxWaitNs, nWaitNs, nMax);
+		if (nOld == nMax)
+			break;
+		nMax = nOld;
+	}
+}
+
+void LockProfileTrace(int nTop)
+{
+	vector<LockSiteStat *> vecSite;
+	for (LockSiteStat *pSite = s_pLockSites; pSite; pSite = pSite->pNext)
+	{
+		if (pSite->nAcquires)
+			vecSite.push_back(pSite);
+	}
+	sort(vecSite.begin(), vecSite.end(), [](const LockSiteStat *a, const LockSiteStat *b)
+	{
+		return a->nWaitNs > b->nWaitNs;
+	});
+	for (int i = 0; i < (int)vecSite.size() && i < nTop; i++)
+	{
+		LockSiteStat *pSite = vecSite[i];
+		LONG nAcquires = pSite->nAcquires;
+		LONG nContended = pSite->nContended;
+		DxTraceMsg("%s %s@%s(%d)\tAcquires = %d\tContended = %.2f%%\tWait = %.3fms(Avg = %.0fns,Max = %.0fns)\tAvgHold = %.0fns.\n", __FUNCTION__,
+					pSite->szName, pSite->szFunction, pSite->nLine, nAcquires, nAcquires ? (double)nContended * 100 / nAcquires : 0.0f,
+					MonoNsToMs(pSite->nWaitNs), nContended ? (double)pSite->nWaitNs / nContended : 0.0f, (double)pSite->nMaxWaitNs,
+					nAcquires ? (double)pSite->nHoldNs / nAcquires : 0.0f);
+	}
+}
+
+void CSpinMutex::LockContended()
+{
+	// ϳ̲߳ͬʱ,û
+	if (GetProcessorCount() > 1)
+	{
+		LONG nMaxSpin = min<LONG>(m_nSpin * 2 + 16, SPIN_MUTEX_MAX_SPIN);
+		for (LONG i = 0; i < nMaxSpin; i++)
+		{
+			_mm_pause();
+			if (m_nState == 0 && InterlockedCompareExchange(&m_nState, 1, 0) == 0)
+			{
+				m_nSpin += (i - m_nSpin) / 8;
+				return;
+			}
+		}
+		m_nSpin += (nMaxSpin - m_nSpin) / 8;
+	}
+	HANDLE hEvent = GetEvent();
+	// Ϊ2,߳̾ݴ˻һߵ߳;ѵ߳Ϊ2,Ϊܻ߳
+	while (InterlockedExchange(&m_nState, 2) != 0)
+	{
+		if (hEvent)
+			WaitForSingleObject(hEvent, INFINITE);
+		else
+			Sleep(1);
+	}
+}
+
+void CSpinMutex::Wake()
+{
+	HANDLE hEvent = m_hEvent;
+	if (hEvent)
+		SetEvent(hEvent);
+}
+
+HANDLE CSpinMutex::GetEvent()
+{
+	if (m_hEvent)
+		return m_hEvent;
+	HANDLE hEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (!hEvent)
+		return NULL;
+	if (InterlockedCompareExchangePointer((PVOID volatile *)&m_hEvent, hEvent, NULL) != NULL)
+		CloseHandle(hEvent);
+	return m_hEvent;
+}
+
+// ȴĵnRound:𽥼ӱĴ,óʱƬ,1
+static void RWLockBackoff(int &nRound)
+{
+	if (nRound < 10 && GetProcessorCount() > 1)
+	{
+		for (int i = 0; i < (1 << nRound); i++)
+			_mm_pause();
+	}
+	else if (nRound < 20)
+		SwitchToThread();
+	else
+		Sleep(1);
+	nRound++;
+}
+
+void CRWLock::LockSharedContended()
+{
+	int nRound = 0;
+	while (!TryLockShared())
+		RWLockBackoff(nRound);
+}
+
+void CRWLock::LockContended()
+{
+	int nRound = 0;
+	while (true)
+	{
+		LONG nState = m_nState;
+		if (!(nState & ~RWLock_WriterWaiting))
+		{// ûжߺд,ͬʱȴ־,ڵȴд߻
+			if (InterlockedCompareExchange(&m_nState, RWLock_Writer, nState) == nState)
+				return;
+			continue;
+		}
+		if (!(nState & RWLock_WriterWaiting))
+			_InterlockedOr(&m_nState, RWLock_WriterWaiting);
+		RWLockBackoff(nRound);
+	}
+}
@@ -0,0 +1,279 @@
+#pragma once
+#include <assert.h>
+#include "Win32Port.h"
+#include "MonoClock.h"
+
+#define SPIN_MUTEX_MAX_SPIN		1000	// ֮ǰ
+
+/// @brief һλõľͳ
+/// @remark LOCK_SITE궨Ϊڵľ̬,ƺλȫΪ0,ڱʱɳʼ;
+/// һμ¼ʱǼǵ̵ļλ,˺ͷ
+struct LockSiteStat
+{
+	const char			*szName;		// 
+	const char			*szFunction;	// ĺ
+	int					nLine;
+	volatile LONG		nAcquires;		// 
+	volatile LONG		nContended;		// ҪȴĴ
+	volatile LONGLONG	nWaitNs;		// ۼƵȴʱ,λ
+	volatile LONGLONG	nHoldNs;		// ۼƳʱ,λ
+	volatile LONGLONG	nMaxWaitNs;
+	volatile LONG		bRegistered;
+	LockSiteStat		*pNext;
+};
+
+extern volatile LONG g_bLockProfile;
+
+/// @brief رռλõľͳ
+/// @remark رʱλֻһ־,ȡʱ;ʱδļֻȡʱĿ
+void LockProfileEnable(bool bEnable);
+inline bool LockProfileIsEnabled()
+{
+	return g_bLockProfile != 0;
+}
+// мλõͳ
+void LockProfileReset();
+// ۼƵȴʱӶൽǰnTopλõͳ
+void LockProfileTrace(int nTop = 20);
+void LockProfileRecord(LockSiteStat *pSite, int64_t nWaitNs, int64_t nHoldNs, bool bContended);
+
+/// @brief ߵĻ,
+/// @remark δʱͽֻһԭӲ;ʱ,лĴ,
+/// ĳʱܶʱں,δʱ¼,õ¼ڵһҪʱŴ
+/// гԱȫΪ0ΪЧĳʼ״̬,ΪCDxSurfaceĳԱ
+/// ԰¼߳,ͬһ߳ظʱʧ,¼Զȴ
+class CSpinMutex
+{
+public:
+	CSpinMutex()
+	{
+		m_nState = 0;
+		m_hEvent = NULL;
+		m_nSpin = 0;
+#ifdef _DEBUG
+		m_dwOwner = 0;
+#endif
+	}
+	~CSpinMutex()
+	{
+		if (m_hEvent)
+			CloseHandle(m_hEvent);
+	}
+	bool TryLock()
+	{
+		if (InterlockedCompareExchange(&m_nState, 1, 0) != 0)
+			return false;
+		SetOwner();
+		return true;
+	}
+	// ,Ƿ˾
+	bool Lock()
+	{
+#ifdef _DEBUG
+		assert(m_dwOwner != GetCurrentThreadId() && "CSpinMutex is not reentrant");
+#endif
+		bool bContended = InterlockedCompareExchange(&m_nState, 1, 0) != 0;
+		if (bContended)
+			LockContended();
+		SetOwner();
+		return bContended;
+	}
+	void Unlock()
+	{
+#ifdef _DEBUG
+		m_dwOwner = 0;
+#endif
+		if (InterlockedExchange(&m_nState, 0) == 2)
+			Wake();
+	}
+private:
+	CSpinMutex(const CSpinMutex &);
+	CSpinMutex &operator=(const CSpinMutex &);
+	void LockContended();
+	void Wake();
+	HANDLE GetEvent();
+	void SetOwner()
+	{
+#ifdef _DEBUG
+		m_dwOwner = GetCurrentThreadId();
+#endif
+	}
+
+	volatile LONG		m_nState;	// 0:δ 1:Ѽ 2:Ѽҿ߳
+	HANDLE volatile		m_hEvent;	// Զλ¼
+	LONG				m_nSpin;	// лƽֵ
+#ifdef _DEBUG
+	DWORD volatile		m_dwOwner;	// ߳
+#endif
+};
+
+/// @brief д,дٵĳʹ,д
+/// @remark дߵȴʱµĶ߲ٽ,д߲;ȴʱ,óʱƬ,1Ϊλ,
+/// дҳʱ̵ܶĳ,細ڵʾӳ;,ҲΪд
+/// гԱȫΪ0ΪЧĳʼ״̬,̬عĳʼ˳
+class CRWLock
+{
+public:
+	CRWLock()
+	{
+		m_nState = 0;
+	}
+	bool TryLockShared()
+	{
+		LONG nState = m_nState;
+		return !(nState & (RWLock_Writer | RWLock_WriterWaiting)) &&
+			InterlockedCompareExchange(&m_nState, nState + 1, nState) == nState;
+	}
+	// Ӷ,Ƿ˾
+	bool LockShared()
+	{
+		if (TryLockShared())
+			return false;
+		LockSharedContended();
+		return true;
+	}
+	void UnlockShared()
+	{
+		InterlockedDecrement(&m_nState);
+	}
+	bool TryLock()
+	{
+		return InterlockedCompareExchange(&m_nState, RWLock_Writer, 0) == 0;
+	}
+	// д,Ƿ˾
+	bool Lock()
+	{
+		if (TryLock())
+			return false;
+		LockContended();
+		return true;
+	}
+	void Unlock()
+	{
+		_InterlockedAnd(&m_nState, ~RWLock_Writer);
+	}
+private:
+	CRWLock(const CRWLock &);
+	CRWLock &operator=(const CRWLock &);
+	void LockSharedContended();
+	void LockContended();
+	enum
+	{
+		RWLock_Writer = 0x40000000,			// д߳
+		RWLock_WriterWaiting = 0x20000000,	// дڵȴ
+		RWLock_ReaderMask = 0x1FFFFFFF,		// Ķ
+	};
+	volatile LONG		m_nState;
+};
+
+/// @brief ڶCSpinMutex,pSiteΪNULLͳѿʱ¼ȴͳʱ
+/// @remark һͨMUTEX_LOCKMUTEX_TRYLOCKʹ,ΪÿλöһLockSiteStat
+class CMutexLock
+{
+public:
+	CMutexLock(CSpinMutex *pMutex, LockSiteStat *pSite = NULL, bool bTry = false)
+	{
+		m_pMutex = pMutex;
+		m_pSite = (pSite && LockProfileIsEnabled()) ? pSite : NULL;
+		m_nLockTime = 0;
+		m_nWaitNs = 0;
+		m_bContended = false;
+		m_bLocked = true;
+		if (bTry)
+			m_bLocked = pMutex->TryLock();
+		else if (!m_pSite)
+			pMutex->Lock();
+		else if (!pMutex->TryLock())
+		{
+			int64_t nT1 = MonoTimeNs();
+			pMutex->Lock();
+			m_nWaitNs = MonoTimeNs() - nT1;
+			m_bContended = true;
+		}
+		if (m_pSite && m_bLocked)
+			m_nLockTime = MonoTimeNs();
+	}
+	~CMutexLock()
+	{
+		if (!m_bLocked)
+			return;
+		int64_t nHoldNs = m_pSite ? MonoTimeNs() - m_nLockTime : 0;
+		m_pMutex->Unlock();
+		if (m_pSite)
+			LockProfileRecord(m_pSite, m_nWaitNs, nHoldNs, m_bContended);
+	}
+	bool IsLocked() const
+	{
+		return m_bLocked;
+	}
+private:
+	CSpinMutex		*m_pMutex;
+	LockSiteStat	*m_pSite;
+	int64_t			m_nLockTime;
+	int64_t			m_nWaitNs;
+	bool			m_bLocked;
+	bool			m_bContended;
+};
+
+// ڶCRWLockӶд,ͳƷʽCMutexLockͬ
+class CRWLockGuard
+{
+public:
+	CRWLockGuard(CRWLock *pLock, bool bShared, LockSiteStat *pSite = NULL)
+	{
+		m_pLock = pLock;
+		m_bShared = bShared;
+		m_pSite = (pSite && LockProfileIsEnabled()) ? pSite : NULL;
+		m_nLockTime = 0;
+		m_nWaitNs = 0;
+		m_bContended = false;
+		if (!m_pSite)
+		{
+			if (bShared)
+				pLock->LockShared();
+			else
+				pLock->Lock();
+			return;
+		}
+		if (bShared ? !pLock->TryLockShared() : !pLock->TryLock())
+		{
+			int64_t nT1 = MonoTimeNs();
+			if (bShared)
+				pLock->LockShared();
+			else
+				pLock->Lock();
+			m_nWaitNs = MonoTimeNs() - nT1;
+			m_bContended = true;
+		}
+		m_nLockTime = MonoTimeNs();
+	}
+	~CRWLockGuard()
+	{
+		int64_t nHoldNs = m_pSite ? MonoTimeNs() - m_nLockTime : 0;
+		if (m_bShared)
+			m_pLock->UnlockShared();
+		else
+			m_pLock->Unlock();
+		if (m_pSite)
+			LockProfileRecord(m_pSite, m_nWaitNs, nHoldNs, m_bContended);
+	}
+private:
+	CRWLock			*m_pLock;
+	LockSiteStat	*m_pSite;
+	int64_t			m_nLockTime;
+	int64_t			m_nWaitNs;
+	bool			m_bShared;
+	bool			m_bContended;
+};
+
+#define LOCK_CONCAT2(a, b)		a##b
+#define LOCK_CONCAT(a, b)		LOCK_CONCAT2(a, b)
+#define LOCK_SITE_VAR			LOCK_CONCAT(_LockSite, __LINE__)
+#define LOCK_SITE(szName)		static LockSiteStat LOCK_SITE_VAR = { szName, __FUNCTION__, __LINE__ }
+
+// ڼ,ƺڵĺкͳƾ
+#define MUTEX_LOCK(Mutex)			LOCK_SITE(#Mutex); CMutexLock LOCK_CONCAT(_MutexLock, __LINE__)(&(Mutex), &LOCK_SITE_VAR)
+// Լ,Guard.IsLocked()Ƿɹ
+#define MUTEX_TRYLOCK(Guard, Mutex)	LOCK_SITE(#Mutex); CMutexLock Guard(&(Mutex), &LOCK_SITE_VAR, true)
+#define READ_LOCK(RWLock)			LOCK_SITE(#RWLock); CRWLockGuard LOCK_CONCAT(_ReadLock, __LINE__)(&(RWLock), true, &LOCK_SITE_VAR)
+#define WRITE_LOCK(RWLock)			LOCK_SITE(#RWLock); CRWLockGuard LOCK_CONCAT(_WriteLock, __LINE__)(&(RWLock), false, &LOCK_SITE_VAR)
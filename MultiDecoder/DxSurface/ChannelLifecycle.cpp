@@ -0,0 +1,230 @@
+#include "ChannelLifecycle.h"
+#include <vector>
+
+CChannelLifecycle::CChannelLifecycle()
+{
+	m_hEventIdle = CreateEvent(NULL, TRUE, TRUE, NULL);
+	m_nAlive = 0;
+	m_bShutdown = FALSE;
+	m_pStopProc = NULL;
+	m_pExitProc = NULL;
+	m_pUserPtr = NULL;
+	ZeroMemory(&m_Stat, sizeof(ChannelLifecycleStat));
+}
+
+CChannelLifecycle::~CChannelLifecycle()
+{
+	Shutdown();
+	if (m_hEventIdle)
+		CloseHandle(m_hEventIdle);
+}
+
+void CChannelLifecycle::SetCallback(ChannelStopProc pStopProc, ChannelExitProc pExitProc, void *pUserPtr)
+{
+	m_pStopProc = pStopProc;
+	m_pExitProc = pExitProc;
+	m_pUserPtr = pUserPtr;
+}
+
+bool CChannelLifecycle::Add(int nChannel, ChannelThreadProc pThreadProc, void *pContext, bool bSuspended)
+{
+	if (!pThreadProc || !pContext)
+		return false;
+	int64_t nT1 = MonoTimeNs();
+	MUTEX_LOCK(m_csChannel);
+	if (Find(pContext) != m_listChannel.end())
+	{
+		DxTraceMsg("%s Channel %d is already added.\n", __FUNCTION__, nChannel);
+		return false;
+	}
+	ChannelEntry *pEntry = new ChannelEntry;
+	ZeroMemory(pEntry, sizeof(ChannelEntry));
+	pEntry->pOwner = this;
+	pEntry->nChannel = nChannel;
+	pEntry->pContext = pContext;
+	// ȹ𴴽,Ǽǵȴ֮ٿʼ,̼߳ʹ˳Ҳܵõ֪ͨ
+	pEntry->hThread = (HANDLE)_beginthreadex(nullptr, 0, pThreadProc, pContext, CREATE_SUSPENDED, nullptr);
+	if (!pEntry->hThread)
+	{
+		DxTraceMsg("%s Failed to create thread for channel %d.\n", __FUNCTION__, nChannel);
+		delete pEntry;
+		return false;
+	}
+	if (!RegisterWaitForSingleObject(&pEntry->hWait, pEntry->hThread, OnThreadExit, pEntry, INFINITE, WT_EXECUTEONLYONCE))
+	{
+		DxTraceMsg("%s RegisterWaitForSingleObject failed for channel %d,Error = %d.\n", __FUNCTION__, nChannel, GetLastError());
+		if (m_pStopProc)
+			m_pStopProc(nChannel, pContext, m_pUserPtr);
+		ResumeThread(pEntry->hThread);
+		WaitForSingleObject(pEntry->hThread, INFINITE);
+		CloseHandle(pEntry->hThread);
+		delete pEntry;
+		return false;
+	}
+	pEntry->nState = bSuspended ? Channel_Suspended : Channel_Running;
+	m_listChannel.push_back(pEntry);
+	if (InterlockedIncrement(&m_nAlive) == 1)
+		ResetEvent(m_hEventIdle);
+	if (!bSuspended)
+		ResumeThread(pEntry->hThread);
+	m_Stat.nAdded++;
+	int64_t nSpan = MonoTimeNs() - nT1;
+	if (nSpan > m_Stat.nMaxAddNs)
+		m_Stat.nMaxAddNs = nSpan;
+	return true;
+}
+
+int CChannelLifecycle::ResumeAll()
+{
+	int nResumed = 0;
+	MUTEX_LOCK(m_csChannel);
+	for (auto it = m_listChannel.begin(); it != m_listChannel.end(); it++)
+	{
+		if ((*it)->nState != Channel_Suspended)
+			continue;
+		(*it)->nState = Channel_Running;
+		ResumeThread((*it)->hThread);
+		nResumed++;
+	}
+	return nResumed;
+}
+
+bool CChannelLifecycle::Remove(void *pContext)
+{
+	MUTEX_LOCK(m_csChannel);
+	auto itFind = Find(pContext);
+	if (itFind == m_listChannel.end())
+		return false;
+	ChannelEntry *pEntry = *itFind;
+	if (pEntry->nState == Channel_Stopping || pEntry->nState == Channel_Stopped)
+		return true;
+	Stop(pEntry);
+	m_Stat.nRemoved++;
+	return true;
+}
+
+bool CChannelLifecycle::Reap(void *pContext)
+{
+	ChannelEntry *pEntry = NULL;
+	{
+		MUTEX_LOCK(m_csChannel);
+		auto itFind = Find(pContext);
+		if (itFind == m_listChannel.end() || (*itFind)->nState != Channel_Stopped)
+			return false;
+		pEntry = *itFind;
+		m_listChannel.erase(itFind);
+	}
+	Release(pEntry);
+	return true;
+}
+
+bool CChannelLifecycle::Shutdown(DWORD dwTimeout)
+{
+	int64_t nT1 = MonoTimeNs();
+	InterlockedExchange(&m_bShutdown, TRUE);
+	int nChannels = 0;
+	{
+		MUTEX_LOCK(m_csChannel);
+		nChannels = (int)m_listChannel.size();
+		for (auto it = m_listChannel.begin(); it != m_listChannel.end(); it++)
+		{
+			if ((*it)->nState == Channel_Suspended || (*it)->nState == Channel_Running)
+				Stop(*it);
+		}
+	}
+	bool bAllExited = WaitForSingleObject(m_hEventIdle, dwTimeout) == WAIT_OBJECT_0;
+	int64_t nT2 = MonoTimeNs();
+	vector<ChannelEntry *> vecStopped;
+	{
+		MUTEX_LOCK(m_csChannel);
+		for (auto it = m_listChannel.begin(); it != m_listChannel.end();)
+		{
+			if ((*it)->nState == Channel_Stopped)
+			{
+				vecStopped.push_back(*it);
+				it = m_listChannel.erase(it);
+			}
+			else
+				it++;
+		}
+	}
+	// עȴʱȴص,ܳ
+	for (auto it = vecStopped.begin(); it != vecStopped.end(); it++)
+		Release(*it);
+	InterlockedExchange(&m_bShutdown, FALSE);
+	if (nChannels)
+		DxTraceMsg("%s Channels = %d\tAlive = %d\tDrain = %.3fms\tReap = %.3fms.\n", __FUNCTION__,
+					nChannels, m_nAlive, MonoNsToMs(nT2 - nT1), MonoNsToMs(MonoTimeNs() - nT2));
+	return bAllExited;
+}
+
+void CChannelLifecycle::GetStat(ChannelLifecycleStat &Stat)
+{
+	MUTEX_LOCK(m_csChannel);
+	Stat = m_Stat;
+	Stat.nAlive = m_nAlive;
+}
+
+void CChannelLifecycle::TraceStat()
+{
+	ChannelLifecycleStat Stat;
+	GetStat(Stat);
+	LONG nDrained = Stat.nRemoved < Stat.nExited ? Stat.nRemoved : Stat.nExited;
+	DxTraceMsg("%s Added = %d\tRemoved = %d\tExited = %d\tAlive = %d\tMaxAdd = %.3fms\tDrain(Avg = %.3fms,Max = %.3fms).\n", __FUNCTION__,
+				Stat.nAdded, Stat.nRemoved, Stat.nExited, Stat.nAlive, MonoNsToMs(Stat.nMaxAddNs),
+				nDrained ? MonoNsToMs(Stat.nDrainNs) / nDrained : 0.0f, MonoNsToMs(Stat.nMaxDrainNs));
+}
+
+// ̳߳ص߳е,ʱ߿Shutdownеȴ,ܵκοܵȴߵĺ
+VOID CALLBACK CChannelLifecycle::OnThreadExit(PVOID pParam, BOOLEAN bTimeout)
+{
+	ChannelEntry *pEntry = (ChannelEntry *)pParam;
+	CChannelLifecycle *pThis = pEntry->pOwner;
+	int nChannel = pEntry->nChannel;
+	void *pContext = pEntry->pContext;
+	{
+		MUTEX_LOCK(pThis->m_csChannel);
+		if (pEntry->nStopTime)
+		{
+			int64_t nDrainNs = MonoTimeNs() - pEntry->nStopTime;
+			pThis->m_Stat.nDrainNs += nDrainNs;
+			if (nDrainNs > pThis->m_Stat.nMaxDrainNs)
+				pThis->m_Stat.nMaxDrainNs = nDrainNs;
+		}
+		pEntry->nState = Channel_Stopped;
+		pThis->m_Stat.nExited++;
+		if (InterlockedDecrement(&pThis->m_nAlive) == 0)
+			SetEvent(pThis->m_hEventIdle);
+	}
+	if (!pThis->m_bShutdown && pThis->m_pExitProc)
+		pThis->m_pExitProc(nChannel, pContext, pThis->m_pUserPtr);
+}
+
+CChannelLifecycle::ChannelList::iterator CChannelLifecycle::Find(void *pContext)
+{
+	for (auto it = m_listChannel.begin(); it != m_listChannel.end(); it++)
+	{
+		if ((*it)->pContext == pContext)
+			return it;
+	}
+	return m_listChannel.end();
+}
+
+// ڳm_csChannelʱ
+void CChannelLifecycle::Stop(ChannelEntry *pEntry)
+{
+	pEntry->nStopTime = MonoTimeNs();
+	if (m_pStopProc)
+		m_pStopProc(pEntry->nChannel, pEntry->pContext, m_pUserPtr);
+	if (pEntry->nState == Channel_Suspended)
+		ResumeThread(pEntry->hThread);
+	pEntry->nState = Channel_Stopping;
+}
+
+void CChannelLifecycle::Release(ChannelEntry *pEntry)
+{
+	// INVALID_HANDLE_VALUE:ȴִеĻصغע,˺صٷpEntry
+	UnregisterWaitEx(pEntry->hWait, INVALID_HANDLE_VALUE);
+	CloseHandle(pEntry->hThread);
+	delete pEntry;
+}
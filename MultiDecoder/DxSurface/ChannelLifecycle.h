@@ -0,0 +1,107 @@
+#pragma once
+#include "Win32Port.h"
+#include <list>
+#include "AdaptiveLock.h"
+#include "DxTrace.h"
+#include "MonoClock.h"
+
+using namespace std;
+
+// ̵̺ͨ߳߳,_beginthreadex̺߳ͬ
+typedef UINT (__stdcall *ChannelThreadProc)(void *pContext);
+// ֪ͨͨ߳˳,ֻ˳־,ܵȴ߳˳
+typedef void (CALLBACK *ChannelStopProc)(int nChannel, void *pContext, void *pUserPtr);
+// ͨ߳˳̳߳ص߳е,ܷʽ,һֻ߳ͶϢ,ɽ̵߳Reapͨ
+typedef void (CALLBACK *ChannelExitProc)(int nChannel, void *pContext, void *pUserPtr);
+
+enum ChannelState
+{
+	Channel_Suspended = 0,	// ߳Ѵ,δʼ
+	Channel_Running,
+	Channel_Stopping,		// ֪ͨ߳˳,߳
+	Channel_Stopped			// ߳˳,ȴ
+};
+
+struct ChannelLifecycleStat
+{
+	LONG		nAdded;			// ӵͨ
+	LONG		nRemoved;		// Ƴͨ
+	LONG		nExited;		// ˳ͨ߳,δƳ˳߳
+	int			nAlive;			// еͨ߳
+	int64_t		nMaxAddNs;		// һͨʱ,λ
+	int64_t		nMaxDrainNs;	// ֪ͨ˳߳˳ʱ,λ
+	int64_t		nDrainNs;		// ֪ͨ˳߳˳ۼʱ,λ
+};
+
+/// @brief ̵ͨ߳ڹ
+/// @remark ÿͨ߳˳ʱRegisterWaitForSingleObject̳߳еõ֪ͨ,ӺƳͨ,
+/// ڽ߳еȴ߳˳,ҲûWaitForMultipleObjectsһ64;
+/// ̵ָͨ߳ʶ,ͬһŵͨھ߳˳֮ǰٴ;
+/// ͨ߳˳ȽChannel_Stopped״̬,ߵReapرվ,ͷ,еĽ״̬Իոµͨ
+/// ShutdownReap,зκ߳е
+class CChannelLifecycle
+{
+public:
+	CChannelLifecycle();
+	~CChannelLifecycle();
+
+	// ֪ͨ˳˳Ļص,֮ͨǰ
+	void SetCallback(ChannelStopProc pStopProc, ChannelExitProc pExitProc, void *pUserPtr);
+
+	/// @brief ͨ߳
+	/// @param nChannel		ͨ,ֻڻصͳ
+	/// @param pContext		̲߳,ͬʱΪͨıʶ,δյͨͬ
+	/// @param bSuspended	Ϊtrueʱ̴߳,ResumeAllͳһʼ
+	bool Add(int nChannel, ChannelThreadProc pThreadProc, void *pContext, bool bSuspended = false);
+
+	// ʼйͨ߳,ؿʼе߳
+	int ResumeAll();
+
+	/// @brief ֪ͨͨ߳˳,
+	/// @remark ߳˳˳ص,߳ȿʼ,Ա˳־
+	bool Remove(void *pContext);
+
+	/// @brief ˳ͨ,ر߳̾עȴ
+	/// @return ͨ߳δ˳򲻴ʱfalse,ʱͷ
+	bool Reap(void *pContext);
+
+	/// @brief ֪ͨͨ߳˳,һ¼ϵȴȫ˳ͨ
+	/// @remark رڼ߳˳ʱٵ˳ص
+	/// @return ʱ߳δ˳ʱfalse,Щͨ
+	bool Shutdown(DWORD dwTimeout = INFINITE);
+
+	// еͨ߳
+	int GetAliveCount()
+	{
+		return m_nAlive;
+	}
+	void GetStat(ChannelLifecycleStat &Stat);
+	void TraceStat();
+private:
+	struct ChannelEntry
+	{
+		CChannelLifecycle	*pOwner;
+		int					nChannel;
+		void				*pContext;
+		HANDLE				hThread;
+		HANDLE				hWait;			// RegisterWaitForSingleObjectصĵȴ
+		ChannelState		nState;
+		int64_t				nStopTime;		// ֪ͨ˳ʱ,λ
+	};
+	typedef list<ChannelEntry *> ChannelList;
+
+	static VOID CALLBACK OnThreadExit(PVOID pParam, BOOLEAN bTimeout);
+	ChannelList::iterator Find(void *pContext);
+	void Stop(ChannelEntry *pEntry);
+	static void Release(ChannelEntry *pEntry);
+
+	ChannelList			m_listChannel;
+	CSpinMutex			m_csChannel;
+	HANDLE				m_hEventIdle;		// ˹λ¼,ûеͨ߳ʱλ
+	volatile LONG		m_nAlive;
+	volatile LONG		m_bShutdown;
+	ChannelStopProc		m_pStopProc;
+	ChannelExitProc		m_pExitProc;
+	void				*m_pUserPtr;
+	ChannelLifecycleStat m_Stat;
+};
@@ -0,0 +1,143 @@
+#include "ChannelPriority.h"
+#include <algorithm>
+
+using namespace std;
+
+CLoadShedder g_LoadShedder;
+
+static const char *szPriorityName[ChannelPriority_Count] = { "Background", "Visible", "Selected" };
+
+CLoadShedder::CLoadShedder()
+{
+	m_nLevel = 0;
+	m_nForceLevel = -1;
+	m_bEvaluating = FALSE;
+	m_nLastCheck = 0;
+	m_nLastIdle = 0;
+	m_nLastTotal = 0;
+	m_nPaced = 0;
+	m_nLate = 0;
+	ZeroMemory(&m_Stat, sizeof(LoadShedderStat));
+}
+
+AVDiscard CLoadShedder::GetDiscard(ChannelPriority nPriority)
+{
+	if (nPriority < ChannelPriority_Background || nPriority >= ChannelPriority_Count)
+		nPriority = ChannelPriority_Background;
+	if (MonoTimeNs() - m_nLastCheck >= _SHED_CHECK_INTERVAL * MONO_NS_PER_MS)
+		Evaluate();
+	AVDiscard nDiscard = GetDiscard(nPriority, GetLevel());
+	InterlockedIncrement(&m_Stat.nFrames[nPriority]);
+	if (nDiscard != AVDISCARD_DEFAULT)
+		InterlockedIncrement(&m_Stat.nShed[nPriority]);
+	return nDiscard;
+}
+
+void CLoadShedder::ReportLate(int64_t nLateNs, int64_t nIntervalNs)
+{
+	InterlockedIncrement(&m_nPaced);
+	if (nLateNs > nIntervalNs)
+		InterlockedIncrement(&m_nLate);
+}
+
+void CLoadShedder::Reset()
+{
+	InterlockedExchange(&m_nLevel, 0);
+	InterlockedExchange(&m_nPaced, 0);
+	InterlockedExchange(&m_nLate, 0);
+	InterlockedExchange64(&m_nLastCheck, 0);
+	m_nLastIdle = 0;
+	m_nLastTotal = 0;
+	ZeroMemory(&m_Stat, sizeof(LoadShedderStat));
+}
+
+void CLoadShedder::GetStat(LoadShedderStat &Stat)
+{
+	memcpy(&Stat, &m_Stat, sizeof(LoadShedderStat));
+}
+
+void CLoadShedder::TraceStat()
+{
+	LoadShedderStat Stat;
+	GetStat(Stat);
+	DxTraceMsg("%s Level = %d\tLevelChanges = %d.\n", __FUNCTION__, GetLevel(), Stat.nLevelChanges);
+	for (int i = ChannelPriority_Count - 1; i >= 0; i--)
+		DxTraceMsg("%s %-10s Frames = %d\tShed = %d(%.2f%%).\n", __FUNCTION__, szPriorityName[i],
+					Stat.nFrames[i], Stat.nShed[i], Stat.nFrames[i] ? (double)Stat.nShed[i] * 100 / Stat.nFrames[i] : 0.0f);
+}
+
+int CLoadShedder::GetThreadPriority(ChannelPriority nPriority)
+{
+	switch (nPriority)
+	{
+	case ChannelPriority_Selected:
+		return THREAD_PRIORITY_ABOVE_NORMAL;
+	case ChannelPriority_Visible:
+		return THREAD_PRIORITY_NORMAL;
+	default:
+		return THREAD_PRIORITY_BELOW_NORMAL;
+	}
+}
+
+AVDiscard CLoadShedder::GetDiscard(ChannelPriority nPriority, int nLevel)
+{
+	if (nPriority == ChannelPriority_Selected || nLevel <= 0)
+		return AVDISCARD_DEFAULT;
+	if (nPriority == ChannelPriority_Visible)
+		return nLevel >= 2 ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+	return nLevel >= 2 ? AVDISCARD_NONKEY : AVDISCARD_NONREF;
+}
+
+// ȷѵִ߳,̼߳ʹԭĵȼ
+void CLoadShedder::Evaluate()
+{
+	if (InterlockedCompareExchange(&m_bEvaluating, TRUE, FALSE) != FALSE)
+		return;
+	int64_t nNow = MonoTimeNs();
+	if (nNow - m_nLastCheck < _SHED_CHECK_INTERVAL * MONO_NS_PER_MS)
+	{
+		InterlockedExchange(&m_bEvaluating, FALSE);
+		return;
+	}
+	InterlockedExchange64(&m_nLastCheck, nNow);
+	int nCPU = GetCPUUsage();
+	LONG nPaced = InterlockedExchange(&m_nPaced, 0);
+	LONG nLate = InterlockedExchange(&m_nLate, 0);
+	int nLatePercent = nPaced ? nLate * 100 / nPaced : 0;
+	int nLevel = m_nLevel;
+	if (nCPU >= 95 || nLatePercent >= 25)
+		nLevel = min(nLevel + 1, _SHED_LEVEL_MAX);
+	else if (nCPU >= 85 || nLatePercent >= 5)
+		nLevel = max(nLevel, 1);
+	else if (nCPU < 75 && nLatePercent < 2)
+		nLevel = max(nLevel - 1, 0);
+	if (nLevel != m_nLevel)
+	{
+		DxTraceMsg("%s Shed level %d -> %d(CPU = %d%%,Late = %d%% of %d).\n", __FUNCTION__, m_nLevel, nLevel, nCPU, nLatePercent, nPaced);
+		InterlockedExchange(&m_nLevel, nLevel);
+		InterlockedIncrement(&m_Stat.nLevelChanges);
+	}
+	InterlockedExchange(&m_bEvaluating, FALSE);
+}
+
+// ϴϵͳCPUռðٷֱ,ֻEvaluateе
+int CLoadShedder::GetCPUUsage()
+{
+#ifndef _WIN32
+	return 0;
+#else
+	FILETIME ftIdle, ftKernel, ftUser;
+	if (!GetSystemTimes(&ftIdle, &ftKernel, &ftUser))
+		return 0;
+	ULONGLONG nIdle = ((ULONGLONG)ftIdle.dwHighDateTime << 32) | ftIdle.dwLowDateTime;
+	// ںʱʱ
+	ULONGLONG nTotal = (((ULONGLONG)ftKernel.dwHighDateTime << 32) | ftKernel.dwLowDateTime) +
+						(((ULONGLONG)ftUser.dwHighDateTime << 32) | ftUser.dwLowDateTime);
+	int nUsage = 0;
+	if (m_nLastTotal && nTotal > m_nLastTotal)
+		nUsage = (int)(100 - (nIdle - m_nLastIdle) * 100 / (nTotal - m_nLastTotal));
+	m_nLastIdle = nIdle;
+	m_nLastTotal = nTotal;
+	return nUsage;
+#endif
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include "Win32Port.h"
+#include "DxTrace.h"
+#include "MonoClock.h"
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define __STDC_CONSTANT_MACROS
+#include "libavcodec/avcodec.h"
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+
+#define _SHED_CHECK_INTERVAL	500		// صļ,λ
+#define _SHED_LEVEL_MAX			2
+
+// ͨȼ,ֵԽԽ
+enum ChannelPriority
+{
+	ChannelPriority_Background = 0,	// ûʾκϵͨ,ʱȶ֡
+	ChannelPriority_Visible,		// ʾϵͨ
+	ChannelPriority_Selected,		// Աѡеϵͨ,ʼȫ֡ʽ
+	ChannelPriority_Count
+};
+
+struct LoadShedderStat
+{
+	LONG	nFrames[ChannelPriority_Count];		// ȼ֡
+	LONG	nShed[ChannelPriority_Count];		// ȼض֡
+	LONG	nLevelChanges;						// صȼı仯
+};
+
+/// @brief ͨȼּ֡Ĺر
+/// @remark ÿ_SHED_CHECK_INTERVAL밴ϵͳCPUռú͸ͨĽӳһιصȼ,ȼ½лز,л;
+/// ȼ1ʱֻ̨ͨο֡,ȼ2ʱֻ̨ͨؼ֡,ɼֻͨο֡,ѡеͨκεȼ֡;
+/// ͬʱȼĽȾ߳ʹòͬ߳ȼ,CPUʱ̨ͨó
+/// ƽ̨²ȡϵͳCPUռ,ֻӳ
+/// зκ߳е
+class CLoadShedder
+{
+public:
+	CLoadShedder();
+
+	/// @brief ȡøȼͨڵǰصȼµĶ֡ʽ,ͳ
+	/// @remark ÿݰһ,ϴ_SHED_CHECK_INTERVALʱɵ߳صȼ
+	AVDiscard GetDiscard(ChannelPriority nPriority);
+
+	/// @brief 水̶Ľͨĵӳ,صȼ
+	/// @param nLateNs	CMonoPacer::Waitķֵ
+	void ReportLate(int64_t nLateNs, int64_t nIntervalNs);
+
+	int GetLevel()
+	{
+		return m_nForceLevel >= 0 ? m_nForceLevel : m_nLevel;
+	}
+	// ̶صȼ,ڲ,Ϊ-1ʱָ
+	void ForceLevel(int nLevel)
+	{
+		InterlockedExchange(&m_nForceLevel, nLevel);
+	}
+	void Reset();
+	void GetStat(LoadShedderStat &Stat);
+	void TraceStat();
+
+	// ȼͨ߳ʹõ߳ȼ
+	static int GetThreadPriority(ChannelPriority nPriority);
+	static AVDiscard GetDiscard(ChannelPriority nPriority, int nLevel);
+private:
+	void Evaluate();
+	int GetCPUUsage();
+
+	volatile LONG		m_nLevel;
+	volatile LONG		m_nForceLevel;
+	volatile LONG		m_bEvaluating;
+	volatile LONGLONG	m_nLastCheck;		// ϴʱ,λ
+	volatile LONG		m_nPaced;			// ڱĽ
+	volatile LONG		m_nLate;			// ӳٳһĵ
+	ULONGLONG			m_nLastIdle;		// ϴʱGetSystemTimesۼʱ,λ100
+	ULONGLONG			m_nLastTotal;
+	LoadShedderStat		m_Stat;
+};
+
+extern CLoadShedder g_LoadShedder;
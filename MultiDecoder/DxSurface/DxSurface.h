@@ -13,6 +13,18 @@
 #include "gpu_memcpy_sse4.h"
 #include "DxTrace.h"
 #include "AutoLock.h"
+#include "SwsContextCache.h"
+#include "FramePool.h"
+#include "HighBitdepth.h"
+#include "PixelCopy.h"
+#include "RenderSurface.h"
+#include "SnapshotService.h"
+#include "RenderThrottle.h"
+#include "LatencyHistogram.h"
+#include "TimelineTrace.h"
+#include "MemoryAccount.h"
+#include "MonoClock.h"
+#include "AdaptiveLock.h"
 #ifdef _DEBUG
 #include "TimeUtility.h"
 #endif
@@ -108,41 +120,8 @@ struct DxSurfaceRenderInfo
 	AVFrame		*pAvFrame;
 };
 class CDxSurface;
-class CriticalSectionWrap;
 typedef map<HWND,CDxSurface*> WndSurfaceMap;
-typedef shared_ptr<CriticalSectionWrap>CriticalSectionPtr;
 typedef void (CALLBACK *ExternDrawProc)(HANDLE handle,HDC hDc,RECT rt,LONG nUser);
-class CriticalSectionWrap
-{
-public:
-	CriticalSectionWrap()
-	{
-		InitializeCriticalSection(&m_cs);
-	}
-	~CriticalSectionWrap()
-	{
-		DeleteCriticalSection(&m_cs);
-	}
-	inline BOOL TryLock()
-	{
-		return TryEnterCriticalSection(&m_cs);
-	}
-	inline void Lock()
-	{
-		EnterCriticalSection(&m_cs);
-	}
-	void Unlock()
-	{
-		LeaveCriticalSection(&m_cs);
-	}
-	inline CRITICAL_SECTION *Get()
-	{
-		return &m_cs;
-	}
-	
-private:
-	CRITICAL_SECTION	m_cs;
-};
 
 enum GraphicQulityParameter
 {
@@ -159,71 +138,20 @@ enum GraphicQulityParameter
 	GQ_POINT			//427		ϸڱȽͼЧͼԲһ㡣
 };
 
-#define _TraceMemory
-
-#if defined(_DEBUG) && defined(_TraceMemory)
-#define TraceMemory()	CTraceMemory Tx(__FUNCTION__);
-#else 
-#define TraceMemory()	
-#endif
-
 #ifndef _CRT_SECURE_NO_WARNINGS
 #define _CRT_SECURE_NO_WARNINGS
 #endif
 
-#include <windows.h>
-#include <psapi.h>
-#pragma comment(lib,"psapi.lib")
-
-class CTraceMemory
-{
-	explicit CTraceMemory(){};
-public:
-	CTraceMemory(CHAR *szFunction, bool bDeconstructOut = true)
-	{
-		m_bDeconstructOut = bDeconstructOut;
-		HANDLE handle = GetCurrentProcess();
-		PROCESS_MEMORY_COUNTERS pmc;
-		GetProcessMemoryInfo(handle, &pmc, sizeof(pmc));
-		CloseHandle(handle);
-		m_nMemoryCount = pmc.WorkingSetSize / 1024;
-		strcpy_s(m_szFunction, 256, szFunction);
-		CHAR szText[1024] = { 0 };
-		sprintf_s(szText, 1024, "CTraceMemory\t_IN_ %s \tMemory = %d KB.\n", szFunction, m_nMemoryCount);
-		//OutputDebugStringA(szText);
-	}
-	~CTraceMemory()
-	{
-		if (m_bDeconstructOut)
-		{
-			CHAR szText[1024] = { 0 };
-			HANDLE handle = GetCurrentProcess();
-			PROCESS_MEMORY_COUNTERS pmc;
-			GetProcessMemoryInfo(handle, &pmc, sizeof(pmc));
-			CloseHandle(handle);
-			m_nMemoryCount = pmc.WorkingSetSize / 1024;
-			sprintf_s(szText, 1024, "CTraceMemory\t_OUT_ %s \tMemory = %d KB.\n", m_szFunction, m_nMemoryCount);
-			//OutputDebugStringA(szText);
-		}
-	}
-private:
-	INT		m_nMemoryCount;
-	bool	m_bDeconstructOut;
-	CHAR	m_szFile[MAX_PATH];
-	CHAR	m_szFunction[256];
-};
-
 // FFMPEGתΪD3DFomrat
+// תȡg_SwsContextCache,ͬĶ·תͬһ,ͼȡg_FramePool
 struct PixelConvert
 {
 private:
 	explicit PixelConvert()
 	{
 	}
-	SwsContext	*pConvertCtx;	
+	SwsContextKey	SwsKey;
 	GraphicQulityParameter	nGQP;
-	int		nScaleFlag;
-// 	int		nSrcImageWidth,nSrcImageHeight;
  	AVPixelFormat nDstAvFormat;	
 public:
 	int nImageSize;
@@ -260,74 +188,35 @@ public:
 			break;
 		}
 		
-		pFrameNew = av_frame_alloc();
-		nImageSize	 = av_image_get_buffer_size(nDstAvFormat, pSrcFrame->width,pSrcFrame->height,8); 
+		nImageSize	 = av_image_get_buffer_size(nDstAvFormat, pSrcFrame->width,pSrcFrame->height,FRAMEPOOL_ALIGN); 
 		if (nImageSize < 0)
 		{
 			char szAvError[256] = {0};
-			av_strerror(nImageSize, szAvError, 1024);
+			av_strerror(nImageSize, szAvError, 256);
 			DxTraceMsg("%s av_image_get_buffer_size failed:%s.\n",__FUNCTION__,szAvError);
 			assert(false);
 		}
-		pImage		 =	new byte[nImageSize];
-		DxTraceMsg("%s Image size = %d.\n",__FUNCTION__,nImageSize);
-		// ʾͼYUV֡
-		av_image_fill_arrays(pFrameNew->data,pFrameNew->linesize, pImage, nDstAvFormat, pSrcFrame->width,pSrcFrame->height,8);
-		pFrameNew->width	 = pSrcFrame->width;
-		pFrameNew->height	 = pSrcFrame->height;
-		pFrameNew->format	 = nDstAvFormat;
-		nGQP = nGQ;
-		switch(nGQP)
+		// ͼȡ֡,ͷʱԶ黹
+		pFrameNew = g_FramePool.GetFrame(nDstAvFormat,pSrcFrame->width,pSrcFrame->height,MemTag_Convert);
+		if (!pFrameNew)
 		{
-		default:
-		case GQ_BICUBIC:
-			nScaleFlag = SWS_BICUBIC;
-			break;
-		case GQ_SINC:
-			nScaleFlag = SWS_SINC;
-			break;
-		case GQ_SPLINE:
-			nScaleFlag = SWS_SPLINE;
-			break;
-		case GQ_LANCZOS:
-			nScaleFlag = SWS_LANCZOS;
-			break;			
-		case GQ_GAUSS:
-			nScaleFlag = SWS_GAUSS;
-			break;
-		case GQ_BICUBLIN:
-			nScaleFlag = SWS_BICUBLIN;
-			break;
-		case GQ_X:
-			nScaleFlag = SWS_X;
-			break;
-		case GQ_BILINEAR:
-			nScaleFlag = SWS_BILINEAR;
-			break;
-		case GQ_AREA:
-			nScaleFlag = SWS_AREA;
-			break;
-		case GQ_FAST_BILINEAR:
-			nScaleFlag = SWS_FAST_BILINEAR;
-			break;
-		case GQ_POINT:
-			nScaleFlag = SWS_POINT;
-			break;
+			DxTraceMsg("%s Failed to get a image buffer of %d bytes.\n",__FUNCTION__,nImageSize);
+			assert(false);
+			return;
 		}
-		
-// 		nDstAvFormat = nDstFormat;
-// 		nSrcImageWidth = nImageWidth;
-// 		nSrcImageHeight = nImageHeight;
-		pConvertCtx = sws_getContext(pSrcFrame->width,					// src Width
-									pSrcFrame->height,					// src Height
-									(AVPixelFormat)pSrcFrame->format,	// src format
-									pSrcFrame->width,					// dst Width
-									pSrcFrame->height,					// dst Height
-									nDstAvFormat,					// dst format
-									nScaleFlag, 
-									NULL, 
-									NULL, 
-									NULL);
+		pImage		 =	pFrameNew->data[0];
+		DxTraceMsg("%s Image size = %d.\n",__FUNCTION__,nImageSize);
+		nGQP = nGQ;
+
+		SwsKey.nSrcWidth	 = pSrcFrame->width;
+		SwsKey.nSrcHeight	 = pSrcFrame->height;
+		SwsKey.nSrcFormat	 = (AVPixelFormat)pSrcFrame->format;
+		SwsKey.nDstWidth	 = pSrcFrame->width;
+		SwsKey.nDstHeight	 = pSrcFrame->height;
+		SwsKey.nDstFormat	 = nDstAvFormat;
+		SwsKey.nFlags		 = GetScaleFlag(nGQP);
+		// Ԥò黹һΣʹתڵһ֮֡ǰڻо
+		g_SwsContextCache.Release(SwsKey, g_SwsContextCache.Acquire(SwsKey));
 
 		/*		
 		sws_scaleת㷨ת(С)ЧʺͻʶԱ(ο:http://blog.csdn.net/leixiaohua1020/article/details/12029505)
@@ -364,83 +253,65 @@ public:
 			Ȼٶ׷㷨Уѡ֡͵ǸɣЧ
 			һõġ
 		*/
-
 	}
 	~PixelConvert()
 	{
-		delete []pImage;
 		pImage = NULL;
-		av_free(pFrameNew);
-		pFrameNew = NULL;
-		sws_freeContext(pConvertCtx);
-		pConvertCtx = NULL;
+		av_frame_free(&pFrameNew);		// 黹֡
 		DxTraceMsg("%s FreeImage size %d.\n",__FUNCTION__,nImageSize);
 	}
+
+	static int GetScaleFlag(GraphicQulityParameter nGQ)
+	{
+		switch(nGQ)
+		{
+		default:
+		case GQ_BICUBIC:
+			return SWS_BICUBIC;
+		case GQ_SINC:
+			return SWS_SINC;
+		case GQ_SPLINE:
+			return SWS_SPLINE;
+		case GQ_LANCZOS:
+			return SWS_LANCZOS;
+		case GQ_GAUSS:
+			return SWS_GAUSS;
+		case GQ_BICUBLIN:
+			return SWS_BICUBLIN;
+		case GQ_X:
+			return SWS_X;
+		case GQ_BILINEAR:
+			return SWS_BILINEAR;
+		case GQ_AREA:
+			return SWS_AREA;
+		case GQ_FAST_BILINEAR:
+			return SWS_FAST_BILINEAR;
+		case GQ_POINT:
+			return SWS_POINT;
+		}
+	}
+
 	// ת
+	// ת㷨ʱֻı仺ֵٲؽת
 	int inline ConvertPixel(AVFrame *pSrcFrame,GraphicQulityParameter nGQ = GQ_BICUBIC)
 	{
 		if (nGQP != nGQ)
 		{
-			// ת㷨
-			sws_freeContext(pConvertCtx);
-			pConvertCtx = NULL;
 			nGQP = nGQ;
-			switch(nGQP)
-			{
-			default:
-			case GQ_BICUBIC:
-				nScaleFlag = SWS_BICUBIC;
-				break;
-			case GQ_SINC:
-				nScaleFlag = SWS_SINC;
-				break;
-			case GQ_SPLINE:
-				nScaleFlag = SWS_SPLINE;
-				break;
-			case GQ_LANCZOS:
-				nScaleFlag = SWS_LANCZOS;
-				break;			
-			case GQ_GAUSS:
-				nScaleFlag = SWS_GAUSS;
-				break;
-			case GQ_BICUBLIN:
-				nScaleFlag = SWS_BICUBLIN;
-				break;
-			case GQ_X:
-				nScaleFlag = SWS_X;
-				break;
-			case GQ_BILINEAR:
-				nScaleFlag = SWS_BILINEAR;
-				break;
-			case GQ_AREA:
-				nScaleFlag = SWS_AREA;
-				break;
-			case GQ_FAST_BILINEAR:
-				nScaleFlag = SWS_FAST_BILINEAR;
-				break;
-			case GQ_POINT:
-				nScaleFlag = SWS_POINT;
-				break;
-			}
-			pConvertCtx = sws_getContext(pSrcFrame->width,					// src Width
-										pSrcFrame->height,					// src Height
-										(AVPixelFormat)pSrcFrame->format,	// src format
-										pSrcFrame->width,					// dst Width
-										pSrcFrame->height,					// dst Height
-										nDstAvFormat,					// dst format
-										nScaleFlag, 
-										NULL, 
-										NULL, 
-										NULL);
+			SwsKey.nFlags = GetScaleFlag(nGQP);
 		}
-		return sws_scale(pConvertCtx,
+		SwsContext *pConvertCtx = g_SwsContextCache.Acquire(SwsKey);
+		if (!pConvertCtx)
+			return -1;
+		int nResult = sws_scale(pConvertCtx,
 						(const byte * const *)pSrcFrame->data,
 						pSrcFrame->linesize,
 						0,
 						pSrcFrame->height,
 						pFrameNew->data,
 						pFrameNew->linesize);
-
+		g_SwsContextCache.Release(SwsKey, pConvertCtx);
+		return nResult;
 	}
 	inline AVPixelFormat GetDestPixelFormat()
 	{
@@ -452,12 +323,12 @@ typedef IDirect3D9* WINAPI pDirect3DCreate9(UINT);
 typedef IDirect3D9Ex* WINAPI pDirect3DCreate9Ex(UINT);
 // ע:
 //		ʹCDxSurfaceʾͼʱڴ߳ʾͼ򵱷DirectX豸ʧʱ޷DirectXԴ
-class CDxSurface
+class CDxSurface :public IRenderSurface
 {
 protected:	
 	long					m_nVtableAddr;		// 麯ַñַλ麯֮󣬽ʼƶñλ
 	D3DPRESENT_PARAMETERS	m_d3dpp;
-	CRITICAL_SECTION		m_csRender;			// Ⱦٽ
+	CSpinMutex				m_csRender;			// Ⱦٽ
 	bool					m_bD3DShared;		// IDirect3D9ӿǷΪ 	
 	/*HWND					m_hWnd;*/
 	DWORD					m_dwExStyle;
@@ -466,7 +337,6 @@ protected:
 	WINDOWPLACEMENT			m_WndPlace;
 	HMENU					m_hMenu;
 	IDirect3DSurface9		*m_pDirect3DSurfaceRender/* = NULL*/;
-	IDirect3DSurface9		*m_pSnapshotSurface;	/* = NULL*/;	//ͼרñ
 	D3DFORMAT				m_nD3DFormat;
 	UINT					m_nVideoWidth;
 	UINT					m_nVideoHeight;
@@ -477,8 +347,14 @@ protected:
 	shared_ptr<PixelConvert>m_pPixelConvert;
 	IDirect3D9				*m_pDirect3D9		/* = NULL*/;
 	IDirect3DDevice9		*m_pDirect3DDevice	/*= NULL*/;	
-	HANDLE					m_hEventCreateSurface;// ͼ洴¼
-	HANDLE					m_hEventCopySurface;// ݸ¼
+	IDirect3DSwapChain9		*m_pSwapChain;		// 豸ʱ,ڹõ豸ΪʾڴĽ
+	AVFrame					*m_pHoldFrame;		// 豸ʱ,ʾӲ֡,֤һ֡ʾ֮ǰ
+	volatile LONG			m_nSnapshotPending;	// нͼȴһ֡
+	CRenderThrottle			m_RenderThrottle;	// ʾ֡ʿ,ȫΪ0Ϊʼ״̬
+	CChannelLatency			*m_pLatency;		// ׶ӳٵֱͼ,ΪNULLʱ¼
+	IDirect3DSurface9		*m_pAccountedSurface;	// Ѽg_MemoryAccountʾ漰ֽ
+	LONGLONG				m_nSurfaceBytes;
+	int						m_nMemoryChannel;
 	// ⲿƽӿڣṩⲿӿڣ÷лͼ
 	ExternDrawProc			m_pExternDraw;
 	long					m_nUserPtr;			// ⲿԶָ
@@ -495,7 +371,7 @@ private:
 	float					m_fWHScale;	
 	WNDPROC					m_pOldWndProc;
 	static WndSurfaceMap	m_WndSurfaceMap;
-	static CriticalSectionPtr m_WndSurfaceMapcs;
+	static CRWLock			m_WndSurfaceMapLock;
 	bool					m_bWndSubclass;		// Ƿ໯ʾ,Ϊtureʱʾ໯,ʱϢȱCDxSurface::WndProcȴ,ɴں
 	pDirect3DCreate9*		m_pDirect3DCreate9;
 public:
@@ -503,7 +379,6 @@ public:
 	explicit CDxSurface(IDirect3D9 *pD3D9)
 	{
 		ZeroMemory(&m_nVtableAddr, sizeof(CDxSurface) - offsetof(CDxSurface,m_nVtableAddr));
-		InitializeCriticalSection(&m_csRender);
 		//InitializeCriticalSection(&m_csSnapShot);
 		if (pD3D9)
 		{
@@ -513,7 +388,6 @@ public:
 	}
 	CDxSurface()
 	{
-		TraceMemory();
 		// m_nVariable1stܿ麯ĳʼ
 		// ΢Visual C++
 		ZeroMemory(&m_nVtableAddr, sizeof(CDxSurface) - offsetof(CDxSurface,m_nVtableAddr));
@@ -538,14 +412,10 @@ public:
 			DxTraceMsg("%s Direct3DCreate9 failed.\n",__FUNCTION__);
 			assert(false);
 		}
-		InitializeCriticalSection(&m_csRender);
-		m_hEventCopySurface		 = CreateEvent(NULL,TRUE,FALSE,NULL);
-		m_hEventCreateSurface	 = CreateEvent(NULL,TRUE,FALSE,NULL);
 	}
 
 	virtual ~CDxSurface()
 	{
-		TraceMemory();
 		//DetachWnd();
 		DxCleanup();
 		SafeRelease(m_pDirect3D9);
@@ -554,12 +424,7 @@ public:
 			FreeLibrary(m_hD3D9);
 			m_hD3D9 = NULL;
 		}
-		DeleteCriticalSection(&m_csRender);
 		//DeleteCriticalSection(&m_csSnapShot);
-		CloseHandle(m_hEventCopySurface);
-		m_hEventCopySurface = NULL;
-		CloseHandle(m_hEventCreateSurface);
-		m_hEventCreateSurface = NULL;
 	}
 
 	// DirectXԴǷȫߴ紴
@@ -633,8 +498,8 @@ public:
 
 	virtual bool ResetDevice()
 	{
-		TraceMemory();
 		SafeRelease(m_pDirect3DSurfaceRender);	
+		AccountSurface();
 #ifdef _DEBUG
 		HRESULT hr = m_pDirect3DDevice->Reset(&m_d3dpp);
 		if (SUCCEEDED(hr))
@@ -655,7 +520,6 @@ public:
 	// D3dDirect9Ex£óԱЧ
 	virtual bool RestoreDevice()
 	{// ָ豸ԭʼؽԴ
-		TraceMemory();
 		if (!m_pDirect3D9 || !m_pDirect3DDevice)
 			return false;
 #ifdef _DEBUG
@@ -676,75 +540,51 @@ public:
 	}
 	virtual void DxCleanup()
 	{
+		if (m_pHoldFrame)
+			av_frame_free(&m_pHoldFrame);
+		SafeRelease(m_pSwapChain);
 		SafeRelease(m_pDirect3DSurfaceRender);
 		SafeRelease(m_pDirect3DDevice);
+		AccountSurface();
 	}
 
-	// ѽ֡pAvFrameеͼ͵ͼ
+	// ʾ仯ʱڴͳ,δ仯ʱֻȽһָ
+	void AccountSurface()
+	{
+		if (m_pAccountedSurface == m_pDirect3DSurfaceRender)
+			return;
+		if (m_nSurfaceBytes)
+			g_MemoryAccount.Free(MemTag_Surface, m_nMemoryChannel, m_nSurfaceBytes);
+		m_pAccountedSurface = m_pDirect3DSurfaceRender;
+		m_nSurfaceBytes = CMemoryAccount::GetSurfaceBytes(m_pDirect3DSurfaceRender);
+		if (m_nSurfaceBytes)
+			m_nMemoryChannel = g_MemoryAccount.Alloc(MemTag_Surface, MEMORY_CURRENT_CHANNEL, m_nSurfaceBytes);
+	}
+
+	// ͼ,ѽ֡pAvFrameύͼ,Ⱦ߳е
 	void TransferSnapShotSurface(AVFrame *pAvFrame)
 	{
-		if (WaitForSingleObject(m_hEventCreateSurface,0) == WAIT_OBJECT_0 )						// Ѿͼ
-		{
-			ResetEvent(m_hEventCreateSurface);
-			// ʹStretchRectԴ渴Ƶϵͳڴ
-			// hr = m_pDirect3DDevice->StretchRect(m_pDirect3DSurfaceRender, &srcrt, m_pSnapshotSurface, &srcrt, D3DTEXF_LINEAR);
-			D3DLOCKED_RECT D3dRect;
-			m_pSnapshotSurface->LockRect(&D3dRect, NULL, D3DLOCK_DONOTWAIT);
-			// FFMPEGرֽDirectXصֽ෴,
-			// D3DFMT_A8R8G8B8(A8:R8:G8:B8)==>AV_PIX_FMT_BGRA(B8:G8:R8:A8)
-#if _MSC_VER >= 1600
-			shared_ptr<PixelConvert> pVideoScale = make_shared<PixelConvert>(pAvFrame,D3DFMT_A8R8G8B8,GQ_BICUBIC);
-#else
-			shared_ptr<PixelConvert> pVideoScale (new PixelConvert(pAvFrame,D3DFMT_A8R8G8B8,GQ_BICUBIC));
-#endif
-			pVideoScale->ConvertPixel(pAvFrame);
-			memcpy(D3dRect.pBits, pVideoScale->pImage,pVideoScale->nImageSize);
-			m_pSnapshotSurface->UnlockRect();
-			SetEvent(m_hEventCopySurface);
-		}
+		if (!InterlockedExchange(&m_nSnapshotPending, 0))
+			return;
+		SnapshotFormat nFormat = Snapshot_JPEG;
+		if (m_D3DXIFF == D3DXIFF_PNG)
+			nFormat = Snapshot_PNG;
+		else if (m_D3DXIFF == D3DXIFF_BMP || m_D3DXIFF == D3DXIFF_DIB)
+			nFormat = Snapshot_BMP;
+		if (!g_SnapshotService.Submit(pAvFrame, m_szSnapShotPath, nFormat))
+			DxTraceMsg("%s Snapshot request rejected.\n", __FUNCTION__);
 	}
 
-	// ץͼSurfaceеͼݱ浽ļУ˽ͼõͼԭʼͼ
-	// ע
+	// ץͼһ֡ͼ񱣴浽ļУ˽ͼõͼԭʼͼ
+	// ע:ֻ֧JPGPNGBMPʽ,ʽJPG;дļɽͼĹ߳
 	void SaveSurfaceToFile(TCHAR *szFilePath,D3DXIMAGE_FILEFORMAT D3DImageFormat = D3DXIFF_JPG)
 	{
-		if (!m_pDirect3DDevice || !m_pDirect3DSurfaceRender)
+		if (!m_bInitialized)
 			return ;
+		MUTEX_LOCK(m_csRender);
 		_tcscpy_s(m_szSnapShotPath,MAX_PATH,szFilePath);
 		m_D3DXIFF = D3DImageFormat;
-		_beginthreadex(NULL,0,ThreadSaveSurface,this,0,NULL);
-	}
-	static UINT __stdcall ThreadSaveSurface(void *p)
-	{
-		CDxSurface *pThis = (CDxSurface *)p;
-		D3DSURFACE_DESC desc;
-		pThis->m_pDirect3DSurfaceRender->GetDesc(&desc);
-		HRESULT hr = pThis->m_pDirect3DDevice->CreateOffscreenPlainSurface(pThis->m_nVideoWidth,
-			pThis->m_nVideoHeight, 
-			D3DFMT_A8R8G8B8,
-			D3DPOOL_SYSTEMMEM, 
-			&pThis->m_pSnapshotSurface, 
-			NULL);
-		if (FAILED(hr))
-		{
-			DxTraceMsg("%s IDirect3DSurface9::GetDesc failed,hr = %08X.\n",__FUNCTION__,hr);
-			return 0;
-		}
-		
-		// ׼,Ը
-		SetEvent(pThis->m_hEventCreateSurface);
-		DWORD dwTime = timeGetTime();
-		if (WaitForSingleObject(pThis->m_hEventCopySurface,1000) == WAIT_OBJECT_0)
-		{
-			hr = D3DXSaveSurfaceToFile(pThis->m_szSnapShotPath,pThis->m_D3DXIFF,pThis->m_pSnapshotSurface,NULL,NULL);
-			if (FAILED(hr))		
-				DxTraceMsg("%s D3DXSaveSurfaceToFile Failed,hr = %08X.\n",__FUNCTION__,hr);
-		}
-		DWORD dwTimeSpan = timeGetTime() - dwTime;
-		DxTraceMsg("%s TimeSpan = %dms.\n",__FUNCTION__,dwTimeSpan);
-		ResetEvent(pThis->m_hEventCopySurface);
-		SafeRelease(pThis->m_pSnapshotSurface);
-		return 0;
+		InterlockedExchange(&m_nSnapshotPending, 1);
 	}
 	// ĻץͼʾĻϵͼ󣬱浽ļ,˽ͼõпܲԭʼͼ񣬿Ǳͼ 
 	void CaptureScreen(TCHAR *szFilePath,D3DXIMAGE_FILEFORMAT D3DImageFormat = D3DXIFF_JPG)		
@@ -819,6 +659,64 @@ public:
 		SaveSurfaceToFile(szPath,D3DXIFF_BMP);
 	}
 	
+	/// @brief ʹӲ豸ʼ,Ӳ֡ıֱ쵽ʾڵĽ,ڴ渴
+	/// @param hWnd		ʾ
+	/// @param pDevice	Ӳʹõ豸,D3DCREATE_MULTITHREADEDʽ
+	/// @remark 豸ɽ,˴豸ʧ;֡ͨm_pDirect3DSurfaceRenderʾ
+	/// ֮ǰDetachSharedDevice,ͷųеӲ֡豸
+	virtual bool InitD3DShared(HWND hWnd,
+		IDirect3DDevice9 *pDevice,
+		int nVideoWidth,
+		int nVideoHeight,
+		D3DFORMAT nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'))
+	{
+		assert(hWnd != NULL && pDevice != NULL);
+		MUTEX_LOCK(m_csRender);
+		DxCleanup();
+		ZeroMemory(&m_d3dpp, sizeof(D3DPRESENT_PARAMETERS));
+		m_d3dpp.Windowed				= TRUE;
+		m_d3dpp.hDeviceWindow			= hWnd;
+		m_d3dpp.BackBufferWidth			= 0;						// ڿͻߴ紴
+		m_d3dpp.BackBufferHeight		= 0;
+		m_d3dpp.BackBufferFormat		= D3DFMT_UNKNOWN;
+		m_d3dpp.BackBufferCount			= 1;
+		m_d3dpp.SwapEffect				= D3DSWAPEFFECT_DISCARD;
+		m_d3dpp.PresentationInterval	= D3DPRESENT_INTERVAL_IMMEDIATE;	// ͨĽһ豸,Presentеȴֱͬ
+		HRESULT hr = pDevice->CreateAdditionalSwapChain(&m_d3dpp, &m_pSwapChain);
+		if (FAILED(hr))
+		{
+			DxTraceMsg("%s IDirect3DDevice9::CreateAdditionalSwapChain failed,hr = %08X.\n", __FUNCTION__, hr);
+			return false;
+		}
+		hr = pDevice->CreateOffscreenPlainSurface(nVideoWidth, nVideoHeight, nD3DFormat, D3DPOOL_DEFAULT, &m_pDirect3DSurfaceRender, NULL);
+		if (FAILED(hr))
+		{
+			DxTraceMsg("%s IDirect3DDevice9::CreateOffscreenPlainSurface failed,hr = %08X.\n", __FUNCTION__, hr);
+			SafeRelease(m_pSwapChain);
+			return false;
+		}
+		m_pDirect3DDevice = pDevice;
+		m_pDirect3DDevice->AddRef();
+		m_pHoldFrame	 = av_frame_alloc();
+		m_nVideoWidth	 = nVideoWidth;
+		m_nVideoHeight	 = nVideoHeight;
+		m_nD3DFormat	 = nD3DFormat;
+		m_bD3DShared	 = true;
+		m_bInitialized	 = true;
+		return true;
+	}
+
+	// ͷõ豸еӲ֡
+	virtual void DetachSharedDevice()
+	{
+		MUTEX_LOCK(m_csRender);
+		if (!m_pSwapChain)
+			return;
+		DxCleanup();
+		m_bD3DShared = false;
+		m_bInitialized = false;
+	}
+
 	// InitD3D֮ǰȵAttachWndƵʾ
 	// nD3DFormat Ϊ¸ʽ֮һ
 	// MAKEFOURCC('Y', 'V', '1', '2')	Ĭϸʽ,ԺܷYUV420Pתõ,YUV420PFFMPEGõĬظʽ
@@ -835,7 +733,6 @@ public:
 				 BOOL bIsWindowed = TRUE,
 				 D3DFORMAT nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'))
 	{
-		TraceMemory();
 		assert(hWnd != NULL);
 		assert(IsWindow(hWnd));
 		assert(nVideoWidth != 0 || nVideoHeight != 0);
@@ -969,19 +866,20 @@ _Failed:
 	// жǷҪĿ괰ʾͼ
 	// ڱػСĴʾͼٶȷǳ,ӰȾ̣
 	// ڻڴػС״̬ʱӦڸôϻͼ
+	// ȫڵСĴͬʾ,СĴڽʾ֡,μCRenderThrottle
 	bool IsNeedRender(HWND hRenderWnd)
 	{
-		// ڱػСʾͼ
-		if (IsIconic(hRenderWnd) ||		// С
-			!IsWindowVisible(hRenderWnd))	// 
-			return false;
-		// ǰڵĸڱػС಻ʾͼ
-		HWND hRoot = GetAncestor(hRenderWnd,GA_ROOT);
-		if (hRoot && 
-			(IsIconic(hRoot) ||			// С
-			!IsWindowVisible(hRoot)))	// ))
-			return false;
-		return true;
+		return m_RenderThrottle.ShouldRender(hRenderWnd, m_nVideoWidth, m_nVideoHeight);
+	}
+
+	void GetThrottleStat(RenderThrottleStat &Stat)
+	{
+		m_RenderThrottle.GetStat(Stat);
+	}
+
+	virtual void SetLatency(CChannelLatency *pLatency)
+	{
+		m_pLatency = pLatency;
 	}
 
 	virtual inline IDirect3DDevice9 *GetD3DDevice()
@@ -999,7 +897,7 @@ _Failed:
 	}
 	void SetFullScreenWnd(HWND hWnd = NULL)
 	{
-		CAutoLock lock(&m_csRender);
+		MUTEX_LOCK(m_csRender);
 		m_hFullScreenWindow = hWnd;
 	}
 
@@ -1019,7 +917,7 @@ _Failed:
 		return m_bD3DShared;
 	}
 
-	bool IsInited()
+	virtual bool IsInited()
 	{
 		return m_bInitialized;
 	}
@@ -1033,7 +931,7 @@ _Failed:
 	// ʱҪʹܣΪĿǰδҵȫشģʽķ
 	inline void SwitchFullScreen(HWND hWnd = NULL)
 	{
-		CAutoLock lock(&m_csRender);
+		MUTEX_LOCK(m_csRender);
 		m_d3dpp.Windowed = !m_d3dpp.Windowed;
 		WNDPROC pOldWndProc = (WNDPROC)GetWindowLong(m_d3dpp.hDeviceWindow,GWL_WNDPROC);
 		if (m_d3dpp.Windowed)
@@ -1092,6 +990,9 @@ _Failed:
 
 		if (!m_pDirect3DDevice)
 			return false;
+		// õ豸ɽ豸ʧ
+		if (m_pSwapChain)
+			return true;
 		
 		hr = m_pDirect3DDevice->TestCooperativeLevel();
 		if (FAILED(hr))
@@ -1124,41 +1025,115 @@ _Failed:
 		return true;
 	}
 	
-	void CopyFrameYUV420P(byte *pDest,int nStride,AVFrame *pFrame420P)
+	// YUV420P֡ƵYV12,nSurfaceHeightΪĸ߶
+	// ĸ߶ȿͼ߶,UVλñ밴߶ȼ
+	void CopyFrameYUV420P(byte *pDest,int nStride,int nSurfaceHeight,AVFrame *pFrame420P)
 	{
-		int nSize = pFrame420P->height * nStride;			
-		const size_t nHalfSize = (nSize) >> 1;	
-		byte *pDestY = pDest;										// Yʼַ
-		byte *pDestV = pDest + nSize;								// Uʼַ
-		byte *pDestU = pDestV + (size_t)(nHalfSize >> 1);			// Vʼַ
+		CopyYUV420PToYV12(pDest,nStride,nSurfaceHeight,pFrame420P->data,pFrame420P->linesize,pFrame420P->width,pFrame420P->height);
+	}
 
-		// YUV420PUVԵΪYV12ʽ
-		// Y
-		for (int i = 0; i < pFrame420P->height; i++)
-			memcpy(pDestY + i * nStride, pFrame420P->data[0] + i * pFrame420P->linesize[0], pFrame420P->linesize[0]);
+	// NV12֡ƵNV12
+	void CopyFrameNV12(byte *pDest,int nStride,int nSurfaceHeight,AVFrame *pFrameNV12)
+	{
+		CopyPlane(pDest,nStride,pFrameNV12->data[0],pFrameNV12->linesize[0],pFrameNV12->width,pFrameNV12->height);
+		CopyPlane(pDest + nStride*nSurfaceHeight,nStride,pFrameNV12->data[1],pFrameNV12->linesize[1],(pFrameNV12->width + 1) & ~1,(pFrameNV12->height + 1)/2);
+	}
 
-		// YUV420PUĿYV12U
-		for (int i = 0; i < pFrame420P->height / 2; i++)
-			memcpy(pDestU + i * nStride / 2, pFrame420P->data[1] + i * pFrame420P->linesize[1] , pFrame420P->linesize[1]);
+	// YUV420P10֡תΪ8bitƵYV12,nSurfaceHeightΪĸ߶
+	void CopyFrameYUV420P10(byte *pDest,int nStride,int nSurfaceHeight,AVFrame *pFrame420P10)
+	{
+		// YV12Vǰ,Uں
+		byte *pDst[3];
+		int nDstPitch[3];
+		GetYV12Planes(pDest,nStride,nSurfaceHeight,pDst,nDstPitch);
+		CopyYUV420P10ToYUV420P(pDst,nDstPitch,pFrame420P10->data,pFrame420P10->linesize,pFrame420P10->width,pFrame420P10->height);
+	}
 
-		// YUV420PVĿYV12V
-		for (int i = 0; i < pFrame420P->height / 2; i++)
-			memcpy(pDestV + i * nStride / 2, pFrame420P->data[2] + i * pFrame420P->linesize[2] , pFrame420P->linesize[2]);
+	// DXVAP010תΪ8bitƵYV12NV12Ⱦ
+	bool CopySurfaceP010(D3DLOCKED_RECT &DstRect,D3DSURFACE_DESC &DstDesc,D3DLOCKED_RECT &SrcRect,D3DSURFACE_DESC &SrcDesc,int nWidth,int nHeight)
+	{
+		switch(DstDesc.Format)
+		{
+		case (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'):
+			CopyP010ToYV12((byte *)DstRect.pBits,DstRect.Pitch,DstDesc.Height,(byte *)SrcRect.pBits,SrcRect.Pitch,SrcDesc.Height,nWidth,nHeight);
+			return true;
+		case (D3DFORMAT)MAKEFOURCC('N', 'V', '1', '2'):
+			CopyP010ToNV12((byte *)DstRect.pBits,DstRect.Pitch,DstDesc.Height,(byte *)SrcRect.pBits,SrcRect.Pitch,SrcDesc.Height,nWidth,nHeight);
+			return true;
+		default:
+			DxTraceMsg("%s Unsupported render surface format:%08X.\n",__FUNCTION__,DstDesc.Format);
+			return false;
+		}
 	}
 
+	// RGBȵƽʽ֡Ƶ,ÿֻЧ
 	void CopyFrameARGB(byte *pDest,int nStride,AVFrame *pFrameARGB)
 	{	
-		for (int i = 0; i < pFrameARGB->height; i++)
-			memcpy(pDest + i * nStride, pFrameARGB->data[0] + i * pFrameARGB->linesize[0], pFrameARGB->linesize[0]);
+		int nRowBytes = av_image_get_linesize((AVPixelFormat)pFrameARGB->format,pFrameARGB->width,0);
+		CopyPlane(pDest,nStride,pFrameARGB->data[0],pFrameARGB->linesize[0],nRowBytes,pFrameARGB->height);
+	}
+
+	// DXVANV12渴ƵYV12NV12Ⱦ
+	// п͸߶ȫһʱ鸴,밴иƸ
+	bool CopySurfaceNV12(D3DLOCKED_RECT &DstRect,D3DSURFACE_DESC &DstDesc,D3DLOCKED_RECT &SrcRect,D3DSURFACE_DESC &SrcDesc,int nWidth,int nHeight)
+	{
+		switch(DstDesc.Format)
+		{
+		case (D3DFORMAT)MAKEFOURCC('N', 'V', '1', '2'):
+			{
+				if (DstRect.Pitch == SrcRect.Pitch && DstDesc.Height == SrcDesc.Height)
+					gpu_memcpy(DstRect.pBits, SrcRect.pBits, SrcRect.Pitch*SrcDesc.Height*3/2);
+				else
+					CopyNV12ToNV12((byte *)DstRect.pBits,DstRect.Pitch,DstDesc.Height,(byte *)SrcRect.pBits,SrcRect.Pitch,SrcDesc.Height,nWidth,nHeight);
+				return true;
+			}
+		case (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'):
+			CopyNV12ToYV12((byte *)DstRect.pBits,DstRect.Pitch,DstDesc.Height,(byte *)SrcRect.pBits,SrcRect.Pitch,SrcDesc.Height,nWidth,nHeight);
+			return true;
+		default:
+			DxTraceMsg("%s Unsupported render surface format:%08X.\n",__FUNCTION__,DstDesc.Format);
+			return false;
+		}
 	}
 	
+	// pSrcSurfacenWidth x nHeightͼ쵽̨
+	// ʹýʱ,豸̹߳,StretchRectҪBeginScene,Ҳ豸ǰȾĿ
+	bool StretchToBackBuffer(IDirect3DSurface9 *pSrcSurface, int nWidth, int nHeight)
+	{
+		IDirect3DSurface9 * pBackSurface = NULL;
+		HRESULT hr = S_OK;
+		if (m_pSwapChain)
+			hr = m_pSwapChain->GetBackBuffer(0, D3DBACKBUFFER_TYPE_MONO, &pBackSurface);
+		else
+		{
+			m_pDirect3DDevice->Clear(0, NULL, D3DCLEAR_TARGET, D3DCOLOR_XRGB(0, 0, 0), 1.0f, 0);
+			m_pDirect3DDevice->BeginScene();
+			hr = m_pDirect3DDevice->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &pBackSurface);
+		}
+		if (FAILED(hr))
+		{
+			if (!m_pSwapChain)
+				m_pDirect3DDevice->EndScene();
+			DxTraceMsg("%s line(%d) GetBackBuffer failed:hr = %08X.\n",__FUNCTION__,__LINE__,hr);
+			return false;
+		}
+		D3DSURFACE_DESC Desc;
+		pBackSurface->GetDesc(&Desc);
+		RECT dstrt = { 0, 0, Desc.Width, Desc.Height };
+		RECT srcrt = { 0, 0, nWidth, nHeight };	
+		hr = m_pDirect3DDevice->StretchRect(pSrcSurface, &srcrt, pBackSurface, &dstrt, D3DTEXF_LINEAR);
+		SafeRelease(pBackSurface);
+		if (!m_pSwapChain)
+			m_pDirect3DDevice->EndScene();
+		return true;
+	}
+
 	virtual bool Render(AVFrame *pAvFrame,HWND hWnd = NULL,RECT *pRenderRt = NULL)
 	{
-		//TraceMemory();
 		if (!pAvFrame)
 			return false;
-		CTryLock Trylock;
-		if (!Trylock.TryLock(&m_csRender))
+		MUTEX_TRYLOCK(lock, m_csRender);
+		if (!lock.IsLocked())
 			return false;
 
 		HWND hRenderWnd = m_d3dpp.hDeviceWindow;
@@ -1173,10 +1148,10 @@ _Failed:
 		if (!m_pDirect3DDevice)
 			return false;
 		HRESULT hr = -1;
-#ifdef _DEBUG
-		double dfT1 = GetExactTime();
-#endif
-		CAutoLock lock(&m_csRender);	
+		AccountSurface();
+		int64_t nT1 = MonoTimeNs();
+		int64_t nT2 = 0;			// ʼ쵽̨ʱ
+		CTimelineScope PresentScope;	// 쵽̨ʼ,PresentΪֹ
 		switch(pAvFrame->format)
 		{
 		case  AV_PIX_FMT_DXVA2_VLD:
@@ -1188,9 +1163,16 @@ _Failed:
 					if (!pSurface)
 						return false;
 					pRenderSurface = pSurface;
+					// и֡,һ֡ʾ֮ǰᱻ
+					if (m_pHoldFrame)
+					{
+						av_frame_unref(m_pHoldFrame);
+						av_frame_ref(m_pHoldFrame, pAvFrame);
+					}
 				}
 				else
 				{
+					TIMELINE_SCOPE("LockRect", TIMELINE_CURRENT_CHANNEL, pAvFrame->pkt_pts);
 					D3DLOCKED_RECT SrcRect;
 					D3DLOCKED_RECT DstRect;
 					D3DSURFACE_DESC SrcSurfaceDesc, DstSurfaceDesc;
@@ -1205,8 +1187,11 @@ _Failed:
 						DxTraceMsg("%s line(%d) IDirect3DSurface9::LockRect failed:hr = %08.\n",__FUNCTION__,__LINE__,hr);
 						return false;
 					}
-					// ƱʱYUVֱƣֱӸƱ漴ɣǰǱĲȫһ
-					gpu_memcpy(DstRect.pBits, SrcRect.pBits, SrcRect.Pitch*SrcSurfaceDesc.Height*3/2);
+					// 10bitP010ҪתΪ8bit
+					if (SrcSurfaceDesc.Format == (D3DFORMAT)MAKEFOURCC('P', '0', '1', '0'))
+						CopySurfaceP010(DstRect,DstSurfaceDesc,SrcRect,SrcSurfaceDesc,pAvFrame->width,pAvFrame->height);
+					else
+						CopySurfaceNV12(DstRect,DstSurfaceDesc,SrcRect,SrcSurfaceDesc,pAvFrame->width,pAvFrame->height);
 					/*
 					// Yͼ
 					uint8_t *pY = (uint8_t*)DstRect.pBits;
@@ -1221,6 +1206,8 @@ _Failed:
 						DxTraceMsg("%s line(%d) IDirect3DSurface9::UnlockRect failed:hr = %08.\n",__FUNCTION__,__LINE__,hr);
 						return false;
 					}
+					if (m_pLatency)
+						m_pLatency->Record(LatencyStage_Download, nT1, MonoTimeNs());
 				}
 				// ͼ
 				TransferSnapShotSurface(pAvFrame);
@@ -1228,35 +1215,19 @@ _Failed:
 				// ⲿֻƽӿ
 				ExternDrawCall(hWnd,pRenderRt);
 
-				IDirect3DSurface9 * pBackSurface = NULL;
-				m_pDirect3DDevice->Clear(0, NULL, D3DCLEAR_TARGET, D3DCOLOR_XRGB(0, 0, 0), 1.0f, 0);
-				m_pDirect3DDevice->BeginScene();
-				hr = m_pDirect3DDevice->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &pBackSurface);
-				D3DSURFACE_DESC desc;
-				
-				if (FAILED(hr))
-				{
-					m_pDirect3DDevice->EndScene();
-					DxTraceMsg("%s line(%d) IDirect3DDevice9::GetBackBuffer failed:hr = %08.\n",__FUNCTION__,__LINE__,hr);
+				nT2 = MonoTimeNs();
+				PresentScope.Begin("Present", TIMELINE_CURRENT_CHANNEL, pAvFrame->pkt_pts);
+				if (!StretchToBackBuffer(pRenderSurface, pAvFrame->width, pAvFrame->height))
 					return true;
-				}
-				pBackSurface->GetDesc(&desc);
-				RECT dstrt = { 0, 0, desc.Width, desc.Height };
-				RECT srcrt = { 0, 0, pAvFrame->width, pAvFrame->height };	
-				hr = m_pDirect3DDevice->StretchRect(pRenderSurface, &srcrt, pBackSurface, &dstrt, D3DTEXF_LINEAR);
-			
-				pBackSurface->Release();
-				m_pDirect3DDevice->EndScene();
-#ifdef _DEBUG
-				double dfT2 = GetExactTime();
-				//DxTraceMsg("%s TimeSpan(T2-T1)\t%.6f\n",__FUNCTION__,dfT2 - dfT1);
-#endif
 				break;
 			}
 		case AV_PIX_FMT_YUV420P:
 		case AV_PIX_FMT_YUVJ420P:		
-			{// ֻ֧֡YUV420Pʽ					
+		case AV_PIX_FMT_YUV420P10:
+			{// ֻ֧֡YUV420PYUV420P10ʽ					
 				TransferSnapShotSurface(pAvFrame);
+				nT1 = MonoTimeNs();
+				CTimelineScope LockScope("LockRect", TIMELINE_CURRENT_CHANNEL, pAvFrame->pkt_pts);
 				D3DLOCKED_RECT d3d_rect;
 				D3DSURFACE_DESC Desc;
 				hr = m_pDirect3DSurfaceRender->GetDesc(&Desc);
@@ -1269,52 +1240,50 @@ _Failed:
 				}
  				if (pAvFrame->format == AV_PIX_FMT_YUV420P &&
 					Desc.Format == (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'))
- 					CopyFrameYUV420P((byte *)d3d_rect.pBits,d3d_rect.Pitch,pAvFrame);
+ 					CopyFrameYUV420P((byte *)d3d_rect.pBits,d3d_rect.Pitch,Desc.Height,pAvFrame);
+				else if (pAvFrame->format == AV_PIX_FMT_YUV420P10 &&
+					Desc.Format == (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'))
+					CopyFrameYUV420P10((byte *)d3d_rect.pBits,d3d_rect.Pitch,Desc.Height,pAvFrame);
  				else
 				{
+					int64_t nConvert = MonoTimeNs();
 					if (!m_pPixelConvert)
 #if _MSC_VER > 1600
 						m_pPixelConvert = make_shared<PixelConvert>(pAvFrame,Desc.Format);
 #else
 						m_pPixelConvert = shared_ptr<PixelConvert>(new PixelConvert(pAvFrame,Desc.Format));
 #endif
-					m_pPixelConvert->ConvertPixel(pAvFrame);
+					{
+						TIMELINE_SCOPE("Convert", TIMELINE_CURRENT_CHANNEL, pAvFrame->pkt_pts);
+						m_pPixelConvert->ConvertPixel(pAvFrame);
+					}
+					if (m_pLatency)
+						m_pLatency->Record(LatencyStage_Convert, nConvert, MonoTimeNs());
+					nT1 += MonoTimeNs() - nConvert;		// ʽתʱ䲻ϴ
 					if (m_pPixelConvert->GetDestPixelFormat() == AV_PIX_FMT_YUV420P)
-						CopyFrameYUV420P((byte *)d3d_rect.pBits,d3d_rect.Pitch,m_pPixelConvert->pFrameNew);
+						CopyFrameYUV420P((byte *)d3d_rect.pBits,d3d_rect.Pitch,Desc.Height,m_pPixelConvert->pFrameNew);
+					else if (m_pPixelConvert->GetDestPixelFormat() == AV_PIX_FMT_NV12)
+						CopyFrameNV12((byte *)d3d_rect.pBits,d3d_rect.Pitch,Desc.Height,m_pPixelConvert->pFrameNew);
 					else					
-						memcpy((byte *)d3d_rect.pBits,m_pPixelConvert->pImage,m_pPixelConvert->nImageSize);
+						CopyFrameARGB((byte *)d3d_rect.pBits,d3d_rect.Pitch,m_pPixelConvert->pFrameNew);
 				}
 				hr = m_pDirect3DSurfaceRender->UnlockRect();
+				LockScope.End();
 				if (FAILED(hr))
 				{
 					DxTraceMsg("%s line(%d) IDirect3DSurface9::UnlockRect failed:hr = %08.\n",__FUNCTION__,__LINE__,hr);
 					return false;
 				}
+				if (m_pLatency)
+					m_pLatency->Record(LatencyStage_Upload, nT1, MonoTimeNs());
 
 				// ⲿֻƽӿ
 				ExternDrawCall(hWnd,pRenderRt);
 
-				IDirect3DSurface9 * pBackSurface = NULL;	
-				m_pDirect3DDevice->Clear(0, NULL, D3DCLEAR_TARGET, D3DCOLOR_XRGB(0, 0, 0), 1.0f, 0);
-				m_pDirect3DDevice->BeginScene();
-				hr = m_pDirect3DDevice->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &pBackSurface);
-				if (FAILED(hr))
-				{
-					m_pDirect3DDevice->EndScene();
-					DxTraceMsg("%s line(%d) IDirect3DDevice9::GetBackBuffer failed:hr = %08.\n",__FUNCTION__,__LINE__,hr);
+				nT2 = MonoTimeNs();
+				PresentScope.Begin("Present", TIMELINE_CURRENT_CHANNEL, pAvFrame->pkt_pts);
+				if (!StretchToBackBuffer(m_pDirect3DSurfaceRender, pAvFrame->width, pAvFrame->height))
 					return true;
-				}	
-				pBackSurface->GetDesc(&Desc);
-				RECT dstrt = { 0, 0, Desc.Width, Desc.Height };
-				RECT srcrt = { 0, 0, pAvFrame->width, pAvFrame->height };	
-				hr = m_pDirect3DDevice->StretchRect(m_pDirect3DSurfaceRender, &srcrt, pBackSurface, &dstrt, D3DTEXF_LINEAR);
-				
-				SafeRelease(pBackSurface);
-				m_pDirect3DDevice->EndScene();
-#ifdef _DEBUG
-				double dfT2 = GetExactTime();
-				//DxTraceMsg("%s TimeSpan(T2-T1)\t%.6f\n",__FUNCTION__,dfT2 - dfT1);
-#endif
 			}
 			break;
 		case AV_PIX_FMT_NONE:
@@ -1327,21 +1296,19 @@ _Failed:
 			break;
 		default:
 			{
-				DxTraceMsg("%s Get a unsupport format frame:%d.\n",pAvFrame->format);
+				DxTraceMsg("%s Get a unsupport format frame:%d.\n",__FUNCTION__,pAvFrame->format);
 				return true;
 			}
 		}
-#ifdef _DEBUG
-		double dfT3 = GetExactTime();
-#endif
 		// Present(RECT* pSourceRect,CONST RECT* pDestRect,HWND hDestWindowOverride,CONST RGNDATA* pDirtyRegion)
 		
-		hr = m_pDirect3DDevice->Present(NULL, pRenderRt, hRenderWnd, NULL);
-		
-#ifdef _DEBUG
-		double dfT4 = GetExactTime();
-		//DxTraceMsg("%s TimeSpan(T3-T4)\t%.6f\n",__FUNCTION__,dfT4 - dfT3);
-#endif
+		if (m_pSwapChain)
+			hr = m_pSwapChain->Present(NULL, pRenderRt, hRenderWnd, NULL, 0);
+		else
+			hr = m_pDirect3DDevice->Present(NULL, pRenderRt, hRenderWnd, NULL);
+		PresentScope.End();
+		if (m_pLatency)
+			m_pLatency->Record(LatencyStage_Present, nT2, MonoTimeNs());
 		return HandelDevLost();	
 	}
 
@@ -1375,7 +1342,7 @@ _Failed:
 	
 	bool AttachWnd()
 	{
-		CAutoLock lock(m_WndSurfaceMapcs->Get());
+		WRITE_LOCK(m_WndSurfaceMapLock);
 		WndSurfaceMap::iterator itFind = m_WndSurfaceMap.find(m_d3dpp.hDeviceWindow);
 		if (itFind != m_WndSurfaceMap.end())
 			return false;
@@ -1402,7 +1369,7 @@ _Failed:
 
 		if (m_pOldWndProc)
 			SetWindowLong(m_d3dpp.hDeviceWindow,GWL_WNDPROC,(long)m_pOldWndProc);
-		CAutoLock lock(m_WndSurfaceMapcs->Get());
+		WRITE_LOCK(m_WndSurfaceMapLock);
 		m_WndSurfaceMap.erase(m_d3dpp.hDeviceWindow);
 		m_pOldWndProc = NULL;
 	}
@@ -1432,7 +1399,7 @@ _Failed:
 // 			}
 		case WM_LBUTTONDBLCLK:
 			{// лģʽ,Ҫm_WndSurfaceMapɾھ
-				CAutoLock lock(m_WndSurfaceMapcs->Get());
+				WRITE_LOCK(m_WndSurfaceMapLock);
 				WndSurfaceMap::iterator itFind = m_WndSurfaceMap.find(hWnd);
 				if (itFind == m_WndSurfaceMap.end())					
 					return DefWindowProc(hWnd, message, wParam, lParam);	
@@ -1447,8 +1414,8 @@ _Failed:
 				break;
 			}
 		default:
-			{
-				CAutoLock lock(m_WndSurfaceMapcs->Get());
+			{// ÿϢҪ,ֻӶ,ͨĴ֮䲻ٻ
+				READ_LOCK(m_WndSurfaceMapLock);
 				WndSurfaceMap::iterator itFind = m_WndSurfaceMap.find(hWnd);
 				if (itFind == m_WndSurfaceMap.end())					
 					return DefWindowProc(hWnd, message, wParam, lParam);	
@@ -1705,7 +1672,6 @@ public:
 		,m_pDirect3DDeviceEx(NULL)
 		,m_pDirect3DCreate9Ex(NULL)
 	{
-		InitializeCriticalSection(&m_csRender);
 		if (pD3D9Ex)
 		{
 			m_bD3DShared = true;
@@ -1717,7 +1683,6 @@ public:
 		,m_pDirect3DDeviceEx(NULL)
 		,m_pDirect3DCreate9Ex(NULL)
 	{
-		TraceMemory();		
 		if (!m_hD3D9)
 			m_hD3D9 = LoadLibraryA("d3d9.dll");
 		if (!m_hD3D9)
@@ -1746,6 +1711,7 @@ public:
 	{
 		SafeRelease(m_pDirect3DSurfaceRender);
 		SafeRelease(m_pDirect3DDeviceEx);
+		AccountSurface();
 	}
 	~CDxSurfaceEx()
 	{
@@ -1774,7 +1740,6 @@ public:
 		BOOL bIsWindowed = TRUE,
 		D3DFORMAT nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'))
 	{
-		TraceMemory();
 		assert(hWnd != NULL);
 		assert(IsWindow(hWnd));
 		assert(nVideoWidth != 0 || nVideoHeight != 0);
@@ -1991,7 +1956,7 @@ _Failed:
 		if (!m_pDirect3DDeviceEx)
 			return false;
 		
-		CAutoLock lock(&m_csRender);
+		MUTEX_LOCK(m_csRender);
 		switch(pAvFrame->format)
 		{
 		case  AV_PIX_FMT_DXVA2_VLD:
@@ -2017,7 +1982,10 @@ _Failed:
 						DxTraceMsg("%s line(%d) IDirect3DSurface9::LockRect failed:hr = %08.\n",__FUNCTION__,__LINE__,hr);
 						return false;
 					}
-					gpu_memcpy(DstRect.pBits, SrcRect.pBits, SrcRect.Pitch*SrcSurfaceDesc.Height);
+					if (SrcSurfaceDesc.Format == (D3DFORMAT)MAKEFOURCC('P', '0', '1', '0'))
+						CopySurfaceP010(DstRect,DstSurfaceDesc,SrcRect,SrcSurfaceDesc,pAvFrame->width,pAvFrame->height);
+					else
+						CopySurfaceNV12(DstRect,DstSurfaceDesc,SrcRect,SrcSurfaceDesc,pAvFrame->width,pAvFrame->height);
 					/*
 					// Yͼ
 					uint8_t *pY = (uint8_t*)DstRect.pBits;
@@ -2076,7 +2044,10 @@ _Failed:
 				}
 				if (pAvFrame->format == AV_PIX_FMT_YUV420P &&
 					Desc.Format == (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'))
-					CopyFrameYUV420P((byte *)d3d_rect.pBits,d3d_rect.Pitch,pAvFrame);
+					CopyFrameYUV420P((byte *)d3d_rect.pBits,d3d_rect.Pitch,Desc.Height,pAvFrame);
+				else if (pAvFrame->format == AV_PIX_FMT_YUV420P10 &&
+					Desc.Format == (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'))
+					CopyFrameYUV420P10((byte *)d3d_rect.pBits,d3d_rect.Pitch,Desc.Height,pAvFrame);
 				else
 				{
 					if (!m_pPixelConvert)
@@ -2087,9 +2058,11 @@ _Failed:
 #endif 
 					m_pPixelConvert->ConvertPixel(pAvFrame);
 					if (m_pPixelConvert->GetDestPixelFormat() == AV_PIX_FMT_YUV420P)
-						CopyFrameYUV420P((byte *)d3d_rect.pBits,d3d_rect.Pitch,m_pPixelConvert->pFrameNew);
+						CopyFrameYUV420P((byte *)d3d_rect.pBits,d3d_rect.Pitch,Desc.Height,m_pPixelConvert->pFrameNew);
+					else if (m_pPixelConvert->GetDestPixelFormat() == AV_PIX_FMT_NV12)
+						CopyFrameNV12((byte *)d3d_rect.pBits,d3d_rect.Pitch,Desc.Height,m_pPixelConvert->pFrameNew);
 					else					
-						memcpy((byte *)d3d_rect.pBits,m_pPixelConvert->pImage,m_pPixelConvert->nImageSize);
+						CopyFrameARGB((byte *)d3d_rect.pBits,d3d_rect.Pitch,m_pPixelConvert->pFrameNew);
 				}
 				hr = m_pDirect3DSurfaceRender->UnlockRect();
 				if (FAILED(hr))
@@ -1,19 +1,660 @@
-#include <windows.h>
+#include "Win32Port.h"
 #include <stdio.h>
-#include <wtypes.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
 #include "DxTrace.h"
 #define __countof(array) (sizeof(array)/sizeof(array[0]))
 #pragma warning (disable:4996)
 
+// ӳٸʽѲva_listڴ沼ָƵ¼,ʱѲĵֱַӵva_list_vsnprintf
+// MSVCx86x64ϵʵ:va_listָchar *,ÿռ_INTSIZEOF()ֽ,doubleֵ,
+// va_argֻǰƶָ;GCCȱva_listǽṹ,ڼĴ,,
+// Щƽ̨Ϣڵ߳иʽΪıٷ뻷λ
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#define TRACE_DEFERRED_FORMAT
+#include <type_traits>
+static_assert(std::is_pointer<va_list>::value && sizeof(va_list) == sizeof(char *), "deferred formatting requires va_list to be a plain pointer into the argument area");
+static_assert(_INTSIZEOF(double) == sizeof(double) && _INTSIZEOF(__int64) == sizeof(__int64), "deferred formatting requires 8-byte argument slots for double and __int64");
+#endif
+
+using namespace std;
+
 void DxTrace(char *pFormat, ...)
 {
 	va_list args;
 	va_start(args, pFormat);
-	int nBuff;
 	CHAR szBuffer[0x7fff];
-	nBuff = _vsnprintf(szBuffer, __countof(szBuffer), pFormat, args);
+	_vsnprintf(szBuffer, __countof(szBuffer), pFormat, args);
 	//::wvsprintf(szBuffer, pFormat, args);
 	//assert(nBuff >=0);
 	OutputDebugStringA(szBuffer);
 	va_end(args);	
-}
\ No newline at end of file
+}
+
+#define TRACE_RING_SIZE		(32 * 1024)		// ÿ̻߳λֽ,Ϊ2
+#define TRACE_MAX_RECORD	1024			// һϢ¼ֽ
+#define TRACE_MAX_RINGS		1024			// λ,߳˳仺ɱ̸߳
+#define TRACE_DRAIN_INTERVAL	20			// ̵̨߳,λ
+#define TRACE_ALIGN(n)		(((n) + 7) & ~7)
+
+enum
+{
+	TraceRecord_Pad = 0x01,		// λβ,βռ䲻Դһ¼
+	TraceRecord_Text = 0x02,	// ڵ߳иʽΪı,ı¼ͷ
+};
+
+// Ϣ¼,¼ͷ֮ǰva_listеĲ,֮%sַ
+// ַڲбԼ¼ʼƫ,ʱٻΪָ
+struct TraceRecord
+{
+	WORD		nSize;			// ¼ֽ,8ֽڶ
+	BYTE		nLevel;
+	BYTE		nFlags;
+	DWORD		dwThreadId;
+	LONGLONG	nTime;			// QueryPerformanceCounterļ
+	const char	*pFormat;
+	WORD		nArgSize;		// ֽ
+	WORD		nReserved;
+};
+#define TRACE_HEADER_SIZE	TRACE_ALIGN(sizeof(TraceRecord))
+
+#ifdef TRACE_DEFERRED_FORMAT
+enum TraceArgType
+{
+	TraceArg_None = 0,			// ʽַ
+	TraceArg_Int,
+	TraceArg_Int64,
+	TraceArg_Ptr,
+	TraceArg_Double,
+	TraceArg_String,
+	TraceArg_WString,
+	TraceArg_Unsupported		// *ȡ*Ȼ%n,ӳٸʽ
+};
+#endif
+
+// ߵߵĻλ,nWritenReadΪۼƵֽ,ֻ
+struct TraceRing
+{
+	BYTE			*pBuffer;
+	volatile LONG	nWrite;			// ֻ߳޸
+	volatile LONG	nRead;			// ֻɺ̨߳޸
+	volatile LONG	nDropped;
+	volatile LONG	nRecords;
+	DWORD			dwThreadId;
+	HANDLE			hThread;		// ̵߳ľ,߳˳һΪպɱ
+	volatile LONG	bFree;
+};
+
+// ־ȫ״̬ھ̬洢,ʼֵȫΪ0,һʹʱųʼ,ȫֶĹ˳
+static volatile LONG		s_nInitState = 0;		// 0:δʼ 1:ڳʼ 2:ѳʼ
+static DWORD				s_dwTlsIndex = TLS_OUT_OF_INDEXES;
+static CRITICAL_SECTION		s_csRings;				// λб,ֻȡúͷŻʱݳ,ڳڼ
+static CRITICAL_SECTION		s_csDrain;				// ͬһʱֻһ߳
+static TraceRing			*s_pRings[TRACE_MAX_RINGS];
+static volatile LONG		s_nRings = 0;
+static volatile LONG		s_nOutputs = DXTRACE_OUTPUT_DEBUGGER;
+static FILE					*s_pFile = NULL;			// ļĿs_csDrain
+static volatile LONGLONG	s_nOutputCount = 0;
+static LONGLONG				s_nBaseTime = 0;
+static double				s_dfFrequency = 0.0f;
+static HANDLE				s_hEventExit = NULL;
+static HANDLE				s_hDrainThread = NULL;
+
+static UINT __stdcall DrainThread(void *p);
+static void DrainRings();
+
+static void TraceShutdown()
+{
+	if (s_hDrainThread)
+	{
+		SetEvent(s_hEventExit);
+		WaitForSingleObject(s_hDrainThread, 2000);
+		CloseHandle(s_hDrainThread);
+		s_hDrainThread = NULL;
+	}
+	DrainRings();
+	EnterCriticalSection(&s_csDrain);
+	if (s_pFile)
+	{
+		fclose(s_pFile);
+		s_pFile = NULL;
+	}
+	LeaveCriticalSection(&s_csDrain);
+}
+
+static bool TraceInit()
+{
+	if (s_nInitState == 2)
+		return true;
+	if (InterlockedCompareExchange(&s_nInitState, 1, 0) == 0)
+	{
+		InitializeCriticalSection(&s_csRings);
+		InitializeCriticalSection(&s_csDrain);
+		s_dwTlsIndex = TlsAlloc();
+		LARGE_INTEGER nFreq, nCounter;
+		QueryPerformanceFrequency(&nFreq);
+		QueryPerformanceCounter(&nCounter);
+		s_dfFrequency = (double)nFreq.QuadPart;
+		s_nBaseTime = nCounter.QuadPart;
+		s_hEventExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+		s_hDrainThread = (HANDLE)_beginthreadex(nullptr, 0, DrainThread, nullptr, 0, nullptr);
+		atexit(TraceShutdown);
+		InterlockedExchange(&s_nInitState, 2);
+	}
+	else
+	{
+		while (s_nInitState != 2)
+			Sleep(0);
+	}
+	return s_dwTlsIndex != TLS_OUT_OF_INDEXES;
+}
+
+// ȡõ̵߳Ļλ,һεʱ˳̵߳Ļ
+static TraceRing *GetRing()
+{
+	TraceRing *pRing = (TraceRing *)TlsGetValue(s_dwTlsIndex);
+	if (pRing)
+		return pRing;
+	EnterCriticalSection(&s_csRings);
+	for (int i = 0; i < s_nRings && !pRing; i++)
+	{
+		if (s_pRings[i]->bFree)
+			pRing = s_pRings[i];
+	}
+	if (!pRing && s_nRings < TRACE_MAX_RINGS)
+	{
+		pRing = new TraceRing;
+		ZeroMemory(pRing, sizeof(TraceRing));
+		pRing->pBuffer = new BYTE[TRACE_RING_SIZE];
+		s_pRings[s_nRings] = pRing;
+		InterlockedIncrement(&s_nRings);
+	}
+	if (pRing)
+	{
+		pRing->dwThreadId = GetCurrentThreadId();
+		pRing->hThread = OpenThread(SYNCHRONIZE, FALSE, pRing->dwThreadId);
+		pRing->bFree = FALSE;
+		TlsSetValue(s_dwTlsIndex, pRing);
+	}
+	LeaveCriticalSection(&s_csRings);
+	return pRing;
+}
+
+#ifdef TRACE_DEFERRED_FORMAT
+/// @brief ʽַеһת˵
+/// @param nType		ز,ʽַʱΪTraceArg_None
+/// @param nPrecision	ؾ,δָʱΪ-1,ַֻƾȷΧڵַ
+/// @return ת˵֮λ
+static const char *NextArg(const char *pFormat, TraceArgType &nType, int &nPrecision)
+{
+	nType = TraceArg_None;
+	nPrecision = -1;
+	const char *p = pFormat;
+	while (*p)
+	{
+		if (*p++ != '%')
+			continue;
+		if (*p == '%')
+		{
+			p++;
+			continue;
+		}
+		while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0')
+			p++;
+		if (*p == '*')
+		{
+			nType = TraceArg_Unsupported;
+			return p;
+		}
+		while (*p >= '0' && *p <= '9')
+			p++;
+		if (*p == '.')
+		{
+			p++;
+			if (*p == '*')
+			{
+				nType = TraceArg_Unsupported;
+				return p;
+			}
+			nPrecision = 0;
+			while (*p >= '0' && *p <= '9')
+				nPrecision = nPrecision * 10 + (*p++ - '0');
+		}
+		bool bLong64 = false;
+		bool bSizeT = false;
+		bool bWide = false;
+		bool bShort = false;
+		if (p[0] == 'I' && p[1] == '6' && p[2] == '4')
+		{
+			bLong64 = true;
+			p += 3;
+		}
+		else if (p[0] == 'I' && p[1] == '3' && p[2] == '2')
+			p += 3;
+		else if (p[0] == 'l' && p[1] == 'l')
+		{
+			bLong64 = true;
+			p += 2;
+		}
+		else if (*p == 'I' || *p == 'z' || *p == 't')
+		{
+			bSizeT = true;
+			p++;
+		}
+		else if (*p == 'j')
+		{
+			bLong64 = true;
+			p++;
+		}
+		else if (*p == 'l' || *p == 'w')
+		{
+			bWide = true;
+			p++;
+		}
+		else if (*p == 'h')
+		{
+			bShort = true;
+			p++;
+			if (*p == 'h')
+				p++;
+		}
+		else if (*p == 'L')
+			p++;
+		switch (*p)
+		{
+		case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c': case 'C':
+			nType = bLong64 ? TraceArg_Int64 : (bSizeT ? TraceArg_Ptr : TraceArg_Int);
+			break;
+		case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+			nType = TraceArg_Double;
+			break;
+		case 'p':
+			nType = TraceArg_Ptr;
+			break;
+		case 's':
+			nType = bWide ? TraceArg_WString : TraceArg_String;
+			break;
+		case 'S':
+			nType = bShort ? TraceArg_String : TraceArg_WString;
+			break;
+		default:
+			nType = TraceArg_Unsupported;
+			return p;
+		}
+		return p + 1;
+	}
+	return p;
+}
+
+// va_listռõֽ,va_argĲһ
+static int ArgSlotSize(TraceArgType nType)
+{
+	switch (nType)
+	{
+	case TraceArg_Int:
+		return _INTSIZEOF(int);
+	case TraceArg_Int64:
+		return _INTSIZEOF(__int64);
+	case TraceArg_Double:
+		return _INTSIZEOF(double);
+	default:
+		return _INTSIZEOF(void *);
+	}
+}
+#endif
+
+// Ѽ¼д뻷λ,ռ䲻ʱfalse
+static bool WriteRing(TraceRing *pRing, const BYTE *pRecord, int nSize)
+{
+	LONG nWrite = pRing->nWrite;
+	LONG nFree = TRACE_RING_SIZE - (nWrite - pRing->nRead);
+	int nOffset = nWrite & (TRACE_RING_SIZE - 1);
+	int nTail = TRACE_RING_SIZE - nOffset;
+	int nPad = nTail < nSize ? nTail : 0;
+	if (nFree < nPad + nSize)
+		return false;
+	if (nPad)
+	{
+		TraceRecord *pPad = (TraceRecord *)(pRing->pBuffer + nOffset);
+		pPad->nSize = (WORD)nPad;
+		pPad->nFlags = TraceRecord_Pad;
+		nOffset = 0;
+	}
+	memcpy(pRing->pBuffer + nOffset, pRecord, nSize);
+	// ¼д֮ƶдλ,̨̲߳ļ¼
+	InterlockedExchange(&pRing->nWrite, nWrite + nPad + nSize);
+	return true;
+}
+
+void DxTraceAsyncV(int nLevel, const char *pFormat, va_list args)
+{
+	if (!pFormat || !TraceInit())
+		return;
+	TraceRing *pRing = GetRing();
+	if (!pRing)
+		return;
+	DECLSPEC_ALIGN(8) BYTE szRecord[TRACE_MAX_RECORD];
+	TraceRecord *pRecord = (TraceRecord *)szRecord;
+	LARGE_INTEGER nCounter;
+	QueryPerformanceCounter(&nCounter);
+	pRecord->nLevel = (BYTE)nLevel;
+	pRecord->nFlags = 0;
+	pRecord->dwThreadId = pRing->dwThreadId;
+	pRecord->nTime = nCounter.QuadPart;
+	pRecord->pFormat = pFormat;
+	pRecord->nReserved = 0;
+
+	int nSize = 0;
+	bool bFormatNow = true;
+#ifdef TRACE_DEFERRED_FORMAT
+	// һֻĴС,ȷתӳٸʽ
+	int nArgSize = 0;
+	TraceArgType nType;
+	int nPrecision;
+	const char *p = pFormat;
+	while ((p = NextArg(p, nType, nPrecision)), nType != TraceArg_None)
+	{
+		if (nType == TraceArg_Unsupported)
+			break;
+		nArgSize += ArgSlotSize(nType);
+	}
+	bFormatNow = nType == TraceArg_Unsupported || TRACE_HEADER_SIZE + nArgSize + 2 * sizeof(WCHAR) > TRACE_MAX_RECORD;
+#endif
+	if (bFormatNow)
+	{// ڵ߳иʽ,¼ȵĲֱض
+		char *szText = (char *)szRecord + TRACE_HEADER_SIZE;
+		int nMaxText = TRACE_MAX_RECORD - TRACE_HEADER_SIZE;
+		int nText = _vsnprintf(szText, nMaxText - 1, pFormat, args);
+		if (nText < 0 || nText >= nMaxText - 1)	// ضʱMSVC-1,Cпⷵĳ
+			nText = nMaxText - 2;
+		szText[nText] = '\0';
+		pRecord->nFlags = TraceRecord_Text;
+		pRecord->pFormat = NULL;
+		pRecord->nArgSize = 0;
+		nSize = TRACE_HEADER_SIZE + nText + 1;
+	}
+#ifdef TRACE_DEFERRED_FORMAT
+	else
+	{// ڶ鰴va_listĲָƲ,ַ
+		BYTE *pArgs = szRecord + TRACE_HEADER_SIZE;
+		int nArgPos = 0;
+		int nStrPos = TRACE_HEADER_SIZE + nArgSize;
+		// ֽڱΪַ,¼ռþַָ
+		int nStrLimit = TRACE_MAX_RECORD - sizeof(WCHAR);
+		int nEmptyPos = nStrLimit;
+		*(WCHAR *)(szRecord + nEmptyPos) = 0;
+		bool bUseEmpty = false;
+		p = pFormat;
+		while ((p = NextArg(p, nType, nPrecision)), nType != TraceArg_None)
+		{
+			size_t nOffset = 0;
+			switch (nType)
+			{
+			case TraceArg_Int:
+				*(int *)(pArgs + nArgPos) = va_arg(args, int);
+				break;
+			case TraceArg_Int64:
+				*(__int64 *)(pArgs + nArgPos) = va_arg(args, __int64);
+				break;
+			case TraceArg_Double:
+				*(double *)(pArgs + nArgPos) = va_arg(args, double);
+				break;
+			case TraceArg_Ptr:
+				*(void **)(pArgs + nArgPos) = va_arg(args, void *);
+				break;
+			case TraceArg_String:
+			{
+				const char *szArg = va_arg(args, const char *);
+				if (!szArg)
+					szArg = "(null)";
+				int nMax = nStrLimit - nStrPos - 1;
+				if (nPrecision >= 0 && nPrecision < nMax)
+					nMax = nPrecision;
+				if (nMax < 0)
+				{
+					nOffset = nEmptyPos;
+					bUseEmpty = true;
+					break;
+				}
+				int nLen = 0;
+				while (nLen < nMax && szArg[nLen])
+				{
+					szRecord[nStrPos + nLen] = szArg[nLen];
+					nLen++;
+				}
+				szRecord[nStrPos + nLen] = '\0';
+				nOffset = nStrPos;
+				nStrPos += nLen + 1;
+				break;
+			}
+			case TraceArg_WString:
+			{
+				const WCHAR *szArg = va_arg(args, const WCHAR *);
+				if (!szArg)
+					szArg = L"(null)";
+				nStrPos = (nStrPos + 1) & ~1;
+				int nMax = (nStrLimit - nStrPos) / (int)sizeof(WCHAR) - 1;
+				if (nPrecision >= 0 && nPrecision < nMax)
+					nMax = nPrecision;
+				if (nMax < 0)
+				{
+					nOffset = nEmptyPos;
+					bUseEmpty = true;
+					break;
+				}
+				WCHAR *pDst = (WCHAR *)(szRecord + nStrPos);
+				int nLen = 0;
+				while (nLen < nMax && szArg[nLen])
+				{
+					pDst[nLen] = szArg[nLen];
+					nLen++;
+				}
+				pDst[nLen] = 0;
+				nOffset = nStrPos;
+				nStrPos += (nLen + 1) * sizeof(WCHAR);
+				break;
+			}
+			}
+			if (nType == TraceArg_String || nType == TraceArg_WString)
+				*(size_t *)(pArgs + nArgPos) = nOffset;
+			nArgPos += ArgSlotSize(nType);
+		}
+		pRecord->nArgSize = (WORD)nArgSize;
+		nSize = bUseEmpty ? TRACE_MAX_RECORD : nStrPos;
+	}
+#endif
+	nSize = TRACE_ALIGN(nSize);
+	pRecord->nSize = (WORD)nSize;
+	if (WriteRing(pRing, szRecord, nSize))
+		InterlockedIncrement(&pRing->nRecords);
+	else
+		InterlockedIncrement(&pRing->nDropped);
+}
+
+void DxTraceAsync(int nLevel, const char *pFormat, ...)
+{
+	va_list args;
+	va_start(args, pFormat);
+	DxTraceAsyncV(nLevel, pFormat, args);
+	va_end(args);
+}
+
+// ʽһ¼,pRecordΪ¼ĸ,ַƫﻻΪָ
+static int FormatRecord(TraceRecord *pRecord, char *szLine, int nLineSize)
+{
+	int nPrefix = _snprintf(szLine, nLineSize, "%10.6f [%5u] ", (pRecord->nTime - s_nBaseTime) / s_dfFrequency, pRecord->dwThreadId);
+	if (nPrefix < 0)
+		nPrefix = 0;
+	char *szText = szLine + nPrefix;
+	int nMaxText = nLineSize - nPrefix - 1;
+	int nText = 0;
+	if (pRecord->nFlags & TraceRecord_Text)
+		nText = _snprintf(szText, nMaxText, "%s", (char *)pRecord + TRACE_HEADER_SIZE);
+#ifdef TRACE_DEFERRED_FORMAT
+	else
+	{
+		BYTE *pArgs = (BYTE *)pRecord + TRACE_HEADER_SIZE;
+		int nArgPos = 0;
+		TraceArgType nType;
+		int nPrecision;
+		const char *p = pRecord->pFormat;
+		while ((p = NextArg(p, nType, nPrecision)), nType != TraceArg_None)
+		{
+			if (nType == TraceArg_String || nType == TraceArg_WString)
+				*(size_t *)(pArgs + nArgPos) = (size_t)pRecord + *(size_t *)(pArgs + nArgPos);
+			nArgPos += ArgSlotSize(nType);
+		}
+		// Ĳva_listһ,TRACE_DEFERRED_FORMAT˵
+		nText = _vsnprintf(szText, nMaxText, pRecord->pFormat, (va_list)pArgs);
+	}
+#endif
+	if (nText < 0 || nText >= nMaxText)
+		nText = nMaxText - 1;
+	szText[nText] = '\0';
+	return nPrefix + nText;
+}
+
+struct TraceEntry
+{
+	LONGLONG	nTime;
+	int			nOffset;		// ¼еλ
+	bool operator < (const TraceEntry &Entry) const
+	{
+		return nTime < Entry.nTime;
+	}
+};
+
+// ȡлλеļ¼,ʱ
+static void DrainRings()
+{
+	if (s_nInitState != 2)
+		return;
+	EnterCriticalSection(&s_csDrain);
+	// ڶϷҲͷ:TraceShutdownatexit˳ʱ,ʱڵľ̬Ѿ
+	static vector<BYTE> &vecRecord = *new vector<BYTE>;
+	static vector<TraceEntry> &vecEntry = *new vector<TraceEntry>;
+	vecRecord.clear();
+	vecEntry.clear();
+	int nRings = s_nRings;
+	for (int i = 0; i < nRings; i++)
+	{
+		TraceRing *pRing = s_pRings[i];
+		LONG nRead = pRing->nRead;
+		LONG nWrite = pRing->nWrite;
+		while (nRead != nWrite)
+		{
+			TraceRecord *pRecord = (TraceRecord *)(pRing->pBuffer + (nRead & (TRACE_RING_SIZE - 1)));
+			int nSize = pRecord->nSize;
+			if (!(pRecord->nFlags & TraceRecord_Pad))
+			{
+				TraceEntry Entry = { pRecord->nTime, (int)vecRecord.size() };
+				vecRecord.insert(vecRecord.end(), (BYTE *)pRecord, (BYTE *)pRecord + nSize);
+				vecEntry.push_back(Entry);
+			}
+			nRead += nSize;
+		}
+		InterlockedExchange(&pRing->nRead, nRead);
+		// ߳˳һѿ,̸߳
+		if (pRing->hThread && WaitForSingleObject(pRing->hThread, 0) == WAIT_OBJECT_0 && pRing->nWrite == nRead)
+		{
+			EnterCriticalSection(&s_csRings);
+			CloseHandle(pRing->hThread);
+			pRing->hThread = NULL;
+			pRing->bFree = TRUE;
+			LeaveCriticalSection(&s_csRings);
+		}
+	}
+	if (vecEntry.size())
+	{
+		// Ȱм¼ʽı,,ڼֻs_csDrain
+		// OutputDebugStringAڵʱ,ܳs_csRings,߳ȡûλͶȡͳƶᱻ
+		stable_sort(vecEntry.begin(), vecEntry.end());
+		static vector<char> &vecText = *new vector<char>;
+		static vector<int> &vecLine = *new vector<int>;			// ÿϢvecTextеʼλ
+		vecText.clear();
+		vecLine.clear();
+		char szLine[TRACE_MAX_RECORD * 4];
+		for (size_t i = 0; i < vecEntry.size(); i++)
+		{
+			// 8ֽڶ븴Ƶջ,vectorĴ洢֤Ķ
+			DECLSPEC_ALIGN(8) BYTE szRecord[TRACE_MAX_RECORD];
+			TraceRecord *pSrc = (TraceRecord *)&vecRecord[vecEntry[i].nOffset];
+			memcpy(szRecord, pSrc, pSrc->nSize);
+			int nLen = FormatRecord((TraceRecord *)szRecord, szLine, sizeof(szLine));
+			vecLine.push_back((int)vecText.size());
+			vecText.insert(vecText.end(), szLine, szLine + nLen + 1);
+		}
+		int nOutputs = s_nOutputs;
+		if (nOutputs & DXTRACE_OUTPUT_DEBUGGER)
+		{
+			for (size_t i = 0; i < vecLine.size(); i++)
+				OutputDebugStringA(&vecText[vecLine[i]]);
+		}
+		// ļͱ׼д,дÿĩβĿַ
+		for (size_t i = 0; i < vecLine.size(); i++)
+		{
+			int nLen = (i + 1 < vecLine.size() ? vecLine[i + 1] : (int)vecText.size()) - vecLine[i] - 1;
+			if ((nOutputs & DXTRACE_OUTPUT_FILE) && s_pFile)
+				fwrite(&vecText[vecLine[i]], 1, nLen, s_pFile);
+			if (nOutputs & DXTRACE_OUTPUT_STDOUT)
+				fwrite(&vecText[vecLine[i]], 1, nLen, stdout);
+		}
+		if (s_pFile)
+			fflush(s_pFile);
+		if (nOutputs & DXTRACE_OUTPUT_STDOUT)
+			fflush(stdout);
+		InterlockedExchangeAdd64(&s_nOutputCount, (LONGLONG)vecEntry.size());
+	}
+	LeaveCriticalSection(&s_csDrain);
+}
+
+static UINT __stdcall DrainThread(void *p)
+{
+	while (WaitForSingleObject(s_hEventExit, TRACE_DRAIN_INTERVAL) == WAIT_TIMEOUT)
+		DrainRings();
+	return 0;
+}
+
+bool DxTraceSetOutput(int nOutputs, const char *szFile)
+{
+	if (!TraceInit())
+		return false;
+	DrainRings();
+	bool bResult = true;
+	EnterCriticalSection(&s_csDrain);
+	if (s_pFile)
+	{
+		fclose(s_pFile);
+		s_pFile = NULL;
+	}
+	if ((nOutputs & DXTRACE_OUTPUT_FILE) && szFile)
+	{
+		s_pFile = fopen(szFile, "ab");
+		bResult = s_pFile != NULL;
+	}
+	InterlockedExchange(&s_nOutputs, nOutputs);
+	LeaveCriticalSection(&s_csDrain);
+	return bResult;
+}
+
+void DxTraceFlush()
+{
+	DrainRings();
+}
+
+void DxTraceGetStat(DxTraceStat &Stat)
+{
+	ZeroMemory(&Stat, sizeof(DxTraceStat));
+	if (!TraceInit())
+		return;
+	EnterCriticalSection(&s_csRings);
+	Stat.nRings = s_nRings;
+	for (int i = 0; i < s_nRings; i++)
+	{
+		Stat.nRecords += s_pRings[i]->nRecords;
+		Stat.nDropped += s_pRings[i]->nDropped;
+	}
+	Stat.nOutput = InterlockedCompareExchange64(&s_nOutputCount, 0, 0);
+	LeaveCriticalSection(&s_csRings);
+}
@@ -1,9 +1,59 @@
 #pragma once
+#include "Win32Port.h"
+#include <stdarg.h>
 
+// ,ֵԽԽϸ
+#define DXTRACE_ERROR		1
+#define DXTRACE_WARN		2
+#define DXTRACE_INFO		3
+#define DXTRACE_DEBUG		4
+
+// ڵļ,DXTRACE_LEVELĵֵͬһ𱻱ȥ
+#ifndef DXTRACE_LEVEL
 #ifdef _DEBUG
-#define DxTraceMsg	DxTrace
+#define DXTRACE_LEVEL		DXTRACE_DEBUG
 #else
-#define DxTraceMsg
+#define DXTRACE_LEVEL		DXTRACE_WARN
+#endif
 #endif
 
-void DxTrace(char *pFormat, ...);
\ No newline at end of file
+#define DxTraceLevel(nLevel, ...)	do { if ((nLevel) <= DXTRACE_LEVEL) DxTraceAsync((nLevel), __VA_ARGS__); } while (0)
+#define DxTraceError(...)			DxTraceLevel(DXTRACE_ERROR, __VA_ARGS__)
+#define DxTraceWarn(...)			DxTraceLevel(DXTRACE_WARN, __VA_ARGS__)
+#define DxTraceInfo(...)			DxTraceLevel(DXTRACE_INFO, __VA_ARGS__)
+#define DxTraceMsg(...)				DxTraceLevel(DXTRACE_DEBUG, __VA_ARGS__)
+
+// Ŀ,
+#define DXTRACE_OUTPUT_DEBUGGER		0x01	// OutputDebugString
+#define DXTRACE_OUTPUT_FILE			0x02
+#define DXTRACE_OUTPUT_STDOUT		0x04
+
+struct DxTraceStat
+{
+	LONGLONG	nRecords;		// Ѽ¼Ϣ
+	LONGLONG	nDropped;		// ̵߳ĻλϢ
+	LONGLONG	nOutput;		// Ϣ
+	LONG		nRings;			// Ѵ̻߳λ
+};
+
+// ͬ,ʽOutputDebugStringA,ֻڲӳٵĳ
+void DxTrace(char *pFormat, ...);
+
+/// @brief 첽
+/// @remark ֻ߳ѸʽַָͲƸƵ̵߳Ļλ,ʽҲں,
+/// ɺ̸̨߳ʽ;pFormatǳַ,%sڵʱ,ҪúȻЧ
+/// ʽк*Ȼ%nȲ֧ӳٵתʱ,ڵ߳иʽΪıٷ뻷λ
+/// ӳٸʽֻMSVCx86x64汾,ڵ߳иʽ,DxTrace.cppTRACE_DEFERRED_FORMAT˵
+/// λʱϢ,̴߳Ӳȴ
+void DxTraceAsync(int nLevel, const char *pFormat, ...);
+void DxTraceAsyncV(int nLevel, const char *pFormat, va_list args);
+
+/// @brief Ŀ,Ĭֻ
+/// @param nOutputs	DXTRACE_OUTPUT_*
+/// @param szFile	nOutputsDXTRACE_OUTPUT_FILEʱļ·,Ϣ׷ӵļĩβ
+bool DxTraceSetOutput(int nOutputs, const char *szFile = 0);
+
+// Ѽ¼Ϣ󷵻
+void DxTraceFlush();
+
+void DxTraceGetStat(DxTraceStat &Stat);
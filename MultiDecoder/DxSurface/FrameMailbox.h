@@ -0,0 +1,109 @@
+#pragma once
+#include "Win32Port.h"
+#include <stdint.h>
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define __STDC_CONSTANT_MACROS
+#include "libavutil/frame.h"
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+
+struct MailboxStat
+{
+	LONG	nPosted;		// Ͷݵ֡
+	LONG	nFetched;		// ȡߵ֡
+	LONG	nDropped;		// δȡ߼µ֡ǵ֡
+	LONG	nRepeated;		// ȡ֡ʱû֡,ֻظʾһ֡Ĵ
+};
+
+/// @brief ߵߵ֡,
+/// @remark ۷ֱ(̨)(ǰ̨)(м),Ͷݺȡֻ֡ǰԼĲмԭӽ,
+/// ˫ӲȴԷ;֡Ǹδȡߵľ֡,ÿȡĶµһ֡
+/// б֡,Ӳ֡
+class CFrameMailbox
+{
+public:
+	CFrameMailbox()
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			m_pSlot[i] = av_frame_alloc();
+			m_nPostTime[i] = 0;
+		}
+		m_nBack = 0;
+		m_nMiddle = 1;
+		m_nFront = 2;
+		ZeroMemory(&m_Stat, sizeof(MailboxStat));
+	}
+	~CFrameMailbox()
+	{
+		for (int i = 0; i < 3; i++)
+			av_frame_free(&m_pSlot[i]);
+	}
+
+	// Ͷһ֡,ֻ֡,ͼ;nPostTimeΪͶʱ,ȡ֡ʱԭ
+	void Post(AVFrame *pFrame, int64_t nPostTime = 0)
+	{
+		AVFrame *pBack = m_pSlot[m_nBack];
+		av_frame_unref(pBack);
+		if (av_frame_ref(pBack, pFrame) < 0)
+			return;
+		m_nPostTime[m_nBack] = nPostTime;
+		LONG nOld = InterlockedExchange(&m_nMiddle, m_nBack | Mailbox_NewFrame);
+		if (nOld & Mailbox_NewFrame)
+			InterlockedIncrement(&m_Stat.nDropped);
+		m_nBack = nOld & Mailbox_IndexMask;
+		// صĲѱʾ򱻶֡,ͷ,ռý
+		av_frame_unref(m_pSlot[m_nBack]);
+		InterlockedIncrement(&m_Stat.nPosted);
+	}
+
+	// ȡµһ֡,û֡ʱNULL;ص֡´ȡ֮֡ǰЧ
+	AVFrame *Fetch(int64_t *pPostTime = NULL)
+	{
+		if (!(m_nMiddle & Mailbox_NewFrame))
+		{
+			InterlockedIncrement(&m_Stat.nRepeated);
+			return NULL;
+		}
+		m_nFront = InterlockedExchange(&m_nMiddle, m_nFront) & Mailbox_IndexMask;
+		InterlockedIncrement(&m_Stat.nFetched);
+		if (pPostTime)
+			*pPostTime = m_nPostTime[m_nFront];
+		return m_pSlot[m_nFront];
+	}
+
+	// ͷве֡,ߺ߶ֹͣ
+	void Clear()
+	{
+		for (int i = 0; i < 3; i++)
+			av_frame_unref(m_pSlot[i]);
+		m_nMiddle &= Mailbox_IndexMask;
+	}
+
+	void GetStat(MailboxStat &Stat)
+	{
+		Stat.nPosted = m_Stat.nPosted;
+		Stat.nFetched = m_Stat.nFetched;
+		Stat.nDropped = m_Stat.nDropped;
+		Stat.nRepeated = m_Stat.nRepeated;
+	}
+private:
+	enum
+	{
+		Mailbox_IndexMask = 0x03,
+		Mailbox_NewFrame = 0x04,		// ме֡δȡ
+	};
+	AVFrame				*m_pSlot[3];
+	int64_t				m_nPostTime[3];		// ֡Ͷʱ,һ𽻻
+	LONG				m_nBack;		// ֻ߷
+	LONG				m_nFront;		// ֻ߷
+	volatile LONG		m_nMiddle;		// м۵żMailbox_NewFrame־
+	MailboxStat			m_Stat;
+};
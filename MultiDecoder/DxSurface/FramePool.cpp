@@ -0,0 +1,5 @@
+#include "FramePool.h"
+
+volatile LONG		CFramePool::m_nAllocs = 0;
+volatile LONGLONG	CFramePool::m_nAllocBytes = 0;
+CFramePool			g_FramePool;
@@ -0,0 +1,183 @@
+#pragma once
+#include "Win32Port.h"
+#include <map>
+#ifdef _WIN32
+#include <psapi.h>
+#endif
+#include "AutoLock.h"
+#include "AdaptiveLock.h"
+#include "DxTrace.h"
+#include "MemoryAccount.h"
+#include "MonoClock.h"
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define __STDC_CONSTANT_MACROS
+#define FF_API_PIX_FMT 0
+#include "libavutil/frame.h"
+#include "libavutil/buffer.h"
+#include "libavutil/imgutils.h"
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+#ifdef _WIN32
+#pragma comment(lib,"psapi.lib")
+#endif
+
+using namespace std;
+
+#define FRAMEPOOL_ALIGN		32		// ͼƽʼַпĶֽ
+
+// ֡صļֵ,;ظʽͳߴȫһµͼܹͬһ
+struct FramePoolKey
+{
+	MemoryTag		nTag;
+	AVPixelFormat	nFormat;
+	int				nWidth;
+	int				nHeight;
+
+	bool operator < (const FramePoolKey &Key) const
+	{
+		if (nTag != Key.nTag)
+			return nTag < Key.nTag;
+		if (nFormat != Key.nFormat)
+			return nFormat < Key.nFormat;
+		if (nWidth != Key.nWidth)
+			return nWidth < Key.nWidth;
+		return nHeight < Key.nHeight;
+	}
+};
+
+struct FramePoolStat
+{
+	LONG		nPools;			// ,ͬʽͳߴ
+	LONG		nGets;			// ȡûĴ
+	LONG		nAllocs;		// ʵʷĴ
+	LONGLONG	nAllocBytes;	// ʵʷֽ
+};
+
+// ̼ͼ֡
+// 롢תȾͼ񻺳ȡ,ü,һͷźԶ黹ӦĻ,
+// ȶкڴ;ȡAVBufferPool,ƽ治ʼ,д
+class CFramePool
+{
+public:
+	CFramePool()
+	{
+		ZeroMemory(&m_Stat, sizeof(FramePoolStat));
+		m_nLastTraceTime = MonoTimeNs();
+		m_nLastTraceAllocs = 0;
+	}
+	~CFramePool()
+	{
+		for (auto it = m_mapPool.begin(); it != m_mapPool.end(); it++)
+			av_buffer_pool_uninit(&it->second);		// еĻȫ黹Żͷ
+		m_mapPool.clear();
+	}
+
+	/// @brief ΪpFrameһ黺еͼ񻺳
+	/// @param nTag	;,ֻΪMemTag_FramePoolMemTag_Convert,ͬ;ĻʹøԵĻ,ֱͳ
+	/// @remark pFrameԭеĻȱͷ,û黹Ļ
+	/// ԷͬһAVFrameȡû,ӶAVFrameķҲԱ
+	/// ʵʷʱ߳ͨ,˺ڸͨ临ʱٸı
+	bool GetFrameBuffer(AVFrame *pFrame, AVPixelFormat nFormat, int nWidth, int nHeight, MemoryTag nTag = MemTag_FramePool)
+	{
+		av_frame_unref(pFrame);
+		if (nTag != MemTag_Convert)
+			nTag = MemTag_FramePool;
+		FramePoolKey Key = { nTag, nFormat, nWidth, nHeight };
+		AVBufferPool *pPool = NULL;
+		{
+			MUTEX_LOCK(m_csPool);
+			auto itFind = m_mapPool.find(Key);
+			if (itFind != m_mapPool.end())
+				pPool = itFind->second;
+			else
+			{
+				int nSize = av_image_get_buffer_size(nFormat, nWidth, nHeight, FRAMEPOOL_ALIGN);
+				if (nSize < 0)
+				{
+					DxTraceMsg("%s av_image_get_buffer_size failed(fmt %d %dx%d).\n", __FUNCTION__, nFormat, nWidth, nHeight);
+					return false;
+				}
+				// Ŀռ,֤ƽʼַFRAMEPOOL_ALIGN
+				pPool = av_buffer_pool_init(nSize + FRAMEPOOL_ALIGN, nTag == MemTag_Convert ? AllocBuffer<MemTag_Convert> : AllocBuffer<MemTag_FramePool>);
+				if (!pPool)
+					return false;
+				m_mapPool.insert(pair<FramePoolKey, AVBufferPool *>(Key, pPool));
+				m_Stat.nPools++;
+			}
+		}
+		AVBufferRef *pBuffer = av_buffer_pool_get(pPool);
+		if (!pBuffer)
+			return false;
+		InterlockedIncrement(&m_Stat.nGets);
+		uint8_t *pData = (uint8_t *)FFALIGN((size_t)pBuffer->data, FRAMEPOOL_ALIGN);
+		av_image_fill_arrays(pFrame->data, pFrame->linesize, pData, nFormat, nWidth, nHeight, FRAMEPOOL_ALIGN);
+		pFrame->buf[0] = pBuffer;
+		pFrame->width = nWidth;
+		pFrame->height = nHeight;
+		pFrame->format = nFormat;
+		return true;
+	}
+
+	// һµAVFrame,av_frame_freeͷ
+	AVFrame *GetFrame(AVPixelFormat nFormat, int nWidth, int nHeight, MemoryTag nTag = MemTag_FramePool)
+	{
+		AVFrame *pFrame = av_frame_alloc();
+		if (pFrame && !GetFrameBuffer(pFrame, nFormat, nWidth, nHeight, nTag))
+			av_frame_free(&pFrame);
+		return pFrame;
+	}
+
+	void GetStat(FramePoolStat &Stat)
+	{
+		MUTEX_LOCK(m_csPool);
+		memcpy(&Stat, &m_Stat, sizeof(FramePoolStat));
+		Stat.nAllocs = m_nAllocs;
+		Stat.nAllocBytes = m_nAllocBytes;
+	}
+
+	// ϴÿķ͵ǰ̵ĹС,ƽ̨²ȡ
+	void TraceStat()
+	{
+		FramePoolStat Stat;
+		GetStat(Stat);
+		size_t nWorkingSet = 0;
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS pmc;
+		ZeroMemory(&pmc, sizeof(pmc));
+		if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+			nWorkingSet = pmc.WorkingSetSize;
+#endif
+		int64_t nNow = MonoTimeNs();
+		int64_t nSpan = nNow - m_nLastTraceTime;
+		double dfAllocsPerSecond = nSpan > 0 ? (double)(Stat.nAllocs - m_nLastTraceAllocs) * MONO_NS_PER_SEC / nSpan : 0.0f;
+		m_nLastTraceTime = nNow;
+		m_nLastTraceAllocs = Stat.nAllocs;
+		DxTraceMsg("%s Pools = %d\tGets = %d\tAllocs = %d(%lld KB)\tAllocs/s = %.2f\tWorkingSet = %d KB.\n", __FUNCTION__,
+					Stat.nPools, Stat.nGets, Stat.nAllocs, (long long)(Stat.nAllocBytes / 1024), dfAllocsPerSecond, (int)(nWorkingSet / 1024));
+	}
+private:
+	// AVBufferPoolķ亯ûû,;ֱʵ
+	template <MemoryTag nTag>
+	static AVBufferRef *AllocBuffer(int nSize)
+	{
+		InterlockedIncrement(&m_nAllocs);
+		InterlockedExchangeAdd64(&m_nAllocBytes, nSize);
+		return g_MemoryAccount.AllocBuffer(nTag, nSize);
+	}
+	CSpinMutex				m_csPool;
+	map<FramePoolKey, AVBufferPool*> m_mapPool;
+	FramePoolStat			m_Stat;
+	int64_t					m_nLastTraceTime;	// ȡMonoTimeNs
+	LONG					m_nLastTraceAllocs;
+	static volatile LONG	m_nAllocs;
+	static volatile LONGLONG m_nAllocBytes;
+};
+
+extern CFramePool g_FramePool;
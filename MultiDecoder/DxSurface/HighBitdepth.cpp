@@ -0,0 +1,114 @@
+#include "HighBitdepth.h"
+#ifdef PIXELCOPY_SSE2
+#include <emmintrin.h>
+#endif
+
+// 4x4 Bayer򶶶,ȡֵ0~15
+static const BYTE s_nBayer4x4[4][4] =
+{
+	{ 0, 8, 2, 10 },
+	{ 12, 4, 14, 6 },
+	{ 3, 11, 1, 9 },
+	{ 15, 7, 13, 5 }
+};
+
+// ѶֵŵصĵλķΧ,[0,(1<<nShift))
+#define DitherValue(nRow, nCol, nShift)	((s_nBayer4x4[(nRow) & 3][(nCol) & 3] << (nShift)) >> 4)
+
+static inline BYTE Dither10Bit(WORD nSample, int nDither, int nShift)
+{
+	int nValue = (nSample + nDither) >> nShift;
+	return nValue > 255 ? 255 : (BYTE)nValue;
+}
+
+void Convert10BitPlane_C(BYTE *pDst, int nDstPitch, const BYTE *pSrc, int nSrcPitch, int nWidth, int nHeight, int nShift)
+{
+	for (int y = 0; y < nHeight; y++)
+	{
+		const WORD *pSrcRow = (const WORD *)(pSrc + y*nSrcPitch);
+		BYTE *pDstRow = pDst + y*nDstPitch;
+		for (int x = 0; x < nWidth; x++)
+			pDstRow[x] = Dither10Bit(pSrcRow[x], DitherValue(y, x, nShift), nShift);
+	}
+}
+
+void SplitUV10Bit_C(BYTE *pDstU, BYTE *pDstV, int nDstPitch, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight, int nShift)
+{
+	for (int y = 0; y < nHeight; y++)
+	{
+		const WORD *pSrcRow = (const WORD *)(pSrcUV + y*nSrcPitch);
+		BYTE *pDstURow = pDstU + y*nDstPitch;
+		BYTE *pDstVRow = pDstV + y*nDstPitch;
+		for (int x = 0; x < nWidth; x++)
+		{
+			int nDither = DitherValue(y, x, nShift);
+			pDstURow[x] = Dither10Bit(pSrcRow[2 * x], nDither, nShift);
+			pDstVRow[x] = Dither10Bit(pSrcRow[2 * x + 1], nDither, nShift);
+		}
+	}
+}
+
+#ifdef PIXELCOPY_SSE2
+// ÿδ16,Ӷʱʹ޷űͼӷ,λֵΪ256,_mm_packus_epi16͵255,C汾Ľһ
+void Convert10BitPlane_SSE2(BYTE *pDst, int nDstPitch, const BYTE *pSrc, int nSrcPitch, int nWidth, int nHeight, int nShift)
+{
+	__m128i xmmShift = _mm_cvtsi32_si128(nShift);
+	for (int y = 0; y < nHeight; y++)
+	{
+		const WORD *pSrcRow = (const WORD *)(pSrc + y*nSrcPitch);
+		BYTE *pDstRow = pDst + y*nDstPitch;
+		__m128i xmmDither = _mm_set_epi16(DitherValue(y, 3, nShift), DitherValue(y, 2, nShift), DitherValue(y, 1, nShift), DitherValue(y, 0, nShift),
+										  DitherValue(y, 3, nShift), DitherValue(y, 2, nShift), DitherValue(y, 1, nShift), DitherValue(y, 0, nShift));
+		int x = 0;
+		for (; x + 16 <= nWidth; x += 16)
+		{
+			__m128i xmm0 = _mm_loadu_si128((const __m128i *)(pSrcRow + x));
+			__m128i xmm1 = _mm_loadu_si128((const __m128i *)(pSrcRow + x + 8));
+			xmm0 = _mm_srl_epi16(_mm_adds_epu16(xmm0, xmmDither), xmmShift);
+			xmm1 = _mm_srl_epi16(_mm_adds_epu16(xmm1, xmmDither), xmmShift);
+			_mm_storeu_si128((__m128i *)(pDstRow + x), _mm_packus_epi16(xmm0, xmm1));
+		}
+		for (; x < nWidth; x++)
+			pDstRow[x] = Dither10Bit(pSrcRow[x], DitherValue(y, x, nShift), nShift);
+	}
+}
+
+// ÿδ8UV,Uλÿ32λԪĵ16λ,Vλڸ16λ
+void SplitUV10Bit_SSE2(BYTE *pDstU, BYTE *pDstV, int nDstPitch, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight, int nShift)
+{
+	__m128i xmmShift = _mm_cvtsi32_si128(nShift);
+	__m128i xmmMask = _mm_set1_epi32(0x0000FFFF);
+	for (int y = 0; y < nHeight; y++)
+	{
+		const WORD *pSrcRow = (const WORD *)(pSrcUV + y*nSrcPitch);
+		BYTE *pDstURow = pDstU + y*nDstPitch;
+		BYTE *pDstVRow = pDstV + y*nDstPitch;
+		__m128i xmmDither = _mm_set_epi16(DitherValue(y, 3, nShift), DitherValue(y, 3, nShift), DitherValue(y, 2, nShift), DitherValue(y, 2, nShift),
+										  DitherValue(y, 1, nShift), DitherValue(y, 1, nShift), DitherValue(y, 0, nShift), DitherValue(y, 0, nShift));
+		int x = 0;
+		for (; x + 8 <= nWidth; x += 8)
+		{
+			__m128i xmm0 = _mm_loadu_si128((const __m128i *)(pSrcRow + 2 * x));
+			__m128i xmm1 = _mm_loadu_si128((const __m128i *)(pSrcRow + 2 * x + 8));
+			xmm0 = _mm_srl_epi16(_mm_adds_epu16(xmm0, xmmDither), xmmShift);
+			xmm1 = _mm_srl_epi16(_mm_adds_epu16(xmm1, xmmDither), xmmShift);
+			__m128i xmmU = _mm_packs_epi32(_mm_and_si128(xmm0, xmmMask), _mm_and_si128(xmm1, xmmMask));
+			__m128i xmmV = _mm_packs_epi32(_mm_srli_epi32(xmm0, 16), _mm_srli_epi32(xmm1, 16));
+			_mm_storel_epi64((__m128i *)(pDstURow + x), _mm_packus_epi16(xmmU, xmmU));
+			_mm_storel_epi64((__m128i *)(pDstVRow + x), _mm_packus_epi16(xmmV, xmmV));
+		}
+		for (; x < nWidth; x++)
+		{
+			int nDither = DitherValue(y, x, nShift);
+			pDstURow[x] = Dither10Bit(pSrcRow[2 * x], nDither, nShift);
+			pDstVRow[x] = Dither10Bit(pSrcRow[2 * x + 1], nDither, nShift);
+		}
+	}
+}
+
+Convert10BitPlaneProc Convert10BitPlane = CpuSupportsSSE2() ? Convert10BitPlane_SSE2 : Convert10BitPlane_C;
+SplitUV10BitProc SplitUV10Bit = CpuSupportsSSE2() ? SplitUV10Bit_SSE2 : SplitUV10Bit_C;
+#else
+Convert10BitPlaneProc Convert10BitPlane = Convert10BitPlane_C;
+SplitUV10BitProc SplitUV10Bit = SplitUV10Bit_C;
+#endif
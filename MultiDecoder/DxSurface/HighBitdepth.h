@@ -0,0 +1,68 @@
+#pragma once
+#include "PixelCopy.h"
+
+// λ(10bit)ͼתΪ8bitͼ
+// P010:		DXVAӲ10bit HEVCıʽ,Yƽ֮UV֯ƽ,ÿռ16λ,Чڸ10λ
+// YUV420P10:	FFMPEG10bit HEVCĸʽ,YUVƽ,ÿռ16λ,Чڵ10λ
+// ֱӽضϵλƽĽԵɫ,תʱ4x4򶶶(Bayer),صĵλķΧ
+#define P010_SHIFT			8		// P010ȡ8λҪƵλ
+#define YUV420P10_SHIFT		2		// YUV420P10ȡ8λҪƵλ
+
+// һ16λƽתΪ8λƽ
+// nWidthΪÿеĲ,nSrcPitchnDstPitchֽΪλ
+typedef void(*Convert10BitPlaneProc)(BYTE *pDst, int nDstPitch, const BYTE *pSrc, int nSrcPitch, int nWidth, int nHeight, int nShift);
+
+// 16λUV֯ƽתΪ8λUVƽ
+// nWidthΪÿUVԵĸ
+typedef void(*SplitUV10BitProc)(BYTE *pDstU, BYTE *pDstV, int nDstPitch, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight, int nShift);
+
+// CPUѡת,֧SSE2ʱʹSSE2汾,ʹC汾
+extern Convert10BitPlaneProc Convert10BitPlane;
+extern SplitUV10BitProc SplitUV10Bit;
+
+// C汾,ΪSSE2汾Ĳοʵ,ߵֽһ
+void Convert10BitPlane_C(BYTE *pDst, int nDstPitch, const BYTE *pSrc, int nSrcPitch, int nWidth, int nHeight, int nShift);
+void SplitUV10Bit_C(BYTE *pDstU, BYTE *pDstV, int nDstPitch, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight, int nShift);
+#ifdef PIXELCOPY_SSE2
+void Convert10BitPlane_SSE2(BYTE *pDst, int nDstPitch, const BYTE *pSrc, int nSrcPitch, int nWidth, int nHeight, int nShift);
+void SplitUV10Bit_SSE2(BYTE *pDstU, BYTE *pDstV, int nDstPitch, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight, int nShift);
+#endif
+
+/// @brief P010תΪYUV420Pͼ
+/// @param pDst			ĿͼYUVƽĵַ
+/// @param nDstPitch	Ŀͼƽп
+/// @param pSrc			P010ݵʼַ
+/// @param nSrcPitch	P010п
+/// @param nSurfaceHeight P010ĸ߶,UVƽλYƽ֮nSrcPitch*nSurfaceHeight
+/// @param nWidth		ͼ
+/// @param nHeight		ͼ߶
+inline void CopyP010ToYUV420P(BYTE *pDst[3], int nDstPitch[3], const BYTE *pSrc, int nSrcPitch, int nSurfaceHeight, int nWidth, int nHeight)
+{
+	Convert10BitPlane(pDst[0], nDstPitch[0], pSrc, nSrcPitch, nWidth, nHeight, P010_SHIFT);
+	SplitUV10Bit(pDst[1], pDst[2], nDstPitch[1], pSrc + nSrcPitch*nSurfaceHeight, nSrcPitch, (nWidth + 1) / 2, (nHeight + 1) / 2, P010_SHIFT);
+}
+
+/// @brief P010תΪNV12
+/// @remark UVƽ水֯Ĳת,Ҫ
+inline void CopyP010ToNV12(BYTE *pDst, int nDstPitch, int nDstHeight, const BYTE *pSrc, int nSrcPitch, int nSurfaceHeight, int nWidth, int nHeight)
+{
+	Convert10BitPlane(pDst, nDstPitch, pSrc, nSrcPitch, nWidth, nHeight, P010_SHIFT);
+	Convert10BitPlane(pDst + nDstPitch*nDstHeight, nDstPitch, pSrc + nSrcPitch*nSurfaceHeight, nSrcPitch, ((nWidth + 1) / 2) * 2, (nHeight + 1) / 2, P010_SHIFT);
+}
+
+/// @brief YUV420P10ͼתΪYUV420Pͼ
+inline void CopyYUV420P10ToYUV420P(BYTE *pDst[3], int nDstPitch[3], BYTE *const pSrc[3], const int nSrcPitch[3], int nWidth, int nHeight)
+{
+	Convert10BitPlane(pDst[0], nDstPitch[0], pSrc[0], nSrcPitch[0], nWidth, nHeight, YUV420P10_SHIFT);
+	Convert10BitPlane(pDst[1], nDstPitch[1], pSrc[1], nSrcPitch[1], (nWidth + 1) / 2, (nHeight + 1) / 2, YUV420P10_SHIFT);
+	Convert10BitPlane(pDst[2], nDstPitch[2], pSrc[2], nSrcPitch[2], (nWidth + 1) / 2, (nHeight + 1) / 2, YUV420P10_SHIFT);
+}
+
+/// @brief P010תΪYV12,nDstHeightΪYV12ĸ߶
+inline void CopyP010ToYV12(BYTE *pDst, int nDstPitch, int nDstHeight, const BYTE *pSrc, int nSrcPitch, int nSurfaceHeight, int nWidth, int nHeight)
+{
+	BYTE *pPlane[3];
+	int nPlanePitch[3];
+	GetYV12Planes(pDst, nDstPitch, nDstHeight, pPlane, nPlanePitch);
+	CopyP010ToYUV420P(pPlane, nPlanePitch, pSrc, nSrcPitch, nSurfaceHeight, nWidth, nHeight);
+}
@@ -0,0 +1,213 @@
+#include "LatencyHistogram.h"
+
+CLatencyMonitor g_LatencyMonitor;
+
+static const char *s_szStageName[LatencyStage_Count] =
+{
+	"Read", "QueueWait", "Decode", "Download", "Convert", "Upload", "Present"
+};
+
+void CLatencyHistogram::GetSnapshot(LatencyStageSnapshot &Snapshot) const
+{
+	ZeroMemory(&Snapshot, sizeof(LatencyStageSnapshot));
+	// д߳̿ڸ,ԸͰ֮Ϊ׼
+	LONG nBuckets[LATENCY_BUCKETS];
+	LONG nCount = 0;
+	double dfTotal = 0.0f;
+	for (int i = 0; i < LATENCY_BUCKETS; i++)
+	{
+		nBuckets[i] = m_nBuckets[i];
+		nCount += nBuckets[i];
+		dfTotal += (double)nBuckets[i] * BucketValue(i);
+	}
+	if (!nCount)
+		return;
+	Snapshot.nCount = nCount;
+	Snapshot.dfMean = dfTotal / nCount;
+	Snapshot.nMax = m_nMax;
+	double dfPercent[4] = { 0.5f, 0.9f, 0.99f, 0.999f };
+	DWORD *pResult[4] = { &Snapshot.nP50, &Snapshot.nP90, &Snapshot.nP99, &Snapshot.nP999 };
+	LONG nSum = 0;
+	int nIndex = 0;
+	for (int i = 0; i < LATENCY_BUCKETS && nIndex < 4; i++)
+	{
+		nSum += nBuckets[i];
+		while (nIndex < 4 && nSum >= (LONG)(dfPercent[nIndex] * nCount + 0.5f) && nSum > 0)
+			*pResult[nIndex++] = BucketValue(i);
+	}
+}
+
+CLatencyMonitor::CLatencyMonitor()
+{
+	InitializeCriticalSection(&m_csChannel);
+	m_nResetTime = -1;
+	m_dfSampleCost = 0.0f;
+}
+
+CLatencyMonitor::~CLatencyMonitor()
+{
+	for (int i = 0; i < m_vecChannel.size(); i++)
+		delete m_vecChannel[i];
+	m_vecChannel.clear();
+	for (int i = 0; i < m_vecActive.size(); i++)
+		delete m_vecActive[i].pLatency;
+	m_vecActive.clear();
+	DeleteCriticalSection(&m_csChannel);
+}
+
+CChannelLatency *CLatencyMonitor::GetChannel(int nChannel)
+{
+	if (nChannel < 0)
+		return NULL;
+	CAutoLock lock(&m_csChannel);
+	if (m_nResetTime < 0)
+		m_nResetTime = MonoTimeNs();
+	while (m_vecChannel.size() <= nChannel)
+	{
+		CChannelLatency *pChannel = new CChannelLatency;
+		pChannel->Reset();
+		m_vecChannel.push_back(pChannel);
+	}
+	return m_vecChannel[nChannel];
+}
+
+int CLatencyMonitor::GetChannelCount()
+{
+	CAutoLock lock(&m_csChannel);
+	int nCount = m_vecChannel.size();
+	for (int i = 0; i < m_vecActive.size(); i++)
+	{
+		if (m_vecActive[i].nChannel >= nCount)
+			nCount = m_vecActive[i].nChannel + 1;
+	}
+	return nCount;
+}
+
+CChannelLatency *CLatencyMonitor::AddChannel(int nChannel)
+{
+	if (nChannel < 0)
+		return NULL;
+	CChannelLatency *pLatency = new CChannelLatency;
+	pLatency->Reset();
+	ActiveLatency Active = { nChannel, pLatency };
+	CAutoLock lock(&m_csChannel);
+	if (m_nResetTime < 0)
+		m_nResetTime = MonoTimeNs();
+	m_vecActive.push_back(Active);
+	return pLatency;
+}
+
+void CLatencyMonitor::RemoveChannel(CChannelLatency *pLatency)
+{
+	if (!pLatency)
+		return;
+	// ƳͲͬһμ,ЩȲȱҲظ
+	CAutoLock lock(&m_csChannel);
+	for (auto it = m_vecActive.begin(); it != m_vecActive.end(); it++)
+	{
+		if (it->pLatency == pLatency)
+		{
+			GetChannel(it->nChannel)->Merge(*pLatency);
+			m_vecActive.erase(it);
+			delete pLatency;
+			break;
+		}
+	}
+}
+
+void CLatencyMonitor::MergeChannel(int nChannel, CChannelLatency &Merged)
+{
+	if (nChannel < m_vecChannel.size())
+		Merged.Merge(*m_vecChannel[nChannel]);
+	for (int i = 0; i < m_vecActive.size(); i++)
+	{
+		if (m_vecActive[i].nChannel == nChannel)
+			Merged.Merge(*m_vecActive[i].pLatency);
+	}
+}
+
+bool CLatencyMonitor::GetSnapshot(int nChannel, LatencySnapshot &Snapshot)
+{
+	ZeroMemory(&Snapshot, sizeof(LatencySnapshot));
+	Snapshot.nChannel = nChannel;
+	int nChannels = GetChannelCount();
+	if (nChannel != LATENCY_ALL_CHANNELS && (nChannel < 0 || nChannel >= nChannels))
+		return false;
+	CChannelLatency *pMerged = new CChannelLatency;
+	pMerged->Reset();
+	{
+		CAutoLock lock(&m_csChannel);
+		if (nChannel != LATENCY_ALL_CHANNELS)
+			MergeChannel(nChannel, *pMerged);
+		else
+		{
+			for (int i = 0; i < m_vecChannel.size(); i++)
+				pMerged->Merge(*m_vecChannel[i]);
+			for (int i = 0; i < m_vecActive.size(); i++)
+				pMerged->Merge(*m_vecActive[i].pLatency);
+		}
+	}
+	for (int i = 0; i < LatencyStage_Count; i++)
+		pMerged->GetHistogram((LatencyStage)i).GetSnapshot(Snapshot.Stage[i]);
+	delete pMerged;
+	return true;
+}
+
+void CLatencyMonitor::Reset()
+{
+	CAutoLock lock(&m_csChannel);
+	for (int i = 0; i < m_vecChannel.size(); i++)
+		m_vecChannel[i]->Reset();
+	for (int i = 0; i < m_vecActive.size(); i++)
+		m_vecActive[i].pLatency->Reset();
+	m_nResetTime = MonoTimeNs();
+}
+
+double CLatencyMonitor::Calibrate(int nSamples)
+{
+	if (nSamples <= 0)
+		return 0.0f;
+	CChannelLatency *pChannel = new CChannelLatency;
+	pChannel->Reset();
+	int64_t nStart = MonoTimeNs();
+	for (int i = 0; i < nSamples; i++)
+	{
+		int64_t nT1 = MonoTimeNs();
+		pChannel->Record((LatencyStage)(i % LatencyStage_Count), nT1, MonoTimeNs());
+	}
+	double dfCost = (double)(MonoTimeNs() - nStart) / nSamples;
+	delete pChannel;
+	m_dfSampleCost = dfCost;
+	return dfCost;
+}
+
+void CLatencyMonitor::TraceStat()
+{
+	LatencySnapshot Snapshot;
+	GetSnapshot(LATENCY_ALL_CHANNELS, Snapshot);
+	LONGLONG nSamples = 0;
+	for (int i = 0; i < LatencyStage_Count; i++)
+	{
+		LatencyStageSnapshot &Stage = Snapshot.Stage[i];
+		nSamples += Stage.nCount;
+		if (!Stage.nCount)
+			continue;
+		DxTraceMsg("%s %-10s Count = %d\tMean = %.1fus\tP50 = %dus\tP90 = %dus\tP99 = %dus\tP99.9 = %dus\tMax = %dus.\n", __FUNCTION__,
+					s_szStageName[i], Stage.nCount, Stage.dfMean, Stage.nP50, Stage.nP90, Stage.nP99, Stage.nP999, Stage.nMax);
+	}
+	if (!m_dfSampleCost)
+		Calibrate();
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	double dfSpan = m_nResetTime >= 0 ? MonoNsToSeconds(MonoTimeNs() - m_nResetTime) : 0.0f;
+	double dfOverhead = dfSpan > 0.0f ? nSamples * m_dfSampleCost / 1000000000 / (dfSpan * si.dwNumberOfProcessors) : 0.0f;
+	DxTraceMsg("%s Channels = %d\tSamples = %lld\tCost/Sample = %.1fns\tOverhead = %.4f%% of %d CPUs.\n", __FUNCTION__,
+				GetChannelCount(), (long long)nSamples, m_dfSampleCost, dfOverhead * 100, si.dwNumberOfProcessors);
+}
+
+const char *CLatencyMonitor::GetStageName(LatencyStage nStage)
+{
+	if (nStage < 0 || nStage >= LatencyStage_Count)
+		return "Unknown";
+	return s_szStageName[nStage];
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include "Win32Port.h"
+#include <vector>
+#include "AutoLock.h"
+#include "DxTrace.h"
+#include "MonoClock.h"
+
+using namespace std;
+
+#define LATENCY_SUB_BITS		4								// ÿ2پΪ2^LATENCY_SUB_BITSͰ,1/16
+#define LATENCY_SUB_COUNT		(1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS			(LATENCY_SUB_COUNT * (33 - LATENCY_SUB_BITS))	// 0~2^32-1΢
+#define LATENCY_ALL_CHANNELS	-1								// GetSnapshotȡͨĻ
+
+// ˮߵĸ׶
+enum LatencyStage
+{
+	LatencyStage_Read = 0,		// ȡѹ֡,Ӳ·InputThreadԤȶڴ,
+	LatencyStage_QueueWait,		// ֡Ⱦ߳еȴʱ
+	LatencyStage_Decode,		// 
+	LatencyStage_Download,		// ӽ渴Ƶڴ
+	LatencyStage_Convert,		// ظʽת
+	LatencyStage_Upload,		// Ƶʾ
+	LatencyStage_Present,		// 쵽̨Present
+	LatencyStage_Count
+};
+
+struct LatencyStageSnapshot
+{
+	LONG		nCount;			// 
+	double		dfMean;			// ʱ䵥λΪ΢
+	DWORD		nP50;
+	DWORD		nP90;
+	DWORD		nP99;
+	DWORD		nP999;
+	DWORD		nMax;
+};
+
+struct LatencySnapshot
+{
+	int						nChannel;		// ͨ,LATENCY_ALL_CHANNELSΪͨĻ
+	LatencyStageSnapshot	Stage[LatencyStage_Count];
+};
+
+/// @brief Ͱӳֱͼ
+/// @remark ΢Ϊλ,СLATENCY_SUB_COUNTֵռһͰ,ֵλڵ2,ÿپΪLATENCY_SUB_COUNTͰ,
+/// ¼һֻһλɨһμӷ,ڴҲ;ͬһֱͼֻһ߳д,ȡʱд벢,õǽƵĿ
+/// гԱȫΪ0ΪЧĳʼ״̬
+class CLatencyHistogram
+{
+public:
+	// nNsΪ,¼ʱضΪ΢
+	void Record(int64_t nNs)
+	{
+		DWORD nValue = nNs > 0 ? (nNs < 0xFFFFFFFFLL * MONO_NS_PER_US ? (DWORD)(nNs / MONO_NS_PER_US) : 0xFFFFFFFF) : 0;
+		m_nBuckets[BucketIndex(nValue)]++;
+		m_nCount++;
+		if (nValue > m_nMax)
+			m_nMax = nValue;
+	}
+
+	void Reset()
+	{
+		ZeroMemory((void *)this, sizeof(CLatencyHistogram));
+	}
+
+	// Histogramۼӵֱͼ
+	void Merge(const CLatencyHistogram &Histogram)
+	{
+		for (int i = 0; i < LATENCY_BUCKETS; i++)
+			m_nBuckets[i] += Histogram.m_nBuckets[i];
+		m_nCount += Histogram.m_nCount;
+		if (Histogram.m_nMax > m_nMax)
+			m_nMax = Histogram.m_nMax;
+	}
+
+	LONG GetCount() const
+	{
+		return m_nCount;
+	}
+
+	void GetSnapshot(LatencyStageSnapshot &Snapshot) const;
+
+	static int BucketIndex(DWORD nValue)
+	{
+		if (nValue < LATENCY_SUB_COUNT)
+			return nValue;
+		DWORD nMsb = 0;
+		_BitScanReverse(&nMsb, nValue);
+		int nShift = nMsb - LATENCY_SUB_BITS;
+		return LATENCY_SUB_COUNT * (nShift + 1) + (int)((nValue >> nShift) - LATENCY_SUB_COUNT);
+	}
+	// Ͱֵ,ȡͰе
+	static DWORD BucketValue(int nIndex)
+	{
+		if (nIndex < LATENCY_SUB_COUNT)
+			return nIndex;
+		int nShift = nIndex / LATENCY_SUB_COUNT - 1;
+		DWORD nLower = (DWORD)(LATENCY_SUB_COUNT + nIndex % LATENCY_SUB_COUNT) << nShift;
+		return nLower + ((1 << nShift) >> 1);
+	}
+private:
+	volatile LONG		m_nBuckets[LATENCY_BUCKETS];
+	volatile LONG		m_nCount;
+	volatile DWORD		m_nMax;
+};
+
+// һͨ׶εӳֱͼ
+class CChannelLatency
+{
+public:
+	// nT1nT2ΪMonoTimeNsȡõĽ׶ֹʱ
+	void Record(LatencyStage nStage, int64_t nT1, int64_t nT2)
+	{
+		m_Histogram[nStage].Record(nT2 - nT1);
+	}
+	const CLatencyHistogram &GetHistogram(LatencyStage nStage) const
+	{
+		return m_Histogram[nStage];
+	}
+	void Reset()
+	{
+		for (int i = 0; i < LatencyStage_Count; i++)
+			m_Histogram[i].Reset();
+	}
+	void Merge(const CChannelLatency &Latency)
+	{
+		for (int i = 0; i < LatencyStage_Count; i++)
+			m_Histogram[i].Merge(Latency.m_Histogram[i]);
+	}
+private:
+	CLatencyHistogram	m_Histogram[LatencyStage_Count];
+};
+
+/// @brief ̼ˮӳټ
+/// @remark ֱͨͼڵһȡʱ,˺ַ,̺߳Ⱦֱ߳д,
+/// ֱͼȡʱɸֱͨͼϲ,дʱûпͨĹ;سʱѯGetSnapshot
+class CLatencyMonitor
+{
+public:
+	CLatencyMonitor();
+	~CLatencyMonitor();
+
+	// ȡֱͨͼ,ʱ
+	CChannelLatency *GetChannel(int nChannel);
+	int GetChannelCount();
+
+	/// @brief Ϊͨһдֱͼ
+	/// @remark ͨƳ߳˳ʱ,ͬһŵͨѾʼ,߸дԼֱͼ;
+	/// ͬһŵϲʾ,д߳ȫ˳RemoveChannelŵֱͼ
+	CChannelLatency *AddChannel(int nChannel);
+	// AddChannelֱͼֱͨͼͷ,дֱͼ߳ȫ˳
+	void RemoveChannel(CChannelLatency *pLatency);
+
+	/// @brief ȡӳٿ
+	/// @param nChannel	ͨ,ΪLATENCY_ALL_CHANNELSʱȡͨĻ
+	bool GetSnapshot(int nChannel, LatencySnapshot &Snapshot);
+
+	// ͨ,û߳дʱ
+	void Reset();
+
+	/// @brief ¼һĿ,MonoTimeNs
+	/// @return ÿĺʱ,λ
+	double Calibrate(int nSamples = 100000);
+
+	// ܵĸ׶ӳ,ԼCalibrateļ¼ռCPUʱı
+	void TraceStat();
+
+	static const char *GetStageName(LatencyStage nStage);
+private:
+	struct ActiveLatency
+	{
+		int					nChannel;
+		CChannelLatency		*pLatency;
+	};
+	// ȡm_csChannel
+	void MergeChannel(int nChannel, CChannelLatency &Merged);
+
+	vector<CChannelLatency *>	m_vecChannel;
+	vector<ActiveLatency>		m_vecActive;		// AddChannelδƳֱͼ
+	CRITICAL_SECTION			m_csChannel;
+	int64_t						m_nResetTime;		// Ϊ-1ʾδʼʱ
+	double						m_dfSampleCost;		// CalibrateĽ,λ,Ϊ0ʾδ
+};
+
+extern CLatencyMonitor g_LatencyMonitor;
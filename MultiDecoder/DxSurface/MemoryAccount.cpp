@@ -0,0 +1,246 @@
+#include "MemoryAccount.h"
+#include <stdio.h>
+#include "DxTrace.h"
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "libavutil/mem.h"
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+
+CMemoryAccount g_MemoryAccount;
+
+static const char *s_szTagName[MemTag_Count] =
+{
+	"PacketQueue", "FramePool", "Convert", "Surface", "Codec", "Record"
+};
+
+// AllocBufferڴͷ,16ֽ,ıav_mallocصַĶ
+struct MemoryBlockHeader
+{
+	int		nTag;
+	int		nChannel;
+	int		nSize;
+	int		nReserved;
+};
+
+CMemoryAccount::CMemoryAccount()
+{
+	InitializeCriticalSection(&m_csChannel);
+	m_dwTlsIndex = TlsAlloc();
+	m_nResetTime = MonoTimeNs();
+	m_nLastTraceTime = m_nResetTime;
+	ZeroMemory(m_nLastTraceAllocs, sizeof(m_nLastTraceAllocs));
+}
+
+CMemoryAccount::~CMemoryAccount()
+{
+	for (int i = 0; i < m_vecChannel.size(); i++)
+		delete m_vecChannel[i];
+	m_vecChannel.clear();
+	if (m_dwTlsIndex != TLS_OUT_OF_INDEXES)
+		TlsFree(m_dwTlsIndex);
+	DeleteCriticalSection(&m_csChannel);
+}
+
+void CMemoryAccount::SetThreadChannel(int nChannel)
+{
+	// TLSĳʼֵΪ0,ͨż1,δõ̼߳Ϊڴ
+	if (m_dwTlsIndex != TLS_OUT_OF_INDEXES)
+		TlsSetValue(m_dwTlsIndex, (LPVOID)(INT_PTR)(nChannel + 1));
+}
+
+int CMemoryAccount::GetThreadChannel()
+{
+	if (m_dwTlsIndex == TLS_OUT_OF_INDEXES)
+		return MEMORY_SHARED_CHANNEL;
+	return (int)(INT_PTR)TlsGetValue(m_dwTlsIndex) - 1;
+}
+
+CMemoryCounter *CMemoryAccount::GetCounter(MemoryTag nTag, int nChannel)
+{
+	if (nChannel < 0)
+		return &m_Shared.Counter[nTag];
+	CAutoLock lock(&m_csChannel);
+	while (m_vecChannel.size() <= nChannel)
+		m_vecChannel.push_back(new ChannelMemory);
+	return &m_vecChannel[nChannel]->Counter[nTag];
+}
+
+int CMemoryAccount::Alloc(MemoryTag nTag, int nChannel, LONGLONG nBytes)
+{
+	if (nTag < 0 || nTag >= MemTag_Count)
+		return MEMORY_SHARED_CHANNEL;
+	if (nChannel == MEMORY_CURRENT_CHANNEL)
+		nChannel = GetThreadChannel();
+	if (nChannel < 0)
+		nChannel = MEMORY_SHARED_CHANNEL;
+	GetCounter(nTag, nChannel)->Alloc(nBytes);
+	m_Total.Counter[nTag].Alloc(nBytes);
+	return nChannel;
+}
+
+void CMemoryAccount::Free(MemoryTag nTag, int nChannel, LONGLONG nBytes)
+{
+	if (nTag < 0 || nTag >= MemTag_Count)
+		return;
+	if (nChannel == MEMORY_CURRENT_CHANNEL)
+		nChannel = GetThreadChannel();
+	GetCounter(nTag, nChannel)->Free(nBytes);
+	m_Total.Counter[nTag].Free(nBytes);
+}
+
+AVBufferRef *CMemoryAccount::AllocBuffer(MemoryTag nTag, int nSize)
+{
+	BYTE *pBlock = (BYTE *)av_malloc(nSize + sizeof(MemoryBlockHeader));
+	if (!pBlock)
+		return NULL;
+	MemoryBlockHeader *pHeader = (MemoryBlockHeader *)pBlock;
+	AVBufferRef *pBuffer = av_buffer_create(pBlock + sizeof(MemoryBlockHeader), nSize, FreeBuffer, NULL, 0);
+	if (!pBuffer)
+	{
+		av_free(pBlock);
+		return NULL;
+	}
+	pHeader->nTag = nTag;
+	pHeader->nSize = nSize;
+	pHeader->nReserved = 0;
+	pHeader->nChannel = Alloc(nTag, MEMORY_CURRENT_CHANNEL, nSize);
+	return pBuffer;
+}
+
+// һͷʱ,κ߳
+void CMemoryAccount::FreeBuffer(void *opaque, uint8_t *data)
+{
+	MemoryBlockHeader *pHeader = (MemoryBlockHeader *)(data - sizeof(MemoryBlockHeader));
+	g_MemoryAccount.Free((MemoryTag)pHeader->nTag, pHeader->nChannel, pHeader->nSize);
+	av_free(pHeader);
+}
+
+bool CMemoryAccount::GetStat(MemoryTag nTag, int nChannel, MemoryTagStat &Stat)
+{
+	ZeroMemory(&Stat, sizeof(MemoryTagStat));
+	if (nTag < 0 || nTag >= MemTag_Count)
+		return false;
+	if (nChannel == MEMORY_ALL_CHANNELS)
+		m_Total.Counter[nTag].GetStat(Stat);
+	else if (nChannel < 0)
+		m_Shared.Counter[nTag].GetStat(Stat);
+	else
+	{
+		CAutoLock lock(&m_csChannel);
+		if (nChannel >= m_vecChannel.size())
+			return false;
+		m_vecChannel[nChannel]->Counter[nTag].GetStat(Stat);
+	}
+	int64_t nSpan = MonoTimeNs() - m_nResetTime;
+	if (nSpan > 0)
+		Stat.dfAllocsPerSecond = (double)Stat.nAllocs * MONO_NS_PER_SEC / nSpan;
+	return true;
+}
+
+int CMemoryAccount::GetChannelCount()
+{
+	CAutoLock lock(&m_csChannel);
+	return m_vecChannel.size();
+}
+
+void CMemoryAccount::Reset()
+{
+	CAutoLock lock(&m_csChannel);
+	for (int i = 0; i < MemTag_Count; i++)
+	{
+		for (int j = 0; j < m_vecChannel.size(); j++)
+			m_vecChannel[j]->Counter[i].Reset();
+		m_Shared.Counter[i].Reset();
+		m_Total.Counter[i].Reset();
+	}
+	m_nResetTime = MonoTimeNs();
+	m_nLastTraceTime = m_nResetTime;
+	ZeroMemory(m_nLastTraceAllocs, sizeof(m_nLastTraceAllocs));
+}
+
+void CMemoryAccount::TraceStat()
+{
+	int64_t nNow = MonoTimeNs();
+	int64_t nSpan = nNow - m_nLastTraceTime;
+	m_nLastTraceTime = nNow;
+	int nChannels = GetChannelCount();
+	LONGLONG nTotalLive = 0;
+	for (int i = 0; i < MemTag_Count; i++)
+	{
+		MemoryTagStat Stat, Shared;
+		GetStat((MemoryTag)i, MEMORY_ALL_CHANNELS, Stat);
+		GetStat((MemoryTag)i, MEMORY_SHARED_CHANNEL, Shared);
+		nTotalLive += Stat.nLiveBytes;
+		// ϴÿķ
+		double dfAllocsPerSecond = nSpan > 0 ? (double)(Stat.nAllocs - m_nLastTraceAllocs[i]) * MONO_NS_PER_SEC / nSpan : 0.0f;
+		m_nLastTraceAllocs[i] = Stat.nAllocs;
+		LONGLONG nPerChannel = nChannels ? (Stat.nLiveBytes - Shared.nLiveBytes) / nChannels : 0;
+		DxTraceMsg("%s %-12s Live = %lld KB\tPeak = %lld KB\tShared = %lld KB\tPerChannel = %lld KB\tAllocs = %d\tAllocs/s = %.2f.\n", __FUNCTION__,
+					s_szTagName[i], (long long)(Stat.nLiveBytes / 1024), (long long)(Stat.nPeakBytes / 1024), (long long)(Shared.nLiveBytes / 1024), (long long)(nPerChannel / 1024), (int)Stat.nAllocs, dfAllocsPerSecond);
+	}
+	for (int i = 0; i < nChannels; i++)
+	{
+		char szText[512] = { 0 };
+		int nLength = 0;
+		LONGLONG nChannelLive = 0;
+		for (int j = 0; j < MemTag_Count; j++)
+		{
+			MemoryTagStat Stat;
+			GetStat((MemoryTag)j, i, Stat);
+			nChannelLive += Stat.nLiveBytes;
+			nLength += sprintf_s(&szText[nLength], sizeof(szText) - nLength, "\t%s = %lld KB", s_szTagName[j], (long long)(Stat.nLiveBytes / 1024));
+		}
+		if (nChannelLive)
+			DxTraceMsg("%s Channel %d:%s\tTotal = %lld KB.\n", __FUNCTION__, i, szText, (long long)(nChannelLive / 1024));
+	}
+	DxTraceMsg("%s Channels = %d\tTotal = %lld KB.\n", __FUNCTION__, nChannels, (long long)(nTotalLive / 1024));
+}
+
+const char *CMemoryAccount::GetTagName(MemoryTag nTag)
+{
+	if (nTag < 0 || nTag >= MemTag_Count)
+		return "Unknown";
+	return s_szTagName[nTag];
+}
+
+LONGLONG CMemoryAccount::GetSurfaceBytes(UINT nWidth, UINT nHeight, D3DFORMAT nFormat)
+{
+	LONGLONG nPixels = (LONGLONG)nWidth * nHeight;
+	switch (nFormat)
+	{
+	case (D3DFORMAT)MAKEFOURCC('N', 'V', '1', '2'):
+	case (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'):
+		return nPixels * 3 / 2;
+	case (D3DFORMAT)MAKEFOURCC('P', '0', '1', '0'):
+		return nPixels * 3;
+	case (D3DFORMAT)MAKEFOURCC('Y', 'U', 'Y', '2'):
+	case (D3DFORMAT)MAKEFOURCC('U', 'Y', 'V', 'Y'):
+	case D3DFMT_R5G6B5:
+	case D3DFMT_X1R5G5B5:
+	case D3DFMT_A1R5G5B5:
+		return nPixels * 2;
+	case D3DFMT_R8G8B8:
+		return nPixels * 3;
+	default:
+		return nPixels * 4;
+	}
+}
+
+#ifdef _WIN32
+LONGLONG CMemoryAccount::GetSurfaceBytes(IDirect3DSurface9 *pSurface)
+{
+	if (!pSurface)
+		return 0;
+	D3DSURFACE_DESC Desc;
+	if (FAILED(pSurface->GetDesc(&Desc)))
+		return 0;
+	return GetSurfaceBytes(Desc.Width, Desc.Height, Desc.Format);
+}
+#endif
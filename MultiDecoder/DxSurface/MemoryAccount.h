@@ -0,0 +1,168 @@
+#pragma once
+#include "Win32Port.h"
+#include <vector>
+#ifdef _WIN32
+#include <d3d9.h>
+#endif
+#include "AutoLock.h"
+#include "MonoClock.h"
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define __STDC_CONSTANT_MACROS
+#include "libavutil/buffer.h"
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+
+using namespace std;
+
+#define MEMORY_SHARED_CHANNEL	-1		// κͨڴ,ͨõ
+#define MEMORY_CURRENT_CHANNEL	-2		// ʹõ߳SetThreadChannelõͨ
+#define MEMORY_ALL_CHANNELS		-3		// ѯʱȡͨ͹ڴĺϼ
+
+// ڴ;
+enum MemoryTag
+{
+	MemTag_PacketQueue = 0,	// еѹ֡
+	MemTag_FramePool,		// ֡еĽʾͼ
+	MemTag_Convert,			// ֡еתȾͽͼõͼ
+	MemTag_Surface,			// D3D,桢ʾͻض,ʽͳߴ
+	MemTag_Codec,			// ڲĲο֡,ο֡
+	MemTag_Record,			// ¼ѹ֡
+	MemTag_Count
+};
+
+struct MemoryTagStat
+{
+	LONGLONG	nLiveBytes;		// ǰʹõֽ
+	LONGLONG	nPeakBytes;		// Resetʹֽ
+	LONG		nAllocs;		// Resetķ
+	LONG		nFrees;
+	LONGLONG	nAllocBytes;	// ResetۼƷֽ
+	double		dfAllocsPerSecond;	// Resetƽÿķ
+};
+
+// һǩļ,ͷſܷڲͬ߳,ȫʹԭӲ
+class CMemoryCounter
+{
+public:
+	CMemoryCounter()
+	{
+		m_nLiveBytes = 0;
+		m_nPeakBytes = 0;
+		m_nAllocs = 0;
+		m_nFrees = 0;
+		m_nAllocBytes = 0;
+	}
+	void Alloc(LONGLONG nBytes)
+	{
+		LONGLONG nLive = InterlockedExchangeAdd64(&m_nLiveBytes, nBytes) + nBytes;
+		LONGLONG nPeak = m_nPeakBytes;
+		while (nLive > nPeak)
+		{
+			LONGLONG nOld = InterlockedCompareExchange64(&m_nPeakBytes, nLive, nPeak);
+			if (nOld == nPeak)
+				break;
+			nPeak = nOld;
+		}
+		InterlockedIncrement(&m_nAllocs);
+		InterlockedExchangeAdd64(&m_nAllocBytes, nBytes);
+	}
+	void Free(LONGLONG nBytes)
+	{
+		InterlockedExchangeAdd64(&m_nLiveBytes, -nBytes);
+		InterlockedIncrement(&m_nFrees);
+	}
+	// ۼֵ,ʹõڴ汣,ֵӵǰʹʼ
+	void Reset()
+	{
+		InterlockedExchange64(&m_nPeakBytes, m_nLiveBytes);
+		InterlockedExchange(&m_nAllocs, 0);
+		InterlockedExchange(&m_nFrees, 0);
+		InterlockedExchange64(&m_nAllocBytes, 0);
+	}
+	void GetStat(MemoryTagStat &Stat) const
+	{
+		Stat.nLiveBytes = m_nLiveBytes;
+		Stat.nPeakBytes = m_nPeakBytes;
+		Stat.nAllocs = m_nAllocs;
+		Stat.nFrees = m_nFrees;
+		Stat.nAllocBytes = m_nAllocBytes;
+		Stat.dfAllocsPerSecond = 0.0f;
+	}
+private:
+	volatile LONGLONG	m_nLiveBytes;
+	volatile LONGLONG	m_nPeakBytes;
+	volatile LONG		m_nAllocs;
+	volatile LONG		m_nFrees;
+	volatile LONGLONG	m_nAllocBytes;
+};
+
+// һͨǩļ
+struct ChannelMemory
+{
+	CMemoryCounter	Counter[MemTag_Count];
+};
+
+/// @brief ̼ķֱǩڴͳ
+/// @remark ȡ̹ͳƵCTraceMemory,ÿڴڷʱ¼ıǩͨ,Կڴ,
+/// Լÿ·ͨƽռöڴ,ݴ˹һ̨ɵͨ;ͳֻڷͷʱԭӲ,
+/// ȶʱ֡زٷڴ,ͳƱûп
+/// ǩһ̺ϼƵļ,ϼƵķֵͬһʱ̵ʵֵ,Ǹֵ֮ͨ
+class CMemoryAccount
+{
+public:
+	CMemoryAccount();
+	~CMemoryAccount();
+
+	// õ߳ͨ,˺߳MEMORY_CURRENT_CHANNELڴͨ
+	void SetThreadChannel(int nChannel);
+	int GetThreadChannel();
+
+	/// @brief ¼һη
+	/// @param nChannel	ͨ,ΪMEMORY_SHARED_CHANNELMEMORY_CURRENT_CHANNEL
+	/// @return ʵʼͨ,ͷʱʹøͨ
+	int Alloc(MemoryTag nTag, int nChannel, LONGLONG nBytes);
+	void Free(MemoryTag nTag, int nChannel, LONGLONG nBytes);
+
+	/// @brief һͳƵAVBufferRef,߳ͨ
+	/// @remark ıǩͨʹСڻ֮ǰ,һͷʱԶ¼ͷ;ֱAVBufferPoolķ亯
+	AVBufferRef *AllocBuffer(MemoryTag nTag, int nSize);
+
+	/// @brief ȡñǩͳ
+	/// @param nChannel	ͨ,MEMORY_SHARED_CHANNELΪڴ,MEMORY_ALL_CHANNELSΪ̺ϼ
+	bool GetStat(MemoryTag nTag, int nChannel, MemoryTagStat &Stat);
+	int GetChannelCount();
+
+	// ոۼֵͷֵ,ʹõڴ治Ӱ
+	void Reset();
+
+	// ǩĺϼ,Լÿͨǩʹƽÿͨʹ
+	void TraceStat();
+
+	static const char *GetTagName(MemoryTag nTag);
+	// ʽͳߴD3DռõԴ
+	static LONGLONG GetSurfaceBytes(UINT nWidth, UINT nHeight, D3DFORMAT nFormat);
+#ifdef _WIN32
+	static LONGLONG GetSurfaceBytes(IDirect3DSurface9 *pSurface);
+#endif
+private:
+	CMemoryCounter *GetCounter(MemoryTag nTag, int nChannel);
+	static void FreeBuffer(void *opaque, uint8_t *data);
+
+	vector<ChannelMemory *>	m_vecChannel;
+	ChannelMemory			m_Shared;		// MEMORY_SHARED_CHANNEL
+	ChannelMemory			m_Total;		// ͨĺϼ
+	CRITICAL_SECTION		m_csChannel;
+	DWORD					m_dwTlsIndex;
+	int64_t					m_nResetTime;		// ȡMonoTimeNs
+	int64_t					m_nLastTraceTime;
+	LONG					m_nLastTraceAllocs[MemTag_Count];
+};
+
+extern CMemoryAccount g_MemoryAccount;
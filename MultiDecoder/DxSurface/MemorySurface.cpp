@@ -0,0 +1,183 @@
+#include "MemorySurface.h"
+#include "PixelCopy.h"
+#include "HighBitdepth.h"
+#include "MonoClock.h"
+#pragma warning (disable:4996)
+
+CMemorySurface::CMemorySurface()
+{
+	m_bInitialized = false;
+	m_nVideoWidth = 0;
+	m_nVideoHeight = 0;
+	m_nPitch = 0;
+	m_nSurfaceHeight = 0;
+	m_pDumpFile = NULL;
+	m_nDumpInterval = 1;
+	ZeroMemory(&m_Stat, sizeof(MemorySurfaceStat));
+	m_pLatency = NULL;
+}
+
+CMemorySurface::~CMemorySurface()
+{
+	DxCleanup();
+	SetDumpFile(NULL);
+}
+
+bool CMemorySurface::InitD3D(HWND hWnd, int nVideoWidth, int nVideoHeight, BOOL bIsWindowed, D3DFORMAT nD3DFormat)
+{
+	if (nVideoWidth <= 0 || nVideoHeight <= 0)
+		return false;
+	MUTEX_LOCK(m_csRender);
+	DxCleanupLocked();
+	if (!AllocSurface(nVideoWidth, nVideoHeight))
+		return false;
+	m_bInitialized = true;
+	return true;
+}
+
+void CMemorySurface::DxCleanup()
+{
+	MUTEX_LOCK(m_csRender);
+	DxCleanupLocked();
+}
+
+// ڳm_csRenderʱ,m_csRender
+void CMemorySurface::DxCleanupLocked()
+{
+	vector<BYTE>().swap(m_vecSurface);
+	m_nVideoWidth = 0;
+	m_nVideoHeight = 0;
+	m_bInitialized = false;
+}
+
+// ڳm_csRenderʱ;CDxSurfaceYV12һ,ȡż,пMEMORY_SURFACE_ALIGN
+bool CMemorySurface::AllocSurface(int nWidth, int nHeight)
+{
+	int nPitch = ((nWidth + 1) & ~1) + MEMORY_SURFACE_ALIGN - 1;
+	nPitch &= ~(MEMORY_SURFACE_ALIGN - 1);
+	int nSurfaceHeight = (nHeight + 1) & ~1;
+	try
+	{
+		m_vecSurface.resize((size_t)nPitch * nSurfaceHeight * 3 / 2);
+	}
+	catch (std::bad_alloc &)
+	{
+		DxTraceMsg("%s Failed to allocate a %dx%d surface.\n", __FUNCTION__, nWidth, nHeight);
+		return false;
+	}
+	m_nVideoWidth = nWidth;
+	m_nVideoHeight = nHeight;
+	m_nPitch = nPitch;
+	m_nSurfaceHeight = nSurfaceHeight;
+	return true;
+}
+
+bool CMemorySurface::SetDumpFile(const char *szPath, int nInterval)
+{
+	MUTEX_LOCK(m_csRender);
+	if (m_pDumpFile)
+	{
+		fclose(m_pDumpFile);
+		m_pDumpFile = NULL;
+	}
+	if (!szPath)
+		return true;
+	m_pDumpFile = fopen(szPath, "wb");
+	if (!m_pDumpFile)
+	{
+		DxTraceMsg("%s Failed to open the dump file.\n", __FUNCTION__);
+		return false;
+	}
+	m_nDumpInterval = nInterval > 0 ? nInterval : 1;
+	return true;
+}
+
+bool CMemorySurface::Render(AVFrame *pAvFrame, HWND hWnd, RECT *pRenderRt)
+{
+	if (!pAvFrame)
+		return false;
+	MUTEX_LOCK(m_csRender);
+	if (!m_bInitialized)
+		return false;
+	switch (pAvFrame->format)
+	{
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUV420P10:
+	case AV_PIX_FMT_NV12:
+		break;
+	default:
+		m_Stat.nUnsupported++;
+		return false;
+	}
+	if ((pAvFrame->width != m_nVideoWidth || pAvFrame->height != m_nVideoHeight) &&
+		!AllocSurface(pAvFrame->width, pAvFrame->height))
+		return false;
+
+	int64_t nT1 = MonoTimeNs();
+	BYTE *pDst = &m_vecSurface[0];
+	switch (pAvFrame->format)
+	{
+	case AV_PIX_FMT_YUV420P10:
+	{
+		BYTE *pPlane[3];
+		int nPlanePitch[3];
+		GetYV12Planes(pDst, m_nPitch, m_nSurfaceHeight, pPlane, nPlanePitch);
+		CopyYUV420P10ToYUV420P(pPlane, nPlanePitch, pAvFrame->data, pAvFrame->linesize, pAvFrame->width, pAvFrame->height);
+		break;
+	}
+	case AV_PIX_FMT_NV12:
+	{
+		BYTE *pPlane[3];
+		int nPlanePitch[3];
+		GetYV12Planes(pDst, m_nPitch, m_nSurfaceHeight, pPlane, nPlanePitch);
+		CopyNV12ToYUV420P(pPlane, nPlanePitch, pAvFrame->data[0], pAvFrame->data[1], pAvFrame->linesize[0], pAvFrame->width, pAvFrame->height);
+		break;
+	}
+	default:
+		CopyYUV420PToYV12(pDst, m_nPitch, m_nSurfaceHeight, pAvFrame->data, pAvFrame->linesize, pAvFrame->width, pAvFrame->height);
+		break;
+	}
+	int64_t nT2 = MonoTimeNs();
+
+	if (m_pDumpFile && (m_Stat.nRendered % m_nDumpInterval) == 0)
+	{
+		BYTE *pPlane[3];
+		int nPlanePitch[3];
+		GetYV12Planes(pDst, m_nPitch, m_nSurfaceHeight, pPlane, nPlanePitch);
+		int nPlaneOrder[3] = { 0, 2, 1 };
+		for (int i = 0; i < 3; i++)
+		{
+			int nPlane = nPlaneOrder[i];
+			int nWidth = nPlane ? (m_nVideoWidth + 1) / 2 : m_nVideoWidth;
+			int nHeight = nPlane ? (m_nVideoHeight + 1) / 2 : m_nVideoHeight;
+			for (int y = 0; y < nHeight; y++)
+				fwrite(pPlane[nPlane] + y * nPlanePitch[nPlane], 1, nWidth, m_pDumpFile);
+		}
+		m_Stat.nDumped++;
+	}
+	m_Stat.nRendered++;
+	m_Stat.dfUploadTime += MonoNsToSeconds(nT2 - nT1);
+	if (m_pLatency)
+		m_pLatency->Record(LatencyStage_Upload, nT1, nT2);
+	return true;
+}
+
+const BYTE *CMemorySurface::GetSurface(int &nWidth, int &nHeight, int &nPitch, int &nSurfaceHeight)
+{
+	MUTEX_LOCK(m_csRender);
+	nWidth = m_nVideoWidth;
+	nHeight = m_nVideoHeight;
+	nPitch = m_nPitch;
+	nSurfaceHeight = m_nSurfaceHeight;
+	return (m_Stat.nRendered && !m_vecSurface.empty()) ? &m_vecSurface[0] : NULL;
+}
+
+void CMemorySurface::TraceStat()
+{
+	MemorySurfaceStat Stat;
+	GetStat(Stat);
+	DxTraceMsg("%s Rendered = %d\tUnsupported = %d\tDumped = %d\tAvgUpload = %.3fms.\n", __FUNCTION__,
+				Stat.nRendered, Stat.nUnsupported, Stat.nDumped,
+				Stat.nRendered ? Stat.dfUploadTime * 1000 / Stat.nRendered : 0.0f);
+}
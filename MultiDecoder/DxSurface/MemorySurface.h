@@ -0,0 +1,114 @@
+#pragma once
+#include "Win32Port.h"
+#include <stdio.h>
+#include <vector>
+#include "RenderSurface.h"
+#include "AdaptiveLock.h"
+#include "DxTrace.h"
+#include "LatencyHistogram.h"
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define __STDC_CONSTANT_MACROS
+#define FF_API_PIX_FMT 0
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+
+using namespace std;
+
+#define MEMORY_SURFACE_ALIGN	64		// YV12пĶֽ,Կĳһ
+
+struct MemorySurfaceStat
+{
+	LONG		nRendered;		// ϴ֡
+	LONG		nUnsupported;	// ʽֶ֧֡
+	LONG		nDumped;		// дתļ֡
+	double		dfUploadTime;	// ϴYV12ۼƺʱ,λ
+};
+
+/// @brief ڴȾ
+/// @remark ڡD3Dswscale,κƽ̨Ϲ;CDxSurfaceCPUϵĲ账ÿһ֡,ͼϴYV12,
+/// ֻǱϵͳڴ;CDxSurface쵽̨PresentGPU,
+/// ֧YUV420PYUVJ420PYUV420P10ԼڴеNV12ͼ,Ӳ֡ʽȾnUnsupported,
+/// ҪЩ֡쵽ڳߴʱʹCOffscreenSurface;ͼߴ仯ʱ·
+class CMemorySurface :public IRenderSurface
+{
+public:
+	CMemorySurface();
+	virtual ~CMemorySurface();
+
+	virtual bool InitD3D(HWND hWnd,
+		int nVideoWidth,
+		int nVideoHeight,
+		BOOL bIsWindowed = TRUE,
+		D3DFORMAT nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'));
+
+	// ڴû豸,
+	virtual bool InitD3DShared(HWND hWnd,
+		IDirect3DDevice9 *pDevice,
+		int nVideoWidth,
+		int nVideoHeight,
+		D3DFORMAT nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'))
+	{
+		return false;
+	}
+	virtual void DetachSharedDevice()
+	{
+	}
+	virtual bool IsInited()
+	{
+		return m_bInitialized;
+	}
+	// hWndpRenderRt,ͼ񱣳ԭߴ
+	virtual bool Render(AVFrame *pAvFrame, HWND hWnd = NULL, RECT *pRenderRt = NULL);
+
+	// ڴûпɶʧ豸
+	virtual bool HandelDevLost()
+	{
+		return m_bInitialized;
+	}
+	virtual void DxCleanup();
+
+	virtual void SetLatency(CChannelLatency *pLatency)
+	{
+		m_pLatency = pLatency;
+	}
+
+	/// @brief תļ,ÿ֡YVUƽ˳YV12ԭʼ׷ӵļ
+	/// @param szPath		תļ·,ΪNULLʱֹͣת
+	/// @param nInterval	ÿ֡תһ֡
+	bool SetDumpFile(const char *szPath, int nInterval = 1);
+
+	/// @brief ȡһϴYV12,VƽλnPitch*nSurfaceHeight,UƽVƽ֮
+	/// @remark ֻȾ߳лȾֹ֮ͣ,ûϴͼʱNULL
+	const BYTE *GetSurface(int &nWidth, int &nHeight, int &nPitch, int &nSurfaceHeight);
+
+	void GetStat(MemorySurfaceStat &Stat)
+	{
+		MUTEX_LOCK(m_csRender);
+		memcpy(&Stat, &m_Stat, sizeof(MemorySurfaceStat));
+	}
+	void TraceStat();
+private:
+	bool AllocSurface(int nWidth, int nHeight);
+	void DxCleanupLocked();
+
+	CSpinMutex			m_csRender;
+	bool				m_bInitialized;
+	int					m_nVideoWidth;		// ͼĳߴ
+	int					m_nVideoHeight;
+	int					m_nPitch;
+	int					m_nSurfaceHeight;
+	vector<BYTE>		m_vecSurface;
+	FILE				*m_pDumpFile;
+	int					m_nDumpInterval;
+	MemorySurfaceStat	m_Stat;
+	CChannelLatency		*m_pLatency;
+};
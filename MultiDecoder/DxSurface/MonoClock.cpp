@@ -0,0 +1,193 @@
+#include "MonoClock.h"
+#include "Win32Port.h"
+#include "DxTrace.h"
+#if !defined(_MSC_VER) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#endif
+
+// ֻx86/x64TSC
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define MONO_TSC
+#endif
+
+// ״̬ȫΪ0ʱΪδʼ,ȫֶĹ˳
+static volatile LONGLONG	s_nBaseCounter;		// ļֵ
+static int64_t				s_nFrequency;		// Ƶ
+static volatile LONGLONG	s_nCounterOffset;	// رTSC·ʱڼʱϵƫ,֤лǰʱ䲻
+static volatile LONG		s_bTsc;				// TSC·Ƿѿ
+static volatile LONG		s_bCalibrating;		// У׼TSC
+static int64_t				s_nTscBase;			// У׼ʱ̵TSC
+static int64_t				s_nTscBaseNs;		// У׼ʱ̵MonoTimeNs
+static int64_t				s_nTscFrequency;
+
+// ѼֵתΪ,ȳ,ֵint64_tΧھ
+static inline int64_t TicksToNs(int64_t nTicks, int64_t nFrequency)
+{
+	return nTicks / nFrequency * MONO_NS_PER_SEC + nTicks % nFrequency * MONO_NS_PER_SEC / nFrequency;
+}
+
+static inline int64_t ReadCounter()
+{
+	LARGE_INTEGER nCounter;
+	QueryPerformanceCounter(&nCounter);
+	return nCounter.QuadPart;
+}
+
+static void InitClock()
+{
+	LARGE_INTEGER nFrequency;
+	QueryPerformanceFrequency(&nFrequency);
+	s_nFrequency = nFrequency.QuadPart;
+	// ߳ͬʱʼʱֻеһЧ,̵߳õʱ䱣һ
+	InterlockedCompareExchange64(&s_nBaseCounter, ReadCounter(), 0);
+}
+
+static inline int64_t CounterTimeNs()
+{
+	if (!s_nBaseCounter)
+		InitClock();
+	return TicksToNs(ReadCounter() - s_nBaseCounter, s_nFrequency) + s_nCounterOffset;
+}
+
+#ifdef MONO_TSC
+static inline int64_t TscTimeNs()
+{
+	return s_nTscBaseNs + TicksToNs((int64_t)__rdtsc() - s_nTscBase, s_nTscFrequency);
+}
+
+// CPUǷֺ֧㶨ƵʵTSC(Invariant TSC),CPUID 0x80000007EDX8λ
+static bool InvariantTscSupported()
+{
+#ifdef _MSC_VER
+	int nRegs[4] = { 0 };
+	__cpuid(nRegs, 0x80000000);
+	if ((unsigned int)nRegs[0] < 0x80000007)
+		return false;
+	__cpuid(nRegs, 0x80000007);
+	return (nRegs[3] & (1 << 8)) != 0;
+#else
+	unsigned int nEAX, nEBX, nECX, nEDX;
+	if (!__get_cpuid(0x80000007, &nEAX, &nEBX, &nECX, &nEDX))
+		return false;
+	return (nEDX & (1 << 8)) != 0;
+#endif
+}
+#endif
+
+int64_t MonoTimeNs()
+{
+#ifdef MONO_TSC
+	if (s_bTsc)
+		return TscTimeNs();
+#endif
+	return CounterTimeNs();
+}
+
+bool MonoClockEnableTsc(bool bEnable)
+{
+#ifdef MONO_TSC
+	if (!bEnable)
+	{
+		if (!s_bTsc)
+			return false;
+		// ʱӵʲȫͬ,TSCʱѾǰڼʱ,ȰƫƵǰTSCʱ,лؼʱ,
+		// лǰʱ;ƫƶ1΢,߳ڵƫƺл֮TSCʱ
+		int64_t nCounterNs = CounterTimeNs();
+		int64_t nTscNs = TscTimeNs();
+		if (nTscNs > nCounterNs)
+			InterlockedExchangeAdd64(&s_nCounterOffset, nTscNs - nCounterNs + MONO_NS_PER_US);
+		InterlockedExchange(&s_bTsc, 0);
+		return false;
+	}
+	if (s_bTsc)
+		return true;
+	if (!InvariantTscSupported())
+	{
+		DxTraceMsg("%s Invariant TSC is not supported,keep using %s.\n", __FUNCTION__, MonoClockSource());
+		return false;
+	}
+	// ͬһʱֻһ߳У׼
+	if (InterlockedCompareExchange(&s_bCalibrating, 1, 0) != 0)
+		return false;
+	// Լ50ͬʱȡʱTSC,ߵTSCƵ
+	// ȶTSCٶʱ,TSCʱ㲻ڼʱ,лֻ΢ǰᵹ
+	int64_t nTsc1 = (int64_t)__rdtsc();
+	int64_t nNs1 = CounterTimeNs();
+	Sleep(50);
+	int64_t nTsc2 = (int64_t)__rdtsc();
+	int64_t nNs2 = CounterTimeNs();
+	bool bResult = nNs2 > nNs1 && nTsc2 > nTsc1;
+	if (bResult)
+	{
+		s_nTscFrequency = (int64_t)((double)(nTsc2 - nTsc1) * MONO_NS_PER_SEC / (nNs2 - nNs1));
+		s_nTscBase = nTsc2;
+		s_nTscBaseNs = nNs2;
+		InterlockedExchange(&s_bTsc, 1);
+		DxTraceMsg("%s TSC frequency = %lld Hz.\n", __FUNCTION__, (long long)s_nTscFrequency);
+	}
+	InterlockedExchange(&s_bCalibrating, 0);
+	return bResult;
+#else
+	return false;
+#endif
+}
+
+static unsigned __stdcall CalibrateThread(void *p)
+{
+	MonoClockEnableTsc(true);
+	return 0;
+}
+
+void MonoClockEnableTscAsync()
+{
+	HANDLE hThread = (HANDLE)_beginthreadex(nullptr, 0, CalibrateThread, nullptr, 0, nullptr);
+	if (hThread)
+		CloseHandle(hThread);
+	else
+		DxTraceMsg("%s Failed to start TSC calibration thread.\n", __FUNCTION__);
+}
+
+const char *MonoClockSource()
+{
+#ifdef _WIN32
+	return s_bTsc ? "TSC" : "QPC";
+#else
+	return s_bTsc ? "TSC" : "clock_gettime";
+#endif
+}
+
+int64_t MonoThreadCpuNs()
+{
+#ifdef _WIN32
+	FILETIME ftCreate, ftExit, ftKernel, ftUser;
+	if (!GetThreadTimes(GetCurrentThread(), &ftCreate, &ftExit, &ftKernel, &ftUser))
+		return 0;
+	ULARGE_INTEGER nKernel, nUser;
+	nKernel.LowPart = ftKernel.dwLowDateTime;
+	nKernel.HighPart = ftKernel.dwHighDateTime;
+	nUser.LowPart = ftUser.dwLowDateTime;
+	nUser.HighPart = ftUser.dwHighDateTime;
+	return (int64_t)(nKernel.QuadPart + nUser.QuadPart) * 100;		// λΪ100
+#else
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		return 0;
+	return (int64_t)ts.tv_sec * MONO_NS_PER_SEC + ts.tv_nsec;
+#endif
+}
+
+void MonoSleepNs(int64_t nNs)
+{
+	if (nNs <= 0)
+		return;
+#ifdef _WIN32
+	// SleepֻԺΪλ,1Ĳֲ,ⳬʱ
+	DWORD dwMilliseconds = (DWORD)(nNs / MONO_NS_PER_MS);
+	Sleep(dwMilliseconds);
+#else
+	struct timespec ts;
+	ts.tv_sec = (time_t)(nNs / MONO_NS_PER_SEC);
+	ts.tv_nsec = (long)(nNs % MONO_NS_PER_SEC);
+	nanosleep(&ts, NULL);
+#endif
+}
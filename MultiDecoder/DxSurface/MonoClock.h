@@ -0,0 +1,118 @@
+#pragma once
+#include <stdint.h>
+
+#define MONO_NS_PER_US		1000LL
+#define MONO_NS_PER_MS		1000000LL
+#define MONO_NS_PER_SEC		1000000000LL
+
+/// @brief ʱӵĵǰʱ,λ
+/// @remark Ϊеһȡʱʱ,ϵͳʱӰ,ȡõʱΪ,Ҫ
+/// Windows»QueryPerformanceCounter,ƽ̨clock_gettime(CLOCK_MONOTONIC);
+/// MonoClockEnableTscֱӶȡTSC,ʡȥQueryPerformanceCounterĵÿ
+/// ȡGetExactTime,GetExactTimeֻҪϵͳʱӦĳ
+int64_t MonoTimeNs();
+
+/// @brief رTSC·
+/// @remark ֻCPUֺ֧㶨ƵʵTSC(Invariant TSC)ʱܿ,ʱڵ߳QueryPerformanceCounterУ׼Լ50,
+/// ˺ʱУ׼ʱ̵ʱ;رʱʱƫ,ǰTSCʱ,͹رǰʱ䶼ᵹ
+/// ·CPUTSCϵͳͬ
+/// @return TSC·Ƿѿ
+bool MonoClockEnableTsc(bool bEnable);
+
+// ں̨߳У׼TSC·,,ڽ̵߳ȲܵȴУ׼ĳ
+void MonoClockEnableTscAsync();
+
+// ǰʹõʱԴ,"QPC""TSC""clock_gettime"
+const char *MonoClockSource();
+
+// ָ,ʵʾȡϵͳĶʱֱ
+void MonoSleepNs(int64_t nNs);
+
+/// @brief ߳ĵCPUʱ(û̬ں̬֮),λ
+/// @remark Windows»GetThreadTimes,Ϊʱ(ͨ15.6),ֻʺͳƽϳʱۼֵ;
+/// ƽ̨clock_gettime(CLOCK_THREAD_CPUTIME_ID)
+int64_t MonoThreadCpuNs();
+
+inline double MonoNsToMs(int64_t nNs)
+{
+	return (double)nNs / MONO_NS_PER_MS;
+}
+
+inline double MonoNsToSeconds(int64_t nNs)
+{
+	return (double)nNs / MONO_NS_PER_SEC;
+}
+
+/// @brief ̶ƽĽ
+/// @remark ÿĵʱʼʱ̼ڵõ,ʱĶߵۻ;
+/// 󳬹һʱӵǰʱ¿ʼʱ,Ϊ׷϶
+class CMonoPacer
+{
+public:
+	CMonoPacer(int64_t nIntervalNs = 0)
+	{
+		m_nInterval = nIntervalNs;
+		m_nNext = 0;
+	}
+	void SetInterval(int64_t nIntervalNs)
+	{
+		m_nInterval = nIntervalNs;
+		m_nNext = 0;
+	}
+	int64_t GetInterval() const
+	{
+		return m_nInterval;
+	}
+	// ӵǰʱ俪ʼʱ,һһ֮
+	void Reset()
+	{
+		m_nNext = MonoTimeNs() + m_nInterval;
+	}
+	/// @brief ȴһ
+	/// @return ʱѾĵ,δʱΪ0
+	int64_t Wait()
+	{
+		int64_t nNow = MonoTimeNs();
+		if (!m_nNext)
+			m_nNext = nNow + m_nInterval;
+		int64_t nLate = 0;
+		if (nNow < m_nNext)
+			MonoSleepNs(m_nNext - nNow);
+		else
+			nLate = nNow - m_nNext;
+		m_nNext += m_nInterval;
+		if (nLate > m_nInterval)
+			m_nNext = nNow + m_nInterval;
+		return nLate;
+	}
+private:
+	int64_t		m_nInterval;
+	int64_t		m_nNext;		// һĵʱ,Ϊ0ʾδʼ
+};
+
+// ֹʱ
+class CMonoDeadline
+{
+public:
+	CMonoDeadline(int64_t nTimeoutNs)
+	{
+		m_nDeadline = MonoTimeNs() + nTimeoutNs;
+	}
+	bool IsExpired() const
+	{
+		return MonoTimeNs() >= m_nDeadline;
+	}
+	// ʣ,ѹʱΪ0
+	int64_t Remaining() const
+	{
+		int64_t nRemaining = m_nDeadline - MonoTimeNs();
+		return nRemaining > 0 ? nRemaining : 0;
+	}
+	// ʣĺ,ȡ,ֱȴĳʱ
+	unsigned long RemainingMs() const
+	{
+		return (unsigned long)((Remaining() + MONO_NS_PER_MS - 1) / MONO_NS_PER_MS);
+	}
+private:
+	int64_t		m_nDeadline;
+};
@@ -0,0 +1,611 @@
+#include "MosaicCompositor.h"
+#ifdef PIXELCOPY_SSE2
+#include <emmintrin.h>
+#endif
+#include "MonoClock.h"
+#include "TimelineTrace.h"
+
+// ذȨػ,nWeightΪ2еȨ,ȡֵ0~128
+typedef void(*BlendRowsProc)(BYTE *pDst, const BYTE *pRow0, const BYTE *pRow1, int nWeight, int nWidth);
+
+static void BlendRows_C(BYTE *pDst, const BYTE *pRow0, const BYTE *pRow1, int nWeight, int nWidth)
+{
+	int nWeight0 = 128 - nWeight;
+	for (int x = 0; x < nWidth; x++)
+		pDst[x] = (BYTE)((pRow0[x] * nWeight0 + pRow1[x] * nWeight + 64) >> 7);
+}
+
+#ifdef PIXELCOPY_SSE2
+// ÿδ16,˻Ϊ255*128,ᳬ16λķΧ
+static void BlendRows_SSE2(BYTE *pDst, const BYTE *pRow0, const BYTE *pRow1, int nWeight, int nWidth)
+{
+	__m128i xmmZero = _mm_setzero_si128();
+	__m128i xmmWeight0 = _mm_set1_epi16(128 - nWeight);
+	__m128i xmmWeight1 = _mm_set1_epi16(nWeight);
+	__m128i xmmRound = _mm_set1_epi16(64);
+	int x = 0;
+	for (; x + 16 <= nWidth; x += 16)
+	{
+		__m128i xmm0 = _mm_loadu_si128((const __m128i *)(pRow0 + x));
+		__m128i xmm1 = _mm_loadu_si128((const __m128i *)(pRow1 + x));
+		__m128i xmmLo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(xmm0, xmmZero), xmmWeight0),
+									  _mm_mullo_epi16(_mm_unpacklo_epi8(xmm1, xmmZero), xmmWeight1));
+		__m128i xmmHi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(xmm0, xmmZero), xmmWeight0),
+									  _mm_mullo_epi16(_mm_unpackhi_epi8(xmm1, xmmZero), xmmWeight1));
+		xmmLo = _mm_srli_epi16(_mm_add_epi16(xmmLo, xmmRound), 7);
+		xmmHi = _mm_srli_epi16(_mm_add_epi16(xmmHi, xmmRound), 7);
+		_mm_storeu_si128((__m128i *)(pDst + x), _mm_packus_epi16(xmmLo, xmmHi));
+	}
+	if (x < nWidth)
+		BlendRows_C(pDst + x, pRow0 + x, pRow1 + x, nWeight, nWidth - x);
+}
+
+#endif
+
+#ifdef PIXELCOPY_SSE2
+static BlendRowsProc BlendRows = CpuSupportsSSE2() ? BlendRows_SSE2 : BlendRows_C;
+#else
+static BlendRowsProc BlendRows = BlendRows_C;
+#endif
+
+void ScaleRow_C(BYTE *pDst, const BYTE *pRow, const int *pIndex, const int *pWeight, int nDstWidth)
+{
+	for (int x = 0; x < nDstWidth; x++)
+	{
+		const BYTE *pPair = pRow + pIndex[x];
+		pDst[x] = (BYTE)((pPair[0] * (pWeight[x] & 0xFFFF) + pPair[1] * (pWeight[x] >> 16) + 64) >> 7);
+	}
+}
+
+#ifdef PIXELCOPY_SSE2
+// 8ĿضӦ8ԴװһĴ,ÿռ16λ
+static inline __m128i GatherPairs(const BYTE *pRow, const int *pIndex)
+{
+	__m128i xmmPairs = _mm_cvtsi32_si128(*(const WORD *)(pRow + pIndex[0]));
+	xmmPairs = _mm_insert_epi16(xmmPairs, *(const WORD *)(pRow + pIndex[1]), 1);
+	xmmPairs = _mm_insert_epi16(xmmPairs, *(const WORD *)(pRow + pIndex[2]), 2);
+	xmmPairs = _mm_insert_epi16(xmmPairs, *(const WORD *)(pRow + pIndex[3]), 3);
+	xmmPairs = _mm_insert_epi16(xmmPairs, *(const WORD *)(pRow + pIndex[4]), 4);
+	xmmPairs = _mm_insert_epi16(xmmPairs, *(const WORD *)(pRow + pIndex[5]), 5);
+	xmmPairs = _mm_insert_epi16(xmmPairs, *(const WORD *)(pRow + pIndex[6]), 6);
+	xmmPairs = _mm_insert_epi16(xmmPairs, *(const WORD *)(pRow + pIndex[7]), 7);
+	return xmmPairs;
+}
+
+// 4Ŀ:ԴضչΪ16λȨضmadd,õ432λļȨ
+static inline __m128i BlendPairs(__m128i xmmPairs16, const int *pWeight, __m128i xmmRound)
+{
+	__m128i xmmSum = _mm_madd_epi16(xmmPairs16, _mm_loadu_si128((const __m128i *)pWeight));
+	return _mm_srli_epi32(_mm_add_epi32(xmmSum, xmmRound), 7);
+}
+
+// Դصλò,ֻװ,ֵĳ˼Ӻÿδ16
+void ScaleRow_SSE2(BYTE *pDst, const BYTE *pRow, const int *pIndex, const int *pWeight, int nDstWidth)
+{
+	__m128i xmmZero = _mm_setzero_si128();
+	__m128i xmmRound = _mm_set1_epi32(64);
+	int x = 0;
+	for (; x + 16 <= nDstWidth; x += 16)
+	{
+		__m128i xmmPairs0 = GatherPairs(pRow, pIndex + x);
+		__m128i xmmPairs1 = GatherPairs(pRow, pIndex + x + 8);
+		__m128i xmm0 = BlendPairs(_mm_unpacklo_epi8(xmmPairs0, xmmZero), pWeight + x, xmmRound);
+		__m128i xmm1 = BlendPairs(_mm_unpackhi_epi8(xmmPairs0, xmmZero), pWeight + x + 4, xmmRound);
+		__m128i xmm2 = BlendPairs(_mm_unpacklo_epi8(xmmPairs1, xmmZero), pWeight + x + 8, xmmRound);
+		__m128i xmm3 = BlendPairs(_mm_unpackhi_epi8(xmmPairs1, xmmZero), pWeight + x + 12, xmmRound);
+		_mm_storeu_si128((__m128i *)(pDst + x), _mm_packus_epi16(_mm_packs_epi32(xmm0, xmm1), _mm_packs_epi32(xmm2, xmm3)));
+	}
+	if (x < nDstWidth)
+		ScaleRow_C(pDst + x, pRow, pIndex + x, pWeight + x, nDstWidth - x);
+}
+
+ScaleRowProc ScaleRow = CpuSupportsSSE2() ? ScaleRow_SSE2 : ScaleRow_C;
+#else
+ScaleRowProc ScaleRow = ScaleRow_C;
+#endif
+
+// ĿnDstԴͼжӦλ,1/128Ϊλ,ȡ
+static inline int MapPosition(int nDst, int nSrcSize, int nDstSize)
+{
+	int nPos = (int)(((LONGLONG)(2 * nDst + 1) * nSrcSize * 128) / (2 * nDstSize)) - 64;
+	return nPos < 0 ? 0 : nPos;
+}
+
+CMosaicWorkers::CMosaicWorkers()
+{
+	m_hStartSemaphore = NULL;
+	m_hDoneEvent = NULL;
+	m_nNext = 0;
+	m_nCount = 0;
+	m_nActive = 0;
+	m_pProc = NULL;
+	m_pParam = NULL;
+	m_bRun = false;
+}
+
+CMosaicWorkers::~CMosaicWorkers()
+{
+	Stop();
+}
+
+bool CMosaicWorkers::Start(int nThreads)
+{
+	Stop();
+	m_hStartSemaphore = CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+	m_hDoneEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (!m_hStartSemaphore || !m_hDoneEvent)
+	{
+		Stop();
+		return false;
+	}
+	m_bRun = true;
+	for (int i = 0; i < nThreads; i++)
+	{
+		HANDLE hThread = (HANDLE)_beginthreadex(nullptr, 0, WorkerThread, this, 0, nullptr);
+		if (!hThread)
+		{
+			DxTraceMsg("%s Failed to create worker %d.\n", __FUNCTION__, i);
+			break;
+		}
+		m_vecThread.push_back(hThread);
+	}
+	return true;
+}
+
+void CMosaicWorkers::Stop()
+{
+	if (!m_vecThread.empty())
+	{
+		m_bRun = false;
+		ReleaseSemaphore(m_hStartSemaphore, (LONG)m_vecThread.size(), NULL);
+		for (size_t i = 0; i < m_vecThread.size(); i++)
+		{
+			WaitForSingleObject(m_vecThread[i], INFINITE);
+			CloseHandle(m_vecThread[i]);
+		}
+		m_vecThread.clear();
+	}
+	m_bRun = false;
+	if (m_hStartSemaphore)
+	{
+		CloseHandle(m_hStartSemaphore);
+		m_hStartSemaphore = NULL;
+	}
+	if (m_hDoneEvent)
+	{
+		CloseHandle(m_hDoneEvent);
+		m_hDoneEvent = NULL;
+	}
+}
+
+void CMosaicWorkers::Run(int nCount, WorkProc pProc, void *pParam)
+{
+	if (nCount <= 0)
+		return;
+	if (m_vecThread.empty() || nCount == 1)
+	{
+		for (int i = 0; i < nCount; i++)
+			pProc(i, pParam);
+		return;
+	}
+	// һRunѵĹ̶߳˳Work,ʱû߳ȡ
+	LONG nWake = min((LONG)m_vecThread.size(), (LONG)nCount - 1);
+	m_pProc = pProc;
+	m_pParam = pParam;
+	m_nCount = nCount;
+	InterlockedExchange(&m_nNext, 0);
+	InterlockedExchange(&m_nActive, nWake + 1);
+	ReleaseSemaphore(m_hStartSemaphore, nWake, NULL);
+	Work();
+	// һ˳Work̻߳¼,ʹǵ߳Լ,ҲҪȴ¼
+	// ȵлѵĹ̶߳˳Workŷ,ٵ̲߳ȡһRun
+	WaitForSingleObject(m_hDoneEvent, INFINITE);
+}
+
+void CMosaicWorkers::Work()
+{
+	for (;;)
+	{
+		LONG nIndex = InterlockedIncrement(&m_nNext) - 1;
+		if (nIndex >= m_nCount)
+			break;
+		m_pProc(nIndex, m_pParam);
+	}
+	// ߳ȡʱѴԼȡõ,һ˳߳˳ʱžѴ
+	if (InterlockedDecrement(&m_nActive) == 0)
+		SetEvent(m_hDoneEvent);
+}
+
+UINT __stdcall CMosaicWorkers::WorkerThread(void *p)
+{
+	CMosaicWorkers *pThis = (CMosaicWorkers *)p;
+	TimelineSetThreadName("MosaicWorker");
+	for (;;)
+	{
+		WaitForSingleObject(pThis->m_hStartSemaphore, INFINITE);
+		if (!pThis->m_bRun)
+			break;
+		pThis->Work();
+	}
+	return 0;
+}
+
+CMosaicCompositor::CMosaicCompositor()
+{
+	m_hPresentWnd = NULL;
+#ifdef _WIN32
+	m_pDxSurface = NULL;
+#endif
+	m_pMosaicFrame = NULL;
+	m_hThread = NULL;
+	m_bThreadRun = false;
+	m_nInterval = 20;
+	m_pCallback = NULL;
+	m_pUserPtr = NULL;
+	ZeroMemory(&m_Stat, sizeof(MosaicStat));
+	InitializeCriticalSection(&m_csLayout);
+	InitializeCriticalSection(&m_csCompose);
+}
+
+CMosaicCompositor::~CMosaicCompositor()
+{
+	Stop();
+	m_Workers.Stop();
+	m_mapTileWnd.clear();
+	m_vecTile.clear();
+	if (m_pMosaicFrame)
+		av_frame_free(&m_pMosaicFrame);
+#ifdef _WIN32
+	SafeDelete(m_pDxSurface);
+#endif
+	DeleteCriticalSection(&m_csLayout);
+	DeleteCriticalSection(&m_csCompose);
+}
+
+bool CMosaicCompositor::Create(HWND hPresentWnd, int nWidth, int nHeight)
+{
+	// YUV420Pɫȷ߼,ƴͼĿȡż
+	nWidth &= ~1;
+	nHeight &= ~1;
+	if (nWidth <= 0 || nHeight <= 0)
+		return false;
+	CAutoLock lock(&m_csCompose);
+	if (m_pMosaicFrame)
+		av_frame_free(&m_pMosaicFrame);
+	m_pMosaicFrame = av_frame_alloc();
+	if (!m_pMosaicFrame)
+		return false;
+	m_pMosaicFrame->width = nWidth;
+	m_pMosaicFrame->height = nHeight;
+	m_pMosaicFrame->format = AV_PIX_FMT_YUV420P;
+	int nAvError = av_frame_get_buffer(m_pMosaicFrame, 32);
+	if (nAvError < 0)
+	{
+		char szAvError[256] = { 0 };
+		av_strerror(nAvError, szAvError, 256);
+		DxTraceMsg("%s av_frame_get_buffer failed:%s.\n", __FUNCTION__, szAvError);
+		av_frame_free(&m_pMosaicFrame);
+		return false;
+	}
+	FillBlack();
+	if (m_Workers.GetThreads() == 0)
+	{// ϳ̱߳Ҳ,̱߳CPUһ
+		SYSTEM_INFO SysInfo;
+		GetSystemInfo(&SysInfo);
+		m_Workers.Start(min((int)SysInfo.dwNumberOfProcessors - 1, 7));
+	}
+
+	m_hPresentWnd = hPresentWnd;
+#ifdef _WIN32
+	SafeDelete(m_pDxSurface);
+	if (m_hPresentWnd)
+		m_pDxSurface = new CDxSurface();	// D3D豸ںϳ߳д
+#endif
+	return true;
+}
+
+int CMosaicCompositor::AddTile(HWND hTileWnd, const RECT &rtTile)
+{
+	if (!m_pMosaicFrame)
+		return -1;
+	RECT rtAligned;
+	rtAligned.left = max((rtTile.left + 1) & ~1, 0);
+	rtAligned.top = max((rtTile.top + 1) & ~1, 0);
+	rtAligned.right = min(rtTile.right & ~1, m_pMosaicFrame->width);
+	rtAligned.bottom = min(rtTile.bottom & ~1, m_pMosaicFrame->height);
+	if (rtAligned.right - rtAligned.left < 2 || rtAligned.bottom - rtAligned.top < 2)
+		return -1;
+
+	CAutoLock lock(&m_csLayout);
+	m_vecTile.push_back(MosaicTilePtr(new MosaicTile(hTileWnd, rtAligned)));
+	int nTile = m_vecTile.size() - 1;
+	if (hTileWnd)
+		m_mapTileWnd[hTileWnd] = nTile;
+	return nTile;
+}
+
+bool CMosaicCompositor::GetTileRect(int nTile, RECT &rtTile)
+{
+	CAutoLock lock(&m_csLayout);
+	if (nTile < 0 || nTile >= (int)m_vecTile.size())
+		return false;
+	rtTile = m_vecTile[nTile]->rect;
+	return true;
+}
+
+void CMosaicCompositor::ClearTiles()
+{
+	CAutoLock lockCompose(&m_csCompose);
+	{
+		CAutoLock lock(&m_csLayout);
+		m_mapTileWnd.clear();
+		m_vecTile.clear();
+	}
+	if (m_pMosaicFrame)
+		FillBlack();
+}
+
+void CMosaicCompositor::FillBlack()
+{
+	for (int i = 0; i < m_pMosaicFrame->height; i++)
+		memset(m_pMosaicFrame->data[0] + i*m_pMosaicFrame->linesize[0], 16, m_pMosaicFrame->width);
+	for (int i = 0; i < m_pMosaicFrame->height / 2; i++)
+	{
+		memset(m_pMosaicFrame->data[1] + i*m_pMosaicFrame->linesize[1], 128, m_pMosaicFrame->width / 2);
+		memset(m_pMosaicFrame->data[2] + i*m_pMosaicFrame->linesize[2], 128, m_pMosaicFrame->width / 2);
+	}
+}
+
+bool CMosaicCompositor::SubmitFrame(int nTile, AVFrame *pAvFrame)
+{
+	MosaicTilePtr pTile;
+	{
+		CAutoLock lock(&m_csLayout);
+		if (nTile < 0 || nTile >= (int)m_vecTile.size())
+			return false;
+		pTile = m_vecTile[nTile];
+	}
+	return SubmitFrame(pTile.get(), pAvFrame);
+}
+
+bool CMosaicCompositor::SubmitFrame(HWND hTileWnd, AVFrame *pAvFrame)
+{
+	MosaicTilePtr pTile;
+	{
+		CAutoLock lock(&m_csLayout);
+		auto itFind = m_mapTileWnd.find(hTileWnd);
+		if (itFind == m_mapTileWnd.end())
+			return false;
+		pTile = m_vecTile[itFind->second];
+	}
+	return SubmitFrame(pTile.get(), pAvFrame);
+}
+
+bool CMosaicCompositor::SubmitFrame(MosaicTile *pTile, AVFrame *pAvFrame)
+{
+	if (!pAvFrame ||
+		(pAvFrame->format != AV_PIX_FMT_YUV420P && pAvFrame->format != AV_PIX_FMT_YUVJ420P))
+	{
+		DxTraceMsg("%s Unsupported frame format:%d.\n", __FUNCTION__, pAvFrame ? pAvFrame->format : -1);
+		return false;
+	}
+	CAutoLock lock(&pTile->csTile);
+	if (pTile->nDirty)
+		InterlockedIncrement(&m_Stat.nDroppedFrames);
+	if (pAvFrame->buf[0])
+	{// üͼֱ,Ҫ
+		av_frame_unref(pTile->pFrame);
+		if (av_frame_ref(pTile->pFrame, pAvFrame) < 0)
+			return false;
+	}
+	else
+	{// ôеͼ񻺳,ֻгߴ仯򻺳Աطʱ·
+		AVFrame *pFrame = pTile->pFrame;
+		if (pFrame->width != pAvFrame->width ||
+			pFrame->height != pAvFrame->height ||
+			pFrame->format != pAvFrame->format ||
+			!pFrame->buf[0] ||
+			!av_frame_is_writable(pFrame))
+		{
+			if (!g_FramePool.GetFrameBuffer(pFrame, (AVPixelFormat)pAvFrame->format, pAvFrame->width, pAvFrame->height))
+				return false;
+		}
+		av_frame_copy(pFrame, pAvFrame);
+	}
+	InterlockedExchange(&pTile->nDirty, 1);
+	InterlockedIncrement(&m_Stat.nSubmitFrames);
+	return true;
+}
+
+void BuildScaleTable(MosaicScaleTable &Table, int nSrcWidth, int nDstWidth)
+{
+	Table.vecIndex.resize(nDstWidth);
+	Table.vecWeight.resize(nDstWidth);
+	for (int x = 0; x < nDstWidth; x++)
+	{
+		int nPos = MapPosition(x, nSrcWidth, nDstWidth);
+		int nIndex = nPos >> 7;
+		int nWeight = nPos & 127;
+		if (nIndex >= nSrcWidth - 1)
+		{// һʱȡһ,ʾΪҲصȨΪ128,֤ɶԶȡʱԽ
+			nIndex = max(nSrcWidth - 2, 0);
+			nWeight = nSrcWidth > 1 ? 128 : 0;
+		}
+		Table.vecIndex[x] = nIndex;
+		Table.vecWeight[x] = (nWeight << 16) | (128 - nWeight);
+	}
+}
+
+void CMosaicCompositor::ScalePlane(MosaicTile *pTile, MosaicScaleTable &Table, const BYTE *pSrc, int nSrcPitch, int nSrcWidth, int nSrcHeight, BYTE *pDst, int nDstPitch, int nDstWidth, int nDstHeight)
+{
+	BYTE *pRowBuffer = &pTile->vecRowBuffer[0];
+	// Դͼֻ1ؿʱɶԶȡԽ,ʱȸƵл,л1ֽ
+	bool bNarrow = nSrcWidth < 2;
+	for (int y = 0; y < nDstHeight; y++)
+	{
+		int nPos = MapPosition(y, nSrcHeight, nDstHeight);
+		int nRow0 = nPos >> 7;
+		int nWeight = nPos & 127;
+		const BYTE *pRow = NULL;
+		if (nRow0 >= nSrcHeight - 1 || nWeight == 0)
+		{
+			pRow = pSrc + min(nRow0, nSrcHeight - 1)*nSrcPitch;
+			if (bNarrow)
+			{
+				memcpy(pRowBuffer, pRow, nSrcWidth);
+				pRow = pRowBuffer;
+			}
+		}
+		else
+		{// ֱĲֵ
+			BlendRows(pRowBuffer, pSrc + nRow0*nSrcPitch, pSrc + (nRow0 + 1)*nSrcPitch, nWeight, nSrcWidth);
+			pRow = pRowBuffer;
+		}
+		// òֵˮƽĲֵ
+		ScaleRow(pDst + y*nDstPitch, pRow, &Table.vecIndex[0], &Table.vecWeight[0], nDstWidth);
+	}
+}
+
+void CMosaicCompositor::ScaleTile(MosaicTile *pTile)
+{
+	CAutoLock lock(&pTile->csTile);
+	InterlockedExchange(&pTile->nDirty, 0);
+	AVFrame *pSrc = pTile->pFrame;
+	if (!pSrc->data[0])
+		return;
+	int nDstWidth = pTile->rect.right - pTile->rect.left;
+	int nDstHeight = pTile->rect.bottom - pTile->rect.top;
+	int nSrcWidthUV = (pSrc->width + 1) / 2;
+	int nSrcHeightUV = (pSrc->height + 1) / 2;
+	if (pTile->nSrcWidth != pSrc->width || pTile->nSrcHeight != pSrc->height)
+	{
+		BuildScaleTable(pTile->ScaleY, pSrc->width, nDstWidth);
+		BuildScaleTable(pTile->ScaleUV, nSrcWidthUV, nDstWidth / 2);
+		pTile->vecRowBuffer.resize(pSrc->width + 1);
+		pTile->nSrcWidth = pSrc->width;
+		pTile->nSrcHeight = pSrc->height;
+	}
+	AVFrame *pDst = m_pMosaicFrame;
+	ScalePlane(pTile, pTile->ScaleY, pSrc->data[0], pSrc->linesize[0], pSrc->width, pSrc->height,
+			   pDst->data[0] + pTile->rect.top*pDst->linesize[0] + pTile->rect.left, pDst->linesize[0], nDstWidth, nDstHeight);
+	for (int i = 1; i < 3; i++)
+		ScalePlane(pTile, pTile->ScaleUV, pSrc->data[i], pSrc->linesize[i], nSrcWidthUV, nSrcHeightUV,
+				   pDst->data[i] + (pTile->rect.top / 2)*pDst->linesize[i] + pTile->rect.left / 2, pDst->linesize[i], nDstWidth / 2, nDstHeight / 2);
+}
+
+void CMosaicCompositor::ScaleTileProc(int nIndex, void *pParam)
+{
+	CMosaicCompositor *pThis = (CMosaicCompositor *)pParam;
+	pThis->ScaleTile(pThis->m_vecDirty[nIndex].get());
+}
+
+int CMosaicCompositor::Compose()
+{
+	CAutoLock lockCompose(&m_csCompose);
+	if (!m_pMosaicFrame)
+		return 0;
+	m_vecDirty.clear();
+	{
+		CAutoLock lock(&m_csLayout);
+		for (auto it = m_vecTile.begin(); it != m_vecTile.end(); it++)
+		{
+			if ((*it)->nDirty)
+				m_vecDirty.push_back(*it);
+		}
+	}
+	if (m_vecDirty.empty())
+		return 0;
+
+	TIMELINE_SCOPE("Compose", -1, TIMELINE_NO_PTS);
+	int64_t nT1 = MonoTimeNs();
+	// ƴͼлص,Բ
+	m_Workers.Run((int)m_vecDirty.size(), ScaleTileProc, this);
+	m_Stat.dfComposeTime += MonoNsToSeconds(MonoTimeNs() - nT1);
+	m_Stat.nComposedFrames++;
+	int nComposed = (int)m_vecDirty.size();
+	InterlockedExchangeAdd(&m_Stat.nScaledTiles, (LONG)nComposed);
+	// д,ClearTiles֮󴰸ͷ
+	m_vecDirty.clear();
+
+	if (m_pCallback)
+		m_pCallback(m_pMosaicFrame, m_pUserPtr);
+	return nComposed;
+}
+
+bool CMosaicCompositor::Start(int nInterval)
+{
+	if (m_hThread)
+		return true;
+	if (!m_pMosaicFrame)
+		return false;
+	m_nInterval = nInterval;
+	m_bThreadRun = true;
+	m_hThread = (HANDLE)_beginthreadex(nullptr, 0, ComposeThread, this, 0, nullptr);
+	if (!m_hThread)
+	{
+		m_bThreadRun = false;
+		return false;
+	}
+	return true;
+}
+
+void CMosaicCompositor::Stop()
+{
+	if (!m_hThread)
+		return;
+	m_bThreadRun = false;
+	WaitForSingleObject(m_hThread, INFINITE);
+	CloseHandle(m_hThread);
+	m_hThread = NULL;
+}
+
+UINT __stdcall CMosaicCompositor::ComposeThread(void *p)
+{
+	CMosaicCompositor *pThis = (CMosaicCompositor *)p;
+#ifdef _WIN32
+	if (pThis->m_pDxSurface && !pThis->m_pDxSurface->IsInited())
+	{
+		if (!pThis->m_pDxSurface->InitD3D(pThis->m_hPresentWnd,
+										  pThis->m_pMosaicFrame->width,
+										  pThis->m_pMosaicFrame->height,
+										  TRUE,
+										  (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2')))
+		{
+			DxTraceMsg("%s Failed in InitD3D.\n", __FUNCTION__);
+			return 0;
+		}
+	}
+#endif
+	TimelineSetThreadName("MosaicCompose");
+	while (pThis->m_bThreadRun)
+	{
+#ifdef _WIN32
+		int nComposed = pThis->Compose();
+		if (pThis->m_pDxSurface)
+		{
+			if (nComposed)
+			{// ģʽPresentȴֱͬ,ÿδֱͬʾһ
+				CAutoLock lock(&pThis->m_csCompose);
+				pThis->m_pDxSurface->Render(pThis->m_pMosaicFrame);
+			}
+			else
+				Sleep(5);
+		}
+		else
+			Sleep(pThis->m_nInterval);
+#else
+		pThis->Compose();
+		Sleep(pThis->m_nInterval);
+#endif
+	}
+	return 0;
+}
+
+void CMosaicCompositor::TraceStat()
+{
+	MosaicStat Stat;
+	GetStat(Stat);
+	DxTraceMsg("%s Composed = %d\tScaledTiles = %d\tSubmit = %d\tDropped = %d\tAvgComposeTime = %.3fms.\n", __FUNCTION__,
+				Stat.nComposedFrames, Stat.nScaledTiles, Stat.nSubmitFrames, Stat.nDroppedFrames,
+				Stat.nComposedFrames ? Stat.dfComposeTime * 1000 / Stat.nComposedFrames : 0.0f);
+}
@@ -0,0 +1,202 @@
+#pragma once
+#include "Win32Port.h"
+#include <vector>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include "AutoLock.h"
+#include "DxTrace.h"
+#include "FramePool.h"
+#include "PixelCopy.h"
+#ifdef _WIN32
+#include "DxSurface.h"
+#endif
+
+using namespace std;
+
+// ֵˮƽһ
+// pIndex[x]ΪĿxԴص,ҲԴصΪpIndex[x]+1
+// pWeight[x]ĵ16λΪصȨ,16λΪҲصȨ,֮Ϊ128,ֱΪ_mm_madd_epi16ϵ
+// ֵ֤pIndex[x]+1ԴͼĿ,SSE2汾ÿγɶԶȡ
+typedef void(*ScaleRowProc)(BYTE *pDst, const BYTE *pRow, const int *pIndex, const int *pWeight, int nDstWidth);
+
+// CPUѡź,֧SSE2ʱʹSSE2汾,ʹC汾
+extern ScaleRowProc ScaleRow;
+void ScaleRow_C(BYTE *pDst, const BYTE *pRow, const int *pIndex, const int *pWeight, int nDstWidth);
+#ifdef PIXELCOPY_SSE2
+void ScaleRow_SSE2(BYTE *pDst, const BYTE *pRow, const int *pIndex, const int *pWeight, int nDstWidth);
+#endif
+
+// ˮƽŵĲֵ
+struct MosaicScaleTable
+{
+	vector<int>	vecIndex;		// ÿĿԴص
+	vector<int>	vecWeight;		// ÿĿԴصȨ,16λΪ,16λΪҲ
+};
+
+// ɰnSrcWidthΪnDstWidthصĲֵ,ȡ
+void BuildScaleTable(MosaicScaleTable &Table, int nSrcWidth, int nDstWidth);
+
+/// @brief ϳɴĹ̳߳
+/// @remark Run߳Ҳ봦,ûй߳ʱŶڵ߳д
+/// ÿRunҪŴϲŷ,ͬһʱֻһ̵߳Run
+class CMosaicWorkers
+{
+public:
+	typedef void (*WorkProc)(int nIndex, void *pParam);
+	CMosaicWorkers();
+	~CMosaicWorkers();
+
+	// nThreads߳,nThreadsΪ0ʱ߳
+	bool Start(int nThreads);
+	void Stop();
+	int GetThreads()
+	{
+		return (int)m_vecThread.size();
+	}
+	// 0nCount-1ÿŵһpProc
+	void Run(int nCount, WorkProc pProc, void *pParam);
+private:
+	void Work();
+	static UINT __stdcall WorkerThread(void *p);
+
+	vector<HANDLE>	m_vecThread;
+	HANDLE			m_hStartSemaphore;	// ÿͷһλһ߳
+	HANDLE			m_hDoneEvent;		// в̶߳˳Work
+	volatile LONG	m_nNext;			// һ
+	volatile LONG	m_nCount;			// ε
+	volatile LONG	m_nActive;			// β봦δ˳Work߳,߳
+	WorkProc		m_pProc;
+	void			*m_pParam;
+	volatile bool	m_bRun;
+};
+
+// ƴӴ
+// ÿ񱣴Ӧͨµһ֡ͼ,ϳʱŵƴͼдڵ
+struct MosaicTile
+{
+	MosaicTile(HWND hWnd, const RECT &rtTile)
+	{
+		hTileWnd = hWnd;
+		rect = rtTile;
+		pFrame = av_frame_alloc();
+		nDirty = 0;
+		nSrcWidth = 0;
+		nSrcHeight = 0;
+		InitializeCriticalSection(&csTile);
+	}
+	~MosaicTile()
+	{
+		av_frame_free(&pFrame);
+		DeleteCriticalSection(&csTile);
+	}
+	HWND				hTileWnd;		// Ӧ崰,޴ģʽ½Ϊıʶ
+	RECT				rect;			// ƴͼеλ,ϽǺͿ߾Ϊż
+	AVFrame				*pFrame;		// µһ֡ͼ
+	volatile LONG		nDirty;			// µͼδϳ
+	int					nSrcWidth;		// ֵӦԴͼߴ,Դͼߴ仯ʱҪؽֵ
+	int					nSrcHeight;
+	MosaicScaleTable	ScaleY;			// ȷˮƽֵ
+	MosaicScaleTable	ScaleUV;		// ɫȷˮƽֵ
+	vector<BYTE>		vecRowBuffer;	// ֱֵл
+	CRITICAL_SECTION	csTile;
+};
+typedef shared_ptr<MosaicTile> MosaicTilePtr;
+
+struct MosaicStat
+{
+	LONG		nComposedFrames;	// Ѻϳɵƴͼ
+	LONG		nScaledTiles;		// ŵĴͼ
+	LONG		nSubmitFrames;		// ύͨͼ
+	LONG		nDroppedFrames;		// ϳ֮ǰͼ񸲸ǵͨͼ
+	double		dfComposeTime;		// ϳɵۼƺʱ,λ
+};
+
+// ƴӺϳɻص,ÿϳһ֡ƴͼһ,pMosaicFrameΪYUV420Pʽ,ڻصڼЧ
+typedef void (CALLBACK *MosaicCallback)(AVFrame *pMosaicFrame, void *pUserPtr);
+
+/// @brief CPUƴӺϳ
+/// @remark ÿͨʹöCDxSurfaceʱ,ÿ嶼ԼD3D豸ͽ,ͨﵽʮ·ʱ豸ԴPresentĿ
+/// ƴӺϳѸͨͼŵͬһƴͼĶӦ,ֻһCDxSurface,ÿδֱֻͬPresentһ
+/// ֻյͼĴŻᱻ,CMosaicWorkers,ֱл,ˮƽԤȼĲֵ,߶SSE2汾
+/// ʱָ޴ģʽ,ƴͼֻڴ,ͨصGetMosaicFrameȡ
+/// ʾֻWindows±,ϳɲֻWin32PortFFMPEGͼṹ,MultiDecoderTest
+class CMosaicCompositor
+{
+public:
+	CMosaicCompositor();
+	~CMosaicCompositor();
+
+	/// @brief ƴͼ
+	/// @param hPresentWnd	ʾƴͼĴ,ΪNULLʱ޴ģʽ
+	/// @param nWidth		ƴͼĿ
+	/// @param nHeight		ƴͼĸ߶
+	bool Create(HWND hPresentWnd, int nWidth, int nHeight);
+
+	/// @brief һ,ش,ʧʱ-1
+	/// @param hTileWnd		Ӧ崰,SubmitFrameøôھָ
+	/// @param rtTile		ƴͼеλ
+	int AddTile(HWND hTileWnd, const RECT &rtTile);
+
+	// ȡôƴͼеλ,λѰż
+	bool GetTileRect(int nTile, RECT &rtTile);
+
+	// ɾд,ƴͼΪɫ
+	void ClearTiles();
+
+	/// @brief ύһ֡ͨͼ,ֻ֧YUV420PYUVJ420Pʽ
+	/// @remark üͼֱ,һ,δϳɵͼᱻ
+	bool SubmitFrame(int nTile, AVFrame *pAvFrame);
+	bool SubmitFrame(HWND hTileWnd, AVFrame *pAvFrame);
+
+	// ϳͼĴ,رκϳɵĴ
+	int Compose();
+
+	// ϳ߳,дʱÿκϳɺPresentһ,ɴֱͬƽ,޴ʱnInterval(λ)ļϳ
+	bool Start(int nInterval = 20);
+	void Stop();
+
+	void SetCallback(MosaicCallback pCallback, void *pUserPtr)
+	{
+		m_pCallback = pCallback;
+		m_pUserPtr = pUserPtr;
+	}
+
+	// ȡƴͼ,߲޸
+	AVFrame *GetMosaicFrame()
+	{
+		return m_pMosaicFrame;
+	}
+
+	void GetStat(MosaicStat &Stat)
+	{
+		CAutoLock lock(&m_csCompose);
+		memcpy(&Stat, &m_Stat, sizeof(MosaicStat));
+	}
+	void TraceStat();
+private:
+	bool SubmitFrame(MosaicTile *pTile, AVFrame *pAvFrame);
+	void ScaleTile(MosaicTile *pTile);
+	static void ScaleTileProc(int nIndex, void *pParam);
+	static void ScalePlane(MosaicTile *pTile, MosaicScaleTable &Table, const BYTE *pSrc, int nSrcPitch, int nSrcWidth, int nSrcHeight, BYTE *pDst, int nDstPitch, int nDstWidth, int nDstHeight);
+	void FillBlack();
+	static UINT __stdcall ComposeThread(void *p);
+
+	HWND					m_hPresentWnd;
+#ifdef _WIN32
+	CDxSurface				*m_pDxSurface;
+#endif
+	CMosaicWorkers			m_Workers;
+	vector<MosaicTilePtr>	m_vecDirty;		// κϳɵĴ,ֻںϳڼʹ
+	AVFrame					*m_pMosaicFrame;
+	vector<MosaicTilePtr>	m_vecTile;
+	map<HWND, int>			m_mapTileWnd;
+	CRITICAL_SECTION		m_csLayout;		// б,ֻڲҺ޸Ĵʱݳ
+	CRITICAL_SECTION		m_csCompose;	// ƴͼ,m_csLayout
+	MosaicStat				m_Stat;
+	HANDLE					m_hThread;
+	volatile bool			m_bThreadRun;
+	int						m_nInterval;
+	MosaicCallback			m_pCallback;
+	void					*m_pUserPtr;
+};
@@ -0,0 +1,173 @@
+#include "OffscreenSurface.h"
+#include "PixelCopy.h"
+#include "HighBitdepth.h"
+#include "MonoClock.h"
+
+COffscreenSurface::COffscreenSurface()
+{
+	m_bInitialized = false;
+	m_hWnd = NULL;
+	m_nVideoWidth = 0;
+	m_nVideoHeight = 0;
+	m_pCopyFrame = av_frame_alloc();
+	m_pTargetFrame = av_frame_alloc();
+	m_pDumpFile = NULL;
+	m_nDumpInterval = 1;
+	ZeroMemory(&m_Stat, sizeof(OffscreenStat));
+	m_pLatency = NULL;
+}
+
+COffscreenSurface::~COffscreenSurface()
+{
+	DxCleanup();
+	SetDumpFile(NULL);
+	av_frame_free(&m_pCopyFrame);
+	av_frame_free(&m_pTargetFrame);
+}
+
+bool COffscreenSurface::InitD3D(HWND hWnd, int nVideoWidth, int nVideoHeight, BOOL bIsWindowed, D3DFORMAT nD3DFormat)
+{
+	if (nVideoWidth <= 0 || nVideoHeight <= 0)
+		return false;
+	MUTEX_LOCK(m_csRender);
+	DxCleanupLocked();
+	m_hWnd = hWnd;
+	m_nVideoWidth = nVideoWidth;
+	m_nVideoHeight = nVideoHeight;
+	m_bInitialized = true;
+	return true;
+}
+
+void COffscreenSurface::DxCleanup()
+{
+	MUTEX_LOCK(m_csRender);
+	DxCleanupLocked();
+}
+
+// ڳm_csRenderʱ,m_csRender
+void COffscreenSurface::DxCleanupLocked()
+{
+	av_frame_unref(m_pCopyFrame);
+	av_frame_unref(m_pTargetFrame);
+	m_bInitialized = false;
+}
+
+bool COffscreenSurface::SetDumpFile(LPCTSTR szPath, int nInterval)
+{
+	MUTEX_LOCK(m_csRender);
+	if (m_pDumpFile)
+	{
+		fclose(m_pDumpFile);
+		m_pDumpFile = NULL;
+	}
+	if (!szPath)
+		return true;
+	if (_tfopen_s(&m_pDumpFile, szPath, _T("wb")) != 0)
+	{
+		DxTraceMsg("%s Failed to open the dump file.\n", __FUNCTION__);
+		m_pDumpFile = NULL;
+		return false;
+	}
+	m_nDumpInterval = nInterval > 0 ? nInterval : 1;
+	return true;
+}
+
+// CDxSurfaceһֱ,ΪYUV420P
+bool COffscreenSurface::CopyDxvaFrame(AVFrame *pDxvaFrame)
+{
+	IDirect3DSurface9 *pSurface = (IDirect3DSurface9 *)pDxvaFrame->data[3];
+	D3DSURFACE_DESC Desc;
+	if (!pSurface || FAILED(pSurface->GetDesc(&Desc)))
+		return false;
+	if (!g_FramePool.GetFrameBuffer(m_pCopyFrame, AV_PIX_FMT_YUV420P, pDxvaFrame->width, pDxvaFrame->height))
+		return false;
+	D3DLOCKED_RECT Rect;
+	HRESULT hr = pSurface->LockRect(&Rect, NULL, D3DLOCK_READONLY);
+	if (FAILED(hr))
+	{
+		DxTraceMsg("%s LockRect failed,hr = %08X.\n", __FUNCTION__, hr);
+		return false;
+	}
+	const BYTE *pSrc = (const BYTE *)Rect.pBits;
+	if (Desc.Format == (D3DFORMAT)MAKEFOURCC('P', '0', '1', '0'))
+		CopyP010ToYUV420P(m_pCopyFrame->data, m_pCopyFrame->linesize, pSrc, Rect.Pitch, Desc.Height, pDxvaFrame->width, pDxvaFrame->height);
+	else
+		CopyNV12ToYUV420P(m_pCopyFrame->data, m_pCopyFrame->linesize, pSrc, pSrc + Rect.Pitch * Desc.Height, Rect.Pitch, pDxvaFrame->width, pDxvaFrame->height);
+	pSurface->UnlockRect();
+	return true;
+}
+
+bool COffscreenSurface::Render(AVFrame *pAvFrame, HWND hWnd, RECT *pRenderRt)
+{
+	if (!pAvFrame)
+		return false;
+	MUTEX_LOCK(m_csRender);
+	if (!m_bInitialized)
+		return false;
+	int64_t nT1 = MonoTimeNs();
+	AVFrame *pSrcFrame = pAvFrame;
+	if (pAvFrame->format == AV_PIX_FMT_DXVA2_VLD)
+	{
+		if (!CopyDxvaFrame(pAvFrame))
+			return false;
+		pSrcFrame = m_pCopyFrame;
+	}
+	int64_t nT2 = MonoTimeNs();
+
+	// Ŀߴ,ӦCDxSurfaceStretchRectĿ
+	int nDstWidth = m_nVideoWidth;
+	int nDstHeight = m_nVideoHeight;
+	RECT rtClient = { 0 };
+	HWND hRenderWnd = hWnd ? hWnd : m_hWnd;
+	if (pRenderRt)
+		rtClient = *pRenderRt;
+	else if (hRenderWnd)
+		GetClientRect(hRenderWnd, &rtClient);
+	if (rtClient.right - rtClient.left > 0 && rtClient.bottom - rtClient.top > 0)
+	{
+		nDstWidth = rtClient.right - rtClient.left;
+		nDstHeight = rtClient.bottom - rtClient.top;
+	}
+	if (m_pTargetFrame->width != nDstWidth || m_pTargetFrame->height != nDstHeight || !m_pTargetFrame->buf[0])
+	{
+		if (!g_FramePool.GetFrameBuffer(m_pTargetFrame, AV_PIX_FMT_BGRA, nDstWidth, nDstHeight, MemTag_Convert))
+			return false;
+	}
+
+	SwsContextKey Key = { pSrcFrame->width, pSrcFrame->height, (AVPixelFormat)pSrcFrame->format,
+						  nDstWidth, nDstHeight, AV_PIX_FMT_BGRA, SWS_FAST_BILINEAR };
+	SwsContext *pContext = g_SwsContextCache.Acquire(Key);
+	if (!pContext)
+		return false;
+	sws_scale(pContext, (const byte * const *)pSrcFrame->data, pSrcFrame->linesize, 0, pSrcFrame->height, m_pTargetFrame->data, m_pTargetFrame->linesize);
+	g_SwsContextCache.Release(Key, pContext);
+	m_pTargetFrame->pts = pAvFrame->pts;
+	int64_t nT3 = MonoTimeNs();
+
+	if (m_pDumpFile && (m_Stat.nRendered % m_nDumpInterval) == 0)
+	{
+		for (int i = 0; i < nDstHeight; i++)
+			fwrite(m_pTargetFrame->data[0] + i * m_pTargetFrame->linesize[0], 1, nDstWidth * 4, m_pDumpFile);
+		m_Stat.nDumped++;
+	}
+	m_Stat.nRendered++;
+	m_Stat.dfCopyTime += MonoNsToSeconds(nT2 - nT1);
+	m_Stat.dfScaleTime += MonoNsToSeconds(nT3 - nT2);
+	if (m_pLatency)
+	{
+		if (pSrcFrame != pAvFrame)
+			m_pLatency->Record(LatencyStage_Download, nT1, nT2);
+		m_pLatency->Record(LatencyStage_Convert, nT2, nT3);
+	}
+	return true;
+}
+
+void COffscreenSurface::TraceStat()
+{
+	OffscreenStat Stat;
+	GetStat(Stat);
+	DxTraceMsg("%s Rendered = %d\tDumped = %d\tAvgCopy = %.3fms\tAvgScale = %.3fms.\n", __FUNCTION__,
+				Stat.nRendered, Stat.nDumped,
+				Stat.nRendered ? Stat.dfCopyTime * 1000 / Stat.nRendered : 0.0f,
+				Stat.nRendered ? Stat.dfScaleTime * 1000 / Stat.nRendered : 0.0f);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <windows.h>
+#include <stdio.h>
+#include <tchar.h>
+#include "RenderSurface.h"
+#include "AutoLock.h"
+#include "AdaptiveLock.h"
+#include "DxTrace.h"
+#include "FramePool.h"
+#include "SwsContextCache.h"
+#include "LatencyHistogram.h"
+
+struct OffscreenStat
+{
+	LONG		nRendered;		// Ⱦ֡
+	LONG		nDumped;		// дתļ֡
+	double		dfCopyTime;		// Ӳ֡Ƶڴۼƺʱ,λ
+	double		dfScaleTime;	// ʽתŵۼƺʱ,λ
+};
+
+/// @brief Ⱦ
+/// @remark D3D豸,ҲҪʾ,CDxSurfaceͬĲ账ÿһ֡:Ӳ֡ȸƵڴ,
+/// תΪ̨ͬBGRAʽŵĿߴ,ֻǽڴ,ɰתļ
+/// ĿߴȡRenderpRenderRtʾڵĿͻƵͼĳߴ
+class COffscreenSurface :public IRenderSurface
+{
+public:
+	COffscreenSurface();
+	virtual ~COffscreenSurface();
+
+	virtual bool InitD3D(HWND hWnd,
+		int nVideoWidth,
+		int nVideoHeight,
+		BOOL bIsWindowed = TRUE,
+		D3DFORMAT nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'));
+
+	// û豸,
+	virtual bool InitD3DShared(HWND hWnd,
+		IDirect3DDevice9 *pDevice,
+		int nVideoWidth,
+		int nVideoHeight,
+		D3DFORMAT nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'))
+	{
+		return false;
+	}
+	virtual void DetachSharedDevice()
+	{
+	}
+	virtual bool IsInited()
+	{
+		return m_bInitialized;
+	}
+	virtual bool Render(AVFrame *pAvFrame, HWND hWnd = NULL, RECT *pRenderRt = NULL);
+
+	// ûпɶʧ豸
+	virtual bool HandelDevLost()
+	{
+		return m_bInitialized;
+	}
+	virtual void DxCleanup();
+
+	virtual void SetLatency(CChannelLatency *pLatency)
+	{
+		m_pLatency = pLatency;
+	}
+
+	/// @brief תļ,ȾBGRAԭʼ׷ӵļ
+	/// @param szPath		תļ·,ΪNULLʱֹͣת
+	/// @param nInterval	ÿ֡תһ֡
+	bool SetDumpFile(LPCTSTR szPath, int nInterval = 1);
+
+	// ȡһȾĽ,߲޸
+	AVFrame *GetTargetFrame()
+	{
+		return m_pTargetFrame;
+	}
+
+	void GetStat(OffscreenStat &Stat)
+	{
+		MUTEX_LOCK(m_csRender);
+		memcpy(&Stat, &m_Stat, sizeof(OffscreenStat));
+	}
+	void TraceStat();
+private:
+	bool CopyDxvaFrame(AVFrame *pDxvaFrame);
+	void DxCleanupLocked();
+
+	CSpinMutex			m_csRender;
+	bool				m_bInitialized;
+	HWND				m_hWnd;
+	int					m_nVideoWidth;
+	int					m_nVideoHeight;
+	AVFrame				*m_pCopyFrame;		// Ӳ֡ƵڴYUV420Pͼ
+	AVFrame				*m_pTargetFrame;	// Ⱦ,BGRAʽ
+	FILE				*m_pDumpFile;
+	int					m_nDumpInterval;
+	OffscreenStat		m_Stat;
+	CChannelLatency		*m_pLatency;
+};
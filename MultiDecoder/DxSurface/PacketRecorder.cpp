@@ -0,0 +1,326 @@
+#include "PacketRecorder.h"
+#ifdef _WIN32
+#include <process.h>
+
+CFFmpegRecordMuxer::CFFmpegRecordMuxer(const AVCodecContext *pCodecCtx, AVRational nTimeBase)
+{
+	m_pCodecCtx = pCodecCtx;
+	m_pFormatCtx = NULL;
+	m_pStream = NULL;
+	m_nTimeBase = nTimeBase;
+	m_bHeaderWritten = false;
+}
+
+CFFmpegRecordMuxer::~CFFmpegRecordMuxer()
+{
+	Close();
+}
+
+bool CFFmpegRecordMuxer::Open(const char *szPath)
+{
+	char szAvError[1024] = { 0 };
+	int nAvError = avformat_alloc_output_context2(&m_pFormatCtx, NULL, NULL, szPath);
+	if (nAvError < 0 || !m_pFormatCtx)
+	{
+		av_strerror(nAvError, szAvError, 1024);
+		DxTraceMsg("%s avformat_alloc_output_context2 failed:%s.\n", __FUNCTION__, szAvError);
+		return false;
+	}
+	m_pStream = avformat_new_stream(m_pFormatCtx, NULL);
+	if (!m_pStream || avcodec_copy_context(m_pStream->codec, m_pCodecCtx) < 0)
+	{
+		DxTraceMsg("%s Failed to create the output stream.\n", __FUNCTION__);
+		return false;
+	}
+	m_pStream->codec->codec_tag = 0;
+	if (m_pFormatCtx->oformat->flags & AVFMT_GLOBALHEADER)
+		m_pStream->codec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+	m_pStream->time_base = m_nTimeBase;
+	if ((nAvError = avio_open(&m_pFormatCtx->pb, szPath, AVIO_FLAG_WRITE)) < 0 ||
+		(nAvError = avformat_write_header(m_pFormatCtx, NULL)) < 0)
+	{
+		av_strerror(nAvError, szAvError, 1024);
+		DxTraceMsg("%s Failed to open %s:%s.\n", __FUNCTION__, szPath, szAvError);
+		return false;
+	}
+	m_bHeaderWritten = true;
+	return true;
+}
+
+bool CFFmpegRecordMuxer::WritePacket(const uint8_t *pData, int nSize, bool bKeyFrame, int64_t nPts, int64_t nDts, int64_t nDuration)
+{
+	AVPacket AvPacket;
+	av_init_packet(&AvPacket);
+	AvPacket.data = (uint8_t *)pData;
+	AvPacket.size = nSize;
+	AvPacket.stream_index = m_pStream->index;
+	AvPacket.flags = bKeyFrame ? AV_PKT_FLAG_KEY : 0;
+	AvPacket.dts = av_rescale_q(nDts, m_nTimeBase, m_pStream->time_base);
+	AvPacket.pts = av_rescale_q(nPts, m_nTimeBase, m_pStream->time_base);
+	AvPacket.duration = av_rescale_q(nDuration, m_nTimeBase, m_pStream->time_base);
+	int nAvError = av_write_frame(m_pFormatCtx, &AvPacket);
+	if (nAvError < 0)
+	{
+		DxTraceMsg("%s av_write_frame failed,error = %d.\n", __FUNCTION__, nAvError);
+		return false;
+	}
+	return true;
+}
+
+void CFFmpegRecordMuxer::Close()
+{
+	if (m_bHeaderWritten)
+	{
+		av_write_trailer(m_pFormatCtx);
+		m_bHeaderWritten = false;
+	}
+	if (m_pFormatCtx)
+	{
+		if (m_pFormatCtx->pb)
+			avio_closep(&m_pFormatCtx->pb);
+		avformat_free_context(m_pFormatCtx);
+		m_pFormatCtx = NULL;
+		m_pStream = NULL;
+	}
+}
+#endif
+
+CPacketRecorder::CPacketRecorder()
+{
+	m_pMuxer = NULL;
+	m_nFrameDuration = 40;
+	m_nMemoryChannel = MEMORY_SHARED_CHANNEL;
+	m_nAccountedBytes = 0;
+	m_nPacketHead = 0;
+	m_nPacketCount = 0;
+	m_nWriteOffset = 0;
+	m_nReadOffset = 0;
+	m_bWaitKeyFrame = true;
+	m_nLastDts = AV_NOPTS_VALUE;
+	m_nDtsOffset = 0;
+	m_nNextDts = 0;
+	ZeroMemory(&m_Stat, sizeof(RecorderStat));
+	m_hEventData = NULL;
+	m_hEventExit = NULL;
+	m_hThread = NULL;
+	InitializeCriticalSection(&m_csBuffer);
+}
+
+CPacketRecorder::~CPacketRecorder()
+{
+	Close();
+	DeleteCriticalSection(&m_csBuffer);
+}
+
+bool CPacketRecorder::Create(const char *szPath, IRecordMuxer *pMuxer, int64_t nFrameDuration, int nBufferSize, int nMaxPackets)
+{
+	Close();
+	if (!szPath || !pMuxer || nBufferSize <= 0 || nMaxPackets <= 0)
+	{
+		delete pMuxer;
+		return false;
+	}
+	m_pMuxer = pMuxer;
+	if (!m_pMuxer->Open(szPath))
+	{
+		Close();
+		return false;
+	}
+	m_nFrameDuration = nFrameDuration > 0 ? nFrameDuration : 1;
+	m_vecBuffer.resize(nBufferSize);
+	RecordPacket Packet;
+	ZeroMemory(&Packet, sizeof(RecordPacket));
+	m_vecPacket.assign(nMaxPackets, Packet);
+	m_nAccountedBytes = nBufferSize + (LONGLONG)nMaxPackets * sizeof(RecordPacket);
+	g_MemoryAccount.Alloc(MemTag_Record, m_nMemoryChannel, m_nAccountedBytes);
+	m_nPacketHead = 0;
+	m_nPacketCount = 0;
+	m_nWriteOffset = 0;
+	m_nReadOffset = 0;
+	m_bWaitKeyFrame = true;
+	m_nLastDts = AV_NOPTS_VALUE;
+	m_nDtsOffset = 0;
+	m_nNextDts = 0;
+	ZeroMemory(&m_Stat, sizeof(RecorderStat));
+	m_hEventData = CreateEvent(NULL, FALSE, FALSE, NULL);
+	m_hEventExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_hThread = (HANDLE)_beginthreadex(nullptr, 0, RecordThread, this, 0, nullptr);
+	if (!m_hThread)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+#ifdef _WIN32
+bool CPacketRecorder::Create(const char *szPath, const AVCodecContext *pCodecCtx, AVRational nTimeBase, AVRational nFrameRate, int nBufferSize, int nMaxPackets)
+{
+	if (!pCodecCtx || nTimeBase.num <= 0 || nTimeBase.den <= 0)
+		return false;
+	int64_t nFrameDuration = 0;
+	if (nFrameRate.num > 0 && nFrameRate.den > 0)
+		nFrameDuration = av_rescale_q(1, av_inv_q(nFrameRate), nTimeBase);
+	else
+	{
+		AVRational nMillisecond = { 1, 1000 };
+		nFrameDuration = av_rescale_q(40, nMillisecond, nTimeBase);
+	}
+	return Create(szPath, new CFFmpegRecordMuxer(pCodecCtx, nTimeBase), nFrameDuration, nBufferSize, nMaxPackets);
+}
+#endif
+
+void CPacketRecorder::Close()
+{
+	if (m_hThread)
+	{// I/O߳˳֮ǰд껺е֡
+		SetEvent(m_hEventExit);
+		WaitForSingleObject(m_hThread, INFINITE);
+		CloseHandle(m_hThread);
+		m_hThread = NULL;
+	}
+	if (m_pMuxer)
+	{
+		m_pMuxer->Close();
+		delete m_pMuxer;
+		m_pMuxer = NULL;
+	}
+	if (m_hEventData)
+	{
+		CloseHandle(m_hEventData);
+		m_hEventData = NULL;
+	}
+	if (m_hEventExit)
+	{
+		CloseHandle(m_hEventExit);
+		m_hEventExit = NULL;
+	}
+	m_vecBuffer.clear();
+	m_vecPacket.clear();
+	if (m_nAccountedBytes)
+	{
+		g_MemoryAccount.Free(MemTag_Record, m_nMemoryChannel, m_nAccountedBytes);
+		m_nAccountedBytes = 0;
+	}
+}
+
+bool CPacketRecorder::Write(const uint8_t *pData, int nSize, bool bKeyFrame, int64_t nPts, int64_t nDts)
+{
+	if (!m_hThread || !pData || nSize <= 0)
+		return false;
+	CAutoLock lock(&m_csBuffer);
+	if (m_bWaitKeyFrame && !bKeyFrame)
+	{
+		m_Stat.nSkipped++;
+		return false;
+	}
+	// ݻΪ֡Ŀռ,βռ䲻ʱӻͷʼ
+	int nBufferSize = (int)m_vecBuffer.size();
+	int nOffset = -1;
+	if (m_nPacketCount == 0)
+	{
+		m_nReadOffset = 0;
+		m_nWriteOffset = 0;
+		if (nSize <= nBufferSize)
+			nOffset = 0;
+	}
+	else if (m_nPacketCount < (int)m_vecPacket.size())
+	{
+		if (m_nWriteOffset >= m_nReadOffset)
+		{
+			if (m_nWriteOffset + nSize <= nBufferSize)
+				nOffset = m_nWriteOffset;
+			else if (nSize < m_nReadOffset)
+				nOffset = 0;
+		}
+		else if (m_nWriteOffset + nSize < m_nReadOffset)
+			nOffset = m_nWriteOffset;
+	}
+	if (nOffset < 0)
+	{// I/Oʱ֡,˺ķǹؼ֡޷,һֱһؼ֡
+		m_Stat.nDropped++;
+		m_bWaitKeyFrame = true;
+		return false;
+	}
+	m_bWaitKeyFrame = false;
+	memcpy(&m_vecBuffer[nOffset], pData, nSize);
+	m_nWriteOffset = nOffset + nSize;
+	RecordPacket &Packet = m_vecPacket[(m_nPacketHead + m_nPacketCount) % m_vecPacket.size()];
+	Packet.nOffset = nOffset;
+	Packet.nSize = nSize;
+	Packet.bKeyFrame = bKeyFrame;
+	Packet.nPts = nPts;
+	Packet.nDts = nDts;
+	m_nPacketCount++;
+	SetEvent(m_hEventData);
+	return true;
+}
+
+// ʱдһ֡,ֻI/O߳е
+void CPacketRecorder::WritePacket(RecordPacket &Packet)
+{
+	int64_t nDts = (Packet.nDts != AV_NOPTS_VALUE) ? Packet.nDts : Packet.nPts;
+	int64_t nOutDts = 0;
+	int64_t nOutPts = 0;
+	if (nDts == AV_NOPTS_VALUE)
+	{// ûʱʱ֡
+		nOutDts = m_nNextDts;
+		nOutPts = nOutDts;
+	}
+	else
+	{
+		if (m_nLastDts == AV_NOPTS_VALUE)
+			m_nDtsOffset = -nDts;						// ʱ0ʼ
+		else if (nDts + m_nDtsOffset <= m_nLastDts)
+			m_nDtsOffset = m_nNextDts - nDts;			// ʱ,һ֡
+		nOutDts = nDts + m_nDtsOffset;
+		nOutPts = ((Packet.nPts != AV_NOPTS_VALUE) ? Packet.nPts : nDts) + m_nDtsOffset;
+	}
+	m_nLastDts = nOutDts;
+	m_nNextDts = nOutDts + m_nFrameDuration;
+
+	bool bWritten = m_pMuxer->WritePacket(&m_vecBuffer[Packet.nOffset], Packet.nSize, Packet.bKeyFrame, nOutPts, nOutDts, m_nFrameDuration);
+	CAutoLock lock(&m_csBuffer);
+	if (bWritten)
+	{
+		m_Stat.nWritten++;
+		m_Stat.nBytes += Packet.nSize;
+	}
+}
+
+UINT __stdcall CPacketRecorder::RecordThread(void *p)
+{
+	CPacketRecorder *pThis = (CPacketRecorder *)p;
+	HANDLE hEvents[2] = { pThis->m_hEventExit, pThis->m_hEventData };
+	g_ThreadPlacement.Apply(ThreadRole_IO, pThis->m_nMemoryChannel);
+	bool bExit = false;
+	while (!bExit)
+	{
+		bExit = (WaitForMultipleObjects(2, hEvents, FALSE, INFINITE) != WAIT_OBJECT_0 + 1);
+		while (true)
+		{
+			RecordPacket Packet;
+			{
+				CAutoLock lock(&pThis->m_csBuffer);
+				if (!pThis->m_nPacketCount)
+					break;
+				Packet = pThis->m_vecPacket[pThis->m_nPacketHead];
+			}
+			// дļڼ֡ڶ,ݲᱻWrite
+			pThis->WritePacket(Packet);
+			CAutoLock lock(&pThis->m_csBuffer);
+			pThis->m_nPacketHead = (pThis->m_nPacketHead + 1) % pThis->m_vecPacket.size();
+			pThis->m_nPacketCount--;
+			pThis->m_nReadOffset = pThis->m_nPacketCount ? pThis->m_vecPacket[pThis->m_nPacketHead].nOffset : pThis->m_nWriteOffset;
+		}
+	}
+	return 0;
+}
+
+void CPacketRecorder::TraceStat()
+{
+	RecorderStat Stat;
+	GetStat(Stat);
+	DxTraceMsg("%s Written = %d(%lld KB)\tSkipped = %d\tDropped = %d.\n", __FUNCTION__,
+				Stat.nWritten, (long long)(Stat.nBytes / 1024), Stat.nSkipped, Stat.nDropped);
+}
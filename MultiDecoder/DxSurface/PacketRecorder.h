@@ -0,0 +1,201 @@
+#pragma once
+#include "Win32Port.h"
+#include <vector>
+#include "AutoLock.h"
+#include "DxTrace.h"
+#include "MemoryAccount.h"
+#include "ThreadPlacement.h"
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define __STDC_CONSTANT_MACROS
+#include "libavutil/avutil.h"
+#ifdef _WIN32
+#include "libavformat/avformat.h"
+#include "libavcodec/avcodec.h"
+#endif
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+
+using namespace std;
+
+// еһѹ֡
+struct RecordPacket
+{
+	int			nOffset;		// ݻеƫ
+	int			nSize;
+	bool		bKeyFrame;
+	int64_t		nPts;
+	int64_t		nDts;
+};
+
+struct RecorderStat
+{
+	LONG		nWritten;		// дļ֡
+	LONG		nSkipped;		// ȴؼ֡ڼ֡
+	LONG		nDropped;		// 򻺳֡,һؼ֡¿ʼд
+	LONGLONG	nBytes;			// дļֽ
+};
+
+/// @brief ¼ļķװ
+/// @remark ʵʱCFFmpegRecordMuxerװΪMP4MKV,ʱԻд򵥸ʽģʵ
+/// OpenCPacketRecorder::Createе,WritePacketI/O߳е,CloseI/O߳˳
+class IRecordMuxer
+{
+public:
+	virtual ~IRecordMuxer() {}
+	virtual bool Open(const char *szPath) = 0;
+	// дһ֡,ʱʱΪλ,Ѵ0ʼ
+	virtual bool WritePacket(const uint8_t *pData, int nSize, bool bKeyFrame, int64_t nPts, int64_t nDts, int64_t nDuration) = 0;
+	// дļβرļ,OpenʧܺҲ
+	virtual void Close() = 0;
+};
+
+#ifdef _WIN32
+// libavformatѹ֡װΪļ,װʽļչ
+class CFFmpegRecordMuxer : public IRecordMuxer
+{
+public:
+	// pCodecCtxΪı,extradata,ֻOpenʹ
+	CFFmpegRecordMuxer(const AVCodecContext *pCodecCtx, AVRational nTimeBase);
+	virtual ~CFFmpegRecordMuxer();
+	virtual bool Open(const char *szPath);
+	virtual bool WritePacket(const uint8_t *pData, int nSize, bool bKeyFrame, int64_t nPts, int64_t nDts, int64_t nDuration);
+	virtual void Close();
+private:
+	const AVCodecContext	*m_pCodecCtx;
+	AVFormatContext			*m_pFormatCtx;
+	AVStream				*m_pStream;
+	AVRational				m_nTimeBase;
+	bool					m_bHeaderWritten;
+};
+#endif
+
+/// @brief ѹֱ֡ͨ¼
+/// @remark ͨѹ֡±ֱӽװдļ
+/// Writeֻѹ֡ƵԤȷĻλ,װдļڶI/O߳н,
+/// ¼ĵһ֡Լ֡ĵһ֡ǹؼ֡;ʱ(ѭ)ʱԶ,֤ʱ
+/// Writeֻһ߳е
+class CPacketRecorder
+{
+public:
+	CPacketRecorder();
+	~CPacketRecorder();
+
+	/// @brief ¼ļI/O߳
+	/// @param szPath		¼ļ·
+	/// @param pMuxer		װ,¼ͷ,ʧʱҲͷ
+	/// @param nFrameDuration	һ֡ʱ,ʱΪλ,ȱʧʱ
+	/// @param nBufferSize	λֽ
+	/// @param nMaxPackets	λɵ֡
+	bool Create(const char *szPath, IRecordMuxer *pMuxer, int64_t nFrameDuration,
+				int nBufferSize = 8 * 1024 * 1024, int nMaxPackets = 1024);
+
+#ifdef _WIN32
+	/// @brief CFFmpegRecordMuxerMP4MKV¼ļ,װʽļչ
+	/// @param pCodecCtx	ı,extradata
+	/// @param nTimeBase	ʱʱ
+	/// @param nFrameRate	֡,ȱʧʱ
+	bool Create(const char *szPath, const AVCodecContext *pCodecCtx, AVRational nTimeBase, AVRational nFrameRate,
+				int nBufferSize = 8 * 1024 * 1024, int nMaxPackets = 1024);
+#endif
+
+	// д껺е֡,дļβرļ
+	void Close();
+
+	// ûڴͳͨ,Create֮ǰ
+	void SetChannel(int nChannel)
+	{
+		m_nMemoryChannel = nChannel;
+	}
+
+	// дһѹ֡,ʱ֡false
+	bool Write(const uint8_t *pData, int nSize, bool bKeyFrame, int64_t nPts, int64_t nDts);
+
+	void GetStat(RecorderStat &Stat)
+	{
+		CAutoLock lock(&m_csBuffer);
+		memcpy(&Stat, &m_Stat, sizeof(RecorderStat));
+	}
+	void TraceStat();
+private:
+	CPacketRecorder(const CPacketRecorder &);
+	CPacketRecorder &operator=(const CPacketRecorder &);
+	void WritePacket(RecordPacket &Packet);
+	static UINT __stdcall RecordThread(void *p);
+
+	IRecordMuxer			*m_pMuxer;
+	int64_t					m_nFrameDuration;	// һ֡ʱ,ʱΪλ
+	int						m_nMemoryChannel;
+	LONGLONG				m_nAccountedBytes;	// g_MemoryAccountֽ
+	vector<uint8_t>			m_vecBuffer;		// ѹ֡ݻ
+	vector<RecordPacket>	m_vecPacket;		// ѹ֡Ļζ
+	int						m_nPacketHead;
+	int						m_nPacketCount;
+	int						m_nWriteOffset;		// һ֡ݵдλ
+	int						m_nReadOffset;		// һ֡ݵλ,кƫƶm_csBuffer
+	bool					m_bWaitKeyFrame;	// ֻWriteз
+	int64_t					m_nLastDts;			// ʱֻI/O߳з
+	int64_t					m_nDtsOffset;
+	int64_t					m_nNextDts;
+	CRITICAL_SECTION		m_csBuffer;
+	RecorderStat			m_Stat;
+	HANDLE					m_hEventData;
+	HANDLE					m_hEventExit;
+	HANDLE					m_hThread;
+};
+
+/// @brief ߳е¼λ
+/// @remark Ӳ̶߳е˳Ѷȡÿһ֡Feed,µ¼һؼ֡ʼ,
+/// Ȳдùؼ֮֡Ѷȡ֡,¼ļGOPʼ,صȴһؼ֡
+/// IteratorָpDatanLengthbKeyFramenPtsnDtsԱָ֡,뱣֤Щ֡ڶȡڼЧ
+template<class Iterator>
+class CRecordCursor
+{
+public:
+	// ItEndΪеĽλ,ʾûжؼ֡
+	explicit CRecordCursor(Iterator ItEnd)
+		: m_ItKeyFrame(ItEnd)
+		, m_ItEnd(ItEnd)
+		, m_pLastRecorder(NULL)
+	{
+	}
+
+	// дͷѭʱ,֮ǰĹؼ֡˺ȡ֡
+	void Reset()
+	{
+		m_ItKeyFrame = m_ItEnd;
+	}
+
+	/// @brief ȡһ֡
+	/// @param pRecorder	ͨǰ¼,ΪNULLʱ¼;뱣֤Feedڼ¼ᱻر
+	void Feed(Iterator ItFrame, CPacketRecorder *pRecorder)
+	{
+		if ((*ItFrame)->bKeyFrame)
+			m_ItKeyFrame = ItFrame;
+		if (!pRecorder)
+		{
+			m_pLastRecorder = NULL;
+			return;
+		}
+		if (pRecorder != m_pLastRecorder)
+		{
+			m_pLastRecorder = pRecorder;
+			if (m_ItKeyFrame != m_ItEnd)
+			{
+				for (Iterator it = m_ItKeyFrame; it != ItFrame; ++it)
+					pRecorder->Write((*it)->pData, (*it)->nLength, (*it)->bKeyFrame, (*it)->nPts, (*it)->nDts);
+			}
+		}
+		pRecorder->Write((*ItFrame)->pData, (*ItFrame)->nLength, (*ItFrame)->bKeyFrame, (*ItFrame)->nPts, (*ItFrame)->nDts);
+	}
+private:
+	Iterator			m_ItKeyFrame;		// һѶȡĹؼ֡
+	Iterator			m_ItEnd;
+	CPacketRecorder		*m_pLastRecorder;	// Ѵӹؼ֡ʼд¼
+};
@@ -0,0 +1,102 @@
+#include "PixelCopy.h"
+#ifdef PIXELCOPY_SSE2
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// ȡCPUIDܺ1ECXEDX
+static bool CpuidFeature(int &nECX, int &nEDX)
+{
+#if defined(PIXELCOPY_SSE2) && defined(_MSC_VER)
+	int nInfo[4];
+	__cpuid(nInfo, 1);
+	nECX = nInfo[2];
+	nEDX = nInfo[3];
+	return true;
+#elif defined(PIXELCOPY_SSE2)
+	unsigned int nEAX, nEBX, nC, nD;
+	if (!__get_cpuid(1, &nEAX, &nEBX, &nC, &nD))
+		return false;
+	nECX = (int)nC;
+	nEDX = (int)nD;
+	return true;
+#else
+	nECX = nEDX = 0;
+	return false;
+#endif
+}
+
+bool CpuSupportsSSE2()
+{
+	int nECX, nEDX;
+	return CpuidFeature(nECX, nEDX) && (nEDX & (1 << 26)) != 0;
+}
+
+bool CpuSupportsSSE41()
+{
+	int nECX, nEDX;
+	return CpuidFeature(nECX, nEDX) && (nECX & (1 << 19)) != 0;
+}
+
+void CopyPlane(BYTE *dst, size_t dst_pitch, const BYTE *src, size_t src_pitch, unsigned width, unsigned height)
+{
+	unsigned int y;
+	for (y = 0; y < height; y++)
+	{
+		memcpy(dst, src, width);
+		src += src_pitch;
+		dst += dst_pitch;
+	}
+}
+
+void SplitUV_C(BYTE *pDstU, int nDstPitchU, BYTE *pDstV, int nDstPitchV, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight)
+{
+	for (int y = 0; y < nHeight; y++)
+	{
+		const BYTE *pSrcRow = pSrcUV + y*nSrcPitch;
+		BYTE *pDstURow = pDstU + y*nDstPitchU;
+		BYTE *pDstVRow = pDstV + y*nDstPitchV;
+		for (int x = 0; x < nWidth; x++)
+		{
+			pDstURow[x] = pSrcRow[2 * x];
+			pDstVRow[x] = pSrcRow[2 * x + 1];
+		}
+	}
+}
+
+#ifdef PIXELCOPY_SSE2
+// ÿδ16UV,Uλÿ16λԪĵ8λ,Vλڸ8λ
+void SplitUV_SSE2(BYTE *pDstU, int nDstPitchU, BYTE *pDstV, int nDstPitchV, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight)
+{
+	__m128i xmmMask = _mm_set1_epi16(0x00FF);
+	for (int y = 0; y < nHeight; y++)
+	{
+		const BYTE *pSrcRow = pSrcUV + y*nSrcPitch;
+		BYTE *pDstURow = pDstU + y*nDstPitchU;
+		BYTE *pDstVRow = pDstV + y*nDstPitchV;
+		int x = 0;
+		for (; x + 16 <= nWidth; x += 16)
+		{
+			__m128i xmm0 = _mm_loadu_si128((const __m128i *)(pSrcRow + 2 * x));
+			__m128i xmm1 = _mm_loadu_si128((const __m128i *)(pSrcRow + 2 * x + 16));
+			__m128i xmmU = _mm_packus_epi16(_mm_and_si128(xmm0, xmmMask), _mm_and_si128(xmm1, xmmMask));
+			__m128i xmmV = _mm_packus_epi16(_mm_srli_epi16(xmm0, 8), _mm_srli_epi16(xmm1, 8));
+			_mm_storeu_si128((__m128i *)(pDstURow + x), xmmU);
+			_mm_storeu_si128((__m128i *)(pDstVRow + x), xmmV);
+		}
+		for (; x < nWidth; x++)
+		{
+			pDstURow[x] = pSrcRow[2 * x];
+			pDstVRow[x] = pSrcRow[2 * x + 1];
+		}
+	}
+}
+
+SplitUVProc SplitUV = CpuSupportsSSE2() ? SplitUV_SSE2 : SplitUV_C;
+#else
+SplitUVProc SplitUV = SplitUV_C;
+#endif
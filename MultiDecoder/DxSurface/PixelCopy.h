@@ -0,0 +1,90 @@
+#pragma once
+#include "Win32Port.h"
+
+// ͼƽ渴ƺתĻ
+// кԴĿԵпд,ֻÿеЧ,ߵͼɫȷȡ(n+1)/2
+// SIMD汾ĺһC汾,ΪSIMD汾Ĳοʵ,ߵֽһ
+// ļHighBitdepthFFMPEGD3D,MultiDecoderTestղοв
+
+// ֻx86/x64űSSE汾
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define PIXELCOPY_SSE2
+#endif
+
+// CPUǷ֧SSE2SSE4.1,֧SSEƽ̨false
+bool CpuSupportsSSE2();
+bool CpuSupportsSSE41();
+
+// һƽ,ÿиwidthֽ
+void CopyPlane(BYTE *dst, size_t dst_pitch, const BYTE *src, size_t src_pitch, unsigned width, unsigned height);
+
+// NV12UV֯ƽΪUVƽ,nWidthΪÿUVԵĸ
+typedef void(*SplitUVProc)(BYTE *pDstU, int nDstPitchU, BYTE *pDstV, int nDstPitchV, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight);
+
+// CPUѡĲֺ,֧SSE2ʱʹSSE2汾,ʹC汾
+extern SplitUVProc SplitUV;
+void SplitUV_C(BYTE *pDstU, int nDstPitchU, BYTE *pDstV, int nDstPitchV, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight);
+#ifdef PIXELCOPY_SSE2
+void SplitUV_SSE2(BYTE *pDstU, int nDstPitchU, BYTE *pDstV, int nDstPitchV, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight);
+#endif
+
+/// @brief ȡYV12YUVƽĵַп
+/// @param pDst			YV12ݵʼַ
+/// @param nDstPitch	YV12Yƽп,UVƽпΪһ
+/// @param nSurfaceHeight YV12ĸ߶,VƽλnDstPitch*nSurfaceHeight,UƽVƽ֮
+/// @param pPlane		YUVƽĵַ,YUV420P˳
+/// @param nPlanePitch	ƽп
+/// @remark ĸ߶ȿͼ߶,UVλñ밴߶ȼ
+inline void GetYV12Planes(BYTE *pDst, int nDstPitch, int nSurfaceHeight, BYTE *pPlane[3], int nPlanePitch[3])
+{
+	pPlane[0] = pDst;
+	pPlane[2] = pDst + nDstPitch*nSurfaceHeight;
+	pPlane[1] = pPlane[2] + (nDstPitch / 2)*(nSurfaceHeight / 2);
+	nPlanePitch[0] = nDstPitch;
+	nPlanePitch[1] = nDstPitch / 2;
+	nPlanePitch[2] = nDstPitch / 2;
+}
+
+/// @brief NV12ͼתΪYUV420Pͼ
+/// @param pDst			ĿͼYUVƽĵַ
+/// @param nDstPitch	Ŀͼƽп
+/// @param pSrcY		NV12ͼYƽ
+/// @param pSrcUV		NV12ͼUVƽ
+/// @param nSrcPitch	NV12ͼп,YUVƽпͬ
+inline void CopyNV12ToYUV420P(BYTE *pDst[3], int nDstPitch[3], const BYTE *pSrcY, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight)
+{
+	CopyPlane(pDst[0], nDstPitch[0], pSrcY, nSrcPitch, nWidth, nHeight);
+	SplitUV(pDst[1], nDstPitch[1], pDst[2], nDstPitch[2], pSrcUV, nSrcPitch, (nWidth + 1) / 2, (nHeight + 1) / 2);
+}
+
+/// @brief YUV420PͼƵYV12
+/// @param pDst			YV12ݵʼַ
+/// @param nDstPitch	YV12Yƽп,UVƽпΪһ
+/// @param nSurfaceHeight YV12ĸ߶,VƽλnDstPitch*nSurfaceHeight,UƽVƽ֮
+/// @remark YUV420PUVԵ,ΪYV12ʽ
+inline void CopyYUV420PToYV12(BYTE *pDst, int nDstPitch, int nSurfaceHeight, BYTE *const pSrc[3], const int nSrcPitch[3], int nWidth, int nHeight)
+{
+	BYTE *pPlane[3];
+	int nPlanePitch[3];
+	GetYV12Planes(pDst, nDstPitch, nSurfaceHeight, pPlane, nPlanePitch);
+	for (int i = 0; i < 3; i++)
+		CopyPlane(pPlane[i], nPlanePitch[i], pSrc[i], nSrcPitch[i], i ? (nWidth + 1) / 2 : nWidth, i ? (nHeight + 1) / 2 : nHeight);
+}
+
+/// @brief NV12ͼƵNV12
+/// @param nDstHeight	NV12ĸ߶,UVƽλnDstPitch*nDstHeight
+/// @param nSrcHeight	ԴNV12ͼĸ߶(),UVƽλnSrcPitch*nSrcHeight
+inline void CopyNV12ToNV12(BYTE *pDst, int nDstPitch, int nDstHeight, const BYTE *pSrc, int nSrcPitch, int nSrcHeight, int nWidth, int nHeight)
+{
+	CopyPlane(pDst, nDstPitch, pSrc, nSrcPitch, nWidth, nHeight);
+	CopyPlane(pDst + nDstPitch*nDstHeight, nDstPitch, pSrc + nSrcPitch*nSrcHeight, nSrcPitch, (nWidth + 1) & ~1, (nHeight + 1) / 2);
+}
+
+/// @brief NV12ͼƵYV12,CopyNV12ToNV12ͬ
+inline void CopyNV12ToYV12(BYTE *pDst, int nDstPitch, int nDstHeight, const BYTE *pSrc, int nSrcPitch, int nSrcHeight, int nWidth, int nHeight)
+{
+	BYTE *pPlane[3];
+	int nPlanePitch[3];
+	GetYV12Planes(pDst, nDstPitch, nDstHeight, pPlane, nPlanePitch);
+	CopyNV12ToYUV420P(pPlane, nPlanePitch, pSrc, pSrc + nSrcPitch*nSrcHeight, nSrcPitch, nWidth, nHeight);
+}
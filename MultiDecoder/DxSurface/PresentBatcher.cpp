@@ -0,0 +1,565 @@
+#include "PresentBatcher.h"
+#include "PixelCopy.h"
+#include "HighBitdepth.h"
+#include "MonoClock.h"
+#include "TimelineTrace.h"
+
+#ifndef SafeRelease
+#define SafeRelease(p)      { if(p) { (p)->Release(); (p)=NULL; } }
+#endif
+
+#ifdef _WIN32
+CD3D9BatchDevice::CD3D9BatchDevice()
+{
+	m_pDirect3D9 = NULL;
+	m_pDevice = NULL;
+	m_pBackBuffer = NULL;
+	ZeroMemory(&m_d3dpp, sizeof(D3DPRESENT_PARAMETERS));
+}
+
+CD3D9BatchDevice::~CD3D9BatchDevice()
+{
+	Release();
+}
+
+bool CD3D9BatchDevice::Create(HWND hPresentWnd, const RECT &rtRegion, HMONITOR hMonitor)
+{
+	m_pDirect3D9 = Direct3DCreate9(D3D_SDK_VERSION);
+	if (!m_pDirect3D9)
+	{
+		DxTraceMsg("%s Direct3DCreate9 failed.\n", __FUNCTION__);
+		return false;
+	}
+	UINT nAdapter = D3DADAPTER_DEFAULT;
+	for (UINT i = 0; i < m_pDirect3D9->GetAdapterCount(); i++)
+	{
+		if (m_pDirect3D9->GetAdapterMonitor(i) == hMonitor)
+		{
+			nAdapter = i;
+			break;
+		}
+	}
+	m_d3dpp.Windowed				= TRUE;
+	m_d3dpp.hDeviceWindow			= hPresentWnd;
+	m_d3dpp.BackBufferWidth			= rtRegion.right - rtRegion.left;
+	m_d3dpp.BackBufferHeight		= rtRegion.bottom - rtRegion.top;
+	m_d3dpp.BackBufferFormat		= D3DFMT_UNKNOWN;
+	m_d3dpp.BackBufferCount			= 1;
+	m_d3dpp.SwapEffect				= D3DSWAPEFFECT_COPY;		// ̨,ֻػиµĴ
+	m_d3dpp.PresentationInterval	= D3DPRESENT_INTERVAL_ONE;	// ÿֱͬPresentһ
+	// ͨȾ߳ͬʱϴͼ,ָD3DCREATE_MULTITHREADED
+	HRESULT hr = m_pDirect3D9->CreateDevice(nAdapter,
+											D3DDEVTYPE_HAL,
+											hPresentWnd,
+											D3DCREATE_SOFTWARE_VERTEXPROCESSING | D3DCREATE_MULTITHREADED | D3DCREATE_FPU_PRESERVE,
+											&m_d3dpp,
+											&m_pDevice);
+	if (FAILED(hr))
+	{
+		DxTraceMsg("%s CreateDevice failed,hr = %08X.\n", __FUNCTION__, hr);
+		SafeRelease(m_pDirect3D9);
+		return false;
+	}
+	m_pDevice->Clear(0, NULL, D3DCLEAR_TARGET, D3DCOLOR_XRGB(0, 0, 0), 1.0f, 0);
+	return true;
+}
+
+void CD3D9BatchDevice::Release()
+{
+	SafeRelease(m_pBackBuffer);
+	SafeRelease(m_pDevice);
+	SafeRelease(m_pDirect3D9);
+}
+
+BatchDeviceState CD3D9BatchDevice::TestDevice()
+{
+	HRESULT hr = m_pDevice->TestCooperativeLevel();
+	if (hr == D3DERR_DEVICELOST)
+		return BatchDevice_Lost;
+	if (hr == D3DERR_DEVICENOTRESET)
+		return BatchDevice_NotReset;
+	return BatchDevice_Ok;
+}
+
+bool CD3D9BatchDevice::Reset()
+{
+	HRESULT hr = m_pDevice->Reset(&m_d3dpp);
+	if (FAILED(hr))
+	{
+		DxTraceMsg("%s Reset failed,hr = %08X.\n", __FUNCTION__, hr);
+		return false;
+	}
+	m_pDevice->Clear(0, NULL, D3DCLEAR_TARGET, D3DCOLOR_XRGB(0, 0, 0), 1.0f, 0);
+	return true;
+}
+
+void *CD3D9BatchDevice::CreateSurface(int nWidth, int nHeight, LONGLONG &nBytes)
+{
+	IDirect3DSurface9 *pSurface = NULL;
+	HRESULT hr = m_pDevice->CreateOffscreenPlainSurface((nWidth + 1) & ~1, (nHeight + 1) & ~1, (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'), D3DPOOL_DEFAULT, &pSurface, NULL);
+	if (FAILED(hr))
+	{
+		DxTraceMsg("%s CreateOffscreenPlainSurface failed,hr = %08X.\n", __FUNCTION__, hr);
+		return NULL;
+	}
+	nBytes = CMemoryAccount::GetSurfaceBytes(pSurface);
+	return pSurface;
+}
+
+void CD3D9BatchDevice::ReleaseSurface(void *pSurface)
+{
+	((IDirect3DSurface9 *)pSurface)->Release();
+}
+
+bool CD3D9BatchDevice::Upload(void *pSurface, AVFrame *pAvFrame)
+{
+	IDirect3DSurface9 *pDstSurface = (IDirect3DSurface9 *)pSurface;
+	int nWidth = pAvFrame->width;
+	int nHeight = pAvFrame->height;
+	D3DSURFACE_DESC DstDesc;
+	D3DLOCKED_RECT DstRect;
+	pDstSurface->GetDesc(&DstDesc);
+	if (FAILED(pDstSurface->LockRect(&DstRect, NULL, 0)))
+		return false;
+	// YV12VƽYƽ֮,UƽֽVƽ֮
+	BYTE *pDstY = (BYTE *)DstRect.pBits;
+	BYTE *pDst[3];
+	int nDstPitch[3];
+	GetYV12Planes(pDstY, DstRect.Pitch, DstDesc.Height, pDst, nDstPitch);
+	bool bSucceed = true;
+	if (pAvFrame->format == AV_PIX_FMT_DXVA2_VLD)
+	{
+		IDirect3DSurface9 *pSrcSurface = (IDirect3DSurface9 *)pAvFrame->data[3];
+		D3DSURFACE_DESC SrcDesc;
+		D3DLOCKED_RECT SrcRect;
+		if (pSrcSurface && SUCCEEDED(pSrcSurface->GetDesc(&SrcDesc)) && SUCCEEDED(pSrcSurface->LockRect(&SrcRect, NULL, D3DLOCK_READONLY)))
+		{
+			const BYTE *pSrc = (const BYTE *)SrcRect.pBits;
+			if (SrcDesc.Format == (D3DFORMAT)MAKEFOURCC('P', '0', '1', '0'))
+				CopyP010ToYUV420P(pDst, nDstPitch, pSrc, SrcRect.Pitch, SrcDesc.Height, nWidth, nHeight);
+			else
+				CopyNV12ToYUV420P(pDst, nDstPitch, pSrc, pSrc + SrcRect.Pitch * SrcDesc.Height, SrcRect.Pitch, nWidth, nHeight);
+			pSrcSurface->UnlockRect();
+		}
+		else
+			bSucceed = false;
+	}
+	else
+		CopyYUV420PToYV12(pDstY, DstRect.Pitch, DstDesc.Height, pAvFrame->data, pAvFrame->linesize, nWidth, nHeight);
+	pDstSurface->UnlockRect();
+	return bSucceed;
+}
+
+bool CD3D9BatchDevice::BeginCompose()
+{
+	return SUCCEEDED(m_pDevice->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &m_pBackBuffer));
+}
+
+void CD3D9BatchDevice::StretchTile(void *pSurface, int nWidth, int nHeight, const RECT &rtTile)
+{
+	RECT rtSrc = { 0, 0, nWidth, nHeight };
+	m_pDevice->StretchRect((IDirect3DSurface9 *)pSurface, &rtSrc, m_pBackBuffer, &rtTile, D3DTEXF_LINEAR);
+}
+
+void CD3D9BatchDevice::EndCompose()
+{
+	SafeRelease(m_pBackBuffer);
+}
+
+void CD3D9BatchDevice::Present(const RECT &rtRegion)
+{
+	m_pDevice->Present(NULL, &rtRegion, NULL, NULL);
+}
+#endif
+
+CPresentBatcher::CPresentBatcher()
+{
+	m_hPresentWnd = NULL;
+	ZeroMemory(&m_rtRegion, sizeof(RECT));
+	m_hMonitor = NULL;
+	m_pDevice = NULL;
+	m_bOwnDevice = false;
+	m_bDeviceCreated = false;
+	ZeroMemory(&m_Stat, sizeof(PresentBatchStat));
+	m_hEventDirty = NULL;
+	m_hEventExit = NULL;
+	m_hEventReady = NULL;
+	m_hThread = NULL;
+	m_nInterval = 20;
+	InitializeCriticalSection(&m_csDevice);
+}
+
+CPresentBatcher::~CPresentBatcher()
+{
+	Stop();
+	m_vecTile.clear();
+	if (m_bOwnDevice)
+		delete m_pDevice;
+	if (m_hEventDirty)
+		CloseHandle(m_hEventDirty);
+	if (m_hEventExit)
+		CloseHandle(m_hEventExit);
+	DeleteCriticalSection(&m_csDevice);
+}
+
+bool CPresentBatcher::Create(HWND hPresentWnd, const RECT &rtRegion, HMONITOR hMonitor, IBatchPresentDevice *pDevice)
+{
+	if (rtRegion.right <= rtRegion.left || rtRegion.bottom <= rtRegion.top || m_hThread)
+		return false;
+	m_hPresentWnd = hPresentWnd;
+	m_rtRegion = rtRegion;
+	m_hMonitor = hMonitor;
+	if (m_bOwnDevice)
+		delete m_pDevice;
+	m_pDevice = pDevice;
+	m_bOwnDevice = false;
+#ifdef _WIN32
+	if (!m_pDevice && hPresentWnd)
+	{
+		m_pDevice = new CD3D9BatchDevice();
+		m_bOwnDevice = true;
+	}
+#endif
+	if (!m_hEventDirty)
+		m_hEventDirty = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if (!m_hEventExit)
+		m_hEventExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+	return m_hEventDirty && m_hEventExit;
+}
+
+int CPresentBatcher::AddTile(HWND hPanelWnd, const RECT &rtTile)
+{
+	if (m_hThread)
+		return -1;
+	m_vecTile.push_back(make_shared<BatchTile>(hPanelWnd, rtTile));
+	return (int)m_vecTile.size() - 1;
+}
+
+int CPresentBatcher::FindTile(HWND hPanelWnd)
+{
+	for (size_t i = 0; i < m_vecTile.size(); i++)
+	{
+		if (m_vecTile[i]->hPanelWnd == hPanelWnd)
+			return (int)i;
+	}
+	return -1;
+}
+
+void CPresentBatcher::ReleaseTileSurfaces()
+{
+	for (size_t i = 0; i < m_vecTile.size(); i++)
+	{
+		CAutoLock lock(&m_vecTile[i]->csTile);
+		m_vecTile[i]->ReleaseSurface(m_pDevice);
+		av_frame_unref(m_vecTile[i]->pLastFrame);
+	}
+}
+
+// ڼд,֤ûͨùдµĴ
+// ˺̨,δµĴٱϴε,óɹдΪи,Compose»
+bool CPresentBatcher::ResetDevice()
+{
+	for (size_t i = 0; i < m_vecTile.size(); i++)
+	{
+		EnterCriticalSection(&m_vecTile[i]->csTile);
+		m_vecTile[i]->ReleaseSurface(m_pDevice);
+	}
+	bool bReset = m_pDevice->Reset();
+	if (bReset)
+	{
+		for (size_t i = 0; i < m_vecTile.size(); i++)
+			InterlockedExchange(&m_vecTile[i]->nDirty, 1);
+	}
+	for (size_t i = 0; i < m_vecTile.size(); i++)
+		LeaveCriticalSection(&m_vecTile[i]->csTile);
+	if (!bReset)
+	{
+		DxTraceMsg("%s Reset failed.\n", __FUNCTION__);
+		return false;
+	}
+	CAutoLock lock(&m_csDevice);
+	m_Stat.nResets++;
+	return true;
+}
+
+// ڳдʱ
+bool CPresentBatcher::UploadFrame(BatchTile *pTile, AVFrame *pAvFrame)
+{
+	int nWidth = pAvFrame->width;
+	int nHeight = pAvFrame->height;
+	if (pAvFrame->format != AV_PIX_FMT_YUV420P &&
+		pAvFrame->format != AV_PIX_FMT_YUVJ420P &&
+		pAvFrame->format != AV_PIX_FMT_DXVA2_VLD)
+		return false;
+	if (!m_bDeviceCreated)
+	{// ޴ģʽ²ͼ
+		pTile->nWidth = nWidth;
+		pTile->nHeight = nHeight;
+		return true;
+	}
+	if (!pTile->pSurface || pTile->nWidth != nWidth || pTile->nHeight != nHeight)
+	{
+		pTile->ReleaseSurface(m_pDevice);
+		LONGLONG nBytes = 0;
+		pTile->pSurface = m_pDevice->CreateSurface(nWidth, nHeight, nBytes);
+		if (!pTile->pSurface)
+			return false;
+		pTile->AccountSurface(nBytes);
+		pTile->nWidth = nWidth;
+		pTile->nHeight = nHeight;
+	}
+	return m_pDevice->Upload(pTile->pSurface, pAvFrame);
+}
+
+bool CPresentBatcher::UpdateTile(int nTile, AVFrame *pAvFrame)
+{
+	if (nTile < 0 || nTile >= (int)m_vecTile.size() || !pAvFrame)
+		return false;
+	BatchTile *pTile = m_vecTile[nTile].get();
+	{
+		CAutoLock lock(&pTile->csTile);
+		if (!UploadFrame(pTile, pAvFrame))
+			return false;
+		av_frame_unref(pTile->pLastFrame);
+		if (m_bDeviceCreated && pAvFrame->format != AV_PIX_FMT_DXVA2_VLD)
+			av_frame_ref(pTile->pLastFrame, pAvFrame);
+	}
+	InterlockedIncrement(&m_Stat.nTileUpdates);
+	if (InterlockedExchange(&pTile->nDirty, 1))
+		InterlockedIncrement(&m_Stat.nTilesDropped);
+	SetEvent(m_hEventDirty);
+	return true;
+}
+
+// иµĴ쵽̨,رκϳɵĴ
+// 豸öͷʱ,ɴ֡ϴ,nRestoredػָĴ
+int CPresentBatcher::Compose(int &nRestored)
+{
+	nRestored = 0;
+	bool bCompose = m_bDeviceCreated && m_pDevice->BeginCompose();
+	if (m_bDeviceCreated && !bCompose)
+		return 0;
+	int nComposed = 0;
+	for (size_t i = 0; i < m_vecTile.size(); i++)
+	{
+		BatchTile *pTile = m_vecTile[i].get();
+		if (!InterlockedExchange(&pTile->nDirty, 0))
+			continue;
+		nComposed++;
+		if (!bCompose)
+			continue;
+		CAutoLock lock(&pTile->csTile);
+		if (!pTile->pSurface && pTile->pLastFrame->buf[0])
+		{
+			if (UploadFrame(pTile, pTile->pLastFrame))
+				nRestored++;
+			else
+				av_frame_unref(pTile->pLastFrame);
+		}
+		if (!pTile->pSurface)
+			continue;
+		m_pDevice->StretchTile(pTile->pSurface, pTile->nWidth, pTile->nHeight, pTile->rect);
+	}
+	if (bCompose)
+		m_pDevice->EndCompose();
+	return nComposed;
+}
+
+bool CPresentBatcher::Start(int nInterval)
+{
+	if (m_hThread || !m_hEventExit || nInterval <= 0)
+		return false;
+	m_nInterval = nInterval;
+	ResetEvent(m_hEventExit);
+	m_hEventReady = CreateEvent(NULL, TRUE, FALSE, NULL);
+	m_hThread = (HANDLE)_beginthreadex(nullptr, 0, PresentThread, this, 0, nullptr);
+	if (!m_hThread)
+	{
+		CloseHandle(m_hEventReady);
+		m_hEventReady = NULL;
+		return false;
+	}
+	// ȴʾ̴߳豸,ʧʱ߳˳
+	HANDLE hWaits[2] = { m_hEventReady, m_hThread };
+	bool bReady = (WaitForMultipleObjects(2, hWaits, FALSE, INFINITE) == WAIT_OBJECT_0);
+	CloseHandle(m_hEventReady);
+	m_hEventReady = NULL;
+	if (!bReady)
+	{
+		CloseHandle(m_hThread);
+		m_hThread = NULL;
+	}
+	return bReady;
+}
+
+void CPresentBatcher::Stop()
+{
+	if (!m_hThread)
+		return;
+	SetEvent(m_hEventExit);
+	WaitForSingleObject(m_hThread, INFINITE);
+	CloseHandle(m_hThread);
+	m_hThread = NULL;
+}
+
+UINT __stdcall CPresentBatcher::PresentThread(void *p)
+{
+	CPresentBatcher *pThis = (CPresentBatcher *)p;
+	// 豸ʾ߳д,豸Ҳֻʾ߳н
+	if (pThis->m_pDevice)
+	{
+		if (!pThis->m_pDevice->Create(pThis->m_hPresentWnd, pThis->m_rtRegion, pThis->m_hMonitor))
+			return 0;
+		pThis->m_bDeviceCreated = true;
+	}
+	SetEvent(pThis->m_hEventReady);
+	HANDLE hEvents[2] = { pThis->m_hEventExit, pThis->m_hEventDirty };
+	TimelineSetThreadName("BatchPresent");
+	while (true)
+	{
+		// 豸ʱPresentȴֱͬ,д¼ɺϳ;޴ģʽ°ʾڶʱϳ
+		DWORD dwResult = pThis->m_bDeviceCreated ? WaitForMultipleObjects(2, hEvents, FALSE, pThis->m_nInterval)
+												 : WaitForSingleObject(pThis->m_hEventExit, pThis->m_nInterval);
+		if (dwResult == WAIT_OBJECT_0)
+			break;
+		if (pThis->m_bDeviceCreated)
+		{
+			BatchDeviceState nState = pThis->m_pDevice->TestDevice();
+			if (nState == BatchDevice_Lost)
+				continue;
+			if (nState == BatchDevice_NotReset && !pThis->ResetDevice())
+				continue;
+		}
+		int64_t nT1 = MonoTimeNs();
+		CTimelineScope ComposeScope("Compose", -1);
+		int nRestored = 0;
+		int nComposed = pThis->Compose(nRestored);
+		ComposeScope.End();
+		if (!nComposed)
+		{
+			CAutoLock lock(&pThis->m_csDevice);
+			pThis->m_Stat.nIdleTicks++;
+			continue;
+		}
+		if (pThis->m_bDeviceCreated)
+		{
+			TIMELINE_SCOPE("Present", -1, TIMELINE_NO_PTS);
+			pThis->m_pDevice->Present(pThis->m_rtRegion);
+		}
+		CAutoLock lock(&pThis->m_csDevice);
+		pThis->m_Stat.nPresents++;
+		pThis->m_Stat.nTilesPresented += nComposed;
+		pThis->m_Stat.nTilesRestored += nRestored;
+		pThis->m_Stat.dfComposeTime += MonoNsToSeconds(MonoTimeNs() - nT1);
+	}
+	if (pThis->m_bDeviceCreated)
+	{// ֹͣͨ,ͷеı
+		pThis->m_bDeviceCreated = false;
+		pThis->ReleaseTileSurfaces();
+		pThis->m_pDevice->Release();
+	}
+	return 0;
+}
+
+void CPresentBatcher::TraceStat()
+{
+	PresentBatchStat Stat;
+	GetStat(Stat);
+	DxTraceMsg("%s Tiles = %d\tPresents = %d\tUpdates = %d\tPresented = %d\tDropped = %d\tIdle = %d\tResets = %d\tRestored = %d\tAvgCompose = %.3fms.\n", __FUNCTION__,
+				(int)m_vecTile.size(), Stat.nPresents, Stat.nTileUpdates, Stat.nTilesPresented, Stat.nTilesDropped, Stat.nIdleTicks, Stat.nResets, Stat.nTilesRestored,
+				Stat.nPresents ? Stat.dfComposeTime * 1000 / Stat.nPresents : 0.0f);
+}
+
+CPresentBatchGroup::CPresentBatchGroup()
+{
+	m_hPresentWnd = NULL;
+}
+
+CPresentBatchGroup::~CPresentBatchGroup()
+{
+	Stop();
+}
+
+void CPresentBatchGroup::AddPanel(HWND hPanelWnd, const RECT &rtPanel)
+{
+	PanelInfo Panel;
+	Panel.hPanelWnd = hPanelWnd;
+	Panel.rect = rtPanel;
+	Panel.hMonitor = NULL;
+#ifdef _WIN32
+	if (m_hPresentWnd)
+	{
+		RECT rtScreen = rtPanel;
+		MapWindowPoints(m_hPresentWnd, NULL, (LPPOINT)&rtScreen, 2);
+		Panel.hMonitor = MonitorFromRect(&rtScreen, MONITOR_DEFAULTTONEAREST);
+	}
+#endif
+	m_vecPanel.push_back(Panel);
+}
+
+bool CPresentBatchGroup::Start(int nInterval)
+{
+	Stop();
+	// ʾΪʾӾ
+	map<HMONITOR, RECT> mapRegion;
+	for (size_t i = 0; i < m_vecPanel.size(); i++)
+	{
+		auto itFind = mapRegion.find(m_vecPanel[i].hMonitor);
+		if (itFind == mapRegion.end())
+			mapRegion.insert(pair<HMONITOR, RECT>(m_vecPanel[i].hMonitor, m_vecPanel[i].rect));
+		else
+			UnionRect(&itFind->second, &itFind->second, &m_vecPanel[i].rect);
+	}
+	for (auto it = mapRegion.begin(); it != mapRegion.end(); it++)
+	{
+		PresentBatcherPtr pBatcher = make_shared<CPresentBatcher>();
+		if (!pBatcher->Create(m_hPresentWnd, it->second, it->first))
+		{
+			Stop();
+			return false;
+		}
+		m_mapBatcher.insert(pair<HMONITOR, PresentBatcherPtr>(it->first, pBatcher));
+	}
+	for (size_t i = 0; i < m_vecPanel.size(); i++)
+	{
+		PanelInfo &Panel = m_vecPanel[i];
+		CPresentBatcher *pBatcher = m_mapBatcher[Panel.hMonitor].get();
+		const RECT &rtRegion = mapRegion[Panel.hMonitor];
+		RECT rtTile = Panel.rect;
+		OffsetRect(&rtTile, -rtRegion.left, -rtRegion.top);
+		pBatcher->AddTile(Panel.hPanelWnd, rtTile);
+		m_mapPanelBatcher[Panel.hPanelWnd] = pBatcher;
+	}
+	for (auto it = m_mapBatcher.begin(); it != m_mapBatcher.end(); it++)
+	{
+		if (!it->second->Start(nInterval))
+		{
+			DxTraceMsg("%s Failed to start the present batcher.\n", __FUNCTION__);
+			Stop();
+			return false;
+		}
+	}
+	return true;
+}
+
+void CPresentBatchGroup::Stop()
+{
+	for (auto it = m_mapBatcher.begin(); it != m_mapBatcher.end(); it++)
+		it->second->Stop();
+	m_mapPanelBatcher.clear();
+	m_mapBatcher.clear();
+}
+
+CPresentBatcher *CPresentBatchGroup::GetBatcher(HWND hPanelWnd)
+{
+	auto itFind = m_mapPanelBatcher.find(hPanelWnd);
+	if (itFind == m_mapPanelBatcher.end())
+		return NULL;
+	return itFind->second;
+}
+
+void CPresentBatchGroup::TraceStat()
+{
+	for (auto it = m_mapBatcher.begin(); it != m_mapBatcher.end(); it++)
+		it->second->TraceStat();
+}
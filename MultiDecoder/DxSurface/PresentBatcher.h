@@ -0,0 +1,317 @@
+#pragma once
+#include "Win32Port.h"
+#include <vector>
+#include <map>
+#include <memory>
+#include "RenderSurface.h"
+#include "AutoLock.h"
+#include "DxTrace.h"
+#include "MemoryAccount.h"
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define __STDC_CONSTANT_MACROS
+#define FF_API_PIX_FMT 0
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+
+using namespace std;
+
+enum BatchDeviceState
+{
+	BatchDevice_Ok = 0,
+	BatchDevice_Lost,			// 豸ʧ,ʱ
+	BatchDevice_NotReset,		// 豸
+};
+
+/// @brief ʾ豸
+/// @remark ʾǲ͸ָ,ʵֽ;CreateTestDeviceResetͺϳʾʾ߳е,
+/// CreateSurfaceReleaseSurfaceUploadڸͨȾ߳ͬʱ,ͬһĵɴл
+/// ʵʱCD3D9BatchDeviceʾϴD3D9豸,ʱԻڴеģʵ
+class IBatchPresentDevice
+{
+public:
+	virtual ~IBatchPresentDevice() {}
+	// 豸,̨ĳߴrtRegionͬ,Ϊɫ
+	virtual bool Create(HWND hPresentWnd, const RECT &rtRegion, HMONITOR hMonitor) = 0;
+	virtual void Release() = 0;
+	virtual BatchDeviceState TestDevice() = 0;
+	// 豸Ѻ̨Ϊɫ,ǰдͷ
+	virtual bool Reset() = 0;
+	// nWidth x nHeightͼYV12,nBytesرռõԴֽ
+	virtual void *CreateSurface(int nWidth, int nHeight, LONGLONG &nBytes) = 0;
+	virtual void ReleaseSurface(void *pSurface) = 0;
+	// һ֡ͼϴ,֧YUV420PYUVJ420PӲ֡
+	virtual bool Upload(void *pSurface, AVFrame *pAvFrame) = 0;
+	// ʼϳ,ȡų́
+	virtual bool BeginCompose() = 0;
+	// ѴnWidth x nHeightͼ쵽̨rtTile
+	virtual void StretchTile(void *pSurface, int nWidth, int nHeight, const RECT &rtTile) = 0;
+	virtual void EndCompose() = 0;
+	// Ѻ̨ʾʾڵrtRegion
+	virtual void Present(const RECT &rtRegion) = 0;
+};
+
+#ifdef _WIN32
+// ʾʾԿϴD3D9豸,ΪD3DPOOL_DEFAULTYV12
+class CD3D9BatchDevice : public IBatchPresentDevice
+{
+public:
+	CD3D9BatchDevice();
+	virtual ~CD3D9BatchDevice();
+	virtual bool Create(HWND hPresentWnd, const RECT &rtRegion, HMONITOR hMonitor);
+	virtual void Release();
+	virtual BatchDeviceState TestDevice();
+	virtual bool Reset();
+	virtual void *CreateSurface(int nWidth, int nHeight, LONGLONG &nBytes);
+	virtual void ReleaseSurface(void *pSurface);
+	virtual bool Upload(void *pSurface, AVFrame *pAvFrame);
+	virtual bool BeginCompose();
+	virtual void StretchTile(void *pSurface, int nWidth, int nHeight, const RECT &rtTile);
+	virtual void EndCompose();
+	virtual void Present(const RECT &rtRegion);
+private:
+	IDirect3D9				*m_pDirect3D9;
+	IDirect3DDevice9		*m_pDevice;
+	IDirect3DSurface9		*m_pBackBuffer;		// ϳڼеĺ̨
+	D3DPRESENT_PARAMETERS	m_d3dpp;
+};
+#endif
+
+// ʾĴ,Ӧһ崰,ͼϴ,ϳʱ쵽̨дڵ
+struct BatchTile
+{
+	BatchTile(HWND hWnd, const RECT &rtTile)
+	{
+		hPanelWnd = hWnd;
+		rect = rtTile;
+		pSurface = NULL;
+		nWidth = 0;
+		nHeight = 0;
+		nDirty = 0;
+		nSurfaceBytes = 0;
+		nMemoryChannel = MEMORY_SHARED_CHANNEL;
+		pLastFrame = av_frame_alloc();
+		InitializeCriticalSection(&csTile);
+	}
+	~BatchTile()
+	{
+		av_frame_free(&pLastFrame);
+		DeleteCriticalSection(&csTile);
+	}
+	// ¼´Ĵ,̴ͨ߳,߳ͨ
+	void AccountSurface(LONGLONG nBytes)
+	{
+		nSurfaceBytes = nBytes;
+		nMemoryChannel = g_MemoryAccount.Alloc(MemTag_Surface, MEMORY_CURRENT_CHANNEL, nSurfaceBytes);
+	}
+	void ReleaseSurface(IBatchPresentDevice *pDevice)
+	{
+		if (pSurface)
+		{
+			pDevice->ReleaseSurface(pSurface);
+			pSurface = NULL;
+		}
+		if (nSurfaceBytes)
+		{
+			g_MemoryAccount.Free(MemTag_Surface, nMemoryChannel, nSurfaceBytes);
+			nSurfaceBytes = 0;
+		}
+	}
+	HWND				hPanelWnd;
+	RECT				rect;			// ں̨еλ
+	void				*pSurface;		// ,YV12ʽ,ߴͼͬ,豸ʱΪNULL
+	int					nWidth;			// ͼĳߴ
+	int					nHeight;
+	volatile LONG		nDirty;			// µͼδʾ
+	LONGLONG			nSurfaceBytes;	// g_MemoryAccountֽ
+	int					nMemoryChannel;
+	AVFrame				*pLastFrame;	// ϴ֡,豸úݴ˻ָ;Ӳ֡,ռý
+	CRITICAL_SECTION	csTile;
+};
+typedef shared_ptr<BatchTile> BatchTilePtr;
+
+struct PresentBatchStat
+{
+	LONG		nPresents;			// PresentĴ
+	LONG		nTileUpdates;		// ϴͼ
+	LONG		nTilesPresented;	// PresentʾĴͼ
+	LONG		nTilesDropped;		// ʾ֮ǰͼ񸲸ǵĴͼ
+	LONG		nIdleTicks;			// ʾûκδ,PresentĴ
+	LONG		nResets;			// 豸óɹĴ
+	LONG		nTilesRestored;		// 豸úɱָ֡Ĵ
+	double		dfComposeTime;		// ϳɺPresentۼƺʱ,λ
+};
+
+/// @brief ʾϵʾ
+/// @remark ÿͨPresentʱ,64ÿʾھ64Presentϳ
+/// ʾһ豸Ϊͬһʾϵ崴һ,ֻͨͼϴԼĴ,
+/// ʾ߳ÿʾڰиµĴ쵽̨ĶӦֻPresentһ,дͬʱת
+/// ʹD3DSWAPEFFECT_COPY,δµĴϴε,ػ;豸ų̂д,
+/// úд񶼱Ϊи,һκϳʱɸ֡ϴ
+/// ʱָʾں豸޴ģʽ,ִֻдĸº͵߼;ָģ豸ûGPUĻ²Ժϳɺ
+class CPresentBatcher
+{
+public:
+	CPresentBatcher();
+	~CPresentBatcher();
+
+	/// @brief ʾ
+	/// @param hPresentWnd	ʾ,ĸ,ΪNULLʱ޴ģʽ
+	/// @param rtRegion		ʾ,Ϊʾڿͻ
+	/// @param hMonitor		ڵʾ,ѡԿ
+	/// @param pDevice		ʾõ豸,ʾڸ;ΪNULLʱ,WindowsָʾʹԼCD3D9BatchDevice,
+	///						޴ģʽ
+	bool Create(HWND hPresentWnd, const RECT &rtRegion, HMONITOR hMonitor, IBatchPresentDevice *pDevice = NULL);
+
+	// һ,rtTileΪʾڿͻеλ,ش,ʧʱ-1
+	int AddTile(HWND hPanelWnd, const RECT &rtTile);
+
+	// 崰ڶӦĴ,ûҵʱ-1
+	int FindTile(HWND hPanelWnd);
+
+	/// @brief һ֡ͼϴ,֧YUV420PYUVJ420PӲ֡
+	/// @remark ڶͨ߳ͬʱ,
+	bool UpdateTile(int nTile, AVFrame *pAvFrame);
+
+	// ʾ߳,nIntervalΪʾ,λ,豸ʱɴֱͬƽ
+	bool Start(int nInterval = 20);
+	void Stop();
+
+	void GetStat(PresentBatchStat &Stat)
+	{
+		CAutoLock lock(&m_csDevice);
+		memcpy(&Stat, &m_Stat, sizeof(PresentBatchStat));
+	}
+	void TraceStat();
+private:
+	bool UploadFrame(BatchTile *pTile, AVFrame *pAvFrame);
+	bool ResetDevice();
+	void ReleaseTileSurfaces();
+	int  Compose(int &nRestored);
+	static UINT __stdcall PresentThread(void *p);
+
+	HWND					m_hPresentWnd;
+	RECT					m_rtRegion;
+	HMONITOR				m_hMonitor;
+	IBatchPresentDevice		*m_pDevice;		// ޴ģʽΪNULL
+	bool					m_bOwnDevice;
+	bool					m_bDeviceCreated;	// ʾ߳Ѵ豸,ܴ
+	vector<BatchTilePtr>	m_vecTile;		// ֻStart֮ǰӴ,ڼ䲻޸
+	CRITICAL_SECTION		m_csDevice;		// 豸úͳ
+	PresentBatchStat		m_Stat;
+	HANDLE					m_hEventDirty;	// д
+	HANDLE					m_hEventExit;
+	HANDLE					m_hEventReady;	// ʾ߳Ѵ豸
+	HANDLE					m_hThread;
+	int						m_nInterval;
+};
+
+/// @brief ʾȾ
+/// @remark ͨȾ߳ʹ,RenderֻͼϴʾӦĴ,ʾͳһPresent
+class CBatchedSurface :public IRenderSurface
+{
+public:
+	explicit CBatchedSurface(CPresentBatcher *pBatcher)
+	{
+		m_pBatcher = pBatcher;
+		m_nTile = -1;
+		m_bInitialized = false;
+	}
+	virtual ~CBatchedSurface()
+	{
+	}
+	// 崰ͨCPresentBatcher::AddTileΪ
+	virtual bool InitD3D(HWND hWnd,
+		int nVideoWidth,
+		int nVideoHeight,
+		BOOL bIsWindowed = TRUE,
+		D3DFORMAT nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'))
+	{
+		m_nTile = m_pBatcher ? m_pBatcher->FindTile(hWnd) : -1;
+		m_bInitialized = (m_nTile >= 0);
+		return m_bInitialized;
+	}
+	// ʾʹԼ豸,
+	virtual bool InitD3DShared(HWND hWnd,
+		IDirect3DDevice9 *pDevice,
+		int nVideoWidth,
+		int nVideoHeight,
+		D3DFORMAT nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2'))
+	{
+		return false;
+	}
+	virtual void DetachSharedDevice()
+	{
+	}
+	virtual bool IsInited()
+	{
+		return m_bInitialized;
+	}
+	virtual bool Render(AVFrame *pAvFrame, HWND hWnd = NULL, RECT *pRenderRt = NULL)
+	{
+		if (!m_bInitialized || !pAvFrame)
+			return false;
+		return m_pBatcher->UpdateTile(m_nTile, pAvFrame);
+	}
+	// 豸ʾ
+	virtual bool HandelDevLost()
+	{
+		return m_bInitialized;
+	}
+	virtual void DxCleanup()
+	{
+		m_bInitialized = false;
+		m_nTile = -1;
+	}
+private:
+	CPresentBatcher		*m_pBatcher;
+	int					m_nTile;
+	bool				m_bInitialized;
+};
+
+/// @brief ʾʾ
+/// @remark 尴ڵʾ,ÿʾһCPresentBatcher,ΪʾӾ
+/// ޴ģʽͬһʾ
+class CPresentBatchGroup
+{
+public:
+	CPresentBatchGroup();
+	~CPresentBatchGroup();
+
+	// ʾ,hPresentWndΪNULLʱ޴ģʽ
+	void SetPresentWnd(HWND hPresentWnd)
+	{
+		m_hPresentWnd = hPresentWnd;
+	}
+	// ,rtPanelΪʾڿͻеλ,Start֮ǰ
+	void AddPanel(HWND hPanelWnd, const RECT &rtPanel);
+
+	// Ϊʾʾʾ߳
+	bool Start(int nInterval = 20);
+	void Stop();
+
+	// ȡʾ,ûҵʱNULL
+	CPresentBatcher *GetBatcher(HWND hPanelWnd);
+
+	void TraceStat();
+private:
+	struct PanelInfo
+	{
+		HWND		hPanelWnd;
+		RECT		rect;
+		HMONITOR	hMonitor;
+	};
+	typedef shared_ptr<CPresentBatcher> PresentBatcherPtr;
+	HWND								m_hPresentWnd;
+	vector<PanelInfo>					m_vecPanel;
+	map<HMONITOR, PresentBatcherPtr>	m_mapBatcher;
+	map<HWND, CPresentBatcher *>		m_mapPanelBatcher;
+};
@@ -0,0 +1,435 @@
+#include "ReadbackRing.h"
+#include "MonoClock.h"
+#include <algorithm>
+#ifdef _WIN32
+#include <d3d9.h>
+#include "MemoryAccount.h"
+#endif
+
+#ifndef SafeRelease
+#define SafeRelease(p)      { if(p) { (p)->Release(); (p)=NULL; } }
+#endif
+
+// лضõķҹ,ض̵߳ùҹʱж,SetAnalyticsHookд
+struct ReadbackAnalyticsHook
+{
+	CRWLock				RWLock;
+	ReadbackCallback	pHook;
+	void				*pUserPtr;
+	volatile LONG		nInterval;
+};
+static ReadbackAnalyticsHook s_AnalyticsHook;
+
+CReadbackRing::CReadbackRing()
+{
+	ZeroMemory(&m_Stat, sizeof(ReadbackStat));
+	m_pStaging = NULL;
+	m_bOwnStaging = false;
+	m_nLatency = 0;
+	m_dwMaxDelay = INFINITE;
+	m_nWrite = 0;
+	m_nQueued = 0;
+	m_nRead = 0;
+	m_nAnalyticsCount = 0;
+	m_hSemReady = NULL;
+	m_hEventFree = NULL;
+	m_hEventExit = NULL;
+	m_hThread = NULL;
+	m_pCallback = NULL;
+	m_pUserPtr = NULL;
+	InitializeCriticalSection(&m_csSubmit);
+	InitializeCriticalSection(&m_csStat);
+}
+
+CReadbackRing::~CReadbackRing()
+{
+	Destroy();
+	DeleteCriticalSection(&m_csSubmit);
+	DeleteCriticalSection(&m_csStat);
+}
+
+bool CReadbackRing::Create(IReadbackStaging *pStaging, int nSlots, int nLatency, DWORD dwMaxDelay, ReadbackCallback pCallback, void *pUserPtr)
+{
+	Destroy();
+	if (nLatency < 1 || nSlots < nLatency + 2)
+	{
+		DxTraceMsg("%s Invalid parameters:nSlots = %d,nLatency = %d.\n", __FUNCTION__, nSlots, nLatency);
+		return false;
+	}
+	if (dwMaxDelay == 0)
+		dwMaxDelay = 1;
+	m_pStaging = pStaging;
+	m_bOwnStaging = false;
+#ifdef _WIN32
+	if (!m_pStaging)
+	{
+		m_pStaging = new CD3D9ReadbackStaging();
+		m_bOwnStaging = true;
+	}
+#endif
+	if (!m_pStaging)
+		return false;
+	ReadbackSlot Slot;
+	ZeroMemory(&Slot, sizeof(ReadbackSlot));
+	m_vecSlot.assign(nSlots, Slot);
+	m_nLatency = nLatency;
+	m_dwMaxDelay = dwMaxDelay;
+	m_nWrite = 0;
+	m_nQueued = 0;
+	m_nRead = 0;
+	m_nAnalyticsCount = 0;
+	m_pCallback = pCallback;
+	m_pUserPtr = pUserPtr;
+	m_hSemReady = CreateSemaphore(NULL, 0, nSlots, NULL);
+	m_hEventFree = CreateEvent(NULL, FALSE, FALSE, NULL);
+	m_hEventExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!m_hSemReady || !m_hEventFree || !m_hEventExit)
+	{
+		Destroy();
+		return false;
+	}
+	m_hThread = (HANDLE)_beginthreadex(nullptr, 0, ReadbackThread, this, 0, nullptr);
+	if (!m_hThread)
+	{
+		Destroy();
+		return false;
+	}
+	return true;
+}
+
+void CReadbackRing::Destroy()
+{
+	if (m_hThread)
+	{
+		Flush();
+		SetEvent(m_hEventExit);
+		WaitForSingleObject(m_hThread, INFINITE);
+		CloseHandle(m_hThread);
+		m_hThread = NULL;
+	}
+	if (m_pStaging)
+	{
+		m_pStaging->Release();
+		if (m_bOwnStaging)
+			delete m_pStaging;
+		m_pStaging = NULL;
+		m_bOwnStaging = false;
+	}
+	m_vecSlot.clear();
+	if (m_hSemReady)
+	{
+		CloseHandle(m_hSemReady);
+		m_hSemReady = NULL;
+	}
+	if (m_hEventFree)
+	{
+		CloseHandle(m_hEventFree);
+		m_hEventFree = NULL;
+	}
+	if (m_hEventExit)
+	{
+		CloseHandle(m_hEventExit);
+		m_hEventExit = NULL;
+	}
+}
+
+// ύݴ潻ض߳,ڳm_csSubmitʱ
+void CReadbackRing::ReleaseOldest()
+{
+	int nSlots = (int)m_vecSlot.size();
+	int nOldest = (m_nWrite - m_nQueued + nSlots) % nSlots;
+	InterlockedExchange(&m_vecSlot[nOldest].nState, Slot_Ready);
+	m_nQueued--;
+	ReleaseSemaphore(m_hSemReady, 1, NULL);
+}
+
+// ڻض߳аύѳm_dwMaxDelayݴ潻Լ
+// ύ߳Flushгm_csSubmitȴض,ﲻm_csSubmit
+void CReadbackRing::ReleaseExpired()
+{
+	if (!TryEnterCriticalSection(&m_csSubmit))
+		return;
+	int nSlots = (int)m_vecSlot.size();
+	int64_t nExpireTime = MonoTimeNs() - (int64_t)m_dwMaxDelay * MONO_NS_PER_MS;
+	while (m_nQueued > 0 && m_vecSlot[(m_nWrite - m_nQueued + nSlots) % nSlots].nSubmitTime <= nExpireTime)
+	{
+		ReleaseOldest();
+		InterlockedIncrement(&m_Stat.nExpired);
+	}
+	LeaveCriticalSection(&m_csSubmit);
+}
+
+bool CReadbackRing::Submit(void *pSurface, int nWidth, int nHeight, int64_t nPts, void *pTag)
+{
+	if (!m_hThread || !pSurface)
+		return false;
+	CAutoLock lock(&m_csSubmit);
+	if (!m_pStaging->IsCompatible(pSurface))
+	{// Դ仯,ضύ֡ؽݴ
+		Flush();
+		m_pStaging->Release();
+		if (!m_pStaging->Create(pSurface, (int)m_vecSlot.size()))
+			return false;
+	}
+	InterlockedIncrement(&m_Stat.nSubmitted);
+	ReadbackSlot &Slot = m_vecSlot[m_nWrite];
+	if (Slot.nState != Slot_Free)
+	{// ض̸߳ύٶ
+		InterlockedIncrement(&m_Stat.nDropped);
+		return false;
+	}
+	// ͬһ豸ϵύ˳ִ,֮ǰý治ᱻĽ븲
+	if (!m_pStaging->Copy(pSurface, m_nWrite))
+	{
+		InterlockedIncrement(&m_Stat.nDropped);
+		return false;
+	}
+	Slot.nWidth = nWidth;
+	Slot.nHeight = nHeight;
+	Slot.nPts = nPts;
+	Slot.pTag = pTag;
+	Slot.bAnalytics = false;
+	LONG nInterval = s_AnalyticsHook.nInterval;
+	if (nInterval > 0 && ++m_nAnalyticsCount >= nInterval)
+	{
+		Slot.bAnalytics = true;
+		m_nAnalyticsCount = 0;
+	}
+	Slot.nSubmitTime = MonoTimeNs();
+	InterlockedExchange(&Slot.nState, Slot_Queued);
+	m_nWrite = (m_nWrite + 1) % (int)m_vecSlot.size();
+	m_nQueued++;
+	// nLatency֡ύ,һ֡GPU,Իض
+	while (m_nQueued > m_nLatency)
+		ReleaseOldest();
+	return true;
+}
+
+void CReadbackRing::Flush()
+{
+	if (!m_hThread)
+		return;
+	CAutoLock lock(&m_csSubmit);
+	while (m_nQueued > 0)
+		ReleaseOldest();
+	for (size_t i = 0; i < m_vecSlot.size(); i++)
+	{
+		while (m_vecSlot[i].nState != Slot_Free)
+			WaitForSingleObject(m_hEventFree, 20);
+	}
+}
+
+bool CReadbackRing::IsAnalyticsDue()
+{
+	LONG nInterval = s_AnalyticsHook.nInterval;
+	CAutoLock lock(&m_csSubmit);
+	return nInterval > 0 && m_nAnalyticsCount + 1 >= nInterval;
+}
+
+void CReadbackRing::SetAnalyticsHook(ReadbackCallback pHook, void *pUserPtr, int nInterval)
+{
+	WRITE_LOCK(s_AnalyticsHook.RWLock);
+	s_AnalyticsHook.pHook = pHook;
+	s_AnalyticsHook.pUserPtr = pUserPtr;
+	InterlockedExchange(&s_AnalyticsHook.nInterval, pHook ? max<LONG>(nInterval, 1) : 0);
+}
+
+bool CReadbackRing::HasAnalyticsHook()
+{
+	return s_AnalyticsHook.nInterval > 0;
+}
+
+void CReadbackRing::ReadSlot(int nSlot)
+{
+	ReadbackSlot &Slot = m_vecSlot[nSlot];
+	ReadbackImage Image;
+	ZeroMemory(&Image, sizeof(ReadbackImage));
+	int64_t nT1 = MonoTimeNs();
+	bool bLocked = m_pStaging->Lock(nSlot, Image);
+	int64_t nT2 = MonoTimeNs();
+	if (!bLocked)
+	{// Ȼص,߾ݴͷ֡صԴ,ͼ
+		Image.pBits = NULL;
+		InterlockedIncrement(&m_Stat.nFailed);
+	}
+	Image.nWidth = Slot.nWidth;
+	Image.nHeight = Slot.nHeight;
+	Image.nPts = Slot.nPts;
+	Image.pTag = Slot.pTag;
+	if (m_pCallback)
+		m_pCallback(Image, m_pUserPtr);
+	if (Slot.bAnalytics && bLocked)
+	{
+		READ_LOCK(s_AnalyticsHook.RWLock);
+		if (s_AnalyticsHook.pHook)
+			s_AnalyticsHook.pHook(Image, s_AnalyticsHook.pUserPtr);
+	}
+	if (bLocked)
+		m_pStaging->Unlock(nSlot);
+	int64_t nT3 = MonoTimeNs();
+	CAutoLock lock(&m_csStat);
+	m_Stat.dfLockTime += MonoNsToSeconds(nT2 - nT1);
+	m_Stat.dfCopyTime += MonoNsToSeconds(nT3 - nT2);
+	if (bLocked)
+		m_Stat.nDelivered++;
+}
+
+UINT __stdcall CReadbackRing::ReadbackThread(void *p)
+{
+	CReadbackRing *pThis = (CReadbackRing *)p;
+	HANDLE hEvents[2] = { pThis->m_hEventExit, pThis->m_hSemReady };
+	// ֻ֡ӳʱһֱȴ,ÿm_dwMaxDelayһǷгʱδض֡
+	DWORD dwTimeout = pThis->m_dwMaxDelay;
+	for (;;)
+	{
+		DWORD dwResult = WaitForMultipleObjects(2, hEvents, FALSE, dwTimeout);
+		if (dwResult == WAIT_TIMEOUT)
+		{
+			pThis->ReleaseExpired();
+			continue;
+		}
+		if (dwResult != WAIT_OBJECT_0 + 1)
+			break;
+		int nSlot = pThis->m_nRead;
+		pThis->m_nRead = (pThis->m_nRead + 1) % (int)pThis->m_vecSlot.size();
+		pThis->ReadSlot(nSlot);
+		InterlockedExchange(&pThis->m_vecSlot[nSlot].nState, Slot_Free);
+		SetEvent(pThis->m_hEventFree);
+	}
+	int64_t nCpuTime = MonoThreadCpuNs();
+	CAutoLock lock(&pThis->m_csStat);
+	pThis->m_Stat.dfThreadCpuTime = MonoNsToSeconds(nCpuTime);
+	return 0;
+}
+
+void CReadbackRing::TraceStat()
+{
+	ReadbackStat Stat;
+	GetStat(Stat);
+	DxTraceMsg("%s Submitted = %d\tDelivered = %d\tDropped = %d\tFailed = %d\tExpired = %d\tAvgLock = %.3fms\tAvgCopy = %.3fms.\n", __FUNCTION__,
+				Stat.nSubmitted, Stat.nDelivered, Stat.nDropped, Stat.nFailed, Stat.nExpired,
+				Stat.nDelivered ? Stat.dfLockTime * 1000 / Stat.nDelivered : 0.0f,
+				Stat.nDelivered ? Stat.dfCopyTime * 1000 / Stat.nDelivered : 0.0f);
+}
+
+#ifdef _WIN32
+CD3D9ReadbackStaging::CD3D9ReadbackStaging()
+{
+	m_pDevice = NULL;
+	m_nWidth = 0;
+	m_nHeight = 0;
+	m_dwFormat = 0;
+	m_nStagingBytes = 0;
+	m_nMemoryChannel = MEMORY_SHARED_CHANNEL;
+}
+
+CD3D9ReadbackStaging::~CD3D9ReadbackStaging()
+{
+	Release();
+}
+
+bool CD3D9ReadbackStaging::IsCompatible(void *pSurface)
+{
+	if (m_vecStaging.empty())
+		return false;
+	IDirect3DSurface9 *pD3DSurface = (IDirect3DSurface9 *)pSurface;
+	D3DSURFACE_DESC Desc;
+	if (FAILED(pD3DSurface->GetDesc(&Desc)))
+		return false;
+	IDirect3DDevice9 *pDevice = NULL;
+	if (FAILED(pD3DSurface->GetDevice(&pDevice)))
+		return false;
+	pDevice->Release();
+	return pDevice == m_pDevice && Desc.Width == m_nWidth && Desc.Height == m_nHeight && Desc.Format == (D3DFORMAT)m_dwFormat;
+}
+
+bool CD3D9ReadbackStaging::Create(void *pSurface, int nSlots)
+{
+	Release();
+	IDirect3DSurface9 *pD3DSurface = (IDirect3DSurface9 *)pSurface;
+	D3DSURFACE_DESC Desc;
+	if (FAILED(pD3DSurface->GetDesc(&Desc)))
+		return false;
+	IDirect3DDevice9 *pDevice = NULL;
+	if (FAILED(pD3DSurface->GetDevice(&pDevice)))
+		return false;
+	HRESULT hr = S_OK;
+	m_vecStaging.assign(nSlots, (IDirect3DSurface9 *)NULL);
+	for (int i = 0; i < nSlots; i++)
+	{
+		hr = pDevice->CreateOffscreenPlainSurface(Desc.Width, Desc.Height, Desc.Format, D3DPOOL_DEFAULT, &m_vecStaging[i], NULL);
+		if (FAILED(hr))
+		{
+			DxTraceMsg("%s CreateOffscreenPlainSurface failed,hr = %08X.\n", __FUNCTION__, hr);
+			break;
+		}
+	}
+	pDevice->Release();
+	if (FAILED(hr))
+	{
+		Release();
+		return false;
+	}
+	m_pDevice = pDevice;
+	m_nWidth = Desc.Width;
+	m_nHeight = Desc.Height;
+	m_dwFormat = Desc.Format;
+	// ݴύ̴߳,߳ͨ
+	m_nStagingBytes = CMemoryAccount::GetSurfaceBytes(Desc.Width, Desc.Height, Desc.Format) * nSlots;
+	m_nMemoryChannel = g_MemoryAccount.Alloc(MemTag_Surface, MEMORY_CURRENT_CHANNEL, m_nStagingBytes);
+	return true;
+}
+
+void CD3D9ReadbackStaging::Release()
+{
+	for (size_t i = 0; i < m_vecStaging.size(); i++)
+		SafeRelease(m_vecStaging[i]);
+	m_vecStaging.clear();
+	m_pDevice = NULL;
+	m_nWidth = 0;
+	m_nHeight = 0;
+	m_dwFormat = 0;
+	if (m_nStagingBytes)
+	{
+		g_MemoryAccount.Free(MemTag_Surface, m_nMemoryChannel, m_nStagingBytes);
+		m_nStagingBytes = 0;
+	}
+}
+
+bool CD3D9ReadbackStaging::Copy(void *pSurface, int nSlot)
+{
+	IDirect3DSurface9 *pD3DSurface = (IDirect3DSurface9 *)pSurface;
+	IDirect3DDevice9 *pDevice = NULL;
+	if (FAILED(pD3DSurface->GetDevice(&pDevice)))
+		return false;
+	HRESULT hr = pDevice->StretchRect(pD3DSurface, NULL, m_vecStaging[nSlot], NULL, D3DTEXF_NONE);
+	pDevice->Release();
+	if (FAILED(hr))
+	{
+		DxTraceMsg("%s StretchRect failed,hr = %08X.\n", __FUNCTION__, hr);
+		return false;
+	}
+	return true;
+}
+
+bool CD3D9ReadbackStaging::Lock(int nSlot, ReadbackImage &Image)
+{
+	D3DLOCKED_RECT Rect;
+	HRESULT hr = m_vecStaging[nSlot]->LockRect(&Rect, NULL, D3DLOCK_READONLY);
+	if (FAILED(hr))
+	{
+		DxTraceMsg("%s LockRect failed,hr = %08X.\n", __FUNCTION__, hr);
+		return false;
+	}
+	Image.pBits = (const BYTE *)Rect.pBits;
+	Image.nPitch = Rect.Pitch;
+	Image.nSurfaceHeight = m_nHeight;
+	Image.bP010 = (m_dwFormat == MAKEFOURCC('P', '0', '1', '0'));
+	return true;
+}
+
+void CD3D9ReadbackStaging::Unlock(int nSlot)
+{
+	m_vecStaging[nSlot]->UnlockRect();
+}
+#endif
@@ -0,0 +1,182 @@
+#pragma once
+#include "Win32Port.h"
+#include <vector>
+#include "AutoLock.h"
+#include "AdaptiveLock.h"
+#include "DxTrace.h"
+#include "PixelCopy.h"
+#include "HighBitdepth.h"
+
+using namespace std;
+
+// ݴһ֡ͼ,ֻڻصڼЧ
+struct ReadbackImage
+{
+	const BYTE	*pBits;			// ݴ׵ַ,UVƽnSurfaceHeightеYƽ֮;ʧʱΪNULL
+	int			nPitch;
+	int			nSurfaceHeight;
+	bool		bP010;			// Ϊtrueʱ10λP010ʽ,ΪNV12
+	int			nWidth;			// ͼʵʳߴ
+	int			nHeight;
+	int64_t		nPts;
+	void		*pTag;			// SubmitʱĲ
+};
+
+// ضɻص,ڻض߳е;ģֱʹYƽ,ҪYUV420PͼʱCopyReadbackImageת
+typedef void (CALLBACK *ReadbackCallback)(const ReadbackImage &Image, void *pUserPtr);
+
+// ѻضͼתΪYUV420P
+inline void CopyReadbackImage(BYTE *pDst[3], int nDstPitch[3], const ReadbackImage &Image)
+{
+	if (Image.bP010)
+		CopyP010ToYUV420P(pDst, nDstPitch, Image.pBits, Image.nPitch, Image.nSurfaceHeight, Image.nWidth, Image.nHeight);
+	else
+		CopyNV12ToYUV420P(pDst, nDstPitch, Image.pBits, Image.pBits + Image.nPitch * Image.nSurfaceHeight, Image.nPitch, Image.nWidth, Image.nHeight);
+}
+
+/// @brief ضݴ
+/// @remark ԴԻضǲ͸ָ,ʵֽ;CreateCopyύ߳е,LockUnlockڻض߳е
+/// ʵʱCD3D9ReadbackStagingڽ豸ϴݴ,ʱԻڴеģʵ
+class IReadbackStaging
+{
+public:
+	virtual ~IReadbackStaging() {}
+	// Դݴ豸ߴ͸ʽͬʱtrue
+	virtual bool IsCompatible(void *pSurface) = 0;
+	// Դ洴nSlotsݴ
+	virtual bool Create(void *pSurface, int nSlots) = 0;
+	virtual void Release() = 0;
+	// GPUϰԴ渴ƵnSlotݴ,ȴ
+	virtual bool Copy(void *pSurface, int nSlot) = 0;
+	// ݴ,дImageеpBitsnPitchnSurfaceHeightbP010,GPUδɸʱȴ
+	virtual bool Lock(int nSlot, ReadbackImage &Image) = 0;
+	virtual void Unlock(int nSlot) = 0;
+};
+
+#ifdef _WIN32
+struct IDirect3DSurface9;
+// ڽڵ豸ϴݴ,StretchRect,ݴԴg_MemoryAccount
+class CD3D9ReadbackStaging : public IReadbackStaging
+{
+public:
+	CD3D9ReadbackStaging();
+	virtual ~CD3D9ReadbackStaging();
+	virtual bool IsCompatible(void *pSurface);
+	virtual bool Create(void *pSurface, int nSlots);
+	virtual void Release();
+	virtual bool Copy(void *pSurface, int nSlot);
+	virtual bool Lock(int nSlot, ReadbackImage &Image);
+	virtual void Unlock(int nSlot);
+private:
+	vector<IDirect3DSurface9 *>	m_vecStaging;
+	void					*m_pDevice;			// ݴڵ豸,ֻڱȽ
+	UINT					m_nWidth;
+	UINT					m_nHeight;
+	DWORD					m_dwFormat;
+	LONGLONG				m_nStagingBytes;	// ݴg_MemoryAccountֽ
+	int						m_nMemoryChannel;
+};
+#endif
+
+enum ReadbackSlotState
+{
+	Slot_Free = 0,		// 
+	Slot_Queued,		// ύGPU,ȴ֡ڼGPUɸ
+	Slot_Ready,			// ѽض߳
+};
+
+struct ReadbackSlot
+{
+	volatile LONG		nState;
+	int					nWidth;			// ͼʵʳߴ
+	int					nHeight;
+	int64_t				nPts;
+	void				*pTag;
+	bool				bAnalytics;		// ض󽻸ҹ
+	int64_t				nSubmitTime;
+};
+
+struct ReadbackStat
+{
+	LONG		nSubmitted;		// ύ֡
+	LONG		nDelivered;		// ѻضص֡
+	LONG		nDropped;		// ݴȫռûʧܶ֡
+	LONG		nFailed;		// ݴʧܵ֡
+	LONG		nExpired;		// δȵ֡ʱض֡
+	double		dfLockTime;		// ݴۼƺʱ,λ
+	double		dfCopyTime;		// صиƺתۼƺʱ,λ
+	double		dfThreadCpuTime;// ض߳ĵCPUʱ,صеĸƺת,λ,ڻض߳˳ʱȡ,Destroy֮Ч
+};
+
+/// @brief Ӳ֡첽ض
+/// @remark ֱʱ,LockRectҪGPUɸ֡Ľ,ύ߳
+/// ضΪÿ֡GPUϰѽ渴Ƶһݴ,֮ύnLatency֡ŰѸݴ潻ض߳,
+/// ʱGPUɸ,ض߳ݴͨصƴӺϳɡͼͷ,ύ̲߳ٵȴGPU
+/// ͼǵύȲ֡,dwMaxDelayɻضֱ߳ӻض
+/// SubmitFlush߳е,ͬһʱֻһ߳ύ
+class CReadbackRing
+{
+public:
+	CReadbackRing();
+	~CReadbackRing();
+
+	/// @brief ض߳
+	/// @param pStaging	ݴ,Ȼضڸ;WindowsΪNULLʱʹûضԼCD3D9ReadbackStaging
+	/// @param nSlots	ݴ,ΪnLatency + 2
+	/// @param nLatency	ύӳٶ֡ٻض
+	/// @param dwMaxDelay	ύӳٶٺٻض,ΪINFINITEʱֻ֡ӳ
+	bool Create(IReadbackStaging *pStaging, int nSlots, int nLatency, DWORD dwMaxDelay, ReadbackCallback pCallback, void *pUserPtr);
+
+	// ضύ֡ض߳,ͷݴ
+	void Destroy();
+
+	/// @brief ύһӲ֡,GPUϸƵݴ
+	/// @param pSurface	Դ,D3D9Ϊ֡data[3]еIDirect3DSurface9
+	/// @param pTag		صʱReadbackImage::pTag
+	/// @return ݴȫռʱ֡,false
+	bool Submit(void *pSurface, int nWidth, int nHeight, int64_t nPts, void *pTag = NULL);
+
+	// ύ֡ض߳,ȴض
+	void Flush();
+
+	// ˷ҹһSubmit֡Ҫҹʱtrue,߳̾ݴֻΪύҪ֡
+	bool IsAnalyticsDue();
+
+	/// @brief ÷ҹ,лضÿύnInterval֡һ֡pHook,pHookΪNULLʱȡ
+	/// @remark pHookڸضĻض߳е,pHook÷ҹ;ʱûлض߳ڵԭĹҹ
+	static void SetAnalyticsHook(ReadbackCallback pHook, void *pUserPtr, int nInterval);
+	static bool HasAnalyticsHook();
+
+	void GetStat(ReadbackStat &Stat)
+	{
+		CAutoLock lock(&m_csStat);
+		memcpy(&Stat, &m_Stat, sizeof(ReadbackStat));
+	}
+	void TraceStat();
+private:
+	CReadbackRing(const CReadbackRing &);
+	CReadbackRing &operator=(const CReadbackRing &);
+	void ReleaseOldest();
+	void ReleaseExpired();
+	void ReadSlot(int nSlot);
+	static UINT __stdcall ReadbackThread(void *p);
+
+	IReadbackStaging		*m_pStaging;
+	bool					m_bOwnStaging;
+	vector<ReadbackSlot>	m_vecSlot;
+	int						m_nLatency;
+	DWORD					m_dwMaxDelay;
+	int						m_nWrite;		// һҪдݴ,m_csSubmit
+	int						m_nQueued;		// Slot_Queued״̬ݴ,m_csSubmit
+	int						m_nRead;		// һҪضݴ,ֻڻض߳з
+	LONG					m_nAnalyticsCount;	// һνҹύ,m_csSubmit
+	HANDLE					m_hSemReady;	// ض̵߳ݴ
+	HANDLE					m_hEventFree;	// ݴ汻ض
+	HANDLE					m_hEventExit;
+	HANDLE					m_hThread;
+	ReadbackCallback		m_pCallback;
+	void					*m_pUserPtr;
+	CRITICAL_SECTION		m_csSubmit;
+	CRITICAL_SECTION		m_csStat;
+	ReadbackStat			m_Stat;
+};
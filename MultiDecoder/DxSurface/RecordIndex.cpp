@@ -0,0 +1,293 @@
+#include "RecordIndex.h"
+#include <algorithm>
+#include "TimeUtility.h"
+#include "MonoClock.h"
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define __STDC_CONSTANT_MACROS
+#include "libavutil/avutil.h"
+#ifdef _WIN32
+#include "libavformat/avformat.h"
+#endif
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+
+#define RECORD_MAX_CHANNELS		1024	// ļеͨŲֵܳ,쳣ļͨ
+
+#ifdef _WIN32
+// Windows 7Ŀ¼öٷʽ,ɰSDKûж
+#ifndef FIND_FIRST_EX_LARGE_FETCH
+#define FIND_FIRST_EX_LARGE_FETCH	2
+#endif
+#define FindExInfo_Basic			((FINDEX_INFO_LEVELS)1)
+#endif
+
+CRecordIndex::CRecordIndex()
+{
+	InitializeCriticalSection(&m_csIndex);
+	m_nFiles = 0;
+	m_bSorted = true;
+}
+
+CRecordIndex::~CRecordIndex()
+{
+	Clear();
+	DeleteCriticalSection(&m_csIndex);
+}
+
+#ifdef _WIN32
+int CRecordIndex::Build(LPCTSTR szRoot)
+{
+	Clear();
+	if (!szRoot)
+		return 0;
+	int64_t nT1 = MonoTimeNs();
+	int nScanned = 0;
+	vector<basic_string<TCHAR> > vecDir;
+	vecDir.push_back(szRoot);
+	while (!vecDir.empty())
+	{
+		basic_string<TCHAR> strDir = vecDir.back();
+		vecDir.pop_back();
+		basic_string<TCHAR> strPattern = strDir + _T("\\*");
+		WIN32_FIND_DATA fd;
+		// ȡļ,ÿδļϵͳȡظĿ¼;XP֧ʱͨʽ
+		HANDLE hFind = FindFirstFileEx(strPattern.c_str(), FindExInfo_Basic, &fd, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+		if (hFind == INVALID_HANDLE_VALUE && GetLastError() == ERROR_INVALID_PARAMETER)
+			hFind = FindFirstFileEx(strPattern.c_str(), FindExInfoStandard, &fd, FindExSearchNameMatch, NULL, 0);
+		if (hFind == INVALID_HANDLE_VALUE)
+			continue;
+		do
+		{
+			if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			{// ؽ,Ŀ¼γѭ
+				if (_tcscmp(fd.cFileName, _T(".")) && _tcscmp(fd.cFileName, _T("..")) &&
+					!(fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+					vecDir.push_back(strDir + _T("\\") + fd.cFileName);
+				continue;
+			}
+			nScanned++;
+			// ֻļ,ļƴ·
+			int nChannel = 0;
+			int64_t nStartTime = 0;
+			if (ParseFileName(fd.cFileName, nChannel, nStartTime))
+				AddFile((strDir + _T("\\") + fd.cFileName).c_str());
+		} while (FindNextFile(hFind, &fd));
+		FindClose(hFind);
+	}
+	int64_t nT2 = MonoTimeNs();
+	CAutoLock lock(&m_csIndex);
+	SortChannels();
+	DxTraceMsg("%s Scanned = %d\tIndexed = %d\tChannels = %d\tTime = %.1fms(Sort = %.1fms).\n", __FUNCTION__,
+				nScanned, m_nFiles, (int)m_vecChannel.size(), MonoNsToMs(MonoTimeNs() - nT1), MonoNsToMs(MonoTimeNs() - nT2));
+	return m_nFiles;
+}
+#endif
+
+bool CRecordIndex::AddFile(LPCTSTR szPath)
+{
+	int nChannel = 0;
+	int64_t nStartTime = 0;
+	if (!szPath || _tcslen(szPath) >= MAX_PATH || !ParseFileName(szPath, nChannel, nStartTime))
+		return false;
+	CAutoLock lock(&m_csIndex);
+	if (m_vecChannel.size() <= nChannel)
+		m_vecChannel.resize(nChannel + 1);
+	m_vecChannel[nChannel].push_back(RecordFile());
+	RecordFile &File = m_vecChannel[nChannel].back();
+	File.strPath = szPath;
+	File.nStartTime = nStartTime;
+	File.nDuration = RECORD_TIME_UNKNOWN;
+	File.bKeyFrameLoaded = false;
+	m_nFiles++;
+	m_bSorted = false;
+	return true;
+}
+
+void CRecordIndex::Clear()
+{
+	CAutoLock lock(&m_csIndex);
+	m_vecChannel.clear();
+	m_nFiles = 0;
+	m_bSorted = true;
+}
+
+int CRecordIndex::GetFileCount()
+{
+	CAutoLock lock(&m_csIndex);
+	return m_nFiles;
+}
+
+int CRecordIndex::GetChannelCount()
+{
+	CAutoLock lock(&m_csIndex);
+	return m_vecChannel.size();
+}
+
+// ȡm_csIndex
+void CRecordIndex::SortChannels()
+{
+	if (m_bSorted)
+		return;
+	for (int i = 0; i < m_vecChannel.size(); i++)
+		stable_sort(m_vecChannel[i].begin(), m_vecChannel[i].end(), [](const RecordFile &a, const RecordFile &b)
+		{
+			return a.nStartTime < b.nStartTime;
+		});
+	m_bSorted = true;
+}
+
+bool CRecordIndex::Resolve(int nChannel, int64_t nTime, RecordPosition &Pos, bool bKeyFrame)
+{
+	if (nChannel < 0)
+		return false;
+	CAutoLock lock(&m_csIndex);
+	SortChannels();
+	if (nChannel >= m_vecChannel.size())
+		return false;
+	vector<RecordFile> &vecFile = m_vecChannel[nChannel];
+	// ʼʱ䲻nTimeһļ
+	int nLow = 0;
+	int nHigh = vecFile.size();
+	while (nLow < nHigh)
+	{
+		int nMid = (nLow + nHigh) / 2;
+		if (vecFile[nMid].nStartTime <= nTime)
+			nLow = nMid + 1;
+		else
+			nHigh = nMid;
+	}
+	if (!nLow)
+		return false;
+	RecordFile &File = vecFile[nLow - 1];
+	int64_t nOffset = nTime - File.nStartTime;
+	if (bKeyFrame && !File.bKeyFrameLoaded)
+		LoadKeyFrames(File);
+	if (File.nDuration != RECORD_TIME_UNKNOWN && nOffset >= File.nDuration)
+		return false;
+	_tcscpy_s(Pos.szPath, MAX_PATH, File.strPath.c_str());
+	Pos.nFileStartTime = File.nStartTime;
+	Pos.nOffset = nOffset;
+	Pos.nKeyFrameOffset = 0;
+	Pos.nKeyFramePos = -1;
+	// nOffsetһؼ֡
+	nLow = 0;
+	nHigh = File.vecKeyFrame.size();
+	while (nLow < nHigh)
+	{
+		int nMid = (nLow + nHigh) / 2;
+		if (File.vecKeyFrame[nMid].nOffset <= nOffset)
+			nLow = nMid + 1;
+		else
+			nHigh = nMid;
+	}
+	if (nLow)
+	{
+		Pos.nKeyFrameOffset = File.vecKeyFrame[nLow - 1].nOffset;
+		Pos.nKeyFramePos = File.vecKeyFrame[nLow - 1].nPos;
+	}
+	return true;
+}
+
+bool CRecordIndex::ParseFileName(LPCTSTR szName, int &nChannel, int64_t &nStartTime)
+{
+	if (!szName)
+		return false;
+	LPCTSTR szFile = szName;
+	for (LPCTSTR p = szName; *p; p++)
+	{
+		if (*p == _T('\\') || *p == _T('/'))
+			szFile = p + 1;
+	}
+	if ((szFile[0] != _T('C') && szFile[0] != _T('c')) || (szFile[1] != _T('H') && szFile[1] != _T('h')))
+		return false;
+	int nValue = 0;
+	int nDigits = 0;
+	for (LPCTSTR p = szFile + 2; *p >= _T('0') && *p <= _T('9') && nDigits < 6; p++, nDigits++)
+		nValue = nValue * 10 + (*p - _T('0'));
+	if (!nDigits || nValue >= RECORD_MAX_CHANNELS)
+		return false;
+	// "_yyyyMMdd_hhmmss",ܽ
+	int nLength = _tcslen(szFile);
+	for (int i = 2 + nDigits; i + 16 <= nLength; i++)
+	{
+		if (szFile[i] != _T('_') || szFile[i + 9] != _T('_'))
+			continue;
+		if (szFile[i + 16] >= _T('0') && szFile[i + 16] <= _T('9'))
+			continue;
+		UINT64 nTime = 0;
+		if (!FastDateTime2UTC(&szFile[i + 1], 15, nTime))
+			continue;
+		nChannel = nValue;
+		nStartTime = (int64_t)nTime * AV_TIME_BASE;
+		return true;
+	}
+	return false;
+}
+
+// ȡļĹؼ֡ʱ,mp4mkvڴļʱļͷж,ضȡ֡
+// ƽ̨²FFMPEG,ֻΪѶȡ,ѯؼ֡,ļʱΪδ֪
+bool CRecordIndex::LoadKeyFrames(RecordFile &File)
+{
+	File.bKeyFrameLoaded = true;
+#ifndef _WIN32
+	return false;
+#else
+	char szFilePath[MAX_PATH] = { 0 };
+#ifdef _UNICODE
+	WideCharToMultiByte(CP_ACP, 0, File.strPath.c_str(), -1, szFilePath, MAX_PATH, NULL, NULL);
+#else
+	strcpy_s(szFilePath, MAX_PATH, File.strPath.c_str());
+#endif
+	AVFormatContext *pFormatCtx = NULL;
+	int nAvError = avformat_open_input(&pFormatCtx, szFilePath, NULL, NULL);
+	if (nAvError < 0)
+	{
+		char szAvError[256] = { 0 };
+		av_strerror(nAvError, szAvError, 256);
+		DxTraceMsg("%s Failed to open %s:%s.\n", __FUNCTION__, szFilePath, szAvError);
+		return false;
+	}
+	AVStream *pStream = NULL;
+	for (int i = 0; i < pFormatCtx->nb_streams; i++)
+	{
+		if (pFormatCtx->streams[i]->codec->codec_type == AVMEDIA_TYPE_VIDEO)
+		{
+			pStream = pFormatCtx->streams[i];
+			break;
+		}
+	}
+	if (!pStream)
+	{
+		avformat_close_input(&pFormatCtx);
+		return false;
+	}
+	AVRational nMicroBase = { 1, AV_TIME_BASE };
+	int64_t nBase = pStream->start_time;
+	if (nBase == AV_NOPTS_VALUE)
+		nBase = pStream->nb_index_entries ? pStream->index_entries[0].timestamp : 0;
+	File.vecKeyFrame.reserve(pStream->nb_index_entries / 8 + 1);
+	for (int i = 0; i < pStream->nb_index_entries; i++)
+	{
+		AVIndexEntry &Entry = pStream->index_entries[i];
+		if (!(Entry.flags & AVINDEX_KEYFRAME))
+			continue;
+		RecordKeyFrame KeyFrame;
+		KeyFrame.nOffset = av_rescale_q(Entry.timestamp - nBase, pStream->time_base, nMicroBase);
+		KeyFrame.nPos = Entry.pos;
+		File.vecKeyFrame.push_back(KeyFrame);
+	}
+	if (pFormatCtx->duration != AV_NOPTS_VALUE)
+		File.nDuration = pFormatCtx->duration;
+	else if (pStream->duration != AV_NOPTS_VALUE)
+		File.nDuration = av_rescale_q(pStream->duration, pStream->time_base, nMicroBase);
+	avformat_close_input(&pFormatCtx);
+	return true;
+#endif
+}
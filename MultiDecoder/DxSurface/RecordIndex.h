@@ -0,0 +1,87 @@
+#pragma once
+#include "Win32Port.h"
+#ifdef _WIN32
+#include <tchar.h>
+#endif
+#include <vector>
+#include <string>
+#include "AutoLock.h"
+#include "DxTrace.h"
+
+using namespace std;
+
+#define RECORD_TIME_UNKNOWN		((int64_t)-1)
+
+// ¼ļеһؼ֡
+struct RecordKeyFrame
+{
+	int64_t		nOffset;		// ļʼʱ΢
+	int64_t		nPos;			// ļеֽƫ,δ֪ʱΪ-1
+};
+
+// еһ¼ļ
+struct RecordFile
+{
+	basic_string<TCHAR>		strPath;
+	int64_t					nStartTime;		// ļʼʱ,1970΢,ȡļ
+	int64_t					nDuration;		// ļʱ,λ΢,δ֪ʱΪRECORD_TIME_UNKNOWN
+	bool					bKeyFrameLoaded;	// ǷѶȡؼ֡,ȡʧҲΪtrue,
+	vector<RecordKeyFrame>	vecKeyFrame;		// ʱ
+};
+
+// ResolveĽ
+struct RecordPosition
+{
+	TCHAR		szPath[MAX_PATH];
+	int64_t		nFileStartTime;		// ļʼʱ,1970΢
+	int64_t		nOffset;			// ʱļʼ΢
+	int64_t		nKeyFrameOffset;	// ʱ֮ǰһؼ֡ļʼ΢,ûйؼ֡ʱΪ0
+	int64_t		nKeyFramePos;		// ùؼ֡ļеֽƫ,δ֪ʱΪ-1
+};
+
+/// @brief ļ¼ʱ
+/// @remark ¼ļCH00_192.168.24.211_ch00_20151210_095601_H.264.mp4,"CH"ͷΪͨ,
+/// "yyyyMMdd_hhmmss"Ϊļʼʱ;BuildɨĿ¼,ֻļ,ļ,ͨļʼʱ,
+/// ѯʱֲڵļ,һβ鵽ĳļʱŶȡؼ֡,˺󻺴
+/// зκ߳е
+class CRecordIndex
+{
+public:
+	CRecordIndex();
+	~CRecordIndex();
+
+#ifdef _WIN32
+	/// @brief ɨĿ¼,з¼ļ
+	/// @remark ǰ
+	/// @return ļ
+	int Build(LPCTSTR szRoot);
+#endif
+
+	/// @brief һ¼ļ,ļʱfalse
+	/// @remark Ӻͨļ´βѯʱ,ʱ
+	bool AddFile(LPCTSTR szPath);
+
+	void Clear();
+	int GetFileCount();
+	int GetChannelCount();
+
+	/// @brief ָͨʱ¼λ
+	/// @param nTime		1970΢
+	/// @param bKeyFrame	ǷȡļĹؼ֡,ȡʱ֮ǰĹؼ֡ļʱ,ֻWindows¶ȡ
+	/// @return ʱû¼ʱfalse,֪ļʱʱ,ļ֮һļʼ֮ǰΪû¼
+	bool Resolve(int nChannel, int64_t nTime, RecordPosition &Pos, bool bKeyFrame = true);
+
+	/// @brief ļнͨͿʼʱ
+	/// @param szName	ļ,Դ·
+	/// @param nStartTime	1970΢
+	static bool ParseFileName(LPCTSTR szName, int &nChannel, int64_t &nStartTime);
+
+private:
+	void SortChannels();
+	static bool LoadKeyFrames(RecordFile &File);
+
+	vector<vector<RecordFile> >	m_vecChannel;
+	CRITICAL_SECTION			m_csIndex;
+	int							m_nFiles;
+	bool						m_bSorted;
+};
@@ -0,0 +1,129 @@
+#include "RenderStage.h"
+
+CRenderStage::CRenderStage()
+{
+	m_pDxSurface = NULL;
+	m_pInitCallback = NULL;
+	m_pUserPtr = NULL;
+	m_pLatency = NULL;
+	m_nChannel = -1;
+	m_nInterval = 20;
+	m_hEventFrame = NULL;
+	m_hEventExit = NULL;
+	m_hThread = NULL;
+	m_nRendered = 0;
+	m_nRenderFailed = 0;
+	m_nRenderTime = 0;
+	m_nThreadCpuTime = 0;
+}
+
+CRenderStage::~CRenderStage()
+{
+	Stop();
+}
+
+bool CRenderStage::Start(IRenderSurface *pDxSurface, RenderInitCallback pInitCallback, void *pUserPtr, int nInterval)
+{
+	Stop();
+	if (!pDxSurface || nInterval <= 0)
+		return false;
+	m_pDxSurface = pDxSurface;
+	m_pInitCallback = pInitCallback;
+	m_pUserPtr = pUserPtr;
+	m_nInterval = nInterval;
+	m_hEventFrame = CreateEvent(NULL, FALSE, FALSE, NULL);
+	m_hEventExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!m_hEventFrame || !m_hEventExit)
+	{
+		Stop();
+		return false;
+	}
+	m_hThread = (HANDLE)_beginthreadex(nullptr, 0, RenderThread, this, 0, nullptr);
+	if (!m_hThread)
+	{
+		Stop();
+		return false;
+	}
+	return true;
+}
+
+void CRenderStage::Stop()
+{
+	if (m_hThread)
+	{
+		SetEvent(m_hEventExit);
+		WaitForSingleObject(m_hThread, INFINITE);
+		CloseHandle(m_hThread);
+		m_hThread = NULL;
+	}
+	// еӲ֡н,ڽ֮ǰͷ
+	m_Mailbox.Clear();
+	if (m_hEventFrame)
+	{
+		CloseHandle(m_hEventFrame);
+		m_hEventFrame = NULL;
+	}
+	if (m_hEventExit)
+	{
+		CloseHandle(m_hEventExit);
+		m_hEventExit = NULL;
+	}
+}
+
+UINT __stdcall CRenderStage::RenderThread(void *p)
+{
+	CRenderStage *pThis = (CRenderStage *)p;
+	HANDLE hEvents[2] = { pThis->m_hEventExit, pThis->m_hEventFrame };
+	TimelineSetThreadName("Render", pThis->m_nChannel);
+	g_MemoryAccount.SetThreadChannel(pThis->m_nChannel);
+	g_ThreadPlacement.Apply(ThreadRole_Render, pThis->m_nChannel);
+	while (true)
+	{
+		DWORD dwResult = WaitForMultipleObjects(2, hEvents, FALSE, pThis->m_nInterval);
+		if (dwResult != WAIT_OBJECT_0 + 1 && dwResult != WAIT_TIMEOUT)
+			break;
+		int64_t nPostTime = 0;
+		AVFrame *pAvFrame = pThis->m_Mailbox.Fetch(&nPostTime);	// ʱû֡ʱΪһظ
+		if (!pAvFrame)
+			continue;
+		if (pThis->m_pLatency && nPostTime > 0)
+			pThis->m_pLatency->Record(LatencyStage_QueueWait, nPostTime, MonoTimeNs());
+		if (!pThis->m_pDxSurface->IsInited() && pThis->m_pInitCallback &&
+			!pThis->m_pInitCallback(pThis->m_pDxSurface, pAvFrame, pThis->m_pUserPtr))
+		{
+			InterlockedIncrement(&pThis->m_nRenderFailed);
+			continue;
+		}
+		TIMELINE_SCOPE("Render", pThis->m_nChannel, pAvFrame->pkt_pts);
+		int64_t nT1 = MonoTimeNs();
+		if (pThis->m_pDxSurface->Render(pAvFrame))
+			InterlockedIncrement(&pThis->m_nRendered);
+		else
+			InterlockedIncrement(&pThis->m_nRenderFailed);
+		pThis->m_nRenderTime += MonoTimeNs() - nT1;
+	}
+	pThis->m_nThreadCpuTime = MonoThreadCpuNs();
+	return 0;
+}
+
+void CRenderStage::GetStat(RenderStageStat &Stat)
+{
+	MailboxStat MBStat;
+	m_Mailbox.GetStat(MBStat);
+	Stat.nPosted = MBStat.nPosted;
+	Stat.nDropped = MBStat.nDropped;
+	Stat.nRepeated = MBStat.nRepeated;
+	Stat.nRendered = m_nRendered;
+	Stat.nRenderFailed = m_nRenderFailed;
+	Stat.dfRenderTime = MonoNsToSeconds(m_nRenderTime);
+	Stat.dfThreadCpuTime = MonoNsToSeconds(m_nThreadCpuTime);
+}
+
+void CRenderStage::TraceStat()
+{
+	RenderStageStat Stat;
+	GetStat(Stat);
+	DxTraceMsg("%s Posted = %d\tRendered = %d\tDropped = %d\tRepeated = %d\tFailed = %d\tAvgRender = %.3fms.\n", __FUNCTION__,
+				Stat.nPosted, Stat.nRendered, Stat.nDropped, Stat.nRepeated, Stat.nRenderFailed,
+				Stat.nRendered ? Stat.dfRenderTime * 1000 / Stat.nRendered : 0.0f);
+}
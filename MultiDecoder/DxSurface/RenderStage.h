@@ -0,0 +1,93 @@
+#pragma once
+#include "Win32Port.h"
+#include "RenderSurface.h"
+#include "DxTrace.h"
+#include "MonoClock.h"
+#include "FrameMailbox.h"
+#include "LatencyHistogram.h"
+#include "TimelineTrace.h"
+#include "MemoryAccount.h"
+#include "ThreadPlacement.h"
+
+// Ⱦʼص,Ⱦ߳յһ֡pDxSurfaceδʼʱ,falseʱ֡,յһ֡ʱٴγ
+typedef bool (CALLBACK *RenderInitCallback)(IRenderSurface *pDxSurface, AVFrame *pFirstFrame, void *pUserPtr);
+
+struct RenderStageStat
+{
+	LONG		nPosted;		// ߳Ͷݵ֡
+	LONG		nDropped;		// δʾ֡ǵ֡
+	LONG		nRendered;		// ɹȾ֡
+	LONG		nRepeated;		// ʾû֡,Ļϱһ֡Ĵ
+	LONG		nRenderFailed;	// Ⱦʧܵ֡,豸ʧָڼȾٽռʱ֡
+	double		dfRenderTime;	// Ⱦۼƺʱ,λ
+	double		dfThreadCpuTime;// Ⱦ߳ĵCPUʱ,λ,Ⱦ߳˳ʱȡ,Stop֮Ч
+};
+
+/// @brief ͨĶȾ߳
+/// @remark ֱ߳ӵȾ˵Renderʱ,Presentĵȴ豸ʧĻָ
+/// Ⱦ߳ͨ֡߳̽:ֻ߳Ͷ֡ú,Ⱦ̰߳ʾȡµһ֡Ⱦ,
+/// Ⱦڽʱм֡,ڽʱһ֡,ֱnDroppednRepeated
+/// Postֻһ߳е
+class CRenderStage
+{
+public:
+	CRenderStage();
+	~CRenderStage();
+
+	/// @brief Ⱦ߳
+	/// @param pDxSurface	Ⱦ,Ⱦ߳ڼֻȾ̵߳Render
+	/// @param pInitCallback	Ⱦĳʼص,D3D豸Ⱦ߳д,ΪNULL
+	/// @param nInterval	ʾ,λ,ʱû֡Ϊһظ
+	bool Start(IRenderSurface *pDxSurface, RenderInitCallback pInitCallback, void *pUserPtr, int nInterval = 20);
+
+	// Ⱦ߳,ͷе֡
+	void Stop();
+
+	// Ͷһ֡,ֻ֡,
+	void Post(AVFrame *pAvFrame)
+	{
+		if (!m_hThread)
+			return;
+		m_Mailbox.Post(pAvFrame, m_pLatency ? MonoTimeNs() : 0);
+		SetEvent(m_hEventFrame);
+	}
+
+	// ü¼֡ȴʱֱͼ,Start֮ǰ
+	void SetLatency(CChannelLatency *pLatency)
+	{
+		m_pLatency = pLatency;
+	}
+
+	// Ⱦ̵߳ȼ,ȡֵSetThreadPriorityͬ,Start֮
+	void SetPriority(int nPriority)
+	{
+		if (m_hThread)
+			::SetThreadPriority(m_hThread, nPriority);
+	}
+
+	// Ⱦ߳ͨ,ʱߺڴͳ,Start֮ǰ
+	void SetChannel(int nChannel)
+	{
+		m_nChannel = nChannel;
+	}
+
+	void GetStat(RenderStageStat &Stat);
+	void TraceStat();
+private:
+	static UINT __stdcall RenderThread(void *p);
+
+	CFrameMailbox			m_Mailbox;
+	IRenderSurface			*m_pDxSurface;
+	RenderInitCallback		m_pInitCallback;
+	void					*m_pUserPtr;
+	CChannelLatency			*m_pLatency;
+	int						m_nChannel;
+	int						m_nInterval;
+	HANDLE					m_hEventFrame;
+	HANDLE					m_hEventExit;
+	HANDLE					m_hThread;
+	volatile LONG			m_nRendered;
+	volatile LONG			m_nRenderFailed;
+	int64_t					m_nRenderTime;	// Ⱦۼƺʱ,λ,ֻȾ߳޸
+	int64_t					m_nThreadCpuTime;	// Ⱦ߳ĵCPUʱ,λ
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include "Win32Port.h"
+#ifdef _WIN32
+#include <d3d9.h>
+#endif
+
+struct AVFrame;
+class CChannelLatency;
+
+/// @brief Ⱦ˽ӿ
+/// @remark ̺߳Ⱦֻ߳ͨýӿڳʼȾ,ĺ
+/// CDxSurfaceΪD3D9ʾĺ,COffscreenSurfaceΪ޴ڵĺ,ڷϲԺȾ,
+/// CMemorySurfaceΪWin32D3DĴڴ,LinuxûGPUʹϵͳĻȾ
+class IRenderSurface
+{
+public:
+	virtual ~IRenderSurface() {}
+
+	/// @brief ʼȾ
+	/// @param hWnd		ʾ,˿ΪNULL
+	/// @param nVideoWidth	ƵͼĿ
+	/// @param nVideoHeight	Ƶͼĸ߶
+	virtual bool InitD3D(HWND hWnd,
+		int nVideoWidth,
+		int nVideoHeight,
+		BOOL bIsWindowed = TRUE,
+		D3DFORMAT nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2')) = 0;
+
+	// ʹӲ豸ʼ,ֹ֧豸ĺ˷false,ӦInitD3D
+	virtual bool InitD3DShared(HWND hWnd,
+		IDirect3DDevice9 *pDevice,
+		int nVideoWidth,
+		int nVideoHeight,
+		D3DFORMAT nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2')) = 0;
+
+	// ͷõԴ,ڽ֮ǰ
+	virtual void DetachSharedDevice() = 0;
+
+	virtual bool IsInited() = 0;
+
+	// Ⱦһ֡,ȾʧܻȾʱfalse
+	virtual bool Render(AVFrame *pAvFrame, HWND hWnd = NULL, RECT *pRenderRt = NULL) = 0;
+
+	// 鲢ָʧ豸,˲ʱfalse
+	virtual bool HandelDevLost() = 0;
+
+	// ͷȾԴ,֮ٴγʼ
+	virtual void DxCleanup() = 0;
+
+	// ü¼׶ӳٵֱͼ,ΪNULLʱ¼;ֵ֧ĺ˺
+	virtual void SetLatency(CChannelLatency *pLatency) {}
+};
@@ -0,0 +1,223 @@
+#pragma once
+#include "Win32Port.h"
+#include "DxTrace.h"
+#include "MonoClock.h"
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define __STDC_CONSTANT_MACROS
+#include "libavcodec/avcodec.h"
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+
+#define _THROTTLE_CHECK_INTERVAL	200		// ¼鴰ڼκڵ״̬ļ,λ
+#define _THROTTLE_MIN_SIZE			16		// ͻСڸֵʱʾ
+#define _THROTTLE_SMALL_RATIO		16		// Ƶͻĸñʱʾ֡
+#define _THROTTLE_REDUCED_INTERVAL	100		// ֡ʺСʾ,λ
+
+enum RenderRate
+{
+	RenderRate_None = 0,	// СءȫڵС,ʾ
+	RenderRate_Reduced,		// ںС,_THROTTLE_REDUCED_INTERVALļʾ
+	RenderRate_Full			// ÿ֡ʾ
+};
+
+struct RenderThrottleStat
+{
+	LONG	nRendered;		// ʾ֡
+	LONG	nReduced;		// 򽵵֡ʶ֡
+	LONG	nHidden;		// 򴰿ڲɼ֡
+};
+
+/// @brief ʾڵļκڵ״̬
+/// @remark ʵʱCWin32WindowGeometryѯ,ʱԻģʵ
+class IRenderWindowGeometry
+{
+public:
+	virtual ~IRenderWindowGeometry() {}
+	// ڼھδСҿɼʱtrue
+	virtual bool IsShown(HWND hWnd) = 0;
+	// ȡÿͻĿ͸
+	virtual bool GetClientSize(HWND hWnd, int &nWidth, int &nHeight) = 0;
+	// ڱȫڵ,ƳڵĿͻʱtrue
+	virtual bool IsOccluded(HWND hWnd) = 0;
+};
+
+#ifdef _WIN32
+/// @brief ͨWin32ںȡô״̬
+/// @remark ڵݴDCĲü,ϳ(DWM)ʱڵĴĲü,ʱֻܼ⵽Сغͳߴ
+class CWin32WindowGeometry : public IRenderWindowGeometry
+{
+public:
+	virtual bool IsShown(HWND hWnd)
+	{
+		if (IsIconic(hWnd) ||				// С
+			!IsWindowVisible(hWnd))			// 
+			return false;
+		// ǰڵĸڱػС಻ʾͼ
+		HWND hRoot = GetAncestor(hWnd, GA_ROOT);
+		return !hRoot || (!IsIconic(hRoot) && IsWindowVisible(hRoot));
+	}
+	virtual bool GetClientSize(HWND hWnd, int &nWidth, int &nHeight)
+	{
+		RECT rtClient;
+		if (!GetClientRect(hWnd, &rtClient))
+			return false;
+		nWidth = rtClient.right - rtClient.left;
+		nHeight = rtClient.bottom - rtClient.top;
+		return true;
+	}
+	virtual bool IsOccluded(HWND hWnd)
+	{
+		HDC hDC = GetDC(hWnd);
+		if (!hDC)
+			return false;
+		RECT rtClip;
+		int nRegion = GetClipBox(hDC, &rtClip);
+		ReleaseDC(hWnd, hDC);
+		return nRegion == NULLREGION;
+	}
+};
+#endif
+
+/// @brief ĿɼԺͳߴʾ֡
+/// @remark ڵļκڵ״̬ÿ_THROTTLE_CHECK_INTERVAL¼һ,ÿֻ֡Ƚʱ
+/// ֡ʰʱ֡,̺߳CDxSurfaceʹʹһCRenderThrottle,Ҳظ֡
+/// гԱȫΪ0ΪЧĳʼ״̬,ֱΪCDxSurfaceThreadParamĳԱ,Ҫ,
+/// ʱͨCWin32WindowGeometryѯ״̬
+class CRenderThrottle
+{
+public:
+	/// @brief ָ״̬Դ,ΪNULLʱʹCWin32WindowGeometry
+	/// @remark ڿʼUpdateShouldRender֮ǰ
+	void SetGeometry(IRenderWindowGeometry *pGeometry)
+	{
+		m_pGeometry = pGeometry;
+		m_nLastCheck = 0;
+	}
+
+	/// @brief ȡôڵʾ֡,ϴμ鲻_THROTTLE_CHECK_INTERVALҴδıʱֱӷϴεĽ
+	/// @param nVideoWidth	Ƶ,Ϊ0ʱߴ罵֡
+	/// @param nNow			ǰʱ,ȡMonoTimeNs
+	RenderRate Update(HWND hWnd, int nVideoWidth, int nVideoHeight, int64_t nNow)
+	{
+		if (hWnd != m_hWnd || !m_nLastCheck || nNow - m_nLastCheck >= _THROTTLE_CHECK_INTERVAL * MONO_NS_PER_MS)
+		{
+			m_hWnd = hWnd;
+			m_nLastCheck = nNow ? nNow : 1;
+			InterlockedExchange(&m_nRate, CheckWindow(hWnd, nVideoWidth, nVideoHeight));
+		}
+		return (RenderRate)m_nRate;
+	}
+
+	RenderRate Update(HWND hWnd, int nVideoWidth, int nVideoHeight)
+	{
+		return Update(hWnd, nVideoWidth, nVideoHeight, MonoTimeNs());
+	}
+
+	/// @brief жϵǰ֡ǷҪʾ
+	/// @param bFullRate	ΪtrueʱֻҪڿɼʾÿһ֡,򴰿ڽС֡,ѡеͨ
+	bool ShouldRender(HWND hWnd, int nVideoWidth, int nVideoHeight, bool bFullRate, int64_t nNow)
+	{
+		switch (Update(hWnd, nVideoWidth, nVideoHeight, nNow))
+		{
+		case RenderRate_None:
+			m_Stat.nHidden++;
+			return false;
+		case RenderRate_Reduced:
+		{
+			if (bFullRate)
+				break;
+			// ķ֮һĶ,Ѱͬ֡ʱٴ֡
+			if (m_nLastRender && nNow - m_nLastRender + _THROTTLE_REDUCED_INTERVAL * MONO_NS_PER_MS / 4 < _THROTTLE_REDUCED_INTERVAL * MONO_NS_PER_MS)
+			{
+				m_Stat.nReduced++;
+				return false;
+			}
+			m_nLastRender = nNow ? nNow : 1;
+			break;
+		}
+		default:
+			m_nLastRender = 0;
+			break;
+		}
+		m_Stat.nRendered++;
+		return true;
+	}
+
+	bool ShouldRender(HWND hWnd, int nVideoWidth, int nVideoHeight, bool bFullRate = false)
+	{
+		return ShouldRender(hWnd, nVideoWidth, nVideoHeight, bFullRate, MonoTimeNs());
+	}
+
+	/// @brief ֮ǰ״̬֡ʽ,ڲɼʱֻο֡,Ҫƺʾ֡
+	/// @param nDiscard	ؿҪĶ֡ʽ
+	/// @return Ķ֡ʽ,δָʱԭ
+	AVDiscard AdjustDiscard(HWND hWnd, int nVideoWidth, int nVideoHeight, AVDiscard nDiscard, int64_t nNow)
+	{
+		if (hWnd && Update(hWnd, nVideoWidth, nVideoHeight, nNow) == RenderRate_None && nDiscard < AVDISCARD_NONREF)
+			return AVDISCARD_NONREF;
+		return nDiscard;
+	}
+
+	AVDiscard AdjustDiscard(HWND hWnd, int nVideoWidth, int nVideoHeight, AVDiscard nDiscard)
+	{
+		return AdjustDiscard(hWnd, nVideoWidth, nVideoHeight, nDiscard, MonoTimeNs());
+	}
+
+	// һμõʾ֡,߳жȡ
+	RenderRate GetRate()
+	{
+		return (RenderRate)m_nRate;
+	}
+
+	void GetStat(RenderThrottleStat &Stat)
+	{
+		memcpy(&Stat, &m_Stat, sizeof(RenderThrottleStat));
+	}
+
+	void TraceStat(const char *szFunction, UINT nChannel)
+	{
+		DxTraceMsg("%s Channel[%d] Rendered = %d\tReduced = %d\tHidden = %d.\n", szFunction, nChannel, m_Stat.nRendered, m_Stat.nReduced, m_Stat.nHidden);
+	}
+
+	/// @brief ״̬Ƶߴʾ֡
+	static RenderRate CheckWindow(IRenderWindowGeometry *pGeometry, HWND hWnd, int nVideoWidth, int nVideoHeight)
+	{
+		if (!hWnd || !pGeometry->IsShown(hWnd))
+			return RenderRate_None;
+		int nWidth = 0, nHeight = 0;
+		if (!pGeometry->GetClientSize(hWnd, nWidth, nHeight) ||
+			nWidth < _THROTTLE_MIN_SIZE || nHeight < _THROTTLE_MIN_SIZE ||
+			pGeometry->IsOccluded(hWnd))
+			return RenderRate_None;
+		if (nVideoWidth > 0 && nVideoHeight > 0 &&
+			(LONGLONG)nWidth * nHeight * _THROTTLE_SMALL_RATIO < (LONGLONG)nVideoWidth * nVideoHeight)
+			return RenderRate_Reduced;
+		return RenderRate_Full;
+	}
+private:
+	RenderRate CheckWindow(HWND hWnd, int nVideoWidth, int nVideoHeight)
+	{
+		if (m_pGeometry)
+			return CheckWindow(m_pGeometry, hWnd, nVideoWidth, nVideoHeight);
+#ifdef _WIN32
+		CWin32WindowGeometry Geometry;
+		return CheckWindow(&Geometry, hWnd, nVideoWidth, nVideoHeight);
+#else
+		return hWnd ? RenderRate_Full : RenderRate_None;	// ûдϵͳ,ͨSetGeometryָ״̬Դ
+#endif
+	}
+
+	IRenderWindowGeometry	*m_pGeometry;		// ΪNULLʱʹCWin32WindowGeometry
+	HWND				m_hWnd;
+	int64_t				m_nLastCheck;		// һμ鴰ڵʱ,Ϊ0ʾδ
+	int64_t				m_nLastRender;		// ֡ʱһʾʱ,Ϊ0ʾδʾ
+	volatile LONG		m_nRate;
+	RenderThrottleStat	m_Stat;
+};
@@ -0,0 +1,386 @@
+#include "SnapshotService.h"
+#include <stdio.h>
+#include "MonoClock.h"
+#ifdef _WIN32
+#include "FramePool.h"
+#include "SwsContextCache.h"
+#endif
+
+#define SNAPSHOT_JPEG_QSCALE	3		// JPEG,ȡֵ2~31,ԽСԽ
+#define SNAPSHOT_READBACK_SLOTS	4		// ضݴ,ͬʱȴضӲͼ
+#define SNAPSHOT_READBACK_DELAY	20		// ͼύ,Ȳ֡,ύ20GPUɸ
+
+CSnapshotService g_SnapshotService;
+
+#ifdef _WIN32
+CFFmpegSnapshotEncoder::CFFmpegSnapshotEncoder()
+{
+	m_pCodecCtx = NULL;
+	m_pConvFrame = av_frame_alloc();
+}
+
+CFFmpegSnapshotEncoder::~CFFmpegSnapshotEncoder()
+{
+	avcodec_free_context(&m_pCodecCtx);
+	av_frame_free(&m_pConvFrame);
+}
+
+bool CFFmpegSnapshotEncoder::OpenEncoder(SnapshotFormat nFormat, int nWidth, int nHeight)
+{
+	AVCodecID nCodecID = AV_CODEC_ID_MJPEG;
+	AVPixelFormat nPixFmt = AV_PIX_FMT_YUVJ420P;
+	if (nFormat == Snapshot_PNG)
+	{
+		nCodecID = AV_CODEC_ID_PNG;
+		nPixFmt = AV_PIX_FMT_RGB24;
+	}
+	else if (nFormat == Snapshot_BMP)
+	{
+		nCodecID = AV_CODEC_ID_BMP;
+		nPixFmt = AV_PIX_FMT_BGR24;
+	}
+	AVCodecContext *pCtx = m_pCodecCtx;
+	if (pCtx && pCtx->codec_id == nCodecID && pCtx->width == nWidth && pCtx->height == nHeight)
+		return true;
+	// avcodec_free_contextرձͷз
+	avcodec_free_context(&m_pCodecCtx);
+	AVCodec *pCodec = avcodec_find_encoder(nCodecID);
+	if (!pCodec)
+	{
+		DxTraceMsg("%s Can't find the encoder %d.\n", __FUNCTION__, nCodecID);
+		return false;
+	}
+	pCtx = avcodec_alloc_context3(pCodec);
+	if (!pCtx)
+		return false;
+	pCtx->width = nWidth;
+	pCtx->height = nHeight;
+	pCtx->pix_fmt = nPixFmt;
+	pCtx->time_base.num = 1;
+	pCtx->time_base.den = 25;
+	if (nCodecID == AV_CODEC_ID_MJPEG)
+	{
+		pCtx->flags |= AV_CODEC_FLAG_QSCALE;
+		pCtx->global_quality = FF_QP2LAMBDA * SNAPSHOT_JPEG_QSCALE;
+	}
+	int nAvError = avcodec_open2(pCtx, pCodec, NULL);
+	if (nAvError < 0)
+	{
+		char szAvError[256] = { 0 };
+		av_strerror(nAvError, szAvError, 256);
+		DxTraceMsg("%s avcodec_open2 failed:%s.\n", __FUNCTION__, szAvError);
+		avcodec_free_context(&pCtx);
+		return false;
+	}
+	m_pCodecCtx = pCtx;
+	// δѹ32λͼԤ,ָʽ
+	size_t nPacketSize = (size_t)(nWidth * 4 + 64) * nHeight + FF_MIN_BUFFER_SIZE;
+	if (m_vecPacket.size() < nPacketSize)
+		m_vecPacket.resize(nPacketSize);
+	return true;
+}
+
+bool CFFmpegSnapshotEncoder::Encode(AVFrame *pFrame, SnapshotFormat nFormat, const uint8_t *&pData, int &nSize)
+{
+	if (!OpenEncoder(nFormat, pFrame->width, pFrame->height))
+		return false;
+	AVCodecContext *pCtx = m_pCodecCtx;
+	// YUV420PYUVJ420Pڴ沼ͬ,ֱӱΪJPEG,תΪظʽ
+	AVFrame *pEncodeFrame = pFrame;
+	if (!(pCtx->pix_fmt == AV_PIX_FMT_YUVJ420P && (pFrame->format == AV_PIX_FMT_YUV420P || pFrame->format == AV_PIX_FMT_YUVJ420P)))
+	{
+		if (!g_FramePool.GetFrameBuffer(m_pConvFrame, pCtx->pix_fmt, pFrame->width, pFrame->height, MemTag_Convert))
+			return false;
+		SwsContextKey Key = { pFrame->width, pFrame->height, (AVPixelFormat)pFrame->format,
+							  pFrame->width, pFrame->height, pCtx->pix_fmt, SWS_POINT };
+		SwsContext *pSwsCtx = g_SwsContextCache.Acquire(Key);
+		if (!pSwsCtx)
+			return false;
+		sws_scale(pSwsCtx, (const byte * const *)pFrame->data, pFrame->linesize, 0, pFrame->height, m_pConvFrame->data, m_pConvFrame->linesize);
+		g_SwsContextCache.Release(Key, pSwsCtx);
+		pEncodeFrame = m_pConvFrame;
+	}
+	pEncodeFrame->quality = pCtx->global_quality;
+
+	AVPacket Packet;
+	av_init_packet(&Packet);
+	Packet.data = &m_vecPacket[0];
+	Packet.size = (int)m_vecPacket.size();
+	int nGotPacket = 0;
+	int nAvError = avcodec_encode_video2(pCtx, &Packet, pEncodeFrame, &nGotPacket);
+	av_frame_unref(m_pConvFrame);
+	if (nAvError < 0 || !nGotPacket)
+	{
+		DxTraceMsg("%s avcodec_encode_video2 failed,error = %d.\n", __FUNCTION__, nAvError);
+		return false;
+	}
+	pData = Packet.data;
+	nSize = Packet.size;
+	return true;
+}
+
+static ISnapshotEncoder *CreateFFmpegSnapshotEncoder(void *pUserPtr)
+{
+	return new CFFmpegSnapshotEncoder();
+}
+#endif
+
+CSnapshotService::CSnapshotService()
+{
+	m_nPendingHead = 0;
+	m_nPendingCount = 0;
+	m_hSemPending = NULL;
+	m_hEventExit = NULL;
+	m_pReadback = NULL;
+	m_nStartTime = 0;
+	m_bStarted = false;
+	m_bStopping = false;
+	m_nSubmitting = 0;
+	ZeroMemory(&m_Stat, sizeof(SnapshotStat));
+	InitializeCriticalSection(&m_csQueue);
+}
+
+CSnapshotService::~CSnapshotService()
+{
+	Stop();
+	DeleteCriticalSection(&m_csQueue);
+}
+
+bool CSnapshotService::Start(int nWorkers, int nQueueSize, SnapshotEncoderFactory pFactory, void *pUserPtr)
+{
+	CAutoLock lock(&m_csQueue);
+	if (m_bStarted)
+		return true;
+	if (nWorkers < 1 || nQueueSize < 1)
+		return false;
+#ifdef _WIN32
+	if (!pFactory)
+		pFactory = CreateFFmpegSnapshotEncoder;
+#endif
+	if (!pFactory)
+	{
+		DxTraceMsg("%s No snapshot encoder on this platform.\n", __FUNCTION__);
+		return false;
+	}
+	SnapshotRequest Request;
+	ZeroMemory(&Request, sizeof(SnapshotRequest));
+	m_vecRequest.assign(nQueueSize, Request);
+	m_vecFreeSlot.clear();
+	for (int i = nQueueSize - 1; i >= 0; i--)
+	{
+		m_vecRequest[i].pFrame = av_frame_alloc();
+		m_vecFreeSlot.push_back(i);
+	}
+	m_vecPending.assign(nQueueSize, -1);
+	m_nPendingHead = 0;
+	m_nPendingCount = 0;
+	m_hSemPending = CreateSemaphore(NULL, 0, nQueueSize, NULL);
+	m_hEventExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+	for (int i = 0; i < nWorkers; i++)
+	{
+		SnapshotWorker *pWorker = new SnapshotWorker;
+		pWorker->pService = this;
+		pWorker->pEncoder = pFactory(pUserPtr);
+		pWorker->hThread = (HANDLE)_beginthreadex(nullptr, 0, SnapshotThread, pWorker, 0, nullptr);
+		m_vecWorker.push_back(pWorker);
+	}
+#ifdef _WIN32
+	m_pReadback = new CReadbackRing();
+	if (!m_pReadback->Create(NULL, SNAPSHOT_READBACK_SLOTS, 1, SNAPSHOT_READBACK_DELAY, OnReadbackImage, this))
+	{
+		DxTraceMsg("%s Failed to create the readback ring,snapshots of hardware frames are rejected.\n", __FUNCTION__);
+		delete m_pReadback;
+		m_pReadback = NULL;
+	}
+#endif
+	m_nStartTime = MonoTimeNs();
+	m_bStarted = true;
+	return true;
+}
+
+void CSnapshotService::Stop()
+{
+	{
+		CAutoLock lock(&m_csQueue);
+		if (!m_bStarted || m_bStopping)
+			return;
+		m_bStopping = true;
+	}
+	// ˺Submitȡ,ȴȡ۵Submitдϲ,ǿܻʹۺͻض
+	while (m_nSubmitting)
+		Sleep(1);
+	if (m_pReadback)
+	{// ضɵĽͼԻŶ,ڹ߳˳ͷ֮ǰض
+		m_pReadback->Destroy();
+		m_pReadback->TraceStat();
+		delete m_pReadback;
+		m_pReadback = NULL;
+	}
+	SetEvent(m_hEventExit);
+	for (size_t i = 0; i < m_vecWorker.size(); i++)
+	{
+		SnapshotWorker *pWorker = m_vecWorker[i];
+		if (pWorker->hThread)
+		{
+			WaitForSingleObject(pWorker->hThread, INFINITE);
+			CloseHandle(pWorker->hThread);
+		}
+		delete pWorker->pEncoder;
+		delete pWorker;
+	}
+	m_vecWorker.clear();
+	CAutoLock lock(&m_csQueue);
+	for (size_t i = 0; i < m_vecRequest.size(); i++)
+		av_frame_free(&m_vecRequest[i].pFrame);
+	m_vecRequest.clear();
+	m_vecFreeSlot.clear();
+	m_vecPending.clear();
+	m_nPendingCount = 0;
+	CloseHandle(m_hSemPending);
+	m_hSemPending = NULL;
+	CloseHandle(m_hEventExit);
+	m_hEventExit = NULL;
+	m_bStarted = false;
+	m_bStopping = false;
+}
+
+bool CSnapshotService::Submit(AVFrame *pAvFrame, LPCTSTR szPath, SnapshotFormat nFormat)
+{
+	if (!pAvFrame || !szPath || !Start())
+		return false;
+	int nSlot = -1;
+	{
+		CAutoLock lock(&m_csQueue);
+		if (!m_bStarted || m_bStopping)
+			return false;
+		m_Stat.nSubmitted++;
+		if (m_vecFreeSlot.empty())
+		{
+			m_Stat.nRejected++;
+			return false;
+		}
+		nSlot = m_vecFreeSlot.back();
+		m_vecFreeSlot.pop_back();
+		InterlockedIncrement(&m_nSubmitting);
+	}
+	bool bSucceed = FillRequest(nSlot, pAvFrame, szPath, nFormat);
+	InterlockedDecrement(&m_nSubmitting);
+	return bSucceed;
+}
+
+// Ѵӿбȡ,дڼΪ̶߳ռ;Stopȴغͷ
+bool CSnapshotService::FillRequest(int nSlot, AVFrame *pAvFrame, LPCTSTR szPath, SnapshotFormat nFormat)
+{
+	SnapshotRequest &Request = m_vecRequest[nSlot];
+	Request.nFormat = nFormat;
+	bool bSucceed = (_tcscpy_s(Request.szPath, MAX_PATH, szPath) == 0);
+	if (bSucceed && pAvFrame->format == AV_PIX_FMT_DXVA2_VLD)
+	{// ضɺOnReadbackImageŶ,۴˺ض߳
+		if (m_pReadback && m_pReadback->Submit(pAvFrame->data[3], pAvFrame->width, pAvFrame->height, pAvFrame->pts, (void *)(INT_PTR)nSlot))
+			return true;
+		bSucceed = false;
+	}
+	else if (bSucceed)
+		bSucceed = (av_frame_ref(Request.pFrame, pAvFrame) == 0);
+	CAutoLock lock(&m_csQueue);
+	if (!bSucceed)
+	{
+		av_frame_unref(Request.pFrame);
+		m_vecFreeSlot.push_back(nSlot);
+		m_Stat.nRejected++;
+		return false;
+	}
+	QueueRequest(nSlot);
+	return true;
+}
+
+// дõ۷,ڳm_csQueueʱ
+void CSnapshotService::QueueRequest(int nSlot)
+{
+	m_vecPending[(m_nPendingHead + m_nPendingCount) % m_vecPending.size()] = nSlot;
+	m_nPendingCount++;
+	ReleaseSemaphore(m_hSemPending, 1, NULL);
+}
+
+#ifdef _WIN32
+// Ӳ֡ض,ڻض߳תΪYUV420PŶ
+void CALLBACK CSnapshotService::OnReadbackImage(const ReadbackImage &Image, void *pUserPtr)
+{
+	CSnapshotService *pThis = (CSnapshotService *)pUserPtr;
+	int nSlot = (int)(INT_PTR)Image.pTag;
+	SnapshotRequest &Request = pThis->m_vecRequest[nSlot];
+	bool bSucceed = Image.pBits && g_FramePool.GetFrameBuffer(Request.pFrame, AV_PIX_FMT_YUV420P, Image.nWidth, Image.nHeight);
+	if (bSucceed)
+	{
+		CopyReadbackImage(Request.pFrame->data, Request.pFrame->linesize, Image);
+		Request.pFrame->pts = Image.nPts;
+	}
+	CAutoLock lock(&pThis->m_csQueue);
+	if (!bSucceed)
+	{
+		av_frame_unref(Request.pFrame);
+		pThis->m_vecFreeSlot.push_back(nSlot);
+		pThis->m_Stat.nFailed++;
+		return;
+	}
+	pThis->QueueRequest(nSlot);
+}
+#endif
+
+bool CSnapshotService::SaveSnapshot(SnapshotWorker *pWorker, SnapshotRequest *pRequest)
+{
+	const uint8_t *pData = NULL;
+	int nSize = 0;
+	if (!pWorker->pEncoder || !pWorker->pEncoder->Encode(pRequest->pFrame, pRequest->nFormat, pData, nSize))
+		return false;
+	FILE *fp = NULL;
+	if (_tfopen_s(&fp, pRequest->szPath, _T("wb")) != 0 || !fp)
+	{
+		DxTraceMsg("%s Failed to open the snapshot file.\n", __FUNCTION__);
+		return false;
+	}
+	bool bSucceed = (fwrite(pData, 1, nSize, fp) == (size_t)nSize);
+	fclose(fp);
+	return bSucceed;
+}
+
+UINT __stdcall CSnapshotService::SnapshotThread(void *p)
+{
+	SnapshotWorker *pWorker = (SnapshotWorker *)p;
+	CSnapshotService *pThis = pWorker->pService;
+	HANDLE hEvents[2] = { pThis->m_hEventExit, pThis->m_hSemPending };
+	while (WaitForMultipleObjects(2, hEvents, FALSE, INFINITE) == WAIT_OBJECT_0 + 1)
+	{
+		int nSlot = -1;
+		{
+			CAutoLock lock(&pThis->m_csQueue);
+			nSlot = pThis->m_vecPending[pThis->m_nPendingHead];
+			pThis->m_nPendingHead = (pThis->m_nPendingHead + 1) % pThis->m_vecPending.size();
+			pThis->m_nPendingCount--;
+		}
+		SnapshotRequest *pRequest = &pThis->m_vecRequest[nSlot];
+		int64_t nT1 = MonoTimeNs();
+		bool bSaved = pThis->SaveSnapshot(pWorker, pRequest);
+		int64_t nT2 = MonoTimeNs();
+		av_frame_unref(pRequest->pFrame);
+		CAutoLock lock(&pThis->m_csQueue);
+		if (bSaved)
+			pThis->m_Stat.nSaved++;
+		else
+			pThis->m_Stat.nFailed++;
+		pThis->m_Stat.dfEncodeTime += MonoNsToSeconds(nT2 - nT1);
+		pThis->m_vecFreeSlot.push_back(nSlot);
+	}
+	return 0;
+}
+
+void CSnapshotService::TraceStat()
+{
+	SnapshotStat Stat;
+	GetStat(Stat);
+	double dfSpan = m_bStarted ? MonoNsToSeconds(MonoTimeNs() - m_nStartTime) : 0.0f;
+	DxTraceMsg("%s Submitted = %d\tSaved = %d\tRejected = %d\tFailed = %d\tAvgEncode = %.3fms\tSnapshots/s = %.2f.\n", __FUNCTION__,
+				Stat.nSubmitted, Stat.nSaved, Stat.nRejected, Stat.nFailed,
+				(Stat.nSaved + Stat.nFailed) ? Stat.dfEncodeTime * 1000 / (Stat.nSaved + Stat.nFailed) : 0.0f,
+				dfSpan > 0.0f ? Stat.nSaved / dfSpan : 0.0f);
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "Win32Port.h"
+#ifdef _WIN32
+#include <tchar.h>
+#endif
+#include <vector>
+#include "AutoLock.h"
+#include "DxTrace.h"
+#include "ReadbackRing.h"
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define __STDC_CONSTANT_MACROS
+#define FF_API_PIX_FMT 0
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+#ifdef _WIN32
+#include "libavcodec/avcodec.h"
+#endif
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+
+using namespace std;
+
+enum SnapshotFormat
+{
+	Snapshot_JPEG = 0,
+	Snapshot_PNG,
+	Snapshot_BMP,
+};
+
+struct SnapshotRequest
+{
+	AVFrame			*pFrame;			// ͼ,֡Ϊ,Ӳ֡ΪضõYUV420Pͼ
+	SnapshotFormat	nFormat;
+	TCHAR			szPath[MAX_PATH];
+};
+
+struct SnapshotStat
+{
+	LONG		nSubmitted;		// ύĽͼ
+	LONG		nSaved;			// ѱĽͼ
+	LONG		nRejected;		// ͼʽֶ֧ܾ
+	LONG		nFailed;		// дļʧܵ
+	double		dfEncodeTime;	// תͱۼƺʱ,λ
+};
+
+/// @brief ͼ
+/// @remark ÿ߳Լı,ֻڸ߳е;ʵʱΪFFMPEGCFFmpegSnapshotEncoder,ʱԻʵ
+class ISnapshotEncoder
+{
+public:
+	virtual ~ISnapshotEncoder() {}
+	/// @brief ͼΪnFormatʽ
+	/// @param pData	ر,һεEncode֮ǰЧ
+	virtual bool Encode(AVFrame *pFrame, SnapshotFormat nFormat, const uint8_t *&pData, int &nSize) = 0;
+};
+
+// Ϊÿ̴߳,pUserPtrΪStartʱĲ
+typedef ISnapshotEncoder *(*SnapshotEncoderFactory)(void *pUserPtr);
+
+#ifdef _WIN32
+// FFMPEGMJPEGPNGBMP,ֻڱʽͼߴ仯ʱؽ
+class CFFmpegSnapshotEncoder : public ISnapshotEncoder
+{
+public:
+	CFFmpegSnapshotEncoder();
+	virtual ~CFFmpegSnapshotEncoder();
+	virtual bool Encode(AVFrame *pFrame, SnapshotFormat nFormat, const uint8_t *&pData, int &nSize);
+private:
+	bool OpenEncoder(SnapshotFormat nFormat, int nWidth, int nHeight);
+	AVCodecContext		*m_pCodecCtx;
+	AVFrame				*m_pConvFrame;	// תΪظʽͼ,ȡg_FramePool
+	vector<uint8_t>		m_vecPacket;	// 
+};
+#endif
+
+/// @brief ̼첽ͼ
+/// @remark ͼ̶ȵк,ɹ̶Ĺ̴߳ӽͼֱӱΪJPEGPNGBMPļ,
+/// Ϊÿνͼ̺߳ϵͳڴ,ҲD3DX;ۡתõͼͱԤȷ䲢ظʹ,
+/// ʱµ󱻾ܾ,ͨͬʱͼҲʹ̺߳ڴ
+/// Ӳ֡ض첽,ύͼȾ̲߳ȴGPU
+class CSnapshotService
+{
+public:
+	CSnapshotService();
+	~CSnapshotService();
+
+	/// @brief ߳,SubmitڷδʱĬϲԶ
+	/// @param nWorkers		߳
+	/// @param nQueueSize	еĳ
+	/// @param pFactory		Ϊÿ̴߳,WindowsΪNULLʱʹCFFmpegSnapshotEncoder
+	bool Start(int nWorkers = 2, int nQueueSize = 64, SnapshotEncoderFactory pFactory = NULL, void *pUserPtr = NULL);
+
+	// ȴеSubmitغ߳,δ󱻶
+	void Stop();
+
+	/// @brief ύһͼ
+	/// @remark ֻ֡,Ӳ֡GPUϸƵضݴ,ɻض̶߳Ŷ
+	/// @return ͼʽ֧ʱfalse
+	bool Submit(AVFrame *pAvFrame, LPCTSTR szPath, SnapshotFormat nFormat = Snapshot_JPEG);
+
+	void GetStat(SnapshotStat &Stat)
+	{
+		CAutoLock lock(&m_csQueue);
+		memcpy(&Stat, &m_Stat, sizeof(SnapshotStat));
+	}
+	void TraceStat();
+private:
+	struct SnapshotWorker
+	{
+		CSnapshotService	*pService;
+		HANDLE				hThread;
+		ISnapshotEncoder	*pEncoder;
+	};
+	bool FillRequest(int nSlot, AVFrame *pAvFrame, LPCTSTR szPath, SnapshotFormat nFormat);
+	void QueueRequest(int nSlot);
+	static void CALLBACK OnReadbackImage(const ReadbackImage &Image, void *pUserPtr);
+	bool SaveSnapshot(SnapshotWorker *pWorker, SnapshotRequest *pRequest);
+	static UINT __stdcall SnapshotThread(void *p);
+
+	vector<SnapshotRequest>	m_vecRequest;	// Ԥȷ
+	vector<int>				m_vecFreeSlot;	// е
+	vector<int>				m_vecPending;	// Ļζ
+	int						m_nPendingHead;
+	int						m_nPendingCount;
+	vector<SnapshotWorker *> m_vecWorker;
+	CReadbackRing			*m_pReadback;	// Ӳ֡Ļض,۵ΪpTag
+	CRITICAL_SECTION		m_csQueue;
+	HANDLE					m_hSemPending;
+	HANDLE					m_hEventExit;
+	SnapshotStat			m_Stat;
+	int64_t					m_nStartTime;
+	volatile bool			m_bStarted;
+	volatile bool			m_bStopping;	// Stopڽ,ٽµ,m_csQueue
+	volatile LONG			m_nSubmitting;	// ȡۡδصSubmit,Stopͷ
+};
+
+extern CSnapshotService g_SnapshotService;
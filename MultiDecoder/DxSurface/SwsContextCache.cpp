@@ -0,0 +1,3 @@
+#include "SwsContextCache.h"
+
+CSwsContextCache	g_SwsContextCache;
@@ -0,0 +1,252 @@
+#pragma once
+#include "Win32Port.h"
+#include <map>
+#include <list>
+#include <vector>
+#include "AutoLock.h"
+#include "AdaptiveLock.h"
+#include "DxTrace.h"
+#include "MonoClock.h"
+
+#pragma warning(push)
+#pragma warning(disable:4244)
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define __STDC_CONSTANT_MACROS
+#define FF_API_PIX_FMT 0
+#include "libswscale/swscale.h"
+#include "libavutil/pixfmt.h"
+#ifdef __cplusplus
+}
+#endif
+#pragma warning(pop)
+
+using namespace std;
+
+// תĵļֵ,ԴĿĳߴ硢ظʽԼ㷨ȫһµתܹͬһSwsContext
+struct SwsContextKey
+{
+	int				nSrcWidth;
+	int				nSrcHeight;
+	AVPixelFormat	nSrcFormat;
+	int				nDstWidth;
+	int				nDstHeight;
+	AVPixelFormat	nDstFormat;
+	int				nFlags;
+
+	bool operator < (const SwsContextKey &Key) const
+	{
+		if (nSrcWidth != Key.nSrcWidth)
+			return nSrcWidth < Key.nSrcWidth;
+		if (nSrcHeight != Key.nSrcHeight)
+			return nSrcHeight < Key.nSrcHeight;
+		if (nSrcFormat != Key.nSrcFormat)
+			return nSrcFormat < Key.nSrcFormat;
+		if (nDstWidth != Key.nDstWidth)
+			return nDstWidth < Key.nDstWidth;
+		if (nDstHeight != Key.nDstHeight)
+			return nDstHeight < Key.nDstHeight;
+		if (nDstFormat != Key.nDstFormat)
+			return nDstFormat < Key.nDstFormat;
+		return nFlags < Key.nFlags;
+	}
+};
+
+struct SwsCacheStat
+{
+	LONG		nContexts;		// Ѵת
+	LONG		nIdleContexts;	// ǰеת
+	LONG		nHits;			// ֱӴӻȡĵĴ
+	LONG		nMisses;		// Ҫ½ĵĴ
+	LONG		nEvicted;		// 򳬳ÿֵĿгʱͷŵ
+	double		dfSetupTime;	// ĵۼƺʱ,λ
+};
+
+#define SWSCACHE_MAX_IDLE_PER_KEY	8		// ÿֵĬౣĿ
+#define SWSCACHE_IDLE_TIMEOUT_MS	30000	// Ĭϵĳʱ,ʱδüͷ
+#define SWSCACHE_TRIM_INTERVAL_MS	1000	// 黹ʱгʱС
+
+// ̼SwsContext
+// SwsContextܱ߳ͬʱʹ,ÿתҪAcquireһ,תɺRelease黹,
+// ڼΪ̶߳ռ;·ͬͬһ,ֻͬʱת߳й,ͨ޹
+// лֱʺɼֵĲٱ,гʱͷ;˲Ĳ߷֮,ÿֵౣm_nMaxIdlePerKey
+class CSwsContextCache
+{
+public:
+	CSwsContextCache()
+	{
+		ZeroMemory(&m_Stat, sizeof(SwsCacheStat));
+		m_nMaxIdlePerKey = SWSCACHE_MAX_IDLE_PER_KEY;
+		m_nIdleTimeout = SWSCACHE_IDLE_TIMEOUT_MS * MONO_NS_PER_MS;
+		m_nLastTrimTime = MonoTimeNs();
+	}
+	~CSwsContextCache()
+	{
+		Clear();
+	}
+
+	// һKeyƥת,ûпʱ½һ
+	SwsContext *Acquire(const SwsContextKey &Key)
+	{
+		{
+			MUTEX_LOCK(m_csCache);
+			auto itFind = m_mapIdleContext.find(Key);
+			if (itFind != m_mapIdleContext.end() && itFind->second.size())
+			{
+				SwsContext *pContext = itFind->second.front().pContext;
+				itFind->second.pop_front();
+				m_Stat.nIdleContexts--;
+				m_Stat.nHits++;
+				return pContext;
+			}
+		}
+		// ⴴ,sws_getContextͨ
+		int64_t nT1 = MonoTimeNs();
+		SwsContext *pContext = sws_getContext(Key.nSrcWidth,
+											Key.nSrcHeight,
+											Key.nSrcFormat,
+											Key.nDstWidth,
+											Key.nDstHeight,
+											Key.nDstFormat,
+											Key.nFlags,
+											NULL,
+											NULL,
+											NULL);
+		int64_t nT2 = MonoTimeNs();
+		if (!pContext)
+		{
+			DxTraceMsg("%s sws_getContext failed(%dx%d fmt %d => %dx%d fmt %d).\n", __FUNCTION__,
+						Key.nSrcWidth, Key.nSrcHeight, Key.nSrcFormat,
+						Key.nDstWidth, Key.nDstHeight, Key.nDstFormat);
+			return NULL;
+		}
+		MUTEX_LOCK(m_csCache);
+		m_Stat.nContexts++;
+		m_Stat.nMisses++;
+		m_Stat.dfSetupTime += MonoNsToSeconds(nT2 - nT1);
+		return pContext;
+	}
+
+	// 黹Acquireõ,黹ȱٴ,Ա㾡CPU
+	// üֵĿѴʱֱͷ;ϴμ鳬SWSCACHE_TRIM_INTERVAL_MSʱ˳ͷſгʱ
+	void Release(const SwsContextKey &Key, SwsContext *pContext)
+	{
+		if (!pContext)
+			return;
+		vector<SwsContext *> vecFree;
+		int64_t nNow = MonoTimeNs();
+		{
+			MUTEX_LOCK(m_csCache);
+			list<IdleContext> &listIdle = m_mapIdleContext[Key];
+			if ((int)listIdle.size() >= m_nMaxIdlePerKey)
+			{
+				vecFree.push_back(pContext);
+				m_Stat.nContexts--;
+				m_Stat.nEvicted++;
+			}
+			else
+			{
+				IdleContext Idle = { pContext, nNow };
+				listIdle.push_front(Idle);
+				m_Stat.nIdleContexts++;
+			}
+			if (nNow - m_nLastTrimTime >= SWSCACHE_TRIM_INTERVAL_MS * MONO_NS_PER_MS)
+				CollectExpired(nNow, vecFree);
+		}
+		// sws_freeContextͷ˲л,
+		for (size_t i = 0; i < vecFree.size(); i++)
+			sws_freeContext(vecFree[i]);
+	}
+
+	/// @brief ÿĵı
+	/// @param nMaxIdlePerKey	ÿֵౣĿ,Ϊ0ʱ黹ͷ
+	/// @param nIdleTimeoutMs	гʱıͷ
+	void SetIdlePolicy(int nMaxIdlePerKey, int nIdleTimeoutMs)
+	{
+		MUTEX_LOCK(m_csCache);
+		m_nMaxIdlePerKey = nMaxIdlePerKey;
+		m_nIdleTimeout = nIdleTimeoutMs * MONO_NS_PER_MS;
+	}
+
+	// ͷпгʱ,ͷŵ
+	int Trim()
+	{
+		vector<SwsContext *> vecFree;
+		{
+			MUTEX_LOCK(m_csCache);
+			CollectExpired(MonoTimeNs(), vecFree);
+		}
+		for (size_t i = 0; i < vecFree.size(); i++)
+			sws_freeContext(vecFree[i]);
+		return (int)vecFree.size();
+	}
+
+	// ͷпеת
+	void Clear()
+	{
+		MUTEX_LOCK(m_csCache);
+		for (auto it = m_mapIdleContext.begin(); it != m_mapIdleContext.end(); it++)
+		{
+			for (auto itCtx = it->second.begin(); itCtx != it->second.end(); itCtx++)
+			{
+				sws_freeContext(itCtx->pContext);
+				m_Stat.nContexts--;
+			}
+		}
+		m_mapIdleContext.clear();
+		m_Stat.nIdleContexts = 0;
+	}
+
+	void GetStat(SwsCacheStat &Stat)
+	{
+		MUTEX_LOCK(m_csCache);
+		memcpy(&Stat, &m_Stat, sizeof(SwsCacheStat));
+	}
+
+	void TraceStat()
+	{
+		SwsCacheStat Stat;
+		GetStat(Stat);
+		DxTraceMsg("%s Contexts = %d(Idle %d)\tHits = %d\tMisses = %d\tEvicted = %d\tSetupTime = %.3fms.\n", __FUNCTION__,
+					Stat.nContexts, Stat.nIdleContexts, Stat.nHits, Stat.nMisses, Stat.nEvicted, Stat.dfSetupTime * 1000);
+	}
+private:
+	struct IdleContext
+	{
+		SwsContext	*pContext;
+		int64_t		nReleaseTime;	// 黹ʱ,MonoTimeNs
+	};
+	// ÿֵĿб黹ʱµ,ʱĶбβ
+	// ڳm_csCacheʱ,ȡɵͷ
+	void CollectExpired(int64_t nNow, vector<SwsContext *> &vecFree)
+	{
+		m_nLastTrimTime = nNow;
+		for (auto it = m_mapIdleContext.begin(); it != m_mapIdleContext.end();)
+		{
+			list<IdleContext> &listIdle = it->second;
+			while (!listIdle.empty() && nNow - listIdle.back().nReleaseTime >= m_nIdleTimeout)
+			{
+				vecFree.push_back(listIdle.back().pContext);
+				listIdle.pop_back();
+				m_Stat.nIdleContexts--;
+				m_Stat.nContexts--;
+				m_Stat.nEvicted++;
+			}
+			if (listIdle.empty())
+				it = m_mapIdleContext.erase(it);
+			else
+				it++;
+		}
+	}
+
+	typedef map<SwsContextKey, list<IdleContext> > SwsContextMap;
+	CSpinMutex				m_csCache;
+	SwsContextMap			m_mapIdleContext;
+	SwsCacheStat			m_Stat;
+	int						m_nMaxIdlePerKey;
+	int64_t					m_nIdleTimeout;		// λ
+	int64_t					m_nLastTrimTime;
+};
+
+extern CSwsContextCache g_SwsContextCache;
@@ -0,0 +1,586 @@
+#include "ThreadPlacement.h"
+#ifdef _WIN32
+#include <tchar.h>
+#else
+#include <stdlib.h>
+#include <dirent.h>
+#include <algorithm>
+#include <string>
+#include <set>
+#include <map>
+#endif
+
+CThreadPlacement g_ThreadPlacement;
+
+#ifdef _WIN32
+typedef BOOL (WINAPI *pGetLogicalProcessorInformation)(PSYSTEM_LOGICAL_PROCESSOR_INFORMATION Buffer, PDWORD ReturnedLength);
+// ΪWindows 7Ĵ麯,XP²,LoadTopologyж̬ȡ,˺ֻ
+typedef BOOL (WINAPI *pGetLogicalProcessorInformationEx)(LOGICAL_PROCESSOR_RELATIONSHIP RelationshipType, PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX Buffer, PDWORD ReturnedLength);
+typedef BOOL (WINAPI *pGetThreadGroupAffinity)(HANDLE hThread, PGROUP_AFFINITY GroupAffinity);
+typedef BOOL (WINAPI *pSetThreadGroupAffinity)(HANDLE hThread, const GROUP_AFFINITY *GroupAffinity, PGROUP_AFFINITY PreviousGroupAffinity);
+typedef BOOL (WINAPI *pSetThreadIdealProcessorEx)(HANDLE hThread, PPROCESSOR_NUMBER lpIdealProcessor, PPROCESSOR_NUMBER lpPreviousIdealProcessor);
+
+static pSetThreadGroupAffinity		s_pSetThreadGroupAffinity = NULL;
+static pSetThreadIdealProcessorEx	s_pSetThreadIdealProcessorEx = NULL;
+#endif
+
+static int CountBits(DWORD_PTR nMask)
+{
+	int nCount = 0;
+	for (; nMask; nMask &= nMask - 1)
+		nCount++;
+	return nCount;
+}
+
+static int LowestBit(DWORD_PTR nMask)
+{
+	for (int i = 0; i < sizeof(DWORD_PTR) * 8; i++)
+	{
+		if (nMask & ((DWORD_PTR)1 << i))
+			return i;
+	}
+	return -1;
+}
+
+#ifndef _WIN32
+#define PLACEMENT_GROUP_SIZE	((int)(sizeof(DWORD_PTR) * 8))	// ÿ߼
+
+// ȡsysfsļĵһ,ȥβĻ
+static bool ReadSysfsLine(const string &strPath, string &strLine)
+{
+	FILE *fp = fopen(strPath.c_str(), "r");
+	if (!fp)
+		return false;
+	char szLine[4096] = { 0 };
+	bool bRead = fgets(szLine, sizeof(szLine), fp) != NULL;
+	fclose(fp);
+	if (!bRead)
+		return false;
+	strLine = szLine;
+	while (!strLine.empty() && (strLine[strLine.size() - 1] == '\n' || strLine[strLine.size() - 1] == '\r'))
+		strLine.erase(strLine.size() - 1);
+	return true;
+}
+
+// "0-3,8,10-11"ʽ߼б
+static bool ParseCpuList(const string &strList, vector<int> &vecCpu)
+{
+	vecCpu.clear();
+	const char *p = strList.c_str();
+	while (*p)
+	{
+		char *pEnd = NULL;
+		long nFirst = strtol(p, &pEnd, 10);
+		if (pEnd == p || nFirst < 0)
+			return false;
+		long nLast = nFirst;
+		p = pEnd;
+		if (*p == '-')
+		{
+			nLast = strtol(p + 1, &pEnd, 10);
+			if (pEnd == p + 1 || nLast < nFirst)
+				return false;
+			p = pEnd;
+		}
+		for (long i = nFirst; i <= nLast; i++)
+			vecCpu.push_back((int)i);
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return false;
+	}
+	return true;
+}
+
+// ߼бпõĴתΪ,ÿпôһ
+static void AddCpuMasks(const vector<int> &vecCpu, const vector<bool> &vecUsable, vector<PlacementMask> &vecMask)
+{
+	map<int, DWORD_PTR> mapGroup;
+	for (size_t i = 0; i < vecCpu.size(); i++)
+	{
+		int nCpu = vecCpu[i];
+		if (nCpu < (int)vecUsable.size() && vecUsable[nCpu])
+			mapGroup[nCpu / PLACEMENT_GROUP_SIZE] |= (DWORD_PTR)1 << (nCpu % PLACEMENT_GROUP_SIZE);
+	}
+	for (auto it = mapGroup.begin(); it != mapGroup.end(); it++)
+	{
+		PlacementMask Mask = { (WORD)it->first, it->second };
+		vecMask.push_back(Mask);
+	}
+}
+
+// ߼ڵNUMAڵ,cpuNĿ¼ΪnodeM,ûʱ-1
+static int GetSysfsCpuNode(const string &strCpuPath)
+{
+	DIR *pDir = opendir(strCpuPath.c_str());
+	if (!pDir)
+		return -1;
+	int nNode = -1;
+	while (struct dirent *pEntry = readdir(pDir))
+	{
+		int nValue = -1;
+		if (strncmp(pEntry->d_name, "node", 4) == 0 && sscanf(pEntry->d_name + 4, "%d", &nValue) == 1 && nValue >= 0)
+		{
+			nNode = nValue;
+			break;
+		}
+	}
+	closedir(pDir);
+	return nNode;
+}
+
+// ȡߵ߼ġL3NUMAڵ,ͬһĻ򻺴ĸͬб,бȥ
+static bool ReadSysfsTopology(const char *szCpuPath, bool bProcessAffinity, vector<PlacementMask> &vecCore, vector<PlacementMask> &vecCache, vector<PlacementMask> &vecNode)
+{
+	string strRoot = szCpuPath;
+	string strOnline;
+	vector<int> vecOnline;
+	if (!ReadSysfsLine(strRoot + "/online", strOnline) || !ParseCpuList(strOnline, vecOnline) || vecOnline.empty())
+	{
+		DxTraceWarn("%s Failed to read %s/online.\n", __FUNCTION__, szCpuPath);
+		return false;
+	}
+	int nMaxCpu = 0;
+	for (size_t i = 0; i < vecOnline.size(); i++)
+		nMaxCpu = max(nMaxCpu, vecOnline[i]);
+	vector<bool> vecUsable(nMaxCpu + 1, false);
+	cpu_set_t ProcessSet;
+	CPU_ZERO(&ProcessSet);
+	if (bProcessAffinity && sched_getaffinity(0, sizeof(cpu_set_t), &ProcessSet) != 0)
+		bProcessAffinity = false;
+	for (size_t i = 0; i < vecOnline.size(); i++)
+	{
+		int nCpu = vecOnline[i];
+		vecUsable[nCpu] = !bProcessAffinity || (nCpu < CPU_SETSIZE && CPU_ISSET(nCpu, &ProcessSet));
+	}
+
+	set<string> setCore;
+	set<string> setCache;
+	map<int, vector<int> > mapNode;
+	for (size_t i = 0; i < vecOnline.size(); i++)
+	{
+		int nCpu = vecOnline[i];
+		if (!vecUsable[nCpu])
+			continue;
+		char szCpu[32];
+		_snprintf(szCpu, sizeof(szCpu), "/cpu%d", nCpu);
+		string strCpuPath = strRoot + szCpu;
+		// µںΪcore_cpus_list,ϾɵΪthread_siblings_list,ûʱÿ߼Ϊһ
+		string strList;
+		if (!ReadSysfsLine(strCpuPath + "/topology/core_cpus_list", strList) &&
+			!ReadSysfsLine(strCpuPath + "/topology/thread_siblings_list", strList))
+			strList = szCpu + 4;
+		setCore.insert(strList);
+		for (int nIndex = 0;; nIndex++)
+		{
+			char szIndex[32];
+			_snprintf(szIndex, sizeof(szIndex), "/cache/index%d/", nIndex);
+			string strLevel, strType;
+			if (!ReadSysfsLine(strCpuPath + szIndex + "level", strLevel))
+				break;
+			ReadSysfsLine(strCpuPath + szIndex + "type", strType);
+			if (atoi(strLevel.c_str()) == 3 && (strType == "Unified" || strType == "Data") &&
+				ReadSysfsLine(strCpuPath + szIndex + "shared_cpu_list", strList))
+				setCache.insert(strList);
+		}
+		int nNode = GetSysfsCpuNode(strCpuPath);
+		if (nNode >= 0)
+			mapNode[nNode].push_back(nCpu);
+	}
+	vector<int> vecCpu;
+	for (auto it = setCore.begin(); it != setCore.end(); it++)
+	{
+		if (ParseCpuList(*it, vecCpu))
+			AddCpuMasks(vecCpu, vecUsable, vecCore);
+	}
+	for (auto it = setCache.begin(); it != setCache.end(); it++)
+	{
+		if (ParseCpuList(*it, vecCpu))
+			AddCpuMasks(vecCpu, vecUsable, vecCache);
+	}
+	// ÿڵֻܶӦһ,ڵԽʱȡһڵ
+	for (auto it = mapNode.begin(); it != mapNode.end(); it++)
+	{
+		vector<PlacementMask> vecMask;
+		AddCpuMasks(it->second, vecUsable, vecMask);
+		PlacementMask Empty = { 0, 0 };
+		if ((int)vecNode.size() <= it->first)
+			vecNode.resize(it->first + 1, Empty);
+		if (!vecMask.empty())
+			vecNode[it->first] = vecMask[0];
+	}
+	return true;
+}
+#endif
+
+static const char *ThreadRoleName(ThreadRole nRole)
+{
+	static const char *szRoleName[] = { "Input", "Decode", "Render", "IO" };
+	return (nRole >= ThreadRole_Input && nRole <= ThreadRole_IO) ? szRoleName[nRole] : "Unknown";
+}
+
+CThreadPlacement::CThreadPlacement()
+{
+	m_nPolicy = Placement_None;
+	m_bTopologyLoaded = false;
+	m_nCores = 0;
+	m_nProcessors = 0;
+	m_nGroups = 0;
+	m_nHomeNode = 0;
+}
+
+void CThreadPlacement::SetPolicy(PlacementPolicy nPolicy)
+{
+	if (nPolicy != Placement_None)
+	{
+		MUTEX_LOCK(m_csTopology);
+		if (!m_bTopologyLoaded)
+		{
+			m_bTopologyLoaded = true;
+			if (LoadTopology())
+				TraceTopology();
+		}
+		if (m_vecDomain.empty())
+		{
+			DxTraceWarn("%s Processor topology is unavailable,threads are not placed.\n", __FUNCTION__);
+			nPolicy = Placement_None;
+		}
+	}
+	InterlockedExchange(&m_nPolicy, nPolicy);
+}
+
+bool CThreadPlacement::Apply(ThreadRole nRole, int nChannel)
+{
+	if (m_nPolicy == Placement_None)
+		return false;
+	int nIdealProcessor = -1;
+	PlacementMask Mask;
+	if (!GetAffinity(nRole, nChannel, Mask, nIdealProcessor))
+		return false;
+	if (!SetThreadPlacement(Mask, nIdealProcessor))
+	{
+		DxTraceWarn("%s Failed to set affinity of %s thread(Channel %d),Group = %d,Error = %d.\n", __FUNCTION__,
+					ThreadRoleName(nRole), nChannel, Mask.nGroup, GetLastError());
+		return false;
+	}
+	DxTraceInfo("%s %s thread(Channel %d,TID %d):Node = %d\tGroup = %d\tAffinity = %llX\tIdealProcessor = %d.\n", __FUNCTION__,
+				ThreadRoleName(nRole), nChannel, GetCurrentThreadId(), GetNodeOfMask(Mask), Mask.nGroup, (unsigned long long)Mask.nMask, nIdealProcessor);
+	return true;
+}
+
+bool CThreadPlacement::GetAffinity(ThreadRole nRole, int nChannel, PlacementMask &Mask, int &nIdealProcessor)
+{
+	nIdealProcessor = -1;
+	MUTEX_LOCK(m_csTopology);
+	if (m_vecDomain.empty())
+		return false;
+	if (nRole == ThreadRole_Input || (nRole == ThreadRole_IO && nChannel < 0))
+	{
+		Mask = m_vecNode[m_nHomeNode];
+		return true;
+	}
+	if (nChannel < 0)
+		nChannel = 0;
+	// ڵֵͨͬĻ,ͬһڵͨηֵͬ
+	int nDomains = m_vecDomain.size();
+	const CacheDomain &Domain = m_vecDomain[nChannel % nDomains];
+	switch (nRole)
+	{
+	case ThreadRole_Decode:
+		nIdealProcessor = LowestBit(Domain.vecCore[(nChannel / nDomains) % Domain.vecCore.size()]);
+		Mask = Domain.Mask;
+		return true;
+	case ThreadRole_Render:
+		Mask = Domain.Mask;
+		return true;
+	case ThreadRole_IO:
+		Mask = m_vecNode[Domain.nNode];
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool CThreadPlacement::SetTopology(const vector<PlacementMask> &vecCore, const vector<PlacementMask> &vecCache, const vector<PlacementMask> &vecNode)
+{
+	MUTEX_LOCK(m_csTopology);
+	m_bTopologyLoaded = true;
+	return BuildDomains(vecCore, vecCache, vecNode);
+}
+
+#ifndef _WIN32
+bool CThreadPlacement::LoadSysfsTopology(const char *szCpuPath, bool bProcessAffinity)
+{
+	vector<PlacementMask> vecCore, vecCache, vecNode;
+	if (!ReadSysfsTopology(szCpuPath, bProcessAffinity, vecCore, vecCache, vecNode))
+		return false;
+	MUTEX_LOCK(m_csTopology);
+	m_bTopologyLoaded = true;
+	return BuildDomains(vecCore, vecCache, vecNode);
+}
+#endif
+
+void CThreadPlacement::TraceTopology()
+{
+	DxTraceInfo("%s Policy = %d\tProcessors = %d\tGroups = %d\tCores = %d\tNodes = %d\tCacheDomains = %d\tHomeNode = %d.\n", __FUNCTION__,
+				m_nPolicy, m_nProcessors, m_nGroups, m_nCores, (int)m_vecNode.size(), (int)m_vecDomain.size(), m_nHomeNode);
+	for (int i = 0; i < m_vecDomain.size(); i++)
+		DxTraceInfo("%s Domain %d:Node = %d\tGroup = %d\tCores = %d\tMask = %llX.\n", __FUNCTION__,
+					i, m_vecDomain[i].nNode, m_vecDomain[i].Mask.nGroup, (int)m_vecDomain[i].vecCore.size(), (unsigned long long)m_vecDomain[i].Mask.nMask);
+}
+
+// ڳm_csTopologyʱ,Ϊ0
+bool CThreadPlacement::BuildDomains(const vector<PlacementMask> &vecCore, const vector<PlacementMask> &vecCache, const vector<PlacementMask> &vecNode)
+{
+	m_vecDomain.clear();
+	m_vecNode = vecNode;
+	m_nCores = 0;
+	m_nProcessors = 0;
+	m_nGroups = 0;
+	m_nHomeNode = 0;
+	for (int i = 0; i < vecCore.size(); i++)
+	{
+		if (!vecCore[i].nMask)
+			continue;
+		m_nCores++;
+		m_nProcessors += CountBits(vecCore[i].nMask);
+		if (vecCore[i].nGroup >= m_nGroups)
+			m_nGroups = vecCore[i].nGroup + 1;
+	}
+	if (m_vecNode.empty())
+	{// ûNUMAڵϢʱ,ÿΪһڵ
+		m_vecNode.resize(m_nGroups);
+		for (int i = 0; i < m_nGroups; i++)
+		{
+			m_vecNode[i].nGroup = (WORD)i;
+			m_vecNode[i].nMask = 0;
+		}
+		for (int i = 0; i < vecCore.size(); i++)
+			m_vecNode[vecCore[i].nGroup].nMask |= vecCore[i].nMask;
+	}
+	// ûL3ϢʱNUMAڵΪ
+	const vector<PlacementMask> &vecDomainMask = vecCache.empty() ? m_vecNode : vecCache;
+	for (int i = 0; i < vecDomainMask.size(); i++)
+	{
+		if (!vecDomainMask[i].nMask)
+			continue;
+		CacheDomain Domain;
+		Domain.Mask = vecDomainMask[i];
+		Domain.nNode = GetNodeOfMask(Domain.Mask);
+		for (int j = 0; j < vecCore.size(); j++)
+		{
+			if (vecCore[j].nMask && vecCore[j].nGroup == Domain.Mask.nGroup && (vecCore[j].nMask & Domain.Mask.nMask) == vecCore[j].nMask)
+				Domain.vecCore.push_back(vecCore[j].nMask);
+		}
+		if (Domain.vecCore.empty())
+			Domain.vecCore.push_back(Domain.Mask.nMask);
+		m_vecDomain.push_back(Domain);
+	}
+	// ڵȡһпôĽڵ
+	for (int i = 0; i < m_vecNode.size(); i++)
+	{
+		if (m_vecNode[i].nMask)
+		{
+			m_nHomeNode = i;
+			break;
+		}
+	}
+	return !m_vecDomain.empty();
+}
+
+// ڳm_csTopologyʱ
+bool CThreadPlacement::LoadTopology()
+{
+#ifndef _WIN32
+	vector<PlacementMask> vecCore, vecCache, vecNode;
+	if (!ReadSysfsTopology("/sys/devices/system/cpu", true, vecCore, vecCache, vecNode))
+		return false;
+	return BuildDomains(vecCore, vecCache, vecNode);
+#else
+	HMODULE hKernel32 = GetModuleHandle(_T("kernel32.dll"));
+	if (!hKernel32)
+		return false;
+	pGetLogicalProcessorInformationEx pGLPIEx = (pGetLogicalProcessorInformationEx)GetProcAddress(hKernel32, "GetLogicalProcessorInformationEx");
+	pGetThreadGroupAffinity pGetThreadGroupAffinity = (pGetThreadGroupAffinity)GetProcAddress(hKernel32, "GetThreadGroupAffinity");
+	s_pSetThreadGroupAffinity = (pSetThreadGroupAffinity)GetProcAddress(hKernel32, "SetThreadGroupAffinity");
+	s_pSetThreadIdealProcessorEx = (pSetThreadIdealProcessorEx)GetProcAddress(hKernel32, "SetThreadIdealProcessorEx");
+	if (!pGLPIEx || !pGetThreadGroupAffinity || !s_pSetThreadGroupAffinity)
+		s_pSetThreadGroupAffinity = NULL;
+
+	// ̵׺ֻ޶,̵̷ֲ߳ڶʱGetProcessAffinityMask0,ʱ޶
+	DWORD_PTR nProcessMask = 0;
+	DWORD_PTR nSystemMask = 0;
+	WORD nProcessGroup = 0;
+	if (!GetProcessAffinityMask(GetCurrentProcess(), &nProcessMask, &nSystemMask))
+		nProcessMask = 0;
+	vector<PlacementMask> vecCore;
+	vector<PlacementMask> vecCache;
+	vector<PlacementMask> vecNode;
+	if (s_pSetThreadGroupAffinity)
+	{
+		GROUP_AFFINITY Affinity;
+		ZeroMemory(&Affinity, sizeof(GROUP_AFFINITY));
+		if (pGetThreadGroupAffinity(GetCurrentThread(), &Affinity))
+			nProcessGroup = Affinity.Group;
+		DWORD dwLength = 0;
+		pGLPIEx(RelationAll, NULL, &dwLength);
+		if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || !dwLength)
+			return false;
+		vector<BYTE> vecBuffer(dwLength);
+		if (!pGLPIEx(RelationAll, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)&vecBuffer[0], &dwLength))
+		{
+			DxTraceWarn("%s GetLogicalProcessorInformationEx failed,Error = %d.\n", __FUNCTION__, GetLastError());
+			return false;
+		}
+		for (DWORD nOffset = 0; nOffset < dwLength;)
+		{
+			PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX pInfo = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)&vecBuffer[nOffset];
+			if (!pInfo->Size)
+				break;
+			nOffset += pInfo->Size;
+			const GROUP_AFFINITY *pGroupMask = NULL;
+			switch (pInfo->Relationship)
+			{
+			case RelationProcessorCore:
+				pGroupMask = &pInfo->Processor.GroupMask[0];		// һĵ߼ͬһ
+				break;
+			case RelationCache:
+				if (pInfo->Cache.Level == 3 && (pInfo->Cache.Type == CacheUnified || pInfo->Cache.Type == CacheData))
+					pGroupMask = &pInfo->Cache.GroupMask;
+				break;
+			case RelationNumaNode:
+				pGroupMask = &pInfo->NumaNode.GroupMask;
+				break;
+			default:
+				break;
+			}
+			if (!pGroupMask)
+				continue;
+			PlacementMask Mask = { pGroupMask->Group, pGroupMask->Mask };
+			if (nProcessMask && Mask.nGroup == nProcessGroup)
+				Mask.nMask &= nProcessMask;
+			if (!Mask.nMask)
+				continue;
+			if (pInfo->Relationship == RelationProcessorCore)
+				vecCore.push_back(Mask);
+			else if (pInfo->Relationship == RelationCache)
+				vecCache.push_back(Mask);
+			else
+			{
+				PlacementMask Empty = { 0, 0 };
+				if (vecNode.size() <= pInfo->NumaNode.NodeNumber)
+					vecNode.resize(pInfo->NumaNode.NodeNumber + 1, Empty);
+				vecNode[pInfo->NumaNode.NodeNumber] = Mask;
+			}
+		}
+		return BuildDomains(vecCore, vecCache, vecNode);
+	}
+
+	// XP SP3֮ǰϵͳûGetLogicalProcessorInformation,ֻʹô0
+	pGetLogicalProcessorInformation pGLPI = (pGetLogicalProcessorInformation)GetProcAddress(hKernel32, "GetLogicalProcessorInformation");
+	if (!pGLPI)
+	{
+		DxTraceWarn("%s GetLogicalProcessorInformation is not supported.\n", __FUNCTION__);
+		return false;
+	}
+	if (!nProcessMask)
+		return false;
+	DWORD dwLength = 0;
+	pGLPI(NULL, &dwLength);
+	if (GetLastError() != ERROR_INSUFFICIENT_BUFFER || !dwLength)
+		return false;
+	vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> vecInfo(dwLength / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION) + 1);
+	if (!pGLPI(&vecInfo[0], &dwLength))
+	{
+		DxTraceWarn("%s GetLogicalProcessorInformation failed,Error = %d.\n", __FUNCTION__, GetLastError());
+		return false;
+	}
+	int nCount = dwLength / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION);
+	for (int i = 0; i < nCount; i++)
+	{
+		PlacementMask Mask = { 0, vecInfo[i].ProcessorMask & nProcessMask };
+		if (!Mask.nMask)
+			continue;
+		switch (vecInfo[i].Relationship)
+		{
+		case RelationProcessorCore:
+			vecCore.push_back(Mask);
+			break;
+		case RelationCache:
+			if (vecInfo[i].Cache.Level == 3 && (vecInfo[i].Cache.Type == CacheUnified || vecInfo[i].Cache.Type == CacheData))
+				vecCache.push_back(Mask);
+			break;
+		case RelationNumaNode:
+			{
+				PlacementMask Empty = { 0, 0 };
+				if (vecNode.size() <= vecInfo[i].NumaNode.NodeNumber)
+					vecNode.resize(vecInfo[i].NumaNode.NodeNumber + 1, Empty);
+				vecNode[vecInfo[i].NumaNode.NodeNumber] = Mask;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+	return BuildDomains(vecCore, vecCache, vecNode);
+#endif
+}
+
+int CThreadPlacement::GetNodeOfMask(const PlacementMask &Mask)
+{
+	for (int i = 0; i < m_vecNode.size(); i++)
+	{
+		if (m_vecNode[i].nGroup == Mask.nGroup && (m_vecNode[i].nMask & Mask.nMask))
+			return i;
+	}
+	return 0;
+}
+
+// Windowsд麯ʱԷõ⴦,ֻܷڴ0
+bool CThreadPlacement::SetThreadPlacement(const PlacementMask &Mask, int nIdealProcessor)
+{
+#ifdef _WIN32
+	if (s_pSetThreadGroupAffinity)
+	{
+		GROUP_AFFINITY Affinity;
+		ZeroMemory(&Affinity, sizeof(GROUP_AFFINITY));
+		Affinity.Group = Mask.nGroup;
+		Affinity.Mask = Mask.nMask;
+		if (!s_pSetThreadGroupAffinity(GetCurrentThread(), &Affinity, NULL))
+			return false;
+		if (nIdealProcessor >= 0 && s_pSetThreadIdealProcessorEx)
+		{
+			PROCESSOR_NUMBER Number;
+			ZeroMemory(&Number, sizeof(PROCESSOR_NUMBER));
+			Number.Group = Mask.nGroup;
+			Number.Number = (BYTE)nIdealProcessor;
+			s_pSetThreadIdealProcessorEx(GetCurrentThread(), &Number, NULL);
+		}
+		return true;
+	}
+	if (Mask.nGroup)
+		return false;
+	if (!SetThreadAffinityMask(GetCurrentThread(), Mask.nMask))
+		return false;
+	if (nIdealProcessor >= 0)
+		SetThreadIdealProcessor(GetCurrentThread(), nIdealProcessor);
+	return true;
+#else
+	// Linuxû봦,ֻ߳޶ڻ
+	cpu_set_t CpuSet;
+	CPU_ZERO(&CpuSet);
+	for (int i = 0; i < PLACEMENT_GROUP_SIZE; i++)
+	{
+		int nCpu = Mask.nGroup * PLACEMENT_GROUP_SIZE + i;
+		if ((Mask.nMask & ((DWORD_PTR)1 << i)) && nCpu < CPU_SETSIZE)
+			CPU_SET(nCpu, &CpuSet);
+	}
+	int nError = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &CpuSet);
+	if (nError)
+	{
+		errno = nError;
+		return false;
+	}
+	return true;
+#endif
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "Win32Port.h"
+#include <vector>
+#include "AdaptiveLock.h"
+#include "DxTrace.h"
+
+using namespace std;
+
+enum PlacementPolicy
+{
+	Placement_None = 0,		// ׺,ϵͳ
+	Placement_Spread,		// ͨ䵽L3,ڰķɢ
+};
+
+// һڵ߼,64߼ϵͳΪ,ÿ64
+struct PlacementMask
+{
+	WORD		nGroup;
+	DWORD_PTR	nMask;
+};
+
+enum ThreadRole
+{
+	ThreadRole_Input = 0,	// ȡļ߳,ڵ
+	ThreadRole_Decode,		// ͨĽ߳,޶ͨL3,봦Ϊͨ
+	ThreadRole_Render,		// ͨȾ߳,߳ͬһL3
+	ThreadRole_IO,			// ͨ¼I/O߳,ͨڵNUMAڵ,nChannelС0ʱڵ
+};
+
+/// @brief ̵߳CPUNUMAڵò
+/// @remark һòʱȡġL3NUMAڵ,ȡL3ʱNUMAڵΪ;
+/// ͬһͨĽȾ̹߳һL3,ͼݲؿ绺Ϳڵ;߳ڿʼʱApply׺,õĽ־
+/// Windows 7ͨGetLogicalProcessorInformationExȡд,SetThreadGroupAffinity̷߳ŵ⴦;
+/// ЩXP²,ʱ̬ȡ,ȡʱGetLogicalProcessorInformation,ֻڴ0
+/// Linux´/sys/devices/system/cpuȡ,߼ÿ64(32λΪ32)Ϊһ,pthread_setaffinity_np׺,û봦
+class CThreadPlacement
+{
+public:
+	CThreadPlacement();
+
+	/// @brief ÷ò,˺ʼе̰߳µĲԷ
+	/// @remark ΪPlacement_Noneʱı̵߳׺
+	void SetPolicy(PlacementPolicy nPolicy);
+	PlacementPolicy GetPolicy()
+	{
+		return (PlacementPolicy)m_nPolicy;
+	}
+
+	/// @brief õ̵߳׺
+	/// @param nChannel	߳ͨ,߳Ϊ-1
+	/// @return ΪPlacement_None˲ûʧʱfalse
+	bool Apply(ThreadRole nRole, int nChannel);
+
+	/// @brief ȡ̰߳Ӧе׺
+	/// @param nIdealProcessor	봦Mask.nGroupڵ,ûʱΪ-1
+	/// @return ˲ʱfalse
+	bool GetAffinity(ThreadRole nRole, int nChannel, PlacementMask &Mask, int &nIdealProcessor);
+
+	/// @brief ֱָ,ϵͳȡ,ڼõĽ
+	/// @param vecCore	ĵ߼
+	/// @param vecCache	L3߼,ΪʱNUMAڵΪ
+	/// @param vecNode	NUMAڵ߼,±Ϊڵ,ΪʱÿΪһڵ
+	bool SetTopology(const vector<PlacementMask> &vecCore, const vector<PlacementMask> &vecCache, const vector<PlacementMask> &vecNode);
+
+#ifndef _WIN32
+	/// @brief ָsysfsĿ¼ȡ,Ĭϵ/sys/devices/system/cpu,ڼĽ
+	/// @param bProcessAffinity	Ƿֻ׺߼
+	bool LoadSysfsTopology(const char *szCpuPath, bool bProcessAffinity);
+#endif
+
+	int GetProcessorCount()
+	{
+		return m_nProcessors;
+	}
+	int GetDomainCount()
+	{
+		return m_vecDomain.size();
+	}
+
+	// 
+	void TraceTopology();
+private:
+	struct CacheDomain
+	{
+		PlacementMask		Mask;		// һL3߼
+		int					nNode;		// ڵNUMAڵ
+		vector<DWORD_PTR>	vecCore;	// ڸĵ߼,Maskͬһ
+	};
+	bool LoadTopology();
+	bool BuildDomains(const vector<PlacementMask> &vecCore, const vector<PlacementMask> &vecCache, const vector<PlacementMask> &vecNode);
+	int GetNodeOfMask(const PlacementMask &Mask);
+	static bool SetThreadPlacement(const PlacementMask &Mask, int nIdealProcessor);
+
+	CSpinMutex			m_csTopology;
+	volatile LONG		m_nPolicy;
+	bool				m_bTopologyLoaded;
+	vector<PlacementMask> m_vecNode;		// NUMAڵ߼
+	vector<CacheDomain>	m_vecDomain;
+	int					m_nCores;			// 
+	int					m_nProcessors;		// õ߼
+	int					m_nGroups;			// 
+	int					m_nHomeNode;		// ڵ,߳ڵĽڵ
+};
+
+extern CThreadPlacement g_ThreadPlacement;
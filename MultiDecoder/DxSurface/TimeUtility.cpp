@@ -1,9 +1,10 @@
 //#include "../StdAfx.h"
 #include <stdio.h>
 #include <assert.h>
+#include "TimeUtility.h"
+#ifdef _WIN32
 #include <WinSock.h>
 #include <memory>
-#include "TimeUtility.h"
 #pragma comment (lib,"Ws2_32")
 
 ETB *g_petb = new ETB;
@@ -120,6 +121,7 @@ LPCSTR DateTimeA()
 		return NULL;
 	return (LPCSTR)szDateTime;
 }
+#endif
 
 
 
@@ -154,33 +156,66 @@ bool IsLeapYear(UINT nYear)
 //Index						   0123456789012345678
 //convet the time string like "2014-04-10 12:11:10" to a UTC time
 UINT64 DateTimeString2UTC(TCHAR *szTime, UINT64 &nTime)
-
 {
-	if (!szTime || _tcslen(szTime) != 18)
+	if (!szTime || !FastDateTime2UTC(szTime, _tcslen(szTime), nTime))
 		return 0;
-	TCHAR szDigit[8];
-	SYSTEMTIME systime;
-	_tcsncpy_s(szDigit, 8, szTime, 4);
-	systime.wYear = _ttoi(szDigit);
-
-	_tcsncpy_s(szDigit, 8, &szTime[5], 2);
-	systime.wMonth = _ttoi(szDigit);
-
-	_tcsncpy_s(szDigit, 8, &szTime[8], 2);
-	systime.wDay = _ttoi(szDigit);
-
-	_tcsncpy_s(szDigit, 8, &szTime[11], 2);
-	systime.wHour = _ttoi(szDigit);
+	return nTime;
+}
 
-	_tcsncpy_s(szDigit, 8, &szTime[14], 2);
-	systime.wMinute = _ttoi(szDigit);
+// ȡnCountֵַ,зַʱ-1
+static inline int ParseDigits(const TCHAR *szDigit, int nCount)
+{
+	int nValue = 0;
+	for (int i = 0; i < nCount; i++)
+	{
+		unsigned int nDigit = (unsigned int)(szDigit[i] - _T('0'));
+		if (nDigit > 9)
+			return -1;
+		nValue = nValue * 10 + nDigit;
+	}
+	return nValue;
+}
 
-	_tcsncpy_s(szDigit, 8, &szTime[17], 2);
-	systime.wSecond = _ttoi(szDigit);
-	SystemTime2UTC(&systime, &nTime);
-	return nTime;
+bool FastDateTime2UTC(const TCHAR *szTime, int nLength, UINT64 &nTime)
+{
+	// ꡢ¡աʱַ֡еλ
+	static const int nPos19[6] = { 0, 5, 8, 11, 14, 17 };
+	static const int nPos15[6] = { 0, 4, 6, 9, 11, 13 };
+	static const int nPos14[6] = { 0, 4, 6, 8, 10, 12 };
+	const int *pPos = NULL;
+	if (!szTime)
+		return false;
+	if (nLength == 19)
+		pPos = nPos19;
+	else if (nLength == 15)
+		pPos = nPos15;
+	else if (nLength == 14)
+		pPos = nPos14;
+	else
+		return false;
+	int nYear = ParseDigits(&szTime[pPos[0]], 4);
+	int nMonth = ParseDigits(&szTime[pPos[1]], 2);
+	int nDay = ParseDigits(&szTime[pPos[2]], 2);
+	int nHour = ParseDigits(&szTime[pPos[3]], 2);
+	int nMinute = ParseDigits(&szTime[pPos[4]], 2);
+	int nSecond = ParseDigits(&szTime[pPos[5]], 2);
+	if (nYear < 1970 || nMonth < 1 || nMonth > 12 || nDay < 1 || nHour < 0 || nHour > 23 || nMinute < 0 || nMinute > 59 || nSecond < 0 || nSecond > 60)
+		return false;
+	static const int nMonthDays[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	if (nDay > nMonthDays[nMonth - 1] + (nMonth == 2 && IsLeapYear(nYear) ? 1 : 0))
+		return false;
+	// 3ΪһĿʼ,λĩ,ÿ31ֻ·й
+	int nY = nYear - (nMonth <= 2 ? 1 : 0);
+	int nEra = nY / 400;
+	int nYearOfEra = nY - nEra * 400;
+	int nDayOfYear = (153 * (nMonth + (nMonth > 2 ? -3 : 9)) + 2) / 5 + nDay - 1;
+	int nDayOfEra = nYearOfEra * 365 + nYearOfEra / 4 - nYearOfEra / 100 + nDayOfYear;
+	INT64 nDays = (INT64)nEra * 146097 + nDayOfEra - 719468;		// 719468Ϊ0000-03-011970-01-01
+	nTime = (UINT64)(nDays * __Day_Sec + nHour * 3600 + nMinute * 60 + nSecond);
+	return true;
 }
 
+#ifdef _WIN32
 void UTC2DateTimeStringA(UINT64 nTime, CHAR *szTime, int nSize)
 {
 	tm TM;
@@ -460,4 +495,5 @@ BOOL NTPTiming(const char  *szTimeServer)
 	// ޸ıϵͳʱ
 	SetLocalTime(&newtime);
 	return TRUE;
-}
\ No newline at end of file
+}
+#endif
@@ -1,9 +1,21 @@
 
 #pragma once
 
-#include <TCHAR.H>
-#include <windows.h>
+// ʱַĽWindows,ƽ̨ҲԹ,¼ļ;ຯֻWindows
+#include "Win32Port.h"
 #include <time.h>
+#ifdef _WIN32
+#include <TCHAR.H>
+#endif
+
+bool	IsLeapYear(UINT nYear);
+UINT64	DateTimeString2UTC(TCHAR *szTime, UINT64 &nTime);
+/// @brief ʱַ,Ӵ,ֱӼ,ۼ
+/// @param nLength	ַ,19Ϊ"2014-04-10 12:11:10"(ָ),15Ϊ"20140410_121110",14Ϊ"20140410121110"
+/// @remark DateTimeString2UTCͬ,ַеʱֱӻ,ʱת
+bool	FastDateTime2UTC(const TCHAR *szTime, int nLength, UINT64 &nTime);
+
+#ifdef _WIN32
 #ifdef _UNICODE
 #define GetDateTime			GetDateTimeW
 #define	_DateTime			DateTimeW
@@ -18,8 +30,6 @@
 int		GetDateTimeA(CHAR *szDateTime, int nSize);
 int		GetDateTimeW(WCHAR *szDateTime, int nSize);
 
-bool	IsLeapYear(UINT nYear);
-UINT64	DateTimeString2UTC(TCHAR *szTime, UINT64 &nTime);
 void	UTC2DateTimeStringA(UINT64 nTime, CHAR *szTime, int nSize);
 void	UTC2DateTimeStringW(UINT64 nTime, WCHAR *szTime, int nSize);
 BOOL	SystemTime2UTC(SYSTEMTIME *pSystemTime, UINT64 *pTime);
@@ -83,3 +93,4 @@ extern ETB* g_petb;
 #define	InitPerformanceClock	InitHighPerformanceClock
 void	InitHighPerformanceClock(ETB *petb = NULL);
 double  GetExactTime(ETB *petb = NULL);
+#endif
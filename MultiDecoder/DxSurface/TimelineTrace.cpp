@@ -0,0 +1,179 @@
+#include "TimelineTrace.h"
+#include <stdio.h>
+#include <vector>
+#include "DxTrace.h"
+#pragma warning (disable:4996)
+
+using namespace std;
+
+// ̵߳¼ѭ,ֻ߳д;nCountΪۼд¼,¼д֮
+struct TimelineBuffer
+{
+	TimelineEvent	Event[TIMELINE_EVENTS];
+	volatile LONG	nCount;
+	DWORD			dwThreadId;
+	HANDLE			hThread;			// ̵߳ľ,߳˳󻺳ɱ
+	const char		*szThreadName;
+	int				nChannel;
+};
+
+// ȫ״̬ھ̬洢,ʼֵȫΪ0,һʹʱųʼ
+static volatile LONG		s_nInitState = 0;		// 0:δʼ 1:ڳʼ 2:ѳʼ
+static volatile LONG		s_bEnabled = FALSE;
+static DWORD				s_dwTlsIndex = TLS_OUT_OF_INDEXES;
+static CRITICAL_SECTION		s_csBuffers;
+static TimelineBuffer		*s_pBuffers[TIMELINE_MAX_THREADS];
+static volatile LONG		s_nBuffers = 0;
+static LONGLONG				s_nBaseTime = 0;
+
+static bool TimelineInit()
+{
+	if (s_nInitState == 2)
+		return true;
+	if (InterlockedCompareExchange(&s_nInitState, 1, 0) == 0)
+	{
+		InitializeCriticalSection(&s_csBuffers);
+		s_dwTlsIndex = TlsAlloc();
+		s_nBaseTime = MonoTimeNs();
+		InterlockedExchange(&s_nInitState, 2);
+	}
+	else
+	{
+		while (s_nInitState != 2)
+			Sleep(0);
+	}
+	return s_dwTlsIndex != TLS_OUT_OF_INDEXES;
+}
+
+// ȡõ̵߳Ļ,һεʱ˳̵߳Ļ
+static TimelineBuffer *GetBuffer()
+{
+	if (!TimelineInit())
+		return NULL;
+	TimelineBuffer *pBuffer = (TimelineBuffer *)TlsGetValue(s_dwTlsIndex);
+	if (pBuffer)
+		return pBuffer;
+	EnterCriticalSection(&s_csBuffers);
+	for (int i = 0; i < s_nBuffers && !pBuffer; i++)
+	{
+		HANDLE hThread = s_pBuffers[i]->hThread;
+		if (hThread && WaitForSingleObject(hThread, 0) == WAIT_OBJECT_0)
+		{
+			CloseHandle(hThread);
+			pBuffer = s_pBuffers[i];
+		}
+	}
+	if (!pBuffer && s_nBuffers < TIMELINE_MAX_THREADS)
+	{
+		pBuffer = new TimelineBuffer;
+		s_pBuffers[s_nBuffers] = pBuffer;
+		InterlockedIncrement(&s_nBuffers);
+	}
+	if (pBuffer)
+	{
+		pBuffer->nCount = 0;
+		pBuffer->dwThreadId = GetCurrentThreadId();
+		pBuffer->hThread = OpenThread(SYNCHRONIZE, FALSE, pBuffer->dwThreadId);
+		pBuffer->szThreadName = NULL;
+		pBuffer->nChannel = -1;
+		TlsSetValue(s_dwTlsIndex, pBuffer);
+	}
+	LeaveCriticalSection(&s_csBuffers);
+	return pBuffer;
+}
+
+void TimelineEnable(bool bEnable)
+{
+	if (TimelineInit())
+		InterlockedExchange(&s_bEnabled, bEnable ? TRUE : FALSE);
+}
+
+bool TimelineIsEnabled()
+{
+	return s_bEnabled != FALSE;
+}
+
+void TimelineSetThreadName(const char *szName, int nChannel)
+{
+	if (!TimelineIsEnabled())
+		return;
+	TimelineBuffer *pBuffer = GetBuffer();
+	if (!pBuffer)
+		return;
+	pBuffer->szThreadName = szName;
+	pBuffer->nChannel = nChannel;
+}
+
+void TimelineRecord(const char *szName, int nChannel, __int64 nPts, LONGLONG nBegin, LONGLONG nEnd)
+{
+	TimelineBuffer *pBuffer = GetBuffer();
+	if (!pBuffer)
+		return;
+	LONG nCount = pBuffer->nCount;
+	TimelineEvent &Event = pBuffer->Event[nCount % TIMELINE_EVENTS];
+	Event.nBegin = nBegin;
+	Event.nEnd = nEnd;
+	Event.nPts = nPts;
+	Event.szName = szName;
+	Event.nChannel = (nChannel == TIMELINE_CURRENT_CHANNEL) ? pBuffer->nChannel : nChannel;
+	// ¼д֮ŷ,̲߳¼
+	InterlockedExchange(&pBuffer->nCount, nCount + 1);
+}
+
+bool TimelineExportChrome(const char *szPath)
+{
+	if (!szPath || !TimelineInit())
+		return false;
+	FILE *fp = fopen(szPath, "wb");
+	if (!fp)
+	{
+		DxTraceWarn("%s Failed to create %s.\n", __FUNCTION__, szPath);
+		return false;
+	}
+	vector<TimelineEvent> vecEvent(TIMELINE_EVENTS);
+	DWORD dwPid = GetCurrentProcessId();
+	int nExported = 0;
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool bFirst = true;
+	EnterCriticalSection(&s_csBuffers);
+	for (int i = 0; i < s_nBuffers; i++)
+	{
+		TimelineBuffer *pBuffer = s_pBuffers[i];
+		DWORD dwTid = pBuffer->dwThreadId;
+		if (pBuffer->szThreadName)
+		{
+			fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s",
+					bFirst ? "" : ",\n", dwPid, dwTid, pBuffer->szThreadName);
+			if (pBuffer->nChannel >= 0)
+				fprintf(fp, " %d", pBuffer->nChannel);
+			fprintf(fp, "\"}}");
+			bFirst = false;
+		}
+		// ȸټ,ڼ䱻̸߳ǵ¼
+		LONG nEnd = pBuffer->nCount;
+		LONG nCopyBegin = nEnd > TIMELINE_EVENTS ? nEnd - TIMELINE_EVENTS : 0;
+		for (LONG n = nCopyBegin; n < nEnd; n++)
+			vecEvent[n - nCopyBegin] = pBuffer->Event[n % TIMELINE_EVENTS];
+		LONG nBegin = pBuffer->nCount - TIMELINE_EVENTS + 1;
+		if (nBegin < nCopyBegin)
+			nBegin = nCopyBegin;
+		for (LONG n = nBegin; n < nEnd; n++)
+		{
+			TimelineEvent &Event = vecEvent[n - nCopyBegin];
+			double dfTs = (double)(Event.nBegin - s_nBaseTime) / MONO_NS_PER_US;
+			double dfDur = (double)(Event.nEnd - Event.nBegin) / MONO_NS_PER_US;
+			fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"pipeline\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{\"channel\":%d",
+					bFirst ? "" : ",\n", Event.szName, dfTs, dfDur, dwPid, dwTid, Event.nChannel);
+			if (Event.nPts != TIMELINE_NO_PTS)
+				fprintf(fp, ",\"pts\":%lld", (long long)Event.nPts);
+			fprintf(fp, "}}");
+			bFirst = false;
+			nExported++;
+		}
+	}
+	LeaveCriticalSection(&s_csBuffers);
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+	DxTraceInfo("%s Exported %d events to %s.\n", __FUNCTION__, nExported, szPath);
+	return true;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "Win32Port.h"
+#include "MonoClock.h"
+
+#define TIMELINE_EVENTS				4096	// ÿ̱߳¼
+#define TIMELINE_MAX_THREADS		512
+#define TIMELINE_CURRENT_CHANNEL	-2		// ʹ߳TimelineSetThreadNameõͨ
+#define TIMELINE_NO_PTS				((__int64)0x8000000000000000LL)
+
+// ʱϵһ¼
+struct TimelineEvent
+{
+	LONGLONG		nBegin;			// MonoTimeNsȡõʱ,λ
+	LONGLONG		nEnd;
+	__int64			nPts;			// ֡ʱ,ΪTIMELINE_NO_PTSʱ
+	const char		*szName;		// ׶,Ϊַ
+	int				nChannel;		// ͨ,Ϊ-1ʱκͨ
+};
+
+/// @brief رʱ߼¼,رʱTIMELINE_SCOPEֻһ־
+/// @remark ÿ̰߳¼дԼѭ,ֻTIMELINE_EVENTS¼,дʱ;
+/// ߳˳仺̸߳,ǰ¼֮
+void TimelineEnable(bool bEnable);
+bool TimelineIsEnabled();
+
+// õ߳ʱʾƺĬͨ,szNameΪַ;¼δʱκ,̵߳Ļֻڼ¼󴴽
+void TimelineSetThreadName(const char *szName, int nChannel = -1);
+
+// ¼һ¼,nBeginnEndΪMonoTimeNsȡõʱ
+void TimelineRecord(const char *szName, int nChannel, __int64 nPts, LONGLONG nBegin, LONGLONG nEnd);
+
+/// @brief ̻߳е¼ΪChrome trace JSONļ
+/// @remark ļchrome://tracingPerfetto UIд,߳ʾΪһ,¼argsаͨʱ
+/// ʱͣ¼,ڼ䱻ǵ¼
+bool TimelineExportChrome(const char *szPath);
+
+// ڼ¼һ¼,ҲBeginEndǲӦ
+class CTimelineScope
+{
+public:
+	CTimelineScope()
+	{
+		m_szName = NULL;
+	}
+	CTimelineScope(const char *szName, int nChannel = TIMELINE_CURRENT_CHANNEL, __int64 nPts = TIMELINE_NO_PTS)
+	{
+		m_szName = NULL;
+		Begin(szName, nChannel, nPts);
+	}
+	~CTimelineScope()
+	{
+		End();
+	}
+	void Begin(const char *szName, int nChannel = TIMELINE_CURRENT_CHANNEL, __int64 nPts = TIMELINE_NO_PTS)
+	{
+		if (!TimelineIsEnabled())
+			return;
+		m_szName = szName;
+		m_nChannel = nChannel;
+		m_nPts = nPts;
+		m_nBegin = MonoTimeNs();
+	}
+	// 䲢¼,˺ʱټ¼
+	void End()
+	{
+		if (!m_szName)
+			return;
+		TimelineRecord(m_szName, m_nChannel, m_nPts, m_nBegin, MonoTimeNs());
+		m_szName = NULL;
+	}
+private:
+	const char	*m_szName;			// ΪNULLʾûне
+	int			m_nChannel;
+	__int64		m_nPts;
+	LONGLONG	m_nBegin;
+};
+
+#define TIMELINE_CONCAT2(a, b)	a##b
+#define TIMELINE_CONCAT(a, b)	TIMELINE_CONCAT2(a, b)
+#define TIMELINE_SCOPE(szName, nChannel, nPts)	CTimelineScope TIMELINE_CONCAT(_TimelineScope, __LINE__)(szName, nChannel, nPts)
@@ -0,0 +1,668 @@
+#pragma once
+// Կĺģ(ظơʱӡ־)WindowsֱʹWin32 API
+// ƽ̨ɱļṩЩģõWin32ͺͺ,ʹWindows,MultiDecoderTest
+// ֻʵָģʵõĲ,Win32һ:
+// CRITICAL_SECTION;¼ź߳̾Եȴ,߳̾߳˳Ϊź״̬
+// ں˶״̬ͬһ,ȴʱͬһϵȴ,ʵּ,׷
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#include <intrin.h>
+#else
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <map>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+typedef uint8_t			BYTE;
+typedef uint16_t		WORD;
+typedef uint32_t		DWORD;
+typedef int32_t			LONG;
+typedef uint32_t		ULONG;
+typedef int64_t			LONGLONG;
+typedef uint64_t		ULONGLONG;
+typedef uint64_t		UINT64;
+typedef int64_t			INT64;
+typedef int64_t			LONG64;
+typedef int				BOOL;
+typedef unsigned int	UINT;
+typedef char			CHAR;
+typedef wchar_t			WCHAR;
+typedef void			*HANDLE;
+typedef void			*PVOID;
+typedef void			*LPVOID;
+typedef void			VOID;
+typedef BYTE			BOOLEAN;
+typedef uintptr_t		DWORD_PTR;
+typedef uintptr_t		ULONG_PTR;
+typedef intptr_t		INT_PTR;
+typedef long long		__int64;
+typedef int32_t			HRESULT;
+typedef void			*HMODULE;
+typedef void			*HWND;
+typedef void			*HMONITOR;
+
+typedef struct tagRECT
+{
+	LONG	left;
+	LONG	top;
+	LONG	right;
+	LONG	bottom;
+} RECT;
+
+typedef union _LARGE_INTEGER
+{
+	struct
+	{
+		DWORD	LowPart;
+		LONG	HighPart;
+	};
+	LONGLONG	QuadPart;
+} LARGE_INTEGER;
+
+#ifndef TRUE
+#define TRUE			1
+#endif
+#ifndef FALSE
+#define FALSE			0
+#endif
+
+#define __stdcall
+#define WINAPI
+#define CALLBACK
+#define DECLSPEC_ALIGN(x)		__attribute__((aligned(x)))
+#define ZeroMemory(p, n)		memset((p), 0, (n))
+#define _vsnprintf				vsnprintf
+#define _snprintf				snprintf
+#define sprintf_s				snprintf
+
+#define S_OK					((HRESULT)0)
+#define E_FAIL					((HRESULT)0x80004005)
+#define E_OUTOFMEMORY			((HRESULT)0x8007000E)
+#define SUCCEEDED(hr)			(((HRESULT)(hr)) >= 0)
+#define FAILED(hr)				(((HRESULT)(hr)) < 0)
+
+#define INFINITE				0xFFFFFFFF
+#define WAIT_OBJECT_0			0
+#define WAIT_TIMEOUT			258
+#define WAIT_FAILED				0xFFFFFFFF
+#define SYNCHRONIZE				0x00100000
+#define CREATE_SUSPENDED		0x00000004
+#define TLS_OUT_OF_INDEXES		0xFFFFFFFF
+#define THREAD_PRIORITY_LOWEST			-2
+#define THREAD_PRIORITY_BELOW_NORMAL	-1
+#define THREAD_PRIORITY_NORMAL			0
+#define THREAD_PRIORITY_ABOVE_NORMAL	1
+#define THREAD_PRIORITY_HIGHEST			2
+#define THREAD_PRIORITY_ERROR_RETURN	0x7FFFFFFF
+#define MAXIMUM_WAIT_OBJECTS	64
+
+// ԭӲ,Win32һȫڴ
+inline LONG InterlockedIncrement(volatile LONG *p)					{ return __sync_add_and_fetch(p, 1); }
+inline LONG InterlockedDecrement(volatile LONG *p)					{ return __sync_sub_and_fetch(p, 1); }
+inline LONG InterlockedExchange(volatile LONG *p, LONG n)			{ return __atomic_exchange_n(p, n, __ATOMIC_SEQ_CST); }
+inline LONG InterlockedExchangeAdd(volatile LONG *p, LONG n)		{ return __sync_fetch_and_add(p, n); }
+inline LONG InterlockedCompareExchange(volatile LONG *p, LONG n, LONG nComparand)	{ return __sync_val_compare_and_swap(p, nComparand, n); }
+inline LONG _InterlockedAnd(volatile LONG *p, LONG n)				{ return __sync_fetch_and_and(p, n); }
+inline LONG _InterlockedOr(volatile LONG *p, LONG n)				{ return __sync_fetch_and_or(p, n); }
+inline LONGLONG InterlockedIncrement64(volatile LONGLONG *p)		{ return __sync_add_and_fetch(p, 1); }
+inline LONGLONG InterlockedExchange64(volatile LONGLONG *p, LONGLONG n)		{ return __atomic_exchange_n(p, n, __ATOMIC_SEQ_CST); }
+inline LONGLONG InterlockedExchangeAdd64(volatile LONGLONG *p, LONGLONG n)	{ return __sync_fetch_and_add(p, n); }
+inline LONGLONG InterlockedCompareExchange64(volatile LONGLONG *p, LONGLONG n, LONGLONG nComparand)	{ return __sync_val_compare_and_swap(p, nComparand, n); }
+inline PVOID InterlockedCompareExchangePointer(PVOID volatile *p, PVOID n, PVOID nComparand)	{ return __sync_val_compare_and_swap(p, nComparand, n); }
+inline PVOID InterlockedExchangePointer(PVOID volatile *p, PVOID n)	{ return __atomic_exchange_n(p, n, __ATOMIC_SEQ_CST); }
+#define MemoryBarrier()			__sync_synchronize()
+inline unsigned char _BitScanReverse(DWORD *pIndex, DWORD nMask)
+{
+	if (!nMask)
+		return 0;
+	*pIndex = 31 - __builtin_clz(nMask);
+	return 1;
+}
+#if defined(__i386__) || defined(__x86_64__)
+#define YieldProcessor()		_mm_pause()
+#else
+#define _mm_pause()				sched_yield()
+#define YieldProcessor()		sched_yield()
+#endif
+
+// ٽ
+typedef struct _CRITICAL_SECTION
+{
+	pthread_mutex_t	hMutex;
+} CRITICAL_SECTION;
+
+inline void InitializeCriticalSection(CRITICAL_SECTION *pcs)
+{
+	pthread_mutexattr_t Attr;
+	pthread_mutexattr_init(&Attr);
+	pthread_mutexattr_settype(&Attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&pcs->hMutex, &Attr);
+	pthread_mutexattr_destroy(&Attr);
+}
+inline BOOL InitializeCriticalSectionAndSpinCount(CRITICAL_SECTION *pcs, DWORD)	{ InitializeCriticalSection(pcs); return TRUE; }
+inline void DeleteCriticalSection(CRITICAL_SECTION *pcs)			{ pthread_mutex_destroy(&pcs->hMutex); }
+inline void EnterCriticalSection(CRITICAL_SECTION *pcs)				{ pthread_mutex_lock(&pcs->hMutex); }
+inline void LeaveCriticalSection(CRITICAL_SECTION *pcs)				{ pthread_mutex_unlock(&pcs->hMutex); }
+inline BOOL TryEnterCriticalSection(CRITICAL_SECTION *pcs)			{ return pthread_mutex_trylock(&pcs->hMutex) == 0; }
+
+// ʱ
+inline int64_t PortNowNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+inline BOOL QueryPerformanceFrequency(LARGE_INTEGER *pFreq)			{ pFreq->QuadPart = 1000000000LL; return TRUE; }
+inline BOOL QueryPerformanceCounter(LARGE_INTEGER *pCounter)		{ pCounter->QuadPart = PortNowNs(); return TRUE; }
+inline DWORD GetTickCount()											{ return (DWORD)(PortNowNs() / 1000000); }
+inline ULONGLONG GetTickCount64()									{ return (ULONGLONG)(PortNowNs() / 1000000); }
+inline BOOL SwitchToThread()										{ sched_yield(); return TRUE; }
+inline void Sleep(DWORD dwMilliseconds)
+{
+	if (dwMilliseconds == 0)
+	{
+		sched_yield();
+		return;
+	}
+	struct timespec ts = { (time_t)(dwMilliseconds / 1000), (long)(dwMilliseconds % 1000) * 1000000L };
+	while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+		;
+}
+
+// д׼,Թر,൱Windowsûиӵ
+inline volatile LONG &PortDebugOutput()
+{
+	static volatile LONG s_bEnable = TRUE;
+	return s_bEnable;
+}
+inline void OutputDebugStringA(const char *szText)
+{
+	if (PortDebugOutput())
+		fputs(szText, stderr);
+}
+inline DWORD GetCurrentProcessId()								{ return (DWORD)getpid(); }
+inline DWORD GetLastError()											{ return (DWORD)errno; }
+
+// ƽ̨°ַֽTCHAR,·ΪUTF-8
+typedef char			TCHAR;
+typedef const char		*LPCTSTR;
+#define _T(x)					x
+#define MAX_PATH				260
+#define _tcslen					strlen
+#define _tcscmp					strcmp
+#define _stprintf_s				snprintf
+inline int _tcscpy_s(TCHAR *szDst, size_t nSize, const TCHAR *szSrc)
+{
+	if (!szDst || !nSize || !szSrc || strlen(szSrc) >= nSize)
+		return EINVAL;
+	strcpy(szDst, szSrc);
+	return 0;
+}
+inline int _tfopen_s(FILE **pFile, const TCHAR *szPath, const TCHAR *szMode)
+{
+	*pFile = fopen(szPath, szMode);
+	return *pFile ? 0 : errno;
+}
+
+struct SYSTEM_INFO
+{
+	DWORD		dwNumberOfProcessors;
+	DWORD		dwPageSize;
+};
+inline void GetSystemInfo(SYSTEM_INFO *pInfo)
+{
+	pInfo->dwNumberOfProcessors = (DWORD)sysconf(_SC_NPROCESSORS_ONLN);
+	pInfo->dwPageSize = (DWORD)sysconf(_SC_PAGESIZE);
+}
+
+// ֲ߳̾洢,Win32֤Сֵͬ
+#define PORT_TLS_SLOTS			64
+inline PVOID *PortTlsSlots()
+{
+	static thread_local PVOID s_pSlots[PORT_TLS_SLOTS];
+	return s_pSlots;
+}
+inline DWORD TlsAlloc()
+{
+	static volatile LONG s_nNext = 0;
+	LONG nIndex = InterlockedIncrement(&s_nNext) - 1;
+	return nIndex < PORT_TLS_SLOTS ? (DWORD)nIndex : TLS_OUT_OF_INDEXES;
+}
+inline BOOL TlsFree(DWORD)											{ return TRUE; }
+inline PVOID TlsGetValue(DWORD dwIndex)								{ return PortTlsSlots()[dwIndex]; }
+inline BOOL TlsSetValue(DWORD dwIndex, PVOID pValue)				{ PortTlsSlots()[dwIndex] = pValue; return TRUE; }
+
+// ں˶
+enum PortObjectType
+{
+	PortObject_Event,
+	PortObject_Semaphore,
+	PortObject_Thread
+};
+
+struct PortObject
+{
+	PortObjectType	nType;
+	LONG			nRefs;				// е̸߳һ
+	bool			bSignaled;
+	bool			bManualReset;		// ¼
+	LONG			nCount;				// źĵǰ
+	LONG			nMaxCount;
+	DWORD			dwThreadId;			// ߳
+	bool			bSuspended;
+	int				nPriority;
+	unsigned		(*pThreadProc)(void *);
+	void			*pThreadParam;
+};
+
+// ں˶õĻ,Լе̱߳
+struct PortKernel
+{
+	pthread_mutex_t	hMutex;
+	pthread_cond_t	hCond;
+	std::map<DWORD, PortObject *> mapThread;
+	PortKernel()
+	{
+		pthread_mutex_init(&hMutex, NULL);
+		pthread_cond_init(&hCond, NULL);
+	}
+};
+inline PortKernel &GetPortKernel()
+{
+	static PortKernel s_Kernel;
+	return s_Kernel;
+}
+
+inline DWORD &PortThreadIdRef()
+{
+	static thread_local DWORD s_dwThreadId = 0;
+	return s_dwThreadId;
+}
+inline DWORD PortNewThreadId()
+{
+	static volatile LONG s_nNextId = 0;
+	return (DWORD)InterlockedIncrement(&s_nNextId) * 4;
+}
+inline DWORD GetCurrentThreadId()
+{
+	DWORD &dwThreadId = PortThreadIdRef();
+	if (!dwThreadId)
+		dwThreadId = PortNewThreadId();
+	return dwThreadId;
+}
+
+// ǰ̵߳α,ֻúͶȡ̵߳ȼ
+#define PORT_CURRENT_THREAD		((HANDLE)(intptr_t)-2)
+inline HANDLE GetCurrentThread()									{ return PORT_CURRENT_THREAD; }
+
+// ʱPortKernel::hMutex
+inline void PortReleaseLocked(PortObject *pObject)
+{
+	if (--pObject->nRefs == 0)
+		delete pObject;
+}
+
+inline BOOL CloseHandle(HANDLE hObject)
+{
+	if (!hObject || hObject == PORT_CURRENT_THREAD)
+		return FALSE;
+	PortKernel &Kernel = GetPortKernel();
+	pthread_mutex_lock(&Kernel.hMutex);
+	PortReleaseLocked((PortObject *)hObject);
+	pthread_mutex_unlock(&Kernel.hMutex);
+	return TRUE;
+}
+
+inline HANDLE CreateEvent(void *, BOOL bManualReset, BOOL bInitialState, const char *)
+{
+	PortObject *pObject = new PortObject();
+	pObject->nType = PortObject_Event;
+	pObject->nRefs = 1;
+	pObject->bManualReset = bManualReset != FALSE;
+	pObject->bSignaled = bInitialState != FALSE;
+	return pObject;
+}
+#define CreateEventA			CreateEvent
+#define CreateEventW			CreateEvent
+
+inline BOOL PortSetSignal(HANDLE hEvent, bool bSignaled)
+{
+	PortKernel &Kernel = GetPortKernel();
+	pthread_mutex_lock(&Kernel.hMutex);
+	((PortObject *)hEvent)->bSignaled = bSignaled;
+	pthread_cond_broadcast(&Kernel.hCond);
+	pthread_mutex_unlock(&Kernel.hMutex);
+	return TRUE;
+}
+inline BOOL SetEvent(HANDLE hEvent)									{ return PortSetSignal(hEvent, true); }
+inline BOOL ResetEvent(HANDLE hEvent)								{ return PortSetSignal(hEvent, false); }
+
+inline HANDLE CreateSemaphore(void *, LONG nInitialCount, LONG nMaximumCount, const char *)
+{
+	PortObject *pObject = new PortObject();
+	pObject->nType = PortObject_Semaphore;
+	pObject->nRefs = 1;
+	pObject->nCount = nInitialCount;
+	pObject->nMaxCount = nMaximumCount;
+	pObject->bSignaled = nInitialCount > 0;
+	return pObject;
+}
+#define CreateSemaphoreA		CreateSemaphore
+#define CreateSemaphoreW		CreateSemaphore
+
+inline BOOL ReleaseSemaphore(HANDLE hSemaphore, LONG nReleaseCount, LONG *pPreviousCount)
+{
+	PortKernel &Kernel = GetPortKernel();
+	PortObject *pObject = (PortObject *)hSemaphore;
+	BOOL bResult = FALSE;
+	pthread_mutex_lock(&Kernel.hMutex);
+	if (pPreviousCount)
+		*pPreviousCount = pObject->nCount;
+	if (nReleaseCount > 0 && pObject->nCount + nReleaseCount <= pObject->nMaxCount)
+	{
+		pObject->nCount += nReleaseCount;
+		pObject->bSignaled = true;
+		pthread_cond_broadcast(&Kernel.hCond);
+		bResult = TRUE;
+	}
+	pthread_mutex_unlock(&Kernel.hMutex);
+	return bResult;
+}
+
+// ȴɹ޸Ķ״̬,Զ¼λ,źһ,ʱPortKernel::hMutex
+inline void PortConsumeLocked(PortObject *pObject)
+{
+	if (pObject->nType == PortObject_Event && !pObject->bManualReset)
+		pObject->bSignaled = false;
+	else if (pObject->nType == PortObject_Semaphore)
+		pObject->bSignaled = --pObject->nCount > 0;
+}
+
+inline DWORD WaitForMultipleObjects(DWORD nCount, const HANDLE *pHandles, BOOL bWaitAll, DWORD dwMilliseconds)
+{
+	PortKernel &Kernel = GetPortKernel();
+	struct timespec tsDeadline;
+	clock_gettime(CLOCK_REALTIME, &tsDeadline);
+	if (dwMilliseconds != INFINITE)
+	{
+		int64_t nNs = tsDeadline.tv_nsec + (int64_t)(dwMilliseconds % 1000) * 1000000;
+		tsDeadline.tv_sec += dwMilliseconds / 1000 + (time_t)(nNs / 1000000000);
+		tsDeadline.tv_nsec = (long)(nNs % 1000000000);
+	}
+	DWORD dwResult = WAIT_TIMEOUT;
+	pthread_mutex_lock(&Kernel.hMutex);
+	for (;;)
+	{
+		DWORD nSignaled = 0, nFirst = nCount;
+		for (DWORD i = 0; i < nCount; i++)
+		{
+			if (((PortObject *)pHandles[i])->bSignaled)
+			{
+				nSignaled++;
+				if (nFirst == nCount)
+					nFirst = i;
+			}
+		}
+		if (bWaitAll ? nSignaled == nCount : nSignaled > 0)
+		{
+			if (bWaitAll)
+			{
+				for (DWORD i = 0; i < nCount; i++)
+					PortConsumeLocked((PortObject *)pHandles[i]);
+			}
+			else
+				PortConsumeLocked((PortObject *)pHandles[nFirst]);
+			dwResult = WAIT_OBJECT_0 + (bWaitAll ? 0 : nFirst);
+			break;
+		}
+		if (dwMilliseconds == 0)
+			break;
+		if (dwMilliseconds == INFINITE)
+			pthread_cond_wait(&Kernel.hCond, &Kernel.hMutex);
+		else if (pthread_cond_timedwait(&Kernel.hCond, &Kernel.hMutex, &tsDeadline) == ETIMEDOUT)
+			dwMilliseconds = 0;		// ʱټһζ״̬
+	}
+	pthread_mutex_unlock(&Kernel.hMutex);
+	return dwResult;
+}
+
+inline DWORD WaitForSingleObject(HANDLE hHandle, DWORD dwMilliseconds)
+{
+	return WaitForMultipleObjects(1, &hHandle, FALSE, dwMilliseconds);
+}
+
+// ߳
+inline void *PortThreadEntry(void *p)
+{
+	PortObject *pObject = (PortObject *)p;
+	PortKernel &Kernel = GetPortKernel();
+	PortThreadIdRef() = pObject->dwThreadId;
+	pthread_mutex_lock(&Kernel.hMutex);
+	while (pObject->bSuspended)
+		pthread_cond_wait(&Kernel.hCond, &Kernel.hMutex);
+	pthread_mutex_unlock(&Kernel.hMutex);
+
+	pObject->pThreadProc(pObject->pThreadParam);
+
+	pthread_mutex_lock(&Kernel.hMutex);
+	Kernel.mapThread.erase(pObject->dwThreadId);
+	pObject->bSignaled = true;
+	pthread_cond_broadcast(&Kernel.hCond);
+	PortReleaseLocked(pObject);
+	pthread_mutex_unlock(&Kernel.hMutex);
+	return NULL;
+}
+
+inline uintptr_t _beginthreadex(void *, unsigned nStackSize, unsigned (*pStartAddress)(void *), void *pArgList, unsigned nInitFlag, unsigned *pThreadId)
+{
+	PortObject *pObject = new PortObject();
+	pObject->nType = PortObject_Thread;
+	pObject->nRefs = 2;
+	pObject->dwThreadId = PortNewThreadId();
+	pObject->bSuspended = (nInitFlag & CREATE_SUSPENDED) != 0;
+	pObject->nPriority = THREAD_PRIORITY_NORMAL;
+	pObject->pThreadProc = pStartAddress;
+	pObject->pThreadParam = pArgList;
+	PortKernel &Kernel = GetPortKernel();
+	pthread_mutex_lock(&Kernel.hMutex);
+	Kernel.mapThread[pObject->dwThreadId] = pObject;
+	pthread_mutex_unlock(&Kernel.hMutex);
+
+	pthread_attr_t Attr;
+	pthread_attr_init(&Attr);
+	pthread_attr_setdetachstate(&Attr, PTHREAD_CREATE_DETACHED);
+	if (nStackSize)
+		pthread_attr_setstacksize(&Attr, nStackSize < PTHREAD_STACK_MIN ? PTHREAD_STACK_MIN : nStackSize);
+	pthread_t hThread;
+	int nError = pthread_create(&hThread, &Attr, PortThreadEntry, pObject);
+	pthread_attr_destroy(&Attr);
+	if (nError)
+	{
+		pthread_mutex_lock(&Kernel.hMutex);
+		Kernel.mapThread.erase(pObject->dwThreadId);
+		pthread_mutex_unlock(&Kernel.hMutex);
+		delete pObject;
+		errno = nError;
+		return 0;
+	}
+	if (pThreadId)
+		*pThreadId = pObject->dwThreadId;
+	return (uintptr_t)pObject;
+}
+
+inline DWORD ResumeThread(HANDLE hThread)
+{
+	PortKernel &Kernel = GetPortKernel();
+	PortObject *pObject = (PortObject *)hThread;
+	pthread_mutex_lock(&Kernel.hMutex);
+	DWORD dwPrevious = pObject->bSuspended ? 1 : 0;
+	pObject->bSuspended = false;
+	pthread_cond_broadcast(&Kernel.hCond);
+	pthread_mutex_unlock(&Kernel.hMutex);
+	return dwPrevious;
+}
+
+// ֻܴ_beginthreadexе߳,̷߳NULL
+inline HANDLE OpenThread(DWORD, BOOL, DWORD dwThreadId)
+{
+	PortKernel &Kernel = GetPortKernel();
+	PortObject *pObject = NULL;
+	pthread_mutex_lock(&Kernel.hMutex);
+	std::map<DWORD, PortObject *>::iterator it = Kernel.mapThread.find(dwThreadId);
+	if (it != Kernel.mapThread.end())
+	{
+		pObject = it->second;
+		pObject->nRefs++;
+	}
+	pthread_mutex_unlock(&Kernel.hMutex);
+	return pObject;
+}
+
+// ̳߳صȴ,ÿȴһ߳,ֻʵWT_EXECUTEONLYONCE
+// UnregisterWaitExǵȴִеĻص,൱CompletionEventΪINVALID_HANDLE_VALUE,ڻصע
+#define WT_EXECUTEONLYONCE		0x00000008
+#define INVALID_HANDLE_VALUE	((HANDLE)(intptr_t)-1)
+typedef VOID (CALLBACK *WAITORTIMERCALLBACK)(PVOID pParam, BOOLEAN bTimeout);
+
+struct PortWait
+{
+	HANDLE				hObject;
+	HANDLE				hCancel;			// ˹λ¼,עʱλ,صδִʱִ
+	DWORD				dwMilliseconds;
+	WAITORTIMERCALLBACK	pCallback;
+	PVOID				pParam;
+	pthread_t			hThread;
+};
+
+inline void *PortWaitEntry(void *p)
+{
+	PortWait *pWait = (PortWait *)p;
+	// ע¼ǰ,ȴͬʱźʱִлص
+	HANDLE hObjects[2] = { pWait->hCancel, pWait->hObject };
+	DWORD dwResult = WaitForMultipleObjects(2, hObjects, FALSE, pWait->dwMilliseconds);
+	if (dwResult != WAIT_OBJECT_0)
+		pWait->pCallback(pWait->pParam, dwResult == WAIT_TIMEOUT);
+	return NULL;
+}
+
+inline BOOL RegisterWaitForSingleObject(HANDLE *phNewWaitObject, HANDLE hObject, WAITORTIMERCALLBACK pCallback, PVOID pContext, DWORD dwMilliseconds, DWORD)
+{
+	PortWait *pWait = new PortWait();
+	pWait->hObject = hObject;
+	pWait->hCancel = CreateEvent(NULL, TRUE, FALSE, NULL);
+	pWait->dwMilliseconds = dwMilliseconds;
+	pWait->pCallback = pCallback;
+	pWait->pParam = pContext;
+	pthread_attr_t Attr;
+	pthread_attr_init(&Attr);
+	pthread_attr_setstacksize(&Attr, 256 * 1024 < PTHREAD_STACK_MIN ? PTHREAD_STACK_MIN : 256 * 1024);
+	int nError = pthread_create(&pWait->hThread, &Attr, PortWaitEntry, pWait);
+	pthread_attr_destroy(&Attr);
+	if (nError)
+	{
+		CloseHandle(pWait->hCancel);
+		delete pWait;
+		errno = nError;
+		return FALSE;
+	}
+	*phNewWaitObject = pWait;
+	return TRUE;
+}
+
+inline BOOL UnregisterWaitEx(HANDLE hWaitHandle, HANDLE)
+{
+	if (!hWaitHandle)
+		return FALSE;
+	PortWait *pWait = (PortWait *)hWaitHandle;
+	SetEvent(pWait->hCancel);
+	pthread_join(pWait->hThread, NULL);
+	CloseHandle(pWait->hCancel);
+	delete pWait;
+	return TRUE;
+}
+
+// ߳ȼֻ¼Ч,_beginthreadex֮߳,ǰ̵߳ȼ¼ֲ߳̾
+inline int &PortCurrentPriority()
+{
+	static thread_local int s_nPriority = THREAD_PRIORITY_NORMAL;
+	return s_nPriority;
+}
+inline BOOL SetThreadPriority(HANDLE hThread, int nPriority)
+{
+	if (hThread == PORT_CURRENT_THREAD)
+		PortCurrentPriority() = nPriority;
+	else
+		((PortObject *)hThread)->nPriority = nPriority;
+	return TRUE;
+}
+inline int GetThreadPriority(HANDLE hThread)
+{
+	if (hThread == PORT_CURRENT_THREAD)
+		return PortCurrentPriority();
+	return ((PortObject *)hThread)->nPriority;
+}
+
+// ֧׺,Win32ʧʱķֵͬ
+inline DWORD_PTR SetThreadAffinityMask(HANDLE, DWORD_PTR)			{ return 0; }
+inline DWORD SetThreadIdealProcessor(HANDLE, DWORD)					{ return (DWORD)-1; }
+
+// ,վβϲ
+inline BOOL IsRectEmpty(const RECT *pRect)
+{
+	return pRect->right <= pRect->left || pRect->bottom <= pRect->top;
+}
+inline BOOL OffsetRect(RECT *pRect, int dx, int dy)
+{
+	pRect->left += dx;
+	pRect->right += dx;
+	pRect->top += dy;
+	pRect->bottom += dy;
+	return TRUE;
+}
+inline BOOL UnionRect(RECT *pDst, const RECT *pSrc1, const RECT *pSrc2)
+{
+	if (IsRectEmpty(pSrc1) && IsRectEmpty(pSrc2))
+	{
+		ZeroMemory(pDst, sizeof(RECT));
+		return FALSE;
+	}
+	if (IsRectEmpty(pSrc1))
+		*pDst = *pSrc2;
+	else if (IsRectEmpty(pSrc2))
+		*pDst = *pSrc1;
+	else
+	{
+		RECT rtUnion;
+		rtUnion.left = pSrc1->left < pSrc2->left ? pSrc1->left : pSrc2->left;
+		rtUnion.top = pSrc1->top < pSrc2->top ? pSrc1->top : pSrc2->top;
+		rtUnion.right = pSrc1->right > pSrc2->right ? pSrc1->right : pSrc2->right;
+		rtUnion.bottom = pSrc1->bottom > pSrc2->bottom ? pSrc1->bottom : pSrc2->bottom;
+		*pDst = rtUnion;
+	}
+	return TRUE;
+}
+
+// D3D9ֻṩģõĸʽ,豸ͱӿֻΪ͸ָ봫
+#define MAKEFOURCC(ch0, ch1, ch2, ch3)	((DWORD)(BYTE)(ch0) | ((DWORD)(BYTE)(ch1) << 8) | ((DWORD)(BYTE)(ch2) << 16) | ((DWORD)(BYTE)(ch3) << 24))
+typedef DWORD			D3DFORMAT;
+#define D3DFMT_UNKNOWN			((D3DFORMAT)0)
+#define D3DFMT_R8G8B8			((D3DFORMAT)20)
+#define D3DFMT_A8R8G8B8			((D3DFORMAT)21)
+#define D3DFMT_X8R8G8B8			((D3DFORMAT)22)
+#define D3DFMT_R5G6B5			((D3DFORMAT)23)
+#define D3DFMT_X1R5G5B5			((D3DFORMAT)24)
+#define D3DFMT_A1R5G5B5			((D3DFORMAT)25)
+struct IDirect3DDevice9;
+struct IDirect3DSurface9;
+#endif
@@ -56,6 +56,7 @@ CMultiDecoderDlg::CMultiDecoderDlg(CWnd* pParent /*=NULL*/)
 	: CDialogEx(CMultiDecoderDlg::IDD, pParent)
 {
 	m_hIcon = AfxGetApp()->LoadIcon(IDR_MAINFRAME);
+	m_Channels.SetCallback(OnChannelStop, OnChannelExit, this);
 }
 
 void CMultiDecoderDlg::DoDataExchange(CDataExchange* pDX)
@@ -77,6 +78,10 @@ BEGIN_MESSAGE_MAP(CMultiDecoderDlg, CDialogEx)
 	ON_COMMAND(ID_FILE_SWITCHVIDEO, &CMultiDecoderDlg::OnFileSwitchvideo)
 	ON_WM_TIMER()
 	ON_COMMAND(ID_DECODER_SETTING, &CMultiDecoderDlg::OnDecoderSetting)
+	ON_COMMAND(ID_FILE_EXPORTTIMELINE, &CMultiDecoderDlg::OnFileExportTimeline)
+	ON_COMMAND(ID_FILE_RECORD, &CMultiDecoderDlg::OnFileRecord)
+	ON_MESSAGE(WM_CHANNELSTOPPED, &CMultiDecoderDlg::OnChannelStopped)
+	ON_MESSAGE(WM_PANELSELECTED, &CMultiDecoderDlg::OnPanelSelected)
 END_MESSAGE_MAP()
 
 #define GetDlgItemRect(nID,Rt) { GetDlgItem(nID)->GetWindowRect(&Rt); ScreenToClient(&Rt);}
@@ -118,10 +123,29 @@ BOOL CMultiDecoderDlg::OnInitDialog()
 // 	GetDlgItemRect(IDC_STATIC_VIDEO, rtClient);
 	m_pVideoWndFrame = new CVideoFrame;	
 	m_pVideoWndFrame->Create(1024, rtClient,1,1, this);
+	LoadOptions();
+	if (m_bTscClock)
+		MonoClockEnableTscAsync();	// TSCȡʱ,ں̨߳У׼Լ50,У׼֮ǰʹQueryPerformanceCounter
 	
 	return TRUE;  // ǽõؼ򷵻 TRUE
 }
 
+#define _OPTION_SECTION		_T("Options")
+
+void CMultiDecoderDlg::LoadOptions()
+{
+	CWinApp *pApp = AfxGetApp();
+	m_nHeadlessRender = pApp->GetProfileInt(_OPTION_SECTION, _T("HeadlessRender"), m_nHeadlessRender);
+	m_bBatchPresent = pApp->GetProfileInt(_OPTION_SECTION, _T("BatchPresent"), m_bBatchPresent);
+	m_bTimelineTrace = pApp->GetProfileInt(_OPTION_SECTION, _T("TimelineTrace"), m_bTimelineTrace);
+	m_bTscClock = pApp->GetProfileInt(_OPTION_SECTION, _T("TscClock"), m_bTscClock);
+	m_bLockProfile = pApp->GetProfileInt(_OPTION_SECTION, _T("LockProfile"), m_bLockProfile);
+	m_nMemoryTraceInterval = pApp->GetProfileInt(_OPTION_SECTION, _T("MemoryTraceInterval"), m_nMemoryTraceInterval);
+	m_nLocateChannel = pApp->GetProfileInt(_OPTION_SECTION, _T("LocateChannel"), m_nLocateChannel);
+	m_nLocateTime = pApp->GetProfileInt(_OPTION_SECTION, _T("LocateTime"), m_nLocateTime);
+	m_nPlacementPolicy = pApp->GetProfileInt(_OPTION_SECTION, _T("PlacementPolicy"), m_nPlacementPolicy);
+}
+
 void CMultiDecoderDlg::OnSysCommand(UINT nID, LPARAM lParam)
 {
 	if ((nID & 0xFFF0) == IDM_ABOUTBOX)
@@ -174,6 +198,12 @@ HCURSOR CMultiDecoderDlg::OnQueryDragIcon()
 void CMultiDecoderDlg::OnFileStart()
 {
 	TCHAR szText[MAX_PATH] = { 0 };
+	if (m_nLocateTime)
+	{// ֻλһ,˺󲥷Žеļ
+		UINT nLocateTime = m_nLocateTime;
+		m_nLocateTime = 0;
+		LocateRecord(m_nLocateChannel, nLocateTime);
+	}
 	if (!PathFileExists((LPCTSTR)m_strFilePath))
 	{
 		_stprintf_s(szText, MAX_PATH, _T("Ҳ\"%s\"ļ."), m_strFilePath);
@@ -189,28 +219,81 @@ void CMultiDecoderDlg::OnFileStart()
 	{
 		m_pVideoWndFrame->AdjustPanels(m_nRenderCount);
 	}
-	m_hThreadArray = new HANDLE[m_nDecodeCount + 1];
+	if (m_nRenderCount > _MOSAIC_RENDER_THRESHOLD)
+	{// Ⱦ·϶ʱ,дϳΪһͼʾ,崰ֻΪıʶ
+		CRect rtFrame;
+		m_pVideoWndFrame->GetClientRect(&rtFrame);
+		m_pMosaic = new CMosaicCompositor;
+		if (m_pMosaic->Create(m_pVideoWndFrame->GetSafeHwnd(), rtFrame.Width(), rtFrame.Height()))
+		{
+			for (int i = 0; i < m_pVideoWndFrame->GetPanelCount(); i++)
+			{
+				HWND hPanelWnd = m_pVideoWndFrame->GetPanelWnd(i);
+				m_pMosaic->AddTile(hPanelWnd, *m_pVideoWndFrame->GetPanelRect(i));
+				::ShowWindow(hPanelWnd, SW_HIDE);
+			}
+			m_pMosaic->Start();
+		}
+		else
+		{
+			DxTraceMsg("%s Failed to create mosaic compositor,fall back to per-channel rendering.\n", __FUNCTION__);
+			delete m_pMosaic;
+			m_pMosaic = nullptr;
+		}
+	}
+	if (!m_pMosaic && m_bBatchPresent)
+	{// ͬһʾϵϲΪһPresent,޴ģʽֻʾĵ߼
+		m_pBatchGroup = new CPresentBatchGroup;
+		m_pBatchGroup->SetPresentWnd(m_nHeadlessRender != Headless_None ? NULL : m_pVideoWndFrame->GetSafeHwnd());
+		for (int i = 0; i < m_pVideoWndFrame->GetPanelCount(); i++)
+			m_pBatchGroup->AddPanel(m_pVideoWndFrame->GetPanelWnd(i), *m_pVideoWndFrame->GetPanelRect(i));
+		if (m_pBatchGroup->Start(m_nRenderInterval))
+		{
+			if (m_nHeadlessRender == Headless_None)
+			{
+				for (int i = 0; i < m_pVideoWndFrame->GetPanelCount(); i++)
+					::ShowWindow(m_pVideoWndFrame->GetPanelWnd(i), SW_HIDE);
+			}
+		}
+		else
+		{
+			DxTraceMsg("%s Failed to start batched present,fall back to per-channel present.\n", __FUNCTION__);
+			delete m_pBatchGroup;
+			m_pBatchGroup = nullptr;
+		}
+	}
 	m_bInputThreadRun = true;
+	g_LatencyMonitor.Reset();
+	g_MemoryAccount.Reset();
+	g_LoadShedder.Reset();
+	if (m_nMemoryTraceInterval > 0)
+		SetTimer(ID_TRACE_MEMORY, m_nMemoryTraceInterval, nullptr);
+	if (m_bTimelineTrace)
+		TimelineEnable(true);		// ڸ֮߳ǰ,߳ʱܵǼ߳
+	g_ThreadPlacement.SetPolicy((PlacementPolicy)m_nPlacementPolicy);	// ڸ֮߳ǰ,߳̿ʼʱԷ
+	if (m_bLockProfile)
+	{
+		LockProfileReset();
+		LockProfileEnable(true);
+	}
 	
-	m_hThreadArray[0] = (HANDLE)_beginthreadex(nullptr, 0, InputThread, this, 0, nullptr);
+	m_Channels.Add(_INPUT_CHANNEL, InputThread, this);
 
+	// ߳ȹ,̶߳ļͳһʼ
 	for (int i = 0; i < m_nDecodeCount; i++)
 	{
-		ThreadParamPtr pTP = make_shared<ThreadParam>();
-		pTP->nThreadIndex = i;
-		pTP->bThreadRun = true;
-		pTP->hRenderWnd = m_pVideoWndFrame->GetPanelWnd(i);
+		HWND hPanelWnd = m_pVideoWndFrame->GetPanelWnd(i);
+		ThreadParamPtr pTP = CreateChannel(i, hPanelWnd);
+		if (!m_Channels.Add(i, m_bEnableHaccel ? DXVADecodeThread : DecodeThread, pTP.get(), true))
+			break;
 		m_pVideoWndFrame->SetPanelParam(i,pTP.get());
-		pTP->pThis = this;
-		if (m_bEnableHaccel)
-			m_hThreadArray[i + 1] = (HANDLE)_beginthreadex(nullptr, 0, DXVADecodeThread, pTP.get(), CREATE_SUSPENDED, nullptr);
-		else 
-			m_hThreadArray[i + 1] = (HANDLE)_beginthreadex(nullptr, 0, DecodeThread, pTP.get(), CREATE_SUSPENDED, nullptr);
 		m_vecTP.push_back(pTP);
 	}
+	m_nDecodeCount = m_vecTP.size();
 	m_nCurRender1st = 0;
 	m_nCurRenderlast = m_nRenderCount - 1;
 	DxTraceMsg("%s RenderRange(%d,%d).\n",__FUNCTION__, m_nCurRender1st, m_nCurRenderlast);
+	UpdateChannelPriority();
 }
 
 void CMultiDecoderDlg::OnFileSwitchvideo()
@@ -254,6 +337,7 @@ void CMultiDecoderDlg::OnFileSwitchvideo()
 		m_nCurRenderlast = i;
 	}
 	DxTraceMsg("%s New RenderRange(%d,%d).\n", __FUNCTION__, m_nCurRender1st, m_nCurRenderlast);
+	UpdateChannelPriority();
 	SetTimer(ID_INVLIAD_PANEL,1000,nullptr);
 }
 
@@ -262,28 +346,54 @@ void CMultiDecoderDlg::OnFileStop()
 	CWaitCursor Wait;
 	m_bInputThreadRun = false;
 	//m_bDecodeThreadRun = false;
-	if (m_hThreadArray)
+	// ֪̺ͨ߳н߳˳,˳еƳͨ,һ¼ϵȴȫ˳
+	m_Channels.Shutdown();
+
+	if (m_pMosaic)
 	{
-		for (int i = 0; i < m_nDecodeCount; i++)
-		{
-			ResumeThread(m_hThreadArray[i + 1]);
-			m_vecTP[i]->bThreadRun = false;
-		}
-		int nWaits = (m_nDecodeCount + 1) / 64;
-		if ((m_nDecodeCount + 1) % 64 != 0)
-			nWaits++;
-		int i = 0;
-		for (i = 0; i < nWaits - 1; i++)
-		{
-			WaitForMultipleObjects(64, (HANDLE *)&m_hThreadArray[i], TRUE, INFINITE);
-		}
-		WaitForMultipleObjects((m_nDecodeCount + 1) - 64 * i, (HANDLE *)&m_hThreadArray[i * 64], TRUE, INFINITE);
+		m_pMosaic->Stop();
+		m_pMosaic->TraceStat();
+		delete m_pMosaic;
+		m_pMosaic = nullptr;
+		for (int i = 0; i < m_pVideoWndFrame->GetPanelCount(); i++)
+			::ShowWindow(m_pVideoWndFrame->GetPanelWnd(i), SW_SHOW);
 	}
-
+	if (m_pBatchGroup)
+	{
+		m_pBatchGroup->TraceStat();
+		m_pBatchGroup->Stop();
+		delete m_pBatchGroup;
+		m_pBatchGroup = nullptr;
+		for (int i = 0; i < m_pVideoWndFrame->GetPanelCount(); i++)
+			::ShowWindow(m_pVideoWndFrame->GetPanelWnd(i), SW_SHOW);
+	}
+	for (int i = 0; i < m_vecTP.size(); i++)
+		StopRecord(i);
+	for (int i = 0; i < m_pVideoWndFrame->GetPanelCount(); i++)
+		m_pVideoWndFrame->SetPanelParam(i, nullptr);
+	m_vecTP.clear();
+	m_listDraining.clear();
+	ReleaseRecycledSurface();
 	m_pVideoWndFrame->Invalidate(TRUE);
-	delete []m_hThreadArray;
-	m_hThreadArray = nullptr;
 	m_InputQueue.clear();
+	m_Channels.TraceStat();
+	g_SwsContextCache.TraceStat();
+	g_FramePool.TraceStat();
+	g_SnapshotService.TraceStat();
+	g_LatencyMonitor.TraceStat();
+	g_LoadShedder.TraceStat();
+	if (m_bLockProfile)
+	{
+		LockProfileEnable(false);
+		LockProfileTrace();
+	}
+	KillTimer(ID_TRACE_MEMORY);
+	g_MemoryAccount.TraceStat();
+	if (m_bTimelineTrace)
+	{
+		ExportTimeline(_T("Timeline.json"));
+		TimelineEnable(false);
+	}
 }
 
 void CMultiDecoderDlg::OnFileDecodeconfig()
@@ -308,6 +418,7 @@ void CMultiDecoderDlg::OnFileDecodeconfig()
 	if (dlg.DoModal() == IDOK)
 	{
 		m_strFilePath	 = dlg.m_strFilePath;
+		m_nStartOffset	 = 0;
 		m_nDecodeCount	 = dlg.m_nDecodeCount;
 		m_bRender		 = dlg.m_bRender;
 		m_nRenderCount	 = dlg.m_nRenderCount;
@@ -336,6 +447,12 @@ UINT CMultiDecoderDlg::InputThread(void *p)
 		DxTraceMsg("ҲƵϢ:%s.\r\n", szAvError);
 		return 0;
 	}
+	if (pThis->m_nStartOffset > 0)
+	{// LocateRecordλʱ俪ʼ,˵ʱ֮ǰĹؼ֡
+		int64_t nSeekTime = pThis->m_nStartOffset + (pFormatCtx->start_time != AV_NOPTS_VALUE ? pFormatCtx->start_time : 0);
+		if (av_seek_frame(pFormatCtx, -1, nSeekTime, AVSEEK_FLAG_BACKWARD) < 0)
+			DxTraceMsg("%s Failed to seek to %I64dus.\n", __FUNCTION__, pThis->m_nStartOffset);
+	}
 	int videoindex = 0;
 	int i = 0;
 	for (i = 0; i < pFormatCtx->nb_streams; i++)
@@ -352,6 +469,14 @@ UINT CMultiDecoderDlg::InputThread(void *p)
 
 	AVCodecContext *pCodecCtx = pFormatCtx->streams[videoindex]->codec;
 	AVCodec *pCodec = avcodec_find_decoder(pCodecCtx->codec_id);
+	// ƵĲ,ֱͨ¼ʱݴ˴
+	if (pThis->m_pInputCodecCtx)
+		avcodec_free_context(&pThis->m_pInputCodecCtx);
+	pThis->m_pInputCodecCtx = avcodec_alloc_context3(NULL);
+	if (pThis->m_pInputCodecCtx && avcodec_copy_context(pThis->m_pInputCodecCtx, pCodecCtx) < 0)
+		avcodec_free_context(&pThis->m_pInputCodecCtx);
+	pThis->m_nInputTimeBase = pFormatCtx->streams[videoindex]->time_base;
+	pThis->m_nInputFrameRate = av_guess_frame_rate(pFormatCtx, pFormatCtx->streams[videoindex], NULL);
 
 	if ((nAvError = avcodec_open2(pCodecCtx, pCodec, NULL)) < 0)
 	{
@@ -361,15 +486,22 @@ UINT CMultiDecoderDlg::InputThread(void *p)
 	}
 	bool bResumed = false;
 	AVPacket *packet = (AVPacket *)av_malloc(sizeof(AVPacket));
+	TimelineSetThreadName("Input");
+	g_ThreadPlacement.Apply(ThreadRole_Input, _INPUT_CHANNEL);
 	while (pThis->m_bInputThreadRun)
 	{
+		CTimelineScope ReadScope("av_read_frame", -1);
 		if (nAvError = av_read_frame(pFormatCtx, packet) < 0)
 		{
 			av_strerror(nAvError, szAvError, 1024);
 			DxTraceMsg("ȡƵ֡ʧ:%s.\n", szAvError);
 			goto Resume; 
 		}
+		ReadScope.End();
 		FramePtr pFrame = make_shared<Frame>((byte *)packet->data, packet->size);
+		pFrame->bKeyFrame = (packet->flags & AV_PKT_FLAG_KEY) != 0;
+		pFrame->nPts = packet->pts;
+		pFrame->nDts = packet->dts;
 		pThis->m_InputQueue.push_back(pFrame);		
 		av_packet_unref(packet);
 	}
@@ -379,10 +511,7 @@ Resume:
 	avformat_close_input(&pFormatCtx);
 	if (!bResumed && pThis->m_InputQueue.size() > 1)
 	{
-		for (int i = 0; i < pThis->m_nDecodeCount; i++)
-		{
-			::ResumeThread(pThis->m_hThreadArray[i + 1]);
-		}
+		pThis->m_Channels.ResumeAll();
 		bResumed = true;
 	}
 	return 0;
@@ -390,7 +519,15 @@ Resume:
 
 struct AvQueue
 {
+	AvQueue(CMultiDecoderDlg *pDlg, ThreadParam *pThreadParam)
+		: pThis(pDlg)
+		, TPPtr(pThreadParam)
+		, RecordCursor(pDlg->m_InputQueue.end())
+	{
+	}
 	CMultiDecoderDlg *pThis;
+	ThreadParam *TPPtr;
+	InputRecordCursor RecordCursor;		// Ӳ߳ͬ,ȡ֡¼
 	list<FramePtr>::iterator ItLoop;
 	uint8_t *pAvBuffer;
 	uint8_t *pOriBuffer;
@@ -404,6 +541,8 @@ int ReadAvData(void *opaque, uint8_t *buf, int buf_size)
  	
 	int nReturnVal = buf_size;
 	pAvQueue->pAvBuffer = buf;
+	if (pAvQueue->nOffset == 0)		// ʼȡһµ֡
+		CMultiDecoderDlg::RecordInputFrame(pAvQueue->TPPtr, pAvQueue->RecordCursor, pAvQueue->ItLoop);
 	int nRemainedLength = (*(pAvQueue->ItLoop))->nLength - pAvQueue->nOffset;
 	if (nRemainedLength > buf_size)
 	{
@@ -428,14 +567,30 @@ int ReadAvData(void *opaque, uint8_t *buf, int buf_size)
 	return nReturnVal;// (*(pAvQueue->ItLoop))->nLength;
 }
 
+// ѡеֻͨҪɼʾÿһ֡,С֡
+static bool ShouldRenderChannel(ThreadParam *TPPtr, ChannelPriority nPriority, int nVideoWidth, int nVideoHeight)
+{
+	return TPPtr->Throttle.ShouldRender(TPPtr->hRenderWnd, nVideoWidth, nVideoHeight, nPriority == ChannelPriority_Selected);
+}
+
 UINT CMultiDecoderDlg::DecodeThread(void *p)
 {
 	ThreadParam *TPPtr = (ThreadParam *)p;	
 	CMultiDecoderDlg *pThis = TPPtr->pThis;
+	g_MemoryAccount.SetThreadChannel(TPPtr->nThreadIndex);
 	int nAvError = 0;
-	AvQueue *pAvQueue = new AvQueue;
-	pAvQueue->pThis = pThis;
+	AvQueue *pAvQueue = new AvQueue(pThis, TPPtr);
 	pAvQueue->ItLoop = pThis->m_InputQueue.begin();
+	// δʹƴӺϳʱ,ͨȾ߳ʾͼ,ֻ߳Ͷ֡,ٱPresent豸ʧĻָ
+	RenderInitParam InitParam = { TPPtr->hRenderWnd, nullptr, false };
+	CRenderStage RenderStage;
+	bool bRenderStage = false;
+	CChannelLatency *pLatency = TPPtr->pLatency;
+	TPPtr->pDxSurface->SetLatency(pLatency);
+	RenderStage.SetLatency(pLatency);
+	RenderStage.SetChannel(TPPtr->nThreadIndex);
+	if (TPPtr->hRenderWnd && !pThis->m_pMosaic)
+		bRenderStage = RenderStage.Start(TPPtr->pDxSurface, InitRenderSurface, &InitParam, pThis->m_nRenderInterval);
 	pAvQueue->nOffset = 0;
 	char szAvError[1024] = { 0 };
 	
@@ -511,32 +666,60 @@ UINT CMultiDecoderDlg::DecodeThread(void *p)
 		DxTraceMsg("%s avcodec_find_decoder Failed.\n", __FUNCTION__);
 		return -1;
 	}
+	// ü֡,ͶݵȾ߳ʱֻ,ͷ֮ǰḴø֡Ļ
+	pAvCodecCtx->refcounted_frames = 1;
 	if ((nAvError = avcodec_open2(pAvCodecCtx, pAvCodec, NULL)) < 0)
 	{
 		av_strerror(nAvError, szAvError, 1024);
 		DxTraceMsg("%s avcodec_open2 Failed:%s.\n", __FUNCTION__, szAvError);
 		return 0;
 	}
-	double dfT1 = 0.0f;
-	double dfT2 = 0.0f;
-	double dfTimeSpan = 0.0f;
+	int64_t nT1 = 0;
+	int64_t nT2 = 0;
+	LONGLONG nCodecBytes = 0;		// ڲο֡Ĺֽ
 	AVPacket *pAvPacket = (AVPacket *)av_malloc(sizeof(AVPacket));
 	av_init_packet(pAvPacket);
 	
 	int nGot_picture = 0;
 	AVFrame *pAvFrame = av_frame_alloc();
 	DWORD nResult = 0;
-	int nTimeSpan = 0;
 	int nFrameInterval = 40;
+	// DXVA߳ͬ,ʱ̿ƽĽ,رÿĵӳ
+	CMonoPacer Pacer(nFrameInterval * MONO_NS_PER_MS);
+	// ƴӺϳɺʾʱ崰ڱ,ɺϳʾ,ʱ崰ڽ֡
+	bool bThrottle = !pThis->m_pMosaic && !pThis->m_pBatchGroup;
+	ChannelPriority nCurPriority = ChannelPriority_Visible;		// ̵߳ĬȼTHREAD_PRIORITY_NORMALӦ
 	pAvQueue->ItLoop = pThis->m_InputQueue.begin();
 	//av_free(pAvBuffer);
+	TimelineSetThreadName("Decode", TPPtr->nThreadIndex);
+	g_ThreadPlacement.Apply(ThreadRole_Decode, TPPtr->nThreadIndex);
 	while (TPPtr->bThreadRun)
 	{
+		int64_t nRead = MonoTimeNs();
+		CTimelineScope ReadScope("av_read_frame");
 		if (av_read_frame(pFormatCtx, pAvPacket) >= 0)
 		//if (ItLoop != pThis->m_InputQueue.end())
 		{
-			dfT1 = GetExactTime();					
+			ReadScope.End();
+			nT1 = MonoTimeNs();
+			pLatency->Record(LatencyStage_Read, nRead, nT1);
+			ChannelPriority nPriority = (ChannelPriority)TPPtr->nPriority;
+			if (nPriority != nCurPriority)
+			{// ѡ򲼾ָıȾ̵߳ȼ
+				nCurPriority = nPriority;
+				SetThreadPriority(GetCurrentThread(), CLoadShedder::GetThreadPriority(nPriority));
+				RenderStage.SetPriority(CLoadShedder::GetThreadPriority(nPriority));
+			}
+			// ʱͨȼ֡,岻ɼʱֻο֡
+			AVDiscard nDiscard = g_LoadShedder.GetDiscard(nPriority);
+			if (bThrottle)
+				nDiscard = TPPtr->Throttle.AdjustDiscard(TPPtr->hRenderWnd, pAvCodecCtx->width, pAvCodecCtx->height, nDiscard);
+			pAvCodecCtx->skip_frame = nDiscard;
+			nT2 = MonoTimeNs();
+			CTimelineScope DecodeScope("avcodec_decode", TIMELINE_CURRENT_CHANNEL, pAvPacket->pts);
 			nAvError = avcodec_decode_video2(pAvCodecCtx, pAvFrame, &nGot_picture, pAvPacket);
+			DecodeScope.End();
+			pLatency->Record(LatencyStage_Decode, nT2, MonoTimeNs());
 			if (nAvError < 0)
 			{
 				av_strerror(nAvError, szAvError, 1024);
@@ -546,50 +729,48 @@ UINT CMultiDecoderDlg::DecodeThread(void *p)
 			av_packet_unref(pAvPacket);
 			if (nGot_picture)
 			{
-				if (TPPtr->hRenderWnd)
-				{
-					// ʹ߳CDxSurfaceʾͼ
-					if (!TPPtr->pDxSurface->IsInited())		// D3D豸δ,˵δʼ
+				if (!nCodecBytes)
+				{// ڲķ޷ͳ,һ֡ĳߴͽͬʱе֡
+					int nFrameSize = av_image_get_buffer_size((AVPixelFormat)pAvFrame->format, pAvFrame->width, pAvFrame->height, FRAMEPOOL_ALIGN);
+					int nFrames = pAvCodecCtx->refs + pAvCodecCtx->has_b_frames + max(pAvCodecCtx->thread_count, 1) + 1;
+					if (nFrameSize > 0)
 					{
-						DxSurfaceInitInfo InitInfo;
-						InitInfo.nFrameWidth = pAvFrame->width;
-						InitInfo.nFrameHeight = pAvFrame->height;
-						InitInfo.nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2');
-						InitInfo.bWindowed = TRUE;
-						InitInfo.hPresentWnd = TPPtr->hRenderWnd;
-					
-							if (!TPPtr->pDxSurface->InitD3D(InitInfo.hPresentWnd,
-								InitInfo.nFrameWidth,
-								InitInfo.nFrameHeight,
-								InitInfo.bWindowed,
-								InitInfo.nD3DFormat))
-							{
-								assert(false);
-								return 0;
-							}
-						//::SendMessageTimeout(pThis->m_hWnd, WM_INITDXSURFACE, (WPARAM)TPPtr->pDxSurface, (LPARAM)&InitInfo, SMTO_BLOCK, 500, (PDWORD_PTR)&nResult);
+						nCodecBytes = (LONGLONG)nFrameSize * nFrames;
+						g_MemoryAccount.Alloc(MemTag_Codec, TPPtr->nThreadIndex, nCodecBytes);
 					}
+				}
+				if (TPPtr->hRenderWnd && (!bThrottle || ShouldRenderChannel(TPPtr, nCurPriority, pAvFrame->width, pAvFrame->height)))
+				{
 					//::SendMessageTimeout(pThis->m_hWnd, WM_RENDERFRAME, (WPARAM)TPPtr->pDxSurface, (LPARAM)pAvFrame, SMTO_BLOCK, 500, (PDWORD_PTR)&nResult);
-					TPPtr->pDxSurface->Render(pAvFrame);
+					if (pThis->m_pMosaic)
+						pThis->m_pMosaic->SubmitFrame(TPPtr->hRenderWnd, pAvFrame);
+					else if (bRenderStage)
+						RenderStage.Post(pAvFrame);
+					else if (TPPtr->pDxSurface->IsInited() || InitRenderSurface(TPPtr->pDxSurface, pAvFrame, &InitParam))
+						TPPtr->pDxSurface->Render(pAvFrame);
 				}
 				av_frame_unref(pAvFrame);
 			}
-			else
+			else if (pAvCodecCtx->skip_frame == AVDISCARD_DEFAULT)
 			{
 				DxTraceMsg("ʧ.\n");
 			}
-			nTimeSpan = (int)(1000 *(GetExactTime() - dfT1));
-			int nSleepTime = nFrameInterval - nTimeSpan;
-// 			if (nSleepTime > 0)
-// 				Sleep(nSleepTime);
-			
+			g_LoadShedder.ReportLate(Pacer.Wait(), Pacer.GetInterval());
 		}
 		else
 			break;
 	}
-	
+	if (bRenderStage)
+	{
+		RenderStage.Stop();
+		RenderStage.TraceStat();
+	}
+	if (bThrottle)
+		TPPtr->Throttle.TraceStat(__FUNCTION__, TPPtr->nThreadIndex);
 	av_frame_free(&pAvFrame);
 	avcodec_close(pAvCodecCtx);
+	if (nCodecBytes)
+		g_MemoryAccount.Free(MemTag_Codec, TPPtr->nThreadIndex, nCodecBytes);
 	avformat_close_input(&pFormatCtx);
 	avformat_free_context(pFormatCtx);	
 	av_free(pAvPacket);
@@ -604,28 +785,17 @@ UINT CMultiDecoderDlg::DecodeThread(void *p)
 /// @remark ҪתYUV420PʽUV
 void CopyNV12ToYV12(byte *pYV12, byte *pNV12[2], int src_pitch[2], unsigned width, unsigned height)
 {
+	// YV12ͼпͼͬ,Vǰ,Uں
+	UINT heithtUV = (height + 1) / 2;
+	UINT widthUV = (width + 1) / 2;
 	byte* dstV = pYV12 + width*height;
-	byte* dstU = pYV12 + width*height / 4;
-	UINT heithtUV = height / 2;
-	UINT widthUV = width / 2;
-	byte *pSrcUV = pNV12[1];
-	byte *pSrcY = pNV12[0];
-	int &nYpitch = src_pitch[0];
-	int &nUVpitch = src_pitch[1];
+	byte* dstU = dstV + widthUV*heithtUV;
 
 	// Y
-	for (int i = 0; i < height; i++)
-		memcpy(pYV12 + i*width, pSrcY + i*nYpitch, width);
+	CopyPlane(pYV12, width, pNV12[0], src_pitch[0], width, height);
 
 	// VU
-	for (int i = 0; i < heithtUV; i++)
-	{
-		for (int j = 0; j < width; j++)
-		{
-			dstU[i*widthUV + j] = pSrcUV[i*nUVpitch + 2 * j];
-			dstV[i*widthUV + j] = pSrcUV[i*nUVpitch + 2 * j + 1];
-		}
-	}
+	SplitUV(dstU, widthUV, dstV, widthUV, pNV12[1], src_pitch[1], widthUV, heithtUV);
 }
 
 int dxva2_retrieve_data(AVFrame **pDstFrame, AVFrame *frame)
@@ -664,7 +834,7 @@ int dxva2_retrieve_data(AVFrame **pDstFrame, AVFrame *frame)
 
 	av_image_copy_plane((*pDstFrame)->data[1], (*pDstFrame)->linesize[1],
 		(uint8_t*)LockedRect.pBits + LockedRect.Pitch * surfaceDesc.Height,
-		LockedRect.Pitch, frame->width, frame->height / 2);
+		LockedRect.Pitch, (frame->width + 1) & ~1, (frame->height + 1) / 2);
 
 	IDirect3DSurface9_UnlockRect(surface);
 
@@ -679,6 +849,7 @@ fail:
 }
 
 /// @brief DxvaӲ֡תNV12ͼ
+/// @remark ֧NV12P010ֱʽ
 void CopyFrame(AVFrame *pFrameYUV420P, AVFrame *pAvFrameDXVA)
 {
 	if (pAvFrameDXVA->format != AV_PIX_FMT_DXVA2_VLD)
@@ -694,175 +865,482 @@ void CopyFrame(AVFrame *pFrameYUV420P, AVFrame *pAvFrameDXVA)
 		DxTraceMsg("%s IDirect3DSurface9::LockRect failed:hr = %08.\n", __FUNCTION__, hr);
 		return;
 	}
+	if (SurfaceDesc.Format == (D3DFORMAT)FOURCC_P010)
+	{// 10bit HEVCӲP010,ҪתΪ8bit
+		CopyP010ToYUV420P(pFrameYUV420P->data, pFrameYUV420P->linesize, (byte *)lRect.pBits, lRect.Pitch, SurfaceDesc.Height, pFrameYUV420P->width, pFrameYUV420P->height);
+		pSurface->UnlockRect();
+		return;
+	}
 
 	//CopyFrameNV12((BYTE *)lRect.pBits, pFrameNV12->data[0], pFrameNV12->data[1], SurfaceDesc.Height, pFrameNV12->height, lRect.Pitch);
 	
 	// Yͼ
 	byte *pSrcY = (byte *)lRect.pBits;
-	// UVͼ
-	//byte *pSrcUV = (byte *)lRect.pBits + lRect.Pitch * SurfaceDesc.Height;
-	byte *pSrcUV = (byte *)lRect.pBits + lRect.Pitch * pFrameYUV420P->height;
-		
-	byte* dstY = pFrameYUV420P->data[0];
-	byte* dstU = pFrameYUV420P->data[1];
-	byte* dstV = pFrameYUV420P->data[2];
-	
-	UINT heithtUV = pFrameYUV420P->height / 2;
-	UINT widthUV = pFrameYUV420P->width / 2;
-
-	// Y
- 	for (int i = 0; i < pFrameYUV420P->height; i++)
- 		memcpy(&dstY[i*pFrameYUV420P->width], &pSrcY[i*lRect.Pitch], pFrameYUV420P->width);
-
-	// VU
-	for (int i = 0; i < heithtUV; i++)
-	{
-		for (int j = 0; j < widthUV; j++)
-		{
-			dstU[i*widthUV + j] = pSrcUV[i*lRect.Pitch + 2 * j];
-			dstV[i*widthUV + j] = pSrcUV[i*lRect.Pitch + 2 * j + 1];
-		}
-	}
+	// UVͼ,λY֮,߶ȿͼ߶
+	byte *pSrcUV = (byte *)lRect.pBits + lRect.Pitch * SurfaceDesc.Height;
+	CopyNV12ToYUV420P(pFrameYUV420P->data, pFrameYUV420P->linesize, pSrcY, pSrcUV, lRect.Pitch, pFrameYUV420P->width, pFrameYUV420P->height);
 	
 	pSurface->UnlockRect();
 }
 
+/// @brief һ·CPUʱ,Լƽÿ֡ĵCPUʱ
+/// @param dfRenderCPU	Ⱦ߳ĵCPUʱ,λ,δȾ߳ʱΪ0
+/// @param dfReadbackCPU	ض߳ĵCPUʱ,λ,δûضʱΪ0
+/// @remark ڽ߳е,ȾͻضĸƲڽ߳н,̵߳CPUʱ,
+/// ָƷʽÿ֡CPUſԱȽ
+void TraceThreadCPU(const char *szFunction, const char *szPath, UINT nChannel, int nFrames, double dfRenderCPU, double dfReadbackCPU)
+{
+	double dfDecodeCPU = (double)MonoThreadCpuNs() / MONO_NS_PER_MS;
+	dfRenderCPU *= 1000;
+	dfReadbackCPU *= 1000;
+	double dfCPUTime = dfDecodeCPU + dfRenderCPU + dfReadbackCPU;
+	DxTraceMsg("%s Channel %d(%s):Frames = %d\tCPU = %.1fms(Decode = %.1fms\tRender = %.1fms\tReadback = %.1fms)\tCPU/Frame = %.3fms.\n", 
+		szFunction, nChannel, szPath, nFrames, dfCPUTime, dfDecodeCPU, dfRenderCPU, dfReadbackCPU, nFrames ? dfCPUTime / nFrames : 0.0f);
+}
+
 UINT CMultiDecoderDlg::DXVADecodeThread(void *p)
 {
 	ThreadParam *TPPtr = (ThreadParam *)p;
 	CMultiDecoderDlg *pThis = TPPtr->pThis;
+	g_MemoryAccount.SetThreadChannel(TPPtr->nThreadIndex);
 	int nAvError = 0;
 	char szAvError[1024] = { 0 };
 	shared_ptr<CDXVA2Decode>pDecodec = make_shared<CDXVA2Decode>();
 
 	pDecodec->InitDecoder(1920,1080,AV_CODEC_ID_H264);
-	double dfT1 = 0.0f;
-	double dfT2 = 0.0f;
-	double dfTimeSpan = 0.0f;
+	int64_t nT1 = 0;
 	AVPacket *pAvPacket = (AVPacket *)av_malloc(sizeof(AVPacket));
 	auto ItLoop = pThis->m_InputQueue.begin();
+	InputRecordCursor RecordCursor(pThis->m_InputQueue.end());
 	FramePtr pFrame;
 	int nGot_picture = 0;
 	AVFrame *pAvFrame = av_frame_alloc();
 	DWORD nResult = 0;
-	int nTimeSpan = 0;
 	int nFrameInterval = 40;
+	// ʱ̿ƽĽ,ÿ֡ʱĶۻΪ֡ʵƫ
+	CMonoPacer Pacer(nFrameInterval * MONO_NS_PER_MS);
 	
+	// ʾͼȡ֡,ÿ֡ȡû,ƴӺϳõһ֡ᱻ
 	AVFrame *pFrame420 = av_frame_alloc();
-	AVFrame *pFrameNV12 = av_frame_alloc();
-	int nWidth = pDecodec->GetAlignedDimension(1920);
-	int nHeight = pDecodec->GetAlignedDimension(1080);
-	int nImage420Size = av_image_get_buffer_size(AV_PIX_FMT_YUV420P, nWidth, nHeight, 16);
-	int nImageNV12Size = av_image_get_buffer_size(AV_PIX_FMT_NV12, nWidth, nHeight, 16);
-	
-	if (nImage420Size < 0)
-	{
-		char szAvError[256] = { 0 };
-		av_strerror(nImage420Size, szAvError, 1024);
-		DxTraceMsg("%s av_image_get_buffer_size failed:%s.\n", __FUNCTION__, szAvError);
-		assert(false);
-	}
-	if ( nImageNV12Size < 0)
+	PixelConvert *pc = nullptr;
+	// 㸴ʾ:CDxSurface豸,ֱ쵽ʾ,ֻƴӺϳɻ豸ʧʱŸƵڴ
+	bool bZeroCopy = pThis->m_bZeroCopyRender && !pThis->m_pMosaic;
+	RenderInitParam InitParam = { TPPtr->hRenderWnd, bZeroCopy ? pDecodec->GetD3DDevice() : nullptr, false };
+	// δʹƴӺϳʱ,ͨȾ߳ʾͼ,ֻ߳Ͷ֡,ٱPresent豸ʧĻָ
+	CRenderStage RenderStage;
+	bool bRenderStage = false;
+	CChannelLatency *pLatency = TPPtr->pLatency;
+	TPPtr->pDxSurface->SetLatency(pLatency);
+	RenderStage.SetLatency(pLatency);
+	RenderStage.SetChannel(TPPtr->nThreadIndex);
+	if (TPPtr->hRenderWnd && !pThis->m_pMosaic)
+		bRenderStage = RenderStage.Start(TPPtr->pDxSurface, InitRenderSurface, &InitParam, pThis->m_nRenderInterval);
+	if (!bRenderStage)
+		InitParam.pDecodeDevice = nullptr;
+	int nRenderFrames = 0;
+	// ƴӺϳɺʾʱ崰ڱ,ɺϳʾ,ʱ崰ڽ֡
+	bool bThrottle = !pThis->m_pMosaic && !pThis->m_pBatchGroup;
+	ChannelPriority nCurPriority = ChannelPriority_Visible;		// ̵߳ĬȼTHREAD_PRIORITY_NORMALӦ
+	int nVideoWidth = 0;
+	int nVideoHeight = 0;
+	// ƴӺϳɺͷҹҪڴеͼ,ʹ첽ض,̲߳صȴGPUɽ
+	CReadbackRing *pReadback = nullptr;
+	if (pThis->m_pMosaic || CReadbackRing::HasAnalyticsHook())
 	{
-		char szAvError[256] = {0};
-		av_strerror(nImageNV12Size, szAvError, 1024);
-		DxTraceMsg("%s av_image_get_buffer_size failed:%s.\n", __FUNCTION__, szAvError);
-		assert(false);
+		pReadback = new CReadbackRing();
+		TPPtr->pReadbackFrame = av_frame_alloc();
+		if (!pReadback->Create(nullptr, 4, 2, _READBACK_MAX_DELAY, OnReadbackFrame, TPPtr))
+		{
+			DxTraceMsg("%s Failed to create readback ring,fall back to synchronous copying.\n", __FUNCTION__);
+			SafeDelete(pReadback);
+		}
 	}
-	byte *pImage420 = (byte *)av_malloc(nImage420Size);
-	byte *pImageNV12 = (byte *)av_malloc(nImageNV12Size);
-
-	ZeroMemory(pImage420, nImage420Size);
-	ZeroMemory(pImageNV12, nImageNV12Size);
-	
-	// ʾͼYUV֡
-	av_image_fill_arrays(pFrame420->data, pFrame420->linesize, pImage420, AV_PIX_FMT_YUV420P, 1920, 1080, 16);
-	av_image_fill_arrays(pFrameNV12->data, pFrameNV12->linesize, pImageNV12, AV_PIX_FMT_NV12, 1920, 1080, 16);
-
-	pFrame420->width = 1920;
-	pFrame420->height = 1080;
-	pFrame420->format = AV_PIX_FMT_YUV420P;
-
-	pFrameNV12->width = 1920;
-	pFrameNV12->height = 1080;
-	pFrameNV12->format = AV_PIX_FMT_NV12;
-	PixelConvert *pc = nullptr;
 
+	TimelineSetThreadName("Decode", TPPtr->nThreadIndex);
+	g_ThreadPlacement.Apply(ThreadRole_Decode, TPPtr->nThreadIndex);
 	while (TPPtr->bThreadRun)
 	{
 		if (ItLoop != pThis->m_InputQueue.end())
 		{
-			dfT1 = GetExactTime();
 			av_init_packet(pAvPacket);
 			pFrame = *ItLoop;
 			pAvPacket->data = (byte *)pFrame->pData;
 			pAvPacket->size = pFrame->nLength;
-			pAvPacket->flags = AV_PKT_FLAG_KEY;
-
+			pAvPacket->flags = pFrame->bKeyFrame ? AV_PKT_FLAG_KEY : 0;	// ֻڹؼ֡ؽ,ܰÿݰΪؼ֡
+			pAvPacket->pts = pFrame->nPts;		// pkt_pts,ʱйͬһ֡ĸ׶
+			pAvPacket->dts = pFrame->nDts;
+			RecordInputFrame(TPPtr, RecordCursor, ItLoop);
+
+			ChannelPriority nPriority = (ChannelPriority)TPPtr->nPriority;
+			if (nPriority != nCurPriority)
+			{// ѡ򲼾ָıȾ̵߳ȼ
+				nCurPriority = nPriority;
+				SetThreadPriority(GetCurrentThread(), CLoadShedder::GetThreadPriority(nPriority));
+				RenderStage.SetPriority(CLoadShedder::GetThreadPriority(nPriority));
+			}
+			// ʱͨȼ֡,岻ɼʱֻο֡,Ҳٻضƽ
+			AVDiscard nDiscard = g_LoadShedder.GetDiscard(nPriority);
+			if (bThrottle)
+				nDiscard = TPPtr->Throttle.AdjustDiscard(TPPtr->hRenderWnd, nVideoWidth, nVideoHeight, nDiscard);
+			bool bSkipFrame = nDiscard != AVDISCARD_DEFAULT;
+			pDecodec->SetSkipFrame(nDiscard);
+
+			nT1 = MonoTimeNs();
+			CTimelineScope DecodeScope("avcodec_decode", TIMELINE_CURRENT_CHANNEL, pAvPacket->pts);
 			nAvError = pDecodec->Decode(pAvFrame, nGot_picture, pAvPacket);			
+			DecodeScope.End();
+			pLatency->Record(LatencyStage_Decode, nT1, MonoTimeNs());
 			if (nAvError < 0)
-			{
+			{// ȴ泬ʱȴʱݰ,ճĵȴ,ͬһݰ
 				av_strerror(nAvError, szAvError, 1024);
 				DxTraceMsg("%s Decode error:%s.\n", __FUNCTION__, szAvError);
+				g_LoadShedder.ReportLate(Pacer.Wait(), Pacer.GetInterval());
+				ItLoop++;
 				continue;
 			}
 			if (nGot_picture)
 			{
-				if (TPPtr->hRenderWnd)
+				nVideoWidth = pAvFrame->width;
+				nVideoHeight = pAvFrame->height;
+				bool bReadback = false;
+				if (TPPtr->hRenderWnd && (!bThrottle || ShouldRenderChannel(TPPtr, nCurPriority, nVideoWidth, nVideoHeight)))
 				{
-					// ʹ߳CDxSurfaceʾͼ
-					if (!TPPtr->pDxSurface->IsInited())		// D3D豸δ,˵δʼ
+					nRenderFrames++;
+					if (bRenderStage)
+						RenderStage.Post(pAvFrame);		// Ⱦֱ߳ʾ,ܹ豸ʱȾ̸߳
+					else if (pReadback && pThis->m_pMosaic && pAvFrame->format == AV_PIX_FMT_DXVA2_VLD)
+					{// ضɺOnReadbackFrameύƴӺϳ
+						pReadback->Submit(pAvFrame->data[3], pAvFrame->width, pAvFrame->height, pAvFrame->pts, TPPtr);
+						bReadback = true;
+					}
+					//dxva2_retrieve_data(&pFrameNV12, pAvFrame);
+					else if (g_FramePool.GetFrameBuffer(pFrame420, AV_PIX_FMT_YUV420P, pAvFrame->width, pAvFrame->height))
 					{
-						DxSurfaceInitInfo InitInfo;
-						InitInfo.nFrameWidth = pDecodec->GetAlignedDimension(pAvFrame->width);
-						InitInfo.nFrameHeight = pDecodec->GetAlignedDimension(pAvFrame->height);
-						InitInfo.nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2');
-						InitInfo.bWindowed = TRUE;
-						InitInfo.hPresentWnd = TPPtr->hRenderWnd;
-
-						if (!TPPtr->pDxSurface->InitD3D(InitInfo.hPresentWnd,
-							InitInfo.nFrameWidth,
-							InitInfo.nFrameHeight,
-							InitInfo.bWindowed,
-							InitInfo.nD3DFormat))
+						nT1 = MonoTimeNs();
 						{
-							assert(false);
-							return 0;
+							TIMELINE_SCOPE("CopyFrame", TIMELINE_CURRENT_CHANNEL, pAvFrame->pkt_pts);
+							CopyFrame(pFrame420, pAvFrame);
 						}
-						//::SendMessageTimeout(pThis->m_hWnd, WM_INITDXSURFACE, (WPARAM)TPPtr->pDxSurface, (LPARAM)&InitInfo, SMTO_BLOCK, 500, (PDWORD_PTR)&nResult);
-					}
-					ZeroMemory(pImageNV12, nImageNV12Size);
-					
-					//dxva2_retrieve_data(&pFrameNV12, pAvFrame);
-					CopyFrame(pFrame420, pAvFrame);
+						pLatency->Record(LatencyStage_Download, nT1, MonoTimeNs());
 
-					//::SendMessageTimeout(pThis->m_hWnd, WM_RENDERFRAME, (WPARAM)TPPtr->pDxSurface, (LPARAM)pAvFrame, SMTO_BLOCK, 500, (PDWORD_PTR)&nResult);
-					TPPtr->pDxSurface->Render(pFrame420);
+						//::SendMessageTimeout(pThis->m_hWnd, WM_RENDERFRAME, (WPARAM)TPPtr->pDxSurface, (LPARAM)pAvFrame, SMTO_BLOCK, 500, (PDWORD_PTR)&nResult);
+						if (pThis->m_pMosaic)
+							pThis->m_pMosaic->SubmitFrame(TPPtr->hRenderWnd, pFrame420);
+						else if (TPPtr->pDxSurface->IsInited() || InitRenderSurface(TPPtr->pDxSurface, pFrame420, &InitParam))
+							TPPtr->pDxSurface->Render(pFrame420);
+					}
+					else
+						DxTraceMsg("%s Failed to get a frame buffer.\n", __FUNCTION__);
 				}
+				// ҹȡͼ,Ƿʾ޹;ֻΪύ֡pTag,OnReadbackFrameʾ
+				if (pReadback && !bReadback && pAvFrame->format == AV_PIX_FMT_DXVA2_VLD && pReadback->IsAnalyticsDue())
+					pReadback->Submit(pAvFrame->data[3], pAvFrame->width, pAvFrame->height, pAvFrame->pts, nullptr);
 			}
-			else
+			else if (!bSkipFrame)
 			{
 				DxTraceMsg("ʧ.\n");
 			}
-			nTimeSpan = (int)(1000 * (GetExactTime() - dfT1));
-			int nSleepTime = nFrameInterval - nTimeSpan;
-			if (nSleepTime > 0)
-				Sleep(nSleepTime);
+			g_LoadShedder.ReportLate(Pacer.Wait(), Pacer.GetInterval());
 			ItLoop++;
 		}
 		else
+		{
 			ItLoop = pThis->m_InputQueue.begin();
+			RecordCursor.Reset();
+		}
 	}
-
+	double dfRenderCPU = 0.0f;
+	double dfReadbackCPU = 0.0f;
+	if (bRenderStage)
+	{// е֡н,ڽ֮ǰͷ
+		RenderStage.Stop();
+		RenderStage.TraceStat();
+		RenderStageStat RenderStat;
+		RenderStage.GetStat(RenderStat);
+		dfRenderCPU = RenderStat.dfThreadCpuTime;
+	}
+	if (bThrottle)
+		TPPtr->Throttle.TraceStat(__FUNCTION__, TPPtr->nThreadIndex);
+	const char *szPath = InitParam.bZeroCopy ? "ZeroCopy" : (pReadback ? "Readback" : "CopyFrame");
+	if (pReadback)
+	{// ݴλڽ豸,ڽ֮ǰͷ
+		pReadback->Destroy();
+		pReadback->TraceStat();
+		ReadbackStat ReadStat;
+		pReadback->GetStat(ReadStat);
+		dfReadbackCPU = ReadStat.dfThreadCpuTime;
+		delete pReadback;
+	}
+	TraceThreadCPU(__FUNCTION__, szPath, TPPtr->nThreadIndex, nRenderFrames, dfRenderCPU, dfReadbackCPU);
+	if (TPPtr->pReadbackFrame)
+		av_frame_free(&TPPtr->pReadbackFrame);
+	// õ豸ͳеĽ֡ڽ֮ǰͷ
+	TPPtr->pDxSurface->DetachSharedDevice();
 	av_frame_free(&pAvFrame);
 	
 	av_free(pAvPacket);
-	av_free(pImageNV12);
-	av_free(pImage420);
-	av_frame_free(&pFrameNV12);
 	av_frame_free(&pFrame420);
 	return 0;
 }
+// ǰʾʽΪ崴Ⱦ
+IRenderSurface *CMultiDecoderDlg::CreateRenderSurface(HWND hPanelWnd)
+{
+	CPresentBatcher *pBatcher = m_pBatchGroup ? m_pBatchGroup->GetBatcher(hPanelWnd) : nullptr;
+	if (pBatcher)
+		return new CBatchedSurface(pBatcher);
+	// ڴ˲,Ӳ֡COffscreenSurface
+	if (m_nHeadlessRender == Headless_Memory && !m_bEnableHaccel)
+		return new CMemorySurface();
+	if (m_nHeadlessRender != Headless_None)
+		return new COffscreenSurface();
+	return new CDxSurface();
+}
+
+ThreadParamPtr CMultiDecoderDlg::CreateChannel(int nChannel, HWND hPanelWnd)
+{
+	bool bRecyclable = !m_pBatchGroup || !m_pBatchGroup->GetBatcher(hPanelWnd);
+	IRenderSurface *pSurface = nullptr;
+	if (bRecyclable && !m_vecRecycledSurface.empty())
+	{
+		pSurface = m_vecRecycledSurface.back();
+		m_vecRecycledSurface.pop_back();
+	}
+	else
+		pSurface = CreateRenderSurface(hPanelWnd);
+	ThreadParamPtr pTP = make_shared<ThreadParam>(pSurface);
+	pTP->nThreadIndex = nChannel;
+	pTP->pLatency = g_LatencyMonitor.AddChannel(nChannel);
+	pTP->bThreadRun = true;
+	pTP->hRenderWnd = hPanelWnd;
+	pTP->pThis = this;
+	pTP->bRecyclable = bRecyclable;
+	return pTP;
+}
+
+void CMultiDecoderDlg::RecycleChannel(ThreadParamPtr pTP)
+{
+	for (int i = 0; i < m_pVideoWndFrame->GetPanelCount(); i++)
+	{
+		if (m_pVideoWndFrame->GetPanelParam(i) == pTP.get())
+			m_pVideoWndFrame->SetPanelParam(i, nullptr);
+	}
+	if (pTP->bRecyclable && pTP->pDxSurface && m_vecRecycledSurface.size() < _MAX_RECYCLED_SURFACE)
+	{// IDirect3D9ȴϴĶ,豸ͱͨյһ֡ʱ´
+		pTP->pDxSurface->DxCleanup();
+		pTP->pDxSurface->SetLatency(nullptr);
+		m_vecRecycledSurface.push_back(pTP->pDxSurface);
+		pTP->pDxSurface = nullptr;
+	}
+}
+
+void CMultiDecoderDlg::ReleaseRecycledSurface()
+{
+	for (auto it = m_vecRecycledSurface.begin(); it != m_vecRecycledSurface.end(); it++)
+		delete *it;
+	m_vecRecycledSurface.clear();
+}
+
+void CALLBACK CMultiDecoderDlg::OnChannelStop(int nChannel, void *pContext, void *pUserPtr)
+{
+	if (nChannel == _INPUT_CHANNEL)
+		((CMultiDecoderDlg *)pUserPtr)->m_bInputThreadRun = false;
+	else
+		((ThreadParam *)pContext)->bThreadRun = false;
+}
+
+// ̳߳ص߳е,ͨڽ߳н
+void CALLBACK CMultiDecoderDlg::OnChannelExit(int nChannel, void *pContext, void *pUserPtr)
+{
+	CMultiDecoderDlg *pThis = (CMultiDecoderDlg *)pUserPtr;
+	::PostMessage(pThis->GetSafeHwnd(), WM_CHANNELSTOPPED, (WPARAM)nChannel, (LPARAM)pContext);
+}
+
+/// @brief Ⱦ߳гʼͨCDxSurface
+/// @remark ָ˽豸ʱȳ豸,ʧ򵥶ʼ,Ӳ֡Ⱦ˵RenderƵڴʾ
+bool CALLBACK CMultiDecoderDlg::InitRenderSurface(IRenderSurface *pDxSurface, AVFrame *pFirstFrame, void *pUserPtr)
+{
+	RenderInitParam *pParam = (RenderInitParam *)pUserPtr;
+	DxSurfaceInitInfo InitInfo;
+	InitInfo.nFrameWidth = pFirstFrame->width;
+	InitInfo.nFrameHeight = pFirstFrame->height;
+	InitInfo.nD3DFormat = (D3DFORMAT)MAKEFOURCC('Y', 'V', '1', '2');
+	InitInfo.bWindowed = TRUE;
+	InitInfo.hPresentWnd = pParam->hRenderWnd;
+	if (pParam->pDecodeDevice)
+	{
+		pParam->bZeroCopy = pDxSurface->InitD3DShared(InitInfo.hPresentWnd, pParam->pDecodeDevice, InitInfo.nFrameWidth, InitInfo.nFrameHeight, InitInfo.nD3DFormat);
+		if (pParam->bZeroCopy)
+			return true;
+		DxTraceMsg("%s Failed to share the decoder device,fall back to copying frames.\n", __FUNCTION__);
+	}
+	if (!pDxSurface->InitD3D(InitInfo.hPresentWnd,
+		InitInfo.nFrameWidth,
+		InitInfo.nFrameHeight,
+		InitInfo.bWindowed,
+		InitInfo.nD3DFormat))
+	{
+		DxTraceMsg("%s InitD3D failed.\n", __FUNCTION__);
+		return false;
+	}
+	return true;
+}
+
+bool CMultiDecoderDlg::StartRecord(int nChannel, LPCTSTR szPath)
+{
+	if (nChannel < 0 || nChannel >= m_vecTP.size() || !m_pInputCodecCtx)
+		return false;
+	ThreadParam *TPPtr = m_vecTP[nChannel].get();
+	if (TPPtr->pRecorder)
+	{
+		DxTraceMsg("%s Channel %d is already recording.\n", __FUNCTION__, nChannel);
+		return false;
+	}
+	char szFilePath[MAX_PATH] = { 0 };
+	WideCharToMultiByte(CP_ACP, 0, szPath, -1, szFilePath, MAX_PATH, NULL, NULL);
+	CPacketRecorder *pRecorder = new CPacketRecorder();
+	pRecorder->SetChannel(nChannel);
+	if (!pRecorder->Create(szFilePath, m_pInputCodecCtx, m_nInputTimeBase, m_nInputFrameRate))
+	{
+		DxTraceMsg("%s Failed to create record file %s.\n", __FUNCTION__, szFilePath);
+		delete pRecorder;
+		return false;
+	}
+	CAutoLock lock(&TPPtr->csRecorder);
+	TPPtr->pRecorder = pRecorder;
+	return true;
+}
+
+void CMultiDecoderDlg::StopRecord(int nChannel)
+{
+	if (nChannel < 0 || nChannel >= m_vecTP.size())
+		return;
+	ThreadParam *TPPtr = m_vecTP[nChannel].get();
+	CPacketRecorder *pRecorder = nullptr;
+	{// ̴߳˺󲻻ٷʸ¼,رļʱ߳
+		CAutoLock lock(&TPPtr->csRecorder);
+		pRecorder = TPPtr->pRecorder;
+		TPPtr->pRecorder = nullptr;
+	}
+	if (pRecorder)
+	{
+		pRecorder->Close();
+		pRecorder->TraceStat();
+		delete pRecorder;
+	}
+}
+
+// ʼֹͣѡдͨ¼,Ĭϵļ¼,LocateRecordԶλļ
+void CMultiDecoderDlg::OnFileRecord()
+{
+	int nCurSelected = m_pVideoWndFrame->GetCurSelected();
+	void *pSelected = nCurSelected >= 0 ? m_pVideoWndFrame->GetPanelParam(nCurSelected) : nullptr;
+	int nChannel = -1;
+	for (int i = 0; i < m_vecTP.size() && pSelected; i++)
+	{
+		if (m_vecTP[i].get() == pSelected)
+		{
+			nChannel = i;
+			break;
+		}
+	}
+	if (nChannel < 0)
+	{
+		AfxMessageBox(_T("ѡһڽĴ."), MB_OK | MB_ICONINFORMATION);
+		return;
+	}
+	// ¼ֻڽ߳ú
+	if (m_vecTP[nChannel]->pRecorder)
+	{
+		StopRecord(nChannel);
+		return;
+	}
+	SYSTEMTIME st;
+	GetLocalTime(&st);
+	TCHAR szName[MAX_PATH] = { 0 };
+	_stprintf_s(szName, MAX_PATH, _T("CH%02d_%04d%02d%02d_%02d%02d%02d.mp4"), nChannel, st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+	CFileDialog dlg(FALSE, _T("mp4"), szName, OFN_HIDEREADONLY | OFN_OVERWRITEPROMPT, _T("MP4 (*.mp4)|*.mp4|Matroska (*.mkv)|*.mkv||"), this);
+	if (dlg.DoModal() != IDOK)
+		return;
+	if (!StartRecord(nChannel, dlg.GetPathName()))
+		AfxMessageBox(_T("ʼ¼ʧ."), MB_OK | MB_ICONSTOP);
+}
+
+// ֻڽ߳е,¼ֻѹ֡,װдļ¼I/O߳
+// ֡ʱļƵʱΪλ,StartRecord¼ʱʹõʱͬ
+void CMultiDecoderDlg::RecordInputFrame(ThreadParam *TPPtr, InputRecordCursor &Cursor, list<FramePtr>::iterator ItFrame)
+{
+	if (!TPPtr->pRecorder)
+	{// ¼ʱֻ¼ؼ֡λ
+		Cursor.Feed(ItFrame, nullptr);
+		return;
+	}
+	CAutoLock lock(&TPPtr->csRecorder);
+	Cursor.Feed(ItFrame, TPPtr->pRecorder);
+}
+
+// ʱ߼¼δʱӴ˿ʼ¼,Ѿе߳ûеǼ,ʱϰ߳IDʾ
+void CMultiDecoderDlg::OnFileExportTimeline()
+{
+	if (!TimelineIsEnabled())
+	{
+		TimelineEnable(true);
+		AfxMessageBox(_T("ѿʼ¼ʱ,Ժٵ."), MB_OK | MB_ICONINFORMATION);
+		return;
+	}
+	CFileDialog dlg(FALSE, _T("json"), _T("Timeline.json"), OFN_HIDEREADONLY | OFN_OVERWRITEPROMPT, _T("Chrome Trace (*.json)|*.json||"), this);
+	if (dlg.DoModal() != IDOK)
+		return;
+	if (!ExportTimeline(dlg.GetPathName()))
+		AfxMessageBox(_T("ʱʧ."), MB_OK | MB_ICONSTOP);
+}
+
+bool CMultiDecoderDlg::ExportTimeline(LPCTSTR szPath)
+{
+	char szFilePath[MAX_PATH] = { 0 };
+	WideCharToMultiByte(CP_ACP, 0, szPath, -1, szFilePath, MAX_PATH, NULL, NULL);
+	if (!TimelineExportChrome(szFilePath))
+	{
+		DxTraceMsg("%s Failed to export timeline to %s.\n", __FUNCTION__, szFilePath);
+		return false;
+	}
+	return true;
+}
+
+bool CMultiDecoderDlg::LocateRecord(int nChannel, UINT64 nTime)
+{
+	if (!m_RecordIndex.GetFileCount())
+	{
+		TCHAR szRoot[MAX_PATH] = { 0 };
+		_tcscpy_s(szRoot, MAX_PATH, m_strFilePath);
+		PathRemoveFileSpec(szRoot);
+		if (!m_RecordIndex.Build(szRoot))
+			return false;
+	}
+	RecordPosition Pos;
+	if (!m_RecordIndex.Resolve(nChannel, (int64_t)nTime * AV_TIME_BASE, Pos))
+	{
+		DxTraceMsg("%s No record of channel %d at %I64d.\n", __FUNCTION__, nChannel, nTime);
+		return false;
+	}
+	m_strFilePath = Pos.szPath;
+	m_nStartOffset = Pos.nOffset;
+	return true;
+}
+
+void CALLBACK CMultiDecoderDlg::OnReadbackFrame(const ReadbackImage &Image, void *pUserPtr)
+{
+	ThreadParam *TPPtr = (ThreadParam *)pUserPtr;
+	// ֻΪҹύ֡ʾ
+	if (!Image.pTag || !Image.pBits || !TPPtr->pThis->m_pMosaic)
+		return;
+	AVFrame *pFrame = TPPtr->pReadbackFrame;
+	if (!g_FramePool.GetFrameBuffer(pFrame, AV_PIX_FMT_YUV420P, Image.nWidth, Image.nHeight))
+		return;
+	CopyReadbackImage(pFrame->data, pFrame->linesize, Image);
+	pFrame->pts = Image.nPts;
+	TPPtr->pThis->m_pMosaic->SubmitFrame(TPPtr->hRenderWnd, pFrame);
+}
+
 void CMultiDecoderDlg::OnSize(UINT nType, int cx, int cy)
 {
 	CDialogEx::OnSize(nType, cx, cy);
@@ -874,7 +1352,7 @@ LRESULT CMultiDecoderDlg::OnInitDxSurface(WPARAM w, LPARAM l)
 {
 	if (!w || !l)
 		return -1;
-	CDxSurface *pDxSurface = (CDxSurface *)w;
+	IRenderSurface *pDxSurface = (IRenderSurface *)w;
 	DxSurfaceInitInfo *pInitInfo = (DxSurfaceInitInfo *)l;
 	
 	if (!pDxSurface->InitD3D(pInitInfo->hPresentWnd,
@@ -896,7 +1374,7 @@ LRESULT CMultiDecoderDlg::OnRenderFrame(WPARAM w, LPARAM l)
 	if (!w || !l)
 		return -1;
 
-	CDxSurface *pDxSurface = (CDxSurface *)w;
+	IRenderSurface *pDxSurface = (IRenderSurface *)w;
 	AVFrame *pAvFrame = (AVFrame *)l;
 
 // 	if (!pDxSurface->IsInited())		// D3D豸δ,˵δʼ
@@ -944,6 +1422,7 @@ void CMultiDecoderDlg::OnDestroy()
 {
 	CDialogEx::OnDestroy();
 	OnFileStop();
+	g_SnapshotService.Stop();
 	m_pVideoWndFrame->DestroyWindow();
 }
 
@@ -962,6 +1441,8 @@ void CMultiDecoderDlg::OnTimer(UINT_PTR nIDEvent)
 			}
 		}
 	}
+	else if (nIDEvent == ID_TRACE_MEMORY)
+		g_MemoryAccount.TraceStat();
 
 	CDialogEx::OnTimer(nIDEvent);
 }
@@ -970,52 +1451,94 @@ void CMultiDecoderDlg::OnDecoderSetting()
 {
 	CAdjustDecoders dlg;
 	dlg.m_nCurDecoders = m_nDecodeCount;
-	if (dlg.DoModal() == IDOK)
+	if (dlg.DoModal() != IDOK || dlg.m_nNewDecoders == m_nDecodeCount)
+		return;
+	if (m_vecTP.empty())
+	{// δʼ,ֻ޸Ľ·
+		m_nDecodeCount = dlg.m_nNewDecoders;
+		return;
+	}
+	if (dlg.m_nNewDecoders > m_vecTP.size())
 	{
-		if (dlg.m_nNewDecoders == m_nDecodeCount)
-			return;
-		else if (dlg.m_nNewDecoders > m_nDecodeCount)
+		for (int i = m_vecTP.size(); i < dlg.m_nNewDecoders; i++)
 		{
-			HANDLE *pNewArray = new HANDLE[dlg.m_nNewDecoders + 1];
-			memcpy(pNewArray, m_hThreadArray, sizeof(HANDLE)*(m_nDecodeCount + 1));
-			delete[]m_hThreadArray;
-			m_hThreadArray = pNewArray;
-			for (int i = m_nDecodeCount; i < dlg.m_nNewDecoders; i++)
-			{
-				ThreadParamPtr pTP = make_shared<ThreadParam>();
-				pTP->bThreadRun = true;
-				pTP->nThreadIndex = i;
-				pTP->hRenderWnd = NULL;				
-				pTP->pThis = this;
-				if (dlg.m_bEnableHaccel)
-					m_hThreadArray[i + 1] = (HANDLE)_beginthreadex(nullptr, 0, DXVADecodeThread, pTP.get(), 0, nullptr);
-				else
-					m_hThreadArray[i + 1] = (HANDLE)_beginthreadex(nullptr, 0, DecodeThread, pTP.get(), 0, nullptr);
-				m_vecTP.push_back(pTP);
-			}
+			ThreadParamPtr pTP = CreateChannel(i, NULL);
+			if (!m_Channels.Add(i, dlg.m_bEnableHaccel ? DXVADecodeThread : DecodeThread, pTP.get()))
+				break;
+			m_vecTP.push_back(pTP);
 		}
-		else
+	}
+	else
+	{// ֻ֪ͨ߳˳,ȴ,߳˳OnChannelStopped
+		while (m_vecTP.size() > dlg.m_nNewDecoders)
 		{
-			int nSubCount = m_nDecodeCount - dlg.m_nNewDecoders;
-			for (auto it = m_vecTP.rbegin(); it != m_vecTP.rend();)
+			int nChannel = m_vecTP.size() - 1;
+			ThreadParamPtr pTP = m_vecTP.back();
+			StopRecord(nChannel);
+			for (int i = 0; i < m_pVideoWndFrame->GetPanelCount(); i++)
 			{
-				if (nSubCount > 0)
-				{
-					(*it)->bThreadRun = false;
-					nSubCount--;
-					it++;
-				}
-				else
-					break;
+				if (m_pVideoWndFrame->GetPanelParam(i) == pTP.get())
+					m_pVideoWndFrame->SetPanelParam(i, nullptr);
 			}
-			nSubCount = m_nDecodeCount - dlg.m_nNewDecoders;
-			WaitForMultipleObjects(nSubCount, &m_hThreadArray[1 + dlg.m_nNewDecoders], TRUE, INFINITE);			
-			auto itbegin = m_vecTP.begin() + dlg.m_nNewDecoders;
-			auto itEnd = m_vecTP.begin() + m_nDecodeCount;
-			m_vecTP.erase(itbegin, itEnd);
-			for (int i = m_nDecodeCount; i < dlg.m_nNewDecoders; i++)
-				m_hThreadArray[1 + i] = nullptr;
+			m_vecTP.pop_back();
+			m_listDraining.push_back(pTP);
+			m_Channels.Remove(pTP.get());
+		}
+	}
+	m_nDecodeCount = m_vecTP.size();
+	if (m_nCurRenderlast >= m_nDecodeCount)
+		m_nCurRenderlast = m_nDecodeCount - 1;
+	if (m_nCurRender1st > m_nCurRenderlast)
+		m_nCurRender1st = 0;
+	UpdateChannelPriority();
+}
+
+// ߳д,ʱͨ߳˳
+LRESULT CMultiDecoderDlg::OnChannelStopped(WPARAM w, LPARAM l)
+{
+	void *pContext = (void *)l;
+	if (!m_Channels.Reap(pContext))
+		return 0;
+	for (auto it = m_listDraining.begin(); it != m_listDraining.end(); it++)
+	{
+		if (it->get() == pContext)
+		{
+			RecycleChannel(*it);
+			m_listDraining.erase(it);
+			break;
 		}
-		m_nDecodeCount = dlg.m_nNewDecoders;
 	}
+	return 0;
+}
+
+void CMultiDecoderDlg::UpdateChannelPriority()
+{
+	int nCurSelected = m_pVideoWndFrame->GetCurSelected();
+	void *pSelected = nCurSelected >= 0 ? m_pVideoWndFrame->GetPanelParam(nCurSelected) : nullptr;
+	int nSelected = -1;
+	int nVisible = 0;
+	for (int i = 0; i < m_vecTP.size(); i++)
+	{
+		ThreadParam *pTP = m_vecTP[i].get();
+		ChannelPriority nPriority = ChannelPriority_Background;
+		if (pSelected && pTP == pSelected)
+		{
+			nPriority = ChannelPriority_Selected;
+			nSelected = i;
+		}
+		else if (pTP->hRenderWnd)
+		{
+			nPriority = ChannelPriority_Visible;
+			nVisible++;
+		}
+		InterlockedExchange(&pTP->nPriority, nPriority);
+	}
+	DxTraceMsg("%s Selected = %d\tVisible = %d\tBackground = %d.\n", __FUNCTION__,
+				nSelected, nVisible, (int)m_vecTP.size() - nVisible - (nSelected >= 0 ? 1 : 0));
+}
+
+LRESULT CMultiDecoderDlg::OnPanelSelected(WPARAM w, LPARAM l)
+{
+	UpdateChannelPriority();
+	return 0;
 }
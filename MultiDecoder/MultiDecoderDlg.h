@@ -8,51 +8,114 @@
 #include <memory>
 #include "./DxSurface/DxSurface.h"
 #include "./DxSurface/TimeUtility.h"
+#include "./DxSurface/MonoClock.h"
+#include "./DxSurface/MosaicCompositor.h"
+#include "./DxSurface/ReadbackRing.h"
+#include "./DxSurface/RenderStage.h"
+#include "./DxSurface/OffscreenSurface.h"
+#include "./DxSurface/MemorySurface.h"
+#include "./DxSurface/PresentBatcher.h"
+#include "./DxSurface/PacketRecorder.h"
+#include "./DxSurface/TimelineTrace.h"
+#include "./DxSurface/RecordIndex.h"
+#include "./DxSurface/ChannelLifecycle.h"
+#include "./DxSurface/ThreadPlacement.h"
+#include "./DxSurface/ChannelPriority.h"
 #include "VideoFrame.h"
 using namespace std;
 using namespace std::tr1;
 
+// ޴Ⱦ,ȡֵעHeadlessRenderֵ
+enum HeadlessRender
+{
+	Headless_None = 0,		// D3D9ʾ
+	Headless_Offscreen,		// COffscreenSurface,תΪBGRA,֧Ӳ֡
+	Headless_Memory,		// CMemorySurface,ֻϴڴеYV12,ӲʱCOffscreenSurface
+};
+
 struct Frame
 {
 	Frame(byte *pInput,int nInputLen)
 	{
 		pData = new byte[nInputLen];
 		nLength = nInputLen;
+		g_MemoryAccount.Alloc(MemTag_PacketQueue, MEMORY_SHARED_CHANNEL, nInputLen);
 		memcpy(pData, pInput, nInputLen);
+		bKeyFrame = false;
+		nPts = AV_NOPTS_VALUE;
+		nDts = AV_NOPTS_VALUE;
 	}
 	~Frame()
 	{
 		if (pData)
+		{
 			delete[]pData;
+			g_MemoryAccount.Free(MemTag_PacketQueue, MEMORY_SHARED_CHANNEL, nLength);
+		}
 		//DxTraceMsg("%s Free memory length:%d.\n", __FUNCTION__, nLength);
 		nLength = 0;
 	}
 	byte	*pData;
 	UINT	nLength;
+	bool	bKeyFrame;
+	int64_t	nPts;			// ʱ,ļƵʱΪλ
+	int64_t	nDts;
 };
 
 class CMultiDecoderDlg;
 struct ThreadParam
 {
-	ThreadParam()
+	// pSurfaceΪͨʹõȾ,ThreadParamͷ,ΪNULLʱʹCDxSurface
+	ThreadParam(IRenderSurface *pSurface = NULL)
 	{
 		ZeroMemory(this, sizeof(ThreadParam));
-		pDxSurface = new CDxSurface();
+		if (pSurface)
+			pDxSurface = pSurface;
+		else
+			pDxSurface = new CDxSurface();
+		InitializeCriticalSection(&csRecorder);
 	}
 	~ThreadParam()
 	{
 		if (pDxSurface)
 			delete pDxSurface;
+		if (pRecorder)
+			delete pRecorder;
+		g_LatencyMonitor.RemoveChannel(pLatency);
+		DeleteCriticalSection(&csRecorder);
 	}
 	bool			bThreadRun;
 	CMultiDecoderDlg *pThis;
 	UINT			 nThreadIndex;
 	HWND			 hRenderWnd;
-	CDxSurface		*pDxSurface;
+	IRenderSurface	*pDxSurface;
+	CPacketRecorder	*volatile pRecorder;	// ֱͨͨ¼,ΪNULLʱ¼
+	CRITICAL_SECTION csRecorder;			// ߳д¼ڼ,StopRecordȡøܹر¼
+	CRenderThrottle	 Throttle;				// ̰߳ĿɼԺͳߴǰҪʾ֡
+	bool			 bRecyclable;			// Ⱦ˲,ͨƳԻոͨ
+	volatile LONG	 nPriority;				// ͨȼ,ȡֵChannelPriority,ɽ߳ѡ򲼾ָıʱ
+	AVFrame			*pReadbackFrame;		// ض߳תͼõ֡,ȡg_FramePool
+	CChannelLatency	*pLatency;				// ͨеӳֱͼ,ͬһŵֿͨд,ThreadParamͷʱŵֱͼ
 };
 
+// Ⱦ̳߳ʼCDxSurfaceĲ
+struct RenderInitParam
+{
+	HWND				hRenderWnd;
+	IDirect3DDevice9	*pDecodeDevice;		// Ӳ豸,ΪNULLʱ豸
+	volatile bool		bZeroCopy;			// Ƿ豸,Ⱦ߳
+};
+
+#define _MOSAIC_RENDER_THRESHOLD	16		// Ⱦ·ֵʱ,ʹƴӺϳʾд
+#define ID_TRACE_MEMORY				102		// ʱڴͳƵĶʱ,resource.hеID_INVLIAD_PANEL
+#define WM_CHANNELSTOPPED			WM_USER + 1026	// ͨ߳˳	WPARAMΪͨ,LPARAMΪͨThreadParamָ
+#define _INPUT_CHANNEL				-1		// ߳ͨڹе
+#define _MAX_RECYCLED_SURFACE		16		// ౣѻȾ
+#define _READBACK_MAX_DELAY			100		// ֻΪҹύ֡ϴ,ӳ100ض
+
 typedef shared_ptr<Frame> FramePtr;
 typedef shared_ptr<ThreadParam> ThreadParamPtr;
+typedef CRecordCursor<list<FramePtr>::iterator> InputRecordCursor;
 // CMultiDecoderDlg Ի
 class CMultiDecoderDlg : public CDialogEx
 {
@@ -63,6 +126,11 @@ public:
 	{
 		if (m_pVideoWndFrame)
 			delete m_pVideoWndFrame;
+		if (m_pMosaic)
+			delete m_pMosaic;
+		if (m_pInputCodecCtx)
+			avcodec_free_context(&m_pInputCodecCtx);
+		ReleaseRecycledSurface();
 	}
 
 // Ի
@@ -90,18 +158,71 @@ public:
 	static UINT __stdcall InputThread(void *);
 	static UINT __stdcall DecodeThread(void *);
 	static UINT __stdcall DXVADecodeThread(void *);
+	static void CALLBACK OnReadbackFrame(const ReadbackImage &Image, void *pUserPtr);
+	IRenderSurface *CreateRenderSurface(HWND hPanelWnd);
+	/// @brief ͨĲ,岻ʹʾʱȡѻյȾ
+	ThreadParamPtr CreateChannel(int nChannel, HWND hPanelWnd);
+	/// @brief ˳ͨ,,ȾͷD3DԴͨ
+	void RecycleChannel(ThreadParamPtr pTP);
+	void ReleaseRecycledSurface();
+	static void CALLBACK OnChannelStop(int nChannel, void *pContext, void *pUserPtr);
+	static void CALLBACK OnChannelExit(int nChannel, void *pContext, void *pUserPtr);
+	LRESULT OnChannelStopped(WPARAM w, LPARAM l);
+	/// @brief ѡе͸ͨ»ͨȼ
+	/// @remark ߳һݰʱݴ˵Ⱦ̵߳ȼԼʱĶ֡ʽ
+	void UpdateChannelPriority();
+	LRESULT OnPanelSelected(WPARAM w, LPARAM l);
+	/// @brief ʼͨѹֱ֡ͨ¼ļ
+	/// @param nChannel	ͨ
+	/// @param szPath	¼ļ·,չΪ.mp4.mkv
+	/// @remark Ӳͨӵǰ֮֡ǰһؼ֡ʼ¼,ͨһؼ֡ʼ
+	bool StartRecord(int nChannel, LPCTSTR szPath);
+	void StopRecord(int nChannel);
+	static void RecordInputFrame(ThreadParam *TPPtr, InputRecordCursor &Cursor, list<FramePtr>::iterator ItFrame);
+	/// @brief Ѽ¼ʱߵΪChrome TraceʽJSONļ
+	/// @remark chrome://tracingPerfetto UI,ڼҲʱ
+	bool ExportTimeline(LPCTSTR szPath);
+	/// @brief ͨʱ䶨λ¼,Ϊ´βŵļʼλ
+	/// @param nTime	1970,¼ļеʱͬ,ʱת
+	/// @remark ΪʱԵǰļڵĿ¼Ϊ¼Ŀ¼
+	bool LocateRecord(int nChannel, UINT64 nTime);
+	/// @brief עOptionsڶȡ͵Կ,ʱһ
+	/// @remark صļԱȥǰ׺ͬ,HeadlessRenderLockProfile,δʱĬֵ
+	void LoadOptions();
+	static bool CALLBACK InitRenderSurface(IRenderSurface *pDxSurface, AVFrame *pFirstFrame, void *pUserPtr);
 	CString		m_strFilePath = _T("");
+	int64_t		m_nStartOffset = 0;			// ļʼλ,λ΢,LocateRecord
+	CRecordIndex m_RecordIndex;				// ¼Ŀ¼ʱ
 	UINT		m_nDecodeCount = 1;
 	UINT		m_nRenderCount = 1;
 	UINT		m_nDxInitCount = 0;
 	UINT		m_nCurRender1st = 1;		// 1ȾĽ·
 	UINT		m_nCurRenderlast = 1;		// һȾĽ·
 	BOOL		m_bEnableHaccel = FALSE;
+	BOOL		m_bZeroCopyRender = TRUE;	// Ӳʱֱʾ,ΪFALSEʹƴӺϳʱ,ȸƵڴʾ
+	int			m_nRenderInterval = 20;		// ͨȾ̵߳ʾ,λ
+	// ͵ԿĬϹر,LoadOptionsעȡ
+	int			m_nHeadlessRender = Headless_None;	// ޴Ⱦ,D3D豸,Ⱦ,ȡֵHeadlessRender
+	BOOL		m_bBatchPresent = FALSE;	// ͬһʾϵ干һ,ÿʾֻPresentһ
+	BOOL		m_bTimelineTrace = FALSE;	// ʱ¼߳̽Ⱦ׶εʱ,ֹͣʱTimeline.json;ҲʱӲ˵͵
+	BOOL		m_bTscClock = FALSE;		// ֺ֧㶨ƵTSCʱ,TSCΪʱӵʱԴ,ȡʱĿ
+	BOOL		m_bLockProfile = FALSE;		// ͳƸλõľ͵ȴʱ,ֹͣʱ
+	UINT		m_nMemoryTraceInterval = 10000;	// ڼֱǩڴͳƵļ,λ,Ϊ0ʱֹֻͣʱ
+	int			m_nLocateChannel = 0;		// һβʱλ¼ͨ
+	UINT		m_nLocateTime = 0;			// һβʱLocateRecordλ¼ʱ,1970,Ϊ0ʱλ
 	BOOL		m_bRender = true;
-	HANDLE		*m_hThreadArray = NULL;
+	int			m_nPlacementPolicy = Placement_None;	// 롢Ⱦ̵߳CPUNUMAڵò,ȡֵPlacementPolicy
+	CChannelLifecycle m_Channels;			// ̺߳͸̵ͨ߳ڹ
+	list<ThreadParamPtr> m_listDraining;	// Ƴ߳δ˳ͨ
+	vector<IRenderSurface *> m_vecRecycledSurface;	// ѻյȾ
 	UINT		m_nVideoWndID = 1024;		// һƵID
 	CVideoFrame *m_pVideoWndFrame = nullptr;
+	CMosaicCompositor *m_pMosaic = nullptr;	// ƴӺϳ,ΪnullptrʱͨʹԼCDxSurfaceʾ
+	CPresentBatchGroup *m_pBatchGroup = nullptr;	// ʾ,ΪnullptrʱͨPresent
 	list<FramePtr>	m_InputQueue;
+	AVCodecContext *m_pInputCodecCtx = nullptr;	// ļƵı,ڴ¼ļ
+	AVRational	m_nInputTimeBase;				// ļƵʱ
+	AVRational	m_nInputFrameRate;
 	LPCTSTR		m_szWndClass = NULL;
 	afx_msg void OnSize(UINT nType, int cx, int cy);
 	LRESULT OnInitDxSurface(WPARAM w, LPARAM l);	
@@ -111,4 +232,6 @@ public:
 	afx_msg void OnFileSwitchvideo();
 	afx_msg void OnTimer(UINT_PTR nIDEvent);
 	afx_msg void OnDecoderSetting();
+	afx_msg void OnFileExportTimeline();
+	afx_msg void OnFileRecord();
 };
\ No newline at end of file
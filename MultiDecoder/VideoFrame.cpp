@@ -25,6 +25,7 @@ BEGIN_MESSAGE_MAP(CVideoFrame, CWnd)
 	ON_WM_PAINT()
 	ON_WM_DESTROY()
 	ON_WM_SIZE()
+	ON_WM_LBUTTONDOWN()
 END_MESSAGE_MAP()
 
 // CVideoFrame message handlers
@@ -86,6 +87,8 @@ bool CVideoFrame::AdjustPanels(int nRow, int nCols)
 			m_vecPanel.push_back(PanelInfoPtr(new PanelInfo(nRow, nCol)));
 		}
 	}
+	if (m_nCurSelected >= (int)m_vecPanel.size())
+		SelectPanel(-1);
 	ResizePanel();
 	int nIndex = 0;
 	for (int nRow = 0; nRow < m_nRows; nRow++)
@@ -129,10 +132,26 @@ bool CVideoFrame::AdjustPanels(int nCount)
 	_TraceMsgA("%s Rows = %d\tCols = %d.\n", __FUNCTION__, nRowCount, nColCount);
 	return AdjustPanels(m_nRows, m_nCols);
 }
+void CVideoFrame::SelectPanel(int nIndex)
+{
+	if (nIndex < 0 || nIndex >= (int)m_vecPanel.size())
+		nIndex = -1;
+	if (nIndex == m_nCurSelected)
+		return;
+	_TraceMsgA("%s Selected panel %d -> %d.\n", __FUNCTION__, m_nCurSelected, nIndex);
+	m_nCurSelected = nIndex;
+	Invalidate();
+	CWnd *pParent = GetParent();
+	if (pParent)
+		pParent->PostMessage(WM_PANELSELECTED, (WPARAM)nIndex, 0);
+}
+
 void CVideoFrame::DrawGrid(CDC *pDc)
 {
 	CRect rtClient;
-	pDc->SelectObject(m_pUnSelectedPen);
+	// ָDCԭĻʺͻˢ,ʶʱɾ,ԱDCѡ
+	CPen *pOldPen = pDc->SelectObject(m_pUnSelectedPen);
+	CGdiObject *pOldBrush = nullptr;
 	GetClientRect(&rtClient);
 	int nWidth = rtClient.Width();
 	int nHeight = rtClient.Height();
@@ -177,6 +196,18 @@ void CVideoFrame::DrawGrid(CDC *pDc)
 		}	
 		nStartY += nAvgRowHeight;
 	}
+	// ѡ֮ļ϶лѡп
+	if (m_nCurSelected >= 0 && m_nCurSelected < m_vecPanel.size())
+	{
+		CRect rtSelected = m_vecPanel[m_nCurSelected]->rect;
+		rtSelected.InflateRect(1, 1);
+		pDc->SelectObject(m_pSelectedPen);
+		pOldBrush = pDc->SelectStockObject(NULL_BRUSH);
+		pDc->Rectangle(&rtSelected);
+	}
+	if (pOldBrush)
+		pDc->SelectObject(pOldBrush);
+	pDc->SelectObject(pOldPen);
 	
 //#ifdef _DEBUG
 //	_TraceMsgA("Index\tLeft\tRight\tTop\t\tBottom.\n");
@@ -292,3 +323,17 @@ void CVideoFrame::OnSize(UINT nType, int cx, int cy)
 	for (auto it = m_vecPanel.begin(); it != m_vecPanel.end(); it++)
 		(*it)->UpdateWindow();
 }
+
+// ƴӺϳɺʾʱ崰ڱ,ڿܴ,λò
+void CVideoFrame::OnLButtonDown(UINT nFlags, CPoint point)
+{
+	for (int i = 0; i < m_vecPanel.size(); i++)
+	{
+		if (PtInRect(&m_vecPanel[i]->rect, point))
+		{
+			SelectPanel(i);
+			break;
+		}
+	}
+	CWnd::OnLButtonDown(nFlags, point);
+}
@@ -3,10 +3,12 @@
 #include <assert.h>
 #include <vector>
 #include <memory>
+#include "./DxSurface/DxTrace.h"
 using namespace  std;
 using namespace  std::tr1;
 
 #define		_GRID_LINE_WIDTH	2
+#define		WM_PANELSELECTED	WM_USER + 1027		// ѡеѸı	WPARAMΪѡе,δѡκʱΪ-1
 // CVideoFrame
 
 struct PanelInfo
@@ -110,6 +112,14 @@ public:
 			return nullptr;
 	}
 
+	LPRECT GetPanelRect(int nIndex)
+	{
+		if (nIndex < m_vecPanel.size())
+			return &m_vecPanel[nIndex]->rect;
+		else
+			return nullptr;
+	}
+
 	HWND GetPanelWnd(int nRow, int nCol)
 	{
 		if ((nRow*m_nCols + nCol) < m_vecPanel.size())
@@ -162,20 +172,34 @@ public:
 	bool AdjustPanels(int nRow, int nCols);
 	bool AdjustPanels(int nCount);
 
+	/// @brief ѡ,ѡıʱػѡп֪ͨ
+	/// @param nIndex	,Ϊ-1ʱȡѡ
+	void SelectPanel(int nIndex);
+	int GetCurSelected()
+	{
+		return m_nCurSelected;
+	}
+	// 崰ڵ,Ҳʱ-1
+	int FindPanel(HWND hPanelWnd)
+	{
+		for (int i = 0; i < m_vecPanel.size(); i++)
+		{
+			if (m_vecPanel[i]->hWnd == hPanelWnd)
+				return i;
+		}
+		return -1;
+	}
+
 
 #define __countof(array) (sizeof(array)/sizeof(array[0]))
 #pragma warning (disable:4996)
 
+	// ־ĺ̸̨߳ʽ,첽־֮ǰһа汾ж,DXTRACE_LEVEL
 	static void _TraceMsgA(LPCSTR pFormat, ...)
 	{
 		va_list args;
 		va_start(args, pFormat);
-		int nBuff;
-		CHAR szBuffer[0x7fff];
-		nBuff = _vsnprintf(szBuffer, __countof(szBuffer), pFormat, args);
-		//::wvsprintf(szBuffer, pFormat, args);
-		//assert(nBuff >=0);
-		OutputDebugStringA(szBuffer);
+		DxTraceAsyncV(DXTRACE_INFO, pFormat, args);
 		va_end(args);
 	}
 	
@@ -210,6 +234,13 @@ public:
 			::EndPaint(hWnd, &ps);
 			break;
 		}
+		case WM_LBUTTONDOWN:	// ѡ
+		{
+			CVideoFrame *pFrame = (CVideoFrame *)CWnd::FromHandlePermanent(::GetParent(hWnd));
+			if (pFrame)
+				pFrame->SelectPanel(pFrame->FindPanel(hWnd));
+			return 0;
+		}
 		case WM_LBUTTONDBLCLK:	// ˫ָ
 		{
 			_TraceMsgA("%08X\tWM_LBUTTONDBLCLK.\n", hWnd);
@@ -251,6 +282,7 @@ public:
 	}
 	
 	afx_msg void OnSize(UINT nType, int cx, int cy);
+	afx_msg void OnLButtonDown(UINT nFlags, CPoint point);
 };
 
 
@@ -0,0 +1,299 @@
+// CSpinMutexCRWLockͼͳƵĲ,ԼCRITICAL_SECTIONԱȵܲ
+// ٽֻ޸ͨļ,ʧЧʱԤ
+#include "TestFramework.h"
+#include "AdaptiveLock.h"
+
+#define LOCK_THREADS		8
+#define LOCK_ITERATIONS		100000
+
+struct MutexTestContext
+{
+	CSpinMutex			Mutex;
+	LockSiteStat		*pSite;
+	volatile LONG		bStart;
+	long long			nCounter;
+};
+
+static unsigned __stdcall MutexTestThread(void *p)
+{
+	MutexTestContext *pContext = (MutexTestContext *)p;
+	while (!pContext->bStart)
+		SwitchToThread();
+	for (int i = 0; i < LOCK_ITERATIONS; i++)
+	{
+		CMutexLock lock(&pContext->Mutex, pContext->pSite);
+		pContext->nCounter++;
+	}
+	return 0;
+}
+
+static void RunThreads(unsigned (__stdcall *pThreadProc)(void *), void *pContext, volatile LONG *pStart, int nThreads)
+{
+	std::vector<HANDLE> vecThread(nThreads);
+	for (int i = 0; i < nThreads; i++)
+		vecThread[i] = (HANDLE)_beginthreadex(NULL, 0, pThreadProc, pContext, 0, NULL);
+	InterlockedExchange(pStart, TRUE);
+	WaitForMultipleObjects(nThreads, &vecThread[0], TRUE, INFINITE);
+	for (int i = 0; i < nThreads; i++)
+		CloseHandle(vecThread[i]);
+}
+
+TEST_CASE(AdaptiveLock, SpinMutexExclusion)
+{
+	MutexTestContext *pContext = new MutexTestContext;
+	pContext->pSite = NULL;
+	pContext->bStart = FALSE;
+	pContext->nCounter = 0;
+	RunThreads(MutexTestThread, pContext, &pContext->bStart, LOCK_THREADS);
+	TEST_EQUAL(pContext->nCounter, LOCK_THREADS * LOCK_ITERATIONS);
+	// صʼ״̬,ٴμ
+	TEST_CHECK(pContext->Mutex.TryLock());
+	pContext->Mutex.Unlock();
+	delete pContext;
+}
+
+TEST_CASE(AdaptiveLock, TryLock)
+{
+	CSpinMutex Mutex;
+	{
+		MUTEX_TRYLOCK(lock1, Mutex);
+		TEST_CHECK(lock1.IsLocked());
+		// ѼʱTryLockʧ,ʱ
+		MUTEX_TRYLOCK(lock2, Mutex);
+		TEST_CHECK(!lock2.IsLocked());
+	}
+	MUTEX_TRYLOCK(lock3, Mutex);
+	TEST_CHECK(lock3.IsLocked());
+}
+
+struct RWLockTestContext
+{
+	CRWLock				RWLock;
+	volatile LONG		bStart;
+	long long			nValue1;		// дͬʱ޸ֵ,߼ʼ
+	long long			nValue2;
+	volatile LONG		nTorn;			// ߿Ĳһ´
+	volatile LONG		nReads;
+};
+
+static unsigned __stdcall RWLockWriterThread(void *p)
+{
+	RWLockTestContext *pContext = (RWLockTestContext *)p;
+	while (!pContext->bStart)
+		SwitchToThread();
+	for (int i = 0; i < LOCK_ITERATIONS / 4; i++)
+	{
+		WRITE_LOCK(pContext->RWLock);
+		pContext->nValue1++;
+		pContext->nValue2++;
+	}
+	return 0;
+}
+
+static unsigned __stdcall RWLockReaderThread(void *p)
+{
+	RWLockTestContext *pContext = (RWLockTestContext *)p;
+	while (!pContext->bStart)
+		SwitchToThread();
+	for (int i = 0; i < LOCK_ITERATIONS / 4; i++)
+	{
+		READ_LOCK(pContext->RWLock);
+		if (pContext->nValue1 != pContext->nValue2)
+			InterlockedIncrement(&pContext->nTorn);
+		InterlockedIncrement(&pContext->nReads);
+	}
+	return 0;
+}
+
+TEST_CASE(AdaptiveLock, RWLockExclusion)
+{
+	const int nWriters = 2;
+	const int nReaders = 4;
+	RWLockTestContext *pContext = new RWLockTestContext;
+	pContext->bStart = FALSE;
+	pContext->nValue1 = 0;
+	pContext->nValue2 = 0;
+	pContext->nTorn = 0;
+	pContext->nReads = 0;
+	HANDLE hThreads[nWriters + nReaders];
+	for (int i = 0; i < nWriters + nReaders; i++)
+		hThreads[i] = (HANDLE)_beginthreadex(NULL, 0, i < nWriters ? RWLockWriterThread : RWLockReaderThread, pContext, 0, NULL);
+	InterlockedExchange(&pContext->bStart, TRUE);
+	WaitForMultipleObjects(nWriters + nReaders, hThreads, TRUE, INFINITE);
+	for (int i = 0; i < nWriters + nReaders; i++)
+		CloseHandle(hThreads[i]);
+	TEST_EQUAL(pContext->nValue1, nWriters * (LOCK_ITERATIONS / 4));
+	TEST_EQUAL(pContext->nValue2, nWriters * (LOCK_ITERATIONS / 4));
+	TEST_EQUAL(pContext->nTorn, 0);
+	TEST_EQUAL(pContext->nReads, nReaders * (LOCK_ITERATIONS / 4));
+	delete pContext;
+}
+
+struct WriterWaitContext
+{
+	CRWLock				*pRWLock;
+	volatile LONG		bLocked;
+};
+
+static unsigned __stdcall WriterWaitThread(void *p)
+{
+	WriterWaitContext *pContext = (WriterWaitContext *)p;
+	pContext->pRWLock->Lock();
+	InterlockedExchange(&pContext->bLocked, TRUE);
+	pContext->pRWLock->Unlock();
+	return 0;
+}
+
+// д:дߵȴʱµĶ߲ܽ,ȫ˳д߻
+TEST_CASE(AdaptiveLock, RWLockWriterPreference)
+{
+	CRWLock RWLock;
+	WriterWaitContext Context = { &RWLock, FALSE };
+	TEST_CHECK(RWLock.TryLockShared());
+	HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, WriterWaitThread, &Context, 0, NULL);
+	Sleep(50);
+	TEST_CHECK(!Context.bLocked);
+	TEST_CHECK(!RWLock.TryLockShared());
+	RWLock.UnlockShared();
+	TEST_EQUAL(WaitForSingleObject(hThread, 5000), WAIT_OBJECT_0);
+	CloseHandle(hThread);
+	TEST_CHECK(Context.bLocked);
+	// д˳ȴ־,߿ٴν
+	TEST_CHECK(RWLock.TryLockShared());
+	RWLock.UnlockShared();
+	TEST_CHECK(RWLock.TryLock());
+	RWLock.Unlock();
+}
+
+// ͳƺÿμλ,ȴʱֻڷʱ
+TEST_CASE(AdaptiveLock, Profile)
+{
+	static LockSiteStat Site = { "Mutex", __FUNCTION__, __LINE__ };
+	LockProfileReset();
+	LockProfileEnable(true);
+	MutexTestContext *pContext = new MutexTestContext;
+	pContext->pSite = &Site;
+	pContext->bStart = FALSE;
+	pContext->nCounter = 0;
+	RunThreads(MutexTestThread, pContext, &pContext->bStart, 4);
+	LockProfileEnable(false);
+	TEST_EQUAL(pContext->nCounter, 4 * LOCK_ITERATIONS);
+	TEST_EQUAL(Site.nAcquires, 4 * LOCK_ITERATIONS);
+	TEST_CHECK(Site.bRegistered);
+	TEST_CHECK(Site.nContended <= Site.nAcquires);
+	TEST_CHECK(Site.nMaxWaitNs <= Site.nWaitNs);
+	TEST_CHECK(Site.nContended == 0 || Site.nWaitNs > 0);
+	TEST_CHECK(Site.nHoldNs > 0);
+	printf("  contended = %d, wait = %.3fms\n", (int)Site.nContended, Site.nWaitNs / 1e6);
+
+	// رͳƺټ¼
+	pContext->bStart = FALSE;
+	RunThreads(MutexTestThread, pContext, &pContext->bStart, 2);
+	TEST_EQUAL(Site.nAcquires, 4 * LOCK_ITERATIONS);
+	LockProfileReset();
+	TEST_EQUAL(Site.nAcquires, 0);
+	TEST_EQUAL(Site.nWaitNs, 0);
+	delete pContext;
+}
+
+enum LockBenchType
+{
+	LockBench_CriticalSection = 0,
+	LockBench_SpinMutex,
+	LockBench_RWLockExclusive,
+	LockBench_RWLockShared,
+	LockBench_Count
+};
+
+struct LockBenchContext
+{
+	LockBenchType		nType;
+	long long			nIterations;
+	volatile LONG		bStart;
+	CRITICAL_SECTION	cs;
+	CSpinMutex			Mutex;
+	CRWLock				RWLock;
+	volatile LONG		nCounter;
+};
+
+static inline void LockBenchOp(LockBenchContext *pContext)
+{
+	switch (pContext->nType)
+	{
+	case LockBench_CriticalSection:
+		EnterCriticalSection(&pContext->cs);
+		pContext->nCounter++;
+		LeaveCriticalSection(&pContext->cs);
+		break;
+	case LockBench_SpinMutex:
+		pContext->Mutex.Lock();
+		pContext->nCounter++;
+		pContext->Mutex.Unlock();
+		break;
+	case LockBench_RWLockExclusive:
+		pContext->RWLock.Lock();
+		pContext->nCounter++;
+		pContext->RWLock.Unlock();
+		break;
+	default:
+		pContext->RWLock.LockShared();
+		InterlockedIncrement(&pContext->nCounter);
+		pContext->RWLock.UnlockShared();
+		break;
+	}
+}
+
+static unsigned __stdcall LockBenchThread(void *p)
+{
+	LockBenchContext *pContext = (LockBenchContext *)p;
+	while (!pContext->bStart)
+		SwitchToThread();
+	for (long long i = 0; i < pContext->nIterations; i++)
+		LockBenchOp(pContext);
+	return 0;
+}
+
+// ÿμĺʱ,ٽֻһ,Ŀ
+// 1̼߳Ϊ޾Ŀ;߳ʱɱ,ֱܺʱ̼ʱʱ
+BENCHMARK(AdaptiveLock, Contention)
+{
+	static const char *szTypeName[LockBench_Count] = { "CRITICAL_SECTION", "CSpinMutex", "CRWLock(Exclusive)", "CRWLock(Shared)" };
+	const int nThreadCounts[] = { 1, 4 };
+	for (size_t t = 0; t < sizeof(nThreadCounts) / sizeof(nThreadCounts[0]); t++)
+	{
+		int nThreads = nThreadCounts[t];
+		for (int nType = 0; nType < LockBench_Count; nType++)
+		{
+			LockBenchContext *pContext = new LockBenchContext;
+			pContext->nType = (LockBenchType)nType;
+			pContext->nCounter = 0;
+			InitializeCriticalSection(&pContext->cs);
+			char szLabel[64];
+			_snprintf(szLabel, sizeof(szLabel), "%s x%d", szTypeName[nType], nThreads);
+			if (nThreads == 1)
+				BenchRun(szLabel, 0, [&]() { LockBenchOp(pContext); });
+			else
+			{
+				long long nIterations = 1024;
+				double dfNsPerOp = 0;
+				for (;;)
+				{
+					pContext->nIterations = nIterations;
+					pContext->bStart = FALSE;
+					pContext->nCounter = 0;
+					int64_t nT1 = TestNowNs();
+					RunThreads(LockBenchThread, pContext, &pContext->bStart, nThreads);
+					int64_t nSpan = TestNowNs() - nT1;
+					dfNsPerOp = (double)nSpan / (nIterations * nThreads);
+					TEST_EQUAL(pContext->nCounter, (LONG)(nIterations * nThreads));
+					if (nSpan >= TestMinTime() * 1e9 || nIterations >= (1LL << 26))
+						break;
+					nIterations *= 2;
+				}
+				printf("  %-44s %12.1f ns/op\n", szLabel, dfNsPerOp);
+			}
+			DeleteCriticalSection(&pContext->cs);
+			delete pContext;
+		}
+	}
+}
@@ -0,0 +1,491 @@
+// libavutilӿڵСʵ,üFFMPEGһԭӵ,߳ͷ
+#include "Win32Port.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+extern "C"
+{
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libswscale/swscale.h"
+}
+#include <math.h>
+
+struct AVBuffer
+{
+	uint8_t			*data;
+	int				size;
+	volatile LONG	refcount;
+	void			(*free)(void *opaque, uint8_t *data);
+	void			*opaque;
+};
+
+void *av_malloc(size_t size)
+{
+	return malloc(size ? size : 1);
+}
+
+void *av_mallocz(size_t size)
+{
+	return calloc(1, size ? size : 1);
+}
+
+void av_free(void *ptr)
+{
+	free(ptr);
+}
+
+void av_freep(void *ptr)
+{
+	void **pp = (void **)ptr;
+	av_free(*pp);
+	*pp = NULL;
+}
+
+void av_buffer_default_free(void *opaque, uint8_t *data)
+{
+	av_free(data);
+}
+
+AVBufferRef *av_buffer_create(uint8_t *data, int size, void (*free)(void *opaque, uint8_t *data), void *opaque, int flags)
+{
+	AVBuffer *pBuffer = (AVBuffer *)av_mallocz(sizeof(AVBuffer));
+	AVBufferRef *pRef = (AVBufferRef *)av_mallocz(sizeof(AVBufferRef));
+	if (!pBuffer || !pRef)
+	{
+		av_free(pBuffer);
+		av_free(pRef);
+		return NULL;
+	}
+	pBuffer->data = data;
+	pBuffer->size = size;
+	pBuffer->refcount = 1;
+	pBuffer->free = free ? free : av_buffer_default_free;
+	pBuffer->opaque = opaque;
+	pRef->buffer = pBuffer;
+	pRef->data = data;
+	pRef->size = size;
+	return pRef;
+}
+
+AVBufferRef *av_buffer_alloc(int size)
+{
+	uint8_t *pData = (uint8_t *)av_malloc(size);
+	if (!pData)
+		return NULL;
+	AVBufferRef *pRef = av_buffer_create(pData, size, av_buffer_default_free, NULL, 0);
+	if (!pRef)
+		av_free(pData);
+	return pRef;
+}
+
+AVBufferRef *av_buffer_ref(AVBufferRef *buf)
+{
+	AVBufferRef *pRef = (AVBufferRef *)av_malloc(sizeof(AVBufferRef));
+	if (!pRef)
+		return NULL;
+	*pRef = *buf;
+	InterlockedIncrement(&buf->buffer->refcount);
+	return pRef;
+}
+
+void av_buffer_unref(AVBufferRef **buf)
+{
+	if (!buf || !*buf)
+		return;
+	AVBuffer *pBuffer = (*buf)->buffer;
+	av_freep(buf);
+	if (InterlockedDecrement(&pBuffer->refcount) == 0)
+	{
+		pBuffer->free(pBuffer->opaque, pBuffer->data);
+		av_free(pBuffer);
+	}
+}
+
+int av_buffer_get_ref_count(const AVBufferRef *buf)
+{
+	return buf->buffer->refcount;
+}
+
+AVFrame *av_frame_alloc(void)
+{
+	return (AVFrame *)av_mallocz(sizeof(AVFrame));
+}
+
+void av_frame_free(AVFrame **frame)
+{
+	if (!frame || !*frame)
+		return;
+	av_frame_unref(*frame);
+	av_freep(frame);
+}
+
+int av_frame_ref(AVFrame *dst, const AVFrame *src)
+{
+	if (!src->buf[0])
+		return -1;
+	*dst = *src;
+	for (int i = 0; i < AV_NUM_DATA_POINTERS; i++)
+	{
+		dst->buf[i] = NULL;
+		if (src->buf[i] && !(dst->buf[i] = av_buffer_ref(src->buf[i])))
+		{
+			av_frame_unref(dst);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+void av_frame_unref(AVFrame *frame)
+{
+	for (int i = 0; i < AV_NUM_DATA_POINTERS; i++)
+		av_buffer_unref(&frame->buf[i]);
+	memset(frame, 0, sizeof(AVFrame));
+}
+
+void av_frame_move_ref(AVFrame *dst, AVFrame *src)
+{
+	*dst = *src;
+	memset(src, 0, sizeof(AVFrame));
+}
+
+AVFrame *av_frame_clone(const AVFrame *src)
+{
+	AVFrame *pFrame = av_frame_alloc();
+	if (pFrame && av_frame_ref(pFrame, src) < 0)
+		av_frame_free(&pFrame);
+	return pFrame;
+}
+
+int av_strerror(int errnum, char *errbuf, size_t errbuf_size)
+{
+	snprintf(errbuf, errbuf_size, "Error number %d occurred", errnum);
+	return 0;
+}
+
+struct BufferPoolEntry
+{
+	AVBufferRef		*pRaw;		// ɳصķ亯Ļ
+	AVBufferPool	*pPool;
+	BufferPoolEntry	*pNext;
+};
+
+struct AVBufferPool
+{
+	CRITICAL_SECTION	csPool;
+	BufferPoolEntry		*pFree;
+	volatile LONG		refcount;	// ر1üϽĻ
+	int					size;
+	AVBufferRef			*(*alloc)(int size);
+};
+
+static void BufferPoolFree(AVBufferPool *pPool)
+{
+	while (pPool->pFree)
+	{
+		BufferPoolEntry *pEntry = pPool->pFree;
+		pPool->pFree = pEntry->pNext;
+		av_buffer_unref(&pEntry->pRaw);
+		av_free(pEntry);
+	}
+	DeleteCriticalSection(&pPool->csPool);
+	av_free(pPool);
+}
+
+static void BufferPoolRelease(void *opaque, uint8_t *data)
+{
+	BufferPoolEntry *pEntry = (BufferPoolEntry *)opaque;
+	AVBufferPool *pPool = pEntry->pPool;
+	EnterCriticalSection(&pPool->csPool);
+	pEntry->pNext = pPool->pFree;
+	pPool->pFree = pEntry;
+	LeaveCriticalSection(&pPool->csPool);
+	if (InterlockedDecrement(&pPool->refcount) == 0)
+		BufferPoolFree(pPool);
+}
+
+AVBufferPool *av_buffer_pool_init(int size, AVBufferRef *(*alloc)(int size))
+{
+	AVBufferPool *pPool = (AVBufferPool *)av_mallocz(sizeof(AVBufferPool));
+	if (!pPool)
+		return NULL;
+	InitializeCriticalSection(&pPool->csPool);
+	pPool->refcount = 1;
+	pPool->size = size;
+	pPool->alloc = alloc ? alloc : av_buffer_alloc;
+	return pPool;
+}
+
+void av_buffer_pool_uninit(AVBufferPool **pool)
+{
+	if (!pool || !*pool)
+		return;
+	AVBufferPool *pPool = *pool;
+	*pool = NULL;
+	if (InterlockedDecrement(&pPool->refcount) == 0)
+		BufferPoolFree(pPool);
+}
+
+AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
+{
+	EnterCriticalSection(&pool->csPool);
+	BufferPoolEntry *pEntry = pool->pFree;
+	if (pEntry)
+		pool->pFree = pEntry->pNext;
+	LeaveCriticalSection(&pool->csPool);
+	if (!pEntry)
+	{
+		pEntry = (BufferPoolEntry *)av_mallocz(sizeof(BufferPoolEntry));
+		if (!pEntry)
+			return NULL;
+		pEntry->pPool = pool;
+		if (!(pEntry->pRaw = pool->alloc(pool->size)))
+		{
+			av_free(pEntry);
+			return NULL;
+		}
+	}
+	AVBufferRef *pRef = av_buffer_create(pEntry->pRaw->data, pool->size, BufferPoolRelease, pEntry, 0);
+	if (!pRef)
+	{
+		BufferPoolRelease(pEntry, NULL);
+		return NULL;
+	}
+	InterlockedIncrement(&pool->refcount);
+	return pRef;
+}
+
+// ƽһеֽ,ƽ,ֵ֧ĸʽ0
+static int GetImagePlanes(enum AVPixelFormat pix_fmt, int width, int height, int nLineBytes[4], int nLines[4])
+{
+	int nWidthUV = (width + 1) >> 1;
+	int nHeightUV = (height + 1) >> 1;
+	memset(nLineBytes, 0, sizeof(int) * 4);
+	memset(nLines, 0, sizeof(int) * 4);
+	switch (pix_fmt)
+	{
+	case AV_PIX_FMT_YUV420P:
+	case AV_PIX_FMT_YUVJ420P:
+	case AV_PIX_FMT_YUV420P10LE:
+		{
+			int nSample = pix_fmt == AV_PIX_FMT_YUV420P10LE ? 2 : 1;
+			nLineBytes[0] = width * nSample;
+			nLineBytes[1] = nLineBytes[2] = nWidthUV * nSample;
+			nLines[0] = height;
+			nLines[1] = nLines[2] = nHeightUV;
+			return 3;
+		}
+	case AV_PIX_FMT_NV12:
+		nLineBytes[0] = width;
+		nLineBytes[1] = nWidthUV * 2;
+		nLines[0] = height;
+		nLines[1] = nHeightUV;
+		return 2;
+	case AV_PIX_FMT_BGRA:
+		nLineBytes[0] = width * 4;
+		nLines[0] = height;
+		return 1;
+	default:
+		return 0;
+	}
+}
+
+int av_image_fill_linesizes(int linesizes[4], enum AVPixelFormat pix_fmt, int width)
+{
+	int nLines[4];
+	if (width <= 0 || !GetImagePlanes(pix_fmt, width, 1, linesizes, nLines))
+		return AVERROR(EINVAL);
+	return 0;
+}
+
+int av_image_fill_arrays(uint8_t *dst_data[4], int dst_linesize[4], const uint8_t *src, enum AVPixelFormat pix_fmt, int width, int height, int align)
+{
+	int nLineBytes[4];
+	int nLines[4];
+	int nPlanes = width > 0 && height > 0 ? GetImagePlanes(pix_fmt, width, height, nLineBytes, nLines) : 0;
+	if (!nPlanes)
+		return AVERROR(EINVAL);
+	int nSize = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		dst_linesize[i] = i < nPlanes ? FFALIGN(nLineBytes[i], align > 0 ? align : 1) : 0;
+		dst_data[i] = i < nPlanes && src ? (uint8_t *)src + nSize : NULL;
+		nSize += dst_linesize[i] * nLines[i];
+	}
+	return nSize;
+}
+
+int av_image_get_buffer_size(enum AVPixelFormat pix_fmt, int width, int height, int align)
+{
+	uint8_t *pData[4];
+	int nLinesize[4];
+	return av_image_fill_arrays(pData, nLinesize, NULL, pix_fmt, width, height, align);
+}
+
+void av_image_copy_plane(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize, int bytewidth, int height)
+{
+	for (int y = 0; y < height; y++)
+		memcpy(dst + y * dst_linesize, src + y * src_linesize, bytewidth);
+}
+
+int av_frame_get_buffer(AVFrame *frame, int align)
+{
+	if (align <= 0)
+		align = 32;
+	int nSize = av_image_get_buffer_size((enum AVPixelFormat)frame->format, frame->width, frame->height, align);
+	if (nSize < 0)
+		return nSize;
+	AVBufferRef *pBuffer = av_buffer_alloc(nSize + align);
+	if (!pBuffer)
+		return AVERROR(ENOMEM);
+	uint8_t *pData = (uint8_t *)FFALIGN((size_t)pBuffer->data, (size_t)align);
+	av_image_fill_arrays(frame->data, frame->linesize, pData, (enum AVPixelFormat)frame->format, frame->width, frame->height, align);
+	frame->buf[0] = pBuffer;
+	return 0;
+}
+
+int av_frame_is_writable(AVFrame *frame)
+{
+	if (!frame->buf[0])
+		return 0;
+	for (int i = 0; i < AV_NUM_DATA_POINTERS; i++)
+	{
+		if (frame->buf[i] && av_buffer_get_ref_count(frame->buf[i]) != 1)
+			return 0;
+	}
+	return 1;
+}
+
+int av_frame_copy(AVFrame *dst, const AVFrame *src)
+{
+	int nLineBytes[4];
+	int nLines[4];
+	if (dst->format != src->format || dst->width != src->width || dst->height != src->height)
+		return AVERROR(EINVAL);
+	int nPlanes = GetImagePlanes((enum AVPixelFormat)src->format, src->width, src->height, nLineBytes, nLines);
+	if (!nPlanes)
+		return AVERROR(EINVAL);
+	for (int i = 0; i < nPlanes; i++)
+		av_image_copy_plane(dst->data[i], dst->linesize[i], src->data[i], src->linesize[i], nLineBytes[i], nLines[i]);
+	return 0;
+}
+
+// ˲һ:ÿĿfilterSizeϵ,ϵΪQ14,FFMPEGfilter/filterPosͬ
+struct SwsStubFilter
+{
+	int			filterSize;
+	int16_t		*filter;
+	int32_t		*filterPos;
+};
+
+struct SwsContext
+{
+	SwsStubFilter	hLum, vLum, hChr, vChr;
+	uint8_t			*lineBuffer;	// ֱ˲Ҫл,filterSize
+	int64_t			nBytes;
+};
+
+static volatile LONGLONG s_nSwsBytes = 0;
+static volatile LONG s_nSwsContexts = 0;
+
+// 㷨ϵ:Ϊ1ϵ,˫Ϊ2,˫Ϊ4,Сʱ˲Сչ
+static bool InitStubFilter(SwsStubFilter &Filter, int srcSize, int dstSize, int flags, int64_t &nBytes)
+{
+	int nTaps = (flags & SWS_POINT) ? 1 : ((flags & SWS_BICUBIC) ? 4 : 2);
+	double dfScale = (double)srcSize / dstSize;
+	Filter.filterSize = dfScale > 1 && nTaps > 1 ? (int)ceil(nTaps * dfScale) : nTaps;
+	Filter.filter = (int16_t *)av_malloc(sizeof(int16_t) * dstSize * Filter.filterSize);
+	Filter.filterPos = (int32_t *)av_malloc(sizeof(int32_t) * dstSize);
+	if (!Filter.filter || !Filter.filterPos)
+		return false;
+	nBytes += sizeof(int16_t) * dstSize * Filter.filterSize + sizeof(int32_t) * dstSize;
+	double dfWidth = dfScale > 1 ? dfScale : 1.0;
+	for (int i = 0; i < dstSize; i++)
+	{
+		double dfCenter = (i + 0.5) * dfScale - 0.5;
+		int nPos = (int)floor(dfCenter - Filter.filterSize / 2.0 + 1);
+		nPos = nPos < 0 ? 0 : (nPos + Filter.filterSize > srcSize ? (srcSize > Filter.filterSize ? srcSize - Filter.filterSize : 0) : nPos);
+		Filter.filterPos[i] = nPos;
+		double dfCoeff[256];
+		double dfSum = 0;
+		int nSize = Filter.filterSize < 256 ? Filter.filterSize : 256;
+		for (int j = 0; j < nSize; j++)
+		{
+			double dfDist = fabs(nPos + j - dfCenter) / dfWidth;
+			dfCoeff[j] = nTaps == 1 ? (j == 0) : (dfDist < nTaps / 2.0 ? nTaps / 2.0 - dfDist : 0);
+			dfSum += dfCoeff[j];
+		}
+		for (int j = 0; j < Filter.filterSize; j++)
+			Filter.filter[i * Filter.filterSize + j] = (int16_t)(j < nSize && dfSum > 0 ? dfCoeff[j] * 16384 / dfSum : 0);
+	}
+	return true;
+}
+
+static void FreeStubFilter(SwsStubFilter &Filter)
+{
+	av_freep(&Filter.filter);
+	av_freep(&Filter.filterPos);
+}
+
+struct SwsContext *sws_getContext(int srcW, int srcH, enum AVPixelFormat srcFormat,
+								  int dstW, int dstH, enum AVPixelFormat dstFormat,
+								  int flags, SwsFilter *srcFilter, SwsFilter *dstFilter, const double *param)
+{
+	int nLineBytes[4], nLines[4];
+	if (srcW <= 0 || srcH <= 0 || dstW <= 0 || dstH <= 0 ||
+		!GetImagePlanes(srcFormat, srcW, srcH, nLineBytes, nLines) ||
+		!GetImagePlanes(dstFormat, dstW, dstH, nLineBytes, nLines))
+		return NULL;
+	SwsContext *c = (SwsContext *)av_mallocz(sizeof(SwsContext));
+	if (!c)
+		return NULL;
+	c->nBytes = sizeof(SwsContext);
+	bool bInited = InitStubFilter(c->hLum, srcW, dstW, flags, c->nBytes) &&
+				   InitStubFilter(c->vLum, srcH, dstH, flags, c->nBytes) &&
+				   InitStubFilter(c->hChr, (srcW + 1) / 2, (dstW + 1) / 2, flags, c->nBytes) &&
+				   InitStubFilter(c->vChr, (srcH + 1) / 2, (dstH + 1) / 2, flags, c->nBytes);
+	if (bInited)
+	{// ÿа16λм,ȺɫȸfilterSize
+		int64_t nLineSize = (int64_t)(dstW * 2 + 64) * 2 * (c->vLum.filterSize + c->vChr.filterSize);
+		c->lineBuffer = (uint8_t *)av_mallocz((size_t)nLineSize);
+		c->nBytes += nLineSize;
+		bInited = c->lineBuffer != NULL;
+	}
+	if (!bInited)
+	{
+		sws_freeContext(c);
+		return NULL;
+	}
+	InterlockedExchangeAdd64(&s_nSwsBytes, c->nBytes);
+	InterlockedIncrement(&s_nSwsContexts);
+	return c;
+}
+
+void sws_freeContext(struct SwsContext *swsContext)
+{
+	if (!swsContext)
+		return;
+	if (swsContext->lineBuffer)
+	{
+		InterlockedExchangeAdd64(&s_nSwsBytes, -swsContext->nBytes);
+		InterlockedDecrement(&s_nSwsContexts);
+	}
+	FreeStubFilter(swsContext->hLum);
+	FreeStubFilter(swsContext->vLum);
+	FreeStubFilter(swsContext->hChr);
+	FreeStubFilter(swsContext->vChr);
+	av_freep(&swsContext->lineBuffer);
+	av_free(swsContext);
+}
+
+int64_t AvStubSwsBytes(void)
+{
+	return s_nSwsBytes;
+}
+
+int AvStubSwsContexts(void)
+{
+	return s_nSwsContexts;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+// δ֪Чʱ
+#define AV_NOPTS_VALUE			((int64_t)UINT64_C(0x8000000000000000))
+#define AV_TIME_BASE			1000000
+
+#define FFALIGN(x, a)			(((x) + (a) - 1) & ~((a) - 1))
+#define AVERROR(e)				(-(e))
+
+int av_strerror(int errnum, char *errbuf, size_t errbuf_size);
@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include "mem.h"
+
+#define AV_BUFFER_FLAG_READONLY		(1 << 0)
+
+typedef struct AVBuffer AVBuffer;
+
+typedef struct AVBufferRef
+{
+	AVBuffer	*buffer;
+	uint8_t		*data;
+	int			size;
+} AVBufferRef;
+
+void av_buffer_default_free(void *opaque, uint8_t *data);
+AVBufferRef *av_buffer_create(uint8_t *data, int size, void (*free)(void *opaque, uint8_t *data), void *opaque, int flags);
+AVBufferRef *av_buffer_alloc(int size);
+AVBufferRef *av_buffer_ref(AVBufferRef *buf);
+void av_buffer_unref(AVBufferRef **buf);
+int av_buffer_get_ref_count(const AVBufferRef *buf);
+
+// ,һͷź黹,av_buffer_pool_uninitл黹ͷ
+typedef struct AVBufferPool AVBufferPool;
+
+AVBufferPool *av_buffer_pool_init(int size, AVBufferRef *(*alloc)(int size));
+void av_buffer_pool_uninit(AVBufferPool **pool);
+AVBufferRef *av_buffer_pool_get(AVBufferPool *pool);
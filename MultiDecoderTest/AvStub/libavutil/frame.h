@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include "buffer.h"
+#include "pixfmt.h"
+
+#define AV_NUM_DATA_POINTERS	8
+
+// ֻģͲõֶ
+typedef struct AVFrame
+{
+	uint8_t		*data[AV_NUM_DATA_POINTERS];
+	int			linesize[AV_NUM_DATA_POINTERS];
+	int			width;
+	int			height;
+	int			format;
+	int			key_frame;
+	int64_t		pts;
+	int64_t		pkt_pts;
+	int64_t		pkt_dts;
+	AVBufferRef	*buf[AV_NUM_DATA_POINTERS];
+	void		*opaque;
+} AVFrame;
+
+AVFrame *av_frame_alloc(void);
+void av_frame_free(AVFrame **frame);
+// ֻ֧ü֡,src->buf[0]ΪNULLʱظֵ
+int av_frame_ref(AVFrame *dst, const AVFrame *src);
+void av_frame_unref(AVFrame *frame);
+void av_frame_move_ref(AVFrame *dst, AVFrame *src);
+AVFrame *av_frame_clone(const AVFrame *src);
+// widthheightformatüĻ,ֻ֧imgutils.hֵ֧ĸʽ
+int av_frame_get_buffer(AVFrame *frame, int align);
+int av_frame_is_writable(AVFrame *frame);
+// ͼ,֡ĸʽͳߴͬ
+int av_frame_copy(AVFrame *dst, const AVFrame *src);
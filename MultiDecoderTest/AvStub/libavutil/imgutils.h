@@ -0,0 +1,10 @@
+#pragma once
+#include <stdint.h>
+#include "avutil.h"
+#include "pixfmt.h"
+
+// ֻ֧YUV420PYUVJ420PNV12BGRAYUV420P10LE,ƽпalign,FFMPEGĲһ
+int av_image_fill_linesizes(int linesizes[4], enum AVPixelFormat pix_fmt, int width);
+int av_image_fill_arrays(uint8_t *dst_data[4], int dst_linesize[4], const uint8_t *src, enum AVPixelFormat pix_fmt, int width, int height, int align);
+int av_image_get_buffer_size(enum AVPixelFormat pix_fmt, int width, int height, int align);
+void av_image_copy_plane(uint8_t *dst, int dst_linesize, const uint8_t *src, int src_linesize, int bytewidth, int height);
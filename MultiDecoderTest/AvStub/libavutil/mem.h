@@ -0,0 +1,8 @@
+#pragma once
+// Թ̲FFMPEG,AvStubֻʵֺģõlibavutilӿ,ӦʹõFFMPEG汾һ,ʵּAvStub.cpp
+#include <stddef.h>
+
+void *av_malloc(size_t size);
+void *av_mallocz(size_t size);
+void av_free(void *ptr);
+void av_freep(void *ptr);
@@ -0,0 +1,15 @@
+#pragma once
+
+// ֻģͲõظʽ,ȡֵֻ軥ͬ
+enum AVPixelFormat
+{
+	AV_PIX_FMT_NONE = -1,
+	AV_PIX_FMT_YUV420P,
+	AV_PIX_FMT_YUVJ420P,
+	AV_PIX_FMT_NV12,
+	AV_PIX_FMT_BGRA,
+	AV_PIX_FMT_DXVA2_VLD,
+	AV_PIX_FMT_YUV420P10LE,
+};
+
+#define AV_PIX_FMT_YUV420P10	AV_PIX_FMT_YUV420P10LE
@@ -0,0 +1,23 @@
+#pragma once
+#include "libavutil/avutil.h"
+#include "libavutil/pixfmt.h"
+
+// 㷨ı־,ȡֵFFMPEGͬ
+#define SWS_FAST_BILINEAR	1
+#define SWS_BILINEAR		2
+#define SWS_BICUBIC			4
+#define SWS_POINT			0x10
+#define SWS_AREA			0x20
+
+struct SwsContext;
+typedef struct SwsFilter SwsFilter;
+
+// FFMPEGһΪÿĿؼˮƽʹֱ˲ϵ,Ŀȷл,ʵʵת
+struct SwsContext *sws_getContext(int srcW, int srcH, enum AVPixelFormat srcFormat,
+								  int dstW, int dstH, enum AVPixelFormat dstFormat,
+								  int flags, SwsFilter *srcFilter, SwsFilter *dstFilter, const double *param);
+void sws_freeContext(struct SwsContext *swsContext);
+
+// ½AvStubṩ:ǰSwsContextռõֽ
+int64_t AvStubSwsBytes(void);
+int AvStubSwsContexts(void);
@@ -0,0 +1,205 @@
+// CChannelLifecycleĲԺܲ
+// Կת̴߳߳,ͨӡƳպ͹ر,Լ߳˳ʱٴͬһŵͨ;
+// ܲ256·²ͨ͹رյĺʱ,ҪԿ
+#include "TestFramework.h"
+#include "ChannelLifecycle.h"
+#include "LatencyHistogram.h"
+
+struct LifecycleContext
+{
+	volatile LONG	bRun;
+	volatile LONG	bStarted;
+	volatile LONG	nRecords;
+	CChannelLatency	*pLatency;
+};
+
+// ת߳ÿһ˳־,߳ÿ֡һ൱
+static UINT __stdcall LifecycleThread(void *p)
+{
+	LifecycleContext *pContext = (LifecycleContext *)p;
+	InterlockedExchange(&pContext->bStarted, TRUE);
+	while (pContext->bRun)
+	{
+		if (pContext->pLatency)
+		{
+			int64_t nT1 = MonoTimeNs();
+			pContext->pLatency->Record(LatencyStage_Decode, nT1, nT1 + 1000);
+			InterlockedIncrement(&pContext->nRecords);
+		}
+		Sleep(1);
+	}
+	return 0;
+}
+
+static void CALLBACK LifecycleStop(int nChannel, void *pContext, void *pUserPtr)
+{
+	InterlockedExchange(&((LifecycleContext *)pContext)->bRun, FALSE);
+}
+
+// ˳صֻ,ɲ߳ѯ
+static void CALLBACK LifecycleExit(int nChannel, void *pContext, void *pUserPtr)
+{
+	InterlockedIncrement((volatile LONG *)pUserPtr);
+}
+
+static bool WaitExited(volatile LONG &nExited, LONG nExpected)
+{
+	for (int i = 0; i < 5000 && nExited < nExpected; i++)
+		Sleep(1);
+	return nExited >= nExpected;
+}
+
+static void InitContext(LifecycleContext *pContext, int nCount)
+{
+	for (int i = 0; i < nCount; i++)
+	{
+		pContext[i].bRun = TRUE;
+		pContext[i].bStarted = FALSE;
+		pContext[i].nRecords = 0;
+		pContext[i].pLatency = NULL;
+	}
+}
+
+TEST_CASE(ChannelLifecycle, AddRemoveReap)
+{
+	volatile LONG nExited = 0;
+	LifecycleContext Context[4];
+	InitContext(Context, 4);
+	CChannelLifecycle Lifecycle;
+	Lifecycle.SetCallback(LifecycleStop, LifecycleExit, (void *)&nExited);
+	for (int i = 0; i < 4; i++)
+		TEST_CHECK(Lifecycle.Add(i, LifecycleThread, &Context[i]));
+	TEST_CHECK(!Lifecycle.Add(0, LifecycleThread, &Context[0]));
+	TEST_EQUAL(Lifecycle.GetAliveCount(), 4);
+	// еܻͨ
+	TEST_CHECK(!Lifecycle.Reap(&Context[1]));
+	TEST_CHECK(Lifecycle.Remove(&Context[1]));
+	TEST_CHECK(WaitExited(nExited, 1));
+	TEST_CHECK(Lifecycle.Reap(&Context[1]));
+	TEST_CHECK(!Lifecycle.Reap(&Context[1]));
+	TEST_EQUAL(Lifecycle.GetAliveCount(), 3);
+	// պٴ
+	Context[1].bRun = TRUE;
+	TEST_CHECK(Lifecycle.Add(1, LifecycleThread, &Context[1]));
+	TEST_CHECK(Lifecycle.Shutdown(5000));
+	TEST_EQUAL(Lifecycle.GetAliveCount(), 0);
+	// رڼ˳̲߳˳ص
+	TEST_EQUAL(nExited, 1);
+	ChannelLifecycleStat Stat;
+	Lifecycle.GetStat(Stat);
+	TEST_EQUAL(Stat.nAdded, 5);
+	TEST_EQUAL(Stat.nRemoved, 1);
+	TEST_EQUAL(Stat.nExited, 5);
+}
+
+TEST_CASE(ChannelLifecycle, SuspendedUntilResume)
+{
+	volatile LONG nExited = 0;
+	LifecycleContext Context[3];
+	InitContext(Context, 3);
+	CChannelLifecycle Lifecycle;
+	Lifecycle.SetCallback(LifecycleStop, LifecycleExit, (void *)&nExited);
+	for (int i = 0; i < 3; i++)
+		TEST_CHECK(Lifecycle.Add(i, LifecycleThread, &Context[i], true));
+	Sleep(20);
+	TEST_EQUAL(Context[0].bStarted + Context[1].bStarted + Context[2].bStarted, 0);
+	// Ƴͨʱ߳ȿʼ,鵽˳־˳
+	TEST_CHECK(Lifecycle.Remove(&Context[2]));
+	TEST_CHECK(WaitExited(nExited, 1));
+	TEST_CHECK(Lifecycle.Reap(&Context[2]));
+	TEST_EQUAL(Lifecycle.ResumeAll(), 2);
+	for (int i = 0; i < 2000 && !(Context[0].bStarted && Context[1].bStarted); i++)
+		Sleep(1);
+	TEST_CHECK(Context[0].bStarted && Context[1].bStarted);
+	TEST_CHECK(Lifecycle.Shutdown(5000));
+}
+
+// Ƴͨ˳ʱ,ͬһŵͨѾʼ,߸дAddChannelֱͼ,ʧҲظ
+TEST_CASE(ChannelLifecycle, ReuseIndexWhileDraining)
+{
+	const int nChannel = 300;
+	volatile LONG nExited = 0;
+	LifecycleContext Context[2];
+	InitContext(Context, 2);
+	CLatencyMonitor Monitor;
+	CChannelLifecycle Lifecycle;
+	Lifecycle.SetCallback(LifecycleStop, LifecycleExit, (void *)&nExited);
+	Context[0].pLatency = Monitor.AddChannel(nChannel);
+	Context[1].pLatency = Monitor.AddChannel(nChannel);
+	TEST_CHECK(Context[0].pLatency != Context[1].pLatency);
+	TEST_CHECK(Lifecycle.Add(nChannel, LifecycleThread, &Context[0]));
+	while (Context[0].nRecords < 5)
+		Sleep(1);
+	TEST_CHECK(Lifecycle.Remove(&Context[0]));
+	TEST_CHECK(Lifecycle.Add(nChannel, LifecycleThread, &Context[1]));
+	TEST_CHECK(WaitExited(nExited, 1));
+	while (Context[1].nRecords < 5)
+		Sleep(1);
+	TEST_EQUAL(Monitor.GetChannelCount(), nChannel + 1);
+	// ߳˳,պŵֱͼ
+	TEST_CHECK(Lifecycle.Reap(&Context[0]));
+	Monitor.RemoveChannel(Context[0].pLatency);
+	TEST_CHECK(Lifecycle.Shutdown(5000));
+	LatencySnapshot Snapshot;
+	TEST_CHECK(Monitor.GetSnapshot(nChannel, Snapshot));
+	TEST_EQUAL(Snapshot.Stage[LatencyStage_Decode].nCount, Context[0].nRecords + Context[1].nRecords);
+	Monitor.RemoveChannel(Context[1].pLatency);
+	TEST_CHECK(Monitor.GetSnapshot(LATENCY_ALL_CHANNELS, Snapshot));
+	TEST_EQUAL(Snapshot.Stage[LatencyStage_Decode].nCount, Context[0].nRecords + Context[1].nRecords);
+	TEST_EQUAL(Snapshot.Stage[LatencyStage_Decode].nP50, 1);
+}
+
+// 16·ӵ128·ٵ16·,ӵ256·ȫر,ֻƵ߱ʱ߳ȫ˳ʱ
+BENCHMARK(ChannelLifecycle, Scale256Channels)
+{
+	const int nChannels = 256;
+	const int nLowChannels = 16;
+	const int nHighChannels = 128;
+	volatile LONG nExited = 0;
+	LifecycleContext *pContext = new LifecycleContext[nChannels];
+	InitContext(pContext, nChannels);
+	CChannelLifecycle *pLifecycle = new CChannelLifecycle;
+	pLifecycle->SetCallback(LifecycleStop, LifecycleExit, (void *)&nExited);
+	for (int i = 0; i < nLowChannels; i++)
+		pLifecycle->Add(i, LifecycleThread, &pContext[i]);
+	int64_t nT1 = TestNowNs();
+	for (int i = nLowChannels; i < nHighChannels; i++)
+		pLifecycle->Add(i, LifecycleThread, &pContext[i]);
+	int64_t nScaleUp = TestNowNs() - nT1;
+
+	// Remove,̵߳˳̳߳еõ֪ͨ
+	nT1 = TestNowNs();
+	for (int i = nLowChannels; i < nHighChannels; i++)
+		pLifecycle->Remove(&pContext[i]);
+	int64_t nScaleDown = TestNowNs() - nT1;
+	TEST_CHECK(WaitExited(nExited, nHighChannels - nLowChannels));
+	int64_t nDrain = TestNowNs() - nT1;
+	int nReaped = 0;
+	for (int i = nLowChannels; i < nHighChannels; i++)
+	{
+		nReaped += pLifecycle->Reap(&pContext[i]);
+		pContext[i].bRun = TRUE;
+	}
+	TEST_EQUAL(nReaped, nHighChannels - nLowChannels);
+
+	nT1 = TestNowNs();
+	for (int i = nLowChannels; i < nChannels; i++)
+		pLifecycle->Add(i, LifecycleThread, &pContext[i]);
+	int64_t nAddAll = TestNowNs() - nT1;
+	TEST_EQUAL(pLifecycle->GetAliveCount(), nChannels);
+	nT1 = TestNowNs();
+	TEST_CHECK(pLifecycle->Shutdown(10000));
+	int64_t nShutdown = TestNowNs() - nT1;
+	ChannelLifecycleStat Stat;
+	pLifecycle->GetStat(Stat);
+	printf("  %-44s %12.3f ms\n", "scale up 16 -> 128", nScaleUp / 1e6);
+	printf("  %-44s %12.3f ms\n", "scale down 128 -> 16, Remove", nScaleDown / 1e6);
+	printf("  %-44s %12.3f ms\n", "scale down 128 -> 16, all exited", nDrain / 1e6);
+	printf("  %-44s %12.3f ms\n", "scale up 16 -> 256", nAddAll / 1e6);
+	printf("  %-44s %12.3f ms\n", "shutdown 256", nShutdown / 1e6);
+	printf("  %-44s %12.3f ms\n", "max add", Stat.nMaxAddNs / 1e6);
+	printf("  %-44s %12.3f ms\n", "max stop to exit", Stat.nMaxDrainNs / 1e6);
+	fflush(stdout);
+	delete pLifecycle;
+	delete []pContext;
+}
@@ -0,0 +1,227 @@
+// CLoadShedderĲԺܲ
+// ԰еͨ߳ģʾ:ÿ֡ο֡ؼCIFͼ,ٸƵʾ,
+// ͨÿ֡ļʹCPUΪ߼,صȼɸͨĽӳ,̶ȼ
+#include "TestFramework.h"
+#include "ChannelPriority.h"
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+#define OVERLOAD_FRAME_SIZE		(352 * 288 * 3 / 2)
+#define OVERLOAD_GOP_SIZE		25		// ؼ֡
+#define OVERLOAD_REF_INTERVAL	3		// ÿ3֡1֡Ϊο֡
+#define OVERLOAD_DEMAND			2		// CPUΪ߼ı
+
+struct OverloadChannel
+{
+	CLoadShedder	*pShedder;
+	ChannelPriority	nPriority;
+	volatile LONG	*pRun;
+	int				nPasses;		// һ֡ļ
+	int64_t			nIntervalNs;
+	BYTE			*pRef;
+	BYTE			*pDecode;
+	BYTE			*pPresent;
+	LONG			nTicks;
+	LONG			nPresented;
+	LONG			nShed;
+	LONG			nLate;			// ӳٳһĵ
+	LONG			nMaxLevel;
+};
+
+struct OverloadResult
+{
+	int		nChannels[ChannelPriority_Count];
+	double	dfFps[ChannelPriority_Count];			// ÿͨÿʾ֡
+	double	dfPresented[ChannelPriority_Count];		// ʾ֡ռĵı
+	double	dfLate[ChannelPriority_Count];			// ӳٳһĵı
+	LONG	nShed[ChannelPriority_Count];
+	int		nMaxLevel;
+};
+
+// ģһ֡:ο֡ؼµͼ
+static void DecodeFrame(BYTE *pDst, const BYTE *pRef, int nPasses, int nFrame)
+{
+	for (int n = 0; n < nPasses; n++)
+	{
+		for (int i = 0; i < OVERLOAD_FRAME_SIZE; i++)
+			pDst[i] = (BYTE)((pRef[i] * 3 + pDst[i] + nFrame + n) >> 2);
+	}
+}
+
+// һ,ȡ̵һ
+static int64_t CalibratePass()
+{
+	vector<BYTE> vecRef(OVERLOAD_FRAME_SIZE, 16);
+	vector<BYTE> vecDst(OVERLOAD_FRAME_SIZE, 128);
+	int64_t nBest = INT64_MAX;
+	for (int i = 0; i < 8; i++)
+	{
+		int64_t nT1 = TestNowNs();
+		DecodeFrame(&vecDst[0], &vecRef[0], 1, i);
+		nBest = min(nBest, TestNowNs() - nT1);
+	}
+	return max(nBest, (int64_t)1);
+}
+
+static UINT __stdcall OverloadChannelThread(void *p)
+{
+	OverloadChannel *pChannel = (OverloadChannel *)p;
+	SetThreadPriority(GetCurrentThread(), CLoadShedder::GetThreadPriority(pChannel->nPriority));
+	CMonoPacer Pacer(pChannel->nIntervalNs);
+	for (int nFrame = 0; *pChannel->pRun; nFrame++)
+	{
+		int nIndex = nFrame % OVERLOAD_GOP_SIZE;
+		bool bKeyFrame = nIndex == 0;
+		bool bRefFrame = bKeyFrame || nIndex % OVERLOAD_REF_INTERVAL == 0;
+		AVDiscard nDiscard = pChannel->pShedder->GetDiscard(pChannel->nPriority);
+		pChannel->nMaxLevel = max(pChannel->nMaxLevel, (LONG)pChannel->pShedder->GetLevel());
+		if ((nDiscard >= AVDISCARD_NONKEY && !bKeyFrame) ||
+			(nDiscard >= AVDISCARD_NONREF && !bRefFrame))
+			pChannel->nShed++;
+		else
+		{
+			DecodeFrame(pChannel->pDecode, pChannel->pRef, pChannel->nPasses, nFrame);
+			memcpy(pChannel->pPresent, pChannel->pDecode, OVERLOAD_FRAME_SIZE);
+			if (bRefFrame)
+				swap(pChannel->pRef, pChannel->pDecode);
+			pChannel->nPresented++;
+		}
+		int64_t nLate = Pacer.Wait();
+		pChannel->pShedder->ReportLate(nLate, Pacer.GetInterval());
+		if (nLate > Pacer.GetInterval())
+			pChannel->nLate++;
+		pChannel->nTicks++;
+	}
+	return 0;
+}
+
+// 1ѡеͨ,ķ֮һΪɼͨ,Ϊ̨ͨ
+static void RunOverload(CLoadShedder &Shedder, int nChannels, int nDurationMs, OverloadResult &Result)
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	const int64_t nIntervalNs = 20 * MONO_NS_PER_MS;
+	int64_t nFrameCost = nIntervalNs * OVERLOAD_DEMAND * max((int)si.dwNumberOfProcessors, 1) / nChannels;
+	int nPasses = max((int)(nFrameCost / CalibratePass()), 1);
+	volatile LONG bRun = TRUE;
+	vector<OverloadChannel> vecChannel(nChannels);
+	vector<HANDLE> vecThread;
+	for (int i = 0; i < nChannels; i++)
+	{
+		OverloadChannel &Channel = vecChannel[i];
+		Channel.pShedder = &Shedder;
+		Channel.nPriority = i == 0 ? ChannelPriority_Selected : (i <= nChannels / 4 ? ChannelPriority_Visible : ChannelPriority_Background);
+		Channel.pRun = &bRun;
+		Channel.nPasses = nPasses;
+		Channel.nIntervalNs = nIntervalNs;
+		Channel.pRef = new BYTE[OVERLOAD_FRAME_SIZE];
+		Channel.pDecode = new BYTE[OVERLOAD_FRAME_SIZE];
+		Channel.pPresent = new BYTE[OVERLOAD_FRAME_SIZE];
+		memset(Channel.pRef, 16, OVERLOAD_FRAME_SIZE);
+		memset(Channel.pDecode, 128, OVERLOAD_FRAME_SIZE);
+		Channel.nTicks = 0;
+		Channel.nPresented = 0;
+		Channel.nShed = 0;
+		Channel.nLate = 0;
+		Channel.nMaxLevel = 0;
+	}
+	Shedder.Reset();
+	for (int i = 0; i < nChannels; i++)
+		vecThread.push_back((HANDLE)_beginthreadex(NULL, 0, OverloadChannelThread, &vecChannel[i], 0, NULL));
+	Sleep(nDurationMs);
+	InterlockedExchange(&bRun, FALSE);
+	for (int i = 0; i < vecThread.size(); i++)
+	{
+		WaitForSingleObject(vecThread[i], INFINITE);
+		CloseHandle(vecThread[i]);
+	}
+
+	memset(&Result, 0, sizeof(OverloadResult));
+	LONG nTicks[ChannelPriority_Count] = { 0 };
+	LONG nPresented[ChannelPriority_Count] = { 0 };
+	LONG nLate[ChannelPriority_Count] = { 0 };
+	for (int i = 0; i < nChannels; i++)
+	{
+		OverloadChannel &Channel = vecChannel[i];
+		Result.nChannels[Channel.nPriority]++;
+		nTicks[Channel.nPriority] += Channel.nTicks;
+		nPresented[Channel.nPriority] += Channel.nPresented;
+		nLate[Channel.nPriority] += Channel.nLate;
+		Result.nShed[Channel.nPriority] += Channel.nShed;
+		Result.nMaxLevel = max(Result.nMaxLevel, (int)Channel.nMaxLevel);
+		delete []Channel.pRef;
+		delete []Channel.pDecode;
+		delete []Channel.pPresent;
+	}
+	for (int i = 0; i < ChannelPriority_Count; i++)
+	{
+		if (!Result.nChannels[i] || !nTicks[i])
+			continue;
+		Result.dfFps[i] = nPresented[i] * 1000.0 / nDurationMs / Result.nChannels[i];
+		Result.dfPresented[i] = (double)nPresented[i] / nTicks[i];
+		Result.dfLate[i] = (double)nLate[i] / nTicks[i];
+	}
+}
+
+TEST_CASE(ChannelPriority, DiscardByLevel)
+{
+	for (int nLevel = 0; nLevel <= _SHED_LEVEL_MAX; nLevel++)
+	{
+		TEST_EQUAL(CLoadShedder::GetDiscard(ChannelPriority_Selected, nLevel), AVDISCARD_DEFAULT);
+		TEST_CHECK(CLoadShedder::GetDiscard(ChannelPriority_Visible, nLevel) <= CLoadShedder::GetDiscard(ChannelPriority_Background, nLevel));
+	}
+	TEST_EQUAL(CLoadShedder::GetDiscard(ChannelPriority_Background, 0), AVDISCARD_DEFAULT);
+	TEST_EQUAL(CLoadShedder::GetDiscard(ChannelPriority_Background, 1), AVDISCARD_NONREF);
+	TEST_EQUAL(CLoadShedder::GetDiscard(ChannelPriority_Visible, 1), AVDISCARD_DEFAULT);
+	TEST_EQUAL(CLoadShedder::GetDiscard(ChannelPriority_Background, 2), AVDISCARD_NONKEY);
+	TEST_EQUAL(CLoadShedder::GetDiscard(ChannelPriority_Visible, 2), AVDISCARD_NONREF);
+	TEST_CHECK(CLoadShedder::GetThreadPriority(ChannelPriority_Selected) > CLoadShedder::GetThreadPriority(ChannelPriority_Visible));
+	TEST_CHECK(CLoadShedder::GetThreadPriority(ChannelPriority_Visible) > CLoadShedder::GetThreadPriority(ChannelPriority_Background));
+}
+
+// Ϊ500,2ɽӳصȼ1
+TEST_CASE(ChannelPriority, ShedUnderLoad)
+{
+	CLoadShedder Shedder;
+	OverloadResult Result;
+	RunOverload(Shedder, 8, 2000, Result);
+	LoadShedderStat Stat;
+	Shedder.GetStat(Stat);
+	TEST_CHECK(Result.nMaxLevel >= 1);
+	TEST_CHECK(Stat.nLevelChanges >= 1);
+	// ѡеͨ֡,̨ͨ֡
+	TEST_EQUAL(Result.nShed[ChannelPriority_Selected], 0);
+	TEST_EQUAL(Stat.nShed[ChannelPriority_Selected], 0);
+	TEST_CHECK(Result.nShed[ChannelPriority_Background] > 0);
+	TEST_CHECK(Result.dfPresented[ChannelPriority_Selected] >= Result.dfPresented[ChannelPriority_Visible]);
+	TEST_CHECK(Result.dfPresented[ChannelPriority_Visible] >= Result.dfPresented[ChannelPriority_Background]);
+}
+
+static void PrintOverload(const char *szName, const OverloadResult &Result)
+{
+	static const char *szPriorityName[ChannelPriority_Count] = { "background", "visible", "selected" };
+	char szLabel[64];
+	for (int i = ChannelPriority_Count - 1; i >= 0; i--)
+	{
+		sprintf_s(szLabel, sizeof(szLabel), "%s, %s x%d", szName, szPriorityName[i], Result.nChannels[i]);
+		printf("  %-44s %12.1f fps/ch %6.1f%% late\n", szLabel, Result.dfFps[i], Result.dfLate[i] * 100);
+	}
+}
+
+// 64·CPU,Ƚϲ֡Ͱȼ֡ʱȼͨʾ֡ʺͽӳ
+BENCHMARK(ChannelPriority, Overload64Channels)
+{
+	int nDurationMs = TestMinTime() > 0 ? 4000 : 600;
+	CLoadShedder Shedder;
+	OverloadResult Result;
+	Shedder.ForceLevel(0);
+	RunOverload(Shedder, 64, nDurationMs, Result);
+	PrintOverload("no shedding", Result);
+	Shedder.ForceLevel(-1);
+	RunOverload(Shedder, 64, nDurationMs, Result);
+	PrintOverload("shedding", Result);
+	printf("  %-44s %12d\n", "max shed level", Result.nMaxLevel);
+	fflush(stdout);
+}
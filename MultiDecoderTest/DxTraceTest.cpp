@@ -0,0 +1,197 @@
+// DxTrace첽־ĲԺܲ
+// Ϣʱļ,غݡÿ߳ڵ˳Լ¼ļ
+#include "TestFramework.h"
+#include "DxTrace.h"
+#include <string>
+#include <stdlib.h>
+
+static std::string TraceFilePath()
+{
+#ifdef _WIN32
+	char szPath[MAX_PATH];
+	GetTempPathA(MAX_PATH, szPath);
+	return std::string(szPath) + "DxTraceTest.log";
+#else
+	return "/tmp/DxTraceTest.log";
+#endif
+}
+
+// Ϣ½ʱļ,ļ·
+static std::string BeginCapture()
+{
+	std::string strPath = TraceFilePath();
+	DxTraceFlush();
+	remove(strPath.c_str());
+	TEST_CHECK(DxTraceSetOutput(DXTRACE_OUTPUT_FILE, strPath.c_str()));
+	return strPath;
+}
+
+// Ϣ,ָĬĿ,ضص
+static std::vector<std::string> EndCapture(const std::string &strPath)
+{
+	DxTraceFlush();
+	DxTraceSetOutput(DXTRACE_OUTPUT_DEBUGGER);
+	std::vector<std::string> vecLine;
+	FILE *fp = fopen(strPath.c_str(), "rb");
+	TEST_CHECK(fp != NULL);
+	if (!fp)
+		return vecLine;
+	char szLine[4096];
+	while (fgets(szLine, sizeof(szLine), fp))
+		vecLine.push_back(szLine);
+	fclose(fp);
+	remove(strPath.c_str());
+	return vecLine;
+}
+
+TEST_CASE(DxTrace, Format)
+{
+	std::string strPath = BeginCapture();
+	char szName[32] = "channel-7";
+	DxTraceAsync(DXTRACE_INFO, "int=%d int64=%lld double=%.2f str=%s.\n", -12, 1234567890123LL, 3.25, szName);
+	// ַڵʱ,֮޸ԭӰ
+	strcpy(szName, "modified");
+	DxTraceAsync(DXTRACE_INFO, "width=[%*d] precision=[%.3s].\n", 5, 42, "abcdef");
+	DxTraceAsync(DXTRACE_INFO, "null=%s.\n", (const char *)NULL);
+	std::vector<std::string> vecLine = EndCapture(strPath);
+	TEST_EQUAL(vecLine.size(), 3);
+	if (vecLine.size() != 3)
+		return;
+	TEST_CHECK(vecLine[0].find("] int=-12 int64=1234567890123 double=3.25 str=channel-7.\n") != std::string::npos);
+	TEST_CHECK(vecLine[1].find("] width=[   42] precision=[abc].\n") != std::string::npos);
+	TEST_CHECK(vecLine[2].find("] null=(null).\n") != std::string::npos);
+}
+
+TEST_CASE(DxTrace, LongMessage)
+{
+	std::string strPath = BeginCapture();
+	std::string strLong(5000, 'x');
+	DxTraceAsync(DXTRACE_INFO, "%s\n", strLong.c_str());
+	std::vector<std::string> vecLine = EndCapture(strPath);
+	// ¼ȵĲֱض,ضϺһ,ַ
+	TEST_EQUAL(vecLine.size(), 1);
+	if (vecLine.size() == 1)
+	{
+		TEST_CHECK(vecLine[0].size() > 900 && vecLine[0].size() < 1100);
+		TEST_CHECK(vecLine[0].find('\0') == std::string::npos);
+	}
+}
+
+#define WRITER_THREADS		8
+#define WRITER_MESSAGES		3000
+
+static unsigned __stdcall WriterThread(void *p)
+{
+	int nWriter = (int)(intptr_t)p;
+	for (int i = 0; i < WRITER_MESSAGES; i++)
+		DxTraceAsync(DXTRACE_INFO, "writer %d seq %d\n", nWriter, i);
+	return 0;
+}
+
+// ߳ͬʱд,λʱϢ,Ϣÿ߳ڱд˳
+TEST_CASE(DxTrace, Concurrent)
+{
+	std::string strPath = BeginCapture();
+	DxTraceStat Stat1, Stat2;
+	DxTraceGetStat(Stat1);
+	HANDLE hThreads[WRITER_THREADS];
+	for (int i = 0; i < WRITER_THREADS; i++)
+		hThreads[i] = (HANDLE)_beginthreadex(NULL, 0, WriterThread, (void *)(intptr_t)i, 0, NULL);
+	WaitForMultipleObjects(WRITER_THREADS, hThreads, TRUE, INFINITE);
+	for (int i = 0; i < WRITER_THREADS; i++)
+		CloseHandle(hThreads[i]);
+	std::vector<std::string> vecLine = EndCapture(strPath);
+	DxTraceGetStat(Stat2);
+
+	LONGLONG nRecords = Stat2.nRecords - Stat1.nRecords;
+	LONGLONG nDropped = Stat2.nDropped - Stat1.nDropped;
+	TEST_EQUAL(nRecords + nDropped, WRITER_THREADS * WRITER_MESSAGES);
+	TEST_EQUAL(vecLine.size(), nRecords);
+	TEST_EQUAL(Stat2.nOutput - Stat1.nOutput, nRecords);
+	int nLastSeq[WRITER_THREADS];
+	for (int i = 0; i < WRITER_THREADS; i++)
+		nLastSeq[i] = -1;
+	bool bOrdered = true;
+	for (size_t i = 0; i < vecLine.size(); i++)
+	{
+		int nWriter = -1, nSeq = -1;
+		size_t nPos = vecLine[i].find("writer ");
+		if (nPos == std::string::npos || sscanf(vecLine[i].c_str() + nPos, "writer %d seq %d", &nWriter, &nSeq) != 2 || nWriter < 0 || nWriter >= WRITER_THREADS)
+		{
+			bOrdered = false;
+			break;
+		}
+		if (nSeq <= nLastSeq[nWriter])
+			bOrdered = false;
+		nLastSeq[nWriter] = nSeq;
+	}
+	TEST_CHECK(bOrdered);
+	printf("  records = %lld, dropped = %lld\n", (long long)nRecords, (long long)nDropped);
+}
+
+static unsigned __stdcall ShortThread(void *p)
+{
+	DxTraceAsync(DXTRACE_INFO, "short-lived thread %d\n", (int)(intptr_t)p);
+	return 0;
+}
+
+// ߳˳һϺ,价λ̸߳
+TEST_CASE(DxTrace, RingReuse)
+{
+	std::string strPath = BeginCapture();
+	DxTraceStat Stat1, Stat2;
+	DxTraceGetStat(Stat1);
+	for (int i = 0; i < 32; i++)
+	{
+		HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, ShortThread, (void *)(intptr_t)i, 0, NULL);
+		WaitForSingleObject(hThread, INFINITE);
+		CloseHandle(hThread);
+		DxTraceFlush();
+	}
+	DxTraceGetStat(Stat2);
+	std::vector<std::string> vecLine = EndCapture(strPath);
+	TEST_EQUAL(vecLine.size(), 32);
+	TEST_CHECK(Stat2.nRings - Stat1.nRings <= 2);
+}
+
+// ͬDxTrace첽DxTraceAsyncÿεõĺʱ
+// ͬʱرյ,൱ûиӵ;첽÷,ÿ֮,ֻͳƵñ
+BENCHMARK(DxTrace, Call)
+{
+	const char *szError = "Invalid data found when processing input";
+#ifndef _WIN32
+	PortDebugOutput() = FALSE;
+#endif
+	BenchRun("DxTrace (sync)", 0, [&]() {
+		DxTrace((char *)"%s Decode error:%s.\n", __FUNCTION__, szError);
+	});
+#ifndef _WIN32
+	PortDebugOutput() = TRUE;
+#endif
+	std::string strPath = BeginCapture();
+	DxTraceStat Stat1, Stat2;
+	DxTraceGetStat(Stat1);
+	const int nBatch = 16;
+	BenchRun("DxTraceAsync x16, then drain", 0, [&]() {
+		for (int i = 0; i < nBatch; i++)
+			DxTraceAsync(DXTRACE_DEBUG, "%s Decode error:%s.\n", __FUNCTION__, szError);
+		DxTraceFlush();
+	});
+	int64_t nStart = TestNowNs();
+	long long nCalls = 0;
+	int64_t nCallNs = 0;
+	// ͳƵñĺʱ,
+	do
+	{
+		int64_t nT1 = TestNowNs();
+		for (int i = 0; i < nBatch; i++)
+			DxTraceAsync(DXTRACE_DEBUG, "%s Decode error:%s.\n", __FUNCTION__, szError);
+		nCallNs += TestNowNs() - nT1;
+		nCalls += nBatch;
+		DxTraceFlush();
+	} while (TestNowNs() - nStart < (int64_t)(TestMinTime() * 1e9));
+	DxTraceGetStat(Stat2);
+	EndCapture(strPath);
+	printf("  %-44s %12.1f ns/op\n", "DxTraceAsync call only", (double)nCallNs / nCalls);
+	printf("  dropped = %lld\n", (long long)(Stat2.nDropped - Stat1.nDropped));
+}
@@ -0,0 +1,270 @@
+// CDxvaDeviceBrokerĲ,ԲԿģ˴D3D9
+// ģΪÿ豸Ų¼豸,ͨõ豸ӿд豸ıź,
+// ͬһϵͨһ豸豸һͨͷź,ԼЧĬ
+#include "TestFramework.h"
+#include "DxvaDeviceBroker.h"
+#include <set>
+
+#define FAKE_ADAPTERS		2		// ŲСڴֵЧ
+#define BROKER_THREADS		8
+#define BROKER_ITERATIONS	2000
+
+class CFakeDeviceBackend : public IDxvaDeviceBackend
+{
+public:
+	CFakeDeviceBackend()
+	{
+		for (int i = 0; i < FAKE_ADAPTERS; i++)
+			m_nLive[i] = 0;
+		m_nCreates = 0;
+		m_nDestroys = 0;
+		m_nShares = 0;
+		m_bFail = FALSE;
+		InitializeCriticalSection(&m_csAlive);
+	}
+	~CFakeDeviceBackend()
+	{
+		DeleteCriticalSection(&m_csAlive);
+	}
+	virtual HRESULT CreateDevice(UINT &nAdapter, DxvaSharedDevice &Device)
+	{
+		if (m_bFail)
+			return E_FAIL;
+		if (nAdapter >= FAKE_ADAPTERS)
+			nAdapter = 0;
+		// 豸ӿֻǲ͸ָ,б豸ıź
+		UINT nSerial = (UINT)InterlockedIncrement(&m_nCreates);
+		ULONG_PTR nHandle = MakeHandle(nSerial, nAdapter);
+		Device.pD3D = (IDirect3D9Ex *)nHandle;
+		Device.pD3DDev = (IDirect3DDevice9Ex *)nHandle;
+		Device.pD3DDevMngr = (IDirect3DDeviceManager9 *)nHandle;
+		Device.nResetToken = nSerial;
+		InterlockedIncrement(&m_nLive[nAdapter]);
+		CAutoLock lock(&m_csAlive);
+		m_setAlive.insert(nSerial);
+		return S_OK;
+	}
+	virtual void DestroyDevice(DxvaSharedDevice &Device)
+	{
+		if (!Device.pD3D)
+			return;
+		InterlockedDecrement(&m_nLive[AdapterOf(Device.pD3DDev)]);
+		InterlockedIncrement(&m_nDestroys);
+		{
+			CAutoLock lock(&m_csAlive);
+			m_setAlive.erase(Device.nResetToken);
+		}
+		Device.pD3D = NULL;
+		Device.pD3DDev = NULL;
+		Device.pD3DDevMngr = NULL;
+	}
+	virtual void ShareDevice(DxvaSharedDevice &Device, IDirect3D9Ex **ppD3D, IDirect3DDevice9Ex **ppD3DDev, IDirect3DDeviceManager9 **ppD3DDevMngr)
+	{
+		*ppD3D = Device.pD3D;
+		*ppD3DDev = Device.pD3DDev;
+		*ppD3DDevMngr = Device.pD3DDevMngr;
+		InterlockedIncrement(&m_nShares);
+	}
+
+	static ULONG_PTR MakeHandle(UINT nSerial, UINT nAdapter)
+	{
+		return ((ULONG_PTR)nSerial << 4) | nAdapter;
+	}
+	static UINT AdapterOf(IDirect3DDevice9Ex *pD3DDev)
+	{
+		return (UINT)((ULONG_PTR)pD3DDev & 0x0F);
+	}
+	bool IsAlive(IDirect3DDevice9Ex *pD3DDev)
+	{
+		CAutoLock lock(&m_csAlive);
+		return m_setAlive.find((UINT)((ULONG_PTR)pD3DDev >> 4)) != m_setAlive.end();
+	}
+
+	volatile LONG		m_nLive[FAKE_ADAPTERS];		// ϴ豸
+	volatile LONG		m_nCreates;
+	volatile LONG		m_nDestroys;
+	volatile LONG		m_nShares;
+	volatile LONG		m_bFail;
+private:
+	CRITICAL_SECTION	m_csAlive;
+	std::set<UINT>		m_setAlive;					// 豸ı
+};
+
+TEST_CASE(DxvaDeviceBroker, ShareOneDevicePerAdapter)
+{
+	CFakeDeviceBackend Backend;
+	CDxvaDeviceBroker Broker(&Backend);
+	IDirect3D9Ex *pD3D = NULL;
+	IDirect3DDevice9Ex *pD3DDev = NULL;
+	IDirect3DDeviceManager9 *pD3DDevMngr = NULL;
+	for (int i = 0; i < 3; i++)
+	{
+		UINT nAdapter = 1;
+		TEST_CHECK(SUCCEEDED(Broker.AcquireDevice(nAdapter, &pD3D, &pD3DDev, &pD3DDevMngr)));
+		TEST_EQUAL(nAdapter, 1);
+		TEST_EQUAL(CFakeDeviceBackend::AdapterOf(pD3DDev), 1);
+		TEST_CHECK(Backend.IsAlive(pD3DDev));
+	}
+	TEST_EQUAL(Backend.m_nCreates, 1);
+	TEST_EQUAL(Backend.m_nShares, 3);
+	LONG nChannels = 0, nSurfaces = 0;
+	LONGLONG nBytes = 0;
+	TEST_CHECK(Broker.GetDeviceStat(1, nChannels, nSurfaces, nBytes));
+	TEST_EQUAL(nChannels, 3);
+	// һͨͷź豸ű
+	Broker.ReleaseDevice(1);
+	Broker.ReleaseDevice(1);
+	TEST_EQUAL(Backend.m_nDestroys, 0);
+	Broker.ReleaseDevice(1);
+	TEST_EQUAL(Backend.m_nDestroys, 1);
+	TEST_EQUAL(Broker.GetDeviceCount(), 0);
+	// ͷű
+	Broker.ReleaseDevice(1);
+	TEST_EQUAL(Backend.m_nDestroys, 1);
+}
+
+// ЧʱĬ,Ĭ豸ʱø豸,½豸
+TEST_CASE(DxvaDeviceBroker, InvalidAdapterFallsBack)
+{
+	CFakeDeviceBackend Backend;
+	CDxvaDeviceBroker Broker(&Backend);
+	IDirect3D9Ex *pD3D = NULL;
+	IDirect3DDevice9Ex *pD3DDev = NULL;
+	IDirect3DDeviceManager9 *pD3DDevMngr = NULL;
+	UINT nAdapter = 0;
+	TEST_CHECK(SUCCEEDED(Broker.AcquireDevice(nAdapter, &pD3D, &pD3DDev, &pD3DDevMngr)));
+	nAdapter = 5;
+	TEST_CHECK(SUCCEEDED(Broker.AcquireDevice(nAdapter, &pD3D, &pD3DDev, &pD3DDevMngr)));
+	TEST_EQUAL(nAdapter, 0);
+	TEST_EQUAL(CFakeDeviceBackend::AdapterOf(pD3DDev), 0);
+	TEST_CHECK(Backend.IsAlive(pD3DDev));
+	TEST_EQUAL(Backend.m_nCreates, 2);
+	TEST_EQUAL(Backend.m_nDestroys, 1);
+	TEST_EQUAL(Broker.GetDeviceCount(), 1);
+	TEST_EQUAL(Backend.m_nLive[0], 1);
+	LONG nChannels = 0, nSurfaces = 0;
+	LONGLONG nBytes = 0;
+	TEST_CHECK(Broker.GetDeviceStat(0, nChannels, nSurfaces, nBytes));
+	TEST_EQUAL(nChannels, 2);
+	Broker.ReleaseDevice(0);
+	Broker.ReleaseDevice(0);
+	TEST_EQUAL(Backend.m_nCreates, Backend.m_nDestroys);
+}
+
+TEST_CASE(DxvaDeviceBroker, CreateFailure)
+{
+	CFakeDeviceBackend Backend;
+	CDxvaDeviceBroker Broker(&Backend);
+	IDirect3D9Ex *pD3D = NULL;
+	IDirect3DDevice9Ex *pD3DDev = NULL;
+	IDirect3DDeviceManager9 *pD3DDevMngr = NULL;
+	Backend.m_bFail = TRUE;
+	UINT nAdapter = 0;
+	TEST_CHECK(FAILED(Broker.AcquireDevice(nAdapter, &pD3D, &pD3DDev, &pD3DDevMngr)));
+	TEST_EQUAL(Broker.GetDeviceCount(), 0);
+	TEST_EQUAL(Backend.m_nShares, 0);
+	// 豸ʧܵͨͷ豸,֮ͨԿ
+	Backend.m_bFail = FALSE;
+	TEST_CHECK(SUCCEEDED(Broker.AcquireDevice(nAdapter, &pD3D, &pD3DDev, &pD3DDevMngr)));
+	Broker.ReleaseDevice(nAdapter);
+	TEST_EQUAL(Backend.m_nCreates, 1);
+	TEST_EQUAL(Backend.m_nDestroys, 1);
+}
+
+TEST_CASE(DxvaDeviceBroker, SurfaceBudget)
+{
+	CFakeDeviceBackend Backend;
+	CDxvaDeviceBroker Broker(&Backend);
+	IDirect3D9Ex *pD3D = NULL;
+	IDirect3DDevice9Ex *pD3DDev = NULL;
+	IDirect3DDeviceManager9 *pD3DDevMngr = NULL;
+	// û豸ܵǼ
+	TEST_CHECK(!Broker.ReserveSurfaces(0, 1, 1024));
+	UINT nAdapter = 0;
+	TEST_CHECK(SUCCEEDED(Broker.AcquireDevice(nAdapter, &pD3D, &pD3DDev, &pD3DDevMngr)));
+	Broker.SetSurfaceBudget(10000);
+	TEST_CHECK(Broker.ReserveSurfaces(0, 6, 6000));
+	TEST_CHECK(!Broker.ReserveSurfaces(0, 6, 6000));
+	TEST_CHECK(Broker.ReserveSurfaces(0, 4, 4000));
+	LONG nChannels = 0, nSurfaces = 0;
+	LONGLONG nBytes = 0;
+	TEST_CHECK(Broker.GetDeviceStat(0, nChannels, nSurfaces, nBytes));
+	TEST_EQUAL(nSurfaces, 10);
+	TEST_EQUAL(nBytes, 10000);
+	Broker.UnreserveSurfaces(0, 6, 6000);
+	TEST_CHECK(Broker.ReserveSurfaces(0, 6, 6000));
+	Broker.UnreserveSurfaces(0, 10, 10000);
+	TEST_CHECK(Broker.GetDeviceStat(0, nChannels, nSurfaces, nBytes));
+	TEST_EQUAL(nSurfaces, 0);
+	TEST_EQUAL(nBytes, 0);
+	Broker.ReleaseDevice(0);
+}
+
+struct BrokerStressContext
+{
+	CDxvaDeviceBroker	*pBroker;
+	CFakeDeviceBackend	*pBackend;
+	volatile LONG		bStart;
+	volatile LONG		nThreadSeed;
+	volatile LONG		nWrongDevice;	// ͨõĲ豸
+	volatile LONG		nDeadDevice;	// ͨʹʱ豸ѱ
+	volatile LONG		nFailed;
+};
+
+// ģͨ򿪺͹ر,ÿѡ,аЧ,ǼǺͳ
+static unsigned __stdcall BrokerStressThread(void *p)
+{
+	BrokerStressContext *pContext = (BrokerStressContext *)p;
+	CTestRandom Random(0x9E3779B9u + InterlockedIncrement(&pContext->nThreadSeed));
+	while (!pContext->bStart)
+		SwitchToThread();
+	for (int i = 0; i < BROKER_ITERATIONS; i++)
+	{
+		IDirect3D9Ex *pD3D = NULL;
+		IDirect3DDevice9Ex *pD3DDev = NULL;
+		IDirect3DDeviceManager9 *pD3DDevMngr = NULL;
+		UINT nAdapter = (UINT)Random.Range(0, FAKE_ADAPTERS);
+		if (FAILED(pContext->pBroker->AcquireDevice(nAdapter, &pD3D, &pD3DDev, &pD3DDevMngr)))
+		{
+			InterlockedIncrement(&pContext->nFailed);
+			continue;
+		}
+		if (CFakeDeviceBackend::AdapterOf(pD3DDev) != nAdapter)
+			InterlockedIncrement(&pContext->nWrongDevice);
+		int nSurfaces = Random.Range(5, 21);
+		if (pContext->pBroker->ReserveSurfaces(nAdapter, nSurfaces, nSurfaces * 4096))
+		{
+			if (Random.Range(0, 3) == 0)
+				SwitchToThread();
+			pContext->pBroker->UnreserveSurfaces(nAdapter, nSurfaces, nSurfaces * 4096);
+		}
+		if (!pContext->pBackend->IsAlive(pD3DDev))
+			InterlockedIncrement(&pContext->nDeadDevice);
+		pContext->pBroker->ReleaseDevice(nAdapter);
+	}
+	return 0;
+}
+
+TEST_CASE(DxvaDeviceBroker, ConcurrentChannels)
+{
+	CFakeDeviceBackend Backend;
+	CDxvaDeviceBroker *pBroker = new CDxvaDeviceBroker(&Backend);
+	BrokerStressContext Context = { pBroker, &Backend, FALSE, 0, 0, 0, 0 };
+	HANDLE hThreads[BROKER_THREADS];
+	for (int i = 0; i < BROKER_THREADS; i++)
+		hThreads[i] = (HANDLE)_beginthreadex(NULL, 0, BrokerStressThread, &Context, 0, NULL);
+	InterlockedExchange(&Context.bStart, TRUE);
+	WaitForMultipleObjects(BROKER_THREADS, hThreads, TRUE, INFINITE);
+	for (int i = 0; i < BROKER_THREADS; i++)
+		CloseHandle(hThreads[i]);
+	TEST_EQUAL(Context.nFailed, 0);
+	TEST_EQUAL(Context.nWrongDevice, 0);
+	TEST_EQUAL(Context.nDeadDevice, 0);
+	TEST_EQUAL(Backend.m_nShares, BROKER_THREADS * BROKER_ITERATIONS);
+	TEST_EQUAL(pBroker->GetDeviceCount(), 0);
+	TEST_EQUAL(Backend.m_nCreates, Backend.m_nDestroys);
+	TEST_EQUAL(Backend.m_nLive[0], 0);
+	TEST_EQUAL(Backend.m_nLive[1], 0);
+	printf("  devices created = %d for %d channel opens\n", (int)Backend.m_nCreates, BROKER_THREADS * BROKER_ITERATIONS);
+	delete pBroker;
+}
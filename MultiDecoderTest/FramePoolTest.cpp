@@ -0,0 +1,254 @@
+// CFramePoolĲԺ64·ܲ
+// Թ̶֡ģ뵽ʾ֮ͬʱеͼ,Ԥ֮ʽͳߴر仯ʱٷڴ;
+// ܲģ64ͨڸԵ߳ȡͼʾ߳ͷ,ȶʱÿķ֡صķֵڴ
+#include "TestFramework.h"
+#include "FramePool.h"
+#include <vector>
+
+#define FRAMEPOOL_TEST_CHANNEL	300		// ʹõͨŴӸֵʼ,Թü
+#define FRAMEPOOL_WORKING_SET	4		// ÿͨͬʱеͼ
+
+struct FramePoolFormat
+{
+	AVPixelFormat	nFormat;
+	int				nWidth;
+	int				nHeight;
+};
+
+// лʱĸʽͳߴ,ΪD1CIF1080PNV12ʹߴD1
+static const FramePoolFormat s_Formats[] =
+{
+	{ AV_PIX_FMT_YUV420P, 704, 576 },
+	{ AV_PIX_FMT_YUV420P, 352, 288 },
+	{ AV_PIX_FMT_NV12, 1920, 1080 },
+	{ AV_PIX_FMT_YUV420P, 703, 575 },
+};
+#define FRAMEPOOL_FORMATS	(int)(sizeof(s_Formats) / sizeof(s_Formats[0]))
+
+static LONG GetPoolAllocs(CFramePool &Pool)
+{
+	FramePoolStat Stat;
+	Pool.GetStat(Stat);
+	return Stat.nAllocs;
+}
+
+// ʽȡnFramesPerFormat֡,ÿθһAVFrame,൱ڽ̳߳еͼʾһͷ
+static bool RunFormatCycle(CFramePool &Pool, AVFrame *pFrames[FRAMEPOOL_WORKING_SET], int nFramesPerFormat, int &nNext)
+{
+	for (int f = 0; f < FRAMEPOOL_FORMATS; f++)
+	{
+		for (int i = 0; i < nFramesPerFormat; i++)
+		{
+			AVFrame *pFrame = pFrames[nNext++ % FRAMEPOOL_WORKING_SET];
+			if (!Pool.GetFrameBuffer(pFrame, s_Formats[f].nFormat, s_Formats[f].nWidth, s_Formats[f].nHeight))
+				return false;
+			// дͼ
+			memset(pFrame->data[0], i, pFrame->linesize[0] * pFrame->height);
+		}
+	}
+	return true;
+}
+
+TEST_CASE(FramePool, ZeroAllocsAfterWarmup)
+{
+	CFramePool Pool;
+	AVFrame *pFrames[FRAMEPOOL_WORKING_SET];
+	for (int i = 0; i < FRAMEPOOL_WORKING_SET; i++)
+		pFrames[i] = av_frame_alloc();
+	int nNext = 0;
+	LONG nAllocs0 = GetPoolAllocs(Pool);
+	TEST_CHECK(RunFormatCycle(Pool, pFrames, 10, nNext));
+	// ÿָʽͬʱйĻ
+	LONG nWarmupAllocs = GetPoolAllocs(Pool) - nAllocs0;
+	TEST_CHECK(nWarmupAllocs >= FRAMEPOOL_FORMATS);
+	TEST_CHECK(nWarmupAllocs <= FRAMEPOOL_FORMATS * FRAMEPOOL_WORKING_SET);
+	LONG nAllocs1 = GetPoolAllocs(Pool);
+	for (int nCycle = 0; nCycle < 5; nCycle++)
+		TEST_CHECK(RunFormatCycle(Pool, pFrames, 10 + nCycle, nNext));
+	TEST_EQUAL(GetPoolAllocs(Pool), nAllocs1);
+
+	FramePoolStat Stat;
+	Pool.GetStat(Stat);
+	TEST_EQUAL(Stat.nPools, FRAMEPOOL_FORMATS);
+	// ƽʼַпFRAMEPOOL_ALIGN
+	for (int i = 0; i < FRAMEPOOL_WORKING_SET; i++)
+	{
+		for (int p = 0; p < 3 && pFrames[i]->data[p]; p++)
+		{
+			TEST_EQUAL((int)((size_t)pFrames[i]->data[p] % FRAMEPOOL_ALIGN), 0);
+			TEST_EQUAL(pFrames[i]->linesize[p] % FRAMEPOOL_ALIGN, 0);
+		}
+		av_frame_free(&pFrames[i]);
+	}
+}
+
+// üͼ񽻸̺߳ɸ߳ͷ,Թ黹ԭĻ
+TEST_CASE(FramePool, ReturnedFromOtherReferences)
+{
+	CFramePool Pool;
+	AVFrame *pFrame = Pool.GetFrame(AV_PIX_FMT_YUV420P, 352, 288);
+	TEST_CHECK(pFrame != NULL);
+	LONG nAllocs = GetPoolAllocs(Pool);
+	AVFrame *pRef = av_frame_clone(pFrame);
+	TEST_CHECK(pRef != NULL);
+	// ʱȡûֻ·
+	TEST_CHECK(Pool.GetFrameBuffer(pFrame, AV_PIX_FMT_YUV420P, 352, 288));
+	TEST_EQUAL(GetPoolAllocs(Pool), nAllocs + 1);
+	av_frame_free(&pRef);
+	TEST_CHECK(Pool.GetFrameBuffer(pFrame, AV_PIX_FMT_YUV420P, 352, 288));
+	TEST_CHECK(Pool.GetFrameBuffer(pFrame, AV_PIX_FMT_YUV420P, 352, 288));
+	TEST_EQUAL(GetPoolAllocs(Pool), nAllocs + 1);
+	av_frame_free(&pFrame);
+}
+
+struct FramePoolChannel
+{
+	CFramePool		*pPool;
+	int				nChannel;
+	int				nFrames;
+	int				nSwitchInterval;	// ÿ֡лһθʽ
+	volatile LONG	*pWarmupDone;		// Ԥɵͨ
+	CRITICAL_SECTION csQueue;
+	vector<AVFrame *> vecQueue;			// ȴʾ߳ͷŵͼ
+	volatile LONG	nOutstanding;		// ȡõδͷŵͼ
+	volatile LONG	bDone;
+	bool			bFailed;
+};
+
+// ߳:ȡͼ󽻸ʾ߳,ʾ߳ͷʱ黹
+static unsigned __stdcall FramePoolDecodeThread(void *p)
+{
+	FramePoolChannel *pChannel = (FramePoolChannel *)p;
+	g_MemoryAccount.SetThreadChannel(pChannel->nChannel);
+	for (int i = 0; i < pChannel->nFrames; i++)
+	{
+		const FramePoolFormat &Format = s_Formats[(i / pChannel->nSwitchInterval) % FRAMEPOOL_FORMATS];
+		// ʾ̻߳ѹʱȴ,ͬʱеͼ
+		while (pChannel->nOutstanding >= FRAMEPOOL_WORKING_SET)
+			Sleep(0);
+		AVFrame *pFrame = pChannel->pPool->GetFrame(Format.nFormat, Format.nWidth, Format.nHeight);
+		if (!pFrame)
+		{
+			pChannel->bFailed = true;
+			break;
+		}
+		memset(pFrame->data[0], i, pFrame->linesize[0]);
+		InterlockedIncrement(&pChannel->nOutstanding);
+		EnterCriticalSection(&pChannel->csQueue);
+		pChannel->vecQueue.push_back(pFrame);
+		LeaveCriticalSection(&pChannel->csQueue);
+		if (i == pChannel->nSwitchInterval * FRAMEPOOL_FORMATS - 1)
+			InterlockedIncrement(pChannel->pWarmupDone);
+	}
+	InterlockedExchange(&pChannel->bDone, TRUE);
+	g_MemoryAccount.SetThreadChannel(MEMORY_SHARED_CHANNEL);
+	return 0;
+}
+
+// ʾ߳:ͷŸͨеͼ
+struct FramePoolRender
+{
+	vector<FramePoolChannel> *pChannels;
+	volatile LONG	bRun;
+};
+
+static unsigned __stdcall FramePoolRenderThread(void *p)
+{
+	FramePoolRender *pRender = (FramePoolRender *)p;
+	vector<AVFrame *> vecFree;
+	for (;;)
+	{
+		bool bAllDone = true;
+		for (size_t i = 0; i < pRender->pChannels->size(); i++)
+		{
+			FramePoolChannel &Channel = (*pRender->pChannels)[i];
+			bool bDone = Channel.bDone != 0;
+			EnterCriticalSection(&Channel.csQueue);
+			vecFree.swap(Channel.vecQueue);
+			LeaveCriticalSection(&Channel.csQueue);
+			for (size_t j = 0; j < vecFree.size(); j++)
+			{
+				av_frame_free(&vecFree[j]);
+				InterlockedDecrement(&Channel.nOutstanding);
+			}
+			vecFree.clear();
+			if (!bDone)
+				bAllDone = false;
+		}
+		if (bAllDone)
+			break;
+		Sleep(0);
+	}
+	return 0;
+}
+
+BENCHMARK(FramePool, Alloc64Channels)
+{
+	const int nChannels = 64;
+	int nFrames = TestMinTime() > 0 ? 2000 : 200;
+	int nSwitchInterval = nFrames / 20;
+	CFramePool *pPool = new CFramePool;
+	vector<FramePoolChannel> vecChannel(nChannels);
+	volatile LONG nWarmupDone = 0;
+	for (int i = 0; i < nChannels; i++)
+	{
+		FramePoolChannel &Channel = vecChannel[i];
+		Channel.pPool = pPool;
+		Channel.nChannel = FRAMEPOOL_TEST_CHANNEL + i;
+		Channel.nFrames = nFrames;
+		Channel.nSwitchInterval = nSwitchInterval;
+		Channel.pWarmupDone = &nWarmupDone;
+		InitializeCriticalSection(&Channel.csQueue);
+		Channel.bDone = FALSE;
+		Channel.nOutstanding = 0;
+		Channel.bFailed = false;
+	}
+	g_MemoryAccount.Reset();
+	LONG nAllocs0 = GetPoolAllocs(*pPool);
+	FramePoolRender Render = { &vecChannel, TRUE };
+	HANDLE hRender = (HANDLE)_beginthreadex(NULL, 0, FramePoolRenderThread, &Render, 0, NULL);
+	vector<HANDLE> vecThread;
+	int64_t nT1 = TestNowNs();
+	for (int i = 0; i < nChannels; i++)
+		vecThread.push_back((HANDLE)_beginthreadex(NULL, 0, FramePoolDecodeThread, &vecChannel[i], 0, NULL));
+	// ͨһָʽлʼȶʱķ
+	while (nWarmupDone < nChannels)
+	{
+		bool bAllDone = true;
+		for (int i = 0; i < nChannels; i++)
+			bAllDone = bAllDone && vecChannel[i].bDone;
+		if (bAllDone)
+			break;
+		Sleep(1);
+	}
+	int64_t nT2 = TestNowNs();
+	LONG nWarmupAllocs = GetPoolAllocs(*pPool) - nAllocs0;
+	for (int i = 0; i < nChannels; i++)
+	{
+		WaitForSingleObject(vecThread[i], INFINITE);
+		CloseHandle(vecThread[i]);
+	}
+	WaitForSingleObject(hRender, INFINITE);
+	CloseHandle(hRender);
+	int64_t nT3 = TestNowNs();
+	LONG nSteadyAllocs = GetPoolAllocs(*pPool) - nAllocs0 - nWarmupAllocs;
+	FramePoolStat Stat;
+	pPool->GetStat(Stat);
+	MemoryTagStat Memory;
+	g_MemoryAccount.GetStat(MemTag_FramePool, MEMORY_ALL_CHANNELS, Memory);
+	for (int i = 0; i < nChannels; i++)
+	{
+		TEST_CHECK(!vecChannel[i].bFailed);
+		DeleteCriticalSection(&vecChannel[i].csQueue);
+	}
+	delete pPool;
+	// ȶʱиʽĻѷ,ٷڴ
+	TEST_EQUAL(nSteadyAllocs, 0);
+	double dfSteadySeconds = (nT3 - nT2) / 1e9;
+	printf("  %-44s %12.1f /s\n", "frames, 64 channels", nChannels * (double)nFrames / ((nT3 - nT1) / 1e9));
+	printf("  %-44s %12d\n", "allocs during warm-up", (int)nWarmupAllocs);
+	printf("  %-44s %12.1f /s\n", "allocs after warm-up", dfSteadySeconds > 0 ? nSteadyAllocs / dfSteadySeconds : 0.0);
+	printf("  %-44s %12.1f MB\n", "frame pool peak", Memory.nPeakBytes / 1048576.0);
+	printf("  %-44s %12.2f MB\n", "frame pool peak per channel", Memory.nPeakBytes / 1048576.0 / nChannels);
+	fflush(stdout);
+}
@@ -0,0 +1,58 @@
+// gpu_memcpyĲԺܲ,ļSSE4.1,ǰCPUǷ֧
+#include "TestFramework.h"
+#include "PixelCopy.h"
+#include "gpu_memcpy_sse4.h"
+
+// 16ֽڶ,gpu_memcpyֻԴĿ궼ʱʹʽȡ
+struct AlignedBuffer
+{
+	std::vector<BYTE>	vecData;
+	BYTE				*pData;
+	explicit AlignedBuffer(size_t nSize, int nFill)
+		: vecData(nSize + 16 + 64, (BYTE)nFill)
+	{
+		pData = &vecData[0] + ((16 - ((size_t)&vecData[0] & 15)) & 15);
+	}
+};
+
+TEST_CASE(GpuMemcpy, Copy)
+{
+	if (!CpuSupportsSSE41())
+	{
+		printf("  SSE4.1 not supported, skipped\n");
+		return;
+	}
+	CTestRandom Rand(10);
+	for (int i = 0; i < 300; i++)
+	{
+		// ǲһѭ顢Լͷĳ,Լδʱ˵memcpy
+		size_t nSize = (size_t)(i < 100 ? Rand.Range(1, 600) : Rand.Range(1, 20000));
+		int nSrcOffset = Rand.Range(0, 3) ? 0 : Rand.Range(1, 15);
+		int nDstOffset = Rand.Range(0, 3) ? 0 : Rand.Range(1, 15);
+		AlignedBuffer Src(nSize + nSrcOffset, 0);
+		Rand.Fill(Src.pData, nSize + nSrcOffset);
+		AlignedBuffer Dst(nSize + nDstOffset, 0xCD);
+		AlignedBuffer Ref(nSize + nDstOffset, 0xCD);
+		memcpy(Ref.pData + nDstOffset, Src.pData + nSrcOffset, nSize);
+		gpu_memcpy(Dst.pData + nDstOffset, Src.pData + nSrcOffset, nSize);
+		TEST_CHECK(memcmp(&Dst.vecData[0] + (Dst.pData - &Dst.vecData[0]), &Ref.vecData[0] + (Ref.pData - &Ref.vecData[0]), nSize + nDstOffset + 64) == 0);
+	}
+}
+
+BENCHMARK(GpuMemcpy, Frame)
+{
+	if (!CpuSupportsSSE41())
+		return;
+	// 1080P NV12,п2048
+	const size_t nSize = 2048 * 1080 * 3 / 2;
+	AlignedBuffer Src(nSize, 0);
+	AlignedBuffer Dst(nSize, 0);
+	CTestRandom Rand;
+	Rand.Fill(Src.pData, nSize);
+	BenchRun("memcpy 1080P NV12", (double)nSize, [&]() {
+		memcpy(Dst.pData, Src.pData, nSize);
+	});
+	BenchRun("gpu_memcpy 1080P NV12", (double)nSize, [&]() {
+		gpu_memcpy(Dst.pData, Src.pData, nSize);
+	});
+}
@@ -0,0 +1,143 @@
+// CLatencyHistogramCLatencyMonitorĲԺܲ
+// ͰٷλͿͨĻ,ܲԲ64ͨͬʱ¼ӳٵĿ,64·25fpsռCPUʱı,Ҫ1%
+#include "TestFramework.h"
+#include "LatencyHistogram.h"
+#include <algorithm>
+#include <vector>
+
+// ÿͰֵͰֵ1/LATENCY_SUB_COUNT
+TEST_CASE(LatencyHistogram, BucketError)
+{
+	int nWorst = 0;
+	for (DWORD nValue = 0; nValue < (1 << 20); nValue = nValue < 4096 ? nValue + 1 : nValue + nValue / 257)
+	{
+		int nIndex = CLatencyHistogram::BucketIndex(nValue);
+		DWORD nBucket = CLatencyHistogram::BucketValue(nIndex);
+		DWORD nError = nBucket > nValue ? nBucket - nValue : nValue - nBucket;
+		if (nIndex < 0 || nIndex >= LATENCY_BUCKETS || (nValue >= LATENCY_SUB_COUNT && nError * LATENCY_SUB_COUNT > nValue))
+			nWorst++;
+	}
+	TEST_EQUAL(nWorst, 0);
+	TEST_CHECK(CLatencyHistogram::BucketIndex(0xFFFFFFFF) < LATENCY_BUCKETS);
+	// Ͱֵ
+	TEST_CHECK(CLatencyHistogram::BucketIndex(1000) < CLatencyHistogram::BucketIndex(1100));
+}
+
+TEST_CASE(LatencyHistogram, Percentiles)
+{
+	CLatencyHistogram Histogram;
+	Histogram.Reset();
+	// 1~1000΢һ
+	for (int i = 1; i <= 1000; i++)
+		Histogram.Record((int64_t)i * MONO_NS_PER_US);
+	LatencyStageSnapshot Snapshot;
+	Histogram.GetSnapshot(Snapshot);
+	TEST_EQUAL(Snapshot.nCount, 1000);
+	TEST_EQUAL(Snapshot.nMax, 1000);
+	TEST_CHECK(Snapshot.nP50 >= 500 - 500 / LATENCY_SUB_COUNT && Snapshot.nP50 <= 500 + 500 / LATENCY_SUB_COUNT);
+	TEST_CHECK(Snapshot.nP90 >= 900 - 900 / LATENCY_SUB_COUNT && Snapshot.nP90 <= 900 + 900 / LATENCY_SUB_COUNT);
+	TEST_CHECK(Snapshot.nP99 >= 990 - 990 / LATENCY_SUB_COUNT && Snapshot.nP99 <= 990 + 990 / LATENCY_SUB_COUNT);
+	TEST_CHECK(Snapshot.dfMean > 500 * 0.95 && Snapshot.dfMean < 500 * 1.05);
+	// ֵΪ0,ΧֵһͰ
+	Histogram.Reset();
+	Histogram.Record(-5);
+	Histogram.Record(0x7FFFFFFFFFFFFFFFLL);
+	Histogram.GetSnapshot(Snapshot);
+	TEST_EQUAL(Snapshot.nCount, 2);
+	TEST_EQUAL(Snapshot.nMax, 0xFFFFFFFF);
+}
+
+// ܿɸֱͨͼϲ
+TEST_CASE(LatencyHistogram, MonitorMergesChannels)
+{
+	CLatencyMonitor Monitor;
+	const int nChannels = 8;
+	for (int i = 0; i < nChannels; i++)
+	{
+		CChannelLatency *pChannel = Monitor.GetChannel(i);
+		TEST_CHECK(pChannel != NULL);
+		TEST_CHECK(Monitor.GetChannel(i) == pChannel);
+		for (int j = 0; j <= i; j++)
+			pChannel->Record(LatencyStage_Decode, 0, (int64_t)(i + 1) * 1000 * MONO_NS_PER_US);
+	}
+	TEST_CHECK(Monitor.GetChannel(-1) == NULL);
+	TEST_EQUAL(Monitor.GetChannelCount(), nChannels);
+	LatencySnapshot Snapshot;
+	TEST_CHECK(Monitor.GetSnapshot(3, Snapshot));
+	TEST_EQUAL(Snapshot.Stage[LatencyStage_Decode].nCount, 4);
+	TEST_EQUAL(Snapshot.Stage[LatencyStage_Present].nCount, 0);
+	TEST_CHECK(!Monitor.GetSnapshot(nChannels, Snapshot));
+	TEST_CHECK(Monitor.GetSnapshot(LATENCY_ALL_CHANNELS, Snapshot));
+	TEST_EQUAL(Snapshot.Stage[LatencyStage_Decode].nCount, nChannels * (nChannels + 1) / 2);
+	TEST_EQUAL(Snapshot.Stage[LatencyStage_Decode].nMax, nChannels * 1000);
+	Monitor.Reset();
+	TEST_CHECK(Monitor.GetSnapshot(LATENCY_ALL_CHANNELS, Snapshot));
+	TEST_EQUAL(Snapshot.Stage[LatencyStage_Decode].nCount, 0);
+}
+
+#define LATENCY_BENCH_FPS		25			// ÿͨ֡
+
+struct LatencyBenchContext
+{
+	CChannelLatency		*pChannel;
+	int					nFrames;
+	volatile LONG		*pStart;
+};
+
+// ģͨĽȾ߳:ÿ֡ĸ׶ǰȡһʱ䲢¼,ʵʱͬ
+static unsigned __stdcall LatencyBenchThread(void *p)
+{
+	LatencyBenchContext *pContext = (LatencyBenchContext *)p;
+	while (!*pContext->pStart)
+		SwitchToThread();
+	for (int i = 0; i < pContext->nFrames; i++)
+	{
+		for (int nStage = 0; nStage < LatencyStage_Count; nStage++)
+		{
+			int64_t nT1 = MonoTimeNs();
+			pContext->pChannel->Record((LatencyStage)nStage, nT1, MonoTimeNs());
+		}
+	}
+	return 0;
+}
+
+// 64ͨͬʱ¼ӳʱÿĿ,Լ64·25fpsʱ¼ӳռCPUʱı
+BENCHMARK(LatencyHistogram, Overhead64Channels)
+{
+	const int nChannels = 64;
+	int nFrames = TestMinTime() > 0 ? 20000 : 10;
+	CLatencyMonitor Monitor;
+	volatile LONG nStart = 0;
+	std::vector<LatencyBenchContext> vecContext(nChannels);
+	std::vector<HANDLE> vecThread(nChannels);
+	for (int i = 0; i < nChannels; i++)
+	{
+		LatencyBenchContext Init = { Monitor.GetChannel(i), nFrames, &nStart };
+		vecContext[i] = Init;
+		vecThread[i] = (HANDLE)_beginthreadex(NULL, 0, LatencyBenchThread, &vecContext[i], 0, NULL);
+	}
+	int64_t nT1 = MonoTimeNs();
+	InterlockedExchange(&nStart, 1);
+	WaitForMultipleObjects(nChannels, &vecThread[0], TRUE, INFINITE);
+	int64_t nSpan = MonoTimeNs() - nT1;
+	for (int i = 0; i < nChannels; i++)
+		CloseHandle(vecThread[i]);
+	LatencySnapshot Snapshot;
+	Monitor.GetSnapshot(LATENCY_ALL_CHANNELS, Snapshot);
+	TEST_EQUAL(Snapshot.Stage[LatencyStage_Present].nCount, nChannels * nFrames);
+
+	// ߳дֱͨͼ,CPUͨʱCPU
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	int nCPUs = std::min((int)si.dwNumberOfProcessors, nChannels);
+	double dfSamples = (double)nChannels * nFrames * LatencyStage_Count;
+	double dfSampleCost = (double)nSpan * nCPUs / dfSamples;
+	double dfSingleCost = Monitor.Calibrate(TestMinTime() > 0 ? 1000000 : 1000);
+	// 64·25fps,ÿ֡LatencyStage_Count,ÿռõCPUʱCPUʱ֮
+	double dfOverhead = (double)nChannels * LATENCY_BENCH_FPS * LatencyStage_Count * dfSampleCost / 1e9 / si.dwNumberOfProcessors;
+	printf("  %-44s %12.1f ns/op\n", "Record + 2 x MonoTimeNs, 1 thread", dfSingleCost);
+	printf("  %-44s %12.1f ns/op\n", "Record + 2 x MonoTimeNs, 64 threads", dfSampleCost);
+	printf("  %-44s %12.4f %% of %d CPU(s)\n", "Overhead at 64 channels x 25 fps", dfOverhead * 100, (int)si.dwNumberOfProcessors);
+	fflush(stdout);
+	TEST_CHECK(dfOverhead < 0.01);
+}
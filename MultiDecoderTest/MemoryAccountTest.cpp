@@ -0,0 +1,286 @@
+// CMemoryAccountĲԺ64·ݲ
+// ǩ͸ͨļ߳ͷŵĻԼʱͨ,ݲģ64ͨͷ,
+// ͨʹص0(ûй©),ͨķֵ乤(ʹ);ܲǩķͳ
+#include "TestFramework.h"
+#include "MemoryAccount.h"
+#include <vector>
+
+#define MEMORY_TEST_CHANNEL		200		// ʹõͨŴӸֵʼ,Թü
+
+static MemoryTagStat GetMemoryStat(MemoryTag nTag, int nChannel)
+{
+	MemoryTagStat Stat;
+	g_MemoryAccount.GetStat(nTag, nChannel, Stat);
+	return Stat;
+}
+
+TEST_CASE(MemoryAccount, TagsAndChannels)
+{
+	int nChannel = MEMORY_TEST_CHANNEL;
+	LONGLONG nTotalBefore = GetMemoryStat(MemTag_Codec, MEMORY_ALL_CHANNELS).nLiveBytes;
+	TEST_EQUAL(g_MemoryAccount.Alloc(MemTag_Codec, nChannel, 1000), nChannel);
+	TEST_EQUAL(g_MemoryAccount.Alloc(MemTag_Codec, nChannel, 500), nChannel);
+	g_MemoryAccount.Free(MemTag_Codec, nChannel, 1000);
+	MemoryTagStat Stat = GetMemoryStat(MemTag_Codec, nChannel);
+	TEST_EQUAL(Stat.nLiveBytes, 500);
+	TEST_EQUAL(Stat.nPeakBytes, 1500);
+	TEST_EQUAL(Stat.nAllocs, 2);
+	TEST_EQUAL(Stat.nFrees, 1);
+	TEST_EQUAL(Stat.nAllocBytes, 1500);
+	// ǩӰ
+	TEST_EQUAL(GetMemoryStat(MemTag_Record, nChannel).nAllocs, 0);
+	// ߳δͨʱ빲ڴ
+	TEST_EQUAL(g_MemoryAccount.Alloc(MemTag_Codec, MEMORY_CURRENT_CHANNEL, 10), MEMORY_SHARED_CHANNEL);
+	g_MemoryAccount.SetThreadChannel(nChannel);
+	TEST_EQUAL(g_MemoryAccount.GetThreadChannel(), nChannel);
+	TEST_EQUAL(g_MemoryAccount.Alloc(MemTag_Codec, MEMORY_CURRENT_CHANNEL, 20), nChannel);
+	TEST_EQUAL(GetMemoryStat(MemTag_Codec, nChannel).nLiveBytes, 520);
+	TEST_EQUAL(GetMemoryStat(MemTag_Codec, MEMORY_ALL_CHANNELS).nLiveBytes - nTotalBefore, 530);
+	g_MemoryAccount.Free(MemTag_Codec, MEMORY_CURRENT_CHANNEL, 520);
+	g_MemoryAccount.SetThreadChannel(MEMORY_SHARED_CHANNEL);
+	g_MemoryAccount.Free(MemTag_Codec, MEMORY_SHARED_CHANNEL, 10);
+	TEST_EQUAL(GetMemoryStat(MemTag_Codec, nChannel).nLiveBytes, 0);
+	TEST_EQUAL(GetMemoryStat(MemTag_Codec, MEMORY_ALL_CHANNELS).nLiveBytes, nTotalBefore);
+	// ЧıǩͲڵͨ
+	TEST_EQUAL(g_MemoryAccount.Alloc(MemTag_Count, nChannel, 1), MEMORY_SHARED_CHANNEL);
+	TEST_CHECK(!g_MemoryAccount.GetStat(MemTag_Count, nChannel, Stat));
+	TEST_CHECK(!g_MemoryAccount.GetStat(MemTag_Codec, g_MemoryAccount.GetChannelCount(), Stat));
+	TEST_CHECK(strcmp(CMemoryAccount::GetTagName(MemTag_Record), "Record") == 0);
+}
+
+struct MemoryFreeContext
+{
+	AVBufferRef		*pBuffer;
+	int				nChannel;
+};
+
+static unsigned __stdcall MemoryAllocThread(void *p)
+{
+	MemoryFreeContext *pContext = (MemoryFreeContext *)p;
+	g_MemoryAccount.SetThreadChannel(pContext->nChannel);
+	pContext->pBuffer = g_MemoryAccount.AllocBuffer(MemTag_FramePool, 4096);
+	return 0;
+}
+
+// AllocBufferĻ߳ͷʱ,Դӷʱͨп۳
+TEST_CASE(MemoryAccount, BufferFreedOnOtherThread)
+{
+	MemoryFreeContext Context = { NULL, MEMORY_TEST_CHANNEL + 1 };
+	HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, MemoryAllocThread, &Context, 0, NULL);
+	WaitForSingleObject(hThread, INFINITE);
+	CloseHandle(hThread);
+	TEST_CHECK(Context.pBuffer != NULL);
+	TEST_EQUAL(GetMemoryStat(MemTag_FramePool, Context.nChannel).nLiveBytes, 4096);
+	AVBufferRef *pRef = av_buffer_ref(Context.pBuffer);
+	av_buffer_unref(&Context.pBuffer);
+	// ʱͷ
+	TEST_EQUAL(GetMemoryStat(MemTag_FramePool, Context.nChannel).nLiveBytes, 4096);
+	av_buffer_unref(&pRef);
+	MemoryTagStat Stat = GetMemoryStat(MemTag_FramePool, Context.nChannel);
+	TEST_EQUAL(Stat.nLiveBytes, 0);
+	TEST_EQUAL(Stat.nFrees, 1);
+}
+
+#define SOAK_CHANNELS			64
+#define SOAK_WORKING_SET		4			// ÿͨͬʱеͼ
+#define SOAK_MAILBOX			2			// ÿͨȾ߳ͷŵͼм;
+#define SOAK_FRAME_BYTES		(352 * 288 * 3 / 2)		// CIF YUV420P
+#define SOAK_PACKET_BYTES		8192
+#define SOAK_CODEC_BYTES		(SOAK_FRAME_BYTES * 6)
+
+struct SoakChannel
+{
+	int					nChannel;
+	int					nFrames;
+	AVBufferRef			*pMailbox[SOAK_MAILBOX];	// Ⱦ߳ͷŵͼ,csMailbox
+	CRITICAL_SECTION	*pcsMailbox;
+	volatile LONG		*pStart;
+};
+
+// ģһͨ:еѹ֡Ĳο֡֡еͼ¼񻺳,ͼԼͷŻ򽻸Ⱦ߳ͷ
+static unsigned __stdcall SoakChannelThread(void *p)
+{
+	SoakChannel *pChannel = (SoakChannel *)p;
+	g_MemoryAccount.SetThreadChannel(pChannel->nChannel);
+	while (!*pChannel->pStart)
+		SwitchToThread();
+	g_MemoryAccount.Alloc(MemTag_Codec, MEMORY_CURRENT_CHANNEL, SOAK_CODEC_BYTES);
+	g_MemoryAccount.Alloc(MemTag_Record, MEMORY_CURRENT_CHANNEL, SOAK_PACKET_BYTES * 16);
+	AVBufferRef *pWorking[SOAK_WORKING_SET] = { NULL };
+	for (int i = 0; i < pChannel->nFrames; i++)
+	{
+		g_MemoryAccount.Alloc(MemTag_PacketQueue, MEMORY_CURRENT_CHANNEL, SOAK_PACKET_BYTES);
+		AVBufferRef *&pSlot = pWorking[i % SOAK_WORKING_SET];
+		if (pSlot)
+		{
+			bool bHanded = false;
+			if (i & 1)
+			{
+				EnterCriticalSection(pChannel->pcsMailbox);
+				for (int j = 0; j < SOAK_MAILBOX && !bHanded; j++)
+				{
+					if (!pChannel->pMailbox[j])
+					{
+						pChannel->pMailbox[j] = pSlot;
+						bHanded = true;
+					}
+				}
+				LeaveCriticalSection(pChannel->pcsMailbox);
+			}
+			if (bHanded)
+				pSlot = NULL;
+			else
+				av_buffer_unref(&pSlot);
+		}
+		// еͼ;ͼֻ֮һ֡,ֵSOAK_WORKING_SET + SOAK_MAILBOX֡
+		pSlot = g_MemoryAccount.AllocBuffer(i % 8 ? MemTag_FramePool : MemTag_Convert, SOAK_FRAME_BYTES);
+		g_MemoryAccount.Free(MemTag_PacketQueue, MEMORY_CURRENT_CHANNEL, SOAK_PACKET_BYTES);
+		if ((i & 15) == 0)
+			SwitchToThread();
+	}
+	for (int i = 0; i < SOAK_WORKING_SET; i++)
+		av_buffer_unref(&pWorking[i]);
+	g_MemoryAccount.Free(MemTag_Record, MEMORY_CURRENT_CHANNEL, SOAK_PACKET_BYTES * 16);
+	g_MemoryAccount.Free(MemTag_Codec, MEMORY_CURRENT_CHANNEL, SOAK_CODEC_BYTES);
+	return 0;
+}
+
+struct SoakRender
+{
+	SoakChannel			*pChannels;
+	volatile LONG		*pStop;
+	LONG				nFreed;
+};
+
+// Ⱦ߳ͷŸͨͼ,ͷżʱͨ
+static unsigned __stdcall SoakRenderThread(void *p)
+{
+	SoakRender *pRender = (SoakRender *)p;
+	for (;;)
+	{
+		bool bStop = *pRender->pStop != 0;
+		for (int i = 0; i < SOAK_CHANNELS; i++)
+		{
+			AVBufferRef *pBuffers[SOAK_MAILBOX] = { NULL };
+			EnterCriticalSection(pRender->pChannels[i].pcsMailbox);
+			memcpy(pBuffers, pRender->pChannels[i].pMailbox, sizeof(pBuffers));
+			ZeroMemory(pRender->pChannels[i].pMailbox, sizeof(pBuffers));
+			LeaveCriticalSection(pRender->pChannels[i].pcsMailbox);
+			for (int j = 0; j < SOAK_MAILBOX; j++)
+			{
+				if (pBuffers[j])
+				{
+					av_buffer_unref(&pBuffers[j]);
+					pRender->nFreed++;
+				}
+			}
+		}
+		if (bStop)
+			break;
+		Sleep(1);
+	}
+	return 0;
+}
+
+struct SoakResult
+{
+	double		dfSeconds;
+	LONG		nHanded;		// Ⱦ߳ͷŵͼ
+};
+
+// 64ͨnFrames֡,߳̽󷵻
+static SoakResult RunMemorySoak(int nFrames)
+{
+	volatile LONG nStart = 0;
+	volatile LONG nStop = 0;
+	std::vector<SoakChannel> vecChannel(SOAK_CHANNELS);
+	std::vector<CRITICAL_SECTION> vecMailboxLock(SOAK_CHANNELS);
+	std::vector<HANDLE> vecThread(SOAK_CHANNELS);
+	for (int i = 0; i < SOAK_CHANNELS; i++)
+	{
+		InitializeCriticalSection(&vecMailboxLock[i]);
+		SoakChannel &Channel = vecChannel[i];
+		Channel.nChannel = MEMORY_TEST_CHANNEL + 10 + i;
+		Channel.nFrames = nFrames;
+		ZeroMemory(Channel.pMailbox, sizeof(Channel.pMailbox));
+		Channel.pcsMailbox = &vecMailboxLock[i];
+		Channel.pStart = &nStart;
+		vecThread[i] = (HANDLE)_beginthreadex(NULL, 0, SoakChannelThread, &Channel, 0, NULL);
+	}
+	SoakRender Render = { &vecChannel[0], &nStop, 0 };
+	HANDLE hRender = (HANDLE)_beginthreadex(NULL, 0, SoakRenderThread, &Render, 0, NULL);
+	int64_t nT1 = TestNowNs();
+	InterlockedExchange(&nStart, 1);
+	WaitForMultipleObjects(SOAK_CHANNELS, &vecThread[0], TRUE, INFINITE);
+	InterlockedExchange(&nStop, 1);
+	WaitForSingleObject(hRender, INFINITE);
+	SoakResult Result = { (double)(TestNowNs() - nT1) / 1e9, Render.nFreed };
+	CloseHandle(hRender);
+	for (int i = 0; i < SOAK_CHANNELS; i++)
+	{
+		CloseHandle(vecThread[i]);
+		DeleteCriticalSection(&vecMailboxLock[i]);
+	}
+	return Result;
+}
+
+TEST_CASE(MemoryAccount, Soak64Channels)
+{
+	const int nFrames = 200;
+	MemoryTagStat Before[MemTag_Count];
+	for (int i = 0; i < MemTag_Count; i++)
+		Before[i] = GetMemoryStat((MemoryTag)i, MEMORY_ALL_CHANNELS);
+	SoakResult Result = RunMemorySoak(nFrames);
+	TEST_CHECK(Result.nHanded > 0);
+	int nLeaked = 0;
+	int nOverCap = 0;
+	int nMiscounted = 0;
+	for (int i = 0; i < SOAK_CHANNELS; i++)
+	{
+		int nChannel = MEMORY_TEST_CHANNEL + 10 + i;
+		for (int j = 0; j < MemTag_Count; j++)
+		{
+			MemoryTagStat Stat = GetMemoryStat((MemoryTag)j, nChannel);
+			nLeaked += Stat.nLiveBytes != 0;
+			nMiscounted += Stat.nAllocs != Stat.nFrees;
+		}
+		// ͼķֵ;ͼڷһ֡
+		LONGLONG nFrameCap = (LONGLONG)(SOAK_WORKING_SET + SOAK_MAILBOX + 1) * SOAK_FRAME_BYTES;
+		nOverCap += GetMemoryStat(MemTag_FramePool, nChannel).nPeakBytes > nFrameCap;
+		nOverCap += GetMemoryStat(MemTag_Convert, nChannel).nPeakBytes > nFrameCap;
+		nOverCap += GetMemoryStat(MemTag_PacketQueue, nChannel).nPeakBytes != SOAK_PACKET_BYTES;
+		nOverCap += GetMemoryStat(MemTag_Codec, nChannel).nPeakBytes != SOAK_CODEC_BYTES;
+		TEST_EQUAL(GetMemoryStat(MemTag_FramePool, nChannel).nAllocs + GetMemoryStat(MemTag_Convert, nChannel).nAllocs, nFrames);
+	}
+	TEST_EQUAL(nLeaked, 0);
+	TEST_EQUAL(nMiscounted, 0);
+	TEST_EQUAL(nOverCap, 0);
+	// ̺ϼ֮ǰͬ,ϼƵķֵͬһʱ̵ʵֵ,ֵ֮ͨ
+	for (int i = 0; i < MemTag_Count; i++)
+	{
+		MemoryTagStat Stat = GetMemoryStat((MemoryTag)i, MEMORY_ALL_CHANNELS);
+		TEST_EQUAL(Stat.nLiveBytes, Before[i].nLiveBytes);
+		TEST_EQUAL(Stat.nAllocs - Before[i].nAllocs, Stat.nFrees - Before[i].nFrees);
+	}
+	MemoryTagStat Total = GetMemoryStat(MemTag_FramePool, MEMORY_ALL_CHANNELS);
+	TEST_CHECK(Total.nPeakBytes <= Before[MemTag_FramePool].nPeakBytes + (LONGLONG)SOAK_CHANNELS * (SOAK_WORKING_SET + SOAK_MAILBOX + 1) * SOAK_FRAME_BYTES);
+}
+
+// 64ͨͷ,ڼǩķͳ,ά㵥ͨʱ
+BENCHMARK(MemoryAccount, Breakdown64Channels)
+{
+	int nFrames = TestMinTime() > 0 ? 2000 : 10;
+	g_MemoryAccount.Reset();
+	SoakResult Result = RunMemorySoak(nFrames);
+	printf("  %-44s %12.1f frames/s\n", "64 channels, AllocBuffer + counters", SOAK_CHANNELS * nFrames / Result.dfSeconds);
+	for (int i = 0; i < MemTag_Count; i++)
+	{
+		MemoryTagStat Total = GetMemoryStat((MemoryTag)i, MEMORY_ALL_CHANNELS);
+		MemoryTagStat Channel = GetMemoryStat((MemoryTag)i, MEMORY_TEST_CHANNEL + 10);
+		char szLabel[64];
+		sprintf_s(szLabel, sizeof(szLabel), "  %s", CMemoryAccount::GetTagName((MemoryTag)i));
+		printf("  %-44s peak %8lld KB  per channel %6lld KB  live %lld KB  allocs %d\n", szLabel,
+				(long long)(Total.nPeakBytes / 1024), (long long)(Channel.nPeakBytes / 1024), (long long)(Total.nLiveBytes / 1024), (int)Total.nAllocs);
+	}
+	fflush(stdout);
+}
@@ -0,0 +1,345 @@
+// CMemorySurfaceĲԺܲ
+// ļָʽͼ,ϴڴеYV12ƽرȽ
+#include "TestFramework.h"
+#include "MemorySurface.h"
+#include "PixelCopy.h"
+#include "RenderStage.h"
+#include <string>
+#include <vector>
+
+#define TEST_PITCH_PAD	40		// Դͼÿжֽ,ϴʱпͼȡ
+
+// һ֡ͼ,ƽͬһ,av_frame_freeͷ
+static AVFrame *MakeImageFrame(int nFormat, int nWidth, int nHeight, CTestRandom &Random)
+{
+	AVFrame *pFrame = av_frame_alloc();
+	int nBytesPerSample = nFormat == AV_PIX_FMT_YUV420P10 ? 2 : 1;
+	int nChromaWidth = (nWidth + 1) / 2;
+	int nChromaHeight = (nHeight + 1) / 2;
+	int nPlaneHeight[3] = { nHeight, nChromaHeight, nChromaHeight };
+	int nPlanes = 3;
+	pFrame->linesize[0] = nWidth * nBytesPerSample + TEST_PITCH_PAD;
+	pFrame->linesize[1] = nChromaWidth * nBytesPerSample + TEST_PITCH_PAD;
+	pFrame->linesize[2] = pFrame->linesize[1];
+	if (nFormat == AV_PIX_FMT_NV12)
+	{
+		nPlanes = 2;
+		pFrame->linesize[1] = pFrame->linesize[0];
+		pFrame->linesize[2] = 0;
+	}
+	int nSize = 0;
+	for (int i = 0; i < nPlanes; i++)
+		nSize += pFrame->linesize[i] * nPlaneHeight[i];
+	pFrame->buf[0] = av_buffer_alloc(nSize);
+	Random.Fill(pFrame->buf[0]->data, nSize);
+	BYTE *pData = pFrame->buf[0]->data;
+	for (int i = 0; i < nPlanes; i++)
+	{
+		pFrame->data[i] = pData;
+		pData += pFrame->linesize[i] * nPlaneHeight[i];
+	}
+	if (nFormat == AV_PIX_FMT_YUV420P10)
+	{// 10λֻе10λЧ
+		for (int i = 0; i < nPlanes; i++)
+		{
+			uint16_t *pSample = (uint16_t *)pFrame->data[i];
+			for (int j = 0; j < pFrame->linesize[i] / 2 * nPlaneHeight[i]; j++)
+				pSample[j] &= 0x3FF;
+		}
+	}
+	pFrame->width = nWidth;
+	pFrame->height = nHeight;
+	pFrame->format = nFormat;
+	return pFrame;
+}
+
+// ȡñYUVƽĵַп
+static const BYTE *GetSurfacePlanes(CMemorySurface &Surface, BYTE *pPlane[3], int nPlanePitch[3], int &nWidth, int &nHeight)
+{
+	int nPitch = 0, nSurfaceHeight = 0;
+	const BYTE *pSurface = Surface.GetSurface(nWidth, nHeight, nPitch, nSurfaceHeight);
+	if (!pSurface)
+	{// ûͼʱͼ񷵻,ߵıȽѭִ
+		nWidth = nHeight = 0;
+		nSurfaceHeight = 0;
+	}
+	GetYV12Planes((BYTE *)pSurface, nPitch, nSurfaceHeight, pPlane, nPlanePitch);
+	return pSurface;
+}
+
+// Ƚϱ8λYUV420PYUVJ420PԴͼ,زһµ
+static int CompareYUV420P(CMemorySurface &Surface, AVFrame *pFrame)
+{
+	BYTE *pPlane[3];
+	int nPlanePitch[3];
+	int nWidth = 0, nHeight = 0;
+	if (!GetSurfacePlanes(Surface, pPlane, nPlanePitch, nWidth, nHeight))
+		return -1;
+	int nMismatch = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		int w = i ? (nWidth + 1) / 2 : nWidth;
+		int h = i ? (nHeight + 1) / 2 : nHeight;
+		for (int y = 0; y < h; y++)
+			for (int x = 0; x < w; x++)
+				nMismatch += pPlane[i][y * nPlanePitch[i] + x] != pFrame->data[i][y * pFrame->linesize[i] + x];
+	}
+	return nMismatch;
+}
+
+TEST_CASE(MemorySurface, UploadYUV420P)
+{
+	CTestRandom Random;
+	CMemorySurface Surface;
+	TEST_CHECK(Surface.InitD3D(NULL, 1921, 1081));
+	TEST_CHECK(Surface.IsInited());
+	int nWidth = 0, nHeight = 0, nPitch = 0, nSurfaceHeight = 0;
+	// ϴ֮ǰûͼ
+	TEST_CHECK(Surface.GetSurface(nWidth, nHeight, nPitch, nSurfaceHeight) == NULL);
+	TEST_EQUAL(nPitch % MEMORY_SURFACE_ALIGN, 0);
+	TEST_EQUAL(nSurfaceHeight, 1082);
+	const int nFormat[2] = { AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUVJ420P };
+	for (int i = 0; i < 2; i++)
+	{
+		AVFrame *pFrame = MakeImageFrame(nFormat[i], 1921, 1081, Random);
+		TEST_CHECK(Surface.Render(pFrame));
+		TEST_EQUAL(CompareYUV420P(Surface, pFrame), 0);
+		av_frame_free(&pFrame);
+	}
+	MemorySurfaceStat Stat;
+	Surface.GetStat(Stat);
+	TEST_EQUAL(Stat.nRendered, 2);
+	TEST_EQUAL(Stat.nUnsupported, 0);
+}
+
+// 10λ2λתΪ8λ,ʹ1
+TEST_CASE(MemorySurface, UploadYUV420P10)
+{
+	CTestRandom Random;
+	CMemorySurface Surface;
+	TEST_CHECK(Surface.InitD3D(NULL, 333, 187));
+	AVFrame *pFrame = MakeImageFrame(AV_PIX_FMT_YUV420P10, 333, 187, Random);
+	TEST_CHECK(Surface.Render(pFrame));
+	BYTE *pPlane[3];
+	int nPlanePitch[3];
+	int nWidth = 0, nHeight = 0;
+	TEST_CHECK(GetSurfacePlanes(Surface, pPlane, nPlanePitch, nWidth, nHeight) != NULL);
+	int nMaxError = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		int w = i ? (nWidth + 1) / 2 : nWidth;
+		int h = i ? (nHeight + 1) / 2 : nHeight;
+		for (int y = 0; y < h; y++)
+		{
+			const uint16_t *pSrc = (const uint16_t *)(pFrame->data[i] + y * pFrame->linesize[i]);
+			for (int x = 0; x < w; x++)
+			{
+				int nError = abs((int)pPlane[i][y * nPlanePitch[i] + x] - (pSrc[x] >> 2));
+				if (nError > nMaxError)
+					nMaxError = nError;
+			}
+		}
+	}
+	TEST_CHECK(nMaxError <= 1);
+	av_frame_free(&pFrame);
+}
+
+TEST_CASE(MemorySurface, UploadNV12)
+{
+	CTestRandom Random;
+	CMemorySurface Surface;
+	TEST_CHECK(Surface.InitD3D(NULL, 255, 129));
+	AVFrame *pFrame = MakeImageFrame(AV_PIX_FMT_NV12, 255, 129, Random);
+	TEST_CHECK(Surface.Render(pFrame));
+	BYTE *pPlane[3];
+	int nPlanePitch[3];
+	int nWidth = 0, nHeight = 0;
+	TEST_CHECK(GetSurfacePlanes(Surface, pPlane, nPlanePitch, nWidth, nHeight) != NULL);
+	int nMismatch = 0;
+	for (int y = 0; y < nHeight; y++)
+		for (int x = 0; x < nWidth; x++)
+			nMismatch += pPlane[0][y * nPlanePitch[0] + x] != pFrame->data[0][y * pFrame->linesize[0] + x];
+	for (int y = 0; y < (nHeight + 1) / 2; y++)
+	{
+		const BYTE *pUV = pFrame->data[1] + y * pFrame->linesize[1];
+		for (int x = 0; x < (nWidth + 1) / 2; x++)
+		{
+			nMismatch += pPlane[1][y * nPlanePitch[1] + x] != pUV[2 * x];
+			nMismatch += pPlane[2][y * nPlanePitch[2] + x] != pUV[2 * x + 1];
+		}
+	}
+	TEST_EQUAL(nMismatch, 0);
+	av_frame_free(&pFrame);
+}
+
+// δʼʱȾʧ,Ӳ֡Ͳֵ֧ĸʽȾ
+TEST_CASE(MemorySurface, RejectsUnsupported)
+{
+	CTestRandom Random;
+	CMemorySurface Surface;
+	AVFrame *pFrame = MakeImageFrame(AV_PIX_FMT_YUV420P, 64, 64, Random);
+	TEST_CHECK(!Surface.Render(pFrame));
+	TEST_CHECK(!Surface.InitD3D(NULL, 0, 64));
+	TEST_CHECK(Surface.InitD3D(NULL, 64, 64));
+	TEST_CHECK(!Surface.InitD3DShared(NULL, NULL, 64, 64));
+	TEST_CHECK(!Surface.Render(NULL));
+	pFrame->format = AV_PIX_FMT_DXVA2_VLD;
+	TEST_CHECK(!Surface.Render(pFrame));
+	pFrame->format = AV_PIX_FMT_BGRA;
+	TEST_CHECK(!Surface.Render(pFrame));
+	pFrame->format = AV_PIX_FMT_YUV420P;
+	TEST_CHECK(Surface.Render(pFrame));
+	MemorySurfaceStat Stat;
+	Surface.GetStat(Stat);
+	TEST_EQUAL(Stat.nRendered, 1);
+	TEST_EQUAL(Stat.nUnsupported, 2);
+	Surface.DxCleanup();
+	TEST_CHECK(!Surface.IsInited());
+	TEST_CHECK(!Surface.Render(pFrame));
+	TEST_CHECK(Surface.HandelDevLost() == false);
+	av_frame_free(&pFrame);
+}
+
+// ͼߴ仯ʱ³ߴ·
+TEST_CASE(MemorySurface, ResizeReallocates)
+{
+	CTestRandom Random;
+	CMemorySurface Surface;
+	TEST_CHECK(Surface.InitD3D(NULL, 352, 288));
+	const int nSize[3][2] = { { 352, 288 }, { 1280, 720 }, { 175, 99 } };
+	for (int i = 0; i < 3; i++)
+	{
+		AVFrame *pFrame = MakeImageFrame(AV_PIX_FMT_YUV420P, nSize[i][0], nSize[i][1], Random);
+		TEST_CHECK(Surface.Render(pFrame));
+		int nWidth = 0, nHeight = 0, nPitch = 0, nSurfaceHeight = 0;
+		TEST_CHECK(Surface.GetSurface(nWidth, nHeight, nPitch, nSurfaceHeight) != NULL);
+		TEST_EQUAL(nWidth, nSize[i][0]);
+		TEST_EQUAL(nHeight, nSize[i][1]);
+		TEST_CHECK(nPitch >= nWidth);
+		TEST_EQUAL(CompareYUV420P(Surface, pFrame), 0);
+		av_frame_free(&pFrame);
+	}
+}
+
+// ļID,ͬʱеĶԽ̻
+static std::string DumpFilePath()
+{
+	char szName[64];
+	sprintf_s(szName, sizeof(szName), "MemorySurfaceTest%u.yuv", (unsigned)GetCurrentProcessId());
+#ifdef _WIN32
+	char szPath[MAX_PATH];
+	GetTempPathA(MAX_PATH, szPath);
+	return std::string(szPath) + szName;
+#else
+	return std::string("/tmp/") + szName;
+#endif
+}
+
+// תļеÿ֡ͼߴü,ΪYVUƽ
+TEST_CASE(MemorySurface, DumpFile)
+{
+	CTestRandom Random;
+	CMemorySurface Surface;
+	std::string strPath = DumpFilePath();
+	TEST_CHECK(Surface.InitD3D(NULL, 101, 51));
+	TEST_CHECK(Surface.SetDumpFile(strPath.c_str(), 2));
+	const int nFrames = 5;
+	AVFrame *pLast = NULL;
+	for (int i = 0; i < nFrames; i++)
+	{
+		av_frame_free(&pLast);
+		pLast = MakeImageFrame(AV_PIX_FMT_YUV420P, 101, 51, Random);
+		TEST_CHECK(Surface.Render(pLast));
+	}
+	TEST_CHECK(Surface.SetDumpFile(NULL));
+	MemorySurfaceStat Stat;
+	Surface.GetStat(Stat);
+	TEST_EQUAL(Stat.nDumped, 3);
+
+	const int nFrameBytes = 101 * 51 + 51 * 26 * 2;
+	FILE *fp = fopen(strPath.c_str(), "rb");
+	TEST_CHECK(fp != NULL);
+	if (!fp)
+		return;
+	std::vector<BYTE> vecDump(nFrameBytes * Stat.nDumped + 1);
+	size_t nRead = fread(&vecDump[0], 1, vecDump.size(), fp);
+	fclose(fp);
+	remove(strPath.c_str());
+	TEST_EQUAL(nRead, nFrameBytes * Stat.nDumped);
+	// һ֡ת,ԴͼƽȽ
+	const BYTE *pDump = &vecDump[nFrameBytes * (Stat.nDumped - 1)];
+	const int nPlaneOrder[3] = { 0, 2, 1 };
+	int nMismatch = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		int nPlane = nPlaneOrder[i];
+		int w = nPlane ? 51 : 101;
+		int h = nPlane ? 26 : 51;
+		for (int y = 0; y < h; y++)
+			for (int x = 0; x < w; x++)
+				nMismatch += *pDump++ != pLast->data[nPlane][y * pLast->linesize[nPlane] + x];
+	}
+	TEST_EQUAL(nMismatch, 0);
+	av_frame_free(&pLast);
+}
+
+static bool CALLBACK InitMemorySurface(IRenderSurface *pDxSurface, AVFrame *pFirstFrame, void *pUserPtr)
+{
+	return pDxSurface->InitD3D(NULL, pFirstFrame->width, pFirstFrame->height);
+}
+
+// Ⱦ߳ڴ,̺߳ʹ޹
+TEST_CASE(MemorySurface, RenderStage)
+{
+	CTestRandom Random;
+	CMemorySurface Surface;
+	CChannelLatency Latency;
+	Latency.Reset();
+	Surface.SetLatency(&Latency);
+	CRenderStage *pStage = new CRenderStage;
+	TEST_CHECK(pStage->Start(&Surface, InitMemorySurface, NULL, 5));
+	const int nFrames = 20;
+	AVFrame *pLast = NULL;
+	for (int i = 0; i < nFrames; i++)
+	{
+		av_frame_free(&pLast);
+		pLast = MakeImageFrame(AV_PIX_FMT_YUV420P, 320, 240, Random);
+		pStage->Post(pLast);
+		// һ֡ȾͶһ֡
+		int64_t nDeadline = MonoTimeNs() + 2000 * MONO_NS_PER_MS;
+		MemorySurfaceStat Stat;
+		do
+		{
+			Sleep(1);
+			Surface.GetStat(Stat);
+		} while (Stat.nRendered < i + 1 && MonoTimeNs() < nDeadline);
+		TEST_EQUAL(Stat.nRendered, i + 1);
+	}
+	pStage->Stop();
+	RenderStageStat Stat;
+	pStage->GetStat(Stat);
+	TEST_EQUAL(Stat.nRendered, nFrames);
+	TEST_EQUAL(Stat.nRenderFailed, 0);
+	TEST_EQUAL(Latency.GetHistogram(LatencyStage_Upload).GetCount(), nFrames);
+	TEST_EQUAL(CompareYUV420P(Surface, pLast), 0);
+	av_frame_free(&pLast);
+	delete pStage;
+}
+
+// ûGPUʹϵͳĻÿ֡ȾCPUϵĿ
+BENCHMARK(MemorySurface, Upload)
+{
+	CTestRandom Random;
+	CMemorySurface Surface;
+	Surface.InitD3D(NULL, 1920, 1080);
+	const double dfFrameBytes = 1920 * 1080 * 3 / 2;
+	AVFrame *pFrame = MakeImageFrame(AV_PIX_FMT_YUV420P, 1920, 1080, Random);
+	BenchRun("MemorySurface 1080P YUV420P", dfFrameBytes, [&]() { Surface.Render(pFrame); });
+	av_frame_free(&pFrame);
+	pFrame = MakeImageFrame(AV_PIX_FMT_NV12, 1920, 1080, Random);
+	BenchRun("MemorySurface 1080P NV12", dfFrameBytes, [&]() { Surface.Render(pFrame); });
+	av_frame_free(&pFrame);
+	pFrame = MakeImageFrame(AV_PIX_FMT_YUV420P10, 1920, 1080, Random);
+	BenchRun("MemorySurface 1080P YUV420P10", dfFrameBytes * 2, [&]() { Surface.Render(pFrame); });
+	av_frame_free(&pFrame);
+}
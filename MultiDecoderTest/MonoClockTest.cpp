@@ -0,0 +1,129 @@
+// MonoClockĲԺܲ
+#include "TestFramework.h"
+#include "MonoClock.h"
+#include "Win32Port.h"
+
+#define READER_THREADS		4
+
+static volatile LONG s_bReaderStop = 0;
+static volatile LONG s_nBackward = 0;
+
+// ϶ȡʱ,Ƿ
+static unsigned __stdcall ReaderThread(void *p)
+{
+	int64_t nLast = MonoTimeNs();
+	while (!s_bReaderStop)
+	{
+		int64_t nNow = MonoTimeNs();
+		if (nNow < nLast)
+			InterlockedIncrement(&s_nBackward);
+		nLast = nNow;
+	}
+	return 0;
+}
+
+// ͹رTSC·,̶߳ʱʼղ
+TEST_CASE(MonoClock, SwitchSourceMonotonic)
+{
+	s_bReaderStop = 0;
+	s_nBackward = 0;
+	HANDLE hThreads[READER_THREADS];
+	for (int i = 0; i < READER_THREADS; i++)
+		hThreads[i] = (HANDLE)_beginthreadex(NULL, 0, ReaderThread, NULL, 0, NULL);
+	int64_t nLast = MonoTimeNs();
+	bool bTsc = false;
+	for (int i = 0; i < 6; i++)
+	{
+		bool bEnabled = MonoClockEnableTsc(true);
+		bTsc = bTsc || bEnabled;
+		int64_t nNow = MonoTimeNs();
+		TEST_CHECK(nNow >= nLast);
+		nLast = nNow;
+		Sleep(10);
+		MonoClockEnableTsc(false);
+		nNow = MonoTimeNs();
+		TEST_CHECK(nNow >= nLast);
+		nLast = nNow;
+	}
+	InterlockedExchange(&s_bReaderStop, 1);
+	WaitForMultipleObjects(READER_THREADS, hThreads, TRUE, INFINITE);
+	for (int i = 0; i < READER_THREADS; i++)
+		CloseHandle(hThreads[i]);
+	TEST_EQUAL(s_nBackward, 0);
+	if (!bTsc)
+		printf("  invariant TSC not supported, only %s was tested\n", MonoClockSource());
+}
+
+// ̨У׼,У׼ڼɺʱ䶼
+TEST_CASE(MonoClock, EnableAsync)
+{
+	int64_t nStart = MonoTimeNs();
+	MonoClockEnableTscAsync();
+	TEST_CHECK(MonoTimeNs() - nStart < 20 * MONO_NS_PER_MS);
+	int64_t nLast = nStart;
+	while (MonoTimeNs() - nStart < 200 * MONO_NS_PER_MS)
+	{
+		int64_t nNow = MonoTimeNs();
+		TEST_CHECK(nNow >= nLast);
+		nLast = nNow;
+		Sleep(1);
+	}
+	printf("  source after calibration: %s\n", MonoClockSource());
+	MonoClockEnableTsc(false);
+}
+
+// Ľʱʼʱ̼ڵõ,ۻ
+TEST_CASE(MonoClock, Pacer)
+{
+	const int64_t nInterval = 5 * MONO_NS_PER_MS;
+	CMonoPacer Pacer(nInterval);
+	Pacer.Reset();
+	int64_t nStart = MonoTimeNs();
+	for (int i = 0; i < 20; i++)
+		Pacer.Wait();
+	double dfElapsed = MonoNsToMs(MonoTimeNs() - nStart);
+	// Sleepȡ,Ŀǰ1,ϿӦæĹ
+	TEST_CHECK(dfElapsed >= 20 * 5 - 20);
+	TEST_CHECK(dfElapsed < 20 * 5 + 200);
+
+	CMonoDeadline Deadline(30 * MONO_NS_PER_MS);
+	TEST_CHECK(!Deadline.IsExpired());
+	TEST_CHECK(Deadline.RemainingMs() <= 30);
+	MonoSleepNs(40 * MONO_NS_PER_MS);
+	TEST_CHECK(Deadline.IsExpired());
+	TEST_EQUAL(Deadline.Remaining(), 0);
+}
+
+// ̵߳CPUʱֻʱ,ʱ
+TEST_CASE(MonoClock, ThreadCpuTime)
+{
+	int64_t nCpu0 = MonoThreadCpuNs();
+	TEST_CHECK(nCpu0 > 0);
+	// æȵ߳20CPU,æĹǽʱܸ
+	int64_t nDeadline = MonoTimeNs() + 5 * MONO_NS_PER_SEC;
+	volatile uint32_t nSpin = 0;
+	while (MonoThreadCpuNs() - nCpu0 < 20 * MONO_NS_PER_MS && MonoTimeNs() < nDeadline)
+		nSpin++;
+	int64_t nCpu1 = MonoThreadCpuNs();
+	TEST_CHECK(nCpu1 - nCpu0 >= 20 * MONO_NS_PER_MS);
+	MonoSleepNs(50 * MONO_NS_PER_MS);
+	TEST_CHECK(MonoThreadCpuNs() - nCpu1 < 10 * MONO_NS_PER_MS);
+}
+
+// ȡʱ䷽ʽÿεõĺʱ
+BENCHMARK(MonoClock, Read)
+{
+	volatile int64_t nSink = 0;
+	BenchRun("MonoTimeNs (counter)", 0, [&]() { nSink += MonoTimeNs(); });
+	LARGE_INTEGER nCounter;
+	BenchRun("QueryPerformanceCounter", 0, [&]() { QueryPerformanceCounter(&nCounter); nSink += nCounter.QuadPart; });
+	BenchRun("GetTickCount", 0, [&]() { nSink += GetTickCount(); });
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+	BenchRun("rdtsc", 0, [&]() { nSink += (int64_t)__rdtsc(); });
+	if (MonoClockEnableTsc(true))
+	{
+		BenchRun("MonoTimeNs (TSC)", 0, [&]() { nSink += MonoTimeNs(); });
+		MonoClockEnableTsc(false);
+	}
+#endif
+}
@@ -0,0 +1,466 @@
+// CMosaicCompositorĲ,޴ģʽ,ֻڴеƴͼ
+// ɫͼźΪͬһɫ,Դ˼鴰ƴͼеλ;봰ͬߴͼźԭͼֽһ,Դ˼ֻºϳͼĴ
+// ˮƽֵSSE2汾C汾ֽڱȽ,Ž븡˫ԲֵȽ,2
+// ܲ1920x1080ƴͼϺϳ163664D1,ֱʹC汾SSE2汾ˮƽֵ
+#include "TestFramework.h"
+#include "MosaicCompositor.h"
+#include <vector>
+#include <math.h>
+#include <stdlib.h>
+
+#define MOSAIC_BLACK_Y		16
+#define MOSAIC_BLACK_UV		128
+
+// üYUV420Pͼ,Ϊһɫ
+static AVFrame *MakeSolidFrame(int nWidth, int nHeight, BYTE nY, BYTE nU, BYTE nV)
+{
+	AVFrame *pFrame = av_frame_alloc();
+	pFrame->format = AV_PIX_FMT_YUV420P;
+	pFrame->width = nWidth;
+	pFrame->height = nHeight;
+	if (av_frame_get_buffer(pFrame, 32) < 0)
+	{
+		av_frame_free(&pFrame);
+		return NULL;
+	}
+	BYTE nValue[3] = { nY, nU, nV };
+	for (int p = 0; p < 3; p++)
+	{
+		int nPlaneHeight = p ? (nHeight + 1) / 2 : nHeight;
+		memset(pFrame->data[p], nValue[p], pFrame->linesize[p] * nPlaneHeight);
+	}
+	return pFrame;
+}
+
+static AVFrame *MakeRandomFrame(int nWidth, int nHeight, CTestRandom &Random)
+{
+	AVFrame *pFrame = MakeSolidFrame(nWidth, nHeight, 0, 0, 0);
+	for (int p = 0; p < 3 && pFrame; p++)
+	{
+		int nPlaneHeight = p ? (nHeight + 1) / 2 : nHeight;
+		Random.Fill(pFrame->data[p], pFrame->linesize[p] * nPlaneHeight);
+	}
+	return pFrame;
+}
+
+// ƴͼĳƽrtRegion(Ѱƽķֱʻ)֮ǷȫΪnInside,rtRegion֮ǷȫΪnOutside
+// ʱμ,һڵȡֵ
+struct MosaicRegion
+{
+	RECT	rect;
+	BYTE	nValue;
+};
+
+static bool CheckPlane(AVFrame *pMosaic, int nPlane, const vector<MosaicRegion> &vecRegion, BYTE nOutside)
+{
+	int nShift = nPlane ? 1 : 0;
+	int nWidth = pMosaic->width >> nShift;
+	int nHeight = pMosaic->height >> nShift;
+	for (int y = 0; y < nHeight; y++)
+	{
+		const BYTE *pRow = pMosaic->data[nPlane] + y * pMosaic->linesize[nPlane];
+		for (int x = 0; x < nWidth; x++)
+		{
+			BYTE nExpected = nOutside;
+			for (size_t i = 0; i < vecRegion.size(); i++)
+			{
+				const RECT &rt = vecRegion[i].rect;
+				if (x >= (rt.left >> nShift) && x < (rt.right >> nShift) && y >= (rt.top >> nShift) && y < (rt.bottom >> nShift))
+					nExpected = vecRegion[i].nValue;
+			}
+			if (pRow[x] != nExpected)
+			{
+				printf("  plane %d (%d,%d) = %d, expected %d\n", nPlane, x, y, pRow[x], nExpected);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// ȽƴͼдԭͼǷֽһ,Ҫ󴰸ԭͼߴͬ
+static bool RegionEquals(AVFrame *pMosaic, const RECT &rtTile, AVFrame *pSrc)
+{
+	for (int p = 0; p < 3; p++)
+	{
+		int nShift = p ? 1 : 0;
+		int nWidth = (rtTile.right - rtTile.left) >> nShift;
+		int nHeight = (rtTile.bottom - rtTile.top) >> nShift;
+		for (int y = 0; y < nHeight; y++)
+		{
+			const BYTE *pDst = pMosaic->data[p] + ((rtTile.top >> nShift) + y) * pMosaic->linesize[p] + (rtTile.left >> nShift);
+			if (memcmp(pDst, pSrc->data[p] + y * pSrc->linesize[p], nWidth) != 0)
+				return false;
+		}
+	}
+	return true;
+}
+
+static uint32_t RegionHash(AVFrame *pMosaic, const RECT &rtTile)
+{
+	uint32_t nHash = 2166136261u;
+	for (int p = 0; p < 3; p++)
+	{
+		int nShift = p ? 1 : 0;
+		for (int y = rtTile.top >> nShift; y < rtTile.bottom >> nShift; y++)
+			nHash = TestHash(pMosaic->data[p] + y * pMosaic->linesize[p] + (rtTile.left >> nShift), (rtTile.right - rtTile.left) >> nShift, nHash);
+	}
+	return nHash;
+}
+
+TEST_CASE(MosaicCompositor, TilePlacement)
+{
+	CMosaicCompositor Mosaic;
+	TEST_CHECK(Mosaic.Create(NULL, 641, 481));
+	TEST_EQUAL(Mosaic.GetMosaicFrame()->width, 640);
+	TEST_EQUAL(Mosaic.GetMosaicFrame()->height, 480);
+	HWND hTileWnd = (HWND)(intptr_t)0x1234;
+	RECT rtTile0 = { 0, 0, 320, 240 };
+	RECT rtTile1 = { 321, 241, 641, 481 };
+	TEST_EQUAL(Mosaic.AddTile(NULL, rtTile0), 0);
+	TEST_EQUAL(Mosaic.AddTile(hTileWnd, rtTile1), 1);
+	// ߲2صĴ
+	RECT rtTiny = { 11, 11, 13, 13 };
+	TEST_EQUAL(Mosaic.AddTile(NULL, rtTiny), -1);
+
+	// Ͻڡ½ڰż,üƴͼ֮
+	RECT rtAligned;
+	TEST_CHECK(Mosaic.GetTileRect(1, rtAligned));
+	TEST_EQUAL(rtAligned.left, 322);
+	TEST_EQUAL(rtAligned.top, 242);
+	TEST_EQUAL(rtAligned.right, 640);
+	TEST_EQUAL(rtAligned.bottom, 480);
+	TEST_CHECK(!Mosaic.GetTileRect(2, rtAligned));
+
+	// ûͼʱϳ
+	TEST_EQUAL(Mosaic.Compose(), 0);
+
+	AVFrame *pFrame0 = MakeSolidFrame(704, 576, 100, 60, 200);
+	AVFrame *pFrame1 = MakeSolidFrame(352, 288, 180, 90, 30);
+	TEST_CHECK(Mosaic.SubmitFrame(0, pFrame0));
+	TEST_CHECK(Mosaic.SubmitFrame(hTileWnd, pFrame1));
+	TEST_CHECK(!Mosaic.SubmitFrame(2, pFrame1));
+	TEST_CHECK(!Mosaic.SubmitFrame((HWND)(intptr_t)0x5678, pFrame1));
+	TEST_EQUAL(Mosaic.Compose(), 2);
+
+	RECT rtTile1Aligned = { 322, 242, 640, 480 };
+	BYTE nValue0[3] = { 100, 60, 200 };
+	BYTE nValue1[3] = { 180, 90, 30 };
+	for (int p = 0; p < 3; p++)
+	{
+		vector<MosaicRegion> vecRegion(2);
+		vecRegion[0].rect = rtTile0;
+		vecRegion[0].nValue = nValue0[p];
+		vecRegion[1].rect = rtTile1Aligned;
+		vecRegion[1].nValue = nValue1[p];
+		TEST_CHECK(CheckPlane(Mosaic.GetMosaicFrame(), p, vecRegion, p ? MOSAIC_BLACK_UV : MOSAIC_BLACK_Y));
+	}
+
+	// ɾƴͼָΪɫ
+	Mosaic.ClearTiles();
+	for (int p = 0; p < 3; p++)
+		TEST_CHECK(CheckPlane(Mosaic.GetMosaicFrame(), p, vector<MosaicRegion>(), p ? MOSAIC_BLACK_UV : MOSAIC_BLACK_Y));
+	av_frame_free(&pFrame0);
+	av_frame_free(&pFrame1);
+}
+
+TEST_CASE(MosaicCompositor, DirtyTiles)
+{
+	CMosaicCompositor Mosaic;
+	TEST_CHECK(Mosaic.Create(NULL, 320, 240));
+	CTestRandom Random;
+	RECT rtTile[4];
+	AVFrame *pFrames[4];
+	for (int i = 0; i < 4; i++)
+	{
+		rtTile[i].left = (i % 2) * 160;
+		rtTile[i].top = (i / 2) * 120;
+		rtTile[i].right = rtTile[i].left + 160;
+		rtTile[i].bottom = rtTile[i].top + 120;
+		TEST_EQUAL(Mosaic.AddTile(NULL, rtTile[i]), i);
+		pFrames[i] = MakeRandomFrame(160, 120, Random);
+		TEST_CHECK(Mosaic.SubmitFrame(i, pFrames[i]));
+	}
+	TEST_EQUAL(Mosaic.Compose(), 4);
+	AVFrame *pMosaic = Mosaic.GetMosaicFrame();
+	for (int i = 0; i < 4; i++)
+		TEST_CHECK(RegionEquals(pMosaic, rtTile[i], pFrames[i]));
+	TEST_EQUAL(Mosaic.Compose(), 0);
+
+	uint32_t nHash[4];
+	for (int i = 0; i < 4; i++)
+		nHash[i] = RegionHash(pMosaic, rtTile[i]);
+	// ϳ֮ǰύ,1֡
+	AVFrame *pDropped = MakeRandomFrame(160, 120, Random);
+	AVFrame *pNewFrame = MakeRandomFrame(160, 120, Random);
+	TEST_CHECK(Mosaic.SubmitFrame(2, pDropped));
+	TEST_CHECK(Mosaic.SubmitFrame(2, pNewFrame));
+	TEST_EQUAL(Mosaic.Compose(), 1);
+	TEST_CHECK(RegionEquals(pMosaic, rtTile[2], pNewFrame));
+	for (int i = 0; i < 4; i++)
+	{
+		if (i != 2)
+			TEST_EQUAL(RegionHash(pMosaic, rtTile[i]), nHash[i]);
+	}
+
+	// üͼƵԼĻ,ύ֮߿д
+	vector<BYTE> vecBuffer(160 * 120 * 3 / 2);
+	Random.Fill(&vecBuffer[0], vecBuffer.size());
+	AVFrame *pPlain = av_frame_alloc();
+	pPlain->format = AV_PIX_FMT_YUV420P;
+	pPlain->width = 160;
+	pPlain->height = 120;
+	av_image_fill_arrays(pPlain->data, pPlain->linesize, &vecBuffer[0], AV_PIX_FMT_YUV420P, 160, 120, 1);
+	TEST_CHECK(Mosaic.SubmitFrame(3, pPlain));
+	AVFrame *pExpected = av_frame_clone(pFrames[0]);
+	av_frame_copy(pExpected, pPlain);
+	memset(&vecBuffer[0], 0, vecBuffer.size());
+	TEST_EQUAL(Mosaic.Compose(), 1);
+	TEST_CHECK(RegionEquals(pMosaic, rtTile[3], pExpected));
+
+	// ֵ֧ĸʽ
+	AVFrame *pNV12 = av_frame_alloc();
+	pNV12->format = AV_PIX_FMT_NV12;
+	TEST_CHECK(!Mosaic.SubmitFrame(0, pNV12));
+
+	MosaicStat Stat;
+	Mosaic.GetStat(Stat);
+	TEST_EQUAL((int)Stat.nSubmitFrames, 7);
+	TEST_EQUAL((int)Stat.nDroppedFrames, 1);
+	TEST_EQUAL((int)Stat.nComposedFrames, 3);
+	TEST_EQUAL((int)Stat.nScaledTiles, 6);
+
+	av_frame_free(&pNV12);
+	av_frame_free(&pExpected);
+	av_frame_free(&pPlain);
+	av_frame_free(&pDropped);
+	av_frame_free(&pNewFrame);
+	for (int i = 0; i < 4; i++)
+		av_frame_free(&pFrames[i]);
+}
+
+// ˫ԲֵĲοʵ,ȡ,ԵʱȡԵ
+static double SampleBilinear(const BYTE *pSrc, int nPitch, int nSrcWidth, int nSrcHeight, double dfX, double dfY)
+{
+	dfX = min(max(dfX, 0.0), (double)(nSrcWidth - 1));
+	dfY = min(max(dfY, 0.0), (double)(nSrcHeight - 1));
+	int x0 = (int)dfX;
+	int y0 = (int)dfY;
+	int x1 = min(x0 + 1, nSrcWidth - 1);
+	int y1 = min(y0 + 1, nSrcHeight - 1);
+	double fx = dfX - x0;
+	double fy = dfY - y0;
+	double dfTop = pSrc[y0 * nPitch + x0] * (1 - fx) + pSrc[y0 * nPitch + x1] * fx;
+	double dfBottom = pSrc[y1 * nPitch + x0] * (1 - fx) + pSrc[y1 * nPitch + x1] * fx;
+	return dfTop * (1 - fy) + dfBottom * fy;
+}
+
+TEST_CASE(MosaicCompositor, ScaleMatchesBilinear)
+{
+	// СŴͿ߱ȱ仯
+	const int nSizes[][4] =
+	{
+		{ 704, 576, 300, 200 },
+		{ 352, 288, 640, 360 },
+		{ 1920, 1080, 238, 134 },
+		{ 177, 99, 320, 240 },
+	};
+	CTestRandom Random;
+	for (size_t n = 0; n < sizeof(nSizes) / sizeof(nSizes[0]); n++)
+	{
+		int nSrcWidth = nSizes[n][0], nSrcHeight = nSizes[n][1];
+		int nDstWidth = nSizes[n][2], nDstHeight = nSizes[n][3];
+		CMosaicCompositor Mosaic;
+		TEST_CHECK(Mosaic.Create(NULL, nDstWidth, nDstHeight));
+		RECT rtTile = { 0, 0, nDstWidth, nDstHeight };
+		TEST_EQUAL(Mosaic.AddTile(NULL, rtTile), 0);
+		// ƽͼܱȽϲֵľ,ĵƵ
+		AVFrame *pSrc = MakeSolidFrame(nSrcWidth, nSrcHeight, 0, 0, 0);
+		for (int p = 0; p < 3; p++)
+		{
+			int nWidth = p ? (nSrcWidth + 1) / 2 : nSrcWidth;
+			int nHeight = p ? (nSrcHeight + 1) / 2 : nSrcHeight;
+			double dfFx = Random.Range(1, 8) * 3.14159 / nWidth;
+			double dfFy = Random.Range(1, 8) * 3.14159 / nHeight;
+			for (int y = 0; y < nHeight; y++)
+				for (int x = 0; x < nWidth; x++)
+					pSrc->data[p][y * pSrc->linesize[p] + x] = (BYTE)(128 + 100 * sin(x * dfFx) * cos(y * dfFy) + Random.Range(-4, 4));
+		}
+		TEST_CHECK(Mosaic.SubmitFrame(0, pSrc));
+		TEST_EQUAL(Mosaic.Compose(), 1);
+		AVFrame *pMosaic = Mosaic.GetMosaicFrame();
+		int nMaxError = 0;
+		for (int p = 0; p < 3; p++)
+		{
+			int nWidth = p ? (nSrcWidth + 1) / 2 : nSrcWidth;
+			int nHeight = p ? (nSrcHeight + 1) / 2 : nSrcHeight;
+			int nOutWidth = p ? nDstWidth / 2 : nDstWidth;
+			int nOutHeight = p ? nDstHeight / 2 : nDstHeight;
+			for (int y = 0; y < nOutHeight; y++)
+			{
+				for (int x = 0; x < nOutWidth; x++)
+				{
+					double dfX = (x + 0.5) * nWidth / nOutWidth - 0.5;
+					double dfY = (y + 0.5) * nHeight / nOutHeight - 0.5;
+					int nRef = (int)floor(SampleBilinear(pSrc->data[p], pSrc->linesize[p], nWidth, nHeight, dfX, dfY) + 0.5);
+					int nError = abs(pMosaic->data[p][y * pMosaic->linesize[p] + x] - nRef);
+					nMaxError = max(nMaxError, nError);
+				}
+			}
+		}
+		if (nMaxError > 2)
+			printf("  %dx%d -> %dx%d max error %d\n", nSrcWidth, nSrcHeight, nDstWidth, nDstHeight, nMaxError);
+		TEST_CHECK(nMaxError <= 2);
+		av_frame_free(&pSrc);
+	}
+}
+
+// SSE2汾C汾ֽһ,Դͼһǡ÷nSrcWidthֽ,ɶԶȡԽ
+TEST_CASE(MosaicCompositor, ScaleRowMatchesC)
+{
+	CTestRandom Random;
+	for (int nCase = 0; nCase < 500; nCase++)
+	{
+		int nSrcWidth = Random.Range(1, 2000);
+		int nDstWidth = Random.Range(1, 2000);
+		MosaicScaleTable Table;
+		BuildScaleTable(Table, nSrcWidth, nDstWidth);
+		bool bInRange = true;
+		for (int x = 0; x < nDstWidth; x++)
+		{
+			int nWeight0 = Table.vecWeight[x] & 0xFFFF;
+			int nWeight1 = Table.vecWeight[x] >> 16;
+			if (Table.vecIndex[x] < 0 || nWeight0 + nWeight1 != 128 ||
+				(nWeight1 && Table.vecIndex[x] + 1 >= nSrcWidth) ||
+				(nSrcWidth > 1 && Table.vecIndex[x] + 1 >= nSrcWidth))
+				bInRange = false;
+		}
+		TEST_CHECK(bInRange);
+		// ԴΪ1ʱŹʹö1ֽڵл,ͬ1ֽ
+		vector<BYTE> vecSrc(nSrcWidth + (nSrcWidth < 2 ? 1 : 0));
+		Random.Fill(&vecSrc[0], vecSrc.size());
+		vector<BYTE> vecRef(nDstWidth), vecOut(nDstWidth);
+		ScaleRow_C(&vecRef[0], &vecSrc[0], &Table.vecIndex[0], &Table.vecWeight[0], nDstWidth);
+		ScaleRow(&vecOut[0], &vecSrc[0], &Table.vecIndex[0], &Table.vecWeight[0], nDstWidth);
+		TEST_CHECK(vecRef == vecOut);
+#ifdef PIXELCOPY_SSE2
+		if (CpuSupportsSSE2())
+		{
+			ScaleRow_SSE2(&vecOut[0], &vecSrc[0], &Table.vecIndex[0], &Table.vecWeight[0], nDstWidth);
+			TEST_CHECK(vecRef == vecOut);
+		}
+#endif
+	}
+}
+
+struct WorkerCounter
+{
+	vector<LONG>	vecCount;
+};
+
+static void CountWork(int nIndex, void *pParam)
+{
+	WorkerCounter *pCounter = (WorkerCounter *)pParam;
+	InterlockedIncrement(&pCounter->vecCount[nIndex]);
+}
+
+// ÿRunÿǡôһ,һRunѵĹ̳߳ٵʱظ
+TEST_CASE(MosaicCompositor, WorkersRunEachIndexOnce)
+{
+	for (int nThreads = 0; nThreads <= 3; nThreads += 3)
+	{
+		CMosaicWorkers Workers;
+		TEST_CHECK(Workers.Start(nThreads));
+		TEST_EQUAL(Workers.GetThreads(), nThreads);
+		CTestRandom Random;
+		bool bExact = true;
+		for (int nRun = 0; nRun < 2000; nRun++)
+		{
+			WorkerCounter Counter;
+			Counter.vecCount.resize(Random.Range(1, 64));
+			Workers.Run((int)Counter.vecCount.size(), CountWork, &Counter);
+			for (size_t i = 0; i < Counter.vecCount.size(); i++)
+				bExact = bExact && Counter.vecCount[i] == 1;
+		}
+		TEST_CHECK(bExact);
+		Workers.Stop();
+	}
+}
+
+static void BenchComposeGrid(int nGrid, const char *szScale)
+{
+	const int nMosaicWidth = 1920, nMosaicHeight = 1080;
+	CMosaicCompositor Mosaic;
+	Mosaic.Create(NULL, nMosaicWidth, nMosaicHeight);
+	CTestRandom Random;
+	vector<AVFrame *> vecFrame;
+	for (int i = 0; i < nGrid * nGrid; i++)
+	{
+		RECT rtTile;
+		rtTile.left = (i % nGrid) * nMosaicWidth / nGrid;
+		rtTile.top = (i / nGrid) * nMosaicHeight / nGrid;
+		rtTile.right = (i % nGrid + 1) * nMosaicWidth / nGrid;
+		rtTile.bottom = (i / nGrid + 1) * nMosaicHeight / nGrid;
+		Mosaic.AddTile(NULL, rtTile);
+		vecFrame.push_back(MakeRandomFrame(704, 576, Random));
+	}
+	char szLabel[64];
+	_snprintf(szLabel, sizeof(szLabel), "compose %d D1 tiles -> 1080p (%s)", nGrid * nGrid, szScale);
+	// ÿκϳǰдյͼ,
+	BenchRun(szLabel, nMosaicWidth * nMosaicHeight * 3 / 2, [&]()
+	{
+		for (int i = 0; i < nGrid * nGrid; i++)
+			Mosaic.SubmitFrame(i, vecFrame[i]);
+		Mosaic.Compose();
+	});
+	for (size_t i = 0; i < vecFrame.size(); i++)
+		av_frame_free(&vecFrame[i]);
+}
+
+BENCHMARK(MosaicCompositor, ComposeThroughput)
+{
+	SYSTEM_INFO SysInfo;
+	GetSystemInfo(&SysInfo);
+	printf("  %-44s %12d\n", "worker threads", min((int)SysInfo.dwNumberOfProcessors - 1, 7));
+	ScaleRowProc pScaleRow = ScaleRow;
+	const int nGrids[] = { 4, 6, 8 };
+	for (int i = 0; i < 3; i++)
+	{
+		ScaleRow = ScaleRow_C;
+		BenchComposeGrid(nGrids[i], "C");
+#ifdef PIXELCOPY_SSE2
+		if (CpuSupportsSSE2())
+		{
+			ScaleRow = ScaleRow_SSE2;
+			BenchComposeGrid(nGrids[i], "SSE2");
+		}
+#endif
+	}
+	ScaleRow = pScaleRow;
+}
+
+// Ƚˮƽֵ,D1һС8x8ĴȺͷŴ2x2Ĵ
+BENCHMARK(MosaicCompositor, ScaleRowSpeed)
+{
+	CTestRandom Random;
+	vector<BYTE> vecSrc(704);
+	Random.Fill(&vecSrc[0], vecSrc.size());
+	const int nDstWidths[] = { 240, 960 };
+	for (int i = 0; i < 2; i++)
+	{
+		int nDstWidth = nDstWidths[i];
+		MosaicScaleTable Table;
+		BuildScaleTable(Table, 704, nDstWidth);
+		vector<BYTE> vecDst(nDstWidth);
+		char szLabel[64];
+		_snprintf(szLabel, sizeof(szLabel), "scale row 704 -> %d (C)", nDstWidth);
+		BenchRun(szLabel, nDstWidth, [&]() { ScaleRow_C(&vecDst[0], &vecSrc[0], &Table.vecIndex[0], &Table.vecWeight[0], nDstWidth); });
+#ifdef PIXELCOPY_SSE2
+		if (CpuSupportsSSE2())
+		{
+			_snprintf(szLabel, sizeof(szLabel), "scale row 704 -> %d (SSE2)", nDstWidth);
+			BenchRun(szLabel, nDstWidth, [&]() { ScaleRow_SSE2(&vecDst[0], &vecSrc[0], &Table.vecIndex[0], &Table.vecWeight[0], nDstWidth); });
+		}
+#endif
+	}
+}
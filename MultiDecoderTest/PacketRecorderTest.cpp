@@ -0,0 +1,391 @@
+// CPacketRecorderCRecordCursorĲ
+// õķװÿһ֡ı־ʱԭдļ,غ¼ӹؼ֡ʼʱ
+// һؼָ֡,Լͨͬʱӹõ¼ʱÿļݶ֡һ
+#include "TestFramework.h"
+#include "PacketRecorder.h"
+#include <list>
+#include <memory>
+#include <string>
+
+// ¼ļÿһ֡ͷ
+struct RawRecordHeader
+{
+	int32_t		nSize;
+	int32_t		bKeyFrame;
+	int64_t		nPts;
+	int64_t		nDts;
+	int64_t		nDuration;
+};
+
+// RawRecordHeaderݵĸʽдļ;hEventGateʱ,ÿдǰȴ¼
+class CRawRecordMuxer : public IRecordMuxer
+{
+public:
+	explicit CRawRecordMuxer(HANDLE hEventGate = NULL)
+	{
+		m_hEventGate = hEventGate;
+		m_fp = NULL;
+	}
+	virtual ~CRawRecordMuxer()
+	{
+		Close();
+	}
+	virtual bool Open(const char *szPath)
+	{
+		m_fp = fopen(szPath, "wb");
+		return m_fp != NULL;
+	}
+	virtual bool WritePacket(const uint8_t *pData, int nSize, bool bKeyFrame, int64_t nPts, int64_t nDts, int64_t nDuration)
+	{
+		if (m_hEventGate)
+			WaitForSingleObject(m_hEventGate, INFINITE);
+		RawRecordHeader Header = { nSize, bKeyFrame, nPts, nDts, nDuration };
+		return fwrite(&Header, sizeof(Header), 1, m_fp) == 1 && fwrite(pData, 1, nSize, m_fp) == (size_t)nSize;
+	}
+	virtual void Close()
+	{
+		if (m_fp)
+		{
+			fclose(m_fp);
+			m_fp = NULL;
+		}
+	}
+private:
+	HANDLE		m_hEventGate;
+	FILE		*m_fp;
+};
+
+struct RawRecordPacket
+{
+	RawRecordHeader		Header;
+	std::vector<uint8_t> vecData;
+};
+
+static bool ReadRawRecord(const std::string &strPath, std::vector<RawRecordPacket> &vecPacket)
+{
+	vecPacket.clear();
+	FILE *fp = fopen(strPath.c_str(), "rb");
+	if (!fp)
+		return false;
+	bool bSucceed = true;
+	RawRecordPacket Packet;
+	while (fread(&Packet.Header, sizeof(RawRecordHeader), 1, fp) == 1)
+	{
+		Packet.vecData.resize(Packet.Header.nSize);
+		if (Packet.Header.nSize <= 0 || fread(&Packet.vecData[0], 1, Packet.Header.nSize, fp) != (size_t)Packet.Header.nSize)
+		{
+			bSucceed = false;
+			break;
+		}
+		vecPacket.push_back(Packet);
+	}
+	fclose(fp);
+	return bSucceed;
+}
+
+static std::string RecordFilePath(const char *szName, int nIndex)
+{
+	char szFile[128];
+	sprintf_s(szFile, sizeof(szFile), "%s%u_%d.rec", szName, (unsigned)GetCurrentProcessId(), nIndex);
+#ifdef _WIN32
+	char szPath[MAX_PATH];
+	GetTempPathA(MAX_PATH, szPath);
+	return std::string(szPath) + szFile;
+#else
+	return std::string("/tmp/") + szFile;
+#endif
+}
+
+// еһ֡,ǰ4ֽΪ֡,ఴ
+struct TestInputFrame
+{
+	TestInputFrame(int nIndex, int nSize, bool bKey, int64_t nTimestamp)
+		: vecData(nSize)
+	{
+		for (int i = 0; i < nSize; i++)
+			vecData[i] = (uint8_t)(nIndex * 31 + i);
+		memcpy(&vecData[0], &nIndex, sizeof(int));
+		pData = &vecData[0];
+		nLength = nSize;
+		bKeyFrame = bKey;
+		nPts = nTimestamp;
+		nDts = nTimestamp;
+	}
+	std::vector<uint8_t> vecData;
+	uint8_t		*pData;
+	UINT		nLength;
+	bool		bKeyFrame;
+	int64_t		nPts;
+	int64_t		nDts;
+};
+typedef std::shared_ptr<TestInputFrame> TestFramePtr;
+typedef std::list<TestFramePtr> TestInputQueue;
+
+static int PacketIndex(const RawRecordPacket &Packet)
+{
+	int nIndex = -1;
+	if (Packet.vecData.size() >= sizeof(int))
+		memcpy(&nIndex, &Packet.vecData[0], sizeof(int));
+	return nIndex;
+}
+
+static bool PacketMatches(const RawRecordPacket &Packet, const TestInputFrame &Frame)
+{
+	return Packet.vecData == Frame.vecData && (Packet.Header.bKeyFrame != 0) == Frame.bKeyFrame;
+}
+
+// nFrames֡,ÿnGop֡һؼ֡,֡ĴС[nMinSize, nMaxSize]֮
+static void MakeInputQueue(TestInputQueue &Queue, int nFrames, int nGop, int nMinSize, int nMaxSize, uint32_t nSeed)
+{
+	CTestRandom Random(nSeed);
+	Queue.clear();
+	for (int i = 0; i < nFrames; i++)
+		Queue.push_back(std::make_shared<TestInputFrame>(i, Random.Range(nMinSize, nMaxSize), i % nGop == 0, (int64_t)i * 40));
+}
+
+TEST_CASE(PacketRecorder, StartsAtKeyFrame)
+{
+	std::string strPath = RecordFilePath("RecordKey", 0);
+	CPacketRecorder Recorder;
+	TEST_CHECK(Recorder.Create(strPath.c_str(), new CRawRecordMuxer(), 40, 64 * 1024, 64));
+	TestInputQueue Queue;
+	MakeInputQueue(Queue, 12, 8, 32, 256, 1);
+	// 0֡ǹؼ֡,ӵ1֡ʼд,8֡ǵһдĹؼ֡
+	for (TestInputQueue::iterator it = ++Queue.begin(); it != Queue.end(); ++it)
+		Recorder.Write((*it)->pData, (*it)->nLength, (*it)->bKeyFrame, (*it)->nPts, (*it)->nDts);
+	Recorder.Close();
+	RecorderStat Stat;
+	Recorder.GetStat(Stat);
+	TEST_EQUAL(Stat.nSkipped, 7);
+	TEST_EQUAL(Stat.nWritten, 4);
+	TEST_EQUAL(Stat.nDropped, 0);
+	std::vector<RawRecordPacket> vecPacket;
+	TEST_CHECK(ReadRawRecord(strPath, vecPacket));
+	remove(strPath.c_str());
+	TEST_EQUAL(vecPacket.size(), 4);
+	if (vecPacket.size() != 4)
+		return;
+	TEST_CHECK(vecPacket[0].Header.bKeyFrame != 0);
+	TEST_EQUAL(PacketIndex(vecPacket[0]), 8);
+	// ʱ0ʼ
+	for (int i = 0; i < 4; i++)
+	{
+		TEST_EQUAL(vecPacket[i].Header.nDts, i * 40);
+		TEST_EQUAL(vecPacket[i].Header.nDuration, 40);
+	}
+}
+
+// ʱʱһ֡,ȱʧʱ֡ʱ
+TEST_CASE(PacketRecorder, RebasesTimestamps)
+{
+	std::string strPath = RecordFilePath("RecordRebase", 0);
+	CPacketRecorder Recorder;
+	TEST_CHECK(Recorder.Create(strPath.c_str(), new CRawRecordMuxer(), 40, 64 * 1024, 64));
+	uint8_t Data[64] = { 0 };
+	for (int nLoop = 0; nLoop < 2; nLoop++)
+		for (int i = 0; i < 5; i++)
+			Recorder.Write(Data, sizeof(Data), i == 0, 1000 + i * 40, 1000 + i * 40);
+	Recorder.Write(Data, sizeof(Data), false, AV_NOPTS_VALUE, AV_NOPTS_VALUE);
+	Recorder.Close();
+	std::vector<RawRecordPacket> vecPacket;
+	TEST_CHECK(ReadRawRecord(strPath, vecPacket));
+	remove(strPath.c_str());
+	TEST_EQUAL(vecPacket.size(), 11);
+	for (size_t i = 0; i < vecPacket.size(); i++)
+	{
+		TEST_EQUAL(vecPacket[i].Header.nDts, (int64_t)i * 40);
+		TEST_EQUAL(vecPacket[i].Header.nPts, vecPacket[i].Header.nDts);
+	}
+}
+
+static void WaitRecordWritten(CPacketRecorder &Recorder, LONG nWritten)
+{
+	for (;;)
+	{
+		RecorderStat Stat;
+		Recorder.GetStat(Stat);
+		if (Stat.nWritten >= nWritten)
+			break;
+		Sleep(1);
+	}
+}
+
+// I/O̸߳ʱ֡,˺ķǹؼ֡Ҳ,ֱһؼ֡
+TEST_CASE(PacketRecorder, DropsToNextKeyFrame)
+{
+	std::string strPath = RecordFilePath("RecordDrop", 0);
+	HANDLE hEventGate = CreateEvent(NULL, TRUE, FALSE, NULL);
+	CPacketRecorder Recorder;
+	const int nMaxPackets = 4;
+	TEST_CHECK(Recorder.Create(strPath.c_str(), new CRawRecordMuxer(hEventGate), 40, 64 * 1024, nMaxPackets));
+	TestInputQueue Queue;
+	MakeInputQueue(Queue, 30, 10, 32, 256, 2);
+	TestInputQueue::iterator it = Queue.begin();
+	// I/O߳ڵһ֡,дnMaxPackets֡4֡,5~9֡ȴؼ֡
+	for (int i = 0; i < 10; i++, ++it)
+		Recorder.Write((*it)->pData, (*it)->nLength, (*it)->bKeyFrame, (*it)->nPts, (*it)->nDts);
+	SetEvent(hEventGate);
+	LONG nAccepted = nMaxPackets;
+	for (; it != Queue.end(); ++it)
+	{// I/O߳дѽܵ֡д,˺
+		WaitRecordWritten(Recorder, nAccepted);
+		if (Recorder.Write((*it)->pData, (*it)->nLength, (*it)->bKeyFrame, (*it)->nPts, (*it)->nDts))
+			nAccepted++;
+	}
+	Recorder.Close();
+	RecorderStat Stat;
+	Recorder.GetStat(Stat);
+	TEST_EQUAL(Stat.nDropped, 1);
+	TEST_EQUAL(Stat.nSkipped, 5);
+	std::vector<RawRecordPacket> vecPacket;
+	TEST_CHECK(ReadRawRecord(strPath, vecPacket));
+	remove(strPath.c_str());
+	CloseHandle(hEventGate);
+	// д0~3֡,4֡,5~9֡ȴؼ֡,ӵ10֡ʼд֡
+	TEST_EQUAL(vecPacket.size(), 4 + 20);
+	int nExpected = 0;
+	for (size_t i = 0; i < vecPacket.size(); i++, nExpected++)
+	{
+		if (nExpected == 4)
+			nExpected = 10;
+		TEST_EQUAL(PacketIndex(vecPacket[i]), nExpected);
+	}
+}
+
+// µ¼һؼ֡ʼ,дؼ֮֡Ѷȡ֡
+TEST_CASE(RecordCursor, PrerollsFromLastKeyFrame)
+{
+	TestInputQueue Queue;
+	MakeInputQueue(Queue, 20, 5, 32, 256, 3);
+	CRecordCursor<TestInputQueue::iterator> Cursor(Queue.end());
+	std::string strPath = RecordFilePath("RecordPreroll", 0);
+	CPacketRecorder *pRecorder = NULL;
+	int nIndex = 0;
+	for (TestInputQueue::iterator it = Queue.begin(); it != Queue.end(); ++it, nIndex++)
+	{
+		if (nIndex == 8)
+		{// 8֡ʼ¼,5֡ΪĹؼ֡
+			pRecorder = new CPacketRecorder();
+			TEST_CHECK(pRecorder->Create(strPath.c_str(), new CRawRecordMuxer(), 40, 64 * 1024, 64));
+		}
+		else if (nIndex == 16)
+		{
+			delete pRecorder;
+			pRecorder = NULL;
+		}
+		Cursor.Feed(it, pRecorder);
+	}
+	std::vector<RawRecordPacket> vecPacket;
+	TEST_CHECK(ReadRawRecord(strPath, vecPacket));
+	remove(strPath.c_str());
+	TEST_EQUAL(vecPacket.size(), 16 - 5);
+	for (size_t i = 0; i < vecPacket.size(); i++)
+		TEST_EQUAL(PacketIndex(vecPacket[i]), 5 + (int)i);
+	// ѭ,һ¼ܻصһֵĹؼ֡
+	Cursor.Reset();
+	pRecorder = new CPacketRecorder();
+	TEST_CHECK(pRecorder->Create(strPath.c_str(), new CRawRecordMuxer(), 40, 64 * 1024, 64));
+	TestInputQueue::iterator it = Queue.begin();
+	++it;
+	Cursor.Feed(it, pRecorder);
+	delete pRecorder;
+	TEST_CHECK(ReadRawRecord(strPath, vecPacket));
+	remove(strPath.c_str());
+	TEST_EQUAL(vecPacket.size(), 0);
+}
+
+struct RecordChannelContext
+{
+	TestInputQueue		*pQueue;
+	int					nChannel;
+	int					nStartFrame;	// ڵڼ֡ʼ¼,Ϊѭ
+	int					nRecordFrames;	// ¼֡
+	bool				bCreated;
+};
+
+// ģһ߳ѭȡõ,ָλÿʼͽ¼
+static unsigned __stdcall RecordChannelThread(void *p)
+{
+	RecordChannelContext *pContext = (RecordChannelContext *)p;
+	TestInputQueue &Queue = *pContext->pQueue;
+	CRecordCursor<TestInputQueue::iterator> Cursor(Queue.end());
+	CPacketRecorder *pRecorder = NULL;
+	int nRead = 0;
+	int nStopFrame = pContext->nStartFrame + pContext->nRecordFrames;
+	TestInputQueue::iterator it = Queue.begin();
+	while (nRead < nStopFrame)
+	{
+		if (it == Queue.end())
+		{
+			it = Queue.begin();
+			Cursor.Reset();
+		}
+		if (nRead == pContext->nStartFrame)
+		{
+			pRecorder = new CPacketRecorder();
+			pRecorder->SetChannel(pContext->nChannel);
+			pContext->bCreated = pRecorder->Create(RecordFilePath("RecordChannel", pContext->nChannel).c_str(), new CRawRecordMuxer(), 40, 1024 * 1024, 1024);
+		}
+		Cursor.Feed(it, pRecorder);
+		++it;
+		nRead++;
+		if ((nRead & 7) == 0)
+			SwitchToThread();
+	}
+	delete pRecorder;
+	return 0;
+}
+
+// ͨͬʱӹõ¼,ֹλøͬ,¼еѭ,ÿļ֡֡һ
+TEST_CASE(PacketRecorder, ManyChannelsConcurrent)
+{
+	const int nChannels = 32;
+	const int nFrames = 100;
+	const int nGop = 25;
+	TestInputQueue Queue;
+	MakeInputQueue(Queue, nFrames, nGop, 64, 4096, 4);
+	std::vector<TestFramePtr> vecFrame(Queue.begin(), Queue.end());
+	CTestRandom Random(5);
+	RecordChannelContext Context[nChannels];
+	HANDLE hThreads[nChannels];
+	for (int i = 0; i < nChannels; i++)
+	{
+		RecordChannelContext Init = { &Queue, i, Random.Range(1, nFrames * 2 - 1), Random.Range(1, nFrames), false };
+		Context[i] = Init;
+		hThreads[i] = (HANDLE)_beginthreadex(NULL, 0, RecordChannelThread, &Context[i], 0, NULL);
+	}
+	WaitForMultipleObjects(nChannels, hThreads, TRUE, INFINITE);
+	for (int i = 0; i < nChannels; i++)
+	{
+		CloseHandle(hThreads[i]);
+		TEST_CHECK(Context[i].bCreated);
+		std::string strPath = RecordFilePath("RecordChannel", i);
+		std::vector<RawRecordPacket> vecPacket;
+		TEST_CHECK(ReadRawRecord(strPath, vecPacket));
+		remove(strPath.c_str());
+		// Ԥڵ֡:ѭпʼλ֮ǰĹؼ֡,ֱλ,ѭʱһֵĵһ֡
+		int nStart = Context[i].nStartFrame;
+		int nStop = nStart + Context[i].nRecordFrames;
+		int nFirst = nStart - nStart % nGop;
+		TEST_EQUAL((int)vecPacket.size(), nStop - nFirst);
+		if ((int)vecPacket.size() != nStop - nFirst)
+			continue;
+		int nMismatch = 0;
+		int nNonMonotonic = 0;
+		for (int n = nFirst; n < nStop; n++)
+		{
+			const RawRecordPacket &Packet = vecPacket[n - nFirst];
+			nMismatch += !PacketMatches(Packet, *vecFrame[n % nFrames]);
+			if (n > nFirst && Packet.Header.nDts <= vecPacket[n - nFirst - 1].Header.nDts)
+				nNonMonotonic++;
+		}
+		TEST_EQUAL(nMismatch, 0);
+		TEST_EQUAL(nNonMonotonic, 0);
+		TEST_CHECK(vecPacket[0].Header.bKeyFrame != 0);
+		TEST_EQUAL(vecPacket[0].Header.nDts, 0);
+	}
+	// ¼Ļͷ
+	MemoryTagStat Stat;
+	TEST_CHECK(g_MemoryAccount.GetStat(MemTag_Record, MEMORY_ALL_CHANNELS, Stat));
+	TEST_EQUAL(Stat.nLiveBytes, 0);
+}
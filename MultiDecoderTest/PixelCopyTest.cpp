@@ -0,0 +1,594 @@
+// PixelCopyHighBitdepthĽԺܲ
+// ÿں˵밴ĲοֽڱȽ,Ŀ껺Ԥڱֵ,
+// ͬβͼһȽ,ԼԽд
+// Գߴ縲ߡͬڿȵпδĵַԼSIMD鳤ºϵĿ
+#include "TestFramework.h"
+#include "PixelCopy.h"
+#include "HighBitdepth.h"
+#ifdef TEST_HAVE_SWSCALE
+#include <stdlib.h>
+#include <math.h>
+extern "C" {
+#include "libswscale/swscale.h"
+}
+#endif
+
+#define CANARY			0xCD		// Ŀ껺ڱֵ
+#define RANDOM_CASES	200			// ÿں˵ߴ
+
+// ƫƵĻ,ƫƺڱɲӾ,֤ο뱻⻺һ
+struct TestBuffer
+{
+	std::vector<BYTE>	vecData;
+	size_t				nOffset;
+	TestBuffer(size_t nSize, size_t nAlignOffset, int nFill)
+		: vecData(nSize + nAlignOffset + 64, (BYTE)nFill)
+		, nOffset(nAlignOffset)
+	{
+	}
+	BYTE *Data()
+	{
+		return &vecData[nOffset];
+	}
+	bool operator == (const TestBuffer &Other) const
+	{
+		return vecData == Other.vecData;
+	}
+};
+
+// οʵʹõBayer,HighBitdepth.cppеĶ໥
+static const int s_nRefBayer[4][4] =
+{
+	{ 0, 8, 2, 10 },
+	{ 12, 4, 14, 6 },
+	{ 3, 11, 1, 9 },
+	{ 15, 7, 13, 5 }
+};
+
+static BYTE RefDither(int nSample, int nRow, int nCol, int nShift)
+{
+	int nValue = (nSample + ((s_nRefBayer[nRow & 3][nCol & 3] << nShift) >> 4)) >> nShift;
+	return (BYTE)(nValue > 255 ? 255 : nValue);
+}
+
+static int RefSample16(const BYTE *pRow, int nIndex)
+{
+	return pRow[2 * nIndex] | (pRow[2 * nIndex + 1] << 8);
+}
+
+// ɵĲԳߴ
+struct TestSize
+{
+	int		nWidth;
+	int		nHeight;
+	int		nSrcPad;		// ԴпЧݵֽ
+	int		nDstPad;		// ĿпЧݵֽ
+	int		nSrcAlign;		// Դַ16ֽڶƫ
+	int		nDstAlign;
+	int		nSurfacePad;	// ߶ȳͼ߶ȵ,ȡż
+};
+
+static TestSize RandomSize(CTestRandom &Rand)
+{
+	TestSize Size;
+	Size.nWidth = Rand.Range(1, 140);
+	Size.nHeight = Rand.Range(1, 11);
+	Size.nSrcPad = Rand.Range(0, 3) ? Rand.Range(0, 40) : 0;
+	Size.nDstPad = Rand.Range(0, 3) ? Rand.Range(0, 40) : 0;
+	Size.nSrcAlign = Rand.Range(0, 15);
+	Size.nDstAlign = Rand.Range(0, 15);
+	Size.nSurfacePad = Rand.Range(0, 3) * 2;
+	return Size;
+}
+
+static const TestSize s_GoldenSize = { 67, 35, 13, 29, 3, 5, 4 };
+
+// nBytesPerPixelֽڵƽΪһƽ渴,ӦRGBȵƽʽĸ·
+static uint32_t CheckCopyPlane(const TestSize &Size, int nBytesPerPixel, CTestRandom &Rand)
+{
+	int nRowBytes = Size.nWidth * nBytesPerPixel;
+	int nSrcPitch = nRowBytes + Size.nSrcPad;
+	int nDstPitch = nRowBytes + Size.nDstPad;
+	TestBuffer Src(nSrcPitch * Size.nHeight, Size.nSrcAlign, 0);
+	Rand.Fill(Src.Data(), nSrcPitch * Size.nHeight);
+	TestBuffer Dst(nDstPitch * Size.nHeight, Size.nDstAlign, CANARY);
+	TestBuffer Ref(Dst);
+	for (int y = 0; y < Size.nHeight; y++)
+		for (int x = 0; x < nRowBytes; x++)
+			Ref.Data()[y * nDstPitch + x] = Src.Data()[y * nSrcPitch + x];
+	CopyPlane(Dst.Data(), nDstPitch, Src.Data(), nSrcPitch, nRowBytes, Size.nHeight);
+	TEST_CHECK(Dst == Ref);
+	return TestHash(Ref.Data(), nDstPitch * Size.nHeight);
+}
+
+TEST_CASE(PixelCopy, CopyPlane)
+{
+	CTestRandom Rand(1);
+	for (int i = 0; i < RANDOM_CASES; i++)
+	{
+		TestSize Size = RandomSize(Rand);
+		CheckCopyPlane(Size, 1, Rand);
+		CheckCopyPlane(Size, 3, Rand);
+		CheckCopyPlane(Size, 4, Rand);
+	}
+}
+
+static uint32_t CheckSplitUV(SplitUVProc pSplitUV, const TestSize &Size, CTestRandom &Rand)
+{
+	int nSrcPitch = Size.nWidth * 2 + Size.nSrcPad;
+	int nDstPitch = Size.nWidth + Size.nDstPad;
+	TestBuffer Src(nSrcPitch * Size.nHeight, Size.nSrcAlign, 0);
+	Rand.Fill(Src.Data(), nSrcPitch * Size.nHeight);
+	// UVƽͬһ,֮ҲûԽд
+	TestBuffer Dst(nDstPitch * Size.nHeight * 2, Size.nDstAlign, CANARY);
+	TestBuffer Ref(Dst);
+	BYTE *pRefV = Ref.Data() + nDstPitch * Size.nHeight;
+	for (int y = 0; y < Size.nHeight; y++)
+		for (int x = 0; x < Size.nWidth; x++)
+		{
+			Ref.Data()[y * nDstPitch + x] = Src.Data()[y * nSrcPitch + 2 * x];
+			pRefV[y * nDstPitch + x] = Src.Data()[y * nSrcPitch + 2 * x + 1];
+		}
+	pSplitUV(Dst.Data(), nDstPitch, Dst.Data() + nDstPitch * Size.nHeight, nDstPitch, Src.Data(), nSrcPitch, Size.nWidth, Size.nHeight);
+	TEST_CHECK(Dst == Ref);
+	return TestHash(Ref.Data(), nDstPitch * Size.nHeight * 2);
+}
+
+TEST_CASE(PixelCopy, SplitUV)
+{
+	std::vector<SplitUVProc> vecProc;
+	vecProc.push_back(SplitUV_C);
+	vecProc.push_back(SplitUV);
+#ifdef PIXELCOPY_SSE2
+	if (CpuSupportsSSE2())
+		vecProc.push_back(SplitUV_SSE2);
+#endif
+	for (size_t nProc = 0; nProc < vecProc.size(); nProc++)
+	{
+		CTestRandom Rand(2);
+		for (int i = 0; i < RANDOM_CASES; i++)
+			CheckSplitUV(vecProc[nProc], RandomSize(Rand), Rand);
+	}
+}
+
+// 沼NV12Դͼ,UVƽĵַ
+static BYTE *MakeNV12Source(TestBuffer &Src, int nSrcPitch, int nSrcHeight, CTestRandom &Rand)
+{
+	Rand.Fill(Src.Data(), nSrcPitch * nSrcHeight * 3 / 2);
+	return Src.Data() + nSrcPitch * nSrcHeight;
+}
+
+// NV12ԴͼYV12Ĳο,Vƽǰ,Uƽں
+static void RefNV12ToYV12(BYTE *pDst, int nDstPitch, int nDstHeight, const BYTE *pSrcY, const BYTE *pSrcUV, int nSrcPitch, int nWidth, int nHeight)
+{
+	BYTE *pDstV = pDst + nDstPitch * nDstHeight;
+	BYTE *pDstU = pDstV + (nDstPitch / 2) * (nDstHeight / 2);
+	for (int y = 0; y < nHeight; y++)
+		for (int x = 0; x < nWidth; x++)
+			pDst[y * nDstPitch + x] = pSrcY[y * nSrcPitch + x];
+	for (int y = 0; y < (nHeight + 1) / 2; y++)
+		for (int x = 0; x < (nWidth + 1) / 2; x++)
+		{
+			pDstU[y * (nDstPitch / 2) + x] = pSrcUV[y * nSrcPitch + 2 * x];
+			pDstV[y * (nDstPitch / 2) + x] = pSrcUV[y * nSrcPitch + 2 * x + 1];
+		}
+}
+
+// пȡż,UVƽпΪһ
+static int SurfacePitch(int nWidth, int nPad)
+{
+	return ((nWidth + 1) & ~1) + (nPad & ~1);
+}
+
+static uint32_t CheckNV12ToYV12(const TestSize &Size, CTestRandom &Rand)
+{
+	int nSrcPitch = SurfacePitch(Size.nWidth, Size.nSrcPad);
+	int nSrcHeight = ((Size.nHeight + 1) & ~1) + Size.nSurfacePad;
+	int nDstPitch = SurfacePitch(Size.nWidth, Size.nDstPad);
+	int nDstHeight = ((Size.nHeight + 1) & ~1) + Size.nSurfacePad;
+	TestBuffer Src(nSrcPitch * nSrcHeight * 3 / 2, Size.nSrcAlign, 0);
+	BYTE *pSrcUV = MakeNV12Source(Src, nSrcPitch, nSrcHeight, Rand);
+	TestBuffer Dst(nDstPitch * nDstHeight * 3 / 2, Size.nDstAlign, CANARY);
+	TestBuffer Ref(Dst);
+	RefNV12ToYV12(Ref.Data(), nDstPitch, nDstHeight, Src.Data(), pSrcUV, nSrcPitch, Size.nWidth, Size.nHeight);
+	CopyNV12ToYV12(Dst.Data(), nDstPitch, nDstHeight, Src.Data(), nSrcPitch, nSrcHeight, Size.nWidth, Size.nHeight);
+	TEST_CHECK(Dst == Ref);
+
+	// CopyNV12ToYUV420Pдƽ,YV12еĶӦƽһ
+	TestBuffer Dst420(nDstPitch * nDstHeight * 3 / 2, Size.nDstAlign, CANARY);
+	BYTE *pPlane[3];
+	int nPlanePitch[3];
+	GetYV12Planes(Dst420.Data(), nDstPitch, nDstHeight, pPlane, nPlanePitch);
+	CopyNV12ToYUV420P(pPlane, nPlanePitch, Src.Data(), pSrcUV, nSrcPitch, Size.nWidth, Size.nHeight);
+	TEST_CHECK(Dst420 == Ref);
+	return TestHash(Ref.Data(), nDstPitch * nDstHeight * 3 / 2);
+}
+
+TEST_CASE(PixelCopy, NV12ToYV12)
+{
+	CTestRandom Rand(3);
+	for (int i = 0; i < RANDOM_CASES; i++)
+		CheckNV12ToYV12(RandomSize(Rand), Rand);
+}
+
+static uint32_t CheckNV12ToNV12(const TestSize &Size, CTestRandom &Rand)
+{
+	int nSrcPitch = SurfacePitch(Size.nWidth, Size.nSrcPad);
+	int nSrcHeight = ((Size.nHeight + 1) & ~1) + Size.nSurfacePad;
+	int nDstPitch = SurfacePitch(Size.nWidth, Size.nDstPad);
+	int nDstHeight = (Size.nHeight + 1) & ~1;
+	TestBuffer Src(nSrcPitch * nSrcHeight * 3 / 2, Size.nSrcAlign, 0);
+	BYTE *pSrcUV = MakeNV12Source(Src, nSrcPitch, nSrcHeight, Rand);
+	TestBuffer Dst(nDstPitch * nDstHeight * 3 / 2, Size.nDstAlign, CANARY);
+	TestBuffer Ref(Dst);
+	BYTE *pRefUV = Ref.Data() + nDstPitch * nDstHeight;
+	int nUVBytes = (Size.nWidth + 1) & ~1;
+	for (int y = 0; y < Size.nHeight; y++)
+		for (int x = 0; x < Size.nWidth; x++)
+			Ref.Data()[y * nDstPitch + x] = Src.Data()[y * nSrcPitch + x];
+	for (int y = 0; y < (Size.nHeight + 1) / 2; y++)
+		for (int x = 0; x < nUVBytes; x++)
+			pRefUV[y * nDstPitch + x] = pSrcUV[y * nSrcPitch + x];
+	CopyNV12ToNV12(Dst.Data(), nDstPitch, nDstHeight, Src.Data(), nSrcPitch, nSrcHeight, Size.nWidth, Size.nHeight);
+	TEST_CHECK(Dst == Ref);
+	return TestHash(Ref.Data(), nDstPitch * nDstHeight * 3 / 2);
+}
+
+TEST_CASE(PixelCopy, NV12ToNV12)
+{
+	CTestRandom Rand(4);
+	for (int i = 0; i < RANDOM_CASES; i++)
+		CheckNV12ToNV12(RandomSize(Rand), Rand);
+}
+
+static uint32_t CheckYUV420PToYV12(const TestSize &Size, CTestRandom &Rand)
+{
+	int nChromaWidth = (Size.nWidth + 1) / 2;
+	int nChromaHeight = (Size.nHeight + 1) / 2;
+	int nSrcPitch[3] = { Size.nWidth + Size.nSrcPad, nChromaWidth + Size.nSrcPad / 2, nChromaWidth + Size.nSrcPad / 2 };
+	int nSrcHeight[3] = { Size.nHeight, nChromaHeight, nChromaHeight };
+	TestBuffer SrcY(nSrcPitch[0] * Size.nHeight, Size.nSrcAlign, 0);
+	TestBuffer SrcU(nSrcPitch[1] * nChromaHeight, Size.nSrcAlign, 0);
+	TestBuffer SrcV(nSrcPitch[2] * nChromaHeight, Size.nSrcAlign, 0);
+	BYTE *pSrc[3] = { SrcY.Data(), SrcU.Data(), SrcV.Data() };
+	for (int i = 0; i < 3; i++)
+		Rand.Fill(pSrc[i], nSrcPitch[i] * nSrcHeight[i]);
+
+	int nDstPitch = SurfacePitch(Size.nWidth, Size.nDstPad);
+	int nDstHeight = ((Size.nHeight + 1) & ~1) + Size.nSurfacePad;
+	TestBuffer Dst(nDstPitch * nDstHeight * 3 / 2, Size.nDstAlign, CANARY);
+	TestBuffer Ref(Dst);
+	BYTE *pRefV = Ref.Data() + nDstPitch * nDstHeight;
+	BYTE *pRefU = pRefV + (nDstPitch / 2) * (nDstHeight / 2);
+	for (int y = 0; y < Size.nHeight; y++)
+		for (int x = 0; x < Size.nWidth; x++)
+			Ref.Data()[y * nDstPitch + x] = pSrc[0][y * nSrcPitch[0] + x];
+	for (int y = 0; y < nChromaHeight; y++)
+		for (int x = 0; x < nChromaWidth; x++)
+		{
+			pRefU[y * (nDstPitch / 2) + x] = pSrc[1][y * nSrcPitch[1] + x];
+			pRefV[y * (nDstPitch / 2) + x] = pSrc[2][y * nSrcPitch[2] + x];
+		}
+	CopyYUV420PToYV12(Dst.Data(), nDstPitch, nDstHeight, pSrc, nSrcPitch, Size.nWidth, Size.nHeight);
+	TEST_CHECK(Dst == Ref);
+	return TestHash(Ref.Data(), nDstPitch * nDstHeight * 3 / 2);
+}
+
+TEST_CASE(PixelCopy, YUV420PToYV12)
+{
+	CTestRandom Rand(5);
+	for (int i = 0; i < RANDOM_CASES; i++)
+		CheckYUV420PToYV12(RandomSize(Rand), Rand);
+}
+
+static uint32_t CheckConvert10BitPlane(Convert10BitPlaneProc pConvert, const TestSize &Size, int nShift, CTestRandom &Rand)
+{
+	int nSrcPitch = Size.nWidth * 2 + (Size.nSrcPad & ~1);
+	int nDstPitch = Size.nWidth + Size.nDstPad;
+	// 16λҪԴַ2ֽڶ
+	TestBuffer Src(nSrcPitch * Size.nHeight, Size.nSrcAlign & ~1, 0);
+	Rand.Fill(Src.Data(), nSrcPitch * Size.nHeight);
+	TestBuffer Dst(nDstPitch * Size.nHeight, Size.nDstAlign, CANARY);
+	TestBuffer Ref(Dst);
+	for (int y = 0; y < Size.nHeight; y++)
+		for (int x = 0; x < Size.nWidth; x++)
+			Ref.Data()[y * nDstPitch + x] = RefDither(RefSample16(Src.Data() + y * nSrcPitch, x), y, x, nShift);
+	pConvert(Dst.Data(), nDstPitch, Src.Data(), nSrcPitch, Size.nWidth, Size.nHeight, nShift);
+	TEST_CHECK(Dst == Ref);
+	return TestHash(Ref.Data(), nDstPitch * Size.nHeight);
+}
+
+// 16λ˼Ӷ󳬹Ҫ͵
+TEST_CASE(HighBitdepth, Convert10BitPlane)
+{
+	std::vector<Convert10BitPlaneProc> vecProc;
+	vecProc.push_back(Convert10BitPlane_C);
+	vecProc.push_back(Convert10BitPlane);
+#ifdef PIXELCOPY_SSE2
+	if (CpuSupportsSSE2())
+		vecProc.push_back(Convert10BitPlane_SSE2);
+#endif
+	for (size_t nProc = 0; nProc < vecProc.size(); nProc++)
+	{
+		CTestRandom Rand(6);
+		for (int i = 0; i < RANDOM_CASES; i++)
+		{
+			TestSize Size = RandomSize(Rand);
+			CheckConvert10BitPlane(vecProc[nProc], Size, P010_SHIFT, Rand);
+			CheckConvert10BitPlane(vecProc[nProc], Size, YUV420P10_SHIFT, Rand);
+		}
+	}
+}
+
+static uint32_t CheckSplitUV10Bit(SplitUV10BitProc pSplit, const TestSize &Size, int nShift, CTestRandom &Rand)
+{
+	int nSrcPitch = Size.nWidth * 4 + (Size.nSrcPad & ~1);
+	int nDstPitch = Size.nWidth + Size.nDstPad;
+	TestBuffer Src(nSrcPitch * Size.nHeight, Size.nSrcAlign & ~1, 0);
+	Rand.Fill(Src.Data(), nSrcPitch * Size.nHeight);
+	TestBuffer Dst(nDstPitch * Size.nHeight * 2, Size.nDstAlign, CANARY);
+	TestBuffer Ref(Dst);
+	BYTE *pRefV = Ref.Data() + nDstPitch * Size.nHeight;
+	for (int y = 0; y < Size.nHeight; y++)
+		for (int x = 0; x < Size.nWidth; x++)
+		{
+			const BYTE *pRow = Src.Data() + y * nSrcPitch;
+			Ref.Data()[y * nDstPitch + x] = RefDither(RefSample16(pRow, 2 * x), y, x, nShift);
+			pRefV[y * nDstPitch + x] = RefDither(RefSample16(pRow, 2 * x + 1), y, x, nShift);
+		}
+	pSplit(Dst.Data(), Dst.Data() + nDstPitch * Size.nHeight, nDstPitch, Src.Data(), nSrcPitch, Size.nWidth, Size.nHeight, nShift);
+	TEST_CHECK(Dst == Ref);
+	return TestHash(Ref.Data(), nDstPitch * Size.nHeight * 2);
+}
+
+TEST_CASE(HighBitdepth, SplitUV10Bit)
+{
+	std::vector<SplitUV10BitProc> vecProc;
+	vecProc.push_back(SplitUV10Bit_C);
+	vecProc.push_back(SplitUV10Bit);
+#ifdef PIXELCOPY_SSE2
+	if (CpuSupportsSSE2())
+		vecProc.push_back(SplitUV10Bit_SSE2);
+#endif
+	for (size_t nProc = 0; nProc < vecProc.size(); nProc++)
+	{
+		CTestRandom Rand(7);
+		for (int i = 0; i < RANDOM_CASES; i++)
+			CheckSplitUV10Bit(vecProc[nProc], RandomSize(Rand), P010_SHIFT, Rand);
+	}
+}
+
+// P010浽YV12NV12·
+static uint32_t CheckP010Surface(const TestSize &Size, bool bNV12, CTestRandom &Rand)
+{
+	int nSrcPitch = SurfacePitch(Size.nWidth, Size.nSrcPad) * 2;
+	int nSrcHeight = ((Size.nHeight + 1) & ~1) + Size.nSurfacePad;
+	int nDstPitch = SurfacePitch(Size.nWidth, Size.nDstPad);
+	int nDstHeight = ((Size.nHeight + 1) & ~1) + Size.nSurfacePad;
+	TestBuffer Src(nSrcPitch * nSrcHeight * 3 / 2, Size.nSrcAlign & ~1, 0);
+	Rand.Fill(Src.Data(), nSrcPitch * nSrcHeight * 3 / 2);
+	const BYTE *pSrcUV = Src.Data() + nSrcPitch * nSrcHeight;
+	TestBuffer Dst(nDstPitch * nDstHeight * 3 / 2, Size.nDstAlign, CANARY);
+	TestBuffer Ref(Dst);
+	int nChromaWidth = (Size.nWidth + 1) / 2;
+	for (int y = 0; y < Size.nHeight; y++)
+		for (int x = 0; x < Size.nWidth; x++)
+			Ref.Data()[y * nDstPitch + x] = RefDither(RefSample16(Src.Data() + y * nSrcPitch, x), y, x, P010_SHIFT);
+	BYTE *pRefChroma = Ref.Data() + nDstPitch * nDstHeight;
+	for (int y = 0; y < (Size.nHeight + 1) / 2; y++)
+	{
+		const BYTE *pRow = pSrcUV + y * nSrcPitch;
+		for (int x = 0; x < nChromaWidth; x++)
+		{
+			if (bNV12)
+			{
+				// NV12UVƽ水֯Ĳ嶶,кΪڵ
+				pRefChroma[y * nDstPitch + 2 * x] = RefDither(RefSample16(pRow, 2 * x), y, 2 * x, P010_SHIFT);
+				pRefChroma[y * nDstPitch + 2 * x + 1] = RefDither(RefSample16(pRow, 2 * x + 1), y, 2 * x + 1, P010_SHIFT);
+			}
+			else
+			{
+				BYTE *pRefU = pRefChroma + (nDstPitch / 2) * (nDstHeight / 2);
+				pRefU[y * (nDstPitch / 2) + x] = RefDither(RefSample16(pRow, 2 * x), y, x, P010_SHIFT);
+				pRefChroma[y * (nDstPitch / 2) + x] = RefDither(RefSample16(pRow, 2 * x + 1), y, x, P010_SHIFT);
+			}
+		}
+	}
+	if (bNV12)
+		CopyP010ToNV12(Dst.Data(), nDstPitch, nDstHeight, Src.Data(), nSrcPitch, nSrcHeight, Size.nWidth, Size.nHeight);
+	else
+		CopyP010ToYV12(Dst.Data(), nDstPitch, nDstHeight, Src.Data(), nSrcPitch, nSrcHeight, Size.nWidth, Size.nHeight);
+	TEST_CHECK(Dst == Ref);
+	return TestHash(Ref.Data(), nDstPitch * nDstHeight * 3 / 2);
+}
+
+TEST_CASE(HighBitdepth, P010Surface)
+{
+	CTestRandom Rand(8);
+	for (int i = 0; i < RANDOM_CASES; i++)
+	{
+		TestSize Size = RandomSize(Rand);
+		CheckP010Surface(Size, false, Rand);
+		CheckP010Surface(Size, true, Rand);
+	}
+}
+
+static uint32_t CheckYUV420P10(const TestSize &Size, CTestRandom &Rand)
+{
+	int nChromaWidth = (Size.nWidth + 1) / 2;
+	int nChromaHeight = (Size.nHeight + 1) / 2;
+	int nWidth[3] = { Size.nWidth, nChromaWidth, nChromaWidth };
+	int nHeight[3] = { Size.nHeight, nChromaHeight, nChromaHeight };
+	int nSrcPitch[3], nDstPitch[3];
+	std::vector<TestBuffer> vecSrc, vecDst, vecRef;
+	BYTE *pSrc[3], *pDst[3];
+	for (int i = 0; i < 3; i++)
+	{
+		nSrcPitch[i] = nWidth[i] * 2 + (Size.nSrcPad & ~1);
+		nDstPitch[i] = nWidth[i] + Size.nDstPad;
+		vecSrc.push_back(TestBuffer(nSrcPitch[i] * nHeight[i], Size.nSrcAlign & ~1, 0));
+		vecDst.push_back(TestBuffer(nDstPitch[i] * nHeight[i], Size.nDstAlign, CANARY));
+	}
+	uint32_t nHash = 2166136261u;
+	for (int i = 0; i < 3; i++)
+	{
+		pSrc[i] = vecSrc[i].Data();
+		pDst[i] = vecDst[i].Data();
+		// YUV420P10Чڵ10λ
+		for (int n = 0; n < nSrcPitch[i] * nHeight[i] / 2; n++)
+			((WORD *)pSrc[i])[n] = (WORD)(Rand.Next() & 0x3FF);
+		vecRef.push_back(vecDst[i]);
+		for (int y = 0; y < nHeight[i]; y++)
+			for (int x = 0; x < nWidth[i]; x++)
+				vecRef[i].Data()[y * nDstPitch[i] + x] = RefDither(RefSample16(pSrc[i] + y * nSrcPitch[i], x), y, x, YUV420P10_SHIFT);
+	}
+	CopyYUV420P10ToYUV420P(pDst, nDstPitch, pSrc, nSrcPitch, Size.nWidth, Size.nHeight);
+	for (int i = 0; i < 3; i++)
+	{
+		TEST_CHECK(vecDst[i] == vecRef[i]);
+		nHash = TestHash(vecRef[i].Data(), nDstPitch[i] * nHeight[i], nHash);
+	}
+	return nHash;
+}
+
+TEST_CASE(HighBitdepth, YUV420P10)
+{
+	CTestRandom Rand(9);
+	for (int i = 0; i < RANDOM_CASES; i++)
+		CheckYUV420P10(RandomSize(Rand), Rand);
+}
+
+#ifdef TEST_HAVE_SWSCALE
+// swscaleYUV420P10תΪYUV420PĽȽ,ߵĶͬ,ֽͬ,
+// ԭֵ4ȡ֮,1,ͼƽӽ0,ûϵͳԵƫ
+TEST_CASE(HighBitdepth, MatchesSwscale)
+{
+	const int nWidth = 333;
+	const int nHeight = 177;
+	int nPlaneWidth[3] = { nWidth, (nWidth + 1) / 2, (nWidth + 1) / 2 };
+	int nPlaneHeight[3] = { nHeight, (nHeight + 1) / 2, (nHeight + 1) / 2 };
+	std::vector<uint16_t> vecSrc[3];
+	std::vector<BYTE> vecDst[3], vecSws[3];
+	BYTE *pSrc[3], *pDst[3], *pSws[3];
+	int nSrcPitch[3], nDstPitch[3];
+	CTestRandom Rand(27);
+	for (int i = 0; i < 3; i++)
+	{
+		// п64ֽڶ벢һ,swscaleSIMDдпڵͼ
+		nSrcPitch[i] = (nPlaneWidth[i] * 2 + 63) & ~63;
+		nDstPitch[i] = (nPlaneWidth[i] + 63) & ~63;
+		vecSrc[i].resize(nSrcPitch[i] / 2 * (nPlaneHeight[i] + 1));
+		for (size_t j = 0; j < vecSrc[i].size(); j++)
+			vecSrc[i][j] = (uint16_t)(Rand.Next() & 0x3FF);
+		vecDst[i].resize(nDstPitch[i] * (nPlaneHeight[i] + 1));
+		vecSws[i].resize(vecDst[i].size());
+		pSrc[i] = (BYTE *)&vecSrc[i][0];
+		pDst[i] = &vecDst[i][0];
+		pSws[i] = &vecSws[i][0];
+	}
+	SwsContext *pContext = sws_getContext(nWidth, nHeight, AV_PIX_FMT_YUV420P10LE, nWidth, nHeight, AV_PIX_FMT_YUV420P, SWS_POINT, NULL, NULL, NULL);
+	TEST_CHECK(pContext != NULL);
+	if (!pContext)
+		return;
+	sws_scale(pContext, pSrc, nSrcPitch, 0, nHeight, pSws, nDstPitch);
+	sws_freeContext(pContext);
+	CopyYUV420P10ToYUV420P(pDst, nDstPitch, pSrc, nSrcPitch, nWidth, nHeight);
+
+	for (int i = 0; i < 3; i++)
+	{
+		int nMaxDiff = 0;
+		long long nSumDiff = 0;
+		for (int y = 0; y < nPlaneHeight[i]; y++)
+		{
+			for (int x = 0; x < nPlaneWidth[i]; x++)
+			{
+				int nDiff = pDst[i][y * nDstPitch[i] + x] - pSws[i][y * nDstPitch[i] + x];
+				if (abs(nDiff) > nMaxDiff)
+					nMaxDiff = abs(nDiff);
+				nSumDiff += nDiff;
+			}
+		}
+		TEST_CHECK(nMaxDiff <= 1);
+		TEST_CHECK(fabs((double)nSumDiff / (nPlaneWidth[i] * nPlaneHeight[i])) < 0.25);
+	}
+}
+#endif
+
+// :̶ӵ67x35ͼ񾭸·ָ
+// οʵֻں˵κΪ仯(ƽ沼)ıָ,޸ںʱȷ仯Ԥڵ
+TEST_CASE(PixelCopy, Golden)
+{
+	CTestRandom Rand(20);
+	TEST_EQUAL(CheckCopyPlane(s_GoldenSize, 4, Rand), 4118374078u);
+	TEST_EQUAL(CheckSplitUV(SplitUV, s_GoldenSize, Rand), 2169021734u);
+	TEST_EQUAL(CheckNV12ToYV12(s_GoldenSize, Rand), 3549960169u);
+	TEST_EQUAL(CheckNV12ToNV12(s_GoldenSize, Rand), 540025232u);
+	TEST_EQUAL(CheckYUV420PToYV12(s_GoldenSize, Rand), 2493756665u);
+	TEST_EQUAL(CheckConvert10BitPlane(Convert10BitPlane, s_GoldenSize, P010_SHIFT, Rand), 4209467313u);
+	TEST_EQUAL(CheckSplitUV10Bit(SplitUV10Bit, s_GoldenSize, P010_SHIFT, Rand), 339610651u);
+	TEST_EQUAL(CheckP010Surface(s_GoldenSize, false, Rand), 4154207523u);
+	TEST_EQUAL(CheckP010Surface(s_GoldenSize, true, Rand), 949124354u);
+	TEST_EQUAL(CheckYUV420P10(s_GoldenSize, Rand), 637980006u);
+}
+
+// ܲʹ1080Pͼ,пԿȡ2048
+#define BENCH_WIDTH		1920
+#define BENCH_HEIGHT	1080
+#define BENCH_PITCH		2048
+
+BENCHMARK(PixelCopy, NV12)
+{
+	std::vector<BYTE> vecSrc(BENCH_PITCH * BENCH_HEIGHT * 3 / 2 * 2);
+	std::vector<BYTE> vecDst(vecSrc.size());
+	CTestRandom Rand;
+	Rand.Fill(&vecSrc[0], vecSrc.size());
+	const double dfFrameBytes = BENCH_WIDTH * BENCH_HEIGHT * 3 / 2;
+	BenchRun("CopyPlane 1080P Y", BENCH_WIDTH * BENCH_HEIGHT, [&]() {
+		CopyPlane(&vecDst[0], BENCH_PITCH, &vecSrc[0], BENCH_PITCH, BENCH_WIDTH, BENCH_HEIGHT);
+	});
+	BenchRun("CopyNV12ToNV12 1080P", dfFrameBytes, [&]() {
+		CopyNV12ToNV12(&vecDst[0], BENCH_PITCH, BENCH_HEIGHT, &vecSrc[0], BENCH_PITCH, BENCH_HEIGHT, BENCH_WIDTH, BENCH_HEIGHT);
+	});
+	BenchRun("CopyNV12ToYV12 1080P", dfFrameBytes, [&]() {
+		CopyNV12ToYV12(&vecDst[0], BENCH_PITCH, BENCH_HEIGHT, &vecSrc[0], BENCH_PITCH, BENCH_HEIGHT, BENCH_WIDTH, BENCH_HEIGHT);
+	});
+	BYTE *pSrcUV = &vecSrc[BENCH_PITCH * BENCH_HEIGHT];
+	BYTE *pDstV = &vecDst[BENCH_PITCH * BENCH_HEIGHT];
+	BenchRun("SplitUV_C 1080P", BENCH_WIDTH * BENCH_HEIGHT / 2, [&]() {
+		SplitUV_C(&vecDst[0], BENCH_PITCH / 2, pDstV, BENCH_PITCH / 2, pSrcUV, BENCH_PITCH, BENCH_WIDTH / 2, BENCH_HEIGHT / 2);
+	});
+#ifdef PIXELCOPY_SSE2
+	if (CpuSupportsSSE2())
+		BenchRun("SplitUV_SSE2 1080P", BENCH_WIDTH * BENCH_HEIGHT / 2, [&]() {
+			SplitUV_SSE2(&vecDst[0], BENCH_PITCH / 2, pDstV, BENCH_PITCH / 2, pSrcUV, BENCH_PITCH, BENCH_WIDTH / 2, BENCH_HEIGHT / 2);
+		});
+#endif
+}
+
+BENCHMARK(HighBitdepth, P010)
+{
+	std::vector<BYTE> vecSrc(BENCH_PITCH * 2 * BENCH_HEIGHT * 3 / 2);
+	std::vector<BYTE> vecDst(BENCH_PITCH * BENCH_HEIGHT * 3 / 2);
+	CTestRandom Rand;
+	Rand.Fill(&vecSrc[0], vecSrc.size());
+	BenchRun("Convert10BitPlane_C 1080P Y", BENCH_WIDTH * BENCH_HEIGHT, [&]() {
+		Convert10BitPlane_C(&vecDst[0], BENCH_PITCH, &vecSrc[0], BENCH_PITCH * 2, BENCH_WIDTH, BENCH_HEIGHT, P010_SHIFT);
+	});
+	BenchRun("SplitUV10Bit_C 1080P", BENCH_WIDTH * BENCH_HEIGHT / 2, [&]() {
+		SplitUV10Bit_C(&vecDst[0], &vecDst[BENCH_PITCH * BENCH_HEIGHT], BENCH_PITCH / 2, &vecSrc[0], BENCH_PITCH * 2, BENCH_WIDTH / 2, BENCH_HEIGHT / 2, P010_SHIFT);
+	});
+#ifdef PIXELCOPY_SSE2
+	if (CpuSupportsSSE2())
+	{
+		BenchRun("Convert10BitPlane_SSE2 1080P Y", BENCH_WIDTH * BENCH_HEIGHT, [&]() {
+			Convert10BitPlane_SSE2(&vecDst[0], BENCH_PITCH, &vecSrc[0], BENCH_PITCH * 2, BENCH_WIDTH, BENCH_HEIGHT, P010_SHIFT);
+		});
+		BenchRun("SplitUV10Bit_SSE2 1080P", BENCH_WIDTH * BENCH_HEIGHT / 2, [&]() {
+			SplitUV10Bit_SSE2(&vecDst[0], &vecDst[BENCH_PITCH * BENCH_HEIGHT], BENCH_PITCH / 2, &vecSrc[0], BENCH_PITCH * 2, BENCH_WIDTH / 2, BENCH_HEIGHT / 2, P010_SHIFT);
+		});
+	}
+#endif
+	BenchRun("CopyP010ToYV12 1080P", BENCH_WIDTH * BENCH_HEIGHT * 3 / 2, [&]() {
+		CopyP010ToYV12(&vecDst[0], BENCH_PITCH, BENCH_HEIGHT, &vecSrc[0], BENCH_PITCH * 2, BENCH_HEIGHT, BENCH_WIDTH, BENCH_HEIGHT);
+	});
+}
@@ -0,0 +1,303 @@
+// CPresentBatcherĲ,豸Ϊڴеģʵ,ҪںԿ
+// ģ豸Ĵֻ¼ϴ֡ʱ,쵽̨ʱ봰ڵλ,Presentʱ̨Ŀ
+// Դ˼ÿʾһ֡,Լ豸֮дǷ񶼱»
+#include "TestFramework.h"
+#include "PresentBatcher.h"
+#include "MonoClock.h"
+#include <map>
+
+#define TEST_TILES			4
+#define TEST_NO_PTS			-1		// ̨иôλΪɫ
+
+struct MockTileSurface
+{
+	int			nWidth;
+	int			nHeight;
+	int64_t		nPts;
+};
+
+class CMockBatchDevice : public IBatchPresentDevice
+{
+public:
+	CMockBatchDevice()
+	{
+		m_nState = BatchDevice_Ok;
+		m_nLiveSurfaces = 0;
+		m_nResets = 0;
+		m_nResetWithSurfaces = 0;
+		m_nPresents = 0;
+		m_bCreated = false;
+		InitializeCriticalSection(&m_cs);
+	}
+	virtual ~CMockBatchDevice()
+	{
+		DeleteCriticalSection(&m_cs);
+	}
+	virtual bool Create(HWND hPresentWnd, const RECT &rtRegion, HMONITOR hMonitor)
+	{
+		CAutoLock lock(&m_cs);
+		m_bCreated = true;
+		m_mapBackBuffer.clear();
+		return true;
+	}
+	virtual void Release()
+	{
+		CAutoLock lock(&m_cs);
+		m_bCreated = false;
+	}
+	virtual BatchDeviceState TestDevice()
+	{
+		return (BatchDeviceState)m_nState;
+	}
+	virtual bool Reset()
+	{
+		CAutoLock lock(&m_cs);
+		if (m_nLiveSurfaces)
+			m_nResetWithSurfaces++;
+		m_mapBackBuffer.clear();
+		m_nResets++;
+		m_nState = BatchDevice_Ok;
+		return true;
+	}
+	virtual void *CreateSurface(int nWidth, int nHeight, LONGLONG &nBytes)
+	{
+		// 豸ʧڼ䲻ܴ
+		if (m_nState != BatchDevice_Ok)
+			return NULL;
+		MockTileSurface *pSurface = new MockTileSurface;
+		pSurface->nWidth = nWidth;
+		pSurface->nHeight = nHeight;
+		pSurface->nPts = TEST_NO_PTS;
+		nBytes = (LONGLONG)nWidth * nHeight * 3 / 2;
+		InterlockedIncrement(&m_nLiveSurfaces);
+		return pSurface;
+	}
+	virtual void ReleaseSurface(void *pSurface)
+	{
+		delete (MockTileSurface *)pSurface;
+		InterlockedDecrement(&m_nLiveSurfaces);
+	}
+	virtual bool Upload(void *pSurface, AVFrame *pAvFrame)
+	{
+		((MockTileSurface *)pSurface)->nPts = pAvFrame->pts;
+		return true;
+	}
+	virtual bool BeginCompose()
+	{
+		EnterCriticalSection(&m_cs);
+		return true;
+	}
+	virtual void StretchTile(void *pSurface, int nWidth, int nHeight, const RECT &rtTile)
+	{
+		m_mapBackBuffer[rtTile.left] = ((MockTileSurface *)pSurface)->nPts;
+	}
+	virtual void EndCompose()
+	{
+		LeaveCriticalSection(&m_cs);
+	}
+	virtual void Present(const RECT &rtRegion)
+	{
+		CAutoLock lock(&m_cs);
+		m_mapScreen = m_mapBackBuffer;
+		m_nPresents++;
+	}
+	// ȡĻϴʾ֡ʱ,߽
+	int64_t GetScreenPts(LONG nLeft)
+	{
+		CAutoLock lock(&m_cs);
+		map<LONG, int64_t>::iterator it = m_mapScreen.find(nLeft);
+		return it == m_mapScreen.end() ? TEST_NO_PTS : it->second;
+	}
+	volatile LONG		m_nState;
+	volatile LONG		m_nLiveSurfaces;
+	LONG				m_nResets;
+	LONG				m_nResetWithSurfaces;	// ʱδͷŵĴĴ
+	volatile LONG		m_nPresents;
+	bool				m_bCreated;
+private:
+	CRITICAL_SECTION	m_cs;
+	map<LONG, int64_t>	m_mapBackBuffer;
+	map<LONG, int64_t>	m_mapScreen;
+};
+
+static AVFrame *MakeTileFrame(int nFormat, int64_t nPts)
+{
+	AVFrame *pFrame = av_frame_alloc();
+	pFrame->buf[0] = av_buffer_alloc(64);
+	pFrame->data[0] = pFrame->buf[0]->data;
+	pFrame->linesize[0] = 64;
+	pFrame->width = 352;
+	pFrame->height = 288;
+	pFrame->format = nFormat;
+	pFrame->pts = nPts;
+	return pFrame;
+}
+
+static bool UpdateTestTile(CPresentBatcher &Batcher, int nTile, int nFormat, int64_t nPts)
+{
+	AVFrame *pFrame = MakeTileFrame(nFormat, nPts);
+	bool bResult = Batcher.UpdateTile(nTile, pFrame);
+	av_frame_free(&pFrame);
+	return bResult;
+}
+
+// ,100,崰
+static void AddTestTiles(CPresentBatcher &Batcher)
+{
+	for (int i = 0; i < TEST_TILES; i++)
+	{
+		RECT rtTile = { i * 100, 0, i * 100 + 100, 100 };
+		TEST_EQUAL(Batcher.AddTile((HWND)(INT_PTR)(i + 1), rtTile), i);
+	}
+}
+
+// ȴPresentĴﵽnPresents
+static bool WaitPresents(CMockBatchDevice &Device, LONG nPresents, DWORD dwTimeout = 2000)
+{
+	int64_t nDeadline = MonoTimeNs() + dwTimeout * MONO_NS_PER_MS;
+	while (Device.m_nPresents < nPresents)
+	{
+		if (MonoTimeNs() > nDeadline)
+			return false;
+		Sleep(1);
+	}
+	return true;
+}
+
+// ޴ģʽֻе߼,ÿθҪôPresentʾ,Ҫôһθ¸
+TEST_CASE(PresentBatcher, HeadlessSchedules)
+{
+	CPresentBatcher Batcher;
+	RECT rtRegion = { 0, 0, TEST_TILES * 100, 100 };
+	TEST_CHECK(Batcher.Create(NULL, rtRegion, NULL));
+	AddTestTiles(Batcher);
+	TEST_CHECK(Batcher.Start(2));
+	// ڼ䲻Ӵ
+	RECT rtTile = { 0, 0, 1, 1 };
+	TEST_EQUAL(Batcher.AddTile(NULL, rtTile), -1);
+	const int nRounds = 50;
+	for (int i = 0; i < nRounds; i++)
+	{
+		for (int j = 0; j < TEST_TILES; j++)
+			TEST_CHECK(UpdateTestTile(Batcher, j, AV_PIX_FMT_YUV420P, i));
+		if (i % 10 == 0)
+			Sleep(5);
+	}
+	TEST_CHECK(!UpdateTestTile(Batcher, TEST_TILES, AV_PIX_FMT_YUV420P, 0));
+	TEST_CHECK(!UpdateTestTile(Batcher, 0, AV_PIX_FMT_BGRA, 0));
+	Sleep(20);
+	Batcher.Stop();
+	PresentBatchStat Stat;
+	Batcher.GetStat(Stat);
+	TEST_EQUAL(Stat.nTileUpdates, nRounds * TEST_TILES);
+	TEST_EQUAL(Stat.nTilesPresented + Stat.nTilesDropped, Stat.nTileUpdates);
+	TEST_CHECK(Stat.nPresents > 0);
+	TEST_CHECK(Stat.nIdleTicks > 0);
+	TEST_EQUAL(Stat.nResets, 0);
+}
+
+// ÿʾϴ֡,ûиµĴػ
+TEST_CASE(PresentBatcher, ComposesLatestFrame)
+{
+	CMockBatchDevice Device;
+	CPresentBatcher Batcher;
+	RECT rtRegion = { 0, 0, TEST_TILES * 100, 100 };
+	TEST_CHECK(Batcher.Create(NULL, rtRegion, NULL, &Device));
+	AddTestTiles(Batcher);
+	TEST_CHECK(Batcher.Start(1000));
+	TEST_CHECK(Device.m_bCreated);
+	// ͨȾ˸´
+	CBatchedSurface Surface(&Batcher);
+	TEST_CHECK(!Surface.InitD3D((HWND)(INT_PTR)(TEST_TILES + 1), 352, 288));
+	TEST_CHECK(Surface.InitD3D((HWND)(INT_PTR)2, 352, 288));
+	AVFrame *pFrame = MakeTileFrame(AV_PIX_FMT_YUV420P, 7);
+	TEST_CHECK(Surface.Render(pFrame));
+	av_frame_free(&pFrame);
+	TEST_CHECK(UpdateTestTile(Batcher, 0, AV_PIX_FMT_YUVJ420P, 3));
+	TEST_CHECK(WaitPresents(Device, 1));
+	int64_t nDeadline = MonoTimeNs() + 2000 * MONO_NS_PER_MS;
+	while ((Device.GetScreenPts(0) != 3 || Device.GetScreenPts(100) != 7) && MonoTimeNs() < nDeadline)
+		Sleep(1);
+	TEST_EQUAL(Device.GetScreenPts(0), 3);
+	TEST_EQUAL(Device.GetScreenPts(100), 7);
+	TEST_EQUAL(Device.GetScreenPts(200), TEST_NO_PTS);
+	TEST_EQUAL(Device.m_nLiveSurfaces, 2);
+	Batcher.Stop();
+	TEST_CHECK(!Device.m_bCreated);
+	TEST_EQUAL(Device.m_nLiveSurfaces, 0);
+}
+
+// 豸úд񶼱»,֡ɴûָ,Ӳ֡Ĵһ֡
+TEST_CASE(PresentBatcher, ResetRepaintsEveryTile)
+{
+	CMockBatchDevice Device;
+	CPresentBatcher Batcher;
+	RECT rtRegion = { 0, 0, TEST_TILES * 100, 100 };
+	TEST_CHECK(Batcher.Create(NULL, rtRegion, NULL, &Device));
+	AddTestTiles(Batcher);
+	// ʾںܶ,豸״̬ı仯ܿ챻ʾ̷߳
+	TEST_CHECK(Batcher.Start(5));
+	for (int i = 0; i < TEST_TILES - 1; i++)
+		TEST_CHECK(UpdateTestTile(Batcher, i, AV_PIX_FMT_YUV420P, 10 + i));
+	TEST_CHECK(UpdateTestTile(Batcher, TEST_TILES - 1, AV_PIX_FMT_DXVA2_VLD, 20));
+	int64_t nDeadline = MonoTimeNs() + 2000 * MONO_NS_PER_MS;
+	while (Device.GetScreenPts((TEST_TILES - 1) * 100) != 20 && MonoTimeNs() < nDeadline)
+		Sleep(1);
+	for (int i = 0; i < TEST_TILES - 1; i++)
+		TEST_EQUAL(Device.GetScreenPts(i * 100), 10 + i);
+	TEST_EQUAL(Device.GetScreenPts((TEST_TILES - 1) * 100), 20);
+
+	// 豸ʧڼ䲻ϳ
+	LONG nPresents = Device.m_nPresents;
+	Device.m_nState = BatchDevice_Lost;
+	Sleep(30);
+	TEST_EQUAL(Device.m_nPresents, nPresents);
+	// 豸ú,Ҫκͨٸ,һPresentָ֡Ĵ
+	Device.m_nState = BatchDevice_NotReset;
+	TEST_CHECK(WaitPresents(Device, nPresents + 1));
+	TEST_EQUAL(Device.m_nResets, 1);
+	TEST_EQUAL(Device.m_nResetWithSurfaces, 0);
+	for (int i = 0; i < TEST_TILES - 1; i++)
+		TEST_EQUAL(Device.GetScreenPts(i * 100), 10 + i);
+	TEST_EQUAL(Device.GetScreenPts((TEST_TILES - 1) * 100), TEST_NO_PTS);
+	PresentBatchStat Stat;
+	Batcher.GetStat(Stat);
+	TEST_EQUAL(Stat.nResets, 1);
+	TEST_EQUAL(Stat.nTilesRestored, TEST_TILES - 1);
+	TEST_EQUAL(Device.m_nLiveSurfaces, TEST_TILES - 1);
+
+	// Ӳ֡Ĵյһָ֡ʾ
+	TEST_CHECK(UpdateTestTile(Batcher, TEST_TILES - 1, AV_PIX_FMT_DXVA2_VLD, 21));
+	nDeadline = MonoTimeNs() + 2000 * MONO_NS_PER_MS;
+	while (Device.GetScreenPts((TEST_TILES - 1) * 100) != 21 && MonoTimeNs() < nDeadline)
+		Sleep(1);
+	TEST_EQUAL(Device.GetScreenPts((TEST_TILES - 1) * 100), 21);
+	TEST_EQUAL(Device.GetScreenPts(0), 10);
+	Batcher.Stop();
+	TEST_EQUAL(Device.m_nLiveSurfaces, 0);
+}
+
+// ޴ģʽͬһʾ,λӾ
+TEST_CASE(PresentBatcher, GroupHeadless)
+{
+	CPresentBatchGroup Group;
+	for (int i = 0; i < TEST_TILES; i++)
+	{
+		RECT rtPanel = { 50 + i * 100, 30, 150 + i * 100, 130 };
+		Group.AddPanel((HWND)(INT_PTR)(i + 1), rtPanel);
+	}
+	TEST_CHECK(Group.Start(5));
+	CPresentBatcher *pBatcher = Group.GetBatcher((HWND)(INT_PTR)1);
+	TEST_CHECK(pBatcher != NULL);
+	if (!pBatcher)
+		return;
+	for (int i = 0; i < TEST_TILES; i++)
+	{
+		TEST_CHECK(Group.GetBatcher((HWND)(INT_PTR)(i + 1)) == pBatcher);
+		TEST_EQUAL(pBatcher->FindTile((HWND)(INT_PTR)(i + 1)), i);
+	}
+	TEST_CHECK(Group.GetBatcher((HWND)(INT_PTR)(TEST_TILES + 1)) == NULL);
+	TEST_CHECK(UpdateTestTile(*pBatcher, 0, AV_PIX_FMT_YUV420P, 1));
+	Group.Stop();
+	TEST_CHECK(Group.GetBatcher((HWND)(INT_PTR)1) == NULL);
+}
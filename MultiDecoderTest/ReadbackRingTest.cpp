@@ -0,0 +1,506 @@
+// CReadbackRingĲ,ڴеģݴD3D9ݴ
+// ģGPUύʱԴ,̶GPUʱ,֮ǰݴҪȴ,Ϊһͣ
+// ԴYƽд֡,صʱرȽ,Էֻض˴ݴݱ
+#include "TestFramework.h"
+#include "ReadbackRing.h"
+#include "MonoClock.h"
+#include <set>
+
+#define MOCK_MAX_SLOTS		16
+
+// ģNV12
+struct MockSourceSurface
+{
+	int				nWidth;
+	int				nHeight;
+	int				nPitch;
+	vector<BYTE>	vecData;
+};
+
+static void InitSource(MockSourceSurface &Surface, int nWidth, int nHeight)
+{
+	Surface.nWidth = nWidth;
+	Surface.nHeight = nHeight;
+	Surface.nPitch = (nWidth + 63) & ~63;
+	Surface.vecData.assign(Surface.nPitch * nHeight * 3 / 2, 0);
+}
+
+// ģһ֡:YƽÿΪ֡ŵĵ8λ,Ͻ4ֽΪ֡,UVƽ潻дUVֵ
+static void DecodeSource(MockSourceSurface &Surface, int nFrame)
+{
+	BYTE *pY = &Surface.vecData[0];
+	for (int y = 0; y < Surface.nHeight; y++)
+		memset(pY + y * Surface.nPitch, nFrame & 0xFF, Surface.nWidth);
+	memcpy(pY, &nFrame, sizeof(int));
+	BYTE *pUV = pY + Surface.nPitch * Surface.nHeight;
+	for (int y = 0; y < Surface.nHeight / 2; y++)
+	{
+		for (int x = 0; x < Surface.nWidth / 2; x++)
+		{
+			pUV[y * Surface.nPitch + x * 2] = 0x40;
+			pUV[y * Surface.nPitch + x * 2 + 1] = 0xC0;
+		}
+	}
+}
+
+static int ImageFrame(const ReadbackImage &Image)
+{
+	int nFrame = 0;
+	memcpy(&nFrame, Image.pBits, sizeof(int));
+	return nFrame;
+}
+
+class CMockReadbackStaging : public IReadbackStaging
+{
+public:
+	explicit CMockReadbackStaging(int64_t nGpuNs)
+	{
+		m_nGpuNs = nGpuNs;
+		m_nWidth = 0;
+		m_nHeight = 0;
+		m_nSlots = 0;
+		m_nCreates = 0;
+		m_nCopies = 0;
+		m_nStalls = 0;
+		m_nLocked = 0;
+		m_nFailSlot = -1;
+		for (int i = 0; i < MOCK_MAX_SLOTS; i++)
+			m_nReadyTime[i] = 0;
+	}
+	virtual bool IsCompatible(void *pSurface)
+	{
+		MockSourceSurface *pSource = (MockSourceSurface *)pSurface;
+		return m_nSlots > 0 && pSource->nWidth == m_nWidth && pSource->nHeight == m_nHeight;
+	}
+	virtual bool Create(void *pSurface, int nSlots)
+	{
+		MockSourceSurface *pSource = (MockSourceSurface *)pSurface;
+		if (nSlots > MOCK_MAX_SLOTS)
+			return false;
+		m_nWidth = pSource->nWidth;
+		m_nHeight = pSource->nHeight;
+		m_nPitch = pSource->nPitch;
+		m_nSlots = nSlots;
+		for (int i = 0; i < nSlots; i++)
+			m_vecSlot[i].assign(pSource->vecData.size(), 0);
+		InterlockedIncrement(&m_nCreates);
+		return true;
+	}
+	virtual void Release()
+	{
+		m_nSlots = 0;
+	}
+	virtual bool Copy(void *pSurface, int nSlot)
+	{
+		// GPUύ˳ִ,ƵύʱԴ,˺
+		MockSourceSurface *pSource = (MockSourceSurface *)pSurface;
+		memcpy(&m_vecSlot[nSlot][0], &pSource->vecData[0], pSource->vecData.size());
+		InterlockedExchange64(&m_nReadyTime[nSlot], MonoTimeNs() + m_nGpuNs);
+		InterlockedIncrement(&m_nCopies);
+		return true;
+	}
+	virtual bool Lock(int nSlot, ReadbackImage &Image)
+	{
+		if (nSlot == m_nFailSlot)
+		{
+			m_nFailSlot = -1;
+			return false;
+		}
+		int64_t nWait = m_nReadyTime[nSlot] - MonoTimeNs();
+		if (nWait > 0)
+		{// LockRectһȴGPUɸ
+			InterlockedIncrement(&m_nStalls);
+			MonoSleepNs(nWait);
+		}
+		if (InterlockedIncrement(&m_nLocked) != 1)
+			TestFail(__FILE__, __LINE__, "two staging surfaces locked at once");
+		Image.pBits = &m_vecSlot[nSlot][0];
+		Image.nPitch = m_nPitch;
+		Image.nSurfaceHeight = m_nHeight;
+		Image.bP010 = false;
+		return true;
+	}
+	virtual void Unlock(int nSlot)
+	{
+		InterlockedDecrement(&m_nLocked);
+	}
+
+	int64_t				m_nGpuNs;			// ģGPUƺʱ
+	int					m_nWidth;
+	int					m_nHeight;
+	int					m_nPitch;
+	int					m_nSlots;
+	vector<BYTE>		m_vecSlot[MOCK_MAX_SLOTS];
+	volatile LONGLONG	m_nReadyTime[MOCK_MAX_SLOTS];
+	volatile LONG		m_nCreates;
+	volatile LONG		m_nCopies;
+	volatile LONG		m_nStalls;			// ʱGPUδɸƵĴ
+	volatile LONG		m_nLocked;
+	volatile int		m_nFailSlot;		// һʧܵݴ
+};
+
+// صмͼ,¼ض֡
+struct ReadbackTestContext
+{
+	CRITICAL_SECTION	cs;
+	vector<int>			vecFrame;		// ص˳¼֡
+	vector<void *>		vecTag;
+	int					nWrongContent;	// ֡ŲĴ
+	int					nFailed;		// pBitsΪNULLĻص
+	int					nLastWidth;
+	HANDLE				hEventBlock;	// ΪNULLʱصȴ¼,ģض̸߳
+	vector<BYTE>		vecYUV;
+};
+
+static void InitContext(ReadbackTestContext &Context)
+{
+	InitializeCriticalSection(&Context.cs);
+	Context.nWrongContent = 0;
+	Context.nFailed = 0;
+	Context.nLastWidth = 0;
+	Context.hEventBlock = NULL;
+}
+
+static void CALLBACK OnTestReadback(const ReadbackImage &Image, void *pUserPtr)
+{
+	ReadbackTestContext *pContext = (ReadbackTestContext *)pUserPtr;
+	if (pContext->hEventBlock)
+		WaitForSingleObject(pContext->hEventBlock, INFINITE);
+	CAutoLock lock(&pContext->cs);
+	pContext->vecTag.push_back(Image.pTag);
+	if (!Image.pBits)
+	{
+		pContext->nFailed++;
+		return;
+	}
+	int nFrame = ImageFrame(Image);
+	pContext->vecFrame.push_back(nFrame);
+	pContext->nLastWidth = Image.nWidth;
+	if (nFrame != (int)Image.nPts)
+		pContext->nWrongContent++;
+	// תΪYUV420PYUVƽ
+	int nPitch[3] = { Image.nWidth, Image.nWidth / 2, Image.nWidth / 2 };
+	pContext->vecYUV.resize(Image.nWidth * Image.nHeight * 3 / 2);
+	BYTE *pDst[3] = { &pContext->vecYUV[0], &pContext->vecYUV[Image.nWidth * Image.nHeight], &pContext->vecYUV[Image.nWidth * Image.nHeight * 5 / 4] };
+	CopyReadbackImage(pDst, nPitch, Image);
+	int nLast = Image.nWidth * (Image.nHeight - 1) + Image.nWidth - 1;
+	if (pDst[0][nLast] != (BYTE)(nFrame & 0xFF) || pDst[1][0] != 0x40 || pDst[2][0] != 0xC0)
+		pContext->nWrongContent++;
+}
+
+TEST_CASE(ReadbackRing, DeliverInOrder)
+{
+	CMockReadbackStaging Staging(1000000);
+	ReadbackTestContext Context;
+	InitContext(Context);
+	MockSourceSurface Source;
+	InitSource(Source, 320, 240);
+	CReadbackRing *pRing = new CReadbackRing();
+	TEST_CHECK(pRing->Create(&Staging, 6, 2, INFINITE, OnTestReadback, &Context));
+	const int nFrames = 200;
+	int nAccepted = 0;
+	for (int i = 0; i < nFrames; i++)
+	{
+		// ڸύԴ,ضύʱ
+		DecodeSource(Source, i);
+		if (pRing->Submit(&Source, Source.nWidth, Source.nHeight, i))
+			nAccepted++;
+		DecodeSource(Source, -1);
+	}
+	pRing->Flush();
+	ReadbackStat Stat;
+	pRing->GetStat(Stat);
+	TEST_EQUAL(Stat.nSubmitted, nFrames);
+	TEST_EQUAL(Stat.nDelivered, nAccepted);
+	TEST_EQUAL(Stat.nDelivered + Stat.nDropped, nFrames);
+	TEST_EQUAL((int)Context.vecFrame.size(), nAccepted);
+	TEST_EQUAL(Context.nWrongContent, 0);
+	for (size_t i = 1; i < Context.vecFrame.size(); i++)
+		TEST_CHECK(Context.vecFrame[i] > Context.vecFrame[i - 1]);
+	TEST_EQUAL(Staging.m_nCreates, 1);
+	// ض߳˳ʱ¼CPUʱ,صеĸ
+	pRing->Destroy();
+	pRing->GetStat(Stat);
+	TEST_CHECK(Stat.dfThreadCpuTime > 0);
+	delete pRing;
+	DeleteCriticalSection(&Context.cs);
+}
+
+// ύ3,GPUƺʱ5:ӳ2֡ضʱ,ض̴߳ӲȴGPU
+TEST_CASE(ReadbackRing, LatencyHidesGpuCopy)
+{
+	CMockReadbackStaging Staging(5 * MONO_NS_PER_MS);
+	ReadbackTestContext Context;
+	InitContext(Context);
+	MockSourceSurface Source;
+	InitSource(Source, 64, 64);
+	CReadbackRing Ring;
+	TEST_CHECK(Ring.Create(&Staging, 5, 2, INFINITE, OnTestReadback, &Context));
+	for (int i = 0; i < 40; i++)
+	{
+		DecodeSource(Source, i);
+		TEST_CHECK(Ring.Submit(&Source, Source.nWidth, Source.nHeight, i));
+		Sleep(3);
+	}
+	Ring.Destroy();
+	TEST_EQUAL((int)Context.vecFrame.size(), 40);
+	TEST_EQUAL(Context.nWrongContent, 0);
+	// ֻDestroyʱύ֡δɸ
+	TEST_CHECK(Staging.m_nStalls <= 2);
+	DeleteCriticalSection(&Context.cs);
+}
+
+// ͼǵύȲ֡,ӳٺɻض߳лض
+TEST_CASE(ReadbackRing, SparseSubmitExpires)
+{
+	CMockReadbackStaging Staging(0);
+	ReadbackTestContext Context;
+	InitContext(Context);
+	MockSourceSurface Source;
+	InitSource(Source, 64, 64);
+	CReadbackRing Ring;
+	TEST_CHECK(Ring.Create(&Staging, 4, 2, 10, OnTestReadback, &Context));
+	for (int i = 0; i < 3; i++)
+	{
+		DecodeSource(Source, i);
+		int64_t nT1 = MonoTimeNs();
+		TEST_CHECK(Ring.Submit(&Source, Source.nWidth, Source.nHeight, i));
+		bool bDelivered = false;
+		while (!bDelivered && MonoTimeNs() - nT1 < 2000 * MONO_NS_PER_MS)
+		{
+			Sleep(1);
+			CAutoLock lock(&Context.cs);
+			bDelivered = ((int)Context.vecFrame.size() == i + 1);
+		}
+		TEST_CHECK(bDelivered);
+		TEST_CHECK(MonoTimeNs() - nT1 >= 10 * MONO_NS_PER_MS);
+	}
+	ReadbackStat Stat;
+	Ring.GetStat(Stat);
+	TEST_EQUAL(Stat.nExpired, 3);
+	TEST_EQUAL(Context.nWrongContent, 0);
+	Ring.Destroy();
+	DeleteCriticalSection(&Context.cs);
+}
+
+// ض̸߳ʱύ֡,ѽܵ֡ȫض
+TEST_CASE(ReadbackRing, DropWhenFull)
+{
+	CMockReadbackStaging Staging(0);
+	ReadbackTestContext Context;
+	InitContext(Context);
+	Context.hEventBlock = CreateEvent(NULL, TRUE, FALSE, NULL);
+	MockSourceSurface Source;
+	InitSource(Source, 64, 64);
+	CReadbackRing Ring;
+	TEST_CHECK(Ring.Create(&Staging, 4, 1, INFINITE, OnTestReadback, &Context));
+	int nAccepted = 0;
+	for (int i = 0; i < 10; i++)
+	{
+		DecodeSource(Source, i);
+		if (Ring.Submit(&Source, Source.nWidth, Source.nHeight, i))
+			nAccepted++;
+	}
+	// 4ݴȫռúٽ
+	TEST_EQUAL(nAccepted, 4);
+	SetEvent(Context.hEventBlock);
+	Ring.Flush();
+	ReadbackStat Stat;
+	Ring.GetStat(Stat);
+	TEST_EQUAL(Stat.nDropped, 6);
+	TEST_EQUAL(Stat.nDelivered, 4);
+	TEST_EQUAL((int)Context.vecFrame.size(), 4);
+	TEST_EQUAL(Context.vecFrame[3], 3);
+	// ضɺԼύ
+	DecodeSource(Source, 10);
+	TEST_CHECK(Ring.Submit(&Source, Source.nWidth, Source.nHeight, 10));
+	Ring.Destroy();
+	TEST_EQUAL((int)Context.vecFrame.size(), 5);
+	CloseHandle(Context.hEventBlock);
+	DeleteCriticalSection(&Context.cs);
+}
+
+// Դߴ仯ʱȻضύ֡,ؽݴ
+TEST_CASE(ReadbackRing, ResizeRecreatesStaging)
+{
+	CMockReadbackStaging Staging(0);
+	ReadbackTestContext Context;
+	InitContext(Context);
+	MockSourceSurface Small, Large;
+	InitSource(Small, 64, 48);
+	InitSource(Large, 128, 96);
+	CReadbackRing Ring;
+	TEST_CHECK(Ring.Create(&Staging, 4, 2, INFINITE, OnTestReadback, &Context));
+	DecodeSource(Small, 0);
+	TEST_CHECK(Ring.Submit(&Small, Small.nWidth, Small.nHeight, 0));
+	DecodeSource(Small, 1);
+	TEST_CHECK(Ring.Submit(&Small, Small.nWidth, Small.nHeight, 1));
+	DecodeSource(Large, 2);
+	TEST_CHECK(Ring.Submit(&Large, Large.nWidth, Large.nHeight, 2));
+	{
+		CAutoLock lock(&Context.cs);
+		TEST_EQUAL((int)Context.vecFrame.size(), 2);
+	}
+	Ring.Flush();
+	TEST_EQUAL((int)Context.vecFrame.size(), 3);
+	TEST_EQUAL(Context.nLastWidth, 128);
+	TEST_EQUAL(Staging.m_nCreates, 2);
+	TEST_EQUAL(Context.nWrongContent, 0);
+	Ring.Destroy();
+	DeleteCriticalSection(&Context.cs);
+}
+
+// ʧʱȻص,pBitsΪNULL,߿ͷ֡صԴ
+TEST_CASE(ReadbackRing, LockFailureStillCallsBack)
+{
+	CMockReadbackStaging Staging(0);
+	ReadbackTestContext Context;
+	InitContext(Context);
+	MockSourceSurface Source;
+	InitSource(Source, 64, 64);
+	CReadbackRing Ring;
+	TEST_CHECK(Ring.Create(&Staging, 4, 1, INFINITE, OnTestReadback, &Context));
+	Staging.m_nFailSlot = 1;
+	for (int i = 0; i < 3; i++)
+	{
+		DecodeSource(Source, i);
+		TEST_CHECK(Ring.Submit(&Source, Source.nWidth, Source.nHeight, i, (void *)(ULONG_PTR)(i + 1)));
+	}
+	Ring.Flush();
+	ReadbackStat Stat;
+	Ring.GetStat(Stat);
+	TEST_EQUAL(Stat.nFailed, 1);
+	TEST_EQUAL(Stat.nDelivered, 2);
+	TEST_EQUAL(Context.nFailed, 1);
+	TEST_EQUAL((int)Context.vecTag.size(), 3);
+	TEST_CHECK(Context.vecTag[1] == (void *)2);
+	Ring.Destroy();
+	DeleteCriticalSection(&Context.cs);
+}
+
+struct SubmitThreadContext
+{
+	CReadbackRing		*pRing;
+	volatile LONG		bStart;
+	volatile LONG		nThreadIndex;
+	volatile LONG		nAccepted;
+};
+
+#define SUBMIT_THREADS		4
+#define SUBMIT_PER_THREAD	300
+
+// ͼĶȾ߳ͬʱύ,ÿ߳ԼԴ
+static unsigned __stdcall SubmitThread(void *p)
+{
+	SubmitThreadContext *pContext = (SubmitThreadContext *)p;
+	int nThread = InterlockedIncrement(&pContext->nThreadIndex) - 1;
+	MockSourceSurface Source;
+	InitSource(Source, 64, 64);
+	while (!pContext->bStart)
+		SwitchToThread();
+	for (int i = 0; i < SUBMIT_PER_THREAD; i++)
+	{
+		int nFrame = nThread * SUBMIT_PER_THREAD + i;
+		DecodeSource(Source, nFrame);
+		if (pContext->pRing->Submit(&Source, Source.nWidth, Source.nHeight, nFrame, (void *)(ULONG_PTR)(nFrame + 1)))
+			InterlockedIncrement(&pContext->nAccepted);
+		if (i % 8 == 0)
+			SwitchToThread();
+	}
+	return 0;
+}
+
+TEST_CASE(ReadbackRing, ConcurrentSubmit)
+{
+	CMockReadbackStaging Staging(200000);
+	ReadbackTestContext Context;
+	InitContext(Context);
+	CReadbackRing Ring;
+	TEST_CHECK(Ring.Create(&Staging, 8, 2, 5, OnTestReadback, &Context));
+	SubmitThreadContext SubmitContext = { &Ring, FALSE, 0, 0 };
+	HANDLE hThreads[SUBMIT_THREADS];
+	for (int i = 0; i < SUBMIT_THREADS; i++)
+		hThreads[i] = (HANDLE)_beginthreadex(NULL, 0, SubmitThread, &SubmitContext, 0, NULL);
+	InterlockedExchange(&SubmitContext.bStart, TRUE);
+	WaitForMultipleObjects(SUBMIT_THREADS, hThreads, TRUE, INFINITE);
+	for (int i = 0; i < SUBMIT_THREADS; i++)
+		CloseHandle(hThreads[i]);
+	Ring.Flush();
+	ReadbackStat Stat;
+	Ring.GetStat(Stat);
+	TEST_EQUAL(Stat.nSubmitted, SUBMIT_THREADS * SUBMIT_PER_THREAD);
+	TEST_EQUAL(Stat.nDelivered, SubmitContext.nAccepted);
+	TEST_EQUAL(Stat.nDelivered + Stat.nDropped, SUBMIT_THREADS * SUBMIT_PER_THREAD);
+	TEST_EQUAL(Context.nWrongContent, 0);
+	// ÿܵ֡ǡûصһ,pTag֡һ
+	std::set<int> setFrame(Context.vecFrame.begin(), Context.vecFrame.end());
+	TEST_EQUAL(setFrame.size(), Context.vecFrame.size());
+	for (size_t i = 0; i < Context.vecFrame.size(); i++)
+		TEST_CHECK(Context.vecTag[i] == (void *)(ULONG_PTR)(Context.vecFrame[i] + 1));
+	printf("  accepted = %d of %d, stalls = %d\n", (int)SubmitContext.nAccepted, SUBMIT_THREADS * SUBMIT_PER_THREAD, (int)Staging.m_nStalls);
+	Ring.Destroy();
+	DeleteCriticalSection(&Context.cs);
+}
+
+struct AnalyticsTestContext
+{
+	volatile LONG		nCalls;
+	volatile LONG		nWrongContent;
+	volatile LONG		nLastFrame;
+};
+
+static void CALLBACK OnTestAnalytics(const ReadbackImage &Image, void *pUserPtr)
+{
+	AnalyticsTestContext *pContext = (AnalyticsTestContext *)pUserPtr;
+	InterlockedIncrement(&pContext->nCalls);
+	// ģֱӶȡݴеYƽ
+	if (ImageFrame(Image) != (int)Image.nPts)
+		InterlockedIncrement(&pContext->nWrongContent);
+	InterlockedExchange(&pContext->nLastFrame, (LONG)Image.nPts);
+}
+
+// ҹÿύnInterval֡ȡһ֡,߳IsAnalyticsDueֻΪύҪ֡
+TEST_CASE(ReadbackRing, AnalyticsHook)
+{
+	CMockReadbackStaging Staging(0);
+	ReadbackTestContext Context;
+	InitContext(Context);
+	AnalyticsTestContext Analytics = { 0, 0, -1 };
+	MockSourceSurface Source;
+	InitSource(Source, 64, 64);
+	CReadbackRing Ring;
+	TEST_CHECK(Ring.Create(&Staging, 4, 1, INFINITE, OnTestReadback, &Context));
+	TEST_CHECK(!CReadbackRing::HasAnalyticsHook());
+	TEST_CHECK(!Ring.IsAnalyticsDue());
+	CReadbackRing::SetAnalyticsHook(OnTestAnalytics, &Analytics, 4);
+	TEST_CHECK(CReadbackRing::HasAnalyticsHook());
+	int nDue = 0;
+	for (int i = 0; i < 40; i++)
+	{
+		if (Ring.IsAnalyticsDue())
+		{
+			nDue++;
+			TEST_EQUAL(i % 4, 3);
+		}
+		DecodeSource(Source, i);
+		TEST_CHECK(Ring.Submit(&Source, Source.nWidth, Source.nHeight, i));
+		Ring.Flush();
+	}
+	TEST_EQUAL(nDue, 10);
+	TEST_EQUAL(Analytics.nCalls, 10);
+	TEST_EQUAL(Analytics.nWrongContent, 0);
+	TEST_EQUAL(Analytics.nLastFrame, 39);
+	// ȡٵ
+	CReadbackRing::SetAnalyticsHook(NULL, NULL, 0);
+	TEST_CHECK(!CReadbackRing::HasAnalyticsHook());
+	for (int i = 40; i < 48; i++)
+	{
+		DecodeSource(Source, i);
+		TEST_CHECK(Ring.Submit(&Source, Source.nWidth, Source.nHeight, i));
+		Ring.Flush();
+	}
+	Ring.Destroy();
+	TEST_EQUAL(Analytics.nCalls, 10);
+	TEST_EQUAL((int)Context.vecFrame.size(), 48);
+	DeleteCriticalSection(&Context.cs);
+}
@@ -0,0 +1,124 @@
+// CRecordIndexĲԺܲ
+// ļĽͰͨʱ¼ļ,ܲ԰ÿ·ÿ10һļ10ļ,
+// ӡһβѯʱԼѯĺʱ;ʴ,ɨĺʱBuild
+#include "TestFramework.h"
+#include "RecordIndex.h"
+#include "TimeUtility.h"
+#include <time.h>
+
+#define RECORD_TEST_BASE_TIME	((int64_t)1449741361)	// 2015-12-10 09:56:01
+
+// ¼ļļ,nTimeΪ1970
+static void MakeRecordName(TCHAR *szName, int nSize, int nChannel, int64_t nTime)
+{
+	time_t tTime = (time_t)nTime;
+	tm TM = *gmtime(&tTime);
+	_stprintf_s(szName, nSize, _T("D:\\DVORecord\\CH%02d_192.168.24.211_ch%02d_%04d%02d%02d_%02d%02d%02d_H.264.mp4"),
+				nChannel, nChannel, TM.tm_year + 1900, TM.tm_mon + 1, TM.tm_mday, TM.tm_hour, TM.tm_min, TM.tm_sec);
+}
+
+TEST_CASE(RecordIndex, ParseFileName)
+{
+	int nChannel = -1;
+	int64_t nStartTime = 0;
+	TEST_CHECK(CRecordIndex::ParseFileName(_T("D:\\DVORecord\\CH00_192.168.24.211_ch00_20151210_095601_H.264.mp4"), nChannel, nStartTime));
+	TEST_EQUAL(nChannel, 0);
+	TEST_EQUAL(nStartTime, RECORD_TEST_BASE_TIME * 1000000);
+	TEST_CHECK(CRecordIndex::ParseFileName(_T("D:/DVORecord/2015/ch12_20160229_235959.mkv"), nChannel, nStartTime));
+	TEST_EQUAL(nChannel, 12);
+	UINT64 nTime = 0;
+	TEST_CHECK(FastDateTime2UTC(_T("2016-02-29 23:59:59"), 19, nTime));
+	TEST_EQUAL(nStartTime, (int64_t)nTime * 1000000);
+	// CHͷЧʱ֮֡ͨŹļ
+	TEST_CHECK(!CRecordIndex::ParseFileName(_T("D:\\DVORecord\\Record00_20151210_095601.mp4"), nChannel, nStartTime));
+	TEST_CHECK(!CRecordIndex::ParseFileName(_T("CH01_20151310_095601.mp4"), nChannel, nStartTime));
+	TEST_CHECK(!CRecordIndex::ParseFileName(_T("CH01_20150229_095601.mp4"), nChannel, nStartTime));
+	TEST_CHECK(!CRecordIndex::ParseFileName(_T("CH01_20151210_0956012.mp4"), nChannel, nStartTime));
+	TEST_CHECK(!CRecordIndex::ParseFileName(_T("CH2048_20151210_095601.mp4"), nChannel, nStartTime));
+	TEST_CHECK(!CRecordIndex::ParseFileName(_T("D:\\CH01_20151210_095601\\Record.mp4"), nChannel, nStartTime));
+	TEST_CHECK(!CRecordIndex::ParseFileName(NULL, nChannel, nStartTime));
+}
+
+TEST_CASE(RecordIndex, ResolveAcrossFiles)
+{
+	CRecordIndex Index;
+	TCHAR szName[MAX_PATH] = { 0 };
+	// ͨ33ļ,ÿļ10
+	const int nOrder[3] = { 2, 0, 1 };
+	for (int i = 0; i < 3; i++)
+	{
+		MakeRecordName(szName, MAX_PATH, 3, RECORD_TEST_BASE_TIME + nOrder[i] * 600);
+		TEST_CHECK(Index.AddFile(szName));
+	}
+	TEST_CHECK(!Index.AddFile(_T("D:\\DVORecord\\Readme.txt")));
+	TEST_EQUAL(Index.GetFileCount(), 3);
+	TEST_EQUAL(Index.GetChannelCount(), 4);
+
+	RecordPosition Pos;
+	int64_t nBase = RECORD_TEST_BASE_TIME * 1000000;
+	// һļʼ֮ǰû¼
+	TEST_CHECK(!Index.Resolve(3, nBase - 1, Pos, false));
+	TEST_CHECK(Index.Resolve(3, nBase, Pos, false));
+	TEST_EQUAL(Pos.nFileStartTime, nBase);
+	TEST_EQUAL(Pos.nOffset, 0);
+	TEST_CHECK(Index.Resolve(3, nBase + 650 * 1000000LL, Pos, false));
+	MakeRecordName(szName, MAX_PATH, 3, RECORD_TEST_BASE_TIME + 600);
+	TEST_CHECK(_tcscmp(Pos.szPath, szName) == 0);
+	TEST_EQUAL(Pos.nOffset, 50 * 1000000LL);
+	TEST_EQUAL(Pos.nKeyFrameOffset, 0);
+	TEST_EQUAL(Pos.nKeyFramePos, -1);
+	// ļʱδ֪ʱ,һļ֮ʱ䶼ڸļ
+	TEST_CHECK(Index.Resolve(3, nBase + 3600 * 1000000LL, Pos, false));
+	TEST_EQUAL(Pos.nFileStartTime, nBase + 1200 * 1000000LL);
+	// û¼ͨ
+	TEST_CHECK(!Index.Resolve(0, nBase, Pos, false));
+	TEST_CHECK(!Index.Resolve(4, nBase, Pos, false));
+	TEST_CHECK(!Index.Resolve(-1, nBase, Pos, false));
+	// ӵļ´βѯʱ
+	MakeRecordName(szName, MAX_PATH, 3, RECORD_TEST_BASE_TIME - 600);
+	TEST_CHECK(Index.AddFile(szName));
+	TEST_CHECK(Index.Resolve(3, nBase - 1, Pos, false));
+	TEST_EQUAL(Pos.nOffset, 600 * 1000000LL - 1);
+	Index.Clear();
+	TEST_EQUAL(Index.GetFileCount(), 0);
+	TEST_CHECK(!Index.Resolve(3, nBase, Pos, false));
+}
+
+// 16·,ÿ·ÿ10һļ,10ļ,Լ16·¼43
+BENCHMARK(RecordIndex, Index100kFiles)
+{
+	const int nFiles = 100000;
+	const int nChannels = 16;
+	const int nFileSpan = 600;
+	vector<basic_string<TCHAR> > vecName(nFiles);
+	TCHAR szName[MAX_PATH] = { 0 };
+	for (int i = 0; i < nFiles; i++)
+	{
+		MakeRecordName(szName, MAX_PATH, i % nChannels, RECORD_TEST_BASE_TIME + (int64_t)(i / nChannels) * nFileSpan);
+		vecName[i] = szName;
+	}
+	CRecordIndex Index;
+	int64_t nT1 = TestNowNs();
+	for (int i = 0; i < nFiles; i++)
+		Index.AddFile(vecName[i].c_str());
+	int64_t nT2 = TestNowNs();
+	RecordPosition Pos;
+	// һβѯʱ
+	Index.Resolve(0, RECORD_TEST_BASE_TIME * 1000000, Pos, false);
+	int64_t nT3 = TestNowNs();
+	int nResolved = 0;
+	for (int i = 0; i < nFiles; i++)
+	{// ˷ɢе˳ѯ,ڵļ
+		int nIndex = (int)(((UINT64)i * 2654435761u) % nFiles);
+		int64_t nTime = (RECORD_TEST_BASE_TIME + (int64_t)(nIndex / nChannels) * nFileSpan + nFileSpan / 2) * 1000000;
+		if (Index.Resolve(nIndex % nChannels, nTime, Pos, false) && Pos.nOffset == nFileSpan / 2 * 1000000LL)
+			nResolved++;
+	}
+	int64_t nT4 = TestNowNs();
+	TEST_EQUAL(Index.GetFileCount(), nFiles);
+	TEST_EQUAL(nResolved, nFiles);
+	printf("  %-44s %12.1f ns/op\n", "100k files, parse + add", (double)(nT2 - nT1) / nFiles);
+	printf("  %-44s %12.1f ms\n", "100k files, sort on first query", (double)(nT3 - nT2) / 1e6);
+	printf("  %-44s %12.1f ns/op\n", "100k files, resolve", (double)(nT4 - nT3) / nFiles);
+	fflush(stdout);
+}
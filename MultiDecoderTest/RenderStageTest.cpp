@@ -0,0 +1,378 @@
+// CFrameMailboxCRenderStageĲ,ȾΪںԿĿȾ
+// ÿ֡ĻͷŻص,ͳȻ֡,Ⱦ߳ûжлǰͷ֡
+// ǰ8ֽΪ֡ʱ,ȾʱرȽ,ԷȾѱͷŻ򸲸ǵ֡
+#include "TestFramework.h"
+#include "RenderStage.h"
+#include <vector>
+
+#define TEST_FRAME_BYTES	64
+
+static volatile LONG s_nLiveFrames = 0;
+
+static void FreeTestFrame(void *opaque, uint8_t *data)
+{
+	memset(data, 0xCC, TEST_FRAME_BYTES);
+	av_free(data);
+	InterlockedDecrement(&s_nLiveFrames);
+}
+
+// ģһ֡,av_frame_freeͷԼ
+static AVFrame *MakeTestFrame(int64_t nPts)
+{
+	AVFrame *pFrame = av_frame_alloc();
+	uint8_t *pData = (uint8_t *)av_malloc(TEST_FRAME_BYTES);
+	memcpy(pData, &nPts, sizeof(int64_t));
+	pFrame->buf[0] = av_buffer_create(pData, TEST_FRAME_BYTES, FreeTestFrame, NULL, 0);
+	pFrame->data[0] = pData;
+	pFrame->linesize[0] = TEST_FRAME_BYTES;
+	pFrame->width = 8;
+	pFrame->height = 8;
+	pFrame->pts = nPts;
+	pFrame->pkt_pts = nPts;
+	InterlockedIncrement(&s_nLiveFrames);
+	return pFrame;
+}
+
+static bool IsFrameIntact(AVFrame *pFrame)
+{
+	int64_t nPts = 0;
+	memcpy(&nPts, pFrame->data[0], sizeof(int64_t));
+	return nPts == pFrame->pkt_pts;
+}
+
+TEST_CASE(FrameMailbox, LatestFrameWins)
+{
+	CFrameMailbox *pMailbox = new CFrameMailbox;
+	TEST_CHECK(pMailbox->Fetch() == NULL);
+	for (int i = 0; i < 3; i++)
+	{
+		AVFrame *pFrame = MakeTestFrame(i);
+		pMailbox->Post(pFrame, 100 + i);
+		av_frame_free(&pFrame);
+	}
+	// ǵ֡ͷ,ֻʣµһ֡
+	TEST_EQUAL(s_nLiveFrames, 1);
+	int64_t nPostTime = 0;
+	AVFrame *pFrame = pMailbox->Fetch(&nPostTime);
+	TEST_CHECK(pFrame != NULL);
+	TEST_EQUAL(pFrame->pkt_pts, 2);
+	TEST_EQUAL(nPostTime, 102);
+	TEST_CHECK(IsFrameIntact(pFrame));
+	TEST_CHECK(pMailbox->Fetch() == NULL);
+	// ȡߵ֡´ȡ֮֡ǰЧ
+	AVFrame *pNext = MakeTestFrame(3);
+	pMailbox->Post(pNext, 103);
+	av_frame_free(&pNext);
+	TEST_EQUAL(s_nLiveFrames, 2);
+	TEST_CHECK(IsFrameIntact(pFrame));
+	TEST_EQUAL(pMailbox->Fetch()->pkt_pts, 3);
+	MailboxStat Stat;
+	pMailbox->GetStat(Stat);
+	TEST_EQUAL(Stat.nPosted, 4);
+	TEST_EQUAL(Stat.nFetched, 2);
+	TEST_EQUAL(Stat.nDropped, 2);
+	TEST_EQUAL(Stat.nRepeated, 2);
+	pMailbox->Clear();
+	TEST_EQUAL(s_nLiveFrames, 0);
+	TEST_CHECK(pMailbox->Fetch() == NULL);
+	delete pMailbox;
+}
+
+struct MailboxThreadContext
+{
+	CFrameMailbox	*pMailbox;
+	int				nFrames;
+	volatile LONG	nMaxLive;
+};
+
+static unsigned __stdcall MailboxProducer(void *p)
+{
+	MailboxThreadContext *pContext = (MailboxThreadContext *)p;
+	for (int i = 0; i < pContext->nFrames; i++)
+	{
+		AVFrame *pFrame = MakeTestFrame(i);
+		pContext->pMailbox->Post(pFrame);
+		av_frame_free(&pFrame);
+		LONG nLive = s_nLiveFrames;
+		if (nLive > pContext->nMaxLive)
+			pContext->nMaxLive = nLive;
+		if (i % 64 == 0)
+			SwitchToThread();
+	}
+	return 0;
+}
+
+// ߺͬʱ,ȡ֡ʱϸ,,ÿ֡ҪôȡҪô
+TEST_CASE(FrameMailbox, ConcurrentPostFetch)
+{
+	CFrameMailbox Mailbox;
+	MailboxThreadContext Context = { &Mailbox, 50000, 0 };
+	HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, MailboxProducer, &Context, 0, NULL);
+	int64_t nLastPts = -1;
+	int nFetched = 0, nOutOfOrder = 0, nBroken = 0;
+	while (nLastPts < Context.nFrames - 1)
+	{
+		AVFrame *pFrame = Mailbox.Fetch();
+		if (!pFrame)
+		{
+			YieldProcessor();
+			continue;
+		}
+		if (pFrame->pkt_pts <= nLastPts)
+			nOutOfOrder++;
+		if (!IsFrameIntact(pFrame))
+			nBroken++;
+		nLastPts = pFrame->pkt_pts;
+		nFetched++;
+	}
+	WaitForSingleObject(hThread, INFINITE);
+	CloseHandle(hThread);
+	TEST_EQUAL(nOutOfOrder, 0);
+	TEST_EQUAL(nBroken, 0);
+	MailboxStat Stat;
+	Mailbox.GetStat(Stat);
+	TEST_EQUAL(Stat.nPosted, Context.nFrames);
+	TEST_EQUAL(Stat.nFetched, nFetched);
+	TEST_EQUAL(Stat.nFetched + Stat.nDropped, Context.nFrames);
+	// ֡,Ͷݵһ֡
+	TEST_CHECK(Context.nMaxLive <= 4);
+	Mailbox.Clear();
+	TEST_EQUAL(s_nLiveFrames, 0);
+}
+
+/// @brief Ⱦ,ں豸
+/// @remark Ⱦʱ֡ݲ¼ʱ,ÿ֡Ⱦʱ,ģPresentĵȴ
+class CNullRenderSurface : public IRenderSurface
+{
+public:
+	CNullRenderSurface()
+	{
+		m_bInited = false;
+		m_nRenderNs = 0;
+		m_nBroken = 0;
+		m_nLastPts = -1;
+		m_nRenderThread = 0;
+		InitializeCriticalSection(&m_cs);
+	}
+	~CNullRenderSurface()
+	{
+		DeleteCriticalSection(&m_cs);
+	}
+	virtual bool InitD3D(HWND hWnd, int nVideoWidth, int nVideoHeight, BOOL bIsWindowed, D3DFORMAT nD3DFormat)
+	{
+		m_bInited = true;
+		return true;
+	}
+	virtual bool InitD3DShared(HWND hWnd, IDirect3DDevice9 *pDevice, int nVideoWidth, int nVideoHeight, D3DFORMAT nD3DFormat)
+	{
+		return false;
+	}
+	virtual void DetachSharedDevice()
+	{
+	}
+	virtual bool IsInited()
+	{
+		return m_bInited;
+	}
+	virtual bool Render(AVFrame *pAvFrame, HWND hWnd, RECT *pRenderRt)
+	{
+		if (m_nRenderNs)
+			MonoSleepNs(m_nRenderNs);
+		CAutoLock lock(&m_cs);
+		if (!IsFrameIntact(pAvFrame))
+			m_nBroken++;
+		m_vecPts.push_back(pAvFrame->pkt_pts);
+		m_nLastPts = pAvFrame->pkt_pts;
+		m_nRenderThread = GetCurrentThreadId();
+		return true;
+	}
+	virtual bool HandelDevLost()
+	{
+		return true;
+	}
+	virtual void DxCleanup()
+	{
+		m_bInited = false;
+	}
+	int64_t GetLastPts()
+	{
+		CAutoLock lock(&m_cs);
+		return m_nLastPts;
+	}
+
+	volatile bool		m_bInited;
+	int64_t				m_nRenderNs;
+	int					m_nBroken;
+	int64_t				m_nLastPts;
+	DWORD				m_nRenderThread;
+	vector<int64_t>		m_vecPts;
+	CRITICAL_SECTION	m_cs;
+};
+
+struct RenderInitContext
+{
+	volatile LONG	nCalls;
+	DWORD			dwThreadId;
+};
+
+// һγʼʧ,֮Ⱦ߳гʼ
+static bool CALLBACK InitNullSurface(IRenderSurface *pDxSurface, AVFrame *pFirstFrame, void *pUserPtr)
+{
+	RenderInitContext *pContext = (RenderInitContext *)pUserPtr;
+	pContext->dwThreadId = GetCurrentThreadId();
+	if (pContext->nCalls++ == 0)
+		return false;
+	return pDxSurface->InitD3D(NULL, pFirstFrame->width, pFirstFrame->height);
+}
+
+static bool WaitLastPts(CNullRenderSurface &Surface, int64_t nPts, int nTimeoutMs)
+{
+	int64_t nDeadline = MonoTimeNs() + nTimeoutMs * MONO_NS_PER_MS;
+	while (Surface.GetLastPts() < nPts)
+	{
+		if (MonoTimeNs() > nDeadline)
+			return false;
+		Sleep(1);
+	}
+	return true;
+}
+
+// Ⱦڽʱÿ֡Ⱦ,ʼȾȾ߳
+TEST_CASE(RenderStage, RendersEveryFrameWhenFast)
+{
+	CNullRenderSurface Surface;
+	RenderInitContext InitContext = { 0, 0 };
+	CChannelLatency Latency;
+	Latency.Reset();
+	CRenderStage *pStage = new CRenderStage;
+	pStage->SetLatency(&Latency);
+	TEST_CHECK(pStage->Start(&Surface, InitNullSurface, &InitContext, 20));
+	const int nFrames = 60;
+	AVFrame *pFrame = MakeTestFrame(0);
+	pStage->Post(pFrame);
+	av_frame_free(&pFrame);
+	int64_t nDeadline = MonoTimeNs() + 2000 * MONO_NS_PER_MS;
+	while (!InitContext.nCalls && MonoTimeNs() < nDeadline)
+		Sleep(1);
+	// ÿ֡Ⱦ֮Ͷһ֡
+	for (int i = 1; i < nFrames; i++)
+	{
+		pFrame = MakeTestFrame(i);
+		pStage->Post(pFrame);
+		av_frame_free(&pFrame);
+		TEST_CHECK(WaitLastPts(Surface, i, 2000));
+	}
+	pStage->Stop();
+	RenderStageStat Stat;
+	pStage->GetStat(Stat);
+	TEST_EQUAL(Stat.nPosted, nFrames);
+	// һ֡ʼʧܶ,ÿ֡Ⱦ
+	TEST_EQUAL(InitContext.nCalls, 2);
+	TEST_EQUAL(Stat.nRenderFailed, 1);
+	TEST_EQUAL(Stat.nRendered, nFrames - 1);
+	TEST_EQUAL(Stat.nDropped, 0);
+	TEST_EQUAL(Surface.m_nBroken, 0);
+	TEST_CHECK(Surface.m_nRenderThread != GetCurrentThreadId());
+	TEST_EQUAL(InitContext.dwThreadId, Surface.m_nRenderThread);
+	TEST_EQUAL(Latency.GetHistogram(LatencyStage_QueueWait).GetCount(), nFrames);
+	TEST_EQUAL(s_nLiveFrames, 0);
+	delete pStage;
+}
+
+// Ⱦڽʱм֡,̵߳ͶݴӲȴȾ
+TEST_CASE(RenderStage, SlowRendererDropsWithoutBlocking)
+{
+	CNullRenderSurface Surface;
+	Surface.m_bInited = true;
+	Surface.m_nRenderNs = 10 * MONO_NS_PER_MS;
+	CRenderStage Stage;
+	TEST_CHECK(Stage.Start(&Surface, NULL, NULL, 20));
+	const int nFrames = 100;
+	int64_t nMaxPostNs = 0;
+	for (int i = 0; i < nFrames; i++)
+	{
+		AVFrame *pFrame = MakeTestFrame(i);
+		int64_t nT1 = MonoTimeNs();
+		Stage.Post(pFrame);
+		int64_t nPostNs = MonoTimeNs() - nT1;
+		if (nPostNs > nMaxPostNs)
+			nMaxPostNs = nPostNs;
+		av_frame_free(&pFrame);
+		// ֡
+		TEST_CHECK(s_nLiveFrames <= 3);
+		Sleep(1);
+	}
+	TEST_CHECK(WaitLastPts(Surface, nFrames - 1, 2000));
+	Stage.Stop();
+	RenderStageStat Stat;
+	Stage.GetStat(Stat);
+	TEST_EQUAL(Stat.nPosted, nFrames);
+	TEST_EQUAL(Stat.nRendered + Stat.nDropped, nFrames);
+	TEST_CHECK(Stat.nDropped > nFrames / 2);
+	TEST_CHECK(nMaxPostNs < Surface.m_nRenderNs);
+	// Ⱦ̴߳󲿷ʱڵȴ,CPUʱԶСȾۼƺʱ
+	TEST_CHECK(Stat.dfThreadCpuTime > 0);
+	TEST_CHECK(Stat.dfThreadCpuTime < Stat.dfRenderTime);
+	TEST_EQUAL(Surface.m_nBroken, 0);
+	for (size_t i = 1; i < Surface.m_vecPts.size(); i++)
+		TEST_CHECK(Surface.m_vecPts[i] > Surface.m_vecPts[i - 1]);
+	printf("  rendered = %d\tdropped = %d\tmax post = %.3f ms\n", (int)Stat.nRendered, (int)Stat.nDropped, MonoNsToMs(nMaxPostNs));
+	TEST_EQUAL(s_nLiveFrames, 0);
+}
+
+// û֡ʱÿʾڼһظ,Ļϱһ֡
+TEST_CASE(RenderStage, IdleCountsRepeats)
+{
+	CNullRenderSurface Surface;
+	Surface.m_bInited = true;
+	CRenderStage Stage;
+	TEST_CHECK(Stage.Start(&Surface, NULL, NULL, 5));
+	AVFrame *pFrame = MakeTestFrame(0);
+	Stage.Post(pFrame);
+	av_frame_free(&pFrame);
+	TEST_CHECK(WaitLastPts(Surface, 0, 2000));
+	Sleep(60);
+	RenderStageStat Stat;
+	Stage.GetStat(Stat);
+	TEST_EQUAL(Stat.nRendered, 1);
+	TEST_CHECK(Stat.nRepeated >= 5);
+	// ֱֵֹ֡ͣʱͷ
+	TEST_EQUAL(s_nLiveFrames, 1);
+	Stage.Stop();
+	TEST_EQUAL(s_nLiveFrames, 0);
+}
+
+// ֹͣʱȾ߳Ⱦ,лδȡߵ֡,ֹͣȫͷ;ֹͣͶݱ
+TEST_CASE(RenderStage, StopReleasesFrames)
+{
+	CNullRenderSurface Surface;
+	Surface.m_bInited = true;
+	Surface.m_nRenderNs = 20 * MONO_NS_PER_MS;
+	CRenderStage Stage;
+	TEST_CHECK(Stage.Start(&Surface, NULL, NULL, 20));
+	for (int i = 0; i < 10; i++)
+	{
+		AVFrame *pFrame = MakeTestFrame(i);
+		Stage.Post(pFrame);
+		av_frame_free(&pFrame);
+	}
+	Stage.Stop();
+	TEST_EQUAL(s_nLiveFrames, 0);
+	AVFrame *pFrame = MakeTestFrame(10);
+	Stage.Post(pFrame);
+	av_frame_free(&pFrame);
+	TEST_EQUAL(s_nLiveFrames, 0);
+	RenderStageStat Stat;
+	Stage.GetStat(Stat);
+	TEST_EQUAL(Stat.nPosted, 10);
+	// ٴ
+	TEST_CHECK(Stage.Start(&Surface, NULL, NULL, 20));
+	Surface.m_nRenderNs = 0;
+	pFrame = MakeTestFrame(11);
+	Stage.Post(pFrame);
+	av_frame_free(&pFrame);
+	TEST_CHECK(WaitLastPts(Surface, 11, 2000));
+	Stage.Stop();
+	TEST_EQUAL(s_nLiveFrames, 0);
+	TEST_EQUAL(Surface.m_nBroken, 0);
+}
@@ -0,0 +1,275 @@
+// CRenderThrottleĲԺܲ
+// ״̬ģIRenderWindowGeometryṩ,ʱɲָ,ϵͳʵʵ֡
+#include "TestFramework.h"
+#include "RenderThrottle.h"
+#include "MemorySurface.h"
+
+#define TEST_VIDEO_WIDTH	1920
+#define TEST_VIDEO_HEIGHT	1080
+#define TEST_FRAME_NS		(40 * MONO_NS_PER_MS)	// 25fps֡
+
+// ģĴ״̬,¼ѯ
+class CFakeWindowGeometry : public IRenderWindowGeometry
+{
+public:
+	CFakeWindowGeometry(int nWidth = 640, int nHeight = 360)
+		: m_bShown(true)
+		, m_bOccluded(false)
+		, m_nWidth(nWidth)
+		, m_nHeight(nHeight)
+		, m_nQueries(0)
+	{
+	}
+	virtual bool IsShown(HWND hWnd)
+	{
+		m_nQueries++;
+		return m_bShown;
+	}
+	virtual bool GetClientSize(HWND hWnd, int &nWidth, int &nHeight)
+	{
+		nWidth = m_nWidth;
+		nHeight = m_nHeight;
+		return true;
+	}
+	virtual bool IsOccluded(HWND hWnd)
+	{
+		return m_bOccluded;
+	}
+	bool	m_bShown;
+	bool	m_bOccluded;
+	int		m_nWidth;
+	int		m_nHeight;
+	int		m_nQueries;
+};
+
+static HWND TestWindow(int nIndex)
+{
+	return (HWND)(intptr_t)(0x1000 + nIndex);
+}
+
+// ȫΪ0Ϊʼ״̬,CDxSurfaceThreadParamе÷ͬ
+static void InitThrottle(CRenderThrottle &Throttle, IRenderWindowGeometry *pGeometry)
+{
+	memset(&Throttle, 0, sizeof(CRenderThrottle));
+	Throttle.SetGeometry(pGeometry);
+}
+
+TEST_CASE(RenderThrottle, RateFromGeometry)
+{
+	CFakeWindowGeometry Geometry;
+	HWND hWnd = TestWindow(0);
+	TEST_EQUAL(CRenderThrottle::CheckWindow(&Geometry, hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT), RenderRate_Full);
+	TEST_EQUAL(CRenderThrottle::CheckWindow(&Geometry, NULL, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT), RenderRate_None);
+	// Ƶͻ_THROTTLE_SMALL_RATIOʱ֡
+	Geometry.m_nWidth = 320;
+	Geometry.m_nHeight = 180;
+	TEST_EQUAL(CRenderThrottle::CheckWindow(&Geometry, hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT), RenderRate_Reduced);
+	TEST_EQUAL(CRenderThrottle::CheckWindow(&Geometry, hWnd, 0, 0), RenderRate_Full);
+	TEST_EQUAL(CRenderThrottle::CheckWindow(&Geometry, hWnd, 640, 360), RenderRate_Full);
+	// СػڵĴڲʾ
+	Geometry.m_nHeight = _THROTTLE_MIN_SIZE - 1;
+	TEST_EQUAL(CRenderThrottle::CheckWindow(&Geometry, hWnd, 0, 0), RenderRate_None);
+	Geometry.m_nHeight = 180;
+	Geometry.m_bOccluded = true;
+	TEST_EQUAL(CRenderThrottle::CheckWindow(&Geometry, hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT), RenderRate_None);
+	Geometry.m_bOccluded = false;
+	Geometry.m_bShown = false;
+	TEST_EQUAL(CRenderThrottle::CheckWindow(&Geometry, hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT), RenderRate_None);
+}
+
+// ״̬ÿ_THROTTLE_CHECK_INTERVALֻѯһ,ʱ²ѯ
+TEST_CASE(RenderThrottle, CheckInterval)
+{
+	CFakeWindowGeometry Geometry;
+	CRenderThrottle Throttle;
+	InitThrottle(Throttle, &Geometry);
+	HWND hWnd = TestWindow(0);
+	int64_t nNow = 1000 * MONO_NS_PER_MS;
+	TEST_EQUAL(Throttle.Update(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, nNow), RenderRate_Full);
+	Geometry.m_bShown = false;
+	int64_t nNext = nNow + _THROTTLE_CHECK_INTERVAL * MONO_NS_PER_MS;
+	for (int64_t nTime = nNow; nTime < nNext; nTime += TEST_FRAME_NS)
+		TEST_EQUAL(Throttle.Update(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, nTime), RenderRate_Full);
+	TEST_EQUAL(Geometry.m_nQueries, 1);
+	TEST_EQUAL(Throttle.Update(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, nNext), RenderRate_None);
+	TEST_EQUAL(Throttle.GetRate(), RenderRate_None);
+	TEST_EQUAL(Geometry.m_nQueries, 2);
+	Geometry.m_bShown = true;
+	TEST_EQUAL(Throttle.Update(TestWindow(1), TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, nNext + 1), RenderRate_Full);
+	TEST_EQUAL(Geometry.m_nQueries, 3);
+}
+
+// 25fpsnFrames֡,ʾ֡
+static int FeedFrames(CRenderThrottle &Throttle, HWND hWnd, int64_t &nNow, int nFrames, bool bFullRate = false)
+{
+	int nRendered = 0;
+	for (int i = 0; i < nFrames; i++, nNow += TEST_FRAME_NS)
+		if (Throttle.ShouldRender(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, bFullRate, nNow))
+			nRendered++;
+	return nRendered;
+}
+
+TEST_CASE(RenderThrottle, EachRate)
+{
+	CFakeWindowGeometry Geometry;
+	CRenderThrottle Throttle;
+	InitThrottle(Throttle, &Geometry);
+	HWND hWnd = TestWindow(0);
+	int64_t nNow = MONO_NS_PER_SEC;
+	// ߴĴʾÿһ֡
+	TEST_EQUAL(FeedFrames(Throttle, hWnd, nNow, 50), 50);
+	// СĴÿ_THROTTLE_REDUCED_INTERVALʾһ֡,ķ֮һĶ,25fpsʱһ֡ʾһ֡
+	Geometry.m_nWidth = 160;
+	Geometry.m_nHeight = 90;
+	nNow += _THROTTLE_CHECK_INTERVAL * MONO_NS_PER_MS;
+	TEST_EQUAL(Throttle.Update(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, nNow), RenderRate_Reduced);
+	TEST_EQUAL(FeedFrames(Throttle, hWnd, nNow, 50), 25);
+	// ѡеֻͨҪɼʾÿһ֡
+	TEST_EQUAL(FeedFrames(Throttle, hWnd, nNow, 50, true), 50);
+	// صĴڲʾ
+	Geometry.m_bShown = false;
+	nNow += _THROTTLE_CHECK_INTERVAL * MONO_NS_PER_MS;
+	TEST_EQUAL(FeedFrames(Throttle, hWnd, nNow, 50), 0);
+	TEST_EQUAL(FeedFrames(Throttle, hWnd, nNow, 50, true), 0);
+
+	RenderThrottleStat Stat;
+	Throttle.GetStat(Stat);
+	TEST_EQUAL(Stat.nRendered, 125);
+	TEST_EQUAL(Stat.nReduced, 25);
+	TEST_EQUAL(Stat.nHidden, 100);
+}
+
+// ֡ʱϴʾļС3/4_THROTTLE_REDUCED_INTERVALʾ
+TEST_CASE(RenderThrottle, ReducedJitter)
+{
+	CFakeWindowGeometry Geometry(160, 90);
+	CRenderThrottle Throttle;
+	InitThrottle(Throttle, &Geometry);
+	HWND hWnd = TestWindow(0);
+	const int64_t nInterval = _THROTTLE_REDUCED_INTERVAL * MONO_NS_PER_MS;
+	int64_t nNow = MONO_NS_PER_SEC;
+	TEST_CHECK(Throttle.ShouldRender(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, false, nNow));
+	TEST_CHECK(!Throttle.ShouldRender(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, false, nNow + nInterval * 3 / 4 - 1));
+	nNow += nInterval * 3 / 4;
+	TEST_CHECK(Throttle.ShouldRender(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, false, nNow));
+	// Ѱͬļ֡,֡ʱжʱٴ֡
+	CTestRandom Random;
+	for (int i = 0; i < 100; i++)
+	{
+		nNow += nInterval + (Random.Range(-20, 20) * MONO_NS_PER_MS);
+		TEST_CHECK(Throttle.ShouldRender(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, false, nNow));
+	}
+	RenderThrottleStat Stat;
+	Throttle.GetStat(Stat);
+	TEST_EQUAL(Stat.nReduced, 1);
+}
+
+// ߳(ThreadParam::Throttle)ڽ֮ǰ״̬֡ʽ,ǰҪʾ֡,
+// CDxSurface֡ΪԽ֡ʶٴα
+TEST_CASE(RenderThrottle, DecoderEarlyDrop)
+{
+	CFakeWindowGeometry Geometry;
+	CRenderThrottle Decoder, Surface;
+	InitThrottle(Decoder, &Geometry);
+	InitThrottle(Surface, &Geometry);
+	HWND hWnd = TestWindow(0);
+	int64_t nNow = MONO_NS_PER_SEC;
+	TEST_EQUAL(Decoder.AdjustDiscard(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, AVDISCARD_DEFAULT, nNow), AVDISCARD_DEFAULT);
+	TEST_EQUAL(Decoder.AdjustDiscard(NULL, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, AVDISCARD_DEFAULT, nNow), AVDISCARD_DEFAULT);
+	Geometry.m_bOccluded = true;
+	nNow += _THROTTLE_CHECK_INTERVAL * MONO_NS_PER_MS;
+	TEST_EQUAL(Decoder.AdjustDiscard(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, AVDISCARD_DEFAULT, nNow), AVDISCARD_NONREF);
+	// ؿҪ֡ʱֲ
+	TEST_EQUAL(Decoder.AdjustDiscard(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, AVDISCARD_NONKEY, nNow), AVDISCARD_NONKEY);
+	// СĴԽÿһ֡,ֻʾ֡
+	Geometry.m_bOccluded = false;
+	Geometry.m_nWidth = 160;
+	Geometry.m_nHeight = 90;
+	nNow += _THROTTLE_CHECK_INTERVAL * MONO_NS_PER_MS;
+	TEST_EQUAL(Decoder.AdjustDiscard(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, AVDISCARD_DEFAULT, nNow), AVDISCARD_DEFAULT);
+
+	// ̷߳е֡Ⱦ߳ŶӺ󵽴CDxSurface,ӳ05֮仯
+	CTestRandom Random;
+	int nDecoded = 0, nPassed = 0, nRendered = 0;
+	for (int i = 0; i < 500; i++, nNow += TEST_FRAME_NS)
+	{
+		nDecoded++;
+		if (!Decoder.ShouldRender(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, false, nNow))
+			continue;
+		nPassed++;
+		int64_t nArrive = nNow + Random.Range(0, 5) * MONO_NS_PER_MS;
+		if (Surface.ShouldRender(hWnd, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, false, nArrive))
+			nRendered++;
+	}
+	TEST_EQUAL(nPassed, nDecoded / 2);
+	TEST_EQUAL(nRendered, nPassed);
+}
+
+#define BENCH_PANELS		64
+#define BENCH_SECONDS		10
+
+// 64ĵͲ:8x8ȷ1920x1080ʾ,4ϲŴΪѡеͨ,8屻ڵ
+BENCHMARK(RenderThrottle, Panels64)
+{
+	vector<CFakeWindowGeometry> vecGeometry(BENCH_PANELS, CFakeWindowGeometry(1920 / 8, 1080 / 8));
+	vector<CRenderThrottle> vecThrottle(BENCH_PANELS);
+	for (int i = 0; i < BENCH_PANELS; i++)
+	{
+		if (i < 4)
+		{
+			vecGeometry[i].m_nWidth = 1920 / 2;
+			vecGeometry[i].m_nHeight = 1080 / 2;
+		}
+		else if (i % 8 == 7)
+			vecGeometry[i].m_bOccluded = true;
+		InitThrottle(vecThrottle[i], &vecGeometry[i]);
+	}
+	// ÿ尴25fpsBENCH_SECONDS֡,֡5Ķ
+	CTestRandom Random;
+	int nFrames = 0, nRendered = 0;
+	int64_t nDecisionNs = 0;
+	for (int i = 0; i < BENCH_PANELS; i++)
+	{
+		int64_t nNow = MONO_NS_PER_SEC + Random.Range(0, 39) * MONO_NS_PER_MS;
+		int64_t nStart = TestNowNs();
+		for (int j = 0; j < BENCH_SECONDS * 25; j++, nNow += TEST_FRAME_NS)
+		{
+			nFrames++;
+			if (vecThrottle[i].ShouldRender(TestWindow(i), TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT, false, nNow + Random.Range(-5, 5) * MONO_NS_PER_MS))
+				nRendered++;
+		}
+		nDecisionNs += TestNowNs() - nStart;
+	}
+	RenderThrottleStat Total = { 0 };
+	for (int i = 0; i < BENCH_PANELS; i++)
+	{
+		RenderThrottleStat Stat;
+		vecThrottle[i].GetStat(Stat);
+		Total.nReduced += Stat.nReduced;
+		Total.nHidden += Stat.nHidden;
+	}
+	// ÿ֡ƵCPUʱ,ȡCMemorySurfaceϴ1080P YUV420Pͼ;PresentGPU,޷ڴ˲
+	CMemorySurface Surface;
+	Surface.InitD3D(NULL, TEST_VIDEO_WIDTH, TEST_VIDEO_HEIGHT);
+	AVFrame *pFrame = av_frame_alloc();
+	pFrame->format = AV_PIX_FMT_YUV420P;
+	pFrame->width = TEST_VIDEO_WIDTH;
+	pFrame->height = TEST_VIDEO_HEIGHT;
+	av_frame_get_buffer(pFrame, 32);
+	for (int i = 0; i < 3; i++)
+		memset(pFrame->data[i], 0x80, pFrame->linesize[i] * (i ? TEST_VIDEO_HEIGHT / 2 : TEST_VIDEO_HEIGHT));
+	double dfCopyNs = BenchRun("copy 1080P YUV420P to surface", TEST_VIDEO_WIDTH * TEST_VIDEO_HEIGHT * 3 / 2, [&]() { Surface.Render(pFrame); });
+	av_frame_free(&pFrame);
+
+	int nSkipped = nFrames - nRendered;
+	printf("  %-44s %12d\n", "frames", nFrames);
+	printf("  %-44s %12d\n", "rendered", nRendered);
+	printf("  %-44s %12d\n", "skipped: reduced rate", Total.nReduced);
+	printf("  %-44s %12d\n", "skipped: hidden", Total.nHidden);
+	printf("  %-44s %12.1f ns\n", "throttle decision per frame", (double)nDecisionNs / nFrames);
+	printf("  %-44s %12.1f ms/s\n", "copy time without throttle", dfCopyNs * nFrames / BENCH_SECONDS / 1e6);
+	printf("  %-44s %12.1f ms/s\n", "copy time saved", dfCopyNs * nSkipped / BENCH_SECONDS / 1e6);
+	fflush(stdout);
+	TEST_EQUAL(nSkipped, Total.nReduced + Total.nHidden);
+	TEST_CHECK(nSkipped > nFrames / 2);
+}
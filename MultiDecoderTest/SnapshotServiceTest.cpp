@@ -0,0 +1,424 @@
+// CSnapshotServiceĲԺܲ
+// õıYƽԭ,ÿ󶼰˳򱣴浽Ӧļ,ʱܾµ,
+// ԼStopͨSubmitͬʱʱۺ֡öȷͷ
+// ҵlibjpegʱܲlibjpegJPEG,64ͨͬʱͼʱÿ뱣Ľͼ
+#include "TestFramework.h"
+#include "SnapshotService.h"
+#include "MonoClock.h"
+#include <string>
+#include <vector>
+#ifdef TEST_HAVE_JPEG
+#include <stdlib.h>
+#include <jpeglib.h>
+#endif
+
+static volatile LONG s_nLiveSnapshotFrames = 0;
+
+static void FreeSnapshotFrame(void *opaque, uint8_t *data)
+{
+	av_free(data);
+	InterlockedDecrement(&s_nLiveSnapshotFrames);
+}
+
+// һ֡YUV420Pͼ,YƽΪnSeedΪĽ,av_frame_freeͷ
+static AVFrame *MakeSnapshotFrame(int nWidth, int nHeight, int nSeed)
+{
+	AVFrame *pFrame = av_frame_alloc();
+	int nChromaWidth = (nWidth + 1) / 2;
+	int nChromaHeight = (nHeight + 1) / 2;
+	int nSize = nWidth * nHeight + nChromaWidth * nChromaHeight * 2;
+	uint8_t *pData = (uint8_t *)av_malloc(nSize);
+	for (int y = 0; y < nHeight; y++)
+		for (int x = 0; x < nWidth; x++)
+			pData[y * nWidth + x] = (uint8_t)(nSeed + x + y);
+	memset(pData + nWidth * nHeight, 128, nChromaWidth * nChromaHeight * 2);
+	pFrame->buf[0] = av_buffer_create(pData, nSize, FreeSnapshotFrame, NULL, 0);
+	InterlockedIncrement(&s_nLiveSnapshotFrames);
+	pFrame->data[0] = pData;
+	pFrame->data[1] = pData + nWidth * nHeight;
+	pFrame->data[2] = pFrame->data[1] + nChromaWidth * nChromaHeight;
+	pFrame->linesize[0] = nWidth;
+	pFrame->linesize[1] = nChromaWidth;
+	pFrame->linesize[2] = nChromaWidth;
+	pFrame->width = nWidth;
+	pFrame->height = nHeight;
+	pFrame->format = AV_PIX_FMT_YUV420P;
+	pFrame->pts = nSeed;
+	return pFrame;
+}
+
+// Yƽԭ;hEventGateʱ,ÿαǰȴ¼
+class CRawSnapshotEncoder : public ISnapshotEncoder
+{
+public:
+	explicit CRawSnapshotEncoder(HANDLE hEventGate)
+	{
+		m_hEventGate = hEventGate;
+	}
+	virtual bool Encode(AVFrame *pFrame, SnapshotFormat nFormat, const uint8_t *&pData, int &nSize)
+	{
+		if (m_hEventGate)
+			WaitForSingleObject(m_hEventGate, INFINITE);
+		m_vecOutput.resize(pFrame->width * pFrame->height);
+		for (int y = 0; y < pFrame->height; y++)
+			memcpy(&m_vecOutput[y * pFrame->width], pFrame->data[0] + y * pFrame->linesize[0], pFrame->width);
+		pData = &m_vecOutput[0];
+		nSize = (int)m_vecOutput.size();
+		return true;
+	}
+private:
+	HANDLE				m_hEventGate;
+	std::vector<uint8_t> m_vecOutput;
+};
+
+static ISnapshotEncoder *CreateRawEncoder(void *pUserPtr)
+{
+	return new CRawSnapshotEncoder((HANDLE)pUserPtr);
+}
+
+// ļID,ͬʱеĶԽ̻
+static std::string SnapshotFilePath(const char *szName, int nIndex)
+{
+	char szFile[128];
+	sprintf_s(szFile, sizeof(szFile), "%s%u_%d", szName, (unsigned)GetCurrentProcessId(), nIndex);
+#ifdef _WIN32
+	char szPath[MAX_PATH];
+	GetTempPathA(MAX_PATH, szPath);
+	return std::string(szPath) + szFile;
+#else
+	return std::string("/tmp/") + szFile;
+#endif
+}
+
+// ȴѽܵ
+static bool WaitSnapshotsDone(CSnapshotService &Service, DWORD dwTimeout = 5000)
+{
+	int64_t nDeadline = MonoTimeNs() + dwTimeout * MONO_NS_PER_MS;
+	for (;;)
+	{
+		SnapshotStat Stat;
+		Service.GetStat(Stat);
+		if (Stat.nSaved + Stat.nFailed + Stat.nRejected == Stat.nSubmitted)
+			return true;
+		if (MonoTimeNs() > nDeadline)
+			return false;
+		Sleep(1);
+	}
+}
+
+static bool ReadSnapshotFile(const std::string &strPath, std::vector<uint8_t> &vecData)
+{
+	FILE *fp = fopen(strPath.c_str(), "rb");
+	if (!fp)
+		return false;
+	fseek(fp, 0, SEEK_END);
+	long nSize = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	vecData.resize(nSize);
+	bool bRead = nSize > 0 && fread(&vecData[0], 1, nSize, fp) == (size_t)nSize;
+	fclose(fp);
+	return bRead;
+}
+
+TEST_CASE(SnapshotService, SavesEveryRequest)
+{
+	CSnapshotService Service;
+	TEST_CHECK(Service.Start(2, 8, CreateRawEncoder, NULL));
+	const int nRequests = 6;
+	const int nWidth = 65, nHeight = 33;
+	for (int i = 0; i < nRequests; i++)
+	{
+		AVFrame *pFrame = MakeSnapshotFrame(nWidth, nHeight, i * 7);
+		TEST_CHECK(Service.Submit(pFrame, SnapshotFilePath("SnapshotTest", i).c_str(), Snapshot_JPEG));
+		av_frame_free(&pFrame);
+	}
+	TEST_CHECK(WaitSnapshotsDone(Service));
+	SnapshotStat Stat;
+	Service.GetStat(Stat);
+	TEST_EQUAL(Stat.nSubmitted, nRequests);
+	TEST_EQUAL(Stat.nSaved, nRequests);
+	TEST_EQUAL(Stat.nFailed, 0);
+	// ϼͷ֡
+	TEST_EQUAL(s_nLiveSnapshotFrames, 0);
+	for (int i = 0; i < nRequests; i++)
+	{
+		std::string strPath = SnapshotFilePath("SnapshotTest", i);
+		std::vector<uint8_t> vecData;
+		TEST_CHECK(ReadSnapshotFile(strPath, vecData));
+		remove(strPath.c_str());
+		TEST_EQUAL(vecData.size(), nWidth * nHeight);
+		if (vecData.size() != nWidth * nHeight)
+			continue;
+		int nMismatch = 0;
+		for (int y = 0; y < nHeight; y++)
+			for (int x = 0; x < nWidth; x++)
+				nMismatch += vecData[y * nWidth + x] != (uint8_t)(i * 7 + x + y);
+		TEST_EQUAL(nMismatch, 0);
+	}
+	Service.Stop();
+}
+
+// ʱܾµ,ʧܵ֡޷ضӲ֡Ҳܾ
+TEST_CASE(SnapshotService, RejectsWhenFull)
+{
+	HANDLE hEventGate = CreateEvent(NULL, TRUE, FALSE, NULL);
+	CSnapshotService Service;
+	const int nQueueSize = 4;
+	TEST_CHECK(Service.Start(1, nQueueSize, CreateRawEncoder, hEventGate));
+	AVFrame *pFrame = MakeSnapshotFrame(16, 16, 0);
+	std::string strPath = SnapshotFilePath("SnapshotFull", 0);
+	// ߳ڱʱȴ,ڱɺŹ黹
+	for (int i = 0; i < nQueueSize; i++)
+		TEST_CHECK(Service.Submit(pFrame, strPath.c_str()));
+	TEST_CHECK(!Service.Submit(pFrame, strPath.c_str()));
+	SetEvent(hEventGate);
+	TEST_CHECK(WaitSnapshotsDone(Service));
+	AVFrame *pNoBuffer = av_frame_alloc();
+	pNoBuffer->width = 16;
+	pNoBuffer->height = 16;
+	pNoBuffer->format = AV_PIX_FMT_YUV420P;
+	TEST_CHECK(!Service.Submit(pNoBuffer, strPath.c_str()));
+	av_frame_free(&pNoBuffer);
+#ifndef _WIN32
+	// ƽ̨ûлض
+	pFrame->format = AV_PIX_FMT_DXVA2_VLD;
+	TEST_CHECK(!Service.Submit(pFrame, strPath.c_str()));
+	pFrame->format = AV_PIX_FMT_YUV420P;
+#endif
+	TEST_CHECK(Service.Submit(pFrame, strPath.c_str()));
+	TEST_CHECK(WaitSnapshotsDone(Service));
+	SnapshotStat Stat;
+	Service.GetStat(Stat);
+	TEST_EQUAL(Stat.nSaved, nQueueSize + 1);
+	TEST_CHECK(Stat.nRejected >= 2);
+	TEST_EQUAL(Stat.nSubmitted, Stat.nSaved + Stat.nRejected);
+	Service.Stop();
+	av_frame_free(&pFrame);
+	TEST_EQUAL(s_nLiveSnapshotFrames, 0);
+	remove(strPath.c_str());
+	CloseHandle(hEventGate);
+}
+
+struct SnapshotSubmitContext
+{
+	CSnapshotService	*pService;
+	int					nChannel;
+	volatile LONG		*pStop;
+	LONG				nAccepted;
+};
+
+static unsigned __stdcall SnapshotSubmitThread(void *p)
+{
+	SnapshotSubmitContext *pContext = (SnapshotSubmitContext *)p;
+	std::string strPath = SnapshotFilePath("SnapshotStop", pContext->nChannel);
+	AVFrame *pFrame = MakeSnapshotFrame(32, 18, pContext->nChannel);
+	while (!*pContext->pStop)
+	{
+		if (pContext->pService->Submit(pFrame, strPath.c_str()))
+			pContext->nAccepted++;
+		SwitchToThread();
+	}
+	av_frame_free(&pFrame);
+	remove(strPath.c_str());
+	return 0;
+}
+
+// ֹͣ,ͬʱͨύ;StopȽеSubmitغͷ,֡նͷ
+TEST_CASE(SnapshotService, StopWhileSubmitting)
+{
+	CSnapshotService Service;
+	const int nThreads = 8;
+	volatile LONG nStop = 0;
+	SnapshotSubmitContext Context[nThreads];
+	HANDLE hThreads[nThreads];
+	TEST_CHECK(Service.Start(2, 4, CreateRawEncoder, NULL));
+	for (int i = 0; i < nThreads; i++)
+	{
+		Context[i].pService = &Service;
+		Context[i].nChannel = i;
+		Context[i].pStop = &nStop;
+		Context[i].nAccepted = 0;
+		hThreads[i] = (HANDLE)_beginthreadex(NULL, 0, SnapshotSubmitThread, &Context[i], 0, NULL);
+	}
+	for (int i = 0; i < 30; i++)
+	{
+		Sleep(2);
+		Service.Stop();
+		Service.Start(2, 4, CreateRawEncoder, NULL);
+	}
+	InterlockedExchange(&nStop, 1);
+	WaitForMultipleObjects(nThreads, hThreads, TRUE, INFINITE);
+	for (int i = 0; i < nThreads; i++)
+		CloseHandle(hThreads[i]);
+	Service.Stop();
+	LONG nAccepted = 0;
+	for (int i = 0; i < nThreads; i++)
+		nAccepted += Context[i].nAccepted;
+	TEST_CHECK(nAccepted > 0);
+	TEST_EQUAL(s_nLiveSnapshotFrames, 0);
+}
+
+#ifdef TEST_HAVE_JPEG
+// libjpegYUV420PͼΪJPEG,ɫȰиƺYCbCr
+class CJpegSnapshotEncoder : public ISnapshotEncoder
+{
+public:
+	CJpegSnapshotEncoder()
+	{
+		m_pOutput = NULL;
+		m_nOutputSize = 0;
+	}
+	virtual ~CJpegSnapshotEncoder()
+	{
+		free(m_pOutput);
+	}
+	virtual bool Encode(AVFrame *pFrame, SnapshotFormat nFormat, const uint8_t *&pData, int &nSize)
+	{
+		jpeg_compress_struct cinfo;
+		jpeg_error_mgr jerr;
+		cinfo.err = jpeg_std_error(&jerr);
+		jpeg_create_compress(&cinfo);
+		free(m_pOutput);
+		m_pOutput = NULL;
+		m_nOutputSize = 0;
+		jpeg_mem_dest(&cinfo, &m_pOutput, &m_nOutputSize);
+		cinfo.image_width = pFrame->width;
+		cinfo.image_height = pFrame->height;
+		cinfo.input_components = 3;
+		cinfo.in_color_space = JCS_YCbCr;
+		jpeg_set_defaults(&cinfo);
+		jpeg_set_quality(&cinfo, 90, TRUE);
+		jpeg_start_compress(&cinfo, TRUE);
+		m_vecRow.resize(pFrame->width * 3);
+		while (cinfo.next_scanline < cinfo.image_height)
+		{
+			int y = cinfo.next_scanline;
+			const uint8_t *pY = pFrame->data[0] + y * pFrame->linesize[0];
+			const uint8_t *pU = pFrame->data[1] + (y / 2) * pFrame->linesize[1];
+			const uint8_t *pV = pFrame->data[2] + (y / 2) * pFrame->linesize[2];
+			for (int x = 0; x < pFrame->width; x++)
+			{
+				m_vecRow[x * 3] = pY[x];
+				m_vecRow[x * 3 + 1] = pU[x / 2];
+				m_vecRow[x * 3 + 2] = pV[x / 2];
+			}
+			JSAMPROW pRow = &m_vecRow[0];
+			jpeg_write_scanlines(&cinfo, &pRow, 1);
+		}
+		jpeg_finish_compress(&cinfo);
+		jpeg_destroy_compress(&cinfo);
+		pData = m_pOutput;
+		nSize = (int)m_nOutputSize;
+		return true;
+	}
+private:
+	unsigned char		*m_pOutput;
+	unsigned long		m_nOutputSize;
+	std::vector<uint8_t> m_vecRow;
+};
+
+static ISnapshotEncoder *CreateJpegEncoder(void *pUserPtr)
+{
+	return new CJpegSnapshotEncoder();
+}
+
+TEST_CASE(SnapshotService, JpegOutput)
+{
+	CSnapshotService Service;
+	TEST_CHECK(Service.Start(1, 4, CreateJpegEncoder, NULL));
+	AVFrame *pFrame = MakeSnapshotFrame(97, 55, 3);
+	std::string strPath = SnapshotFilePath("SnapshotJpeg", 0);
+	TEST_CHECK(Service.Submit(pFrame, strPath.c_str()));
+	av_frame_free(&pFrame);
+	TEST_CHECK(WaitSnapshotsDone(Service));
+	std::vector<uint8_t> vecData;
+	TEST_CHECK(ReadSnapshotFile(strPath, vecData));
+	remove(strPath.c_str());
+	// JPEGļSOIʼ,EOI
+	TEST_CHECK(vecData.size() > 4);
+	if (vecData.size() > 4)
+	{
+		TEST_CHECK(vecData[0] == 0xFF && vecData[1] == 0xD8);
+		TEST_CHECK(vecData[vecData.size() - 2] == 0xFF && vecData[vecData.size() - 1] == 0xD9);
+	}
+	Service.Stop();
+}
+#endif
+
+struct SnapshotBenchContext
+{
+	CSnapshotService	*pService;
+	AVFrame				*pFrame;
+	int					nChannel;
+	int					nSnapshots;		// ÿͨĽͼ
+	volatile BOOL		*pStart;
+	LONG				nRetries;		// ܾύĴ
+};
+
+// ģһͨȾ߳ͼ,󱻾ܾʱóCPU,ֱнͼ
+static unsigned __stdcall SnapshotBenchThread(void *p)
+{
+	SnapshotBenchContext *pContext = (SnapshotBenchContext *)p;
+	std::string strPath = SnapshotFilePath("SnapshotBench", pContext->nChannel);
+	while (!*pContext->pStart)
+		SwitchToThread();
+	for (int i = 0; i < pContext->nSnapshots; i++)
+	{
+		while (!pContext->pService->Submit(pContext->pFrame, strPath.c_str()))
+		{
+			pContext->nRetries++;
+			Sleep(1);
+		}
+	}
+	return 0;
+}
+
+// 64ͨͬʱͼʱÿ뱣Ľͼ,ͼΪ1080P
+BENCHMARK(SnapshotService, Channels64)
+{
+	const int nChannels = 64;
+	int nPerChannel = TestMinTime() > 0 ? 4 : 1;
+	SnapshotEncoderFactory pFactory = CreateRawEncoder;
+	const char *szEncoder = "raw";
+#ifdef TEST_HAVE_JPEG
+	pFactory = CreateJpegEncoder;
+	szEncoder = "libjpeg";
+#endif
+	AVFrame *pFrame = MakeSnapshotFrame(1920, 1080, 0);
+	const int nWorkerCounts[] = { 1, 4 };
+	for (size_t w = 0; w < sizeof(nWorkerCounts) / sizeof(nWorkerCounts[0]); w++)
+	{
+		CSnapshotService Service;
+		Service.Start(nWorkerCounts[w], 64, pFactory, NULL);
+		volatile BOOL bStart = FALSE;
+		SnapshotBenchContext Context[nChannels];
+		HANDLE hThreads[nChannels];
+		for (int i = 0; i < nChannels; i++)
+		{
+			SnapshotBenchContext Init = { &Service, pFrame, i, nPerChannel, &bStart, 0 };
+			Context[i] = Init;
+			hThreads[i] = (HANDLE)_beginthreadex(NULL, 0, SnapshotBenchThread, &Context[i], 0, NULL);
+		}
+		int64_t nT1 = MonoTimeNs();
+		bStart = TRUE;
+		WaitForMultipleObjects(nChannels, hThreads, TRUE, INFINITE);
+		WaitSnapshotsDone(Service, 600000);
+		double dfSpan = MonoNsToSeconds(MonoTimeNs() - nT1);
+		SnapshotStat Stat;
+		Service.GetStat(Stat);
+		TEST_EQUAL(Stat.nSaved, nChannels * nPerChannel);
+		Service.Stop();
+		LONG nRetries = 0;
+		for (int i = 0; i < nChannels; i++)
+		{
+			CloseHandle(hThreads[i]);
+			nRetries += Context[i].nRetries;
+			remove(SnapshotFilePath("SnapshotBench", i).c_str());
+		}
+		char szLabel[64];
+		sprintf_s(szLabel, sizeof(szLabel), "64 channels, %s, %d worker(s)", szEncoder, nWorkerCounts[w]);
+		printf("  %-44s %12.1f snapshots/s %8d retries\n", szLabel, dfSpan > 0 ? Stat.nSaved / dfSpan : 0.0, (int)nRetries);
+		fflush(stdout);
+	}
+	av_frame_free(&pFrame);
+}
@@ -0,0 +1,341 @@
+// CSurfaceAllocatorѹ,ģĽD3D
+// ÿͨһ̺߳һʾ߳:̰߳GOP,DPBбĲο֡,Ͷݵֻһ֡;
+// ʾ߳ʱʾе֡,ͬʱһ֡,Ⱦͬ
+// ÿдռ֡,ʾʱرȽ,Աʱٴηͻᱻ
+#include "TestFramework.h"
+#include "SurfaceAllocator.h"
+#include <memory>
+#include <deque>
+
+#define STRESS_CHANNELS		8
+#define STRESS_FRAMES		600
+#define STRESS_GOP			30
+#define STRESS_DPB			4
+#define STRESS_RENDER		3		// DXVA2_RENDER_SURFACESͬ:е֡ʾ֡ͱһ֡
+
+// һReset֮б,ӦؽʱһD3D,ɱ֡ͷź
+struct MockSurfaceSet
+{
+	UINT				nGeneration;
+	volatile LONG		nContent[SURFACE_ALLOCATOR_MAX];	// еͼ,д֡
+	volatile LONG		nInUse[SURFACE_ALLOCATOR_MAX];		// 汻Ĵ,1Ϊظ
+};
+
+// õһ֡,һͷʱ黹,൱free_dxva2_buffer
+struct MockFrame
+{
+	CSurfaceAllocator				*pAlloc;
+	std::shared_ptr<MockSurfaceSet>	pSet;
+	int								nIndex;
+	int								nFrame;
+	~MockFrame()
+	{
+		InterlockedDecrement(&pSet->nInUse[nIndex]);
+		pAlloc->Free(nIndex, pSet->nGeneration);
+	}
+};
+typedef std::shared_ptr<MockFrame> MockFramePtr;
+
+struct StressChannel
+{
+	CSurfaceAllocator				Alloc;
+	std::shared_ptr<MockSurfaceSet>	pSet;
+	int								nSurfaces;
+	bool							bGrow;			// 治ʱǷǼ
+	CRITICAL_SECTION				csMailbox;
+	MockFramePtr					pMailbox;		// ֻһ֡
+	volatile LONG					bDecoding;
+	// 
+	volatile LONG					nDuplicates;	// 汻ظĴ
+	volatile LONG					nCorrupted;		// ʾʱѱдĴ
+	volatile LONG					nShown;
+	int								nFailed;		// ûеõ֡
+	int								nResets;
+	DXVA2SurfaceStat				Stat;
+};
+
+static void ResetSurfaces(StressChannel *pChannel, int nSurfaces)
+{
+	pChannel->nSurfaces = nSurfaces;
+	pChannel->Alloc.Reset(nSurfaces);
+	std::shared_ptr<MockSurfaceSet> pSet = std::make_shared<MockSurfaceSet>();
+	ZeroMemory(pSet.get(), sizeof(MockSurfaceSet));
+	pSet->nGeneration = pChannel->Alloc.GetGeneration();
+	pChannel->pSet = pSet;
+	pChannel->nResets++;
+}
+
+static unsigned __stdcall StressDecodeThread(void *p)
+{
+	StressChannel *pChannel = (StressChannel *)p;
+	std::deque<MockFramePtr> Dpb;
+	for (int nFrame = 0; nFrame < STRESS_FRAMES; nFrame++)
+	{
+		bool bKeyFrame = (nFrame % STRESS_GOP) == 0;
+		// CDXVA2Decode::Decodeͬ,ÿ֮֡ǰ,ֻйؼ֡ȡ,DPB,൱avcodec_flush_buffers
+		int nExtra = 0;
+		if (pChannel->Alloc.TakeGrowAtKeyFrame(bKeyFrame, nExtra))
+		{
+			Dpb.clear();
+			ResetSurfaces(pChannel, pChannel->nSurfaces + nExtra);
+		}
+		int nIndex = pChannel->Alloc.Alloc();
+		if (nIndex == -1)
+		{
+			if (pChannel->bGrow && !pChannel->Alloc.IsGrowPending())
+				pChannel->Alloc.RequestGrow(4);
+			nIndex = pChannel->Alloc.Alloc(20);
+		}
+		if (nIndex == -1)
+		{
+			pChannel->nFailed++;
+			continue;
+		}
+		MockFramePtr pFrame(new MockFrame);
+		pFrame->pAlloc = &pChannel->Alloc;
+		pFrame->pSet = pChannel->pSet;
+		pFrame->nIndex = nIndex;
+		pFrame->nFrame = nFrame;
+		if (InterlockedIncrement(&pFrame->pSet->nInUse[nIndex]) != 1)
+			InterlockedIncrement(&pChannel->nDuplicates);
+		InterlockedExchange(&pFrame->pSet->nContent[nIndex], nFrame);
+		// ο֡DPB,DPBСʱĲο֡Ƴ
+		Dpb.push_back(pFrame);
+		if ((int)Dpb.size() > STRESS_DPB)
+			Dpb.pop_front();
+		{
+			CAutoLock lock(&pChannel->csMailbox);
+			pChannel->pMailbox = pFrame;
+		}
+		pFrame.reset();
+		if ((nFrame & 7) == 0)
+			SwitchToThread();
+	}
+	Dpb.clear();
+	InterlockedExchange(&pChannel->bDecoding, FALSE);
+	return 0;
+}
+
+static unsigned __stdcall StressRenderThread(void *p)
+{
+	StressChannel *pChannel = (StressChannel *)p;
+	CTestRandom Random((uint32_t)(uintptr_t)p);
+	MockFramePtr pFront, pHold;
+	while (pChannel->bDecoding)
+	{
+		MockFramePtr pFrame;
+		{
+			CAutoLock lock(&pChannel->csMailbox);
+			pFrame.swap(pChannel->pMailbox);
+		}
+		if (pFrame)
+		{
+			pHold = pFront;
+			pFront = pFrame;
+			if (pFront->pSet->nContent[pFront->nIndex] != pFront->nFrame)
+				InterlockedIncrement(&pChannel->nCorrupted);
+			InterlockedIncrement(&pChannel->nShown);
+		}
+		// ʾʱ01
+		if (Random.Range(0, 3) == 0)
+			Sleep(1);
+		else
+			SwitchToThread();
+		if (pFront && pFront->pSet->nContent[pFront->nIndex] != pFront->nFrame)
+			InterlockedIncrement(&pChannel->nCorrupted);
+	}
+	return 0;
+}
+
+static void RunStress(StressChannel *pChannels, int nChannels)
+{
+	std::vector<HANDLE> vecThread;
+	for (int i = 0; i < nChannels; i++)
+	{
+		pChannels[i].bDecoding = TRUE;
+		vecThread.push_back((HANDLE)_beginthreadex(NULL, 0, StressRenderThread, &pChannels[i], 0, NULL));
+		vecThread.push_back((HANDLE)_beginthreadex(NULL, 0, StressDecodeThread, &pChannels[i], 0, NULL));
+	}
+	WaitForMultipleObjects((DWORD)vecThread.size(), &vecThread[0], TRUE, INFINITE);
+	for (size_t i = 0; i < vecThread.size(); i++)
+		CloseHandle(vecThread[i]);
+	for (int i = 0; i < nChannels; i++)
+	{
+		pChannels[i].pMailbox.reset();
+		pChannels[i].Alloc.GetStat(pChannels[i].Stat);
+	}
+}
+
+static StressChannel *CreateChannels(int nChannels, int nSurfaces, bool bGrow)
+{
+	StressChannel *pChannels = new StressChannel[nChannels];
+	for (int i = 0; i < nChannels; i++)
+	{
+		StressChannel &Channel = pChannels[i];
+		InitializeCriticalSection(&Channel.csMailbox);
+		Channel.bGrow = bGrow;
+		Channel.nDuplicates = 0;
+		Channel.nCorrupted = 0;
+		Channel.nShown = 0;
+		Channel.nFailed = 0;
+		Channel.nResets = 0;
+		ResetSurfaces(&Channel, nSurfaces);
+	}
+	return pChannels;
+}
+
+static void DeleteChannels(StressChannel *pChannels, int nChannels)
+{
+	for (int i = 0; i < nChannels; i++)
+		DeleteCriticalSection(&pChannels[i].csMailbox);
+	delete[] pChannels;
+}
+
+TEST_CASE(SurfaceAllocator, FreeListOrder)
+{
+	CSurfaceAllocator Alloc;
+	Alloc.Reset(4);
+	UINT nGeneration = Alloc.GetGeneration();
+	// η,ͷź׷ӵβ,δʹõıȱٴη
+	TEST_EQUAL(Alloc.Alloc(), 0);
+	TEST_EQUAL(Alloc.Alloc(), 1);
+	TEST_EQUAL(Alloc.Alloc(), 2);
+	Alloc.Free(1, nGeneration);
+	TEST_EQUAL(Alloc.Alloc(), 3);
+	TEST_EQUAL(Alloc.Alloc(), 1);
+	TEST_EQUAL(Alloc.Alloc(), -1);
+	TEST_EQUAL(Alloc.GetFreeCount(), 0);
+	// ؽ֮ıͷʱ
+	Alloc.Reset(2);
+	TEST_CHECK(Alloc.GetGeneration() != nGeneration);
+	Alloc.Free(0, nGeneration);
+	TEST_EQUAL(Alloc.GetFreeCount(), 2);
+	DXVA2SurfaceStat Stat;
+	Alloc.GetStat(Stat);
+	TEST_EQUAL(Stat.nSurfaces, 2);
+	TEST_EQUAL(Stat.nAllocs, 5);
+}
+
+TEST_CASE(SurfaceAllocator, WaitAndGrowRequest)
+{
+	CSurfaceAllocator Alloc;
+	Alloc.Reset(1);
+	TEST_EQUAL(Alloc.Alloc(), 0);
+	int64_t nT1 = TestNowNs();
+	TEST_EQUAL(Alloc.Alloc(30), -1);
+	TEST_CHECK(TestNowNs() - nT1 >= 20 * 1000000LL);
+	int nExtra = 0;
+	TEST_CHECK(!Alloc.TakeGrow(nExtra));
+	// ͬһؼ֮֡ǰĶϲΪһ
+	Alloc.RequestGrow(4);
+	Alloc.RequestGrow(2);
+	TEST_CHECK(Alloc.IsGrowPending());
+	TEST_CHECK(Alloc.TakeGrow(nExtra));
+	TEST_EQUAL(nExtra, 4);
+	TEST_CHECK(!Alloc.IsGrowPending());
+	DXVA2SurfaceStat Stat;
+	Alloc.GetStat(Stat);
+	TEST_EQUAL(Stat.nWaits, 1);
+	TEST_EQUAL(Stat.nWaitTimeouts, 1);
+	TEST_EQUAL(Stat.nGrows, 1);
+}
+
+// ǼǺǹؼ֡,ֱؼ֡ؽ,DPBʱ0ӱǼǵͬ
+TEST_CASE(SurfaceAllocator, GrowOnlyAtKeyFrame)
+{
+	CSurfaceAllocator Alloc;
+	Alloc.Reset(4);
+	int nExtra = -1;
+	TEST_CHECK(!Alloc.TakeGrowAtKeyFrame(true, nExtra));
+	TEST_EQUAL(nExtra, 0);
+	const int nGop = 25;
+	int nRebuildFrame = -1;
+	int nRebuildExtra = 0;
+	Alloc.RequestGrow(0);
+	for (int nFrame = 3; nFrame < nGop * 2; nFrame++)
+	{
+		bool bKeyFrame = (nFrame % nGop) == 0;
+		if (Alloc.TakeGrowAtKeyFrame(bKeyFrame, nExtra))
+		{
+			TEST_EQUAL(nRebuildFrame, -1);
+			nRebuildFrame = nFrame;
+			nRebuildExtra = nExtra;
+			Alloc.Reset(6);
+		}
+		else if (nRebuildFrame < 0)
+			TEST_CHECK(Alloc.IsGrowPending());
+		if (nFrame == 10)
+			Alloc.RequestGrow(2);
+	}
+	TEST_EQUAL(nRebuildFrame, nGop);
+	TEST_EQUAL(nRebuildExtra, 2);
+	TEST_CHECK(!Alloc.IsGrowPending());
+	DXVA2SurfaceStat Stat;
+	Alloc.GetStat(Stat);
+	TEST_EQUAL(Stat.nGrows, 1);
+}
+
+// ׼DPBС,ֵ׼еļֹ
+TEST_CASE(SurfaceAllocator, DpbFrames)
+{
+	// H.264:MaxDpbMbs / 
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_H264, 41, 1920, 1088, 0, 0), 4);		// 32768 / 8160
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_H264, 31, 720, 576, 0, 0), 11);		// 18000 / 1620
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_H264, 51, 352, 288, 0, 0), 16);		// 16֡
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_H264, 41, 1920, 1088, 2, 1), 3);		// ͷвο֡
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_H264, 0, 1920, 1088, 0, 0), 0);		// δ֪
+	// HEVC:4MaxLumaPsΪ2228224
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_HEVC, 120, 1920, 1080, 0, 0), 6);
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_HEVC, 120, 1600, 900, 0, 0), 8);		// 1440000 <= 3/4
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_HEVC, 120, 1024, 576, 0, 0), 12);		// 589824 <= 1/2
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_HEVC, 120, 704, 576, 0, 0), 16);		// 405504 <= 1/4
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_HEVC, 153, 3840, 2160, 0, 0), 6);
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_HEVC, 93, 1280, 720, 5, 2), 7);
+	// MPEG-2VC-1ֻǰο֡,뼶޹
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_MPEG2, 0, 1920, 1080, 0, 0), 2);
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_VC1, 0, 1920, 1080, 0, 0), 2);
+	TEST_EQUAL(CalcDpbFrames(DpbCodec_Unknown, 41, 1920, 1080, 4, 0), 0);
+}
+
+// DPBӽеһ֡صһ֡Ⱦһеı,дӲȱٱ
+TEST_CASE(SurfaceAllocator, StressSizedAtInit)
+{
+	StressChannel *pChannels = CreateChannels(STRESS_CHANNELS, STRESS_DPB + 2 + STRESS_RENDER, false);
+	RunStress(pChannels, STRESS_CHANNELS);
+	for (int i = 0; i < STRESS_CHANNELS; i++)
+	{
+		StressChannel &Channel = pChannels[i];
+		TEST_EQUAL(Channel.nDuplicates, 0);
+		TEST_EQUAL(Channel.nCorrupted, 0);
+		TEST_EQUAL(Channel.nFailed, 0);
+		TEST_EQUAL(Channel.Stat.nWaits, 0);
+		TEST_EQUAL(Channel.Stat.nAllocs, STRESS_FRAMES);
+		// ֡ͷźȫص
+		TEST_EQUAL(Channel.Stat.nFreeSurfaces, Channel.nSurfaces);
+		TEST_CHECK(Channel.nShown > 0);
+	}
+	DeleteChannels(pChannels, STRESS_CHANNELS);
+}
+
+// 治ʱֻڹؼ֡ؽ,ؽǰ󶼲Աеıٴη
+TEST_CASE(SurfaceAllocator, StressGrowAtKeyFrame)
+{
+	StressChannel *pChannels = CreateChannels(STRESS_CHANNELS, STRESS_DPB, true);
+	RunStress(pChannels, STRESS_CHANNELS);
+	int nGrows = 0;
+	for (int i = 0; i < STRESS_CHANNELS; i++)
+	{
+		StressChannel &Channel = pChannels[i];
+		TEST_EQUAL(Channel.nDuplicates, 0);
+		TEST_EQUAL(Channel.nCorrupted, 0);
+		TEST_CHECK(Channel.Stat.nGrows >= 1);
+		TEST_EQUAL(Channel.nResets, 1 + Channel.Stat.nGrows);
+		TEST_CHECK(Channel.nSurfaces <= SURFACE_ALLOCATOR_MAX);
+		// ֮㹻,ʧֻܵ֡ڵһGOP
+		TEST_CHECK(Channel.nFailed < STRESS_GOP);
+		TEST_EQUAL(Channel.Stat.nFreeSurfaces, Channel.nSurfaces);
+		nGrows += Channel.Stat.nGrows;
+	}
+	printf("  grows = %d, surfaces = %d\n", nGrows, pChannels[0].nSurfaces);
+	DeleteChannels(pChannels, STRESS_CHANNELS);
+}
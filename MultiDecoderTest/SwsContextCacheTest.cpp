@@ -0,0 +1,210 @@
+// CSwsContextCacheĲԺ64·ܲ
+// תAvStub,ֻ˲ϵл,AvStubSwsBytesռõֽ;
+// ͬͨġ黹ȱٴ,ԼÿֵĿͿгʱıͷ;
+// ܲԱȽ64·ͬͨԴ빲ûʱĵĺʱռõڴ
+#include "TestFramework.h"
+#include "SwsContextCache.h"
+#include <vector>
+
+static SwsContextKey MakeKey(int nDstWidth, int nDstHeight)
+{
+	SwsContextKey Key = { 704, 576, AV_PIX_FMT_YUV420P, nDstWidth, nDstHeight, AV_PIX_FMT_BGRA, SWS_FAST_BILINEAR };
+	return Key;
+}
+
+TEST_CASE(SwsContextCache, SharedAcrossChannels)
+{
+	int nStubContexts = AvStubSwsContexts();
+	{
+		CSwsContextCache Cache;
+		SwsContextKey Key = MakeKey(480, 270);
+		// 64ͨת,ʼֻһ
+		SwsContext *pFirst = NULL;
+		for (int i = 0; i < 64; i++)
+		{
+			SwsContext *pContext = Cache.Acquire(Key);
+			TEST_CHECK(pContext != NULL);
+			if (!pFirst)
+				pFirst = pContext;
+			TEST_CHECK(pContext == pFirst);
+			Cache.Release(Key, pContext);
+		}
+		SwsCacheStat Stat;
+		Cache.GetStat(Stat);
+		TEST_EQUAL((int)Stat.nContexts, 1);
+		TEST_EQUAL((int)Stat.nMisses, 1);
+		TEST_EQUAL((int)Stat.nHits, 63);
+
+		// ͬʱתͨһ,黹ȱٴ
+		SwsContext *pContext[3];
+		for (int i = 0; i < 3; i++)
+			pContext[i] = Cache.Acquire(Key);
+		TEST_CHECK(pContext[0] != pContext[1] && pContext[1] != pContext[2] && pContext[0] != pContext[2]);
+		for (int i = 0; i < 3; i++)
+			Cache.Release(Key, pContext[i]);
+		TEST_CHECK(Cache.Acquire(Key) == pContext[2]);
+		Cache.Release(Key, pContext[2]);
+
+		// ͬת
+		SwsContextKey KeyCIF = MakeKey(352, 288);
+		SwsContext *pCIF = Cache.Acquire(KeyCIF);
+		TEST_CHECK(pCIF != NULL && pCIF != pContext[0] && pCIF != pContext[1] && pCIF != pContext[2]);
+		Cache.Release(KeyCIF, pCIF);
+		Cache.GetStat(Stat);
+		TEST_EQUAL((int)Stat.nContexts, 4);
+		TEST_EQUAL((int)Stat.nIdleContexts, 4);
+		TEST_EQUAL(AvStubSwsContexts() - nStubContexts, 4);
+	}
+	// ʱͷпе
+	TEST_EQUAL(AvStubSwsContexts(), nStubContexts);
+}
+
+TEST_CASE(SwsContextCache, EvictIdleContexts)
+{
+	int nStubContexts = AvStubSwsContexts();
+	CSwsContextCache Cache;
+	Cache.SetIdlePolicy(2, 60000);
+	SwsContextKey Key = MakeKey(480, 270);
+	SwsContext *pContext[5];
+	for (int i = 0; i < 5; i++)
+		pContext[i] = Cache.Acquire(Key);
+	TEST_EQUAL(AvStubSwsContexts() - nStubContexts, 5);
+	// ߷ֻ2
+	for (int i = 0; i < 5; i++)
+		Cache.Release(Key, pContext[i]);
+	SwsCacheStat Stat;
+	Cache.GetStat(Stat);
+	TEST_EQUAL((int)Stat.nIdleContexts, 2);
+	TEST_EQUAL((int)Stat.nContexts, 2);
+	TEST_EQUAL((int)Stat.nEvicted, 3);
+	TEST_EQUAL(AvStubSwsContexts() - nStubContexts, 2);
+	// δʱĲͷ
+	TEST_EQUAL(Cache.Trim(), 0);
+
+	// лֱʺɼֵٱ,гʱͷ,ʹõ¼ֵӰ
+	SwsContextKey KeyNew = MakeKey(640, 360);
+	Cache.SetIdlePolicy(2, 20);
+	Sleep(40);
+	SwsContext *pNew = Cache.Acquire(KeyNew);
+	TEST_EQUAL(Cache.Trim(), 2);
+	Cache.Release(KeyNew, pNew);
+	Cache.GetStat(Stat);
+	TEST_EQUAL((int)Stat.nContexts, 1);
+	TEST_EQUAL((int)Stat.nIdleContexts, 1);
+	TEST_EQUAL((int)Stat.nEvicted, 5);
+	TEST_EQUAL(AvStubSwsContexts() - nStubContexts, 1);
+
+	// ÿֵʱ黹ͷ
+	Cache.SetIdlePolicy(0, 60000);
+	Cache.Trim();
+	Cache.Clear();
+	Cache.Release(Key, Cache.Acquire(Key));
+	TEST_EQUAL(AvStubSwsContexts(), nStubContexts);
+}
+
+#define SWSBENCH_CHANNELS	64
+
+struct SwsBenchChannel
+{
+	CSwsContextCache	*pCache;		// ΪNULLʱͨԼ
+	int					nFrames;
+	vector<BYTE>		*pFrame;		// sws_scale,ÿ֡һD1ͼ
+	volatile LONG		*pConverted;	// תͨ
+	HANDLE				hExit;			// ͨת,¼ڴ֮ͷŸԵ
+	int64_t				nSetupNs;
+	uint32_t			nSum;
+};
+
+static UINT __stdcall SwsBenchThread(void *p)
+{
+	SwsBenchChannel *pChannel = (SwsBenchChannel *)p;
+	SwsContextKey Key = MakeKey(480, 270);
+	SwsContext *pOwn = NULL;
+	if (!pChannel->pCache)
+	{
+		int64_t nT1 = MonoTimeNs();
+		pOwn = sws_getContext(Key.nSrcWidth, Key.nSrcHeight, Key.nSrcFormat, Key.nDstWidth, Key.nDstHeight, Key.nDstFormat, Key.nFlags, NULL, NULL, NULL);
+		pChannel->nSetupNs = MonoTimeNs() - nT1;
+	}
+	uint32_t nSum = 0;
+	for (int i = 0; i < pChannel->nFrames; i++)
+	{
+		SwsContext *pContext = pChannel->pCache ? pChannel->pCache->Acquire(Key) : pOwn;
+		const vector<BYTE> &vecFrame = *pChannel->pFrame;
+		for (size_t j = 0; j < vecFrame.size(); j += 64)
+			nSum += vecFrame[j];
+		if (pChannel->pCache)
+			pChannel->pCache->Release(Key, pContext);
+	}
+	pChannel->nSum = nSum;
+	InterlockedIncrement(pChannel->pConverted);
+	WaitForSingleObject(pChannel->hExit, INFINITE);
+	if (pOwn)
+		sws_freeContext(pOwn);
+	return 0;
+}
+
+// ͨתʱռõֽ
+static int64_t RunSwsChannels(CSwsContextCache *pCache, int nFrames, int64_t &nSetupNs, int &nContexts)
+{
+	vector<BYTE> vecFrame(704 * 576 * 3 / 2, 1);
+	vector<SwsBenchChannel> vecChannel(SWSBENCH_CHANNELS);
+	volatile LONG nConverted = 0;
+	HANDLE hExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+	int64_t nBytes0 = AvStubSwsBytes();
+	int nContexts0 = AvStubSwsContexts();
+	vector<HANDLE> vecThread;
+	for (int i = 0; i < SWSBENCH_CHANNELS; i++)
+	{
+		SwsBenchChannel &Channel = vecChannel[i];
+		Channel.pCache = pCache;
+		Channel.nFrames = nFrames;
+		Channel.pFrame = &vecFrame;
+		Channel.pConverted = &nConverted;
+		Channel.hExit = hExit;
+		Channel.nSetupNs = 0;
+		vecThread.push_back((HANDLE)_beginthreadex(NULL, 0, SwsBenchThread, &Channel, 0, NULL));
+	}
+	while (nConverted < SWSBENCH_CHANNELS)
+		Sleep(1);
+	int64_t nBytes = AvStubSwsBytes() - nBytes0;
+	nContexts = AvStubSwsContexts() - nContexts0;
+	SetEvent(hExit);
+	nSetupNs = 0;
+	for (int i = 0; i < SWSBENCH_CHANNELS; i++)
+	{
+		WaitForSingleObject(vecThread[i], INFINITE);
+		CloseHandle(vecThread[i]);
+		nSetupNs += vecChannel[i].nSetupNs;
+	}
+	CloseHandle(hExit);
+	if (pCache)
+	{
+		SwsCacheStat Stat;
+		pCache->GetStat(Stat);
+		nSetupNs = (int64_t)(Stat.dfSetupTime * 1e9);
+	}
+	return nBytes;
+}
+
+BENCHMARK(SwsContextCache, Setup64Channels)
+{
+	int nFrames = TestMinTime() > 0 ? 200 : 5;
+	int64_t nSetupNs = 0;
+	int nContexts = 0;
+	int64_t nBytes = RunSwsChannels(NULL, nFrames, nSetupNs, nContexts);
+	printf("  %-44s %12d\n", "per channel: contexts", nContexts);
+	printf("  %-44s %12.3f ms\n", "per channel: setup time", MonoNsToMs(nSetupNs));
+	printf("  %-44s %12.1f KB\n", "per channel: context memory", nBytes / 1024.0);
+
+	CSwsContextCache Cache;
+	nBytes = RunSwsChannels(&Cache, nFrames, nSetupNs, nContexts);
+	SwsCacheStat Stat;
+	Cache.GetStat(Stat);
+	printf("  %-44s %12d\n", "shared cache: contexts", nContexts);
+	printf("  %-44s %12.3f ms\n", "shared cache: setup time", MonoNsToMs(nSetupNs));
+	printf("  %-44s %12.1f KB\n", "shared cache: context memory", nBytes / 1024.0);
+	printf("  %-44s %12.2f %%\n", "shared cache: hit rate", Stat.nHits * 100.0 / max(Stat.nHits + Stat.nMisses, 1));
+	fflush(stdout);
+	TEST_CHECK(nContexts <= SWSBENCH_CHANNELS);
+}
@@ -0,0 +1,112 @@
+#include "TestFramework.h"
+#include <stdlib.h>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static std::vector<TestEntry> &TestEntries()
+{
+	static std::vector<TestEntry> s_vecEntry;
+	return s_vecEntry;
+}
+
+static int s_nFailures = 0;
+static double s_dfMinTime = 0.2;
+
+CTestRegistrar::CTestRegistrar(const char *szSuite, const char *szName, TestProc pProc, bool bBenchmark)
+{
+	TestEntry Entry = { szSuite, szName, pProc, bBenchmark };
+	TestEntries().push_back(Entry);
+}
+
+void TestFail(const char *szFile, int nLine, const char *szExpr)
+{
+	s_nFailures++;
+	printf("%s(%d): check failed: %s\n", szFile, nLine, szExpr);
+	fflush(stdout);
+}
+
+void TestFailEqual(const char *szFile, int nLine, const char *szExpr, long long nActual, long long nExpected)
+{
+	s_nFailures++;
+	printf("%s(%d): %s is %lld, expected %lld\n", szFile, nLine, szExpr, nActual, nExpected);
+	fflush(stdout);
+}
+
+int64_t TestNowNs()
+{
+#ifdef _WIN32
+	LARGE_INTEGER nFreq, nCounter;
+	QueryPerformanceFrequency(&nFreq);
+	QueryPerformanceCounter(&nCounter);
+	return (int64_t)((double)nCounter.QuadPart * 1e9 / (double)nFreq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+#endif
+}
+
+double TestMinTime()
+{
+	return s_dfMinTime;
+}
+
+int main(int argc, char *argv[])
+{
+	bool bBenchmark = false;
+	bool bList = false;
+	std::string strFilter;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--test") == 0 || strcmp(argv[i], "--bench") == 0)
+		{
+			bBenchmark = strcmp(argv[i], "--bench") == 0;
+			if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0)
+				strFilter = argv[++i];
+		}
+		else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+			s_dfMinTime = atof(argv[++i]);
+		else if (strcmp(argv[i], "--list") == 0)
+			bList = true;
+		else
+		{
+			printf("usage: %s [--test [filter]] [--bench [filter]] [--min-time seconds] [--list]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	int nRun = 0;
+	std::vector<TestEntry> &vecEntry = TestEntries();
+	for (size_t i = 0; i < vecEntry.size(); i++)
+	{
+		std::string strName = std::string(vecEntry[i].szSuite) + "." + vecEntry[i].szName;
+		if (bList)
+		{
+			printf("%s%s\n", strName.c_str(), vecEntry[i].bBenchmark ? " (benchmark)" : "");
+			continue;
+		}
+		if (vecEntry[i].bBenchmark != bBenchmark || strName.find(strFilter) == std::string::npos)
+			continue;
+		int nFailures = s_nFailures;
+		printf("[ RUN  ] %s\n", strName.c_str());
+		fflush(stdout);
+		int64_t nStart = TestNowNs();
+		vecEntry[i].pProc();
+		printf("[ %s ] %s (%.1f ms)\n", s_nFailures == nFailures ? " OK " : "FAIL", strName.c_str(), (double)(TestNowNs() - nStart) / 1e6);
+		fflush(stdout);
+		nRun++;
+	}
+	if (bList)
+		return 0;
+	if (nRun == 0)
+	{
+		printf("no test matches \"%s\"\n", strFilter.c_str());
+		return 1;
+	}
+	printf("%d run, %d check(s) failed\n", nRun, s_nFailures);
+	return s_nFailures ? 1 : 0;
+}
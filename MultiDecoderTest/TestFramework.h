@@ -0,0 +1,127 @@
+#pragma once
+// MultiDecoderTestʹõĲԺܲԿ,
+// TEST_CASE幦ܲ,BENCHMARKܲ,ھ̬ʼʱԶע
+// :
+//	MultiDecoderTest [--test [˴]]		(Suite.Name)˴Ĺܲ,ʱȫܲ
+//	MultiDecoderTest --bench [˴]		ܲ
+//	MultiDecoderTest --min-time 		ÿܲԵ̼ʱʱ,Ϊ0ʱÿֻһ,ð̲
+//	MultiDecoderTest --list					гв
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+typedef void(*TestProc)();
+
+struct TestEntry
+{
+	const char	*szSuite;
+	const char	*szName;
+	TestProc	pProc;
+	bool		bBenchmark;
+};
+
+// ע,TEST_CASEBENCHMARKھ̬ʼʱʹ
+struct CTestRegistrar
+{
+	CTestRegistrar(const char *szSuite, const char *szName, TestProc pProc, bool bBenchmark);
+};
+
+// ¼һμʧ,Լִ,Խʧܴж
+void TestFail(const char *szFile, int nLine, const char *szExpr);
+void TestFailEqual(const char *szFile, int nLine, const char *szExpr, long long nActual, long long nExpected);
+
+// ʱ,Ϊλ,뱻ģ޹
+int64_t TestNowNs();
+
+// ܲÿ̼ʱʱ(),--min-timeָ
+double TestMinTime();
+
+#define TEST_CASE(Suite, Name)	\
+	static void Test_##Suite##_##Name();	\
+	static CTestRegistrar s_Register_##Suite##_##Name(#Suite, #Name, Test_##Suite##_##Name, false);	\
+	static void Test_##Suite##_##Name()
+
+#define BENCHMARK(Suite, Name)	\
+	static void Bench_##Suite##_##Name();	\
+	static CTestRegistrar s_Register_##Suite##_##Name(#Suite, #Name, Bench_##Suite##_##Name, true);	\
+	static void Bench_##Suite##_##Name()
+
+#define TEST_CHECK(expr)	\
+	do { if (!(expr)) TestFail(__FILE__, __LINE__, #expr); } while (0)
+
+#define TEST_EQUAL(actual, expected)	\
+	do { long long _a = (long long)(actual), _e = (long long)(expected); if (_a != _e) TestFailEqual(__FILE__, __LINE__, #actual, _a, _e); } while (0)
+
+/// @brief һܲԲÿβĺʱ
+/// @param szLabel		ʱʹõ
+/// @param dfBytes		ÿβֽ,Ϊ0ʱ
+/// @param fn			
+/// @return ÿβƽʱ,λ
+/// @remark ɱ,ֱܺʱTestMinTime()
+template <class Fn>
+double BenchRun(const char *szLabel, double dfBytes, Fn fn)
+{
+	double dfMinTime = TestMinTime();
+	long long nIterations = 1;
+	double dfElapsed = 0;
+	for (;;)
+	{
+		int64_t nStart = TestNowNs();
+		for (long long i = 0; i < nIterations; i++)
+			fn();
+		dfElapsed = (double)(TestNowNs() - nStart) / 1e9;
+		if (dfElapsed >= dfMinTime || nIterations >= (1LL << 40))
+			break;
+		nIterations *= 2;
+	}
+	double dfNsPerOp = dfElapsed * 1e9 / (double)nIterations;
+	if (dfBytes > 0)
+		printf("  %-44s %12.1f ns/op %10.1f MB/s\n", szLabel, dfNsPerOp, dfNsPerOp > 0 ? dfBytes * 1e3 / dfNsPerOp : 0.0);
+	else
+		printf("  %-44s %12.1f ns/op\n", szLabel, dfNsPerOp);
+	fflush(stdout);
+	return dfNsPerOp;
+}
+
+// ̶ӵxorshift32α,֤ÿеĲһ
+class CTestRandom
+{
+public:
+	explicit CTestRandom(uint32_t nSeed = 2463534242u)
+		: m_nState(nSeed ? nSeed : 1)
+	{
+	}
+	uint32_t Next()
+	{
+		m_nState ^= m_nState << 13;
+		m_nState ^= m_nState >> 17;
+		m_nState ^= m_nState << 5;
+		return m_nState;
+	}
+	// [nMin,nMax]֮
+	int Range(int nMin, int nMax)
+	{
+		return nMin + (int)(Next() % (uint32_t)(nMax - nMin + 1));
+	}
+	void Fill(void *pBuffer, size_t nSize)
+	{
+		uint8_t *p = (uint8_t *)pBuffer;
+		for (size_t i = 0; i < nSize; i++)
+			p[i] = (uint8_t)(Next() >> 24);
+	}
+private:
+	uint32_t	m_nState;
+};
+
+// FNV-1aϣ,ڼ¼οָ
+inline uint32_t TestHash(const void *pData, size_t nSize, uint32_t nHash = 2166136261u)
+{
+	const uint8_t *p = (const uint8_t *)pData;
+	for (size_t i = 0; i < nSize; i++)
+	{
+		nHash ^= p[i];
+		nHash *= 16777619u;
+	}
+	return nHash;
+}
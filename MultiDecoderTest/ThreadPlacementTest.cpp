@@ -0,0 +1,390 @@
+// CThreadPlacementĲԺܲ
+// ָģⳬ64߼Ϊϵͳ,ͨ߳ڴ顢ļķֲ;
+// LinuxʱĿ¼ģ/sys/devices/system/cpu,˵Ľ,߳ʵõ׺;
+// ܲԽ߳д롢Ⱦ̶߳ȡD1ͼʾ,Ƚϲúͷɢʱ
+#include "TestFramework.h"
+#include "ThreadPlacement.h"
+#include <set>
+#ifndef _WIN32
+#include <string>
+#include <sys/stat.h>
+#endif
+
+#define PLACEMENT_GROUP_BITS	((int)(sizeof(DWORD_PTR) * 8))
+
+static DWORD_PTR LowBits(int nBits)
+{
+	return nBits >= PLACEMENT_GROUP_BITS ? ~(DWORD_PTR)0 : (((DWORD_PTR)1 << nBits) - 1);
+}
+
+// ,ÿ64߼(32λΪ32)ΪһNUMAڵ,ÿ߼,ÿ鹲һL3
+static void MakeTwoGroupTopology(vector<PlacementMask> &vecCore, vector<PlacementMask> &vecCache, vector<PlacementMask> &vecNode)
+{
+	int nHalf = PLACEMENT_GROUP_BITS / 2;
+	for (WORD nGroup = 0; nGroup < 2; nGroup++)
+	{
+		for (int i = 0; i < PLACEMENT_GROUP_BITS; i += 2)
+		{
+			PlacementMask Core = { nGroup, (DWORD_PTR)3 << i };
+			vecCore.push_back(Core);
+		}
+		PlacementMask Cache = { nGroup, LowBits(nHalf) };
+		vecCache.push_back(Cache);
+		Cache.nMask = LowBits(nHalf) << nHalf;
+		vecCache.push_back(Cache);
+		PlacementMask Node = { nGroup, ~(DWORD_PTR)0 };
+		vecNode.push_back(Node);
+	}
+}
+
+TEST_CASE(ThreadPlacement, SpreadAcrossGroups)
+{
+	vector<PlacementMask> vecCore, vecCache, vecNode;
+	MakeTwoGroupTopology(vecCore, vecCache, vecNode);
+	CThreadPlacement Placement;
+	TEST_CHECK(Placement.SetTopology(vecCore, vecCache, vecNode));
+	TEST_EQUAL(Placement.GetProcessorCount(), PLACEMENT_GROUP_BITS * 2);
+	TEST_EQUAL(Placement.GetDomainCount(), 4);
+
+	int nHalf = PLACEMENT_GROUP_BITS / 2;
+	int nCoresPerDomain = nHalf / 2;
+	int nChannels = nCoresPerDomain * 4;
+	set<pair<int, int> > setCore;
+	for (int nChannel = 0; nChannel < nChannels; nChannel++)
+	{
+		int nDomain = nChannel % 4;
+		PlacementMask Decode, Render, IO;
+		int nIdeal = -1;
+		int nRenderIdeal = -1;
+		int nIOIdeal = -1;
+		TEST_CHECK(Placement.GetAffinity(ThreadRole_Decode, nChannel, Decode, nIdeal));
+		TEST_CHECK(Placement.GetAffinity(ThreadRole_Render, nChannel, Render, nRenderIdeal));
+		TEST_CHECK(Placement.GetAffinity(ThreadRole_IO, nChannel, IO, nIOIdeal));
+		// ڵֵͨ,2͵3ڴ1
+		TEST_EQUAL(Decode.nGroup, nDomain / 2);
+		TEST_CHECK(Decode.nMask == vecCache[nDomain].nMask);
+		TEST_EQUAL(nIdeal, (nDomain % 2) * nHalf + 2 * (nChannel / 4));
+		// Ⱦ̹߳߳û,I/O߳ͨĽڵ
+		TEST_EQUAL(Render.nGroup, Decode.nGroup);
+		TEST_CHECK(Render.nMask == Decode.nMask);
+		TEST_EQUAL(nRenderIdeal, -1);
+		TEST_EQUAL(IO.nGroup, Decode.nGroup);
+		TEST_CHECK(IO.nMask == ~(DWORD_PTR)0);
+		setCore.insert(make_pair((int)Decode.nGroup, nIdeal));
+	}
+	// ͨʱ,ÿǡ÷ֵһ߳
+	TEST_EQUAL((int)setCore.size(), nChannels);
+
+	PlacementMask Input;
+	int nIdeal = -1;
+	TEST_CHECK(Placement.GetAffinity(ThreadRole_Input, -1, Input, nIdeal));
+	TEST_EQUAL(Input.nGroup, 0);
+	TEST_EQUAL(nIdeal, -1);
+}
+
+TEST_CASE(ThreadPlacement, FallbackDomains)
+{
+	vector<PlacementMask> vecCore, vecCache, vecNode;
+	MakeTwoGroupTopology(vecCore, vecCache, vecNode);
+	CThreadPlacement Placement;
+	// ûL3NUMAڵϢʱ,ÿΪһ
+	TEST_CHECK(Placement.SetTopology(vecCore, vector<PlacementMask>(), vector<PlacementMask>()));
+	TEST_EQUAL(Placement.GetDomainCount(), 2);
+	PlacementMask Mask;
+	int nIdeal = -1;
+	TEST_CHECK(Placement.GetAffinity(ThreadRole_Decode, 1, Mask, nIdeal));
+	TEST_EQUAL(Mask.nGroup, 1);
+	TEST_CHECK(Mask.nMask == ~(DWORD_PTR)0);
+	TEST_EQUAL(nIdeal, 0);
+	TEST_CHECK(Placement.GetAffinity(ThreadRole_Decode, 3, Mask, nIdeal));
+	TEST_EQUAL(nIdeal, 2);
+
+	// ׺˵ĺĺͿյ˲
+	vector<PlacementMask> vecEmpty(1);
+	vecEmpty[0].nGroup = 0;
+	vecEmpty[0].nMask = 0;
+	TEST_CHECK(!Placement.SetTopology(vecEmpty, vecEmpty, vector<PlacementMask>()));
+	TEST_EQUAL(Placement.GetDomainCount(), 0);
+	TEST_CHECK(!Placement.GetAffinity(ThreadRole_Render, 0, Mask, nIdeal));
+}
+
+#ifndef _WIN32
+// ʱĿ¼ģsysfscpuĿ¼,¼ļĿ¼,ʱɾ
+class CFakeSysfs
+{
+public:
+	CFakeSysfs()
+	{
+		char szRoot[64];
+		_snprintf(szRoot, sizeof(szRoot), "/tmp/ThreadPlacementTest.%d", (int)getpid());
+		m_strRoot = szRoot;
+		MakeDir("");
+	}
+	~CFakeSysfs()
+	{
+		for (size_t i = m_vecPath.size(); i > 0; i--)
+			remove(m_vecPath[i - 1].c_str());
+	}
+	const char *GetRoot()
+	{
+		return m_strRoot.c_str();
+	}
+	void MakeDir(const string &strDir)
+	{
+		string strPath = m_strRoot + strDir;
+		mkdir(strPath.c_str(), 0755);
+		m_vecPath.push_back(strPath);
+	}
+	void WriteFile(const string &strFile, const char *szText)
+	{
+		string strPath = m_strRoot + strFile;
+		FILE *fp = fopen(strPath.c_str(), "w");
+		if (!fp)
+			return;
+		fprintf(fp, "%s\n", szText);
+		fclose(fp);
+		m_vecPath.push_back(strPath);
+	}
+	// һ߼,L2Ķռ,L3ɽڵڵĴ
+	void AddCpu(int nCpu, const char *szCoreCpus, const char *szL3Cpus, int nNode)
+	{
+		char szCpu[32];
+		_snprintf(szCpu, sizeof(szCpu), "/cpu%d", nCpu);
+		string strCpu = szCpu;
+		MakeDir(strCpu);
+		MakeDir(strCpu + "/topology");
+		WriteFile(strCpu + "/topology/core_cpus_list", szCoreCpus);
+		MakeDir(strCpu + "/cache");
+		MakeDir(strCpu + "/cache/index0");
+		WriteFile(strCpu + "/cache/index0/level", "1");
+		WriteFile(strCpu + "/cache/index0/type", "Data");
+		WriteFile(strCpu + "/cache/index0/shared_cpu_list", szCoreCpus);
+		MakeDir(strCpu + "/cache/index1");
+		WriteFile(strCpu + "/cache/index1/level", "2");
+		WriteFile(strCpu + "/cache/index1/type", "Unified");
+		WriteFile(strCpu + "/cache/index1/shared_cpu_list", szCoreCpus);
+		MakeDir(strCpu + "/cache/index2");
+		WriteFile(strCpu + "/cache/index2/level", "3");
+		WriteFile(strCpu + "/cache/index2/type", "Unified");
+		WriteFile(strCpu + "/cache/index2/shared_cpu_list", szL3Cpus);
+		char szNode[32];
+		_snprintf(szNode, sizeof(szNode), "/node%d", nNode);
+		MakeDir(strCpu + szNode);
+	}
+private:
+	string			m_strRoot;
+	vector<string>	m_vecPath;
+};
+
+// NUMAڵ㹲8߼,Intel̵߳ıͬ,cpuNcpuN+4Ϊͬһ;ÿڵһL3,cpu7
+TEST_CASE(ThreadPlacement, SysfsTopology)
+{
+	CFakeSysfs Sysfs;
+	Sysfs.WriteFile("/online", "0-6");
+	const char *szCore[4] = { "0,4", "1,5", "2,6", "3,7" };
+	for (int nCpu = 0; nCpu < 7; nCpu++)
+	{
+		int nNode = (nCpu % 4) / 2;
+		Sysfs.AddCpu(nCpu, szCore[nCpu % 4], nNode ? "2-3,6-7" : "0-1,4-5", nNode);
+	}
+	CThreadPlacement Placement;
+	TEST_CHECK(Placement.LoadSysfsTopology(Sysfs.GetRoot(), false));
+	TEST_EQUAL(Placement.GetProcessorCount(), 7);
+	TEST_EQUAL(Placement.GetDomainCount(), 2);
+
+	// ֵͨڵL3,ͬһڵͨηֵͬ
+	const DWORD_PTR nDomainMask[2] = { 0x33, 0x4C };
+	const int nExpectedIdeal[4] = { 0, 2, 1, 3 };
+	for (int nChannel = 0; nChannel < 4; nChannel++)
+	{
+		PlacementMask Mask;
+		int nIdeal = -1;
+		TEST_CHECK(Placement.GetAffinity(ThreadRole_Decode, nChannel, Mask, nIdeal));
+		TEST_EQUAL(Mask.nGroup, 0);
+		TEST_CHECK(Mask.nMask == nDomainMask[nChannel % 2]);
+		TEST_EQUAL(nIdeal, nExpectedIdeal[nChannel]);
+		TEST_CHECK(Placement.GetAffinity(ThreadRole_IO, nChannel, Mask, nIdeal));
+		TEST_CHECK(Mask.nMask == nDomainMask[nChannel % 2]);
+	}
+
+	// ߴбʱȡ
+	CThreadPlacement Missing;
+	TEST_CHECK(!Missing.LoadSysfsTopology("/tmp/ThreadPlacementTest.missing", false));
+	TEST_EQUAL(Missing.GetDomainCount(), 0);
+}
+
+struct PlacementAffinityCheck
+{
+	CThreadPlacement	*pPlacement;
+	bool				bApplied;
+	cpu_set_t			CpuSet;
+};
+
+static UINT __stdcall PlacementAffinityThread(void *p)
+{
+	PlacementAffinityCheck *pCheck = (PlacementAffinityCheck *)p;
+	pCheck->bApplied = pCheck->pPlacement->Apply(ThreadRole_Render, 0);
+	CPU_ZERO(&pCheck->CpuSet);
+	pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &pCheck->CpuSet);
+	return 0;
+}
+
+// ӱsysfsȡ,̰߳Էúʵʵ׺뻺һ
+TEST_CASE(ThreadPlacement, ApplySetsAffinity)
+{
+	CThreadPlacement Placement;
+	Placement.SetPolicy(Placement_Spread);
+	if (Placement.GetPolicy() != Placement_Spread)
+	{
+		printf("  processor topology unavailable, skipped\n");
+		return;
+	}
+	cpu_set_t ProcessSet;
+	CPU_ZERO(&ProcessSet);
+	TEST_EQUAL(sched_getaffinity(0, sizeof(cpu_set_t), &ProcessSet), 0);
+	TEST_EQUAL(Placement.GetProcessorCount(), CPU_COUNT(&ProcessSet));
+
+	PlacementMask Mask;
+	int nIdeal = -1;
+	TEST_CHECK(Placement.GetAffinity(ThreadRole_Render, 0, Mask, nIdeal));
+	PlacementAffinityCheck Check;
+	Check.pPlacement = &Placement;
+	Check.bApplied = false;
+	HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, PlacementAffinityThread, &Check, 0, NULL);
+	WaitForSingleObject(hThread, INFINITE);
+	CloseHandle(hThread);
+	TEST_CHECK(Check.bApplied);
+	int nGroupSize = (int)(sizeof(DWORD_PTR) * 8);
+	for (int i = 0; i < nGroupSize; i++)
+	{
+		bool bInMask = (Mask.nMask & ((DWORD_PTR)1 << i)) != 0;
+		TEST_EQUAL(CPU_ISSET(Mask.nGroup * nGroupSize + i, &Check.CpuSet) != 0, bInMask);
+	}
+}
+#endif
+
+#define PLACEMENT_FRAME_SIZE	(704 * 576 * 3 / 2)
+
+struct PlacementChannel
+{
+	CThreadPlacement *pPlacement;
+	int			nChannel;
+	int			nFrames;
+	uint32_t	*pFrame[2];
+	HANDLE		hFilled[2];
+	HANDLE		hEmpty[2];
+	uint32_t	nSum;
+};
+
+// ߳,ÿ֡дһD1ͼ
+static UINT __stdcall PlacementDecodeThread(void *p)
+{
+	PlacementChannel *pChannel = (PlacementChannel *)p;
+	pChannel->pPlacement->Apply(ThreadRole_Decode, pChannel->nChannel);
+	for (int i = 0; i < pChannel->nFrames; i++)
+	{
+		int nSlot = i & 1;
+		WaitForSingleObject(pChannel->hEmpty[nSlot], INFINITE);
+		uint32_t *pFrame = pChannel->pFrame[nSlot];
+		for (int j = 0; j < PLACEMENT_FRAME_SIZE / 4; j++)
+			pFrame[j] = i + j;
+		SetEvent(pChannel->hFilled[nSlot]);
+	}
+	return 0;
+}
+
+// Ⱦ߳,ÿ֡߳дͼ
+static UINT __stdcall PlacementRenderThread(void *p)
+{
+	PlacementChannel *pChannel = (PlacementChannel *)p;
+	pChannel->pPlacement->Apply(ThreadRole_Render, pChannel->nChannel);
+	uint32_t nSum = 0;
+	for (int i = 0; i < pChannel->nFrames; i++)
+	{
+		int nSlot = i & 1;
+		WaitForSingleObject(pChannel->hFilled[nSlot], INFINITE);
+		const uint32_t *pFrame = pChannel->pFrame[nSlot];
+		for (int j = 0; j < PLACEMENT_FRAME_SIZE / 4; j++)
+			nSum += pFrame[j];
+		SetEvent(pChannel->hEmpty[nSlot]);
+	}
+	pChannel->nSum = nSum;
+	return 0;
+}
+
+// ͨϼÿ֡
+static double RunPlacement(CThreadPlacement &Placement, int nChannels, int nFrames)
+{
+	vector<PlacementChannel> vecChannel(nChannels);
+	vector<HANDLE> vecThread;
+	for (int i = 0; i < nChannels; i++)
+	{
+		PlacementChannel &Channel = vecChannel[i];
+		Channel.pPlacement = &Placement;
+		Channel.nChannel = i;
+		Channel.nFrames = nFrames;
+		Channel.nSum = 0;
+		for (int j = 0; j < 2; j++)
+		{
+			Channel.pFrame[j] = new uint32_t[PLACEMENT_FRAME_SIZE / 4];
+			memset(Channel.pFrame[j], 0, PLACEMENT_FRAME_SIZE);
+			Channel.hFilled[j] = CreateEvent(NULL, FALSE, FALSE, NULL);
+			Channel.hEmpty[j] = CreateEvent(NULL, FALSE, TRUE, NULL);
+		}
+	}
+	int64_t nT1 = TestNowNs();
+	for (int i = 0; i < nChannels; i++)
+	{
+		vecThread.push_back((HANDLE)_beginthreadex(NULL, 0, PlacementDecodeThread, &vecChannel[i], 0, NULL));
+		vecThread.push_back((HANDLE)_beginthreadex(NULL, 0, PlacementRenderThread, &vecChannel[i], 0, NULL));
+	}
+	for (int i = 0; i < vecThread.size(); i++)
+	{
+		WaitForSingleObject(vecThread[i], INFINITE);
+		CloseHandle(vecThread[i]);
+	}
+	int64_t nTime = TestNowNs() - nT1;
+	for (int i = 0; i < nChannels; i++)
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			delete []vecChannel[i].pFrame[j];
+			CloseHandle(vecChannel[i].hFilled[j]);
+			CloseHandle(vecChannel[i].hEmpty[j]);
+		}
+	}
+	return (double)nChannels * nFrames * 1e9 / (nTime ? nTime : 1);
+}
+
+// ͨΪ߼,Ⱦ߳ϼΪ߼ı,ʱ൱
+BENCHMARK(ThreadPlacement, SpreadThroughput)
+{
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	int nChannels = si.dwNumberOfProcessors * 2;
+	if (nChannels < 4)
+		nChannels = 4;
+	if (nChannels > 128)
+		nChannels = 128;
+	int nFrames = TestMinTime() > 0 ? 200 : 4;
+	char szLabel[64];
+
+	CThreadPlacement Placement;
+	Placement.SetPolicy(Placement_None);
+	double dfNone = RunPlacement(Placement, nChannels, nFrames);
+	sprintf_s(szLabel, sizeof(szLabel), "none, %d channels D1", nChannels);
+	printf("  %-44s %12.1f fps\n", szLabel, dfNone);
+
+	Placement.SetPolicy(Placement_Spread);
+	if (Placement.GetPolicy() != Placement_Spread)
+	{
+		printf("  %-44s\n", "spread: processor topology unavailable");
+		fflush(stdout);
+		return;
+	}
+	double dfSpread = RunPlacement(Placement, nChannels, nFrames);
+	sprintf_s(szLabel, sizeof(szLabel), "spread, %d channels D1 (%d domains)", nChannels, Placement.GetDomainCount());
+	printf("  %-44s %12.1f fps\n", szLabel, dfSpread);
+	printf("  %-44s %12.2f x\n", "spread / none", dfSpread / dfNone);
+	fflush(stdout);
+}
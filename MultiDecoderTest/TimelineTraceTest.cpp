@@ -0,0 +1,201 @@
+// ʱ߼¼ĲԺܲ
+// Chrome traceļغ¼Ƽ,¼ء߳ơʱѭֻ¼,Լ¼
+#include "TestFramework.h"
+#include "TimelineTrace.h"
+#include <string>
+#include <vector>
+
+static std::string TimelineFilePath(const char *szName)
+{
+	char szFile[128];
+	sprintf_s(szFile, sizeof(szFile), "%s%u.json", szName, (unsigned)GetCurrentProcessId());
+#ifdef _WIN32
+	char szPath[MAX_PATH];
+	GetTempPathA(MAX_PATH, szPath);
+	return std::string(szPath) + szFile;
+#else
+	return std::string("/tmp/") + szFile;
+#endif
+}
+
+// ļݲɾļ
+static bool ExportTimelineText(const char *szName, std::string &strText)
+{
+	std::string strPath = TimelineFilePath(szName);
+	strText.clear();
+	if (!TimelineExportChrome(strPath.c_str()))
+		return false;
+	FILE *fp = fopen(strPath.c_str(), "rb");
+	if (!fp)
+		return false;
+	char szBuffer[4096];
+	size_t nRead = 0;
+	while ((nRead = fread(szBuffer, 1, sizeof(szBuffer), fp)) > 0)
+		strText.append(szBuffer, nRead);
+	fclose(fp);
+	remove(strPath.c_str());
+	return true;
+}
+
+static int CountText(const std::string &strText, const std::string &strPattern)
+{
+	int nCount = 0;
+	for (size_t nPos = strText.find(strPattern); nPos != std::string::npos; nPos = strText.find(strPattern, nPos + 1))
+		nCount++;
+	return nCount;
+}
+
+// ļһJSON,¼ѱպ
+static bool IsCompleteTrace(const std::string &strText)
+{
+	return strText.compare(0, 19, "{\"displayTimeUnit\":") == 0 && strText.size() > 4 && strText.compare(strText.size() - 4, 4, "\n]}\n") == 0;
+}
+
+TEST_CASE(TimelineTrace, DisabledRecordsNothing)
+{
+	TimelineEnable(false);
+	TEST_CHECK(!TimelineIsEnabled());
+	for (int i = 0; i < 10; i++)
+		TIMELINE_SCOPE("DisabledScope", 1, i);
+	std::string strText;
+	TEST_CHECK(ExportTimelineText("TimelineDisabled", strText));
+	TEST_CHECK(IsCompleteTrace(strText));
+	TEST_EQUAL(CountText(strText, "\"name\":\"DisabledScope\""), 0);
+}
+
+struct TimelineThreadContext
+{
+	int				nChannel;
+	int				nEvents;
+	volatile LONG	*pStop;		// ΪNULLʱһֱ¼,ֱ*pStopΪ0
+	HANDLE			hEventExit;	// ΪNULLʱ¼Ϻȴ¼˳,˳̵߳Ļᱻ̸߳
+};
+
+static unsigned __stdcall TimelineThread(void *p)
+{
+	TimelineThreadContext *pContext = (TimelineThreadContext *)p;
+	TimelineSetThreadName("TestDecode", pContext->nChannel);
+	for (int i = 0; i < pContext->nEvents || (pContext->pStop && !*pContext->pStop); i++)
+	{
+		CTimelineScope Scope("TestStage", TIMELINE_CURRENT_CHANNEL, i);
+		Scope.End();
+		Scope.End();		// ѽ䲻ټ¼
+	}
+	if (pContext->hEventExit)
+		WaitForSingleObject(pContext->hEventExit, INFINITE);
+	return 0;
+}
+
+// TestStage¼ﵽnEventsʱtrue
+static bool TimelineHasEvents(int nEvents)
+{
+	std::string strText;
+	return ExportTimelineText("TimelinePoll", strText) && CountText(strText, "\"name\":\"TestStage\"") >= nEvents;
+}
+
+// ̵߳¼߳ơĬͨʱ
+TEST_CASE(TimelineTrace, ExportsThreadsAndEvents)
+{
+	TimelineEnable(true);
+	const int nThreads = 4;
+	const int nEvents = 100;
+	HANDLE hEventExit = CreateEvent(NULL, TRUE, FALSE, NULL);
+	TimelineThreadContext Context[nThreads];
+	HANDLE hThreads[nThreads];
+	for (int i = 0; i < nThreads; i++)
+	{
+		TimelineThreadContext Init = { 10 + i, nEvents, NULL, hEventExit };
+		Context[i] = Init;
+		hThreads[i] = (HANDLE)_beginthreadex(NULL, 0, TimelineThread, &Context[i], 0, NULL);
+	}
+	// ȸ̼߳¼
+	for (int nRetry = 0; nRetry < 5000 && !TimelineHasEvents(nThreads * nEvents); nRetry++)
+		Sleep(1);
+	{
+		CTimelineScope Scope;
+		Scope.Begin("MainScope", 3, TIMELINE_NO_PTS);
+	}
+	std::string strText;
+	TEST_CHECK(ExportTimelineText("TimelineExport", strText));
+	TimelineEnable(false);
+	SetEvent(hEventExit);
+	WaitForMultipleObjects(nThreads, hThreads, TRUE, INFINITE);
+	for (int i = 0; i < nThreads; i++)
+		CloseHandle(hThreads[i]);
+	CloseHandle(hEventExit);
+	TEST_CHECK(IsCompleteTrace(strText));
+	TEST_EQUAL(CountText(strText, "\"name\":\"TestStage\""), nThreads * nEvents);
+	for (int i = 0; i < nThreads; i++)
+	{
+		char szPattern[64];
+		sprintf_s(szPattern, sizeof(szPattern), "\"args\":{\"name\":\"TestDecode %d\"}", 10 + i);
+		TEST_EQUAL(CountText(strText, szPattern), 1);
+		sprintf_s(szPattern, sizeof(szPattern), "\"args\":{\"channel\":%d,\"pts\":%d}", 10 + i, nEvents - 1);
+		TEST_EQUAL(CountText(strText, szPattern), 1);
+	}
+	// ûʱ¼pts
+	TEST_EQUAL(CountText(strText, "\"name\":\"MainScope\""), 1);
+	TEST_EQUAL(CountText(strText, "\"args\":{\"channel\":3}"), 1);
+}
+
+// ÿֻ߳¼
+TEST_CASE(TimelineTrace, KeepsLatestEvents)
+{
+	TimelineEnable(true);
+	TimelineThreadContext Context = { 20, TIMELINE_EVENTS * 2 + 10, NULL, NULL };
+	HANDLE hThread = (HANDLE)_beginthreadex(NULL, 0, TimelineThread, &Context, 0, NULL);
+	WaitForSingleObject(hThread, INFINITE);
+	CloseHandle(hThread);
+	std::string strText;
+	TEST_CHECK(ExportTimelineText("TimelineWrap", strText));
+	TimelineEnable(false);
+	TEST_CHECK(IsCompleteTrace(strText));
+	// ʱͣ¼,ɵһ¼,
+	TEST_EQUAL(CountText(strText, "\"args\":{\"channel\":20,"), TIMELINE_EVENTS - 1);
+	char szPattern[64];
+	sprintf_s(szPattern, sizeof(szPattern), "\"channel\":20,\"pts\":%d}", Context.nEvents - 1);
+	TEST_EQUAL(CountText(strText, szPattern), 1);
+	sprintf_s(szPattern, sizeof(szPattern), "\"channel\":20,\"pts\":%d}", Context.nEvents - TIMELINE_EVENTS + 1);
+	TEST_EQUAL(CountText(strText, szPattern), 1);
+	sprintf_s(szPattern, sizeof(szPattern), "\"channel\":20,\"pts\":%d}", Context.nEvents - TIMELINE_EVENTS);
+	TEST_EQUAL(CountText(strText, szPattern), 0);
+}
+
+// ¼ͬʱ,ÿεļ
+TEST_CASE(TimelineTrace, ExportWhileRecording)
+{
+	TimelineEnable(true);
+	const int nThreads = 4;
+	volatile LONG nStop = 0;
+	TimelineThreadContext Context[nThreads];
+	HANDLE hThreads[nThreads];
+	for (int i = 0; i < nThreads; i++)
+	{
+		TimelineThreadContext Init = { 30 + i, 0, &nStop, NULL };
+		Context[i] = Init;
+		hThreads[i] = (HANDLE)_beginthreadex(NULL, 0, TimelineThread, &Context[i], 0, NULL);
+	}
+	int nIncomplete = 0;
+	for (int i = 0; i < 10; i++)
+	{
+		std::string strText;
+		if (!ExportTimelineText("TimelineConcurrent", strText) || !IsCompleteTrace(strText))
+			nIncomplete++;
+	}
+	InterlockedExchange(&nStop, 1);
+	WaitForMultipleObjects(nThreads, hThreads, TRUE, INFINITE);
+	for (int i = 0; i < nThreads; i++)
+		CloseHandle(hThreads[i]);
+	TimelineEnable(false);
+	TEST_EQUAL(nIncomplete, 0);
+}
+
+// ¼͹رʱһTIMELINE_SCOPEĿ
+BENCHMARK(TimelineTrace, Scope)
+{
+	TimelineEnable(false);
+	BenchRun("TIMELINE_SCOPE, disabled", 0, []() { TIMELINE_SCOPE("BenchScope", 0, 0); });
+	TimelineEnable(true);
+	BenchRun("TIMELINE_SCOPE, enabled", 0, []() { TIMELINE_SCOPE("BenchScope", 0, 0); });
+	TimelineEnable(false);
+}